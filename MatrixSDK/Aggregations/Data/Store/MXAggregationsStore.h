@@ -36,6 +36,24 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (instancetype)initWithCredentials:(MXCredentials *)credentials;
 
+#pragma mark - Write batch
+
+/**
+ Group the following mutations done on the calling thread in write transactions.
+
+ Mutations done in the same run loop iteration share a transaction. It is committed when the thread
+ goes back to its run loop, so that the write lock is not held while the caller waits for asynchronous
+ work, and by the outermost `commitBatch`.
+ Reads done on the calling thread see the pending mutations.
+ Batches can be nested. Both methods must be called on the thread that uses the store.
+ */
+- (void)beginBatch;
+
+/**
+ Commit the mutations done since the matching `beginBatch`.
+ */
+- (void)commitBatch;
+
 #pragma mark - Reaction count
 
 #pragma mark - Single object CRUD operations
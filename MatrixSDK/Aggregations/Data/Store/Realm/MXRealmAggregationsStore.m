@@ -23,12 +23,31 @@
 
 #import "MXLog.h"
 #import "RLMRealm+MatrixSDK.h"
+#import "MXSDKOptions.h"
+#import "MXBackgroundModeHandler.h"
 
 @interface MXRealmAggregationsStore ()
 
 @property (nonatomic) NSString *userId;
 @property (nonatomic) MXRealmAggregationsMapper *mapper;
 
+/**
+ Nesting level of `beginBatch` calls.
+ */
+@property (nonatomic) NSUInteger batchCount;
+
+/**
+ The thread that began the batch. Only its mutations are grouped.
+ */
+@property (nonatomic, nullable) NSThread *batchThread;
+
+/**
+ The realm in write transaction for the current run loop iteration of the batch thread.
+ It is retained so that the transaction is not rolled back if no other object references the realm.
+ */
+@property (nonatomic, nullable) RLMRealm *batchRealm;
+@property (nonatomic, nullable) id<MXBackgroundTask> batchBackgroundTask;
+
 @end
 
 
@@ -46,6 +65,65 @@
 }
 
 
+#pragma mark - Write batch
+
+- (void)beginBatch
+{
+    if (self.batchCount++)
+    {
+        return;
+    }
+
+    id<MXBackgroundModeHandler> handler = [MXSDKOptions sharedInstance].backgroundModeHandler;
+    self.batchBackgroundTask = [handler startBackgroundTaskWithName:@"[MXRealmAggregationsStore] batch" reusable:YES expirationHandler:nil];
+
+    // The write transaction is opened by the first mutation
+    self.batchThread = [NSThread currentThread];
+}
+
+- (void)commitBatch
+{
+    if (!self.batchCount)
+    {
+        MXLogError(@"[MXRealmAggregationsStore] commitBatch: No batch in progress");
+        return;
+    }
+
+    if (--self.batchCount)
+    {
+        return;
+    }
+
+    [self commitBatchTransaction];
+    self.batchThread = nil;
+
+    [self.batchBackgroundTask stop];
+    self.batchBackgroundTask = nil;
+}
+
+/**
+ Commit the write transaction of the current run loop iteration of the batch, if any.
+ */
+- (void)commitBatchTransaction
+{
+    RLMRealm *realm = self.batchRealm;
+    if (!realm)
+    {
+        return;
+    }
+    self.batchRealm = nil;
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(commitBatchTransaction) object:nil];
+
+    NSError *error;
+    if (realm.inWriteTransaction && ![realm commitWriteTransaction:&error])
+    {
+        MXLogErrorDetails(@"[MXRealmAggregationsStore] commitBatchTransaction: Failed to commit", @{
+            @"error": error ?: @"unknown"
+        });
+    }
+}
+
+
 #pragma mark - Reaction count
 
 #pragma mark - Single object CRUD operations
@@ -53,8 +131,8 @@
 - (void)addOrUpdateReactionCount:(nonnull MXReactionCount *)reactionCount onEvent:(nonnull NSString *)eventId inRoom:(nonnull NSString *)roomId
 {
     RLMRealm *realm = self.realm;
-    
-    [realm transactionWithName:@"[MXRealmAggregationsStore] addOrUpdateReactionCount" block:^{
+
+    [self writeWithRealm:realm name:@"[MXRealmAggregationsStore] addOrUpdateReactionCount" block:^{
         MXRealmReactionCount *realmReactionCount = [self.mapper realmReactionCountFromReactionCount:reactionCount
                                                                                             onEvent:eventId
                                                                                            inRoomId:roomId];
@@ -87,7 +165,7 @@
 {
     RLMRealm *realm = self.realm;
 
-    [realm transactionWithName:@"[MXRealmAggregationsStore] deleteReactionCountsForReaction" block:^{
+    [self writeWithRealm:realm name:@"[MXRealmAggregationsStore] deleteReactionCountsForReaction" block:^{
         NSString *primaryKey = [MXRealmReactionCount primaryKeyFromEventId:eventId andReaction:reaction];
         
         MXRealmReactionCount *realmReactionCount = [MXRealmReactionCount objectInRealm:realm forPrimaryKey:primaryKey];
@@ -101,8 +179,8 @@
 - (void)setReactionCounts:(nonnull NSArray<MXReactionCount *> *)reactionCounts onEvent:(nonnull NSString *)eventId inRoom:(nonnull NSString *)roomId
 {
     RLMRealm *realm = self.realm;
-    
-    [realm transactionWithName:@"[MXRealmAggregationsStore] setReactionCounts" block:^{
+
+    [self writeWithRealm:realm name:@"[MXRealmAggregationsStore] setReactionCounts" block:^{
         // Flush previous data
         RLMResults<MXRealmReactionCount *> *realmReactionCounts = [MXRealmReactionCount objectsInRealm:realm
                                                                                                  where:@"eventId = %@", eventId];
@@ -141,8 +219,8 @@
 - (void)deleteAllReactionCountsInRoom:(nonnull NSString *)roomId
 {
     RLMRealm *realm = self.realm;
-    
-    [realm transactionWithName:@"[MXRealmAggregationsStore] deleteAllReactionCountsInRoom" block:^{
+
+    [self writeWithRealm:realm name:@"[MXRealmAggregationsStore] deleteAllReactionCountsInRoom" block:^{
         RLMResults<MXRealmReactionCount *> *results = [MXRealmReactionCount objectsInRealm:realm
                                                                                      where:@"roomId = %@", roomId];
         [realm deleteObjects:results];
@@ -156,8 +234,8 @@
 - (void)addReactionRelation:(MXReactionRelation*)relation inRoom:(NSString*)roomId
 {
     RLMRealm *realm = self.realm;
-    
-    [realm transactionWithName:@"[MXRealmAggregationsStore] addReactionRelation" block:^{
+
+    [self writeWithRealm:realm name:@"[MXRealmAggregationsStore] addReactionRelation" block:^{
         MXRealmReactionRelation *realmRelation = [self.mapper realmReactionRelationFromReactionRelation:relation inRoomId:roomId];
         [realm addOrUpdateObject:realmRelation];
     }];
@@ -181,7 +259,7 @@
 {
     RLMRealm *realm = self.realm;
 
-    [realm transactionWithName:@"[MXRealmAggregationsStore] deleteReactionRelation" block:^{
+    [self writeWithRealm:realm name:@"[MXRealmAggregationsStore] deleteReactionRelation" block:^{
         NSString *primaryKey = [MXRealmReactionRelation primaryKeyFromEventId:relation.eventId andReactionEventId:relation.reactionEventId];
 
         MXRealmReactionRelation *result = [MXRealmReactionRelation objectInRealm:realm forPrimaryKey:primaryKey];
@@ -214,7 +292,7 @@
 {
     RLMRealm *realm = self.realm;
 
-    [realm transactionWithName:@"[MXRealmAggregationsStore] deleteAllReactionRelationsInRoom" block:^{
+    [self writeWithRealm:realm name:@"[MXRealmAggregationsStore] deleteAllReactionRelationsInRoom" block:^{
         RLMResults<MXRealmReactionRelation *> *results = [MXRealmReactionRelation objectsInRealm:realm
                                                                                            where:@"roomId = %@", roomId];
         [realm deleteObjects:results];
@@ -228,7 +306,7 @@
 {
     RLMRealm *realm = self.realm;
 
-    [realm transactionWithName:@"[MXRealmAggregationsStore] deleteAll" block:^{
+    [self writeWithRealm:realm name:@"[MXRealmAggregationsStore] deleteAll" block:^{
         [realm deleteAllObjects];
     }];
 }
@@ -236,8 +314,39 @@
 
 #pragma mark - Private -
 
+/**
+ Run a write block in its own transaction, or in the current batch one.
+ */
+- (void)writeWithRealm:(RLMRealm*)realm name:(NSString*)name block:(void (^)(void))block
+{
+    if (realm.inWriteTransaction)
+    {
+        block();
+    }
+    else if (self.batchCount && self.batchThread == [NSThread currentThread])
+    {
+        // Group the mutations until the thread goes back to its run loop. The batch may then wait
+        // for asynchronous work, like decryption, without blocking the writers of other threads
+        [realm beginWriteTransaction];
+        self.batchRealm = realm;
+        [self performSelector:@selector(commitBatchTransaction) withObject:nil afterDelay:0 inModes:@[NSRunLoopCommonModes]];
+
+        block();
+    }
+    else
+    {
+        [realm transactionWithName:name block:block];
+    }
+}
+
 - (nullable RLMRealm*)realm
 {
+    // Realm instances are confined to their thread
+    if (self.batchRealm && self.batchThread == [NSThread currentThread])
+    {
+        return self.batchRealm;
+    }
+
     NSError *error;
     RLMRealm *realm = [RLMRealm realmWithConfiguration:self.realmConfiguration error:&error];
 
@@ -17,6 +17,9 @@
 import Foundation
 
 /// MXBeaconAggregations aggregates related beacon info events and beacon info events into a summary object MXBeaconInfoSummary
+///
+/// Beacons are coalesced per beacon info summary: only the latest one is stored and listeners are notified once
+/// at the end of a batch (a sync response or a pagination chunk), or at the next run loop iteration out of a batch.
 @objcMembers
 public class MXBeaconAggregations: NSObject {
     
@@ -24,6 +27,17 @@ public class MXBeaconAggregations: NSObject {
     
     private unowned let session: MXSession
     
+    /// Beacons waiting to be aggregated, by room id and beacon info summary id
+    private var pendingBeacons: [String: [String: [MXBeacon]]] = [:]
+    private var batchCount = 0
+    private var isFlushScheduled = false
+    
+    /// Location history by room id and beacon info summary id
+    private var beaconTracks: [String: [String: MXBeaconTrack]] = [:]
+    
+    /// Maximum number of beacons kept in the track of a beacon info summary. 0, the default, disables tracks.
+    public var maxBeaconTrackCount: Int = 0
+    
     private var perRoomListeners: [MXBeaconInfoSummaryPerRoomListener] = []
     private var perRoomDeletionListeners: [MXBeaconInfoSummaryDeletionPerRoomListener] = []
     
@@ -80,11 +94,37 @@ public class MXBeaconAggregations: NSObject {
         }
     }
     
+    /// Get the location history of a beacon info summary, if tracks are enabled with `maxBeaconTrackCount`.
+    public func beaconTrack(for beaconInfoSummaryId: String, inRoomWithId roomId: String) -> MXBeaconTrack? {
+        return self.beaconTracks[roomId]?[beaconInfoSummaryId]
+    }
+    
     public func clearData(inRoomWithId roomId: String) {
         // TODO: Notify data clear
+        self.pendingBeacons[roomId] = nil
+        self.beaconTracks[roomId] = nil
         self.beaconInfoSummaryStore.deleteAllBeaconInfoSummaries(inRoomWithId: roomId)
     }
     
+    // MARK: Batch
+    
+    /// Hold beacons until the matching `endBatch()`. Calls can be nested.
+    public func beginBatch() {
+        self.batchCount += 1
+    }
+    
+    /// Aggregate the beacons received since the outermost `beginBatch()`.
+    public func endBatch() {
+        guard self.batchCount > 0 else {
+            return
+        }
+        
+        self.batchCount -= 1
+        if self.batchCount == 0 {
+            self.flushPendingBeacons()
+        }
+    }
+    
     // MARK: Data update
     
     public func handleBeacon(event: MXEvent) {
@@ -99,14 +139,11 @@ public class MXBeaconAggregations: NSObject {
         guard let beacon = MXBeacon(mxEvent: event) else {
             return
         }
-                
-        guard let beaconInfoSummary = self.getBeaconInfoSummary(withIdentifier: beacon.beaconInfoEventId, inRoomWithId: roomId), self.canAddBeacon(beacon, to: beaconInfoSummary) else {
-            return
-        }
         
-        if beaconInfoSummary.updateWithLastBeacon(beacon) {
-            self.beaconInfoSummaryStore.addOrUpdateBeaconInfoSummary(beaconInfoSummary, inRoomWithId: roomId)
-            self.notifyBeaconInfoSummaryListeners(ofRoomWithId: roomId, beaconInfoSummary: beaconInfoSummary)
+        self.pendingBeacons[roomId, default: [:]][beacon.beaconInfoEventId, default: []].append(beacon)
+        
+        if self.batchCount == 0 {
+            self.scheduleFlush()
         }
     }
     
@@ -115,6 +152,9 @@ public class MXBeaconAggregations: NSObject {
             return
         }
         
+        // Beacons received before must be applied to the summary before it changes
+        self.flushPendingBeacons(inRoomWithId: roomId)
+        
         if event.isRedactedEvent() {
             self.handleRedactedBeaconInfo(with: event, roomId: roomId)
             return
@@ -138,6 +178,7 @@ public class MXBeaconAggregations: NSObject {
             
             // Delete beacon info summary
             self.beaconInfoSummaryStore.deleteBeaconInfoSummary(with: beaconInfoEventId, inRoomWithId: roomId)
+            self.beaconTracks[roomId]?[beaconInfoEventId] = nil
             
             // If the beacon info belongs to the current user
             if beaconInfoSummary.userId == session.myUserId {
@@ -241,6 +282,73 @@ public class MXBeaconAggregations: NSObject {
     
     // MARK: - Private
     
+    private func scheduleFlush() {
+        guard self.isFlushScheduled == false else {
+            return
+        }
+        
+        // Coalesce beacons received out of a batch in the same run loop iteration
+        self.isFlushScheduled = true
+        DispatchQueue.main.async { [weak self] in
+            guard let self = self else {
+                return
+            }
+            
+            self.isFlushScheduled = false
+            if self.batchCount == 0 {
+                self.flushPendingBeacons()
+            }
+        }
+    }
+    
+    private func flushPendingBeacons() {
+        for roomId in Array(self.pendingBeacons.keys) {
+            self.flushPendingBeacons(inRoomWithId: roomId)
+        }
+    }
+    
+    /// Store the latest valid beacon of each beacon info summary and notify each updated summary once.
+    private func flushPendingBeacons(inRoomWithId roomId: String) {
+        guard let beaconsBySummaryId = self.pendingBeacons.removeValue(forKey: roomId) else {
+            return
+        }
+        
+        for (beaconInfoSummaryId, beacons) in beaconsBySummaryId {
+            guard let beaconInfoSummary = self.getBeaconInfoSummary(withIdentifier: beaconInfoSummaryId, inRoomWithId: roomId) else {
+                continue
+            }
+            
+            let sortedBeacons = beacons.count > 1 ? beacons.sorted { $0.timestamp < $1.timestamp } : beacons
+            
+            var lastBeacon: MXBeacon?
+            for beacon in sortedBeacons where self.canAddBeacon(beacon, after: lastBeacon, to: beaconInfoSummary) {
+                lastBeacon = beacon
+                self.addToBeaconTrack(beacon, of: beaconInfoSummary, inRoomWithId: roomId)
+            }
+            
+            if let lastBeacon = lastBeacon, beaconInfoSummary.updateWithLastBeacon(lastBeacon) {
+                self.beaconInfoSummaryStore.addOrUpdateBeaconInfoSummary(beaconInfoSummary, inRoomWithId: roomId)
+                self.notifyBeaconInfoSummaryListeners(ofRoomWithId: roomId, beaconInfoSummary: beaconInfoSummary)
+            }
+        }
+    }
+    
+    private func addToBeaconTrack(_ beacon: MXBeacon, of beaconInfoSummary: MXBeaconInfoSummary, inRoomWithId roomId: String) {
+        guard self.maxBeaconTrackCount > 0 else {
+            return
+        }
+        
+        let beaconTrack: MXBeaconTrack
+        if let existingBeaconTrack = self.beaconTracks[roomId]?[beaconInfoSummary.id] {
+            beaconTrack = existingBeaconTrack
+        } else {
+            beaconTrack = MXBeaconTrack(maxBeaconCount: self.maxBeaconTrackCount)
+            self.beaconTracks[roomId, default: [:]][beaconInfoSummary.id] = beaconTrack
+        }
+        
+        beaconTrack.add(beacon)
+    }
+    
     private func addOrUpdateBeaconInfo(_ beaconInfo: MXBeaconInfo, inRoomWithId roomId: String) {
         
         guard let eventId = beaconInfo.originalEvent?.eventId else {
@@ -326,14 +434,15 @@ public class MXBeaconAggregations: NSObject {
         }
     }
     
-    private func canAddBeacon(_ beacon: MXBeacon, to beaconInfoSummary: MXBeaconInfoSummary) -> Bool {
+    /// - Parameter previousBeacon: the last beacon accepted in the current flush, not stored yet.
+    private func canAddBeacon(_ beacon: MXBeacon, after previousBeacon: MXBeacon?, to beaconInfoSummary: MXBeaconInfoSummary) -> Bool {
     
         guard beaconInfoSummary.hasStopped == false, beaconInfoSummary.hasExpired == false,
         beacon.timestamp < beaconInfoSummary.expiryTimestamp else {
             return false
         }
         
-        if let lastBeacon = beaconInfoSummary.lastBeacon, beacon.timestamp < lastBeacon.timestamp {
+        if let lastBeacon = previousBeacon ?? beaconInfoSummary.lastBeacon, beacon.timestamp < lastBeacon.timestamp {
             return false
         }
         
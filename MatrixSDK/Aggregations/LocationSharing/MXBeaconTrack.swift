@@ -0,0 +1,83 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import Foundation
+
+/// MXBeaconTrack is the bounded location history of a beacon info summary.
+///
+/// Successive beacons at the same location are merged into the latest one.
+/// When the track is full, the resolution of its older half is halved so that the whole sharing period stays covered.
+@objcMembers
+public final class MXBeaconTrack: NSObject {
+
+    // MARK: - Properties
+
+    /// Maximum number of beacons kept
+    public let maxBeaconCount: Int
+
+    /// Beacons of the track, oldest first
+    public private(set) var beacons: [MXBeacon] = []
+
+    // MARK: - Setup
+
+    public init(maxBeaconCount: Int) {
+        self.maxBeaconCount = max(2, maxBeaconCount)
+
+        super.init()
+    }
+
+    // MARK: - Internal
+
+    /// Add a beacon to the track.
+    /// - Parameter beacon: the beacon. Beacons older than the last one are ignored.
+    /// - Returns: true if the track changed.
+    @discardableResult
+    func add(_ beacon: MXBeacon) -> Bool {
+        if let lastBeacon = beacons.last {
+            guard beacon.timestamp >= lastBeacon.timestamp else {
+                return false
+            }
+
+            if beacon.location.latitude == lastBeacon.location.latitude
+                && beacon.location.longitude == lastBeacon.location.longitude {
+                beacons[beacons.count - 1] = beacon
+                return true
+            }
+        }
+
+        beacons.append(beacon)
+
+        if beacons.count > maxBeaconCount {
+            compact()
+        }
+        return true
+    }
+
+    // MARK: - Private
+
+    /// Drop every other beacon of the older half of the track. The first beacon is kept.
+    private func compact() {
+        let olderHalfCount = beacons.count / 2
+
+        var compactedBeacons = [MXBeacon]()
+        compactedBeacons.reserveCapacity(maxBeaconCount)
+        for (index, beacon) in beacons.enumerated() where index >= olderHalfCount || index % 2 == 0 {
+            compactedBeacons.append(beacon)
+        }
+
+        beacons = compactedBeacons
+    }
+}
@@ -56,6 +56,15 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (void)resetDataInRoom:(NSString *)roomId;
 
+#pragma mark - Batch
+/**
+ Hold reaction count change notifications until the matching `endBatch`.
+ Changes on the same event are then merged and listeners are notified once per room.
+ Changes due to local echoes are still notified immediately.
+ */
+- (void)beginBatch;
+- (void)endBatch;
+
 @end
 
 NS_ASSUME_NONNULL_END
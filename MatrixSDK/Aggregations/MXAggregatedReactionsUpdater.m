@@ -36,6 +36,10 @@
 @property (nonatomic) NSMutableDictionary<NSString* /* eventId */,
                                     NSMutableDictionary<NSString* /* reaction */, NSMutableArray<MXReactionOperation*>*>*> *reactionOperations;
 
+@property (nonatomic) NSUInteger batchCount;
+@property (nonatomic) NSMutableDictionary<NSString* /* roomId */,
+                                    NSMutableDictionary<NSString* /* eventId */, MXReactionCountChange*>*> *batchedChanges;
+
 @end
 
 @implementation MXAggregatedReactionsUpdater
@@ -52,6 +56,7 @@
 
         self.reactionOperations = [NSMutableDictionary dictionary];
         self.listeners = [NSMutableArray array];
+        self.batchedChanges = [NSMutableDictionary dictionary];
     }
     return self;
 }
@@ -263,6 +268,42 @@
     [self.store deleteAllReactionRelationsInRoom:roomId];
 }
 
+
+#pragma mark - Batch
+
+- (void)beginBatch
+{
+    self.batchCount++;
+}
+
+- (void)endBatch
+{
+    if (!self.batchCount || --self.batchCount)
+    {
+        return;
+    }
+
+    NSDictionary<NSString*, NSDictionary<NSString*, MXReactionCountChange*>*> *batchedChanges = self.batchedChanges;
+    self.batchedChanges = [NSMutableDictionary dictionary];
+
+    for (NSString *roomId in batchedChanges)
+    {
+        NSMutableDictionary<NSString*, MXReactionCountChange*> *changes = [NSMutableDictionary dictionary];
+        [batchedChanges[roomId] enumerateKeysAndObjectsUsingBlock:^(NSString *eventId, MXReactionCountChange *change, BOOL *stop) {
+            // Reactions added then removed in the same batch cancel each other out
+            if (change.inserted.count || change.modified.count || change.deleted.count)
+            {
+                changes[eventId] = change;
+            }
+        }];
+
+        if (changes.count)
+        {
+            [self notifyReactionCountChangeListenersOfRoom:roomId changes:changes];
+        }
+    }
+}
+
 #pragma mark - Private methods -
 
 - (void)storeRelationForReaction:(NSString*)reaction forEvent:(NSString*)eventId reactionEvent:(MXEvent *)reactionEvent
@@ -366,9 +407,7 @@
         reactionCountChange.modified = @[reactionCount];
     }
 
-    [self notifyReactionCountChangeListenersOfRoom:roomId changes:@{
-                                                                    eventId:reactionCountChange
-                                                                    }];
+    [self notifyOrBatchReactionCountChange:reactionCountChange ofRoom:roomId event:eventId];
 }
 
 - (void)notifyReactionCountChangeListenersOfRoom:(NSString*)roomId event:(NSString*)eventId forDeletedReaction:(NSString*)deletedReaction
@@ -376,9 +415,96 @@
     MXReactionCountChange *reactionCountChange = [MXReactionCountChange new];
     reactionCountChange.deleted = @[deletedReaction];
 
-    [self notifyReactionCountChangeListenersOfRoom:roomId changes:@{
-                                                                    eventId:reactionCountChange
-                                                                    }];
+    [self notifyOrBatchReactionCountChange:reactionCountChange ofRoom:roomId event:eventId];
+}
+
+- (void)notifyOrBatchReactionCountChange:(MXReactionCountChange*)reactionCountChange ofRoom:(NSString*)roomId event:(NSString*)eventId
+{
+    if (!self.batchCount)
+    {
+        [self notifyReactionCountChangeListenersOfRoom:roomId changes:@{
+                                                                        eventId:reactionCountChange
+                                                                        }];
+        return;
+    }
+
+    if (!self.batchedChanges[roomId])
+    {
+        self.batchedChanges[roomId] = [NSMutableDictionary dictionary];
+    }
+
+    MXReactionCountChange *batchedChange = self.batchedChanges[roomId][eventId];
+    self.batchedChanges[roomId][eventId] = batchedChange ? [self mergeReactionCountChange:reactionCountChange intoChange:batchedChange] : reactionCountChange;
+}
+
+/**
+ Merge two successive changes on the reaction counts of an event.
+
+ @param change the most recent change.
+ @param previousChange the change done before.
+ @return a change that has the same effect as both changes.
+ */
+- (MXReactionCountChange*)mergeReactionCountChange:(MXReactionCountChange*)change intoChange:(MXReactionCountChange*)previousChange
+{
+    NSMutableDictionary<NSString*, MXReactionCount*> *inserted = [NSMutableDictionary dictionary];
+    NSMutableDictionary<NSString*, MXReactionCount*> *modified = [NSMutableDictionary dictionary];
+    NSMutableOrderedSet<NSString*> *deleted = [NSMutableOrderedSet orderedSetWithArray:previousChange.deleted ?: @[]];
+
+    for (MXReactionCount *reactionCount in previousChange.inserted)
+    {
+        inserted[reactionCount.reaction] = reactionCount;
+    }
+    for (MXReactionCount *reactionCount in previousChange.modified)
+    {
+        modified[reactionCount.reaction] = reactionCount;
+    }
+
+    for (MXReactionCount *reactionCount in change.inserted)
+    {
+        if ([deleted containsObject:reactionCount.reaction])
+        {
+            // The reaction existed before the batch
+            [deleted removeObject:reactionCount.reaction];
+            modified[reactionCount.reaction] = reactionCount;
+        }
+        else
+        {
+            inserted[reactionCount.reaction] = reactionCount;
+        }
+    }
+
+    for (MXReactionCount *reactionCount in change.modified)
+    {
+        if (inserted[reactionCount.reaction])
+        {
+            inserted[reactionCount.reaction] = reactionCount;
+        }
+        else
+        {
+            modified[reactionCount.reaction] = reactionCount;
+        }
+    }
+
+    for (NSString *reaction in change.deleted)
+    {
+        if (inserted[reaction])
+        {
+            // The reaction did not exist before the batch
+            [inserted removeObjectForKey:reaction];
+        }
+        else
+        {
+            [modified removeObjectForKey:reaction];
+            [deleted addObject:reaction];
+        }
+    }
+
+    MXReactionCountChange *mergedChange = [MXReactionCountChange new];
+    mergedChange.inserted = inserted.count ? [self sortReactionCounts:inserted.allValues] : nil;
+    mergedChange.modified = modified.count ? [self sortReactionCounts:modified.allValues] : nil;
+    mergedChange.deleted = deleted.count ? deleted.array : nil;
+
+    return mergedChange;
 }
 
 - (void)notifyReactionCountChangeListenersOfRoom:(NSString*)roomId changes:(NSDictionary<NSString*, MXReactionCountChange*>*)changes
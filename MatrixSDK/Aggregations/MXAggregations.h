@@ -27,6 +27,7 @@
 NS_ASSUME_NONNULL_BEGIN
 
 @class MXBeaconAggregations;
+@class MXPollTallyStore;
 
 /**
  The `MXAggregations` class instance manages the Matrix aggregations API.
@@ -35,6 +36,11 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, strong, readonly) MXBeaconAggregations *beaconAggregations;
 
+/**
+ The snapshots of the poll tallies. They are kept up to date with live poll events.
+ */
+@property (nonatomic, strong, readonly) MXPollTallyStore *pollTallyStore;
+
 #pragma mark - Reactions
 
 /**
@@ -41,8 +41,11 @@
 @property (nonatomic) MXAggregatedPollsUpdater *aggregatedPollsUpdater;
 
 @property (nonatomic, strong, readwrite) MXBeaconAggregations *beaconAggregations;
+@property (nonatomic, strong, readwrite) MXPollTallyStore *pollTallyStore;
 @property (nonatomic, strong) id<MXBeaconInfoSummaryStoreProtocol> beaconInfoSummaryStore;
 
+@property (nonatomic) NSUInteger batchCount;
+
 @end
 
 
@@ -232,6 +235,7 @@
     MXLogDebug(@"[MXAggregations] Reset data")
     [self.store deleteAll];
     [self.beaconInfoSummaryStore deleteAllBeaconInfoSummaries];
+    [self.pollTallyStore removeAllSnapshots];
 }
 
 
@@ -253,6 +257,7 @@
                                                                                            matrixStore:mxSession.store];
         self.aggregatedPollsUpdater = [[MXAggregatedPollsUpdater alloc] initWithSession:self.mxSession
                                                                                   store:self.mxSession.store];
+        self.pollTallyStore = [[MXPollTallyStore alloc] initWithUserId:mxSession.matrixRestClient.credentials.userId ?: @""];
         
         id<MXBeaconInfoSummaryStoreProtocol> beaconInfoSummaryStore = [[MXBeaconInfoSummaryRealmStore alloc] initWithSession:self.mxSession];
         
@@ -279,6 +284,37 @@
 {
     [self.aggregatedReactionsUpdater resetDataInRoom:roomId];
     [self.beaconAggregations clearDataInRoomWithId:roomId];
+    [self.pollTallyStore removeSnapshotsInRoom:roomId];
+}
+
+- (void)beginBatch
+{
+    if (self.batchCount++ == 0)
+    {
+        [self.store beginBatch];
+        [self.aggregatedReactionsUpdater beginBatch];
+        [self.beaconAggregations beginBatch];
+    }
+}
+
+- (void)endBatch
+{
+    if (!self.batchCount)
+    {
+        MXLogError(@"[MXAggregations] endBatch: No batch in progress");
+        return;
+    }
+
+    if (--self.batchCount == 0)
+    {
+        // Notify listeners once data is committed
+        [self.store commitBatch];
+        [self.aggregatedReactionsUpdater endBatch];
+        [self.beaconAggregations endBatch];
+
+        // The batch ends before the session store commits the events. Poll snapshots must not be older
+        [self.pollTallyStore writePendingSnapshots];
+    }
 }
 
 
@@ -306,6 +342,15 @@
                     [self.aggregatedReactionsUpdater handleRedaction:event];
                 }
                 break;
+            case MXEventTypePollResponse:
+            case MXEventTypePollEnd:
+            case MXEventTypeRoomEncrypted:
+                // Undecryptable events may be votes. The store keeps track of them until they are decrypted
+                if (direction == MXTimelineDirectionForwards)
+                {
+                    [self.pollTallyStore handlePollEvent:event];
+                }
+                break;
             case MXEventTypeBeaconInfo:
                 [self.beaconAggregations handleBeaconInfoWithEvent:event];
                 break;
@@ -50,6 +50,16 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)resetDataInRoom:(NSString *)roomId;
 
+/**
+ Group the aggregation updates of a sync response or of a pagination chunk.
+
+ Store mutations of a same run loop iteration are written in a single transaction. Reaction count listeners
+ are notified once, with merged changes, and beacons are aggregated by the outermost `endBatch`.
+ Calls can be nested and must be balanced.
+ */
+- (void)beginBatch;
+- (void)endBatch;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -39,7 +39,7 @@ class MXBackgroundCryptoV2: MXBackgroundCrypto {
         let syncId = UUID().uuidString
         let details = """
         Handling new sync response `\(syncId)`
-          - to-device events : \(syncResponse.toDevice?.events.count ?? 0)
+          - to-device events : \(syncResponse.toDevice?.eventsCount ?? 0)
           - devices changed  : \(syncResponse.deviceLists?.changed?.count ?? 0)
           - devices left     : \(syncResponse.deviceLists?.left?.count ?? 0)
           - one time keys    : \(syncResponse.deviceOneTimeKeysCount?[kMXKeySignedCurve25519Type] ?? 0)
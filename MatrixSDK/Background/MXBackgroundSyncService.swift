@@ -394,7 +394,7 @@ public enum MXBackgroundSyncServiceError: Error {
                     
                     if let event = self.syncResponseStoreManager.event(withEventId: eventId, inRoom: roomId),
                        !self.crypto.canDecryptEvent(event),
-                       (syncResponse.toDevice?.events ?? []).count > 0 {
+                       (syncResponse.toDevice?.eventsCount ?? 0) > 0 {
                         //  we got the event but not the keys to decrypt it. continue to sync
                         self.launchBackgroundSync(forEventId: eventId, roomId: roomId, completion: completion)
                     } else {
@@ -424,7 +424,7 @@ public enum MXBackgroundSyncServiceError: Error {
             Received \(syncResponse.rooms?.join?.count ?? 0) joined rooms, \
             \(syncResponse.rooms?.invite?.count ?? 0) invited rooms, \
             \(syncResponse.rooms?.leave?.count ?? 0) left rooms, \
-            \(syncResponse.toDevice?.events.count ?? 0) toDevice events.
+            \(syncResponse.toDevice?.eventsCount ?? 0) toDevice events.
             """)
         
         if let accountData = syncResponse.accountData {
@@ -21,7 +21,7 @@ import MatrixSDKCrypto
 protocol MXRoomEventDecrypting: Actor {
     
     /// Decrypt a list of events
-    func decrypt(events: [MXEvent]) -> [MXEventDecryptionResult]
+    func decrypt(events: [MXEvent]) async -> [MXEventDecryptionResult]
     
     /// Process an event that may contain room key and retry decryption if it does
     ///
@@ -44,16 +44,28 @@ actor MXRoomEventDecryption: MXRoomEventDecrypting {
         
     private let handler: MXCryptoRoomEventDecrypting
     private var undecryptedEvents: [SessionId: [EventId: MXEvent]]
+    /// Number of times a room key has been received for a session.
+    /// It tells whether a key arrived while events of that session were decrypted outside of the actor.
+    private var roomKeyGenerations: [SessionId: UInt]
     private let log = MXNamedLog(name: "MXRoomEventDecryption")
     
     init(handler: MXCryptoRoomEventDecrypting) {
         self.handler = handler
         self.undecryptedEvents = [:]
+        self.roomKeyGenerations = [:]
     }
     
-    func decrypt(events: [MXEvent]) -> [MXEventDecryptionResult] {
+    /// Events are decrypted outside of the actor so that several batches, for example
+    /// from different rooms, are decrypted in parallel. Only the tracking of undecryptable
+    /// events is serialised.
+    ///
+    /// A room key may arrive between a failed decryption and the tracking of the event.
+    /// Such events are decrypted again in the actor, before they are tracked.
+    nonisolated func decrypt(events: [MXEvent]) async -> [MXEventDecryptionResult] {
         log.debug("Decrypting \(events.count) event(s)")
-        let results = events.map(decrypt(event:))
+        let generations = await currentRoomKeyGenerations(for: events)
+        let outcomes = events.map(decryptionOutcome(for:))
+        let results = await results(for: events, outcomes: outcomes, generations: generations)
         
         let undecrypted = results.filter {
             $0.clearEvent == nil || $0.error != nil
@@ -74,11 +86,15 @@ actor MXRoomEventDecryption: MXRoomEventDecrypting {
         }
         
         log.debug("Received a new room key as `\(event.type ?? "")` for session \(sessionId)")
+        roomKeyGenerations[sessionId, default: 0] += 1
         let events = undecryptedEvents[sessionId]?.map(\.value) ?? []
         retryDecryption(events: events)
     }
     
     func retryUndecryptedEvents(sessionIds: [String]) {
+        for sessionId in sessionIds {
+            roomKeyGenerations[sessionId, default: 0] += 1
+        }
         let events = sessionIds
             .flatMap {
                 undecryptedEvents[$0]?.map {
@@ -90,16 +106,60 @@ actor MXRoomEventDecryption: MXRoomEventDecrypting {
     
     func resetUndecryptedEvents() {
         undecryptedEvents = [:]
+        roomKeyGenerations = [:]
     }
     
     // MARK: - Private
     
     private func decrypt(event: MXEvent) -> MXEventDecryptionResult {
-        let eventId = event.eventId ?? "unknown"
-        
+        return result(for: event, outcome: decryptionOutcome(for: event))
+    }
+    
+    /// The room key generations of the sessions of the events to decrypt
+    private func currentRoomKeyGenerations(for events: [MXEvent]) -> [SessionId: UInt] {
+        var generations = [SessionId: UInt]()
+        for event in events where event.isEncrypted && event.clear == nil {
+            if let sessionId = sessionId(for: event) {
+                generations[sessionId] = roomKeyGenerations[sessionId] ?? 0
+            }
+        }
+        return generations
+    }
+    
+    private func results(for events: [MXEvent], outcomes: [Result<DecryptedEvent, Error>?], generations: [SessionId: UInt]) -> [MXEventDecryptionResult] {
+        return zip(events, outcomes).map { event, outcome in
+            if case .failure? = outcome,
+               let sessionId = sessionId(for: event),
+               (roomKeyGenerations[sessionId] ?? 0) != (generations[sessionId] ?? 0) {
+                log.debug("Received a room key for session \(sessionId) during decryption. Decrypting `\(event.eventId ?? "unknown")` again")
+                return decrypt(event: event)
+            }
+            return result(for: event, outcome: outcome)
+        }
+    }
+    
+    /// Decrypt an event with the handler. This does not access the state of the actor.
+    ///
+    /// - Returns: nil if the event cannot be decrypted as a megolm room event.
+    nonisolated private func decryptionOutcome(for event: MXEvent) -> Result<DecryptedEvent, Error>? {
         guard
             event.isEncrypted && event.clear == nil,
             event.content?["algorithm"] as? String == kMXCryptoMegolmAlgorithm,
+            sessionId(for: event) != nil
+        else {
+            return nil
+        }
+        
+        return Result {
+            try handler.decryptRoomEvent(event)
+        }
+    }
+    
+    private func result(for event: MXEvent, outcome: Result<DecryptedEvent, Error>?) -> MXEventDecryptionResult {
+        let eventId = event.eventId ?? "unknown"
+        
+        guard
+            let outcome = outcome,
             let sessionId = sessionId(for: event)
         else {
             if !event.isEncrypted {
@@ -114,7 +174,7 @@ actor MXRoomEventDecryption: MXRoomEventDecrypting {
         }
         
         do {
-            let decryptedEvent = try handler.decryptRoomEvent(event)
+            let decryptedEvent = try outcome.get()
             let result = try MXEventDecryptionResult(event: decryptedEvent)
             log.debug("Decrypted event `\(result.clearEvent["type"] ?? "unknown")` eventId `\(eventId)`")
             return result
@@ -190,7 +250,7 @@ actor MXRoomEventDecryption: MXRoomEventDecrypting {
         }
     }
     
-    private func sessionId(for event: MXEvent) -> String? {
+    nonisolated private func sessionId(for event: MXEvent) -> String? {
         let sessionId = event.content["session_id"] ?? event.wireContent["session_id"]
         guard let sessionId = sessionId as? String else {
             log.failure("Event is missing session id")
@@ -190,6 +190,7 @@ extension MXCryptoMachine: MXCryptoSyncing {
         unusedFallbackKeys: [String]?,
         nextBatchToken: String
     ) throws -> MXToDeviceSyncResponse {
+        // Received events are serialised as they came from the sync response, without decoding them
         let events = toDevice?.jsonString() ?? "[]"
         let deviceChanges = DeviceLists(
             changed: deviceLists?.changed ?? [],
@@ -205,26 +206,8 @@ extension MXCryptoMachine: MXCryptoSyncing {
             nextBatchToken: nextBatchToken
         )
         
-        var deserialisedToDeviceEvents = [Any]()
-        for toDeviceEvent in result.toDeviceEvents {
-            guard let deserialisedToDeviceEvent = MXTools.deserialiseJSONString(toDeviceEvent) else {
-                log.failure("Failed deserialising to device event", context: [
-                    "result": result
-                ])
-                return MXToDeviceSyncResponse()
-            }
-            
-            deserialisedToDeviceEvents.append(deserialisedToDeviceEvent)
-        }
-        
-        guard let toDeviceSyncResponse = MXToDeviceSyncResponse(fromJSON: ["events": deserialisedToDeviceEvents]) else {
-            log.failure("Result cannot be serialized", context: [
-                "result": result
-            ])
-            return MXToDeviceSyncResponse()
-        }
-        
-        return toDeviceSyncResponse
+        // Returned events are decoded only when they are accessed
+        return MXToDeviceSyncResponse.model(withEventJSONStrings: result.toDeviceEvents)
     }
     
     func downloadKeysIfNecessary(users: [String]) async throws {
@@ -325,7 +325,7 @@ class MXCryptoV2: NSObject, MXCrypto {
         let syncId = UUID().uuidString
         let details = """
         Handling new sync response `\(syncId)`
-          - to-device events : \(syncResponse.toDevice?.events.count ?? 0)
+          - to-device events : \(syncResponse.toDevice?.eventsCount ?? 0)
           - devices changed  : \(syncResponse.deviceLists?.changed?.count ?? 0)
           - devices left     : \(syncResponse.deviceLists?.left?.count ?? 0)
           - one time keys    : \(syncResponse.deviceOneTimeKeysCount?[kMXKeySignedCurve25519Type] ?? 0)
@@ -342,7 +342,7 @@ class MXCryptoV2: NSObject, MXCrypto {
                     unusedFallbackKeys: syncResponse.unusedFallbackKeys,
                     nextBatchToken: syncResponse.nextBatch
                 )
-                await handle(toDeviceEvents: toDevice.events)
+                await handle(toDeviceEvents: toDevice.events(ofTypes: Self.consumedToDeviceEventTypes))
             } catch {
                 log.error("Cannot handle sync", context: error)
             }
@@ -360,6 +360,13 @@ class MXCryptoV2: NSObject, MXCrypto {
         }
     }
     
+    /// Types of the to-device events processed by the machine that require client side updates
+    private static let consumedToDeviceEventTypes: Set<String> = MXKeyVerificationManagerV2.toDeviceEventTypes.union([
+        kMXEventTypeStringSecretSend,
+        kMXEventTypeStringRoomKey,
+        kMXEventTypeStringRoomForwardedKey
+    ])
+    
     private func handle(toDeviceEvents: [MXEvent]) async {
         // Some of the to-device events processed by the machine require further updates
         // on the client side, not currently exposed through any convenient api.
@@ -16,32 +16,227 @@
 
 #import "MXCryptoTools.h"
 
-#import "NSObject+sortedKeys.h"
+#import "MXLog.h"
 
-@implementation MXCryptoTools
+// Canonical JSON numbers must be integers in the [-(2^53)+1, (2^53)-1] range
+static int64_t const kMXCryptoToolsCanonicalJSONMaxInteger = 9007199254740991;
 
-+ (nullable NSString *)canonicalJSONStringForJSON:(NSDictionary *)JSONDictinary
+static BOOL MXCryptoToolsAppendCanonicalJSON(NSMutableData *data, id object);
+
+static void MXCryptoToolsAppendCanonicalJSONString(NSMutableData *data, NSString *string)
+{
+    NSUInteger maxLength = [string maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+
+    char stackBuffer[256];
+    char *buffer = maxLength <= sizeof(stackBuffer) ? stackBuffer : malloc(maxLength);
+
+    NSUInteger length = 0;
+    [string getBytes:buffer maxLength:maxLength usedLength:&length encoding:NSUTF8StringEncoding options:NSStringEncodingConversionAllowLossy range:NSMakeRange(0, string.length) remainingRange:NULL];
+
+    [data appendBytes:"\"" length:1];
+
+    // Only '"', '\\' and control characters are escaped. Copy other bytes by runs
+    NSUInteger runStart = 0;
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        unsigned char c = (unsigned char)buffer[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+
+        [data appendBytes:buffer + runStart length:i - runStart];
+        runStart = i + 1;
+
+        switch (c)
+        {
+            case '"':  [data appendBytes:"\\\"" length:2]; break;
+            case '\\': [data appendBytes:"\\\\" length:2]; break;
+            case '\b': [data appendBytes:"\\b" length:2]; break;
+            case '\f': [data appendBytes:"\\f" length:2]; break;
+            case '\n': [data appendBytes:"\\n" length:2]; break;
+            case '\r': [data appendBytes:"\\r" length:2]; break;
+            case '\t': [data appendBytes:"\\t" length:2]; break;
+            default:
+            {
+                char escape[7];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                [data appendBytes:escape length:6];
+                break;
+            }
+        }
+    }
+    [data appendBytes:buffer + runStart length:length - runStart];
+
+    [data appendBytes:"\"" length:1];
+
+    if (buffer != stackBuffer)
+    {
+        free(buffer);
+    }
+}
+
+static BOOL MXCryptoToolsAppendCanonicalJSONNumber(NSMutableData *data, NSNumber *number)
+{
+    if (CFGetTypeID((__bridge CFTypeRef)number) == CFBooleanGetTypeID())
+    {
+        if (number.boolValue)
+        {
+            [data appendBytes:"true" length:4];
+        }
+        else
+        {
+            [data appendBytes:"false" length:5];
+        }
+        return YES;
+    }
+
+    char buffer[32];
+    int length;
+    if (CFNumberIsFloatType((__bridge CFNumberRef)number))
+    {
+        double value = number.doubleValue;
+        if (isnan(value) || isinf(value))
+        {
+            MXLogError(@"[MXCryptoTools] canonicalJSON: Invalid number");
+            return NO;
+        }
+        if (value != floor(value) || fabs(value) > kMXCryptoToolsCanonicalJSONMaxInteger)
+        {
+            // Canonical JSON does not support them. Keep the Foundation representation
+            NSData *numberData = [NSJSONSerialization dataWithJSONObject:@[number] options:0 error:nil];
+            if (numberData.length < 2)
+            {
+                return NO;
+            }
+            [data appendBytes:(const char *)numberData.bytes + 1 length:numberData.length - 2];
+            return YES;
+        }
+        length = snprintf(buffer, sizeof(buffer), "%lld", (long long)value);
+    }
+    else if (strcmp(number.objCType, @encode(unsigned long long)) == 0)
+    {
+        length = snprintf(buffer, sizeof(buffer), "%llu", number.unsignedLongLongValue);
+    }
+    else
+    {
+        length = snprintf(buffer, sizeof(buffer), "%lld", number.longLongValue);
+    }
+
+    [data appendBytes:buffer length:length];
+    return YES;
+}
+
+static BOOL MXCryptoToolsAppendCanonicalJSONDictionary(NSMutableData *data, NSDictionary *dictionary)
 {
-    NSString *unescapedCanonicalJSON;
+    // Keys are sorted by code points, which is the order of their UTF-8 bytes
+    NSMutableArray<NSString*> *keys = [NSMutableArray arrayWithCapacity:dictionary.count];
+    for (id key in dictionary)
+    {
+        if (![key isKindOfClass:NSString.class])
+        {
+            return NO;
+        }
+        [keys addObject:key];
+    }
+    [keys sortUsingComparator:^NSComparisonResult(NSString *key1, NSString *key2) {
+        const char *utf8Key1 = key1.UTF8String, *utf8Key2 = key2.UTF8String;
+        int result = strcmp(utf8Key1 ?: "", utf8Key2 ?: "");
+        return result < 0 ? NSOrderedAscending : (result > 0 ? NSOrderedDescending : NSOrderedSame);
+    }];
 
-    NSData *canonicalJSONData = [NSJSONSerialization dataWithJSONObject:[JSONDictinary objectWithSortedKeys] options:0 error:nil];
+    [data appendBytes:"{" length:1];
+    BOOL first = YES;
+    for (NSString *key in keys)
+    {
+        if (!first)
+        {
+            [data appendBytes:"," length:1];
+        }
+        first = NO;
 
-    // NSJSONSerialization escapes the '/' character in base64 strings which is useless in our case
-    // and does not match with other platforms.
-    // Remove this escaping
+        MXCryptoToolsAppendCanonicalJSONString(data, key);
+        [data appendBytes:":" length:1];
+        if (!MXCryptoToolsAppendCanonicalJSON(data, dictionary[key]))
+        {
+            return NO;
+        }
+    }
+    [data appendBytes:"}" length:1];
+    return YES;
+}
 
-    if (canonicalJSONData)
+static BOOL MXCryptoToolsAppendCanonicalJSON(NSMutableData *data, id object)
+{
+    if ([object isKindOfClass:NSString.class])
+    {
+        MXCryptoToolsAppendCanonicalJSONString(data, object);
+    }
+    else if ([object isKindOfClass:NSDictionary.class])
+    {
+        return MXCryptoToolsAppendCanonicalJSONDictionary(data, object);
+    }
+    else if ([object isKindOfClass:NSArray.class])
+    {
+        [data appendBytes:"[" length:1];
+        BOOL first = YES;
+        for (id item in (NSArray*)object)
+        {
+            if (!first)
+            {
+                [data appendBytes:"," length:1];
+            }
+            first = NO;
+
+            if (!MXCryptoToolsAppendCanonicalJSON(data, item))
+            {
+                return NO;
+            }
+        }
+        [data appendBytes:"]" length:1];
+    }
+    else if ([object isKindOfClass:NSNumber.class])
+    {
+        return MXCryptoToolsAppendCanonicalJSONNumber(data, object);
+    }
+    else if ([object isKindOfClass:NSNull.class])
+    {
+        [data appendBytes:"null" length:4];
+    }
+    else
     {
-        unescapedCanonicalJSON = [[NSString alloc] initWithData:canonicalJSONData encoding:NSUTF8StringEncoding];
-        unescapedCanonicalJSON = [unescapedCanonicalJSON stringByReplacingOccurrencesOfString:@"\\/" withString:@"/"];
+        MXLogError(@"[MXCryptoTools] canonicalJSON: Unsupported object type: %@", NSStringFromClass([object class]));
+        return NO;
     }
+    return YES;
+}
 
-    return unescapedCanonicalJSON;
+@implementation MXCryptoTools
+
++ (nullable NSString *)canonicalJSONStringForJSON:(NSDictionary *)JSONDictinary
+{
+    NSData *canonicalJSONData = [self canonicalJSONDataForJSON:JSONDictinary];
+    if (!canonicalJSONData)
+    {
+        return nil;
+    }
+    return [[NSString alloc] initWithData:canonicalJSONData encoding:NSUTF8StringEncoding];
 }
 
 + (nullable NSData *)canonicalJSONDataForJSON:(NSDictionary *)JSONDictinary
 {
-    return [[self canonicalJSONStringForJSON:JSONDictinary] dataUsingEncoding:NSUTF8StringEncoding];
+    if (![JSONDictinary isKindOfClass:NSDictionary.class])
+    {
+        return nil;
+    }
+
+    // The canonical JSON is written directly in UTF-8, with sorted keys and without whitespaces
+    NSMutableData *data = [NSMutableData dataWithCapacity:256];
+    if (!MXCryptoToolsAppendCanonicalJSONDictionary(data, JSONDictinary))
+    {
+        return nil;
+    }
+    return data;
 }
 
 @end
@@ -35,6 +35,9 @@ typedef enum : NSUInteger
     MXMegolmExportErrorCannotDecryptCode,
     MXMegolmExportErrorCannotEncryptCode,
     MXMegolmExportErrorCannotDeriveKeysCode,
+    MXMegolmExportErrorStreamFailureCode,
+    MXMegolmExportErrorInvalidSessionsCode,
+    MXMegolmExportErrorCancelledCode,
 
 } MXMegolmExportErrorCode;
 
@@ -63,6 +66,72 @@ typedef enum : NSUInteger
  */
 + (NSData*)encryptMegolmKeyFile:(NSData*)data withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds error:(NSError**)error;
 
+/**
+ Decrypt a megolm key file from a stream.
+
+ The content is decrypted chunk by chunk so that memory usage does not depend on the file size.
+ As the file is authenticated by a trailing HMAC, it can only be checked at the end: if the
+ method fails, the data already written to `outputStream` must be discarded.
+
+ Streams that are not open are opened and closed by this method.
+
+ @param inputStream the key file stream.
+ @param outputStream the stream to write the decrypted content to.
+ @param password the password.
+ @param error the output error.
+ @return YES on success.
+ */
++ (BOOL)decryptMegolmKeyStream:(NSInputStream*)inputStream toStream:(NSOutputStream*)outputStream withPassword:(NSString*)password error:(NSError**)error;
+
+/**
+ Encrypt a megolm key file from a stream.
+
+ The content is encrypted, authenticated and armoured chunk by chunk so that memory usage
+ does not depend on its size.
+
+ Streams that are not open are opened and closed by this method.
+
+ @param inputStream the stream of data to encrypt.
+ @param outputStream the stream to write the key file to.
+ @param password the password.
+ @param kdfRounds Number of iterations to perform of the key-derivation function.
+                  If 0, 500000 is used as default value.
+ @param error the output error.
+ @return YES on success.
+ */
++ (BOOL)encryptMegolmKeyStream:(NSInputStream*)inputStream toStream:(NSOutputStream*)outputStream withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds error:(NSError**)error;
+
+/**
+ Encrypt megolm sessions into a key file.
+
+ Sessions are serialised to JSON and encrypted one at a time. Pass an enumerator that
+ builds sessions on demand to keep memory usage constant regardless of the number of keys.
+
+ @param sessions the sessions to export, as JSON dictionaries.
+ @param outputStream the stream to write the key file to.
+ @param password the password.
+ @param kdfRounds Number of iterations to perform of the key-derivation function.
+                  If 0, 500000 is used as default value.
+ @param error the output error.
+ @return YES on success.
+ */
++ (BOOL)encryptMegolmSessions:(id<NSFastEnumeration>)sessions toStream:(NSOutputStream*)outputStream withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds error:(NSError**)error;
+
+/**
+ Decrypt the megolm sessions of a key file.
+
+ The file is read twice: once to check its authenticity, then to decrypt and parse sessions
+ one at a time. Sessions are never handed out from a file that fails authentication.
+
+ @param fileURL the URL of the key file.
+ @param password the password.
+ @param sessionBlock the block called with each session, as a JSON dictionary.
+ @param error the output error.
+ @return YES on success.
+ */
++ (BOOL)decryptMegolmKeyFileAtURL:(NSURL*)fileURL withPassword:(NSString*)password sessionBlock:(void (^)(NSDictionary *session))sessionBlock error:(NSError**)error;
+
+
 /**
  Check that a file starts like a megolm key file.
  
@@ -71,4 +140,46 @@ typedef enum : NSUInteger
  */
 + (BOOL)isMegolmKeyFile:(NSURL*)fileURL;
 
+#pragma mark - Asynchronous operations
+
+/**
+ Encrypt megolm sessions into a key file, off the calling thread.
+
+ Keys derivation and encryption run on a background queue. The returned progress reports
+ both of them. Cancelling it stops the operation with a `MXMegolmExportErrorCancelledCode` error.
+
+ @param sessions the sessions to export, as JSON dictionaries. They are enumerated on the background queue.
+ @param fileURL the URL of the key file to write. The file is removed if the operation fails.
+ @param password the password.
+ @param kdfRounds Number of iterations to perform of the key-derivation function.
+                  If 0, 500000 is used as default value. See `kdfRoundsForDuration:`.
+ @param success A block object called on the main queue when the operation succeeds.
+ @param failure A block object called on the main queue when the operation fails.
+ @return the progress of the operation.
+ */
++ (NSProgress*)encryptMegolmSessions:(id<NSFastEnumeration>)sessions toFileAtURL:(NSURL*)fileURL withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds success:(void (^)(void))success failure:(void (^)(NSError *error))failure;
+
+/**
+ Decrypt the megolm sessions of a key file, off the calling thread.
+
+ Keys derivation, authentication and decryption run on a background queue. The returned progress
+ reports all of them. Cancelling it stops the operation with a `MXMegolmExportErrorCancelledCode` error.
+
+ @param fileURL the URL of the key file.
+ @param password the password.
+ @param sessionBlock the block called on the background queue with each session, as a JSON dictionary.
+ @param success A block object called on the main queue when the operation succeeds.
+ @param failure A block object called on the main queue when the operation fails.
+ @return the progress of the operation.
+ */
++ (NSProgress*)decryptMegolmKeyFileAtURL:(NSURL*)fileURL withPassword:(NSString*)password sessionBlock:(void (^)(NSDictionary *session))sessionBlock success:(void (^)(void))success failure:(void (^)(NSError *error))failure;
+
+/**
+ The number of key-derivation iterations that takes a given duration on this device.
+
+ @param duration the target duration of the key derivation.
+ @return the number of iterations. It is never lower than 100000.
+ */
++ (NSUInteger)kdfRoundsForDuration:(NSTimeInterval)duration;
+
 @end
@@ -19,458 +19,1395 @@
 #import <Security/Security.h>
 #import <CommonCrypto/CommonDigest.h>
 #import <CommonCrypto/CommonCryptor.h>
+#import <CommonCrypto/CommonHMAC.h>
 #import <CommonCrypto/CommonKeyDerivation.h>
 
 #import "MXLog.h"
+#import "MXBase64Tools.h"
 
 NSString *const MXMegolmExportEncryptionErrorDomain = @"org.matrix.sdk.megolm.export";
 
 NSString *const MXMegolmExportEncryptionHeaderLine = @"-----BEGIN MEGOLM SESSION DATA-----";
 NSString *const MXMegolmExportEncryptionTrailerLine = @"-----END MEGOLM SESSION DATA-----";
 
+/**
+ Size of the chunks read from input streams.
+ */
+static NSUInteger const kMXMegolmExportStreamChunkSize = 32 * 1024;
+
+/**
+ Number of raw bytes per armored line: 72 * 4 / 3, i.e. 128 base64 characters.
+ */
+#define kMXMegolmExportLineLength 96
+
+/**
+ Length of the body header: version, salt, iv and kdf rounds.
+ */
+#define kMXMegolmExportBodyHeaderLength (1 + 16 + 16 + 4)
+
+/**
+ Length of the HMAC-SHA-256 at the end of the body.
+ */
+#define kMXMegolmExportHMACLength CC_SHA256_DIGEST_LENGTH
+
+static NSUInteger const kMXMegolmExportDefaultKdfRounds = 500000;
+
+/**
+ Lower bound of calibrated kdf rounds, whatever the device speed.
+ */
+static NSUInteger const kMXMegolmExportMinimumKdfRounds = 100000;
+
+/**
+ Number of kdf rounds between two progress updates and cancellation checks.
+ */
+static NSUInteger const kMXMegolmExportKdfRoundsPerProgressUpdate = 10000;
+
+/**
+ Share of the keys derivation and of the payload in the progress of asynchronous operations.
+ */
+static int64_t const kMXMegolmExportKdfProgressUnitCount = 50;
+static int64_t const kMXMegolmExportPayloadProgressUnitCount = 50;
+
+
+#pragma mark - Helpers
+
+static NSError *MXMegolmExportError(MXMegolmExportErrorCode code, NSString *description)
+{
+    return [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
+                               code:code
+                           userInfo:@{
+                                      NSLocalizedDescriptionKey: description,
+                                      }];
+}
+
+static NSError *MXMegolmExportCancelledError(void)
+{
+    return MXMegolmExportError(MXMegolmExportErrorCancelledCode, @"Cancelled");
+}
+
+static void MXMegolmExportSetError(NSError *__autoreleasing *error, NSError *value)
+{
+    if (error)
+    {
+        *error = value;
+    }
+}
+
+static BOOL MXMegolmExportWrite(NSOutputStream *outputStream, const uint8_t *bytes, NSUInteger length, NSError *__autoreleasing *error)
+{
+    while (length)
+    {
+        NSInteger written = [outputStream write:bytes maxLength:length];
+        if (written <= 0)
+        {
+            MXMegolmExportSetError(error, outputStream.streamError ?: MXMegolmExportError(MXMegolmExportErrorStreamFailureCode, @"Cannot write to the output stream"));
+            return NO;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return YES;
+}
+
+/**
+ PBKDF2-HMAC-SHA-512 for a 64 bytes derived key, i.e. a single block.
+
+ It produces the same output as `CCKeyDerivationPBKDF` but runs by slices of rounds so that
+ it can report progress and be cancelled.
+
+ @param passwordData the password.
+ @param salt the salt.
+ @param iterations the number of rounds.
+ @param progress the progress to update. Derivation stops if it is cancelled.
+ @param derivedKey the output buffer.
+ @return kCCSuccess on success.
+ */
+static int MXMegolmExportPBKDF2(NSData *passwordData, NSData *salt, NSUInteger iterations, NSProgress *progress, uint8_t derivedKey[CC_SHA512_DIGEST_LENGTH])
+{
+    if (!iterations)
+    {
+        return kCCParamError;
+    }
+
+    // The context keyed with the password is copied at each round instead of being initialised again
+    CCHmacContext keyedContext, context;
+    CCHmacInit(&keyedContext, kCCHmacAlgSHA512, passwordData.bytes, passwordData.length);
+
+    // U1 = HMAC(password, salt || INT(1))
+    uint8_t blockIndex[4] = {0, 0, 0, 1};
+    uint8_t u[CC_SHA512_DIGEST_LENGTH];
+    context = keyedContext;
+    CCHmacUpdate(&context, salt.bytes, salt.length);
+    CCHmacUpdate(&context, blockIndex, sizeof(blockIndex));
+    CCHmacFinal(&context, u);
+    memcpy(derivedKey, u, sizeof(u));
+
+    progress.totalUnitCount = iterations;
+
+    int result = kCCSuccess;
+    for (NSUInteger iteration = 1; iteration < iterations; iteration++)
+    {
+        // Ui = HMAC(password, Ui-1), derived key = U1 ^ U2 ^ ... ^ Un
+        context = keyedContext;
+        CCHmacUpdate(&context, u, sizeof(u));
+        CCHmacFinal(&context, u);
+        for (NSUInteger i = 0; i < sizeof(u); i++)
+        {
+            derivedKey[i] ^= u[i];
+        }
+
+        if (iteration % kMXMegolmExportKdfRoundsPerProgressUpdate == 0)
+        {
+            if (progress.isCancelled)
+            {
+                result = kCCUnspecifiedError;
+                break;
+            }
+            progress.completedUnitCount = iteration;
+        }
+    }
+
+    if (result == kCCSuccess)
+    {
+        progress.completedUnitCount = iterations;
+    }
+    return result;
+}
+
+/**
+ Block receiving bytes produced by a stage of the pipeline.
+ */
+typedef BOOL (^MXMegolmExportBytesBlock)(const uint8_t *bytes, NSUInteger length, NSError *__autoreleasing *error);
+
+
+@interface MXMegolmExportEncryption ()
+
++ (int)deriveKeys:(NSData*)salt iterations:(NSUInteger)iterations password:(NSString*)password progress:(NSProgress*)progress aesKey:(NSData**)aesKey hmacKey:(NSData**)hmacKey;
+
+@end
+
+
+#pragma mark - MXMegolmExportArmorWriter
+
+/**
+ Ascii-armours bytes on the fly: header line, base64 lines and trailer line.
+ */
+@interface MXMegolmExportArmorWriter : NSObject
+{
+    NSOutputStream *outputStream;
+    uint8_t line[kMXMegolmExportLineLength];
+    NSUInteger lineLength;
+}
+
+- (instancetype)initWithOutputStream:(NSOutputStream*)outputStream;
+- (BOOL)writeHeader:(NSError**)error;
+- (BOOL)writeBytes:(const uint8_t*)bytes length:(NSUInteger)length error:(NSError**)error;
+- (BOOL)finish:(NSError**)error;
+
+@end
+
+@implementation MXMegolmExportArmorWriter
+
+- (instancetype)initWithOutputStream:(NSOutputStream *)theOutputStream
+{
+    self = [super init];
+    if (self)
+    {
+        outputStream = theOutputStream;
+    }
+    return self;
+}
+
+- (BOOL)writeHeader:(NSError *__autoreleasing *)error
+{
+    return [self writeLine:MXMegolmExportEncryptionHeaderLine error:error];
+}
+
+- (BOOL)writeBytes:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError *__autoreleasing *)error
+{
+    while (length)
+    {
+        NSUInteger copyLength = MIN(length, kMXMegolmExportLineLength - lineLength);
+        memcpy(line + lineLength, bytes, copyLength);
+        lineLength += copyLength;
+        bytes += copyLength;
+        length -= copyLength;
+
+        if (lineLength == kMXMegolmExportLineLength && ![self flushLine:error])
+        {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (BOOL)finish:(NSError *__autoreleasing *)error
+{
+    return [self flushLine:error] && [self writeLine:MXMegolmExportEncryptionTrailerLine error:error];
+}
+
+- (BOOL)flushLine:(NSError *__autoreleasing *)error
+{
+    if (!lineLength)
+    {
+        return YES;
+    }
+
+    NSData *lineData = [NSData dataWithBytesNoCopy:line length:lineLength freeWhenDone:NO];
+    lineLength = 0;
+    return [self writeLine:[MXBase64Tools base64FromData:lineData] error:error];
+}
+
+- (BOOL)writeLine:(NSString*)string error:(NSError *__autoreleasing *)error
+{
+    NSData *data = [[string stringByAppendingString:@"\n"] dataUsingEncoding:NSUTF8StringEncoding];
+    return MXMegolmExportWrite(outputStream, data.bytes, data.length, error);
+}
+
+@end
+
+
+#pragma mark - MXMegolmExportEncryptor
+
+/**
+ Encrypts, authenticates and armours plain bytes on the fly.
+ */
+@interface MXMegolmExportEncryptor : NSObject
+{
+    MXMegolmExportArmorWriter *armorWriter;
+    CCCryptorRef cryptor;
+    CCHmacContext hmacContext;
+    NSMutableData *cipherBuffer;
+}
+
+- (instancetype)initWithOutputStream:(NSOutputStream*)outputStream password:(NSString*)password kdfRounds:(NSUInteger)kdfRounds kdfProgress:(NSProgress*)kdfProgress error:(NSError**)error;
+- (BOOL)appendBytes:(const uint8_t*)bytes length:(NSUInteger)length error:(NSError**)error;
+- (BOOL)finish:(NSError**)error;
+
+@end
+
+
+#pragma mark - MXMegolmExportDecryptor
+
+/**
+ Authenticates and decrypts body bytes on the fly.
+
+ The HMAC of the body can only be checked once all bytes are received.
+ */
+@interface MXMegolmExportDecryptor : NSObject
+{
+    NSString *password;
+
+    NSMutableData *bodyHeader;
+    NSData *derivedKeysSalt;
+    NSUInteger derivedKeysIterations;
+    NSData *aesKey;
+    NSData *hmacKey;
+
+    CCCryptorRef cryptor;
+    CCHmacContext hmacContext;
+
+    // The last bytes received. They may be the HMAC
+    NSMutableData *tail;
+    NSMutableData *plainBuffer;
+}
+
+- (instancetype)initWithPassword:(NSString*)password;
+
+/**
+ The progress of the keys derivation. Derivation stops if it is cancelled.
+ */
+@property (nonatomic) NSProgress *kdfProgress;
+
+/**
+ The block receiving decrypted bytes. nil to only authenticate the body.
+ */
+@property (nonatomic, copy) MXMegolmExportBytesBlock outputBlock;
+
+- (BOOL)appendBytes:(const uint8_t*)bytes length:(NSUInteger)length error:(NSError**)error;
+- (BOOL)finish:(NSError**)error;
+
+/**
+ Prepare for another pass on the same body. Derived keys are reused.
+ */
+- (void)reset;
+
+@end
+
+
+#pragma mark - MXMegolmExportSessionParser
+
+/**
+ Parses a JSON array of sessions on the fly, one element at a time.
+ */
+@interface MXMegolmExportSessionParser : NSObject
+{
+    void (^sessionBlock)(NSDictionary *session);
+
+    NSMutableData *element;
+    NSUInteger elementsCount;
+    NSUInteger depth;
+    BOOL inString;
+    BOOL escaped;
+    BOOL ended;
+}
+
+- (instancetype)initWithSessionBlock:(void (^)(NSDictionary *session))sessionBlock;
+- (BOOL)appendBytes:(const uint8_t*)bytes length:(NSUInteger)length error:(NSError**)error;
+- (BOOL)finish:(NSError**)error;
+
+@end
+
+
+#pragma mark - MXMegolmExportEncryption
+
+@implementation MXMegolmExportEncryption
+
++ (NSData*)decryptMegolmKeyFile:(NSData*)data withPassword:(NSString*)password error:(NSError *__autoreleasing *)error
+{
+    NSInputStream *inputStream = [NSInputStream inputStreamWithData:data];
+    NSOutputStream *outputStream = [NSOutputStream outputStreamToMemory];
+    [outputStream open];
+
+    NSData *result;
+    if ([MXMegolmExportEncryption decryptMegolmKeyStream:inputStream toStream:outputStream withPassword:password error:error])
+    {
+        result = [outputStream propertyForKey:NSStreamDataWrittenToMemoryStreamKey] ?: [NSData data];
+    }
+    [outputStream close];
+
+    return result;
+}
+
++ (NSData*)encryptMegolmKeyFile:(NSData*)data withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds error:(NSError *__autoreleasing *)error
+{
+    NSInputStream *inputStream = [NSInputStream inputStreamWithData:data];
+    NSOutputStream *outputStream = [NSOutputStream outputStreamToMemory];
+    [outputStream open];
+
+    NSData *result;
+    if ([MXMegolmExportEncryption encryptMegolmKeyStream:inputStream toStream:outputStream withPassword:password kdfRounds:kdfRounds error:error])
+    {
+        result = [outputStream propertyForKey:NSStreamDataWrittenToMemoryStreamKey];
+    }
+    [outputStream close];
+
+    return result;
+}
+
++ (BOOL)decryptMegolmKeyStream:(NSInputStream*)inputStream toStream:(NSOutputStream*)outputStream withPassword:(NSString*)password error:(NSError *__autoreleasing *)error
+{
+    NSDate *startDate = [NSDate date];
+
+    BOOL closeInputStream = [MXMegolmExportEncryption openStream:inputStream];
+    BOOL closeOutputStream = [MXMegolmExportEncryption openStream:outputStream];
+
+    MXMegolmExportDecryptor *decryptor = [[MXMegolmExportDecryptor alloc] initWithPassword:password];
+    decryptor.outputBlock = ^BOOL(const uint8_t *bytes, NSUInteger length, NSError *__autoreleasing *error) {
+        return MXMegolmExportWrite(outputStream, bytes, length, error);
+    };
+
+    __block NSUInteger bodyLength = 0;
+    BOOL success = [MXMegolmExportEncryption readArmoredStream:inputStream progress:nil bodyBlock:^BOOL(const uint8_t *bytes, NSUInteger length, NSError *__autoreleasing *error) {
+        bodyLength += length;
+        return [decryptor appendBytes:bytes length:length error:error];
+    } error:error];
+    success = success && [decryptor finish:error];
+
+    if (closeInputStream)
+    {
+        [inputStream close];
+    }
+    if (closeOutputStream)
+    {
+        [outputStream close];
+    }
+
+    if (success)
+    {
+        MXLogDebug(@"[MXMegolmExportEncryption] decryptMegolmKeyStream: decrypted %tu bytes in %.0fms", bodyLength, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+    }
+
+    return success;
+}
+
++ (BOOL)encryptMegolmKeyStream:(NSInputStream*)inputStream toStream:(NSOutputStream*)outputStream withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds error:(NSError *__autoreleasing *)error
+{
+    NSDate *startDate = [NSDate date];
+
+    BOOL closeInputStream = [MXMegolmExportEncryption openStream:inputStream];
+    BOOL closeOutputStream = [MXMegolmExportEncryption openStream:outputStream];
+
+    __block NSUInteger plainLength = 0;
+    BOOL success = [MXMegolmExportEncryption encryptToStream:outputStream withPassword:password kdfRounds:kdfRounds kdfProgress:nil error:error plainBlock:^BOOL(MXMegolmExportEncryptor *encryptor, NSError *__autoreleasing *error) {
+        NSMutableData *buffer = [NSMutableData dataWithLength:kMXMegolmExportStreamChunkSize];
+        while (YES)
+        {
+            NSInteger length = [inputStream read:buffer.mutableBytes maxLength:buffer.length];
+            if (length < 0)
+            {
+                MXMegolmExportSetError(error, inputStream.streamError ?: MXMegolmExportError(MXMegolmExportErrorStreamFailureCode, @"Cannot read the input stream"));
+                return NO;
+            }
+            if (length == 0)
+            {
+                return YES;
+            }
+
+            plainLength += length;
+
+            NSError *chunkError;
+            BOOL appended;
+            @autoreleasepool
+            {
+                appended = [encryptor appendBytes:buffer.bytes length:length error:&chunkError];
+            }
+            if (!appended)
+            {
+                MXMegolmExportSetError(error, chunkError);
+                return NO;
+            }
+        }
+    }];
+
+    if (closeInputStream)
+    {
+        [inputStream close];
+    }
+    if (closeOutputStream)
+    {
+        [outputStream close];
+    }
+
+    if (success)
+    {
+        MXLogDebug(@"[MXMegolmExportEncryption] encryptMegolmKeyStream: encrypted %tu bytes in %.0fms", plainLength, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+    }
+
+    return success;
+}
+
++ (BOOL)encryptMegolmSessions:(id<NSFastEnumeration>)sessions toStream:(NSOutputStream*)outputStream withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds error:(NSError *__autoreleasing *)error
+{
+    return [MXMegolmExportEncryption encryptMegolmSessions:sessions toStream:outputStream withPassword:password kdfRounds:kdfRounds kdfProgress:nil payloadProgress:nil error:error];
+}
+
++ (BOOL)decryptMegolmKeyFileAtURL:(NSURL*)fileURL withPassword:(NSString*)password sessionBlock:(void (^)(NSDictionary *session))sessionBlock error:(NSError *__autoreleasing *)error
+{
+    return [MXMegolmExportEncryption decryptMegolmKeyFileAtURL:fileURL withPassword:password kdfProgress:nil payloadProgress:nil sessionBlock:sessionBlock error:error];
+}
+
++ (BOOL)isMegolmKeyFile:(NSURL *)fileURL
+{
+    BOOL isMegolmKeyFile = NO;
+
+    NSError *error;
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingFromURL:fileURL error:&error];
+    if (fileHandle)
+    {
+        NSData *fileHeaderData = [fileHandle readDataOfLength:MXMegolmExportEncryptionHeaderLine.length];
+        NSString *fileHeader = [[NSString alloc] initWithData:fileHeaderData encoding:NSUTF8StringEncoding];
+
+        if ([fileHeader isEqualToString:MXMegolmExportEncryptionHeaderLine])
+        {
+            isMegolmKeyFile = YES;
+        }
+
+        [fileHandle closeFile];
+    }
+
+    return isMegolmKeyFile;
+}
+
+
+#pragma mark - Asynchronous operations
+
++ (NSProgress*)encryptMegolmSessions:(id<NSFastEnumeration>)sessions toFileAtURL:(NSURL*)fileURL withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds success:(void (^)(void))success failure:(void (^)(NSError *error))failure
+{
+    NSProgress *progress = [NSProgress progressWithTotalUnitCount:kMXMegolmExportKdfProgressUnitCount + kMXMegolmExportPayloadProgressUnitCount];
+    NSProgress *kdfProgress = [NSProgress progressWithTotalUnitCount:kdfRounds ?: kMXMegolmExportDefaultKdfRounds parent:progress pendingUnitCount:kMXMegolmExportKdfProgressUnitCount];
+
+    // The payload progress stays indeterminate if the number of sessions is unknown
+    int64_t sessionsCount = [(id)sessions respondsToSelector:@selector(count)] ? [(id)sessions count] : -1;
+    NSProgress *payloadProgress = [NSProgress progressWithTotalUnitCount:sessionsCount parent:progress pendingUnitCount:kMXMegolmExportPayloadProgressUnitCount];
+
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        NSError *error;
+        NSOutputStream *outputStream = [NSOutputStream outputStreamWithURL:fileURL append:NO];
+        BOOL encrypted = [MXMegolmExportEncryption encryptMegolmSessions:sessions toStream:outputStream withPassword:password kdfRounds:kdfRounds kdfProgress:kdfProgress payloadProgress:payloadProgress error:&error];
+
+        if (encrypted)
+        {
+            payloadProgress.totalUnitCount = payloadProgress.completedUnitCount;
+        }
+        else
+        {
+            MXLogErrorDetails(@"[MXMegolmExportEncryption] encryptMegolmSessions: Failed", @{
+                @"error": error ?: @"unknown"
+            });
+            [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (encrypted)
+            {
+                success();
+            }
+            else
+            {
+                failure(error);
+            }
+        });
+    });
+
+    return progress;
+}
+
++ (NSProgress*)decryptMegolmKeyFileAtURL:(NSURL*)fileURL withPassword:(NSString*)password sessionBlock:(void (^)(NSDictionary *session))sessionBlock success:(void (^)(void))success failure:(void (^)(NSError *error))failure
+{
+    NSProgress *progress = [NSProgress progressWithTotalUnitCount:kMXMegolmExportKdfProgressUnitCount + kMXMegolmExportPayloadProgressUnitCount];
+
+    // The number of rounds is known once the file header is read
+    NSProgress *kdfProgress = [NSProgress progressWithTotalUnitCount:1 parent:progress pendingUnitCount:kMXMegolmExportKdfProgressUnitCount];
+
+    // The file is read twice
+    unsigned long long fileSize = [[NSFileManager defaultManager] attributesOfItemAtPath:fileURL.path error:nil].fileSize;
+    NSProgress *payloadProgress = [NSProgress progressWithTotalUnitCount:2 * fileSize parent:progress pendingUnitCount:kMXMegolmExportPayloadProgressUnitCount];
+
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        NSError *error;
+        BOOL decrypted = [MXMegolmExportEncryption decryptMegolmKeyFileAtURL:fileURL withPassword:password kdfProgress:kdfProgress payloadProgress:payloadProgress sessionBlock:sessionBlock error:&error];
+
+        if (decrypted)
+        {
+            payloadProgress.completedUnitCount = payloadProgress.totalUnitCount;
+        }
+        else
+        {
+            MXLogErrorDetails(@"[MXMegolmExportEncryption] decryptMegolmKeyFileAtURL: Failed", @{
+                @"error": error ?: @"unknown"
+            });
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (decrypted)
+            {
+                success();
+            }
+            else
+            {
+                failure(error);
+            }
+        });
+    });
+
+    return progress;
+}
+
++ (NSUInteger)kdfRoundsForDuration:(NSTimeInterval)duration
+{
+    // CCCalibratePBKDF measures the derivation of a key like ours from a typical password
+    uint rounds = CCCalibratePBKDF(kCCPBKDF2, 16, 16, kCCPRFHmacAlgSHA512, 64, (uint32_t)(duration * 1000));
+
+    NSUInteger kdfRounds = MAX(rounds, kMXMegolmExportMinimumKdfRounds);
+    MXLogDebug(@"[MXMegolmExportEncryption] kdfRoundsForDuration: %tu rounds for %.0fms", kdfRounds, duration * 1000);
+
+    return kdfRounds;
+}
+
+
+#pragma mark - Private methods
+
+/**
+ Encrypt megolm sessions into a key file, reporting progress.
+
+ @param kdfProgress the progress of the keys derivation. nil to not report it.
+ @param payloadProgress the progress of sessions encryption, in number of sessions. nil to not report it.
+ */
++ (BOOL)encryptMegolmSessions:(id<NSFastEnumeration>)sessions toStream:(NSOutputStream*)outputStream withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds kdfProgress:(NSProgress*)kdfProgress payloadProgress:(NSProgress*)payloadProgress error:(NSError *__autoreleasing *)error
+{
+    NSDate *startDate = [NSDate date];
+
+    BOOL closeOutputStream = [MXMegolmExportEncryption openStream:outputStream];
+
+    __block NSUInteger sessionsCount = 0;
+    BOOL success = [MXMegolmExportEncryption encryptToStream:outputStream withPassword:password kdfRounds:kdfRounds kdfProgress:kdfProgress error:error plainBlock:^BOOL(MXMegolmExportEncryptor *encryptor, NSError *__autoreleasing *error) {
+        if (![encryptor appendBytes:(const uint8_t*)"[" length:1 error:error])
+        {
+            return NO;
+        }
+
+        for (NSDictionary *session in sessions)
+        {
+            if (payloadProgress.isCancelled)
+            {
+                MXMegolmExportSetError(error, MXMegolmExportCancelledError());
+                return NO;
+            }
+
+            NSError *sessionError;
+            BOOL appended = NO;
+            @autoreleasepool
+            {
+                NSData *sessionData = [NSJSONSerialization dataWithJSONObject:session options:0 error:&sessionError];
+                if (sessionData)
+                {
+                    appended = (sessionsCount++ == 0 || [encryptor appendBytes:(const uint8_t*)"," length:1 error:&sessionError])
+                        && [encryptor appendBytes:sessionData.bytes length:sessionData.length error:&sessionError];
+                }
+            }
+            if (!appended)
+            {
+                MXMegolmExportSetError(error, sessionError);
+                return NO;
+            }
+            payloadProgress.completedUnitCount = sessionsCount;
+        }
+
+        return [encryptor appendBytes:(const uint8_t*)"]" length:1 error:error];
+    }];
+
+    if (closeOutputStream)
+    {
+        [outputStream close];
+    }
+
+    if (success)
+    {
+        MXLogDebug(@"[MXMegolmExportEncryption] encryptMegolmSessions: encrypted %tu sessions in %.0fms", sessionsCount, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+    }
+
+    return success;
+}
+
+/**
+ Decrypt the megolm sessions of a key file, reporting progress.
+
+ @param kdfProgress the progress of the keys derivation. nil to not report it.
+ @param payloadProgress the progress of both passes on the file, in bytes read. nil to not report it.
+ */
++ (BOOL)decryptMegolmKeyFileAtURL:(NSURL*)fileURL withPassword:(NSString*)password kdfProgress:(NSProgress*)kdfProgress payloadProgress:(NSProgress*)payloadProgress sessionBlock:(void (^)(NSDictionary *session))sessionBlock error:(NSError *__autoreleasing *)error
+{
+    NSDate *startDate = [NSDate date];
+
+    MXMegolmExportDecryptor *decryptor = [[MXMegolmExportDecryptor alloc] initWithPassword:password];
+    decryptor.kdfProgress = kdfProgress;
+
+    // First pass: authenticate the file so that no session is handed out from a tampered file
+    if (![MXMegolmExportEncryption readArmoredFileAtURL:fileURL decryptor:decryptor progress:payloadProgress error:error])
+    {
+        return NO;
+    }
+
+    // Second pass: decrypt and parse sessions
+    __block NSUInteger sessionsCount = 0;
+    MXMegolmExportSessionParser *parser = [[MXMegolmExportSessionParser alloc] initWithSessionBlock:^(NSDictionary *session) {
+        sessionsCount++;
+        sessionBlock(session);
+    }];
+
+    [decryptor reset];
+    decryptor.outputBlock = ^BOOL(const uint8_t *bytes, NSUInteger length, NSError *__autoreleasing *error) {
+        return [parser appendBytes:bytes length:length error:error];
+    };
+
+    if (![MXMegolmExportEncryption readArmoredFileAtURL:fileURL decryptor:decryptor progress:payloadProgress error:error]
+        || ![parser finish:error])
+    {
+        return NO;
+    }
+
+    MXLogDebug(@"[MXMegolmExportEncryption] decryptMegolmKeyFileAtURL: decrypted %tu sessions in %.0fms", sessionsCount, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+
+    return YES;
+}
+
+/**
+ Derive the AES and HMAC-SHA-256 keys for the file.
+
+ @param salt for pbkdf.
+ @param iterations the number of pbkdf iterations.
+ @param password the password.
+ @param progress the progress of the derivation. nil to derive in one call.
+ @param aesKey the aes key
+ @param hmacKey the hmac key
+ @return the derivation result. Should be kCCSuccess.
+ */
++ (int)deriveKeys:(NSData*)salt iterations:(NSUInteger)iterations password:(NSString*)password progress:(NSProgress*)progress aesKey:(NSData**)aesKey hmacKey:(NSData**)hmacKey
+{
+    int result = kCCSuccess;
+
+    NSDate *startDate = [NSDate date];
+
+    NSData *passwordData = [password dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSMutableData *derivedKey = [NSMutableData dataWithLength:64];
+
+    if (progress)
+    {
+        result = MXMegolmExportPBKDF2(passwordData, salt, iterations, progress, derivedKey.mutableBytes);
+    }
+    else
+    {
+        result =  CCKeyDerivationPBKDF(kCCPBKDF2,
+                                       passwordData.bytes,
+                                       passwordData.length,
+                                       salt.bytes,
+                                       salt.length,
+                                       kCCPRFHmacAlgSHA512,
+                                       (uint)iterations,
+                                       derivedKey.mutableBytes,
+                                       derivedKey.length);
+    }
+
+    *aesKey = [derivedKey subdataWithRange:NSMakeRange(0, 32)];
+    *hmacKey = [derivedKey subdataWithRange:NSMakeRange(32, derivedKey.length - 32)];
+
+    MXLogDebug(@"[MXMegolmExportEncryption] deriveKeys: %tu iterations took %.0fms", iterations, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
 
-@implementation MXMegolmExportEncryption
+    return result;
+}
 
-+ (NSData*)decryptMegolmKeyFile:(NSData*)data withPassword:(NSString*)password error:(NSError *__autoreleasing *)error
-{
-    NSDate *startDate = [NSDate date];
+/**
+ Open a stream if it is not open yet.
 
-    NSData *result;
+ @return YES if the stream has been opened by this call and must be closed by the caller.
+ */
++ (BOOL)openStream:(NSStream*)stream
+{
+    if (stream.streamStatus == NSStreamStatusNotOpen)
+    {
+        [stream open];
+        return YES;
+    }
+    return NO;
+}
 
-    NSData *body = [MXMegolmExportEncryption unpackMegolmKeyFile:data error:error];
-    uint8_t *bodyBytes = (uint8_t*)body.bytes;
+/**
+ Create an encryptor, let `plainBlock` feed it and finalise the output.
+ */
++ (BOOL)encryptToStream:(NSOutputStream*)outputStream
+           withPassword:(NSString*)password
+              kdfRounds:(NSUInteger)kdfRounds
+            kdfProgress:(NSProgress*)kdfProgress
+                  error:(NSError *__autoreleasing *)error
+             plainBlock:(BOOL (^)(MXMegolmExportEncryptor *encryptor, NSError *__autoreleasing *error))plainBlock
+{
+    if (!password)
+    {
+        MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorAuthenticationFailedCode, @"Authentication check failed: password is mandatory"));
+        return NO;
+    }
 
-    if (!*error)
+    MXMegolmExportEncryptor *encryptor = [[MXMegolmExportEncryptor alloc] initWithOutputStream:outputStream password:password kdfRounds:kdfRounds kdfProgress:kdfProgress error:error];
+    if (!encryptor)
     {
-        // Check we have a version byte
-        if (body.length < 1)
-        {
-            *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                         code:MXMegolmExportErrorInvalidKeyFileTooShortCode
-                                     userInfo:@{
-                                                NSLocalizedDescriptionKey: @"Invalid file: too short",
-                                                }];
-            return nil;
-        }
+        return NO;
+    }
 
-        uint8_t version = bodyBytes[0];
-        if (version != 1)
-        {
-            *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                         code:MXMegolmExportErrorInvalidKeyFileUnsupportedVersionCode
-                                     userInfo:@{
-                                                NSLocalizedDescriptionKey: @"Unsupported version",
-                                                }];
-            return nil;
-        }
+    return plainBlock(encryptor, error) && [encryptor finish:error];
+}
 
-        NSInteger ciphertextLength = body.length-(1+16+16+4+32);
-        if (ciphertextLength < 0)
-        {
-            *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                         code:MXMegolmExportErrorInvalidKeyFileTooShortCode
-                                     userInfo:@{
-                                                NSLocalizedDescriptionKey: @"Invalid file: too short",
-                                                }];
-            return nil;
-        }
+/**
+ Run a decryptor pass on an armoured file.
+ */
++ (BOOL)readArmoredFileAtURL:(NSURL*)fileURL decryptor:(MXMegolmExportDecryptor*)decryptor progress:(NSProgress*)progress error:(NSError *__autoreleasing *)error
+{
+    NSInputStream *inputStream = [NSInputStream inputStreamWithURL:fileURL];
+    [inputStream open];
 
-        NSData *salt = [body subdataWithRange:NSMakeRange(1, 16)];
-        NSData *iv = [body subdataWithRange:NSMakeRange(17, 16)];
-        NSUInteger iterations = bodyBytes[33] << 24 | bodyBytes[34] << 16 | bodyBytes[35] << 8 | bodyBytes[36];
-        NSData *ciphertext = [body subdataWithRange:NSMakeRange(37, ciphertextLength)];
-        NSData *hmac = [body subdataWithRange:NSMakeRange(body.length-32, 32)];
+    BOOL success = [MXMegolmExportEncryption readArmoredStream:inputStream progress:progress bodyBlock:^BOOL(const uint8_t *bytes, NSUInteger length, NSError *__autoreleasing *error) {
+        return [decryptor appendBytes:bytes length:length error:error];
+    } error:error];
+    success = success && [decryptor finish:error];
 
-        NSData *aesKey, *hmacKey;
-        if (kCCSuccess == [MXMegolmExportEncryption deriveKeys:salt iterations:iterations password:password aesKey:&aesKey hmacKey:&hmacKey])
+    [inputStream close];
+    return success;
+}
+
+/**
+ Unbase64 an ascii-armoured megolm key stream on the fly.
+
+ Skips lines until the header line and unbase64s the content until the trailer line.
+
+ @param inputStream the armoured stream.
+ @param progress the progress to increment by the number of bytes read. Reading stops if it is cancelled.
+ @param bodyBlock the block receiving unbase64ed content.
+ @param error the output error.
+ @return YES on success.
+ */
++ (BOOL)readArmoredStream:(NSInputStream*)inputStream progress:(NSProgress*)progress bodyBlock:(MXMegolmExportBytesBlock)bodyBlock error:(NSError *__autoreleasing *)error
+{
+    NSData *headerLine = [MXMegolmExportEncryptionHeaderLine dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *trailerLine = [MXMegolmExportEncryptionTrailerLine dataUsingEncoding:NSUTF8StringEncoding];
+
+    BOOL headerFound = NO, trailerFound = NO;
+
+    // The beginning of the current line, kept while it can still be the header or the trailer line
+    NSMutableData *line = [NSMutableData data];
+    BOOL lineIsMarkerCandidate = YES;
+
+    // The decoder ignores line breaks: body content is decoded by runs spanning several lines
+    MXBase64Decoder *decoder = [MXBase64Decoder new];
+    MXMegolmExportBytesBlock decodeBlock = ^BOOL(const uint8_t *bytes, NSUInteger length, NSError *__autoreleasing *error) {
+        if (!length)
         {
-            // Check HMAC
-            NSData *toVerify = [body subdataWithRange:NSMakeRange(0, body.length - 32)];
+            return YES;
+        }
+        NSData *decoded = [decoder decodeBytes:bytes length:length];
+        return !decoded.length || bodyBlock(decoded.bytes, decoded.length, error);
+    };
 
-            NSMutableData* hash = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH ];
-            CCHmac(kCCHmacAlgSHA256, hmacKey.bytes, hmacKey.length, toVerify.bytes, toVerify.length, hash.mutableBytes);
+    NSMutableData *buffer = [NSMutableData dataWithLength:kMXMegolmExportStreamChunkSize];
 
-            if (![hash isEqualToData:hmac])
-            {
-                *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                             code:MXMegolmExportErrorAuthenticationFailedCode
-                                         userInfo:@{
-                                                    NSLocalizedDescriptionKey: @"Authentication check failed: incorrect password?",
-                                                    }];
-                return nil;
-            }
+    BOOL endOfStream = NO;
+    while (!endOfStream && !trailerFound)
+    {
+        NSError *chunkError;
+        BOOL chunkFailed = NO;
 
-            // Decrypt the cypher text
-            CCCryptorRef cryptor;
-            CCCryptorStatus status;
+        if (progress.isCancelled)
+        {
+            MXMegolmExportSetError(error, MXMegolmExportCancelledError());
+            return NO;
+        }
 
-            status = CCCryptorCreateWithMode(kCCDecrypt, kCCModeCTR, kCCAlgorithmAES,
-                                             ccNoPadding, iv.bytes, aesKey.bytes, kCCKeySizeAES256,
-                                             NULL, 0, 0, kCCModeOptionCTR_BE, &cryptor);
-            if (status != kCCSuccess)
+        // Release temporary objects at each chunk to keep memory usage constant
+        @autoreleasepool
+        {
+            NSInteger length = [inputStream read:buffer.mutableBytes maxLength:buffer.length];
+            if (length < 0)
             {
-                *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                             code:MXMegolmExportErrorCannotInitialiseCryptorCode
-                                         userInfo:@{
-                                                    NSLocalizedDescriptionKey: @"Cannot initialise decryptor",
-                                                    }];
-                return nil;
+                chunkError = inputStream.streamError ?: MXMegolmExportError(MXMegolmExportErrorStreamFailureCode, @"Cannot read the input stream");
+                chunkFailed = YES;
+                length = 0;
             }
+            endOfStream = (length == 0);
+            progress.completedUnitCount += length;
 
-            size_t bufferLength = CCCryptorGetOutputLength(cryptor, ciphertext.length, false);
-            NSMutableData *buffer = [NSMutableData dataWithLength:bufferLength];
-
-            size_t outLength;
-            status |= CCCryptorUpdate(cryptor,
-                                      ciphertext.bytes,
-                                      ciphertext.length,
-                                      [buffer mutableBytes],
-                                      [buffer length],
-                                      &outLength);
+            const uint8_t *bytes = buffer.bytes;
 
-            status |= CCCryptorRelease(cryptor);
+            // Start of the body content of this chunk that is not decoded yet
+            NSInteger contentStart = 0;
 
-            if (status == kCCSuccess)
+            // Process the chunk line slice by line slice. At the end of the stream, end the last line
+            NSInteger index = 0;
+            while (!chunkFailed && !trailerFound && (index < length || (endOfStream && index == 0)))
             {
-                result = buffer;
+                NSInteger lineEnd = index;
+                while (lineEnd < length && bytes[lineEnd] != '\n' && bytes[lineEnd] != '\r')
+                {
+                    lineEnd++;
+                }
+                NSUInteger sliceLength = lineEnd - index;
+                BOOL endOfLine = endOfStream || lineEnd < length;
+
+                NSData *markerLine = headerFound ? trailerLine : headerLine;
+                if (lineIsMarkerCandidate && sliceLength)
+                {
+                    lineIsMarkerCandidate = line.length + sliceLength <= markerLine.length
+                        && memcmp((const uint8_t *)markerLine.bytes + line.length, &bytes[index], sliceLength) == 0;
+
+                    if (lineIsMarkerCandidate)
+                    {
+                        // Decode the content before the line and keep the line aside
+                        if (headerFound && !line.length)
+                        {
+                            chunkFailed = !decodeBlock(&bytes[contentStart], index - contentStart, &chunkError);
+                        }
+                        [line appendBytes:&bytes[index] length:sliceLength];
+                        contentStart = lineEnd;
+                    }
+                    else if (headerFound)
+                    {
+                        // The kept beginning of the line was content. The rest of the line is in the current run
+                        chunkFailed = !decodeBlock(line.bytes, line.length, &chunkError);
+                        line.length = 0;
+                    }
+                    else
+                    {
+                        line.length = 0;
+                    }
+                }
+
+                if (endOfLine && !chunkFailed)
+                {
+                    if (lineIsMarkerCandidate && line.length == markerLine.length)
+                    {
+                        if (headerFound)
+                        {
+                            trailerFound = YES;
+                        }
+                        else
+                        {
+                            headerFound = YES;
+                            contentStart = lineEnd;
+                        }
+                    }
+                    else if (headerFound && line.length)
+                    {
+                        chunkFailed = !decodeBlock(line.bytes, line.length, &chunkError);
+                    }
+
+                    line.length = 0;
+                    lineIsMarkerCandidate = YES;
+                }
+
+                index = endOfLine ? lineEnd + 1 : lineEnd;
             }
-            else
+
+            if (!chunkFailed && headerFound && !trailerFound && contentStart < length)
             {
-                *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                             code:MXMegolmExportErrorCannotDecryptCode
-                                         userInfo:@{
-                                                    NSLocalizedDescriptionKey: @"Cannot decrypt",
-                                                    }];
-                return nil;
+                chunkFailed = !decodeBlock(&bytes[contentStart], length - contentStart, &chunkError);
             }
         }
-        else
+
+        if (chunkFailed)
         {
-            *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                         code:MXMegolmExportErrorCannotDeriveKeysCode
-                                     userInfo:@{
-                                                NSLocalizedDescriptionKey: @"Cannot derive keys",
-                                                }];
-            return nil;
+            MXMegolmExportSetError(error, chunkError);
+            return NO;
         }
     }
 
-    MXLogDebug(@"[MXMegolmExportEncryption] decryptMegolmKeyFile: decrypted %tu bytes in %.0fms", data.length, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
-
-    return result;
-}
-
-+ (NSData*)encryptMegolmKeyFile:(NSData*)data withPassword:(NSString*)password kdfRounds:(NSUInteger)kdfRounds error:(NSError *__autoreleasing *)error
-{
-    NSDate *startDate = [NSDate date];
+    if (!headerFound)
+    {
+        MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorInvalidKeyFileHeaderNotFoundCode, @"Header line not found"));
+        return NO;
+    }
 
-    if (!password)
+    if (!trailerFound)
     {
-        *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                     code:MXMegolmExportErrorAuthenticationFailedCode
-                                 userInfo:@{
-                                            NSLocalizedDescriptionKey: @"Authentication check failed: password is mandatory",
-                                            }];
-        return nil;
+        MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorInvalidKeyFileTrailerNotFoundCode, @"Trailer line not found"));
+        return NO;
     }
 
-    if (!kdfRounds)
+    NSData *decoded = [decoder finish];
+    if (!decoded)
     {
-        kdfRounds = 500000;
+        MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorInvalidKeyFileTooShortCode, @"Invalid file: too short"));
+        return NO;
     }
 
-    NSMutableData *salt = [NSMutableData dataWithLength:16];
-    int r = SecRandomCopyBytes(kSecRandomDefault, 16, salt.mutableBytes);
+    return !decoded.length || bodyBlock(decoded.bytes, decoded.length, error);
+}
 
-    NSMutableData *iv = [NSMutableData dataWithLength:16];
-    r += SecRandomCopyBytes(kSecRandomDefault, 16, iv.mutableBytes);
+// @TODO: For dev. To remove
++ (void)logBytesDec:(NSData*)data
+{
+    uint8_t *bytes = (uint8_t*)data.bytes;
 
-    if (r != 0)
+    NSMutableString *s = [NSMutableString string];
+    for (NSUInteger i = 0; i < data.length; i++)
     {
-        *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                     code:MXMegolmExportErrorCannotInitialiseCryptorCode
-                                 userInfo:@{
-                                            NSLocalizedDescriptionKey: @"Cannot compute salt or iv",
-                                            }];
-        return nil;
+        [s appendFormat:@"%hhu, ", bytes[i]];
     }
 
-    // Clear bit 63 of the IV to stop us hitting the 64-bit counter boundary
-    // (which would mean we wouldn't be able to decrypt on Android). The loss
-    // of a single bit of iv is a price we have to pay.
-    uint8_t *ivBytes = (uint8_t*)iv.mutableBytes;
-    ivBytes[9] &= 0x7f;
-
-    NSData *aesKey, *hmacKey;
-    if (kCCSuccess == [MXMegolmExportEncryption deriveKeys:salt iterations:kdfRounds password:password aesKey:&aesKey hmacKey:&hmacKey])
-    {
-        // Encrypt
-        CCCryptorRef cryptor;
-        CCCryptorStatus status;
+    MXLogDebug(@"%tu bytes:\n%@", data.length, s);
+}
 
-        status = CCCryptorCreateWithMode(kCCEncrypt, kCCModeCTR, kCCAlgorithmAES,
-                                         ccNoPadding, iv.bytes, aesKey.bytes, kCCKeySizeAES256,
-                                         NULL, 0, 0, kCCModeOptionCTR_BE, &cryptor);
-        if (status != kCCSuccess)
-        {
-            *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                         code:MXMegolmExportErrorCannotInitialiseCryptorCode
-                                     userInfo:@{
-                                                NSLocalizedDescriptionKey: @"Cannot initialise encryptor",
-                                                }];
-            return nil;
-        }
+@end
 
-        size_t bufferLength = CCCryptorGetOutputLength(cryptor, data.length, false);
-        NSMutableData *cipher = [NSMutableData dataWithLength:bufferLength];
 
-        size_t outLength;
-        status |= CCCryptorUpdate(cryptor,
-                                  data.bytes,
-                                  data.length,
-                                  [cipher mutableBytes],
-                                  [cipher length],
-                                  &outLength);
+#pragma mark - MXMegolmExportEncryptor
 
-        status |= CCCryptorRelease(cryptor);
+@implementation MXMegolmExportEncryptor
 
-        if (status == kCCSuccess)
+- (instancetype)initWithOutputStream:(NSOutputStream *)outputStream password:(NSString *)password kdfRounds:(NSUInteger)kdfRounds kdfProgress:(NSProgress *)kdfProgress error:(NSError *__autoreleasing *)error
+{
+    self = [super init];
+    if (self)
+    {
+        if (!kdfRounds)
         {
-            // Packetise
-            NSUInteger bodyLength = (1+salt.length+iv.length+4+cipher.length);
-
-            NSMutableData *result = [NSMutableData dataWithLength:bodyLength];
-            uint8_t *resultBuffer = (uint8_t*)result.mutableBytes;
-
-            NSUInteger idx = 0;
-            resultBuffer[idx++] = 1; // version
-            [result replaceBytesInRange:NSMakeRange(idx, salt.length) withBytes:salt.bytes]; idx += salt.length;
-            [result replaceBytesInRange:NSMakeRange(idx, iv.length) withBytes:iv.bytes]; idx += iv.length;
-            resultBuffer[idx++] = kdfRounds >> 24;
-            resultBuffer[idx++] = (kdfRounds >> 16) & 0xff;
-            resultBuffer[idx++] = (kdfRounds >> 8) & 0xff;
-            resultBuffer[idx++] = kdfRounds & 0xff;
-            [result replaceBytesInRange:NSMakeRange(idx, cipher.length) withBytes:cipher.bytes]; idx += cipher.length;
-
-            // Sign
-            NSData *toSign = result;
+            kdfRounds = kMXMegolmExportDefaultKdfRounds;
+        }
 
-            NSMutableData* hmac = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH ];
-            CCHmac(kCCHmacAlgSHA256, hmacKey.bytes, hmacKey.length, toSign.bytes, toSign.length, hmac.mutableBytes);
+        NSMutableData *salt = [NSMutableData dataWithLength:16];
+        int r = SecRandomCopyBytes(kSecRandomDefault, 16, salt.mutableBytes);
 
-            [result appendData:hmac];
+        NSMutableData *iv = [NSMutableData dataWithLength:16];
+        r += SecRandomCopyBytes(kSecRandomDefault, 16, iv.mutableBytes);
 
-            NSData *keyFile = [MXMegolmExportEncryption packMegolmKeyFile:result];
+        if (r != 0)
+        {
+            MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorCannotInitialiseCryptorCode, @"Cannot compute salt or iv"));
+            return nil;
+        }
 
-            MXLogDebug(@"[MXMegolmExportEncryption] encryptMegolmKeyFile: encrypted %tu bytes in %.0fms", data.length, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+        // Clear bit 63 of the IV to stop us hitting the 64-bit counter boundary
+        // (which would mean we wouldn't be able to decrypt on Android). The loss
+        // of a single bit of iv is a price we have to pay.
+        uint8_t *ivBytes = (uint8_t*)iv.mutableBytes;
+        ivBytes[9] &= 0x7f;
 
-            return keyFile;
+        NSData *aesKey, *hmacKey;
+        if (kCCSuccess != [MXMegolmExportEncryption deriveKeys:salt iterations:kdfRounds password:password progress:kdfProgress aesKey:&aesKey hmacKey:&hmacKey])
+        {
+            MXMegolmExportSetError(error, kdfProgress.isCancelled ? MXMegolmExportCancelledError() : MXMegolmExportError(MXMegolmExportErrorCannotDeriveKeysCode, @"Cannot derive keys"));
+            return nil;
         }
-        else
+
+        CCCryptorStatus status = CCCryptorCreateWithMode(kCCEncrypt, kCCModeCTR, kCCAlgorithmAES,
+                                                         ccNoPadding, iv.bytes, aesKey.bytes, kCCKeySizeAES256,
+                                                         NULL, 0, 0, kCCModeOptionCTR_BE, &cryptor);
+        if (status != kCCSuccess)
         {
-            *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                         code:MXMegolmExportErrorCannotEncryptCode
-                                     userInfo:@{
-                                                NSLocalizedDescriptionKey: @"Cannot encrypt",
-                                                }];
+            cryptor = NULL;
+            MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorCannotInitialiseCryptorCode, @"Cannot initialise encryptor"));
             return nil;
         }
 
+        CCHmacInit(&hmacContext, kCCHmacAlgSHA256, hmacKey.bytes, hmacKey.length);
+        cipherBuffer = [NSMutableData data];
+
+        // Body header
+        uint8_t bodyHeader[kMXMegolmExportBodyHeaderLength];
+        NSUInteger idx = 0;
+        bodyHeader[idx++] = 1; // version
+        memcpy(bodyHeader + idx, salt.bytes, salt.length); idx += salt.length;
+        memcpy(bodyHeader + idx, iv.bytes, iv.length); idx += iv.length;
+        bodyHeader[idx++] = kdfRounds >> 24;
+        bodyHeader[idx++] = (kdfRounds >> 16) & 0xff;
+        bodyHeader[idx++] = (kdfRounds >> 8) & 0xff;
+        bodyHeader[idx++] = kdfRounds & 0xff;
+
+        armorWriter = [[MXMegolmExportArmorWriter alloc] initWithOutputStream:outputStream];
+        if (![armorWriter writeHeader:error] || ![self writeBodyBytes:bodyHeader length:idx error:error])
+        {
+            return nil;
+        }
     }
-    else
+    return self;
+}
+
+- (void)dealloc
+{
+    if (cryptor)
     {
-        *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                     code:MXMegolmExportErrorCannotDeriveKeysCode
-                                 userInfo:@{
-                                            NSLocalizedDescriptionKey: @"Cannot derive keys",
-                                            }];
-        return nil;
+        CCCryptorRelease(cryptor);
     }
-
-    return nil;
 }
 
-+ (BOOL)isMegolmKeyFile:(NSURL *)fileURL
+- (BOOL)appendBytes:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError *__autoreleasing *)error
 {
-    BOOL isMegolmKeyFile = NO;
-
-    NSError *error;
-    NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingFromURL:fileURL error:&error];
-    if (fileHandle)
+    if (!length)
     {
-        NSData *fileHeaderData = [fileHandle readDataOfLength:MXMegolmExportEncryptionHeaderLine.length];
-        NSString *fileHeader = [[NSString alloc] initWithData:fileHeaderData encoding:NSUTF8StringEncoding];
+        return YES;
+    }
 
-        if ([fileHeader isEqualToString:MXMegolmExportEncryptionHeaderLine])
-        {
-            isMegolmKeyFile = YES;
-        }
+    cipherBuffer.length = CCCryptorGetOutputLength(cryptor, length, false);
 
-        [fileHandle closeFile];
+    size_t outLength;
+    CCCryptorStatus status = CCCryptorUpdate(cryptor, bytes, length, cipherBuffer.mutableBytes, cipherBuffer.length, &outLength);
+    if (status != kCCSuccess)
+    {
+        MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorCannotEncryptCode, @"Cannot encrypt"));
+        return NO;
     }
 
-    return isMegolmKeyFile;
+    return [self writeBodyBytes:cipherBuffer.bytes length:outLength error:error];
 }
 
+- (BOOL)finish:(NSError *__autoreleasing *)error
+{
+    // Sign
+    uint8_t hmac[kMXMegolmExportHMACLength];
+    CCHmacFinal(&hmacContext, hmac);
 
-#pragma mark - Private methods
-
-/**
- Derive the AES and HMAC-SHA-256 keys for the file.
+    return [armorWriter writeBytes:hmac length:kMXMegolmExportHMACLength error:error] && [armorWriter finish:error];
+}
 
- @param salt for pbkdf.
- @param iterations the number of pbkdf iterations.
- @param password the password.
- @param aesKey the aes key
- @param hmacKey the hmac key
- @return the derivation result. Should be kCCSuccess.
- */
-+ (int)deriveKeys:(NSData*)salt iterations:(NSUInteger)iterations password:(NSString*)password aesKey:(NSData**)aesKey hmacKey:(NSData**)hmacKey
+- (BOOL)writeBodyBytes:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError *__autoreleasing *)error
 {
-    int result = kCCSuccess;
+    CCHmacUpdate(&hmacContext, bytes, length);
+    return [armorWriter writeBytes:bytes length:length error:error];
+}
 
-    NSDate *startDate = [NSDate date];
+@end
 
-    NSData *passwordData = [password dataUsingEncoding:NSUTF8StringEncoding];
 
-    NSMutableData *derivedKey = [NSMutableData dataWithLength:64];
+#pragma mark - MXMegolmExportDecryptor
 
-    result =  CCKeyDerivationPBKDF(kCCPBKDF2,
-                                   passwordData.bytes,
-                                   passwordData.length,
-                                   salt.bytes,
-                                   salt.length,
-                                   kCCPRFHmacAlgSHA512,
-                                   (uint)iterations,
-                                   derivedKey.mutableBytes,
-                                   derivedKey.length);
+@implementation MXMegolmExportDecryptor
 
-    *aesKey = [derivedKey subdataWithRange:NSMakeRange(0, 32)];
-    *hmacKey = [derivedKey subdataWithRange:NSMakeRange(32, derivedKey.length - 32)];
+- (instancetype)initWithPassword:(NSString *)thePassword
+{
+    self = [super init];
+    if (self)
+    {
+        password = thePassword;
+        plainBuffer = [NSMutableData data];
+        [self reset];
+    }
+    return self;
+}
 
-    MXLogDebug(@"[MXMegolmExportEncryption] deriveKeys: %tu iterations took %.0fms", iterations, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+- (void)dealloc
+{
+    if (cryptor)
+    {
+        CCCryptorRelease(cryptor);
+    }
+}
 
-    return result;
+- (void)reset
+{
+    if (cryptor)
+    {
+        CCCryptorRelease(cryptor);
+        cryptor = NULL;
+    }
+    bodyHeader = [NSMutableData data];
+    tail = [NSMutableData data];
 }
 
-/**
- ascii-armour a megolm key file.
+- (BOOL)appendBytes:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError *__autoreleasing *)error
+{
+    // Body header
+    if (bodyHeader.length < kMXMegolmExportBodyHeaderLength)
+    {
+        NSUInteger headerBytesLength = MIN(length, kMXMegolmExportBodyHeaderLength - bodyHeader.length);
+        [bodyHeader appendBytes:bytes length:headerBytesLength];
+        bytes += headerBytesLength;
+        length -= headerBytesLength;
 
- base64s the content, and adds header and trailer lines.
+        if (bodyHeader.length && ((uint8_t*)bodyHeader.bytes)[0] != 1)
+        {
+            MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorInvalidKeyFileUnsupportedVersionCode, @"Unsupported version"));
+            return NO;
+        }
 
- @param data raw data.
- @return formatted data.
- */
-+ (NSData*)packMegolmKeyFile:(NSData*)data
-{
-    NSMutableArray<NSString*> *lines = [NSMutableArray array];
-    [lines addObject:MXMegolmExportEncryptionHeaderLine];
+        if (bodyHeader.length == kMXMegolmExportBodyHeaderLength && ![self startDecryption:error])
+        {
+            return NO;
+        }
+    }
 
-    // We split into lines before base64ing, because encodeBase64 doesn't deal
-    // terribly well with large arrays.
-    NSUInteger LINE_LENGTH = (72 * 4 / 3);
-    NSUInteger nLines = ceil((double)data.length / LINE_LENGTH);
-    NSUInteger o = 0;
+    if (!length)
+    {
+        return YES;
+    }
 
-    for (NSUInteger i = 0; i < nLines; i++)
+    // Hold back the last bytes as they may be the HMAC
+    [tail appendBytes:bytes length:length];
+    if (tail.length <= kMXMegolmExportHMACLength)
     {
-        NSUInteger len = MIN(LINE_LENGTH, data.length - o);
+        return YES;
+    }
 
-        NSData *lineData = [data subdataWithRange:NSMakeRange(o, len)];
-        [lines addObject:[lineData base64EncodedStringWithOptions:0]];
+    NSUInteger ciphertextLength = tail.length - kMXMegolmExportHMACLength;
+    CCHmacUpdate(&hmacContext, tail.bytes, ciphertextLength);
 
-        o += LINE_LENGTH;
-    }
+    if (_outputBlock)
+    {
+        plainBuffer.length = CCCryptorGetOutputLength(cryptor, ciphertextLength, false);
+
+        size_t outLength;
+        CCCryptorStatus status = CCCryptorUpdate(cryptor, tail.bytes, ciphertextLength, plainBuffer.mutableBytes, plainBuffer.length, &outLength);
+        if (status != kCCSuccess)
+        {
+            MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorCannotDecryptCode, @"Cannot decrypt"));
+            return NO;
+        }
 
-    [lines addObject:MXMegolmExportEncryptionTrailerLine];
-    [lines addObject:@""];
+        if (!_outputBlock(plainBuffer.bytes, outLength, error))
+        {
+            return NO;
+        }
+    }
 
-    return [[lines componentsJoinedByString:@"\n"] dataUsingEncoding:NSUTF8StringEncoding];
+    [tail replaceBytesInRange:NSMakeRange(0, ciphertextLength) withBytes:NULL length:0];
+    return YES;
 }
 
-/*
- Unbase64 an ascii-armoured megolm key file.
+- (BOOL)finish:(NSError *__autoreleasing *)error
+{
+    if (bodyHeader.length < kMXMegolmExportBodyHeaderLength || tail.length < kMXMegolmExportHMACLength)
+    {
+        MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorInvalidKeyFileTooShortCode, @"Invalid file: too short"));
+        return NO;
+    }
 
- Strips the header and trailer lines, and unbase64s the content.
+    // Check HMAC
+    NSMutableData *hash = [NSMutableData dataWithLength:kMXMegolmExportHMACLength];
+    CCHmacFinal(&hmacContext, hash.mutableBytes);
 
- @param data the input file.
- @param error the output error.
- @return unbase64ed content.
- */
-+ (NSData *)unpackMegolmKeyFile:(NSData*)data error:(NSError *__autoreleasing *)error
+    if (![hash isEqualToData:tail])
+    {
+        MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorAuthenticationFailedCode, @"Authentication check failed: incorrect password?"));
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)startDecryption:(NSError *__autoreleasing *)error
 {
-    // Parse the file as a great big String. This should be safe, because there
-    // should be no non-ASCII characters, and it means that we can do string
-    // comparisons to find the header and footer, and feed it into window.atob.
-    NSString *fileStr = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    const uint8_t *bodyHeaderBytes = bodyHeader.bytes;
 
-    NSArray* lines = [fileStr componentsSeparatedByCharactersInSet: [NSCharacterSet newlineCharacterSet]];
+    NSData *salt = [bodyHeader subdataWithRange:NSMakeRange(1, 16)];
+    NSData *iv = [bodyHeader subdataWithRange:NSMakeRange(17, 16)];
+    NSUInteger iterations = bodyHeaderBytes[33] << 24 | bodyHeaderBytes[34] << 16 | bodyHeaderBytes[35] << 8 | bodyHeaderBytes[36];
 
-    // Look for the start line
-    NSUInteger lineStart = 0;
-    for (lineStart = 0; lineStart < lines.count; lineStart++)
+    // Keys derivation is the costly part. Do it once for several passes
+    if (!aesKey || iterations != derivedKeysIterations || ![salt isEqualToData:derivedKeysSalt])
     {
-        NSString *line = lines[lineStart];
-
-        if ([line isEqualToString:MXMegolmExportEncryptionHeaderLine])
+        NSData *theAESKey, *theHMACKey;
+        if (kCCSuccess != [MXMegolmExportEncryption deriveKeys:salt iterations:iterations password:password progress:_kdfProgress aesKey:&theAESKey hmacKey:&theHMACKey])
         {
-            break;
+            MXMegolmExportSetError(error, _kdfProgress.isCancelled ? MXMegolmExportCancelledError() : MXMegolmExportError(MXMegolmExportErrorCannotDeriveKeysCode, @"Cannot derive keys"));
+            return NO;
         }
+        aesKey = theAESKey;
+        hmacKey = theHMACKey;
+        derivedKeysSalt = salt;
+        derivedKeysIterations = iterations;
+    }
+
+    CCCryptorStatus status = CCCryptorCreateWithMode(kCCDecrypt, kCCModeCTR, kCCAlgorithmAES,
+                                                     ccNoPadding, iv.bytes, aesKey.bytes, kCCKeySizeAES256,
+                                                     NULL, 0, 0, kCCModeOptionCTR_BE, &cryptor);
+    if (status != kCCSuccess)
+    {
+        cryptor = NULL;
+        MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorCannotInitialiseCryptorCode, @"Cannot initialise decryptor"));
+        return NO;
     }
 
-    if (lineStart == lines.count)
+    CCHmacInit(&hmacContext, kCCHmacAlgSHA256, hmacKey.bytes, hmacKey.length);
+    CCHmacUpdate(&hmacContext, bodyHeader.bytes, bodyHeader.length);
+
+    return YES;
+}
+
+@end
+
+
+#pragma mark - MXMegolmExportSessionParser
+
+@implementation MXMegolmExportSessionParser
+
+- (instancetype)initWithSessionBlock:(void (^)(NSDictionary *))theSessionBlock
+{
+    self = [super init];
+    if (self)
     {
-        *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                     code:MXMegolmExportErrorInvalidKeyFileHeaderNotFoundCode
-                                 userInfo:@{
-                                            NSLocalizedDescriptionKey: @"Header line not found",
-                                            }];
-        return nil;
+        sessionBlock = theSessionBlock;
+        element = [NSMutableData data];
     }
+    return self;
+}
 
-    // Look for the end line
-    NSUInteger lineEnd = 0;
-    for (lineEnd = lineStart + 1; lineEnd < lines.count; lineEnd++)
+- (BOOL)appendBytes:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError *__autoreleasing *)error
+{
+    for (NSUInteger index = 0; index < length; index++)
     {
-        NSString *line = lines[lineEnd];
+        uint8_t c = bytes[index];
+        BOOL isWhitespace = (c == ' ' || c == '\n' || c == '\r' || c == '\t');
 
-        if ([line isEqualToString:MXMegolmExportEncryptionTrailerLine])
+        if (ended || depth == 0)
         {
-            break;
+            if (isWhitespace)
+            {
+                continue;
+            }
+            if (!ended && c == '[')
+            {
+                depth = 1;
+                continue;
+            }
+            return [self failWithError:error];
         }
-    }
 
-    if (lineEnd == lines.count)
-    {
-        *error = [NSError errorWithDomain:MXMegolmExportEncryptionErrorDomain
-                                     code:MXMegolmExportErrorInvalidKeyFileTrailerNotFoundCode
-                                 userInfo:@{
-                                            NSLocalizedDescriptionKey: @"Trailer line not found",
-                                            }];
+        if (inString)
+        {
+            [element appendBytes:&c length:1];
+            if (escaped)
+            {
+                escaped = NO;
+            }
+            else if (c == '\\')
+            {
+                escaped = YES;
+            }
+            else if (c == '"')
+            {
+                inString = NO;
+            }
+            continue;
+        }
 
-        return nil;
-    }
+        if (depth == 1 && (c == ',' || c == ']'))
+        {
+            // End of a top-level element
+            // Only an empty array can have an empty element
+            BOOL isRequired = (c == ',' || elementsCount > 0);
+            if (![self flushElement:isRequired error:error])
+            {
+                return NO;
+            }
+            ended = (c == ']');
+            continue;
+        }
 
-    NSArray *contentLines = [lines subarrayWithRange:NSMakeRange(lineStart + 1, lineEnd - lineStart - 1)];
-    NSString *content = [contentLines componentsJoinedByString:@""];
+        if (c == '"')
+        {
+            inString = YES;
+        }
+        else if (c == '{' || c == '[')
+        {
+            depth++;
+        }
+        else if (c == '}' || c == ']')
+        {
+            depth--;
+        }
 
-    NSData *contentData = [[NSData alloc] initWithBase64EncodedString:content options:0];
+        if (!isWhitespace || depth > 1)
+        {
+            [element appendBytes:&c length:1];
+        }
+    }
 
-    return contentData;
+    return YES;
 }
 
-// @TODO: For dev. To remove
-+ (void)logBytesDec:(NSData*)data
+- (BOOL)finish:(NSError *__autoreleasing *)error
 {
-    uint8_t *bytes = (uint8_t*)data.bytes;
+    if (!ended)
+    {
+        return [self failWithError:error];
+    }
+    return YES;
+}
 
-    NSMutableString *s = [NSMutableString string];
-    for (NSUInteger i = 0; i < data.length; i++)
+- (BOOL)flushElement:(BOOL)isRequired error:(NSError *__autoreleasing *)error
+{
+    if (!element.length)
     {
-        [s appendFormat:@"%hhu, ", bytes[i]];
+        return isRequired ? [self failWithError:error] : YES;
     }
 
-    MXLogDebug(@"%tu bytes:\n%@", data.length, s);
+    BOOL isValid;
+    @autoreleasepool
+    {
+        NSDictionary *session = [NSJSONSerialization JSONObjectWithData:element options:0 error:nil];
+        isValid = [session isKindOfClass:NSDictionary.class];
+        if (isValid)
+        {
+            element.length = 0;
+            elementsCount++;
+            sessionBlock(session);
+        }
+    }
+
+    return isValid ? YES : [self failWithError:error];
+}
+
+- (BOOL)failWithError:(NSError *__autoreleasing *)error
+{
+    MXMegolmExportSetError(error, MXMegolmExportError(MXMegolmExportErrorInvalidSessionsCode, @"Invalid sessions JSON"));
+    return NO;
 }
 
 @end
@@ -32,7 +32,7 @@ class MXKeyVerificationManagerV2: NSObject, MXKeyVerificationManager {
     
     // A set of to-device events we have to monitor manually to synchronize CryptoMachine
     // and verification UI, optionally triggering global notifications.
-    private static let toDeviceEventTypes: Set<String> = [
+    static let toDeviceEventTypes: Set<String> = [
         kMXMessageTypeKeyVerificationRequest,
         kMXEventTypeStringKeyVerificationStart
     ]
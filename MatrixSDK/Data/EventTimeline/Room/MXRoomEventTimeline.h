@@ -49,6 +49,17 @@ FOUNDATION_EXPORT NSString *const kMXRoomInviteStateEventIdPrefix;
  */
 - (instancetype)initWithRoom:(MXRoom*)room initialEventId:(nullable NSString*)initialEventId andStore:(id<MXStore>)store;
 
+/**
+ The number of events to prepare beyond the back pagination position. Default is 0: no read-ahead.
+
+ After each back pagination, the timeline prepares the next events in the background, from the store
+ then from the homeserver. These events are stored and decrypted but listeners are notified only when
+ they are paginated. So, the next back pagination does not wait for a server round-trip.
+
+ The read-ahead is cancelled by `destroy` and `resetPagination`, or by setting this value to 0.
+ */
+@property (nonatomic) NSUInteger backPaginationReadAheadCount;
+
 @end
 
 NS_ASSUME_NONNULL_END
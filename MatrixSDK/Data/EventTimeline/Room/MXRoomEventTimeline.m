@@ -31,14 +31,15 @@
 #import "MXEventsEnumeratorOnArray.h"
 
 #import "MXRoomSync.h"
+#import "MXEventListenerDispatchTable.h"
 #import "MatrixSDKSwiftHeader.h"
 
 NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
 
 @interface MXRoomEventTimeline ()
 {
-    // The list of event listeners (`MXEventListener`) of this timeline.
-    NSMutableArray<MXEventListener *> *eventListeners;
+    // The event listeners (`MXEventListener`) of this timeline, by event type.
+    MXEventListenerDispatchTable *eventListeners;
 
     // The historical state of the room when paginating back.
     MXRoomState *backState;
@@ -67,6 +68,16 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
      The current pending request.
      */
     MXHTTPOperation *httpOperation;
+
+    // Events prepared beyond the back pagination position, in chronological order.
+    // They are stored and decrypted but they are not yet part of the timeline.
+    NSMutableArray<MXEvent*> *readAheadEvents;
+
+    // The pending read-ahead request to the homeserver
+    MXHTTPOperation *readAheadOperation;
+
+    // Back paginations waiting for the pending read-ahead request
+    NSMutableArray<dispatch_block_t> *readAheadWaitingBlocks;
 }
 @end
 
@@ -86,7 +97,9 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
     if (self)
     {
         _timelineId = [[NSUUID UUID] UUIDString];
-        eventListeners = [NSMutableArray array];
+        eventListeners = [[MXEventListenerDispatchTable alloc] init];
+        readAheadEvents = [NSMutableArray array];
+        readAheadWaitingBlocks = [NSMutableArray array];
     }
     return self;
 }
@@ -148,6 +161,10 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
         [httpOperation cancel];
         httpOperation = nil;
     }
+
+    // Paginations waiting for the read-ahead will never complete, like the ones cancelled above
+    [readAheadWaitingBlocks removeAllObjects];
+    [self resetReadAhead];
     
     if (!_isLiveTimeline && !store.isPermanent)
     {
@@ -168,6 +185,7 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
         //  - did we end to paginate from the MXStore?
         //  - did we reach the top of the pagination in our requests to the home server?
         canPaginate = (0 < storeMessagesEnumerator.remaining)
+            || (0 < readAheadEvents.count)
             || ![store hasReachedHomeServerPaginationEndForRoom:_state.roomId];
     }
     else
@@ -193,6 +211,9 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
 
     // Reset store pagination
     storeMessagesEnumerator = [store messagesEnumeratorForRoom:_state.roomId];
+
+    // Events prepared by the read-ahead are in the store, so in the new enumerator
+    [self resetReadAhead];
 }
 
 - (MXHTTPOperation *)resetPaginationAroundInitialEventWithLimit:(NSUInteger)limit success:(void (^)(void))success failure:(void (^)(NSError *))failure
@@ -252,8 +273,17 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
 {
     if (direction == MXTimelineDirectionBackwards)
     {
-        // For back pagination, try to get messages from the store first
-        NSArray<MXEvent *> *eventsFromStore = [storeMessagesEnumerator nextEventsBatch:numItems threadId:nil];
+        // For back pagination, try to get messages from the store first,
+        // starting by the ones already prepared by the read-ahead
+        NSArray<MXEvent *> *eventsFromStore = [self takeReadAheadEvents:numItems];
+        if (eventsFromStore.count < numItems)
+        {
+            NSArray<MXEvent *> *eventsFromEnumerator = [storeMessagesEnumerator nextEventsBatch:numItems - eventsFromStore.count threadId:nil];
+            if (eventsFromEnumerator.count)
+            {
+                eventsFromStore = [eventsFromEnumerator arrayByAddingObjectsFromArray:eventsFromStore];
+            }
+        }
         
         // messagesFromStore are in chronological order
         // Handle events from the most recent
@@ -281,6 +311,34 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
     NSAssert(!(_isLiveTimeline && direction == MXTimelineDirectionForwards), @"Cannot paginate forwards on a live timeline");
     
     MXWeakify(self);
+
+    if (direction == MXTimelineDirectionBackwards && !onlyFromStore && readAheadOperation
+        && numItems > readAheadEvents.count + storeMessagesEnumerator.remaining)
+    {
+        // The read-ahead is already requesting the next events to the homeserver. Wait for them
+        MXLogDebug(@"[MXRoomEventTimeline] paginate: wait for the read-ahead");
+        [readAheadWaitingBlocks addObject:^{
+            MXStrongifyAndReturnIfNil(self);
+            if (!operation.isCancelled)
+            {
+                [operation mutateTo:[self paginate:numItems direction:direction onlyFromStore:onlyFromStore complete:complete failure:failure]];
+            }
+        }];
+        return operation;
+    }
+
+    if (direction == MXTimelineDirectionBackwards && _backPaginationReadAheadCount)
+    {
+        // Prepare the next events once these ones are in the timeline.
+        // Start before informing the caller so that its next pagination can wait for them
+        void (^paginationComplete)(void) = complete;
+        complete = ^{
+            [weakself readAheadIfNeeded];
+
+            paginationComplete();
+        };
+    }
+
     [self paginateFromStore:numItems direction:direction onComplete:^(NSArray<MXEvent *> *eventsFromStore) {
         MXStrongifyAndReturnIfNil(self);
         
@@ -291,10 +349,12 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
         {
             // messagesFromStore are in chronological order
             // Handle events from the most recent
+            [self->room.mxSession.aggregations beginBatch];
             for (MXEvent *event in eventsFromStore.reverseObjectEnumerator)
             {
                 [self addEvent:event direction:MXTimelineDirectionBackwards fromStore:YES isRoomInitialSync:NO];
             }
+            [self->room.mxSession.aggregations endBatch];
             
             remainingNumItems -= eventsFromStoreCount;
                 
@@ -421,7 +481,219 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
 
 - (NSUInteger)remainingMessagesForBackPaginationInStore
 {
-    return storeMessagesEnumerator.remaining;
+    return storeMessagesEnumerator.remaining + readAheadEvents.count;
+}
+
+
+#pragma mark - Back pagination read-ahead
+
+- (void)setBackPaginationReadAheadCount:(NSUInteger)backPaginationReadAheadCount
+{
+    _backPaginationReadAheadCount = backPaginationReadAheadCount;
+
+    if (!backPaginationReadAheadCount)
+    {
+        // Prepared events stay available for the next paginations
+        [self cancelReadAheadRequest];
+    }
+}
+
+/**
+ Prepare events beyond the back pagination position, up to `backPaginationReadAheadCount`.
+
+ Events are taken from the store first. Then they are requested to the homeserver and stored.
+ */
+- (void)readAheadIfNeeded
+{
+    if (!_backPaginationReadAheadCount || readAheadOperation || !backState)
+    {
+        return;
+    }
+
+    if (readAheadEvents.count >= _backPaginationReadAheadCount)
+    {
+        return;
+    }
+    NSUInteger missingEventsCount = _backPaginationReadAheadCount - readAheadEvents.count;
+
+    if (storeMessagesEnumerator.remaining)
+    {
+        NSArray<MXEvent *> *eventsFromStore = [storeMessagesEnumerator nextEventsBatch:missingEventsCount threadId:nil];
+        if (eventsFromStore.count)
+        {
+            MXLogDebug(@"[MXRoomEventTimeline] readAheadIfNeeded: prepare %tu events from the store", eventsFromStore.count);
+
+            [self addReadAheadEvents:eventsFromStore];
+            [self decryptEvents:eventsFromStore onComplete:^{}];
+
+            missingEventsCount -= MIN(missingEventsCount, eventsFromStore.count);
+        }
+    }
+
+    if (!missingEventsCount || storeMessagesEnumerator.remaining
+        || [store hasReachedHomeServerPaginationEndForRoom:_state.roomId])
+    {
+        return;
+    }
+
+    NSString *paginationToken = [store paginationTokenOfRoom:_state.roomId] ?: @"END";
+
+    MXLogDebug(@"[MXRoomEventTimeline] readAheadIfNeeded: request %tu events from the server", missingEventsCount);
+
+    MXHTTPOperation *operation = [MXHTTPOperation new];
+    readAheadOperation = operation;
+
+    MXWeakify(self);
+    MXHTTPOperation *request = [room.mxSession.matrixRestClient messagesForRoom:_state.roomId from:paginationToken direction:MXTimelineDirectionBackwards limit:missingEventsCount filter:_roomEventFilter success:^(MXPaginationResponse *paginatedResponse) {
+        MXStrongifyAndReturnIfNil(self);
+
+        // Ignore responses of cancelled requests
+        if (self->readAheadOperation != operation)
+        {
+            return;
+        }
+
+        MXLogDebug(@"[MXRoomEventTimeline] readAheadIfNeeded: got %tu events from the server", paginatedResponse.chunk.count);
+        [self handleReadAheadResponse:paginatedResponse];
+
+    } failure:^(NSError *error) {
+        MXStrongifyAndReturnIfNil(self);
+
+        if (self->readAheadOperation != operation)
+        {
+            return;
+        }
+
+        MXError *mxError = [[MXError alloc] initWithNSError:error];
+        if (mxError && [mxError.error isEqualToString:kMXErrorStringInvalidToken])
+        {
+            [self->store storeHasReachedHomeServerPaginationEndForRoom:self->_state.roomId andValue:YES];
+        }
+        else
+        {
+            // The pagination requested by the consumer will retry
+            MXLogDebug(@"[MXRoomEventTimeline] readAheadIfNeeded: request failed");
+        }
+
+        [self endReadAheadRequest];
+    }];
+
+    // The read-ahead is opportunistic. It is the consumer pagination that retries
+    request.maxNumberOfTries = 1;
+    [operation mutateTo:request];
+}
+
+- (void)handleReadAheadResponse:(MXPaginationResponse*)paginatedResponse
+{
+    // Check if the room has not been left while waiting for the response
+    if (![room.mxSession hasRoomWithRoomId:room.roomId]
+        && ![room.mxSession isPeekingInRoomWithRoomId:room.roomId])
+    {
+        [self endReadAheadRequest];
+        return;
+    }
+
+    // Check pagination end, like in handlePaginationResponse
+    if (paginatedResponse.chunk.count == 0 && (paginatedResponse.end == nil || [paginatedResponse.start isEqualToString:paginatedResponse.end]))
+    {
+        [store storeHasReachedHomeServerPaginationEndForRoom:_state.roomId andValue:YES];
+    }
+
+    // Handle lazy loaded members now, with the storage of their events: prepared events may be
+    // dropped before being paginated. Only unknown members are added to the root state
+    if (paginatedResponse.state.count)
+    {
+        [self handlePaginationStateEvents:paginatedResponse.state direction:MXTimelineDirectionBackwards];
+    }
+
+    // Store events now so that the pagination token stays consistent with the store content.
+    // They are added to the timeline when they are paginated, as events from the store
+    NSMutableArray<MXEvent *> *events = [NSMutableArray arrayWithCapacity:paginatedResponse.chunk.count];
+    for (MXEvent *event in paginatedResponse.chunk)
+    {
+        if (![store eventExistsWithEventId:event.eventId inRoom:_state.roomId])
+        {
+            [store storeEventForRoom:_state.roomId event:event direction:MXTimelineDirectionBackwards];
+            [events insertObject:event atIndex:0];
+        }
+    }
+    [store storePaginationTokenOfRoom:_state.roomId andToken:paginatedResponse.end];
+
+    if ([store respondsToSelector:@selector(commit)])
+    {
+        [store commit];
+    }
+
+    MXHTTPOperation *operation = readAheadOperation;
+
+    MXWeakify(self);
+    [self decryptEvents:events onComplete:^{
+        MXStrongifyAndReturnIfNil(self);
+
+        // Check the read-ahead has not been reset in the meantime
+        if (self->readAheadOperation != operation)
+        {
+            return;
+        }
+
+        [self addReadAheadEvents:events];
+        [self endReadAheadRequest];
+    }];
+}
+
+- (void)addReadAheadEvents:(NSArray<MXEvent *> *)events
+{
+    // Events are prepared from the most recent to the oldest
+    [readAheadEvents insertObjects:events atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, events.count)]];
+}
+
+/**
+ Take the most recent events prepared by the read-ahead.
+
+ @param numItems the maximum number of events to take.
+ @return the events in chronological order.
+ */
+- (NSArray<MXEvent *> *)takeReadAheadEvents:(NSUInteger)numItems
+{
+    NSUInteger count = MIN(numItems, readAheadEvents.count);
+    NSRange range = NSMakeRange(readAheadEvents.count - count, count);
+
+    NSArray<MXEvent *> *events = [readAheadEvents subarrayWithRange:range];
+    [readAheadEvents removeObjectsInRange:range];
+    return events;
+}
+
+/**
+ Cancel the pending read-ahead request, if any.
+ */
+- (void)cancelReadAheadRequest
+{
+    [readAheadOperation cancel];
+    [self endReadAheadRequest];
+}
+
+/**
+ Forget the read-ahead request and let the paginations waiting for it go on.
+ */
+- (void)endReadAheadRequest
+{
+    readAheadOperation = nil;
+
+    NSArray<dispatch_block_t> *waitingBlocks = readAheadWaitingBlocks;
+    readAheadWaitingBlocks = [NSMutableArray array];
+    for (dispatch_block_t block in waitingBlocks)
+    {
+        block();
+    }
+}
+
+/**
+ Cancel the read-ahead and forget the events it prepared.
+ */
+- (void)resetReadAhead
+{
+    [readAheadEvents removeAllObjects];
+    [self cancelReadAheadRequest];
 }
 
 
@@ -513,6 +785,10 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
             {
                 // Flush the existing messages for this room by keeping state events.
                 [self->store deleteAllMessagesInRoom:self.state.roomId];
+
+                // Prepared events have been flushed too. A pending read-ahead would store events
+                // and a pagination token from before the gap
+                [self resetReadAhead];
             }
             
             for (MXEvent *event in roomSync.timeline.events)
@@ -605,28 +881,7 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
     // Process additional state events (this happens in case of lazy loading)
     if (paginatedResponse.state.count)
     {
-        if (direction == MXTimelineDirectionBackwards)
-        {
-            // Enrich the timeline root state with the additional state events observed during back pagination.
-            // Check that it is a member state event (it should always be the case) and
-            // that this memeber is not already known in our live room state
-            NSMutableArray<MXEvent *> *selectedStateEvents = [NSMutableArray array];
-            for (MXEvent *stateEvent in paginatedResponse.state)
-            {
-                if ((stateEvent.eventType == MXEventTypeRoomMember)
-                    && ![_state.members memberWithUserId: stateEvent.stateKey]) {
-                    [selectedStateEvents addObject:stateEvent];
-                }
-            }
-            
-            if (selectedStateEvents.count)
-            {
-                [self handleStateEvents:selectedStateEvents direction:MXTimelineDirectionForwards];
-            }
-        }
-
-        // Enrich intermediate room state while paginating
-        [self handleStateEvents:paginatedResponse.state  direction:direction];
+        [self handlePaginationStateEvents:paginatedResponse.state direction:direction];
     }
     
     MXWeakify(self);
@@ -634,11 +889,14 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
         MXStrongifyAndReturnIfNil(self);
         
         // Process received events
+        // Their aggregation updates are written at once
+        [self->room.mxSession.aggregations beginBatch];
         for (MXEvent *event in paginatedResponse.chunk)
         {
             // Make sure we have not processed this event yet
             [self addEvent:event direction:direction fromStore:NO isRoomInitialSync:NO];
         }
+        [self->room.mxSession.aggregations endBatch];
         
         // And update pagination tokens
         if (direction == MXTimelineDirectionBackwards)
@@ -660,6 +918,38 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
     }];
 }
 
+/**
+ Handle lazy loaded state events received with paginated events.
+
+ @param stateEvents the state events.
+ @param direction the pagination direction.
+ */
+- (void)handlePaginationStateEvents:(NSArray<MXEvent *> *)stateEvents direction:(MXTimelineDirection)direction
+{
+    if (direction == MXTimelineDirectionBackwards)
+    {
+        // Enrich the timeline root state with the additional state events observed during back pagination.
+        // Check that it is a member state event (it should always be the case) and
+        // that this memeber is not already known in our live room state
+        NSMutableArray<MXEvent *> *selectedStateEvents = [NSMutableArray array];
+        for (MXEvent *stateEvent in stateEvents)
+        {
+            if ((stateEvent.eventType == MXEventTypeRoomMember)
+                && ![_state.members memberWithUserId: stateEvent.stateKey]) {
+                [selectedStateEvents addObject:stateEvent];
+            }
+        }
+        
+        if (selectedStateEvents.count)
+        {
+            [self handleStateEvents:selectedStateEvents direction:MXTimelineDirectionForwards];
+        }
+    }
+
+    // Enrich intermediate room state while paginating
+    [self handleStateEvents:stateEvents direction:direction];
+}
+
 
 #pragma mark - Timeline events
 /**
@@ -741,35 +1031,27 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
     // Check whether the current room state depends on this redacted event.
     if (!redactedEvent || redactedEvent.isState)
     {
-        NSMutableArray *stateEvents = [NSMutableArray arrayWithArray:_state.stateEvents];
-        
-        for (NSInteger index = 0; index < stateEvents.count; index++)
+        MXEvent *stateEvent = [_state stateEventWithEventId:redactionEvent.redacts];
+        if (stateEvent)
         {
-            MXEvent *stateEvent = stateEvents[index];
-            
-            if ([stateEvent.eventId isEqualToString:redactionEvent.redacts])
-            {
-                MXLogDebug(@"[MXRoomEventTimeline] handleRedaction: the current room state has been modified by the event redaction.");
-                
-                // Redact the stored event
-                redactedEvent = [stateEvent prune];
-                redactedEvent.redactedBecause = redactionEvent.JSONDictionary;
-                
-                [stateEvents replaceObjectAtIndex:index withObject:redactedEvent];
-                
-                // Reset the room state.
-                _state = [[MXRoomState alloc] initWithRoomId:room.roomId andMatrixSession:room.mxSession andDirection:YES];
-                [self initialiseState:stateEvents];
-                
-                // Reset the current pagination
-                [self resetPagination];
-                
-                // Notify that room history has been flushed
-                [[NSNotificationCenter defaultCenter] postNotificationName:kMXRoomDidFlushDataNotification
-                                                                    object:room
-                                                                  userInfo:nil];
-                return;
-            }
+            MXLogDebug(@"[MXRoomEventTimeline] handleRedaction: the current room state has been modified by the event redaction.");
+
+            // Redact the state event
+            redactedEvent = [stateEvent prune];
+            redactedEvent.redactedBecause = redactionEvent.JSONDictionary;
+
+            // Update a copy of the state, like for any state change
+            [self cloneState:MXTimelineDirectionForwards];
+            [_state handleRedactedStateEvent:redactedEvent];
+
+            // Update summary with this state event update
+            [room.summary handleStateEvents:@[redactedEvent]];
+
+            // Notify only this change. There is no need to reload the room history
+            [[NSNotificationCenter defaultCenter] postNotificationName:kMXRoomDidRedactStateEventNotification
+                                                                object:room
+                                                              userInfo:@{kMXRoomNotificationRedactedEventKey: redactedEvent}];
+            return;
         }
     }
 
@@ -888,19 +1170,19 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
 {
     MXEventListener *listener = [[MXEventListener alloc] initWithSender:self andEventTypes:types andListenerBlock:onEvent];
 
-    [eventListeners addObject:listener];
+    [eventListeners addListener:listener];
 
     return listener;
 }
 
 - (void)removeListener:(MXEventListener *)listener
 {
-    [eventListeners removeObject:listener];
+    [eventListeners removeListener:listener];
 }
 
 - (void)removeAllListeners
 {
-    [eventListeners removeAllObjects];
+    [eventListeners removeAllListeners];
 }
 
 - (void)notifyListeners:(MXEvent*)event direction:(MXTimelineDirection)direction
@@ -924,15 +1206,15 @@ NSString *const kMXRoomInviteStateEventIdPrefix = @"invite-";
         }
     }
 
-    // Notify all listeners
+    // Notify the listeners of this event type
     // The SDK client may remove a listener while calling them by enumeration
     // So, use a copy of them
-    NSArray<MXEventListener *> *listeners = [eventListeners copy];
+    NSArray<MXEventListener *> *listeners = [eventListeners listenersForEvent:event];
 
     for (MXEventListener *listener in listeners)
     {
         // And check the listener still exists before calling it
-        if (NSNotFound != [eventListeners indexOfObject:listener])
+        if ([eventListeners containsListener:listener])
         {
             [listener notify:event direction:direction andCustomObject:roomState];
         }
@@ -0,0 +1,170 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MXEvent;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Priority classes of decryption work. Work of a higher class always starts first.
+ */
+typedef NS_ENUM(NSUInteger, MXDecryptionPriority) {
+    /**
+     Rooms whose timeline is displayed.
+     */
+    MXDecryptionPriorityVisible,
+    /**
+     Rooms displayed in the room list, whose last message is previewed.
+     */
+    MXDecryptionPriorityPreview,
+    /**
+     Other rooms. This is the default priority.
+     */
+    MXDecryptionPriorityBacklog,
+};
+
+/**
+ The number of `MXDecryptionPriority` values.
+ */
+FOUNDATION_EXPORT NSUInteger const MXDecryptionPriorityCount;
+
+/**
+ Block that decrypts a chunk of events.
+
+ @param events the events to decrypt.
+ @param onComplete the block to call once the events are decrypted.
+ */
+typedef void (^MXDecryptionSchedulerChunkBlock)(NSArray<MXEvent*> *events, dispatch_block_t onComplete);
+
+
+/**
+ A snapshot of the decryption work of a priority class.
+ */
+@interface MXDecryptionSchedulerMetrics : NSObject
+
+/**
+ The priority class.
+ */
+@property (nonatomic, readonly) MXDecryptionPriority priority;
+
+/**
+ The number of queued jobs and the number of events they contain.
+ */
+@property (nonatomic, readonly) NSUInteger queuedJobsCount;
+@property (nonatomic, readonly) NSUInteger queuedEventsCount;
+
+/**
+ The number of jobs completed since the creation of the scheduler or the last `resetMetrics`.
+ */
+@property (nonatomic, readonly) NSUInteger completedJobsCount;
+
+/**
+ The average and the maximum time between the submission and the completion of jobs, in milliseconds.
+ */
+@property (nonatomic, readonly) NSUInteger averageLatency;
+@property (nonatomic, readonly) NSUInteger maxLatency;
+
+@end
+
+
+/**
+ `MXDecryptionScheduler` orders the decryption of events across all rooms of a session.
+
+ - A bounded number of chunks of events are decrypted at the same time.
+ - Jobs are split into chunks. Between two chunks, the jobs of rooms with a higher priority go first.
+ - Jobs of a room are decrypted one at a time, in their submission order.
+ - Changing the priority of a room moves its queued jobs.
+
+ It must be used from the main thread.
+ */
+@interface MXDecryptionScheduler : NSObject
+
+/**
+ Create a scheduler.
+
+ @param maxConcurrentChunks the maximum number of chunks decrypted at the same time.
+ @param chunkSize the maximum number of events in a chunk.
+ @return a `MXDecryptionScheduler` instance.
+ */
+- (instancetype)initWithMaxConcurrentChunks:(NSUInteger)maxConcurrentChunks chunkSize:(NSUInteger)chunkSize;
+
+/**
+ The maximum number of chunks decrypted at the same time.
+ */
+@property (nonatomic, readonly) NSUInteger maxConcurrentChunks;
+
+/**
+ The maximum number of events in a chunk.
+ */
+@property (nonatomic, readonly) NSUInteger chunkSize;
+
+/**
+ The number of chunks being decrypted.
+ */
+@property (nonatomic, readonly) NSUInteger runningChunksCount;
+
+/**
+ Submit a decryption job.
+
+ @param events the events to decrypt.
+ @param roomId the room of the events.
+ @param chunkBlock the block that decrypts each chunk of events.
+ @param onComplete the block called once all events are decrypted.
+ */
+- (void)decryptEvents:(NSArray<MXEvent*> *)events
+               inRoom:(NSString*)roomId
+           chunkBlock:(MXDecryptionSchedulerChunkBlock)chunkBlock
+           onComplete:(dispatch_block_t)onComplete;
+
+/**
+ Set the priority of a room. Its queued jobs are moved to the new priority class.
+
+ @param priority the priority.
+ @param roomId the room id.
+ */
+- (void)setPriority:(MXDecryptionPriority)priority forRoom:(NSString*)roomId;
+
+/**
+ Get the priority of a room.
+
+ @param roomId the room id.
+ @return the priority. `MXDecryptionPriorityBacklog` by default.
+ */
+- (MXDecryptionPriority)priorityForRoom:(NSString*)roomId;
+
+/**
+ Set all rooms back to `MXDecryptionPriorityBacklog`.
+ */
+- (void)resetPriorities;
+
+/**
+ Get the metrics of a priority class.
+
+ @param priority the priority class.
+ @return a snapshot of its decryption work.
+ */
+- (MXDecryptionSchedulerMetrics*)metricsForPriority:(MXDecryptionPriority)priority;
+
+/**
+ Reset the counters of all priority classes.
+ */
+- (void)resetMetrics;
+
+@end
+
+NS_ASSUME_NONNULL_END
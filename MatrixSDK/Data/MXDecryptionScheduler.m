@@ -0,0 +1,328 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXDecryptionScheduler.h"
+
+#import "MXLog.h"
+#import "MXTools.h"
+
+NSUInteger const MXDecryptionPriorityCount = MXDecryptionPriorityBacklog + 1;
+
+
+#pragma mark - MXDecryptionSchedulerMetrics
+
+@interface MXDecryptionSchedulerMetrics ()
+
+@property (nonatomic, readwrite) MXDecryptionPriority priority;
+@property (nonatomic, readwrite) NSUInteger queuedJobsCount;
+@property (nonatomic, readwrite) NSUInteger queuedEventsCount;
+@property (nonatomic, readwrite) NSUInteger completedJobsCount;
+@property (nonatomic, readwrite) NSUInteger averageLatency;
+@property (nonatomic, readwrite) NSUInteger maxLatency;
+
+@end
+
+@implementation MXDecryptionSchedulerMetrics
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<MXDecryptionSchedulerMetrics: priority: %@, queued: %@ jobs (%@ events), completed: %@, latency: avg %@ms, max %@ms>",
+            @(_priority), @(_queuedJobsCount), @(_queuedEventsCount), @(_completedJobsCount), @(_averageLatency), @(_maxLatency)];
+}
+
+@end
+
+
+#pragma mark - MXDecryptionJob
+
+@interface MXDecryptionJob : NSObject
+
+@property (nonatomic) NSUInteger sequenceNumber;
+@property (nonatomic) NSString *roomId;
+@property (nonatomic) NSArray<MXEvent*> *events;
+@property (nonatomic) NSUInteger nextEventIndex;
+@property (nonatomic, copy) MXDecryptionSchedulerChunkBlock chunkBlock;
+@property (nonatomic, copy) dispatch_block_t onComplete;
+@property (nonatomic) NSDate *submissionDate;
+
+@end
+
+@implementation MXDecryptionJob
+@end
+
+
+#pragma mark - MXDecryptionScheduler
+
+@interface MXDecryptionScheduler ()
+{
+    // Queued jobs by priority, in submission order
+    NSArray<NSMutableArray<MXDecryptionJob*>*> *queues;
+
+    // Rooms with a chunk being decrypted
+    NSMutableSet<NSString*> *busyRooms;
+
+    // Priorities of rooms that are not in the backlog
+    NSMutableDictionary<NSString*, NSNumber*> *roomPriorities;
+
+    NSUInteger nextSequenceNumber;
+    BOOL isScheduling;
+
+    // Metrics by priority
+    NSUInteger completedJobsCounts[MXDecryptionPriorityBacklog + 1];
+    NSTimeInterval totalLatencies[MXDecryptionPriorityBacklog + 1];
+    NSTimeInterval maxLatencies[MXDecryptionPriorityBacklog + 1];
+}
+@end
+
+@implementation MXDecryptionScheduler
+
+- (instancetype)initWithMaxConcurrentChunks:(NSUInteger)maxConcurrentChunks chunkSize:(NSUInteger)chunkSize
+{
+    self = [super init];
+    if (self)
+    {
+        _maxConcurrentChunks = MAX(maxConcurrentChunks, 1);
+        _chunkSize = MAX(chunkSize, 1);
+
+        NSMutableArray *theQueues = [NSMutableArray arrayWithCapacity:MXDecryptionPriorityCount];
+        for (NSUInteger priority = 0; priority < MXDecryptionPriorityCount; priority++)
+        {
+            [theQueues addObject:[NSMutableArray array]];
+        }
+        queues = theQueues;
+        busyRooms = [NSMutableSet set];
+        roomPriorities = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (void)decryptEvents:(NSArray<MXEvent *> *)events
+               inRoom:(NSString *)roomId
+           chunkBlock:(MXDecryptionSchedulerChunkBlock)chunkBlock
+           onComplete:(dispatch_block_t)onComplete
+{
+    if (!events.count)
+    {
+        onComplete();
+        return;
+    }
+
+    MXDecryptionJob *job = [MXDecryptionJob new];
+    job.sequenceNumber = nextSequenceNumber++;
+    job.roomId = roomId ?: @"";
+    job.events = events;
+    job.chunkBlock = chunkBlock;
+    job.onComplete = onComplete;
+    job.submissionDate = [NSDate date];
+
+    [queues[[self priorityForRoom:job.roomId]] addObject:job];
+    [self scheduleChunks];
+}
+
+- (void)setPriority:(MXDecryptionPriority)priority forRoom:(NSString *)roomId
+{
+    MXDecryptionPriority currentPriority = [self priorityForRoom:roomId];
+    if (priority == currentPriority)
+    {
+        return;
+    }
+
+    MXLogDebug(@"[MXDecryptionScheduler] setPriority: %@ for room %@", @(priority), roomId);
+
+    if (priority == MXDecryptionPriorityBacklog)
+    {
+        [roomPriorities removeObjectForKey:roomId];
+    }
+    else
+    {
+        roomPriorities[roomId] = @(priority);
+    }
+
+    // Move queued jobs of the room
+    NSMutableArray<MXDecryptionJob*> *currentQueue = queues[currentPriority];
+    NSIndexSet *indexes = [currentQueue indexesOfObjectsPassingTest:^BOOL(MXDecryptionJob *job, NSUInteger idx, BOOL *stop) {
+        return [job.roomId isEqualToString:roomId];
+    }];
+    if (indexes.count)
+    {
+        NSArray<MXDecryptionJob*> *jobs = [currentQueue objectsAtIndexes:indexes];
+        [currentQueue removeObjectsAtIndexes:indexes];
+        for (MXDecryptionJob *job in jobs)
+        {
+            [self enqueueJob:job];
+        }
+    }
+}
+
+- (MXDecryptionPriority)priorityForRoom:(NSString *)roomId
+{
+    NSNumber *priority = roomPriorities[roomId];
+    return priority ? priority.unsignedIntegerValue : MXDecryptionPriorityBacklog;
+}
+
+- (void)resetPriorities
+{
+    for (NSString *roomId in roomPriorities.allKeys)
+    {
+        [self setPriority:MXDecryptionPriorityBacklog forRoom:roomId];
+    }
+}
+
+- (MXDecryptionSchedulerMetrics *)metricsForPriority:(MXDecryptionPriority)priority
+{
+    MXDecryptionSchedulerMetrics *metrics = [MXDecryptionSchedulerMetrics new];
+    metrics.priority = priority;
+    metrics.queuedJobsCount = queues[priority].count;
+
+    NSUInteger queuedEventsCount = 0;
+    for (MXDecryptionJob *job in queues[priority])
+    {
+        queuedEventsCount += job.events.count - job.nextEventIndex;
+    }
+    metrics.queuedEventsCount = queuedEventsCount;
+
+    metrics.completedJobsCount = completedJobsCounts[priority];
+    if (completedJobsCounts[priority])
+    {
+        metrics.averageLatency = totalLatencies[priority] * 1000 / completedJobsCounts[priority];
+    }
+    metrics.maxLatency = maxLatencies[priority] * 1000;
+    return metrics;
+}
+
+- (void)resetMetrics
+{
+    for (NSUInteger priority = 0; priority < MXDecryptionPriorityCount; priority++)
+    {
+        completedJobsCounts[priority] = 0;
+        totalLatencies[priority] = 0;
+        maxLatencies[priority] = 0;
+    }
+}
+
+#pragma mark - Private
+
+/**
+ Insert a job in the queue of its room priority, keeping the submission order.
+ */
+- (void)enqueueJob:(MXDecryptionJob*)job
+{
+    NSMutableArray<MXDecryptionJob*> *queue = queues[[self priorityForRoom:job.roomId]];
+    NSUInteger index = [queue indexOfObject:job
+                              inSortedRange:NSMakeRange(0, queue.count)
+                                    options:NSBinarySearchingInsertionIndex
+                            usingComparator:^NSComparisonResult(MXDecryptionJob *job1, MXDecryptionJob *job2) {
+        if (job1.sequenceNumber == job2.sequenceNumber)
+        {
+            return NSOrderedSame;
+        }
+        return job1.sequenceNumber < job2.sequenceNumber ? NSOrderedAscending : NSOrderedDescending;
+    }];
+    [queue insertObject:job atIndex:index];
+}
+
+/**
+ Take the first job of the highest priority whose room is not busy.
+ */
+- (MXDecryptionJob*)dequeueNextJob
+{
+    for (NSMutableArray<MXDecryptionJob*> *queue in queues)
+    {
+        for (NSUInteger index = 0; index < queue.count; index++)
+        {
+            MXDecryptionJob *job = queue[index];
+            if (![busyRooms containsObject:job.roomId])
+            {
+                [queue removeObjectAtIndex:index];
+                return job;
+            }
+        }
+    }
+    return nil;
+}
+
+- (void)scheduleChunks
+{
+    // Completion blocks called synchronously from the loop must not start a nested loop
+    if (isScheduling)
+    {
+        return;
+    }
+    isScheduling = YES;
+
+    while (_runningChunksCount < _maxConcurrentChunks)
+    {
+        MXDecryptionJob *job = [self dequeueNextJob];
+        if (!job)
+        {
+            break;
+        }
+        [self runNextChunkOfJob:job];
+    }
+
+    isScheduling = NO;
+}
+
+- (void)runNextChunkOfJob:(MXDecryptionJob*)job
+{
+    NSRange range = NSMakeRange(job.nextEventIndex, MIN(_chunkSize, job.events.count - job.nextEventIndex));
+    NSArray<MXEvent*> *chunk = [job.events subarrayWithRange:range];
+
+    _runningChunksCount++;
+    [busyRooms addObject:job.roomId];
+
+    __block BOOL completed = NO;
+    MXWeakify(self);
+    job.chunkBlock(chunk, ^{
+        MXStrongifyAndReturnIfNil(self);
+
+        if (completed)
+        {
+            MXLogError(@"[MXDecryptionScheduler] Chunk already completed in room %@", job.roomId);
+            return;
+        }
+        completed = YES;
+
+        self->_runningChunksCount--;
+        [self->busyRooms removeObject:job.roomId];
+        job.nextEventIndex = NSMaxRange(range);
+
+        if (job.nextEventIndex < job.events.count)
+        {
+            // Let jobs with a higher priority go before the next chunk
+            [self enqueueJob:job];
+        }
+        else
+        {
+            [self recordCompletionOfJob:job];
+            job.onComplete();
+        }
+
+        [self scheduleChunks];
+    });
+}
+
+- (void)recordCompletionOfJob:(MXDecryptionJob*)job
+{
+    MXDecryptionPriority priority = [self priorityForRoom:job.roomId];
+    NSTimeInterval latency = -job.submissionDate.timeIntervalSinceNow;
+
+    completedJobsCounts[priority]++;
+    totalLatencies[priority] += latency;
+    maxLatencies[priority] = MAX(maxLatencies[priority], latency);
+}
+
+@end
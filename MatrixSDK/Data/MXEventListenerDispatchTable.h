@@ -0,0 +1,74 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MXEventListener.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ `MXEventListenerDispatchTable` stores event listeners by the event types they listen to.
+
+ Listeners registered without event types go to a wildcard bucket.
+ Getting the listeners of an event costs the number of listeners that match it, not the
+ number of registered listeners. Listeners are always returned in registration order.
+ */
+@interface MXEventListenerDispatchTable : NSObject
+
+/**
+ All listeners, in registration order.
+ */
+@property (nonatomic, readonly) NSArray<MXEventListener*> *listeners;
+
+/**
+ Add a listener.
+
+ @param listener the listener to add.
+ */
+- (void)addListener:(MXEventListener*)listener;
+
+/**
+ Remove a listener.
+
+ @param listener the listener to remove.
+ */
+- (void)removeListener:(MXEventListener*)listener;
+
+/**
+ Remove all listeners.
+ */
+- (void)removeAllListeners;
+
+/**
+ Check whether a listener is registered.
+
+ @param listener the listener.
+ @return YES if it is registered.
+ */
+- (BOOL)containsListener:(MXEventListener*)listener;
+
+/**
+ Get the listeners that listen to the type of an event.
+
+ @param event the event.
+ @return the listeners registered for the event type and the wildcard ones, in registration order.
+ */
+- (NSArray<MXEventListener*>*)listenersForEvent:(MXEvent*)event;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,166 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXEventListenerDispatchTable.h"
+
+@interface MXEventListenerDispatchTable ()
+{
+    // All listeners, in registration order
+    NSMutableArray<MXEventListener*> *orderedListeners;
+
+    // Listeners by event type, in registration order
+    NSMutableDictionary<NSString*, NSMutableArray<MXEventListener*>*> *listenersByType;
+
+    // Listeners without event types, in registration order
+    NSMutableArray<MXEventListener*> *wildcardListeners;
+
+    // Registration sequence number by listener. Used to merge buckets in registration order
+    NSMapTable<MXEventListener*, NSNumber*> *sequenceNumbers;
+    NSUInteger nextSequenceNumber;
+}
+@end
+
+@implementation MXEventListenerDispatchTable
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        orderedListeners = [NSMutableArray array];
+        listenersByType = [NSMutableDictionary dictionary];
+        wildcardListeners = [NSMutableArray array];
+        sequenceNumbers = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality
+                                                valueOptions:NSPointerFunctionsStrongMemory];
+    }
+    return self;
+}
+
+- (NSArray<MXEventListener *> *)listeners
+{
+    return [orderedListeners copy];
+}
+
+- (void)addListener:(MXEventListener *)listener
+{
+    if ([self containsListener:listener])
+    {
+        return;
+    }
+
+    [sequenceNumbers setObject:@(nextSequenceNumber++) forKey:listener];
+    [orderedListeners addObject:listener];
+
+    if (listener.eventTypes)
+    {
+        for (MXEventTypeString eventType in [NSOrderedSet orderedSetWithArray:listener.eventTypes])
+        {
+            NSMutableArray<MXEventListener*> *bucket = listenersByType[eventType];
+            if (!bucket)
+            {
+                bucket = [NSMutableArray array];
+                listenersByType[eventType] = bucket;
+            }
+            [bucket addObject:listener];
+        }
+    }
+    else
+    {
+        [wildcardListeners addObject:listener];
+    }
+}
+
+- (void)removeListener:(MXEventListener *)listener
+{
+    if (![self containsListener:listener])
+    {
+        return;
+    }
+
+    [sequenceNumbers removeObjectForKey:listener];
+    [orderedListeners removeObjectIdenticalTo:listener];
+
+    if (listener.eventTypes)
+    {
+        for (MXEventTypeString eventType in listener.eventTypes)
+        {
+            NSMutableArray<MXEventListener*> *bucket = listenersByType[eventType];
+            [bucket removeObjectIdenticalTo:listener];
+            if (bucket && !bucket.count)
+            {
+                [listenersByType removeObjectForKey:eventType];
+            }
+        }
+    }
+    else
+    {
+        [wildcardListeners removeObjectIdenticalTo:listener];
+    }
+}
+
+- (void)removeAllListeners
+{
+    [orderedListeners removeAllObjects];
+    [listenersByType removeAllObjects];
+    [wildcardListeners removeAllObjects];
+    [sequenceNumbers removeAllObjects];
+}
+
+- (BOOL)containsListener:(MXEventListener *)listener
+{
+    return [sequenceNumbers objectForKey:listener] != nil;
+}
+
+- (NSArray<MXEventListener *> *)listenersForEvent:(MXEvent *)event
+{
+    // Same matching as [MXEventListener notify:]: a redacted event may have no type
+    NSString *eventType = event.type ?: event.wireType;
+    NSArray<MXEventListener*> *typedListeners = eventType ? listenersByType[eventType] : nil;
+
+    if (!typedListeners.count)
+    {
+        return [wildcardListeners copy];
+    }
+    if (!wildcardListeners.count)
+    {
+        return [typedListeners copy];
+    }
+
+    // Merge the two buckets in registration order
+    NSMutableArray<MXEventListener*> *listeners = [NSMutableArray arrayWithCapacity:typedListeners.count + wildcardListeners.count];
+    NSUInteger typedIndex = 0, wildcardIndex = 0;
+    while (typedIndex < typedListeners.count && wildcardIndex < wildcardListeners.count)
+    {
+        MXEventListener *typedListener = typedListeners[typedIndex];
+        MXEventListener *wildcardListener = wildcardListeners[wildcardIndex];
+        if ([sequenceNumbers objectForKey:typedListener].unsignedIntegerValue < [sequenceNumbers objectForKey:wildcardListener].unsignedIntegerValue)
+        {
+            [listeners addObject:typedListener];
+            typedIndex++;
+        }
+        else
+        {
+            [listeners addObject:wildcardListener];
+            wildcardIndex++;
+        }
+    }
+    [listeners addObjectsFromArray:[typedListeners subarrayWithRange:NSMakeRange(typedIndex, typedListeners.count - typedIndex)]];
+    [listeners addObjectsFromArray:[wildcardListeners subarrayWithRange:NSMakeRange(wildcardIndex, wildcardListeners.count - wildcardIndex)]];
+
+    return listeners;
+}
+
+@end
@@ -0,0 +1,130 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MXEvent;
+@class MXHTTPOperation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Block that requests an event from the homeserver.
+
+ @param success the block to call with the event.
+ @param failure the block to call in case of error.
+ @return the HTTP operation.
+ */
+typedef MXHTTPOperation* _Nonnull (^MXEventLookupRequestBlock)(void (^success)(MXEvent *event), void (^failure)(NSError *error));
+
+/**
+ Block that requests an event of a batch from the homeserver.
+
+ @param eventId the event id.
+ @param roomId the room id.
+ @param success the block to call with the event.
+ @param failure the block to call in case of error.
+ @return the HTTP operation.
+ */
+typedef MXHTTPOperation* _Nonnull (^MXEventLookupBatchRequestBlock)(NSString *eventId, NSString *roomId, void (^success)(MXEvent *event), void (^failure)(NSError *error));
+
+/**
+ `MXEventLookupCoalescer` limits the requests made to fetch events from the homeserver.
+
+ - Concurrent lookups of the same event share a single request. Each caller gets its own
+   `MXHTTPOperation`. The request is cancelled only when all callers have cancelled theirs.
+ - Events that the homeserver reported as not found are remembered for `negativeResultTTL`.
+   Lookups of them fail immediately during that time.
+
+ It must be used from the main thread.
+ */
+@interface MXEventLookupCoalescer : NSObject
+
+/**
+ Create a coalescer.
+
+ @param negativeResultTTL how long a not found event is remembered, in seconds.
+ @return a `MXEventLookupCoalescer` instance.
+ */
+- (instancetype)initWithNegativeResultTTL:(NSTimeInterval)negativeResultTTL;
+
+/**
+ How long a not found event is remembered, in seconds.
+ */
+@property (nonatomic, readonly) NSTimeInterval negativeResultTTL;
+
+/**
+ The number of requests in flight.
+ */
+@property (nonatomic, readonly) NSUInteger pendingRequestsCount;
+
+/**
+ Look up an event.
+
+ @param eventId the event id.
+ @param roomId (optional) the room id.
+ @param request the block that requests the event. It is not called if a request for the same
+                event is in flight or if the event is known as not found.
+ @param success A block object called when the operation succeeds.
+ @param failure A block object called when the operation fails.
+ @return the operation of the caller.
+ */
+- (MXHTTPOperation*)eventWithEventId:(NSString*)eventId
+                              inRoom:(nullable NSString*)roomId
+                             request:(MXEventLookupRequestBlock)request
+                             success:(nullable void (^)(MXEvent *event))success
+                             failure:(nullable void (^)(NSError *error))failure;
+
+/**
+ Look up several events.
+
+ Each event is looked up as with `eventWithEventId:inRoom:request:success:failure:`.
+
+ @param eventIdsByRoomId the ids of the events to look up, grouped by room id.
+ @param request the block that requests an event.
+ @param completion A block object called when all lookups are complete. It gets the found events
+                   grouped by room id. Events that could not be fetched are omitted.
+ @return an operation that cancels all lookups.
+ */
+- (MXHTTPOperation*)eventsWithEventIds:(NSDictionary<NSString*, NSArray<NSString*>*>*)eventIdsByRoomId
+                               request:(MXEventLookupBatchRequestBlock)request
+                            completion:(void (^)(NSDictionary<NSString*, NSArray<MXEvent*>*> *eventsByRoomId))completion;
+
+/**
+ Check whether an event has recently been reported as not found.
+
+ @param eventId the event id.
+ @param roomId (optional) the room id.
+ @return YES if a lookup would fail immediately.
+ */
+- (BOOL)isEventKnownAsNotFound:(NSString*)eventId inRoom:(nullable NSString*)roomId;
+
+/**
+ Forget an event reported as not found, for example because it has been received since.
+
+ @param eventId the event id.
+ @param roomId (optional) the room id.
+ */
+- (void)forgetNotFoundEvent:(NSString*)eventId inRoom:(nullable NSString*)roomId;
+
+/**
+ Forget all events reported as not found.
+ */
+- (void)removeAllNotFoundEvents;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,343 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXEventLookupCoalescer.h"
+
+#import "MXError.h"
+#import "MXHTTPOperation.h"
+#import "MXLog.h"
+#import "MXTools.h"
+
+#pragma mark - MXEventLookupOperation
+
+/**
+ The operation returned to a caller. It notifies the coalescer when it is cancelled.
+ */
+@interface MXEventLookupOperation : MXHTTPOperation
+
+@property (nonatomic, copy) dispatch_block_t onCancel;
+
+@end
+
+@implementation MXEventLookupOperation
+
+- (void)cancel
+{
+    if (self.isCancelled)
+    {
+        return;
+    }
+
+    [super cancel];
+
+    dispatch_block_t onCancel = self.onCancel;
+    self.onCancel = nil;
+    if (onCancel)
+    {
+        onCancel();
+    }
+}
+
+@end
+
+
+#pragma mark - MXEventLookupWaiter
+
+@interface MXEventLookupWaiter : NSObject
+
+@property (nonatomic) MXEventLookupOperation *operation;
+@property (nonatomic, copy) void (^success)(MXEvent *event);
+@property (nonatomic, copy) void (^failure)(NSError *error);
+
+@end
+
+@implementation MXEventLookupWaiter
+@end
+
+
+#pragma mark - MXEventLookupRequest
+
+@interface MXEventLookupRequest : NSObject
+
+@property (nonatomic) MXHTTPOperation *operation;
+@property (nonatomic) NSMutableArray<MXEventLookupWaiter*> *waiters;
+
+@end
+
+@implementation MXEventLookupRequest
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _waiters = [NSMutableArray array];
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark - MXEventLookupCoalescer
+
+@interface MXEventLookupCoalescer ()
+{
+    // Requests in flight by lookup key
+    NSMutableDictionary<NSString*, MXEventLookupRequest*> *pendingRequests;
+
+    // Expiration date of not found events by lookup key
+    NSMutableDictionary<NSString*, NSDate*> *notFoundEvents;
+}
+@end
+
+@implementation MXEventLookupCoalescer
+
+- (instancetype)initWithNegativeResultTTL:(NSTimeInterval)negativeResultTTL
+{
+    self = [super init];
+    if (self)
+    {
+        _negativeResultTTL = negativeResultTTL;
+        pendingRequests = [NSMutableDictionary dictionary];
+        notFoundEvents = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (NSUInteger)pendingRequestsCount
+{
+    return pendingRequests.count;
+}
+
+- (MXHTTPOperation *)eventWithEventId:(NSString *)eventId
+                               inRoom:(NSString *)roomId
+                              request:(MXEventLookupRequestBlock)request
+                              success:(void (^)(MXEvent *))success
+                              failure:(void (^)(NSError *))failure
+{
+    NSString *key = [self keyForEventId:eventId inRoom:roomId];
+    MXEventLookupOperation *operation = [MXEventLookupOperation new];
+
+    if ([self isEventKnownAsNotFound:eventId inRoom:roomId])
+    {
+        MXLogDebug(@"[MXEventLookupCoalescer] eventWithEventId: %@ is known as not found", eventId);
+        if (failure)
+        {
+            NSError *error = [[MXError alloc] initWithErrorCode:kMXErrCodeStringNotFound
+                                                          error:[NSString stringWithFormat:@"Could not find event %@", eventId]].createNSError;
+            dispatch_async(dispatch_get_main_queue(), ^{
+                if (!operation.isCancelled)
+                {
+                    failure(error);
+                }
+            });
+        }
+        return operation;
+    }
+
+    MXEventLookupWaiter *waiter = [MXEventLookupWaiter new];
+    waiter.operation = operation;
+    waiter.success = success;
+    waiter.failure = failure;
+
+    MXEventLookupRequest *pendingRequest = pendingRequests[key];
+    if (pendingRequest)
+    {
+        [pendingRequest.waiters addObject:waiter];
+    }
+    else
+    {
+        pendingRequest = [MXEventLookupRequest new];
+        [pendingRequest.waiters addObject:waiter];
+        pendingRequests[key] = pendingRequest;
+
+        MXWeakify(self);
+        MXEventLookupRequest *theRequest = pendingRequest;
+        pendingRequest.operation = request(^(MXEvent *event) {
+            MXStrongifyAndReturnIfNil(self);
+            [self completeRequest:theRequest withKey:key event:event error:nil];
+        }, ^(NSError *error) {
+            MXStrongifyAndReturnIfNil(self);
+            [self completeRequest:theRequest withKey:key event:nil error:error];
+        });
+    }
+
+    MXWeakify(self);
+    MXWeakify(pendingRequest);
+    MXWeakify(waiter);
+    operation.onCancel = ^{
+        MXStrongifyAndReturnIfNil(self);
+        MXStrongifyAndReturnIfNil(pendingRequest);
+        MXStrongifyAndReturnIfNil(waiter);
+        [self cancelWaiter:waiter ofRequest:pendingRequest withKey:key];
+    };
+
+    return operation;
+}
+
+- (MXHTTPOperation *)eventsWithEventIds:(NSDictionary<NSString *,NSArray<NSString *> *> *)eventIdsByRoomId
+                                request:(MXEventLookupBatchRequestBlock)request
+                             completion:(void (^)(NSDictionary<NSString *,NSArray<MXEvent *> *> *))completion
+{
+    MXEventLookupOperation *operation = [MXEventLookupOperation new];
+    NSMutableArray<MXHTTPOperation*> *lookupOperations = [NSMutableArray array];
+    NSMutableDictionary<NSString*, NSMutableArray<MXEvent*>*> *eventsByRoomId = [NSMutableDictionary dictionary];
+    dispatch_group_t group = dispatch_group_create();
+
+    for (NSString *roomId in eventIdsByRoomId)
+    {
+        NSMutableArray<MXEvent*> *roomEvents = [NSMutableArray array];
+        eventsByRoomId[roomId] = roomEvents;
+
+        for (NSString *eventId in [NSOrderedSet orderedSetWithArray:eventIdsByRoomId[roomId]])
+        {
+            dispatch_group_enter(group);
+            MXHTTPOperation *lookupOperation = [self eventWithEventId:eventId inRoom:roomId request:^MXHTTPOperation *(void (^success)(MXEvent *), void (^failure)(NSError *)) {
+                return request(eventId, roomId, success, failure);
+            } success:^(MXEvent *event) {
+                [roomEvents addObject:event];
+                dispatch_group_leave(group);
+            } failure:^(NSError *error) {
+                MXLogDebug(@"[MXEventLookupCoalescer] eventsWithEventIds: Cannot get event %@. Error: %@", eventId, error);
+                dispatch_group_leave(group);
+            }];
+            [lookupOperations addObject:lookupOperation];
+        }
+    }
+
+    operation.onCancel = ^{
+        for (MXHTTPOperation *lookupOperation in lookupOperations)
+        {
+            [lookupOperation cancel];
+        }
+    };
+
+    dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+        if (operation.isCancelled)
+        {
+            return;
+        }
+        operation.onCancel = nil;
+        completion(eventsByRoomId);
+    });
+
+    return operation;
+}
+
+- (BOOL)isEventKnownAsNotFound:(NSString *)eventId inRoom:(NSString *)roomId
+{
+    NSString *key = [self keyForEventId:eventId inRoom:roomId];
+    NSDate *expirationDate = notFoundEvents[key];
+    if (!expirationDate)
+    {
+        return NO;
+    }
+
+    if (expirationDate.timeIntervalSinceNow <= 0)
+    {
+        [notFoundEvents removeObjectForKey:key];
+        return NO;
+    }
+    return YES;
+}
+
+- (void)forgetNotFoundEvent:(NSString *)eventId inRoom:(NSString *)roomId
+{
+    [notFoundEvents removeObjectForKey:[self keyForEventId:eventId inRoom:roomId]];
+}
+
+- (void)removeAllNotFoundEvents
+{
+    [notFoundEvents removeAllObjects];
+}
+
+#pragma mark - Private
+
+- (NSString*)keyForEventId:(NSString*)eventId inRoom:(NSString*)roomId
+{
+    return [NSString stringWithFormat:@"%@|%@", roomId ?: @"", eventId];
+}
+
+- (void)completeRequest:(MXEventLookupRequest*)request withKey:(NSString*)key event:(MXEvent*)event error:(NSError*)error
+{
+    if (pendingRequests[key] == request)
+    {
+        [pendingRequests removeObjectForKey:key];
+    }
+
+    if (!event && [self isNotFoundError:error] && _negativeResultTTL > 0)
+    {
+        notFoundEvents[key] = [NSDate dateWithTimeIntervalSinceNow:_negativeResultTTL];
+    }
+
+    for (MXEventLookupWaiter *waiter in request.waiters)
+    {
+        if (waiter.operation.isCancelled)
+        {
+            continue;
+        }
+
+        // The waiter operation cannot be cancelled anymore
+        waiter.operation.onCancel = nil;
+
+        if (event)
+        {
+            if (waiter.success)
+            {
+                waiter.success(event);
+            }
+        }
+        else if (waiter.failure)
+        {
+            waiter.failure(error);
+        }
+    }
+    [request.waiters removeAllObjects];
+}
+
+- (void)cancelWaiter:(MXEventLookupWaiter*)waiter ofRequest:(MXEventLookupRequest*)request withKey:(NSString*)key
+{
+    [request.waiters removeObjectIdenticalTo:waiter];
+
+    // Cancel the request once nobody waits for it
+    if (!request.waiters.count && pendingRequests[key] == request)
+    {
+        [pendingRequests removeObjectForKey:key];
+        [request.operation cancel];
+    }
+}
+
+- (BOOL)isNotFoundError:(NSError*)error
+{
+    if (!error)
+    {
+        return NO;
+    }
+
+    if ([MXError isMXError:error])
+    {
+        MXError *mxError = [[MXError alloc] initWithNSError:error];
+        if ([mxError.errcode isEqualToString:kMXErrCodeStringNotFound])
+        {
+            return YES;
+        }
+    }
+
+    return [MXHTTPOperation urlResponseFromError:error].statusCode == 404;
+}
+
+@end
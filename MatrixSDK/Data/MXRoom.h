@@ -60,13 +60,27 @@ FOUNDATION_EXPORT NSString *const kMXRoomInitialSyncNotification;
 
 /**
  Posted when the messages of an existing room has been flushed during server sync.
- This flush may be due to a limited timeline in the room sync, or the redaction of a state event.
+ This flush is due to a limited timeline in the room sync.
  The token where to start back pagination has been updated.
  
  The notification object is the concerned room (MXRoom instance).
  */
 FOUNDATION_EXPORT NSString *const kMXRoomDidFlushDataNotification;
 
+/**
+ Posted when an event of the current state of a room has been redacted.
+ The room state has been updated in place. The room history is unchanged.
+
+ The notification object is the concerned room (MXRoom instance).
+ The `userInfo` dictionary contains the redacted state event under `kMXRoomNotificationRedactedEventKey`.
+ */
+FOUNDATION_EXPORT NSString *const kMXRoomDidRedactStateEventNotification;
+
+/**
+ The key in notification userInfo dictionary representing the redacted event.
+ */
+FOUNDATION_EXPORT NSString *const kMXRoomNotificationRedactedEventKey;
+
 /**
  Error code when tried to join an already joined room.
  */
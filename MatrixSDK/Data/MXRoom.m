@@ -42,6 +42,8 @@
 #import "NSDictionary+MutableDeepCopy.h"
 
 NSString *const kMXRoomDidFlushDataNotification = @"kMXRoomDidFlushDataNotification";
+NSString *const kMXRoomDidRedactStateEventNotification = @"kMXRoomDidRedactStateEventNotification";
+NSString *const kMXRoomNotificationRedactedEventKey = @"kMXRoomNotificationRedactedEventKey";
 NSString *const kMXRoomInitialSyncNotification = @"kMXRoomInitialSyncNotification";
 NSInteger const kMXRoomAlreadyJoinedErrorCode = 9001;
 NSInteger const kMXRoomInvalidInviteSenderErrorCode = 9002;
@@ -2829,19 +2831,13 @@ NSInteger const kMXRoomInvalidInviteSenderErrorCode = 9002;
 - (void)storeOutgoingMessage:(MXEvent*)outgoingMessage
 {
     [mxSession.store storeOutgoingMessageForRoom:self.roomId outgoingMessage:outgoingMessage];
-    if ([mxSession.store respondsToSelector:@selector(commit)])
-    {
-        [mxSession.store commit];
-    }
+    [self commitOutgoingMessagesChanges];
 }
 
 - (void)removeAllOutgoingMessages
 {
     [mxSession.store removeAllOutgoingMessagesFromRoom:self.roomId];
-    if ([mxSession.store respondsToSelector:@selector(commit)])
-    {
-        [mxSession.store commit];
-    }
+    [self commitOutgoingMessagesChanges];
 
     // If required, update the last message
     [mxSession eventWithEventId:self.summary.lastMessage.eventId
@@ -2861,10 +2857,7 @@ NSInteger const kMXRoomInvalidInviteSenderErrorCode = 9002;
 - (void)removeOutgoingMessage:(NSString*)outgoingMessageEventId
 {
     [mxSession.store removeOutgoingMessageFromRoom:self.roomId outgoingMessage:outgoingMessageEventId];
-    if ([mxSession.store respondsToSelector:@selector(commit)])
-    {
-        [mxSession.store commit];
-    }
+    [self commitOutgoingMessagesChanges];
 
     // If required, update the last message
     if ([self.summary.lastMessage.eventId isEqualToString:outgoingMessageEventId])
@@ -2883,6 +2876,20 @@ NSInteger const kMXRoomInvalidInviteSenderErrorCode = 9002;
     [mxSession.store removeOutgoingMessageFromRoom:self.roomId outgoingMessage:outgoingMessageEventId];
     [mxSession.store storeOutgoingMessageForRoom:self.roomId outgoingMessage:outgoingMessage];
 
+    [self commitOutgoingMessagesChanges];
+}
+
+/**
+ Commit the store after a change on outgoing messages, unless the store has already persisted it.
+ */
+- (void)commitOutgoingMessagesChanges
+{
+    if ([mxSession.store respondsToSelector:@selector(persistsOutgoingMessagesImmediately)]
+        && mxSession.store.persistsOutgoingMessagesImmediately)
+    {
+        return;
+    }
+
     if ([mxSession.store respondsToSelector:@selector(commit)])
     {
         [mxSession.store commit];
@@ -3229,7 +3236,16 @@ NSInteger const kMXRoomInvalidInviteSenderErrorCode = 9002;
     
     // Check whether the event is posterior to the current position (if any).
     // Look for an acknowledgeable event if the event type is not acknowledgeable.
-    if (currentReadReceiptEventId || !isAcknowledgeable)
+    if ((currentReadReceiptEventId || !isAcknowledgeable)
+        && [mxSession.store respondsToSelector:@selector(eventToAcknowledge:afterReceipt:inRoom:withTypeIn:)])
+    {
+        // The store finds it without enumerating the room messages
+        updatedReadReceiptEvent = [mxSession.store eventToAcknowledge:event
+                                                         afterReceipt:currentReadReceiptEventId
+                                                               inRoom:self.roomId
+                                                           withTypeIn:mxSession.acknowledgableEventTypes];
+    }
+    else if (currentReadReceiptEventId || !isAcknowledgeable)
     {
         @autoreleasepool
         {
@@ -18,6 +18,7 @@
 
 #import "MXEvent.h"
 #import "MXRoomMember.h"
+#import "MXRoomMembersIndex.h"
 
 @class MXRoomState, MXSession;
 
@@ -110,6 +111,32 @@
 - (NSArray<MXRoomMember*>*)membersWithMembership:(MXMembership)membership includeConferenceUser:(BOOL)includeConferenceUser;
 
 
+#pragma mark - Search
+
+/**
+ The search index of the room members.
+
+ The index is built on first access then kept up to date by `handleStateEvents:`.
+ Use it for member search (mention autocompletion), counts per membership or
+ sorted iteration in rooms with a lot of members.
+
+ The index is shared with the copies of this instance until their members change.
+ It must not be modified directly.
+ */
+@property (nonatomic, readonly) MXRoomMembersIndex *index;
+
+/**
+ Search members by display name or user id.
+
+ @see `-[MXRoomMembersIndex membersMatchingSearchText:limit:]`.
+
+ @param searchText the text to look for.
+ @param limit the maximum number of results. 0 means no limit.
+ @return matching members ordered by `memberSortedName:`.
+ */
+- (NSArray<MXRoomMember*>*)membersMatchingSearchText:(NSString*)searchText limit:(NSUInteger)limit;
+
+
 #pragma mark - State events handling
 
 /**
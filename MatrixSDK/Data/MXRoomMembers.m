@@ -40,6 +40,16 @@
      displayname -> count (= how many members of the room uses this displayname)
      */
     NSMutableDictionary<NSString*, NSNumber*> *membersNamesInUse;
+
+    /**
+     The search index. Built lazily on first use.
+     */
+    MXRoomMembersIndex *index;
+
+    /**
+     YES if `index` may be shared with a copy of this instance. It is copied before any change.
+     */
+    BOOL indexIsShared;
 }
 @end
 
@@ -154,6 +164,11 @@
 
 - (NSArray<MXRoomMember*>*)membersWithMembership:(MXMembership)theMembership
 {
+    if (index)
+    {
+        return [index membersWithMembership:theMembership];
+    }
+
     NSMutableArray *membersWithMembership = [NSMutableArray array];
     for (MXRoomMember *roomMember in members.allValues)
     {
@@ -226,6 +241,34 @@
     return membersWithMembership;
 }
 
+#pragma mark - Search
+- (MXRoomMembersIndex *)index
+{
+    if (!index)
+    {
+        index = [[MXRoomMembersIndex alloc] initWithMembers:members.allValues];
+    }
+    return index;
+}
+
+- (NSArray<MXRoomMember *> *)membersMatchingSearchText:(NSString *)searchText limit:(NSUInteger)limit
+{
+    return [self.index membersMatchingSearchText:searchText limit:limit];
+}
+
+/**
+ The index to update, if it has been built. A shared index is copied first.
+ */
+- (MXRoomMembersIndex*)mutableIndex
+{
+    if (indexIsShared)
+    {
+        index = [index copy];
+        indexIsShared = NO;
+    }
+    return index;
+}
+
 #pragma mark - State events handling
 - (BOOL)handleStateEvents:(NSArray<MXEvent *> *)stateEvents;
 {
@@ -293,12 +336,15 @@
                             // Force to use an identicon url
                             roomMember.avatarUrl = [mxSession.mediaManager urlOfIdenticon:roomMember.userId];
                         }
+
+                        [self.mutableIndex addOrUpdateMember:roomMember];
                     }
                     else
                     {
                         // The user is no more part of the room. Remove him.
                         // This case happens during back pagination: we remove here users when they are not in the room yet.
                         [members removeObjectForKey:event.stateKey];
+                        [self.mutableIndex removeMemberWithUserId:event.stateKey];
                     }
 
                     // Special handling for presence: update MXUser data in case of membership event.
@@ -341,6 +387,15 @@
 
     membersCopy->membersNamesInUse = [membersNamesInUse mutableCopyWithZone:zone];
 
+    // Room states are copied on every live state event. Share the index until one of
+    // the instances changes its members rather than building it again for the copy
+    if (index)
+    {
+        membersCopy->index = index;
+        membersCopy->indexIsShared = YES;
+        indexIsShared = YES;
+    }
+
     return membersCopy;
 }
 
@@ -0,0 +1,112 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MXEnumConstants.h"
+
+@class MXRoomMember;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ `MXRoomMembersIndex` is a search index over the members of a room.
+
+ It is maintained incrementally by `MXRoomMembers` while it handles member state
+ events so that member search, counts per membership and sorted iteration do not
+ need to go through all members of the room.
+
+ The index is not thread safe. Like `MXRoomMembers`, it must be used from the
+ thread that processes the room state.
+
+ A copy reuses the keys, sort orders and trigrams of the original instead of
+ computing them again. It can then be updated independently.
+ */
+@interface MXRoomMembersIndex : NSObject <NSCopying>
+
+/**
+ Create an index with an initial set of members.
+
+ @param members the members to index.
+ @return the newly-initialized MXRoomMembersIndex.
+ */
+- (instancetype)initWithMembers:(NSArray<MXRoomMember*> *)members;
+
+/**
+ Add a member to the index or replace the indexed member with the same user id.
+
+ @param member the new version of the member.
+ */
+- (void)addOrUpdateMember:(MXRoomMember*)member;
+
+/**
+ Remove the member with the given user id from the index.
+
+ @param userId the user id of the member.
+ */
+- (void)removeMemberWithUserId:(NSString*)userId;
+
+/**
+ The number of indexed members.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ Count the members with a given membership.
+
+ @param membership the membership to look for.
+ @return the number of members with this membership.
+ */
+- (NSUInteger)countOfMembersWithMembership:(MXMembership)membership;
+
+/**
+ Return the list of members with a given membership.
+
+ @param membership the membership to look for.
+ @return an array of MXRoomMember objects, in no particular order.
+ */
+- (NSArray<MXRoomMember*> *)membersWithMembership:(MXMembership)membership;
+
+/**
+ Search members by display name or user id.
+
+ Queries shorter than 3 characters match the beginning of the display name or of
+ the user id (the leading "@" is optional). Longer queries match any part of them.
+ The comparison is case and diacritic insensitive.
+
+ @param searchText the text to look for.
+ @param limit the maximum number of results. 0 means no limit.
+ @return matching members, ordered like `enumerateMembersSortedByNameUsingBlock:`.
+ */
+- (NSArray<MXRoomMember*> *)membersMatchingSearchText:(NSString*)searchText limit:(NSUInteger)limit;
+
+/**
+ Enumerate members ordered by the name returned by `-[MXRoomMembers memberSortedName:]`.
+
+ Ties are broken by user id.
+
+ @param block the block to apply to each member. Set `stop` to YES to end the enumeration.
+ */
+- (void)enumerateMembersSortedByNameUsingBlock:(void (^)(MXRoomMember *member, BOOL *stop))block;
+
+/**
+ Joined and invited members, ordered by the timestamp of their member event (oldest first).
+ */
+@property (nonatomic, readonly) NSArray<MXRoomMember*> *joinedOrInvitedMembersByCreation;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,493 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXRoomMembersIndex.h"
+
+#import "MXRoomMember.h"
+#import "MXEvent.h"
+
+/**
+ Length of the n-grams used for substring search.
+ */
+static const NSUInteger kMXRoomMembersIndexGramLength = 3;
+
+@interface MXRoomMembersIndex ()
+{
+    /**
+     Indexed members by user id.
+     */
+    NSMutableDictionary<NSString*, MXRoomMember*> *membersByUserId;
+
+    /**
+     Normalised keys used for sorting and search.
+     userId -> folded `memberSortedName:`, userId -> folded user id without the leading "@".
+     */
+    NSMutableDictionary<NSString*, NSString*> *nameKeys;
+    NSMutableDictionary<NSString*, NSString*> *userIdKeys;
+
+    /**
+     Members sorted by name key then user id.
+     */
+    NSMutableArray<MXRoomMember*> *membersSortedByName;
+
+    /**
+     User ids sorted by user id key.
+     */
+    NSMutableArray<NSString*> *userIdsSortedByKey;
+
+    /**
+     Members partitioned by membership.
+     */
+    NSMutableDictionary<NSNumber*, NSMutableDictionary<NSString*, MXRoomMember*>*> *membersByMembership;
+
+    /**
+     Posting lists: trigram -> user ids of members whose name key or user id key contain it.
+     */
+    NSMutableDictionary<NSString*, NSMutableSet<NSString*>*> *trigrams;
+
+    /**
+     Joined and invited members sorted by member event timestamp.
+     */
+    NSMutableArray<MXRoomMember*> *joinedOrInvitedSortedByCreation;
+
+    NSComparator nameComparator;
+    NSComparator userIdComparator;
+    NSComparator creationComparator;
+}
+@end
+
+@implementation MXRoomMembersIndex
+
+- (instancetype)init
+{
+    return [self initWithMembers:@[]];
+}
+
+- (instancetype)initWithMembers:(NSArray<MXRoomMember *> *)members
+{
+    self = [super init];
+    if (self)
+    {
+        membersByUserId = [NSMutableDictionary dictionaryWithCapacity:members.count];
+        nameKeys = [NSMutableDictionary dictionaryWithCapacity:members.count];
+        userIdKeys = [NSMutableDictionary dictionaryWithCapacity:members.count];
+        membersByMembership = [NSMutableDictionary dictionary];
+        trigrams = [NSMutableDictionary dictionary];
+
+        [self setUpComparators];
+
+        // Bulk load: fill keys and partitions first, then sort once
+        membersSortedByName = [NSMutableArray arrayWithCapacity:members.count];
+        userIdsSortedByKey = [NSMutableArray arrayWithCapacity:members.count];
+        joinedOrInvitedSortedByCreation = [NSMutableArray array];
+
+        for (MXRoomMember *member in members)
+        {
+            if (!member.userId || membersByUserId[member.userId])
+            {
+                continue;
+            }
+
+            [self indexKeysOfMember:member];
+
+            [membersSortedByName addObject:member];
+            [userIdsSortedByKey addObject:member.userId];
+            if ([self isJoinedOrInvited:member])
+            {
+                [joinedOrInvitedSortedByCreation addObject:member];
+            }
+        }
+
+        [membersSortedByName sortUsingComparator:nameComparator];
+        [userIdsSortedByKey sortUsingComparator:userIdComparator];
+        [joinedOrInvitedSortedByCreation sortUsingComparator:creationComparator];
+    }
+    return self;
+}
+
+- (NSUInteger)count
+{
+    return membersByUserId.count;
+}
+
+
+#pragma mark - NSCopying
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    MXRoomMembersIndex *indexCopy = [[MXRoomMembersIndex allocWithZone:zone] init];
+
+    // MXRoomMember objects are immutable. Only the containers need to be copied
+    indexCopy->membersByUserId = [membersByUserId mutableCopyWithZone:zone];
+    indexCopy->nameKeys = [nameKeys mutableCopyWithZone:zone];
+    indexCopy->userIdKeys = [userIdKeys mutableCopyWithZone:zone];
+    indexCopy->membersSortedByName = [membersSortedByName mutableCopyWithZone:zone];
+    indexCopy->userIdsSortedByKey = [userIdsSortedByKey mutableCopyWithZone:zone];
+    indexCopy->joinedOrInvitedSortedByCreation = [joinedOrInvitedSortedByCreation mutableCopyWithZone:zone];
+
+    NSMutableDictionary<NSNumber*, NSMutableDictionary<NSString*, MXRoomMember*>*> *membersByMembershipCopy = [NSMutableDictionary dictionaryWithCapacity:membersByMembership.count];
+    [membersByMembership enumerateKeysAndObjectsUsingBlock:^(NSNumber *membership, NSMutableDictionary<NSString*, MXRoomMember*> *partition, BOOL *stop) {
+        membersByMembershipCopy[membership] = [partition mutableCopyWithZone:zone];
+    }];
+    indexCopy->membersByMembership = membersByMembershipCopy;
+
+    NSMutableDictionary<NSString*, NSMutableSet<NSString*>*> *trigramsCopy = [NSMutableDictionary dictionaryWithCapacity:trigrams.count];
+    [trigrams enumerateKeysAndObjectsUsingBlock:^(NSString *gram, NSMutableSet<NSString*> *userIds, BOOL *stop) {
+        trigramsCopy[gram] = [userIds mutableCopyWithZone:zone];
+    }];
+    indexCopy->trigrams = trigramsCopy;
+
+    // The comparators must read the keys of the copy
+    [indexCopy setUpComparators];
+
+    return indexCopy;
+}
+
+
+#pragma mark - Updates
+
+- (void)addOrUpdateMember:(MXRoomMember *)member
+{
+    if (!member.userId)
+    {
+        return;
+    }
+
+    [self removeMemberWithUserId:member.userId];
+
+    [self indexKeysOfMember:member];
+
+    [self insertObject:member inSortedArray:membersSortedByName usingComparator:nameComparator];
+    [self insertObject:member.userId inSortedArray:userIdsSortedByKey usingComparator:userIdComparator];
+    if ([self isJoinedOrInvited:member])
+    {
+        [self insertObject:member inSortedArray:joinedOrInvitedSortedByCreation usingComparator:creationComparator];
+    }
+}
+
+- (void)removeMemberWithUserId:(NSString *)userId
+{
+    MXRoomMember *member = membersByUserId[userId];
+    if (!member)
+    {
+        return;
+    }
+
+    // Remove from sorted arrays while the keys used by the comparators are still there
+    [self removeObject:member fromSortedArray:membersSortedByName usingComparator:nameComparator];
+    [self removeObject:userId fromSortedArray:userIdsSortedByKey usingComparator:userIdComparator];
+    if ([self isJoinedOrInvited:member])
+    {
+        [self removeObject:member fromSortedArray:joinedOrInvitedSortedByCreation usingComparator:creationComparator];
+    }
+
+    for (NSString *gram in [self trigramsOfMemberWithUserId:userId])
+    {
+        NSMutableSet<NSString*> *userIds = trigrams[gram];
+        [userIds removeObject:userId];
+        if (!userIds.count)
+        {
+            [trigrams removeObjectForKey:gram];
+        }
+    }
+
+    [membersByMembership[@(member.membership)] removeObjectForKey:userId];
+    [nameKeys removeObjectForKey:userId];
+    [userIdKeys removeObjectForKey:userId];
+    [membersByUserId removeObjectForKey:userId];
+}
+
+
+#pragma mark - Queries
+
+- (NSUInteger)countOfMembersWithMembership:(MXMembership)membership
+{
+    return membersByMembership[@(membership)].count;
+}
+
+- (NSArray<MXRoomMember *> *)membersWithMembership:(MXMembership)membership
+{
+    NSArray<MXRoomMember *> *members = membersByMembership[@(membership)].allValues;
+    return members ?: @[];
+}
+
+- (NSArray<MXRoomMember *> *)membersMatchingSearchText:(NSString *)searchText limit:(NSUInteger)limit
+{
+    NSString *query = [self userIdKeyForString:searchText];
+    if (!query.length)
+    {
+        return @[];
+    }
+
+    NSMutableSet<NSString*> *matchingUserIds;
+
+    if (query.length < kMXRoomMembersIndexGramLength)
+    {
+        matchingUserIds = [NSMutableSet set];
+        [self collectUserIdsWithNamePrefix:query into:matchingUserIds];
+        [self collectUserIdsWithUserIdPrefix:query into:matchingUserIds];
+    }
+    else
+    {
+        matchingUserIds = [self candidateUserIdsForQuery:query];
+
+        // Posting lists can give false positives, check the actual keys
+        for (NSString *userId in matchingUserIds.allObjects)
+        {
+            if ([nameKeys[userId] rangeOfString:query].location == NSNotFound
+                && [userIdKeys[userId] rangeOfString:query].location == NSNotFound)
+            {
+                [matchingUserIds removeObject:userId];
+            }
+        }
+    }
+
+    NSMutableArray<MXRoomMember*> *result = [NSMutableArray arrayWithCapacity:matchingUserIds.count];
+    for (NSString *userId in matchingUserIds)
+    {
+        [result addObject:membersByUserId[userId]];
+    }
+    [result sortUsingComparator:nameComparator];
+
+    if (limit && result.count > limit)
+    {
+        [result removeObjectsInRange:NSMakeRange(limit, result.count - limit)];
+    }
+
+    return result;
+}
+
+- (void)enumerateMembersSortedByNameUsingBlock:(void (^)(MXRoomMember * _Nonnull, BOOL * _Nonnull))block
+{
+    [membersSortedByName enumerateObjectsUsingBlock:^(MXRoomMember *member, NSUInteger idx, BOOL *stop) {
+        block(member, stop);
+    }];
+}
+
+- (NSArray<MXRoomMember *> *)joinedOrInvitedMembersByCreation
+{
+    return [joinedOrInvitedSortedByCreation copy];
+}
+
+
+#pragma mark - Private methods
+
+- (void)setUpComparators
+{
+    NSMutableDictionary<NSString*, NSString*> *theNameKeys = nameKeys;
+    NSMutableDictionary<NSString*, NSString*> *theUserIdKeys = userIdKeys;
+
+    nameComparator = ^NSComparisonResult(MXRoomMember *member1, MXRoomMember *member2) {
+        NSComparisonResult result = [theNameKeys[member1.userId] compare:theNameKeys[member2.userId]];
+        if (result == NSOrderedSame)
+        {
+            result = [member1.userId compare:member2.userId];
+        }
+        return result;
+    };
+
+    userIdComparator = ^NSComparisonResult(NSString *userId1, NSString *userId2) {
+        NSComparisonResult result = [theUserIdKeys[userId1] compare:theUserIdKeys[userId2]];
+        if (result == NSOrderedSame)
+        {
+            result = [userId1 compare:userId2];
+        }
+        return result;
+    };
+
+    creationComparator = ^NSComparisonResult(MXRoomMember *member1, MXRoomMember *member2) {
+        uint64_t originServerTs1 = member1.originalEvent.originServerTs;
+        uint64_t originServerTs2 = member2.originalEvent.originServerTs;
+        if (originServerTs1 == originServerTs2)
+        {
+            return [member1.userId compare:member2.userId];
+        }
+        return originServerTs1 > originServerTs2 ? NSOrderedDescending : NSOrderedAscending;
+    };
+}
+
+- (BOOL)isJoinedOrInvited:(MXRoomMember*)member
+{
+    return member.membership == MXMembershipJoin || member.membership == MXMembershipInvite;
+}
+
+- (void)indexKeysOfMember:(MXRoomMember*)member
+{
+    NSString *userId = member.userId;
+
+    membersByUserId[userId] = member;
+    nameKeys[userId] = [self nameKeyForString:member.displayname ?: userId];
+    userIdKeys[userId] = [self userIdKeyForString:userId];
+
+    NSMutableDictionary<NSString*, MXRoomMember*> *partition = membersByMembership[@(member.membership)];
+    if (!partition)
+    {
+        partition = [NSMutableDictionary dictionary];
+        membersByMembership[@(member.membership)] = partition;
+    }
+    partition[userId] = member;
+
+    for (NSString *gram in [self trigramsOfMemberWithUserId:userId])
+    {
+        NSMutableSet<NSString*> *userIds = trigrams[gram];
+        if (!userIds)
+        {
+            userIds = [NSMutableSet set];
+            trigrams[gram] = userIds;
+        }
+        [userIds addObject:userId];
+    }
+}
+
+- (NSString*)nameKeyForString:(NSString*)string
+{
+    return [string stringByFoldingWithOptions:NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch locale:nil];
+}
+
+- (NSString*)userIdKeyForString:(NSString*)string
+{
+    NSString *key = [self nameKeyForString:string];
+    if ([key hasPrefix:@"@"])
+    {
+        key = [key substringFromIndex:1];
+    }
+    return key;
+}
+
+- (NSSet<NSString*>*)trigramsOfMemberWithUserId:(NSString*)userId
+{
+    NSMutableSet<NSString*> *grams = [NSMutableSet set];
+    [self addTrigramsOfString:nameKeys[userId] to:grams];
+    [self addTrigramsOfString:userIdKeys[userId] to:grams];
+    return grams;
+}
+
+- (void)addTrigramsOfString:(NSString*)string to:(NSMutableSet<NSString*>*)grams
+{
+    if (string.length < kMXRoomMembersIndexGramLength)
+    {
+        return;
+    }
+
+    for (NSUInteger i = 0; i <= string.length - kMXRoomMembersIndexGramLength; i++)
+    {
+        [grams addObject:[string substringWithRange:NSMakeRange(i, kMXRoomMembersIndexGramLength)]];
+    }
+}
+
+- (NSMutableSet<NSString*>*)candidateUserIdsForQuery:(NSString*)query
+{
+    NSMutableSet<NSString*> *queryGrams = [NSMutableSet set];
+    [self addTrigramsOfString:query to:queryGrams];
+
+    // Intersect the posting lists, smallest first
+    NSMutableArray<NSSet<NSString*>*> *lists = [NSMutableArray arrayWithCapacity:queryGrams.count];
+    for (NSString *gram in queryGrams)
+    {
+        NSSet<NSString*> *userIds = trigrams[gram];
+        if (!userIds)
+        {
+            return [NSMutableSet set];
+        }
+        [lists addObject:userIds];
+    }
+    [lists sortUsingComparator:^NSComparisonResult(NSSet *set1, NSSet *set2) {
+        return set1.count < set2.count ? NSOrderedAscending : (set1.count > set2.count ? NSOrderedDescending : NSOrderedSame);
+    }];
+
+    NSMutableSet<NSString*> *candidates = [lists.firstObject mutableCopy];
+    for (NSUInteger i = 1; i < lists.count && candidates.count; i++)
+    {
+        [candidates intersectSet:lists[i]];
+    }
+    return candidates ?: [NSMutableSet set];
+}
+
+- (void)collectUserIdsWithNamePrefix:(NSString*)prefix into:(NSMutableSet<NSString*>*)userIds
+{
+    NSUInteger index = [self lowerBoundOfKey:prefix count:membersSortedByName.count keyAtIndex:^NSString *(NSUInteger idx) {
+        return self->nameKeys[self->membersSortedByName[idx].userId];
+    }];
+
+    for (; index < membersSortedByName.count; index++)
+    {
+        NSString *userId = membersSortedByName[index].userId;
+        if (![nameKeys[userId] hasPrefix:prefix])
+        {
+            break;
+        }
+        [userIds addObject:userId];
+    }
+}
+
+- (void)collectUserIdsWithUserIdPrefix:(NSString*)prefix into:(NSMutableSet<NSString*>*)userIds
+{
+    NSUInteger index = [self lowerBoundOfKey:prefix count:userIdsSortedByKey.count keyAtIndex:^NSString *(NSUInteger idx) {
+        return self->userIdKeys[self->userIdsSortedByKey[idx]];
+    }];
+
+    for (; index < userIdsSortedByKey.count; index++)
+    {
+        NSString *userId = userIdsSortedByKey[index];
+        if (![userIdKeys[userId] hasPrefix:prefix])
+        {
+            break;
+        }
+        [userIds addObject:userId];
+    }
+}
+
+// Index of the first key that is not lower than `key`
+- (NSUInteger)lowerBoundOfKey:(NSString*)key count:(NSUInteger)count keyAtIndex:(NSString* (^)(NSUInteger idx))keyAtIndex
+{
+    NSUInteger low = 0, high = count;
+    while (low < high)
+    {
+        NSUInteger mid = low + (high - low) / 2;
+        if ([keyAtIndex(mid) compare:key] == NSOrderedAscending)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+- (void)insertObject:(id)object inSortedArray:(NSMutableArray*)array usingComparator:(NSComparator)comparator
+{
+    NSUInteger index = [array indexOfObject:object
+                              inSortedRange:NSMakeRange(0, array.count)
+                                    options:NSBinarySearchingInsertionIndex
+                            usingComparator:comparator];
+    [array insertObject:object atIndex:index];
+}
+
+- (void)removeObject:(id)object fromSortedArray:(NSMutableArray*)array usingComparator:(NSComparator)comparator
+{
+    NSUInteger index = [array indexOfObject:object
+                              inSortedRange:NSMakeRange(0, array.count)
+                                    options:NSBinarySearchingFirstEqual
+                            usingComparator:comparator];
+    if (index != NSNotFound)
+    {
+        [array removeObjectAtIndex:index];
+    }
+}
+
+@end
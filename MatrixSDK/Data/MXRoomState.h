@@ -244,6 +244,24 @@ Use MXRoomSummary.displayname to get a computed room display name.
  */
 - (NSArray<MXEvent*> *)stateEventsWithType:(MXEventTypeString)eventType NS_REFINED_FOR_SWIFT;
 
+/**
+ Return the state event with the given event id.
+
+ @param eventId the event id.
+ @return the event if it is part of the state. Else nil.
+ */
+- (MXEvent*)stateEventWithEventId:(NSString*)eventId;
+
+/**
+ Replace a state event by its redacted version.
+
+ Unlike a new state event, the redacted event takes the place of the original one.
+
+ @param redactedEvent the pruned event.
+ @return YES if the original event was part of the state.
+ */
+- (BOOL)handleRedactedStateEvent:(MXEvent*)redactedEvent;
+
 /**
  According to the direction of the instance, we are interested either by
  the content of the event or its prev_content.
@@ -32,6 +32,12 @@
      */
     NSMutableDictionary<NSString*, NSMutableArray<MXEvent*>*> *stateEvents;
 
+    /**
+     State events by event id.
+     It includes all events listed in `stateEvents`, members, room aliases and third party invites.
+     */
+    NSMutableDictionary<NSString*, MXEvent*> *stateEventsByEventIds;
+
     /**
      The room aliases. The key is the domain.
      */
@@ -76,6 +82,7 @@
         _isLive = isLive;
         
         stateEvents = [NSMutableDictionary dictionary];
+        stateEventsByEventIds = [NSMutableDictionary dictionary];
         _members = [[MXRoomMembers alloc] initWithRoomState:self andMatrixSession:mxSession];
         _membersCount = [[MXRoomMembersCount alloc] initWithMembers:_members.members.count
                                                              joined:_members.joinedMembers.count
@@ -455,6 +462,12 @@
 #pragma mark - State events handling
 - (void)handleStateEvents:(NSArray<MXEvent *> *)events;
 {
+    // Index events before members are updated, to know the events they replace
+    for (MXEvent *event in events)
+    {
+        [self indexStateEvent:event];
+    }
+
     // Process the update on room members
     if ([_members handleStateEvents:events])
     {
@@ -539,19 +552,7 @@
                 }
                 case MXEventTypeRoomPowerLevels:
                 {
-                    powerLevels = [MXRoomPowerLevels modelFromJSON:[self contentOfEvent:event]];
-                    // Compute max power level
-                    maxPowerLevel = powerLevels.usersDefault;
-                    NSArray<NSNumber *> *array = powerLevels.users.allValues;
-                    for (NSNumber *powerLevel in array)
-                    {
-                        NSInteger level = 0;
-                        MXJSONModelSetInteger(level, powerLevel);
-                        if (level > maxPowerLevel)
-                        {
-                            maxPowerLevel = level;
-                        }
-                    }
+                    [self updatePowerLevelsWithEvent:event];
 
                     // Do not break here to store the event into the stateEvents dictionary.
                 }
@@ -579,6 +580,110 @@
     return stateEvents[eventType];
 }
 
+- (MXEvent *)stateEventWithEventId:(NSString *)eventId
+{
+    return eventId ? stateEventsByEventIds[eventId] : nil;
+}
+
+- (BOOL)handleRedactedStateEvent:(MXEvent *)redactedEvent
+{
+    MXEvent *stateEvent = [self stateEventWithEventId:redactedEvent.eventId];
+    if (!stateEvent)
+    {
+        return NO;
+    }
+
+    switch (stateEvent.eventType)
+    {
+        case MXEventTypeRoomThirdPartyInvite:
+            // The redacted invite may be no more valid
+            if (stateEvent.stateKey)
+            {
+                [thirdPartyInvites removeObjectForKey:stateEvent.stateKey];
+            }
+            // Do not break here to handle it as a new state event.
+        case MXEventTypeRoomMember:
+        case MXEventTypeRoomAliases:
+            // These events are stored by state key. The redacted event replaces the original one
+            [self handleStateEvents:@[redactedEvent]];
+            break;
+
+        default:
+        {
+            // Keep the position of the event in the list of its type: the last one is the current one
+            NSMutableArray<MXEvent*> *events = stateEvents[stateEvent.type];
+            NSUInteger index = [events indexOfObjectIdenticalTo:stateEvent];
+            if (index == NSNotFound)
+            {
+                return NO;
+            }
+
+            events[index] = redactedEvent;
+            stateEventsByEventIds[redactedEvent.eventId] = redactedEvent;
+
+            if (stateEvent.eventType == MXEventTypeRoomPowerLevels && index == events.count - 1)
+            {
+                [self updatePowerLevelsWithEvent:redactedEvent];
+            }
+
+            if (_isLive && [mxSession.store respondsToSelector:@selector(storeStateForRoom:stateEvents:)])
+            {
+                [mxSession.store storeStateForRoom:_roomId stateEvents:self.stateEvents];
+            }
+            break;
+        }
+    }
+
+    return YES;
+}
+
+- (void)indexStateEvent:(MXEvent*)event
+{
+    // Forget the event replaced by this one
+    MXEvent *replacedEvent;
+    switch (event.eventType)
+    {
+        case MXEventTypeRoomMember:
+            replacedEvent = event.stateKey ? [_members memberWithUserId:event.stateKey].originalEvent : nil;
+            break;
+        case MXEventTypeRoomAliases:
+            replacedEvent = event.stateKey ? roomAliases[event.stateKey] : nil;
+            break;
+        case MXEventTypeRoomThirdPartyInvite:
+            replacedEvent = event.stateKey ? thirdPartyInvites[event.stateKey].originalEvent : nil;
+            break;
+        default:
+            break;
+    }
+
+    if (replacedEvent.eventId)
+    {
+        [stateEventsByEventIds removeObjectForKey:replacedEvent.eventId];
+    }
+
+    if (event.eventId)
+    {
+        stateEventsByEventIds[event.eventId] = event;
+    }
+}
+
+- (void)updatePowerLevelsWithEvent:(MXEvent*)event
+{
+    powerLevels = [MXRoomPowerLevels modelFromJSON:[self contentOfEvent:event]];
+    // Compute max power level
+    maxPowerLevel = powerLevels.usersDefault;
+    NSArray<NSNumber *> *array = powerLevels.users.allValues;
+    for (NSNumber *powerLevel in array)
+    {
+        NSInteger level = 0;
+        MXJSONModelSetInteger(level, powerLevel);
+        if (level > maxPowerLevel)
+        {
+            maxPowerLevel = level;
+        }
+    }
+}
+
 - (MXRoomMember *)memberWithThirdPartyInviteToken:(NSString *)thirdPartyInviteToken
 {
     return membersWithThirdPartyInviteTokenCache[thirdPartyInviteToken];
@@ -661,6 +766,7 @@
         // Copy the list of state events pointers. A deep copy is not necessary as MXEvent objects are immutable
         stateCopy->stateEvents[key] = [[NSMutableArray allocWithZone:zone] initWithArray:stateEvents[key]];
     }
+    stateCopy->stateEventsByEventIds = [[NSMutableDictionary allocWithZone:zone] initWithDictionary:stateEventsByEventIds];
 
     stateCopy->_members = [_members copyWithZone:zone];
 
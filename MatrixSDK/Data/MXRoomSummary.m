@@ -30,6 +30,7 @@
 
 #import "MXRoomSync.h"
 #import "MatrixSDKSwiftHeader.h"
+#import "MXRoomSummary_Private.h"
 
 #import <Security/Security.h>
 #import <CommonCrypto/CommonCryptor.h>
@@ -52,6 +53,11 @@ NSUInteger const MXRoomSummaryPaginationChunkSize = 50;
  */
 static NSUInteger const kMXRoomSummaryTrustComputationDelayMs = 1000;
 
+/**
+ Number of field groups compared in `consumeChangedFields`.
+ */
+static NSUInteger const kMXRoomSummaryChangedFieldsGroupCount = 8;
+
 
 @interface MXRoomSummary ()
 {
@@ -65,6 +71,9 @@ static NSUInteger const kMXRoomSummaryTrustComputationDelayMs = 1000;
     id eventEditsListener;
     
     MXRoomSummaryNextTrustComputation nextTrustComputation;
+
+    // Values of each group of fields at the last call of consumeChangedFields
+    NSArray<NSArray*> *changedFieldsValues;
 }
 
 @property (nonatomic, readwrite) MXSpaceChildInfo *spaceChildInfo;
@@ -145,8 +154,8 @@ static NSUInteger const kMXRoomSummaryTrustComputationDelayMs = 1000;
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(eventDidChangeIdentifier:) name:kMXEventDidChangeIdentifierNotification object:nil];
 
     // Listen to data being flush in a room
-    // This is used to update the room summary in case of a state event redaction
-    // We may need to update the room displayname when it happens
+    // This happens when the room is resynced with a limited timeline
+    // State event redactions do not flush the room. The live timeline updates the summary directly
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(roomDidFlushData:) name:kMXRoomDidFlushDataNotification object:nil];
 
     // Listen to event edits within the room
@@ -960,6 +969,81 @@ static NSUInteger const kMXRoomSummaryTrustComputationDelayMs = 1000;
 }
 
 
+#pragma mark - Changed fields
+
+/**
+ A value that can be stored in an array of changed fields values.
+ */
+static inline id MXRoomSummaryChangedFieldsValue(id value)
+{
+    return value ?: NSNull.null;
+}
+
+- (MXRoomSummaryChangedFields)consumeChangedFields
+{
+    // Values are copied so that in place mutations are detected at the next call.
+    // Their order must match the bits of MXRoomSummaryChangedFields
+    NSArray<NSArray*> *values = @[
+        // MXRoomSummaryChangedFieldsProfile
+        @[
+            MXRoomSummaryChangedFieldsValue(_displayName),
+            MXRoomSummaryChangedFieldsValue(_avatar),
+            MXRoomSummaryChangedFieldsValue(_topic),
+            MXRoomSummaryChangedFieldsValue([_aliases copy]),
+            MXRoomSummaryChangedFieldsValue(_roomTypeString),
+            MXRoomSummaryChangedFieldsValue(_creatorUserId),
+            MXRoomSummaryChangedFieldsValue(_historyVisibility),
+            MXRoomSummaryChangedFieldsValue(_joinRule)
+        ],
+        // MXRoomSummaryChangedFieldsMembership
+        @[@(_membership), @(_membershipTransitionState)],
+        // MXRoomSummaryChangedFieldsUnread
+        @[@(_localUnreadEventCount), @(_notificationCount), @(_highlightCount),
+          @(_hasAnyUnread), @(_hasAnyNotification), @(_hasAnyHighlight)],
+        // MXRoomSummaryChangedFieldsLastMessage
+        @[
+            MXRoomSummaryChangedFieldsValue(_lastMessage.eventId),
+            MXRoomSummaryChangedFieldsValue(_lastMessage.text),
+            @(_lastMessage.originServerTs),
+            @(_sentStatus)
+        ],
+        // MXRoomSummaryChangedFieldsDataTypes
+        @[@(_dataTypes), MXRoomSummaryChangedFieldsValue(_favoriteTagOrder), MXRoomSummaryChangedFieldsValue(_directUserId)],
+        // MXRoomSummaryChangedFieldsEncryption
+        @[
+            @(_isEncrypted),
+            @(_trust.trustedUsersProgress.completedUnitCount),
+            @(_trust.trustedUsersProgress.totalUnitCount),
+            @(_trust.trustedDevicesProgress.completedUnitCount),
+            @(_trust.trustedDevicesProgress.totalUnitCount)
+        ],
+        // MXRoomSummaryChangedFieldsMembersCount
+        @[@(_membersCount.members), @(_membersCount.joined), @(_membersCount.invited)],
+        // MXRoomSummaryChangedFieldsSpaces
+        @[MXRoomSummaryChangedFieldsValue([_parentSpaceIds copy]), MXRoomSummaryChangedFieldsValue(_spaceChildInfo)]
+    ];
+    NSAssert(values.count == kMXRoomSummaryChangedFieldsGroupCount, @"[MXRoomSummary] consumeChangedFields: Missing group of fields");
+
+    MXRoomSummaryChangedFields changedFields = 0;
+    if (changedFieldsValues)
+    {
+        for (NSUInteger group = 0; group < kMXRoomSummaryChangedFieldsGroupCount; group++)
+        {
+            if (![changedFieldsValues[group] isEqualToArray:values[group]])
+            {
+                changedFields |= (1 << group);
+            }
+        }
+    }
+    else
+    {
+        changedFields = MXRoomSummaryChangedFieldsAll;
+    }
+
+    changedFieldsValues = values;
+    return changedFields;
+}
+
 #pragma mark - NSCoding
 - (instancetype)initWithCoder:(NSCoder *)aDecoder
 {
@@ -0,0 +1,77 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MXRoomSummary;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The groups of room summary fields that can change.
+ */
+typedef NS_OPTIONS(NSUInteger, MXRoomSummaryChangedFields)
+{
+    // displayname, avatar, topic, aliases, room type, creator, history visibility, join rule
+    MXRoomSummaryChangedFieldsProfile = 1 << 0,
+    // membership and membership transition state
+    MXRoomSummaryChangedFieldsMembership = 1 << 1,
+    // unread and notification counts
+    MXRoomSummaryChangedFieldsUnread = 1 << 2,
+    // last message and sent status
+    MXRoomSummaryChangedFieldsLastMessage = 1 << 3,
+    // data types (direct, favorite, low priority...), favorite tag order and direct user id
+    MXRoomSummaryChangedFieldsDataTypes = 1 << 4,
+    // encryption and trust
+    MXRoomSummaryChangedFieldsEncryption = 1 << 5,
+    // members count
+    MXRoomSummaryChangedFieldsMembersCount = 1 << 6,
+    // parent spaces and space child info
+    MXRoomSummaryChangedFieldsSpaces = 1 << 7,
+    // any other field. Used when the summary changed but none of the groups above
+    MXRoomSummaryChangedFieldsOther = 1 << 8,
+
+    MXRoomSummaryChangedFieldsAll = NSUIntegerMax
+};
+
+/**
+ `MXRoomSummaryChange` describes the changes of a room summary in a batch of changes.
+
+ @see kMXSessionDidUpdateRoomSummariesNotification.
+ */
+@interface MXRoomSummaryChange : NSObject
+
+- (instancetype)initWithSummary:(MXRoomSummary*)summary changedFields:(MXRoomSummaryChangedFields)changedFields;
+
+/**
+ The id of the room.
+ */
+@property (nonatomic, readonly) NSString *roomId;
+
+/**
+ The room summary, as it is at the end of the batch.
+ */
+@property (nonatomic, readonly) MXRoomSummary *summary;
+
+/**
+ The fields that changed since the previous batch.
+ It is `MXRoomSummaryChangedFieldsAll` the first time a summary is reported.
+ */
+@property (nonatomic, readonly) MXRoomSummaryChangedFields changedFields;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,40 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXRoomSummaryChange.h"
+
+#import "MXRoomSummary.h"
+
+@implementation MXRoomSummaryChange
+
+- (instancetype)initWithSummary:(MXRoomSummary *)summary changedFields:(MXRoomSummaryChangedFields)changedFields
+{
+    self = [super init];
+    if (self)
+    {
+        _roomId = summary.roomId;
+        _summary = summary;
+        _changedFields = changedFields;
+    }
+    return self;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<MXRoomSummaryChange: %p> %@: %@", self, _roomId, @(_changedFields)];
+}
+
+@end
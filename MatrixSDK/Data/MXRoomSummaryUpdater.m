@@ -736,33 +736,19 @@
 
 - (NSArray<MXRoomMember*> *)sortedOtherMembersInRoomState:(MXRoomState*)roomState withMatrixSession:(MXSession *)session
 {
-    // Get all joined and invited members other than my user
-    NSMutableArray<MXRoomMember*> *otherMembers = [NSMutableArray array];
-    for (MXRoomMember *member in roomState.members.members)
+    // Get all joined and invited members other than my user, sorted by their creation (oldest first).
+    // The members index keeps them sorted so that we do not need to sort all members on each update.
+    NSArray<MXRoomMember*> *joinedOrInvitedMembers = roomState.members.index.joinedOrInvitedMembersByCreation;
+
+    NSMutableArray<MXRoomMember*> *otherMembers = [NSMutableArray arrayWithCapacity:joinedOrInvitedMembers.count];
+    for (MXRoomMember *member in joinedOrInvitedMembers)
     {
-        if ((member.membership == MXMembershipJoin || member.membership == MXMembershipInvite)
-            && ![member.userId isEqualToString:session.myUserId])
+        if (![member.userId isEqualToString:session.myUserId])
         {
             [otherMembers addObject:member];
         }
     }
 
-    // Sort members by their creation (oldest first)
-    [otherMembers sortUsingComparator:^NSComparisonResult(MXRoomMember *member1, MXRoomMember *member2) {
-
-        uint64_t originServerTs1 = member1.originalEvent.originServerTs;
-        uint64_t originServerTs2 = member2.originalEvent.originServerTs;
-
-        if (originServerTs1 == originServerTs2)
-        {
-            return NSOrderedSame;
-        }
-        else
-        {
-            return originServerTs1 > originServerTs2 ? NSOrderedDescending : NSOrderedAscending;
-        }
-    }];
-
     return otherMembers;
 }
 
@@ -0,0 +1,35 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXRoomSummary.h"
+#import "MXRoomSummaryChange.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface MXRoomSummary ()
+
+/**
+ Get the fields that changed since the last call to this method.
+
+ It is used by MXSession to build batches of room summary changes.
+
+ @return the changed fields. `MXRoomSummaryChangedFieldsAll` on the first call.
+ */
+- (MXRoomSummaryChangedFields)consumeChangedFields;
+
+@end
+
+NS_ASSUME_NONNULL_END
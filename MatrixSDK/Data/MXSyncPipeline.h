@@ -0,0 +1,101 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MXRestClient;
+@class MXSyncResponse;
+@class MXHTTPOperation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ `MXSyncPipeline` fetches the next /sync response while the session processes the current one.
+
+ As soon as a response is received, the request for the following batch is sent with
+ `since` set to its `next_batch`. Responses are handed over to the session strictly in order,
+ when the session asks for them. The number of requests in flight plus responses waiting to be
+ processed is bounded by `maxDepth`: no new request is sent while the queue is full.
+
+ The server deletes to-device events once the following batch is requested. So a response that
+ carries to-device events or device list changes is not prefetched from until the session
+ reports it stored with `didStoreSyncResponse:`.
+
+ There is one `MXSyncPipeline` instance per MXSession. It must be used from the main thread.
+ */
+@interface MXSyncPipeline : NSObject
+
+/**
+ Create a pipeline.
+
+ @param restClient the client to send /sync requests.
+ @param maxDepth the maximum number of prefetched batches.
+ @return a `MXSyncPipeline` instance.
+ */
+- (instancetype)initWithRestClient:(MXRestClient*)restClient maxDepth:(NSUInteger)maxDepth;
+
+/**
+ The maximum number of prefetched batches.
+ */
+@property (nonatomic, readonly) NSUInteger maxDepth;
+
+/**
+ The number of prefetched batches, in flight or waiting to be processed.
+ */
+@property (nonatomic, readonly) NSUInteger depth;
+
+/**
+ Return the server timeout to use for the request that follows a response.
+
+ It must return the same value as the one the session would use once the response is processed.
+ If not set, the server timeout of the previous request is used.
+ */
+@property (nonatomic, copy, nullable) NSUInteger (^nextServerTimeoutBlock)(NSUInteger serverTimeout, MXSyncResponse *syncResponse);
+
+/**
+ Get the /sync response for a token.
+
+ If this batch has been prefetched, it is returned without a new request. Otherwise, the
+ prefetched batches are discarded and a new request is sent.
+ In both cases, the request for the next batch is sent as soon as the response is received.
+
+ The parameters are the ones of `[MXRestClient syncFromToken:...]`.
+
+ @return a MXHTTPOperation instance. Use `cancel` to stop the pipeline.
+ */
+- (MXHTTPOperation*)syncFromToken:(nullable NSString*)token
+                    serverTimeout:(NSUInteger)serverTimeout
+                    clientTimeout:(NSUInteger)clientTimeout
+                      setPresence:(nullable NSString*)setPresence
+                           filter:(nullable NSString*)filterId
+                          success:(void (^)(MXSyncResponse *syncResponse))success
+                          failure:(void (^)(NSError *error))failure;
+
+/**
+ Tell the pipeline that the session has processed a response and stored its sync token.
+
+ @param syncResponse the stored response.
+ */
+- (void)didStoreSyncResponse:(MXSyncResponse*)syncResponse;
+
+/**
+ Cancel the requests in flight and discard all prefetched responses.
+ */
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
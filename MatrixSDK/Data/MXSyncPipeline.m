@@ -0,0 +1,277 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXSyncPipeline.h"
+
+#import "MXRestClient.h"
+#import "MXHTTPOperation.h"
+#import "MXSyncResponse.h"
+#import "MXToDeviceSyncResponse.h"
+#import "MXDeviceListResponse.h"
+#import "MXTools.h"
+#import "MXLog.h"
+
+static BOOL MXSyncPipelineIsSameString(NSString *string1, NSString *string2)
+{
+    return string1 == string2 || [string1 isEqualToString:string2];
+}
+
+/**
+ Tell whether a response carries data the server does not send again.
+
+ To-device events are deleted by the server once the next batch is requested. Device list changes
+ are not sent again either.
+ */
+static BOOL MXSyncPipelineHasUnrecoverableData(MXSyncResponse *syncResponse)
+{
+    return syncResponse.toDevice.eventsCount
+        || syncResponse.deviceLists.changed.count
+        || syncResponse.deviceLists.left.count;
+}
+
+#pragma mark - MXSyncPipelineBatch
+
+/**
+ A /sync request of the pipeline and its response.
+ */
+@interface MXSyncPipelineBatch : NSObject
+
+@property (nonatomic, nullable) NSString *token;
+@property (nonatomic) NSUInteger serverTimeout;
+@property (nonatomic) NSUInteger clientTimeout;
+@property (nonatomic, nullable) NSString *setPresence;
+@property (nonatomic, nullable) NSString *filterId;
+
+@property (nonatomic, nullable) MXHTTPOperation *operation;
+@property (nonatomic, nullable) MXSyncResponse *syncResponse;
+
+// The session callbacks, set when the session is waiting for this batch
+@property (nonatomic, copy, nullable) void (^success)(MXSyncResponse *syncResponse);
+@property (nonatomic, copy, nullable) void (^failure)(NSError *error);
+
+@end
+
+@implementation MXSyncPipelineBatch
+@end
+
+
+#pragma mark - MXSyncPipeline
+
+@interface MXSyncPipeline ()
+{
+    MXRestClient *restClient;
+
+    // Prefetched batches not yet requested by the session, in sync order
+    NSMutableArray<MXSyncPipelineBatch*> *batches;
+
+    // The most recent batch of the chain. The next prefetch starts from its response
+    MXSyncPipelineBatch *lastBatch;
+
+    // The next_batch of the last response stored by the session
+    NSString *storedToken;
+}
+@end
+
+@implementation MXSyncPipeline
+
+- (instancetype)initWithRestClient:(MXRestClient *)theRestClient maxDepth:(NSUInteger)maxDepth
+{
+    self = [super init];
+    if (self)
+    {
+        restClient = theRestClient;
+        _maxDepth = maxDepth;
+        batches = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (NSUInteger)depth
+{
+    return batches.count;
+}
+
+- (MXHTTPOperation *)syncFromToken:(NSString *)token
+                     serverTimeout:(NSUInteger)serverTimeout
+                     clientTimeout:(NSUInteger)clientTimeout
+                       setPresence:(NSString *)setPresence
+                            filter:(NSString *)filterId
+                           success:(void (^)(MXSyncResponse *))success
+                           failure:(void (^)(NSError *))failure
+{
+    MXSyncPipelineBatch *batch = batches.firstObject;
+
+    if (batch
+        && MXSyncPipelineIsSameString(batch.token, token)
+        && batch.serverTimeout == serverTimeout
+        && MXSyncPipelineIsSameString(batch.setPresence, setPresence)
+        && MXSyncPipelineIsSameString(batch.filterId, filterId))
+    {
+        [batches removeObjectAtIndex:0];
+
+        if (batch.syncResponse)
+        {
+            MXLogDebug(@"[MXSyncPipeline] syncFromToken: Use prefetched response. Depth: %@", @(batches.count));
+
+            // Keep the usual asynchronous behaviour of a request
+            MXHTTPOperation *operation = [[MXHTTPOperation alloc] init];
+            MXSyncResponse *syncResponse = batch.syncResponse;
+            dispatch_async(dispatch_get_main_queue(), ^{
+                if (!operation.isCancelled)
+                {
+                    success(syncResponse);
+                }
+            });
+
+            // There is room for one more batch
+            [self prefetchIfPossible];
+
+            return operation;
+        }
+
+        MXLogDebug(@"[MXSyncPipeline] syncFromToken: Wait for prefetched response. Depth: %@", @(batches.count));
+        batch.success = success;
+        batch.failure = failure;
+        [self prefetchIfPossible];
+        return batch.operation;
+    }
+
+    if (batch)
+    {
+        MXLogDebug(@"[MXSyncPipeline] syncFromToken: Discard %@ prefetched batches", @(batches.count));
+    }
+    [self cancel];
+
+    batch = [[MXSyncPipelineBatch alloc] init];
+    batch.token = token;
+    batch.serverTimeout = serverTimeout;
+    batch.clientTimeout = clientTimeout;
+    batch.setPresence = setPresence;
+    batch.filterId = filterId;
+    batch.success = success;
+    batch.failure = failure;
+
+    [self sendRequestForBatch:batch];
+
+    return batch.operation;
+}
+
+- (void)cancel
+{
+    for (MXSyncPipelineBatch *batch in batches)
+    {
+        [batch.operation cancel];
+    }
+    [batches removeAllObjects];
+
+    // The last batch may be the one the session is waiting for
+    [lastBatch.operation cancel];
+    lastBatch = nil;
+}
+
+- (void)didStoreSyncResponse:(MXSyncResponse *)syncResponse
+{
+    storedToken = syncResponse.nextBatch;
+
+    // Resume the prefetch if it was waiting for this response
+    [self prefetchIfPossible];
+}
+
+
+#pragma mark - Private methods
+
+- (void)sendRequestForBatch:(MXSyncPipelineBatch*)batch
+{
+    lastBatch = batch;
+
+    MXWeakify(self);
+    batch.operation = [restClient syncFromToken:batch.token serverTimeout:batch.serverTimeout clientTimeout:batch.clientTimeout setPresence:batch.setPresence filter:batch.filterId success:^(MXSyncResponse *syncResponse) {
+        MXStrongifyAndReturnIfNil(self);
+
+        if (batch.operation.isCancelled)
+        {
+            return;
+        }
+
+        batch.syncResponse = syncResponse;
+
+        // Send the next request before the session starts processing this response
+        [self prefetchIfPossible];
+
+        if (batch.success)
+        {
+            void (^success)(MXSyncResponse *) = batch.success;
+            batch.success = nil;
+            batch.failure = nil;
+            success(syncResponse);
+        }
+
+    } failure:^(NSError *error) {
+        MXStrongifyAndReturnIfNil(self);
+
+        // The chain is broken. The session will request this batch again
+        [self->batches removeObject:batch];
+        if (self->lastBatch == batch)
+        {
+            self->lastBatch = nil;
+        }
+
+        if (batch.failure)
+        {
+            void (^failure)(NSError *) = batch.failure;
+            batch.success = nil;
+            batch.failure = nil;
+            failure(error);
+        }
+        else
+        {
+            MXLogDebug(@"[MXSyncPipeline] Prefetch failed: %@", error);
+        }
+    }];
+}
+
+- (void)prefetchIfPossible
+{
+    MXSyncResponse *syncResponse = lastBatch.syncResponse;
+    if (!syncResponse.nextBatch || batches.count >= _maxDepth)
+    {
+        // Either the last request is still running or the queue is full
+        return;
+    }
+
+    if (MXSyncPipelineHasUnrecoverableData(syncResponse)
+        && !MXSyncPipelineIsSameString(syncResponse.nextBatch, storedToken))
+    {
+        // Requesting the next batch would make the server delete these to-device events
+        // before they are processed. Wait for the session to store this response
+        MXLogDebug(@"[MXSyncPipeline] Wait for the response to be stored before prefetching from token: %@", syncResponse.nextBatch);
+        return;
+    }
+
+    MXSyncPipelineBatch *batch = [[MXSyncPipelineBatch alloc] init];
+    batch.token = syncResponse.nextBatch;
+    batch.serverTimeout = _nextServerTimeoutBlock ? _nextServerTimeoutBlock(lastBatch.serverTimeout, syncResponse) : lastBatch.serverTimeout;
+    batch.clientTimeout = lastBatch.clientTimeout;
+    batch.setPresence = lastBatch.setPresence;
+    batch.filterId = lastBatch.filterId;
+
+    MXLogDebug(@"[MXSyncPipeline] Prefetch from token: %@. Depth: %@", batch.token, @(batches.count + 1));
+
+    [batches addObject:batch];
+    [self sendRequestForBatch:batch];
+}
+
+@end
@@ -186,8 +186,8 @@ internal class MXStoreRoomListDataFetcher: NSObject, MXRoomListDataFetcher {
                                                name: .mxSessionDidLeaveRoom,
                                                object: nil)
         NotificationCenter.default.addObserver(self,
-                                               selector: #selector(roomSummaryUpdated(_:)),
-                                               name: .mxRoomSummaryDidChange,
+                                               selector: #selector(roomSummariesUpdated(_:)),
+                                               name: .mxSessionDidUpdateRoomSummaries,
                                                object: nil)
         NotificationCenter.default.addObserver(self,
                                                selector: #selector(directRoomsUpdated(_:)),
@@ -203,7 +203,7 @@ internal class MXStoreRoomListDataFetcher: NSObject, MXRoomListDataFetcher {
                                                   name: .mxSessionDidLeaveRoom,
                                                   object: nil)
         NotificationCenter.default.removeObserver(self,
-                                                  name: .mxRoomSummaryDidChange,
+                                                  name: .mxSessionDidUpdateRoomSummaries,
                                                   object: nil)
         NotificationCenter.default.removeObserver(self,
                                                   name: .mxSessionDirectRoomsDidChange,
@@ -249,17 +249,21 @@ internal class MXStoreRoomListDataFetcher: NSObject, MXRoomListDataFetcher {
     }
     
     @objc
-    private func roomSummaryUpdated(_ notification: Notification) {
+    private func roomSummariesUpdated(_ notification: Notification) {
         executionQueue.async { [weak self] in
             guard let self = self else { return }
             guard let data = self.data else {
                 //  ignore this change if we never computed data yet
                 return
             }
-            guard let summary = notification.object as? MXRoomSummary else {
+            guard let changes = notification.userInfo?[kMXSessionNotificationRoomSummaryChangesKey] as? [MXRoomSummaryChange],
+                  !changes.isEmpty else {
                 return
             }
-            self.roomSummaries[summary.roomId] = summary
+            //  recompute once for the whole batch
+            for change in changes {
+                self.roomSummaries[change.roomId] = change.summary
+            }
             self.recomputeData(using: data)
         }
     }
@@ -27,9 +27,9 @@ NS_ASSUME_NONNULL_BEGIN
  + NSCachesDirectory
     + MXFileRoomSummaryStore
         + Matrix user id (one folder per account)
-            + {roomId1}
-            + {roomId2}
-            + ...
+            + summaries.table: all room summaries (see `MXRoomSummaryTable`)
+
+ Summaries stored by previous versions, one file per room, are moved into the table on first use.
  */
 @interface MXFileRoomSummaryStore : MXMemoryRoomSummaryStore
 
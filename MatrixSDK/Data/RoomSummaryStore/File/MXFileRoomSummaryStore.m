@@ -17,8 +17,10 @@
 #import "MXFileRoomSummaryStore.h"
 #import "MXTools.h"
 #import "MatrixSDKSwiftHeader.h"
+#import "MXRoomSummaryTable.h"
 
 static NSString *const kMXFileRoomSummaryStoreFolder = @"MXFileRoomSummaryStore";
+static NSString *const kMXFileRoomSummaryStoreTableFile = @"summaries.table";
 
 @interface MXFileRoomSummaryStore()
 {
@@ -29,7 +31,19 @@ static NSString *const kMXFileRoomSummaryStoreFolder = @"MXFileRoomSummaryStore"
     NSString *storePath;
 
     //  Execution queue for computationally expensive operations.
+    //  All writes to the table are done on this queue.
     dispatch_queue_t executionQueue;
+
+    // The table containing all summaries. Loaded on first use
+    // Set on executionQueue, within @synchronized(self) to be read from other threads
+    MXRoomSummaryTable *table;
+
+    // Ids of the stored rooms, including the ones still being written. nil until the table is loaded.
+    // Guarded by @synchronized(self). It lets reads from the main thread skip executionQueue
+    NSMutableSet<NSString*> *roomIds;
+
+    // Rooms stored (YES) or removed (NO) before roomIds is loaded
+    NSMutableDictionary<NSString*, NSNumber*> *pendingRoomIdChanges;
 }
 @end
 
@@ -41,6 +55,7 @@ static NSString *const kMXFileRoomSummaryStoreFolder = @"MXFileRoomSummaryStore"
     {
         self->credentials = credentials;
         executionQueue = dispatch_queue_create("MXFileRoomSummaryStoreExecutionQueue", DISPATCH_QUEUE_SERIAL);
+        pendingRoomIdChanges = [NSMutableDictionary dictionary];
         [self setUpStoragePaths];
     }
     return self;
@@ -76,38 +91,174 @@ static NSString *const kMXFileRoomSummaryStoreFolder = @"MXFileRoomSummaryStore"
     }
 }
 
-- (NSString*)summaryFileForRoom:(NSString*)roomId
+/**
+ The summaries table. Must be called on executionQueue.
+ */
+- (MXRoomSummaryTable*)table
+{
+    if (!table)
+    {
+        NSDate *startDate = [NSDate date];
+
+        [self checkStorePathExistence];
+        MXRoomSummaryTable *newTable = [[MXRoomSummaryTable alloc] initWithPath:[storePath stringByAppendingPathComponent:kMXFileRoomSummaryStoreTableFile]];
+        [self migrateSummaryFilesToTable:newTable];
+
+        @synchronized (self)
+        {
+            table = newTable;
+
+            if (!roomIds)
+            {
+                roomIds = [NSMutableSet setWithArray:newTable.roomIds];
+                [pendingRoomIdChanges enumerateKeysAndObjectsUsingBlock:^(NSString *roomId, NSNumber *stored, BOOL *stop) {
+                    if (stored.boolValue)
+                    {
+                        [self->roomIds addObject:roomId];
+                    }
+                    else
+                    {
+                        [self->roomIds removeObject:roomId];
+                    }
+                }];
+                [pendingRoomIdChanges removeAllObjects];
+            }
+        }
+
+        MXLogDebug(@"[MXFileRoomSummaryStore] Loaded table of %@ room summaries in %.0fms", @(table.count), [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+    }
+    return table;
+}
+
+/**
+ The table, once loaded, for reads from any thread.
+ Only the first call waits for executionQueue, to load the table.
+
+ @return the table. nil if all summaries have been removed.
+ */
+- (MXRoomSummaryTable*)loadedTable
+{
+    @synchronized (self)
+    {
+        if (roomIds)
+        {
+            return table;
+        }
+    }
+
+    dispatch_sync(executionQueue, ^{
+        [self table];
+    });
+
+    @synchronized (self)
+    {
+        return table;
+    }
+}
+
+- (void)updateRoomId:(NSString*)roomId stored:(BOOL)stored
 {
-    return [storePath stringByAppendingPathComponent:roomId];
+    @synchronized (self)
+    {
+        if (!roomIds)
+        {
+            pendingRoomIdChanges[roomId] = @(stored);
+        }
+        else if (stored)
+        {
+            [roomIds addObject:roomId];
+        }
+        else
+        {
+            [roomIds removeObject:roomId];
+        }
+    }
+}
+
+/**
+ Move summaries stored by previous versions, one file per room, into the table.
+ */
+- (void)migrateSummaryFilesToTable:(MXRoomSummaryTable*)summaryTable
+{
+    NSArray<NSString *> *files = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storePath error:nil];
+    NSUInteger migratedCount = 0;
+
+    for (NSString *file in files)
+    {
+        // Legacy files are named by room id. Leave the table, its temporary files and any other file
+        if (![MXTools isMatrixRoomIdentifier:file])
+        {
+            continue;
+        }
+
+        NSString *summaryFile = [storePath stringByAppendingPathComponent:file];
+        BOOL isDirectory = NO;
+        if (![[NSFileManager defaultManager] fileExistsAtPath:summaryFile isDirectory:&isDirectory] || isDirectory)
+        {
+            continue;
+        }
+
+        NSData *data = [NSData dataWithContentsOfFile:summaryFile];
+        if (data)
+        {
+            [summaryTable setData:data forRoomId:file];
+            migratedCount++;
+        }
+        [[NSFileManager defaultManager] removeItemAtPath:summaryFile error:nil];
+    }
+
+    if (migratedCount)
+    {
+        MXLogDebug(@"[MXFileRoomSummaryStore] Migrated %@ room summary files into the table", @(migratedCount));
+    }
+}
+
+- (id<MXRoomSummaryProtocol>)summaryFromData:(NSData*)data ofRoom:(NSString*)roomId
+{
+    id<MXRoomSummaryProtocol> summary;
+    @try
+    {
+        summary = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+    }
+    @catch(NSException *exception)
+    {
+        NSDictionary *details = @{
+            @"room_id": roomId ?: @"unknown",
+            @"exception": exception ?: @"unknown"
+        };
+        MXLogErrorDetails(@"[MXFileStore] Warning: room summary file for room has been corrupted", details);
+    }
+    return summary;
 }
 
 #pragma mark - MXRoomSummaryStore
 
 - (NSArray<NSString *> *)rooms
 {
-    NSArray<NSString *> *result = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storePath error:nil];
-    if (!result)
+    [self loadedTable];
+    @synchronized (self)
     {
-        return @[];
+        return roomIds.allObjects;
     }
-    return result;
 }
 
 - (NSUInteger)countOfRooms
 {
-    NSArray<NSString *> *result = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storePath error:nil];
-    return result.count;
+    [self loadedTable];
+    @synchronized (self)
+    {
+        return roomIds.count;
+    }
 }
 
 - (void)storeSummary:(id<MXRoomSummaryProtocol>)summary
 {
     [super storeSummary:summary];
+    [self updateRoomId:summary.roomId stored:YES];
     
     dispatch_async(executionQueue, ^{
-        NSString *file = [self summaryFileForRoom:summary.roomId];
-        [self checkStorePathExistence];
-        
-        [NSKeyedArchiver archiveRootObject:summary toFile:file];
+        NSData *data = [NSKeyedArchiver archivedDataWithRootObject:summary];
+        [self.table setData:data forRoomId:summary.roomId];
     });
 }
 
@@ -116,27 +267,27 @@ static NSString *const kMXFileRoomSummaryStoreFolder = @"MXFileRoomSummaryStore"
     id<MXRoomSummaryProtocol> summary = [super summaryOfRoom:roomId];
     if (!summary)
     {
-        NSString *summaryFile = [self summaryFileForRoom:roomId];
-        if ([[NSFileManager defaultManager] fileExistsAtPath:summaryFile])
+        // Summaries being written are still in memory. Read the others without waiting for the writes
+        MXRoomSummaryTable *loadedTable = [self loadedTable];
+        BOOL isStored;
+        @synchronized (self)
+        {
+            isStored = [roomIds containsObject:roomId];
+        }
+        NSData *data = isStored ? [loadedTable dataForRoomId:roomId] : nil;
+
+        if (data)
         {
-            @try
+            NSDate *startDate = [NSDate date];
+            summary = [self summaryFromData:data ofRoom:roomId];
+            if (summary)
             {
-                NSDate *startDate = [NSDate date];
-                summary = [NSKeyedUnarchiver unarchiveObjectWithFile:summaryFile];
                 [super storeSummary:summary];
-                
-                if ([NSThread isMainThread])
-                {
-                    MXLogWarning(@"[MXFileStore] Loaded room summary of room: %@ in %.0fms, in main thread", roomId, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
-                }
             }
-            @catch(NSException *exception)
+
+            if ([NSThread isMainThread])
             {
-                NSDictionary *details = @{
-                    @"room_id": roomId ?: @"unknown",
-                    @"exception": exception ?: @"unknown"
-                };
-                MXLogErrorDetails(@"[MXFileStore] Warning: room summary file for room has been corrupted", details);
+                MXLogWarning(@"[MXFileStore] Loaded room summary of room: %@ in %.0fms, in main thread", roomId, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
             }
         }
     }
@@ -146,33 +297,46 @@ static NSString *const kMXFileRoomSummaryStoreFolder = @"MXFileRoomSummaryStore"
 - (void)removeSummaryOfRoom:(NSString *)roomId
 {
     [super removeSummaryOfRoom:roomId];
+    [self updateRoomId:roomId stored:NO];
     
-    NSString *summaryFile = [self summaryFileForRoom:roomId];
-    [[NSFileManager defaultManager] removeItemAtPath:summaryFile error:nil];
+    dispatch_async(executionQueue, ^{
+        [self.table removeDataForRoomId:roomId];
+    });
 }
 
 - (void)removeAllSummaries
 {
     [super removeAllSummaries];
+    @synchronized (self)
+    {
+        roomIds = [NSMutableSet set];
+        [pendingRoomIdChanges removeAllObjects];
+    }
     
-    [[NSFileManager defaultManager] removeItemAtPath:storePath error:nil];
+    dispatch_async(executionQueue, ^{
+        [self->table removeAllData];
+        @synchronized (self)
+        {
+            self->table = nil;
+        }
+        [[NSFileManager defaultManager] removeItemAtPath:self->storePath error:nil];
+    });
 }
 
 - (void)fetchAllSummaries:(void (^)(NSArray<id<MXRoomSummaryProtocol>> * _Nonnull))completion
 {
     dispatch_async(executionQueue, ^{
-        NSArray<NSString *> *roomIDs = self.rooms;
-        NSMutableArray<id<MXRoomSummaryProtocol>> *result = [NSMutableArray arrayWithCapacity:roomIDs.count];
+        NSMutableArray<id<MXRoomSummaryProtocol>> *result = [NSMutableArray arrayWithCapacity:self.table.count];
         
-        for (NSString *roomId in roomIDs)
-        {
-            NSString *summaryFile = [self summaryFileForRoom:roomId];
-            id<MXRoomSummaryProtocol> summary = [NSKeyedUnarchiver unarchiveObjectWithFile:summaryFile];
+        // One sequential read of the table
+        [self.table enumerateDataUsingBlock:^(NSString *roomId, NSData *data) {
+            id<MXRoomSummaryProtocol> summary = [self summaryFromData:data ofRoom:roomId];
             if (summary)
             {
                 [result addObject:summary];
             }
-        }
+        }];
+        
         dispatch_async(dispatch_get_main_queue(), ^{
             completion(result);
         });
@@ -0,0 +1,115 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ `MXRoomSummaryTable` stores data blobs by room id in a single packed file.
+
+ The file structure is the following:
+ + header: magic, version, record capacity, heap end
+ + records: `recordCapacity` fixed-width records. A used record points to its room id and data in the heap
+ + heap: room ids and data blobs
+
+ Each data blob has some spare capacity so that an updated summary is usually rewritten in place.
+ Bigger blobs are appended to the heap. The space they leave, like the space of removed rooms, is
+ reclaimed by compaction, which runs when it exceeds half of the heap.
+
+ The whole table is loaded with a single sequential read. An in-memory index maps room ids to records.
+
+ Data that grows out of its slot is written before its record points to it, so that a crash does not
+ lose the previous version. A file that cannot be opened, eg while the device is locked, is never reset.
+
+ Writes must be done from a single thread or serial queue. `roomIds`, `count` and `dataForRoomId:` can
+ be called from any thread, without waiting for the writes. Data updated in place at the same time
+ may be read partially updated.
+ */
+@interface MXRoomSummaryTable : NSObject
+
+/**
+ Open the table at a path. The file is created if it does not exist.
+ A corrupted file is reset. A file that cannot be opened is opened again on the next write.
+
+ @param path the path of the table file.
+ @return a `MXRoomSummaryTable` instance.
+ */
+- (instancetype)initWithPath:(NSString*)path;
+
+/**
+ The path of the table file.
+ */
+@property (nonatomic, readonly) NSString *path;
+
+/**
+ The room ids stored in the table.
+ */
+@property (nonatomic, readonly) NSArray<NSString*> *roomIds;
+
+/**
+ The number of rooms stored in the table.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ The number of bytes in the heap that are not used anymore.
+ */
+@property (nonatomic, readonly) uint64_t unusedBytes;
+
+/**
+ Get the data stored for a room.
+
+ @param roomId the room id.
+ @return the data. nil if there is no data for this room.
+ */
+- (nullable NSData*)dataForRoomId:(NSString*)roomId;
+
+/**
+ Store the data of a room.
+
+ @param data the data.
+ @param roomId the room id.
+ */
+- (void)setData:(NSData*)data forRoomId:(NSString*)roomId;
+
+/**
+ Remove the data of a room.
+
+ @param roomId the room id.
+ */
+- (void)removeDataForRoomId:(NSString*)roomId;
+
+/**
+ Remove all data and delete the table file.
+ */
+- (void)removeAllData;
+
+/**
+ Enumerate the data of all rooms. The table file is read once.
+
+ @param block the block called for each room.
+ */
+- (void)enumerateDataUsingBlock:(void (^)(NSString *roomId, NSData *data))block;
+
+/**
+ Rewrite the table file without unused space.
+ */
+- (void)compact;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,600 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXRoomSummaryTable.h"
+
+#import "MXLog.h"
+
+#import <unistd.h>
+
+static uint32_t const kMXRoomSummaryTableMagic = 0x5453584D; // "MXST"
+static uint32_t const kMXRoomSummaryTableVersion = 1;
+static uint32_t const kMXRoomSummaryTableMinRecordCapacity = 64;
+static uint32_t const kMXRoomSummaryTableRecordFlagUsed = 1;
+
+// Unused heap space below which compaction is not worth it
+static uint64_t const kMXRoomSummaryTableMinUnusedBytesForCompaction = 64 * 1024;
+
+// All fields are stored in host byte order (little endian on all supported platforms)
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordCapacity;
+    uint32_t reserved;
+    uint64_t heapEnd;
+    uint64_t reserved2;
+} MXRoomSummaryTableHeader;
+
+typedef struct
+{
+    uint32_t flags;
+    uint32_t roomIdLength;
+    uint64_t roomIdOffset;
+    uint64_t dataOffset;
+    uint32_t dataLength;
+    uint32_t dataCapacity;
+} MXRoomSummaryTableRecord;
+
+_Static_assert(sizeof(MXRoomSummaryTableHeader) == 32, "Unexpected MXRoomSummaryTableHeader size");
+_Static_assert(sizeof(MXRoomSummaryTableRecord) == 32, "Unexpected MXRoomSummaryTableRecord size");
+
+/**
+ Capacity to reserve in the heap for a data blob, so that it can grow a bit in place.
+ */
+static uint32_t MXRoomSummaryTableCapacityForLength(NSUInteger length)
+{
+    NSUInteger capacity = length + length / 4;
+    return (uint32_t)((capacity + 63) & ~(NSUInteger)63);
+}
+
+static uint64_t MXRoomSummaryTableHeapStart(uint32_t recordCapacity)
+{
+    return sizeof(MXRoomSummaryTableHeader) + (uint64_t)recordCapacity * sizeof(MXRoomSummaryTableRecord);
+}
+
+static MXRoomSummaryTableRecord MXRoomSummaryTableRecordAtIndex(NSData *recordsData, uint32_t index)
+{
+    MXRoomSummaryTableRecord record;
+    [recordsData getBytes:&record range:NSMakeRange(index * sizeof(MXRoomSummaryTableRecord), sizeof(MXRoomSummaryTableRecord))];
+    return record;
+}
+
+typedef NS_ENUM(NSUInteger, MXRoomSummaryTableLoadResult)
+{
+    MXRoomSummaryTableLoadResultLoaded,
+    // The file is missing or is not a valid table
+    MXRoomSummaryTableLoadResultInvalid,
+    // The file exists but cannot be read now, eg when it is protected while the device is locked
+    MXRoomSummaryTableLoadResultUnavailable
+};
+
+@interface MXRoomSummaryTable ()
+{
+    NSFileHandle *fileHandle;
+
+    // Handle used by `dataForRoomId:`, which can be called from any thread
+    NSFileHandle *readHandle;
+
+    MXRoomSummaryTableHeader header;
+
+    // Copy of the records area of the file. Guarded by @synchronized(self), like recordIndexes and readHandle
+    NSMutableData *recordsData;
+
+    // Record index by room id
+    NSMutableDictionary<NSString*, NSNumber*> *recordIndexes;
+
+    // Indexes of the unused records
+    NSMutableIndexSet *freeRecordIndexes;
+}
+@end
+
+@implementation MXRoomSummaryTable
+
+- (instancetype)initWithPath:(NSString *)path
+{
+    self = [super init];
+    if (self)
+    {
+        _path = path;
+        recordIndexes = [NSMutableDictionary dictionary];
+        freeRecordIndexes = [NSMutableIndexSet indexSet];
+
+        switch ([self load])
+        {
+            case MXRoomSummaryTableLoadResultLoaded:
+                break;
+            case MXRoomSummaryTableLoadResultInvalid:
+                [self rewriteWithRecordCapacity:kMXRoomSummaryTableMinRecordCapacity entries:@{}];
+                break;
+            case MXRoomSummaryTableLoadResultUnavailable:
+                // Do not lose the stored summaries. The file will be opened again on the next write
+                MXLogError(@"[MXRoomSummaryTable] init: Cannot open the table file");
+                break;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [fileHandle closeFile];
+}
+
+- (NSArray<NSString *> *)roomIds
+{
+    @synchronized (self)
+    {
+        return recordIndexes.allKeys;
+    }
+}
+
+- (NSUInteger)count
+{
+    @synchronized (self)
+    {
+        return recordIndexes.count;
+    }
+}
+
+- (NSData *)dataForRoomId:(NSString *)roomId
+{
+    MXRoomSummaryTableRecord record;
+    NSFileHandle *handle;
+    @synchronized (self)
+    {
+        NSNumber *recordIndex = recordIndexes[roomId];
+        if (!recordIndex || !readHandle)
+        {
+            return nil;
+        }
+
+        record = [self recordAtIndex:recordIndex.unsignedIntValue];
+        handle = readHandle;
+    }
+
+    // pread does not use the file offset. Reads do not interfere with each other or with writes.
+    // After a compaction, the handle still reads the previous file, which matches the record
+    NSMutableData *data = [NSMutableData dataWithLength:record.dataLength];
+    ssize_t readLength = pread(handle.fileDescriptor, data.mutableBytes, record.dataLength, (off_t)record.dataOffset);
+    if (readLength != (ssize_t)record.dataLength)
+    {
+        MXLogError(@"[MXRoomSummaryTable] dataForRoomId: Cannot read data");
+        return nil;
+    }
+    return data;
+}
+
+- (void)setData:(NSData *)data forRoomId:(NSString *)roomId
+{
+    if (!fileHandle && ![self reopen])
+    {
+        MXLogError(@"[MXRoomSummaryTable] setData: Cannot open the table file. Data not stored");
+        return;
+    }
+
+    NSNumber *recordIndex;
+    @synchronized (self)
+    {
+        recordIndex = recordIndexes[roomId];
+    }
+
+    @try
+    {
+        if (recordIndex)
+        {
+            uint32_t index = recordIndex.unsignedIntValue;
+            MXRoomSummaryTableRecord record = [self recordAtIndex:index];
+
+            if (data.length > record.dataCapacity)
+            {
+                // Move the data to the end of the heap. The record keeps pointing to the previous
+                // data until the new one is completely written. The previous slot becomes unused
+                uint32_t dataCapacity = MXRoomSummaryTableCapacityForLength(data.length);
+                uint64_t dataOffset = [self extendHeapBy:dataCapacity synchronize:YES];
+                [fileHandle seekToFileOffset:dataOffset];
+                [fileHandle writeData:data];
+
+                _unusedBytes += record.dataCapacity;
+                record.dataOffset = dataOffset;
+                record.dataCapacity = dataCapacity;
+            }
+            else
+            {
+                // Update in place
+                [fileHandle seekToFileOffset:record.dataOffset];
+                [fileHandle writeData:data];
+            }
+            record.dataLength = (uint32_t)data.length;
+
+            [self writeRecord:record atIndex:index];
+        }
+        else
+        {
+            if (!freeRecordIndexes.count)
+            {
+                // No more records. Make room for more while compacting
+                [self compactWithRecordCapacity:header.recordCapacity * 2];
+                if (!freeRecordIndexes.count)
+                {
+                    MXLogError(@"[MXRoomSummaryTable] setData: Cannot grow the table. Data not stored");
+                    return;
+                }
+            }
+
+            uint32_t index = (uint32_t)freeRecordIndexes.firstIndex;
+
+            NSData *roomIdData = [roomId dataUsingEncoding:NSUTF8StringEncoding];
+
+            MXRoomSummaryTableRecord record = {0};
+            record.flags = kMXRoomSummaryTableRecordFlagUsed;
+            record.roomIdLength = (uint32_t)roomIdData.length;
+            record.dataLength = (uint32_t)data.length;
+            record.dataCapacity = MXRoomSummaryTableCapacityForLength(data.length);
+
+            // A new room has no previous data to lose. There is no need to flush the header
+            record.roomIdOffset = [self extendHeapBy:record.roomIdLength + record.dataCapacity synchronize:NO];
+            record.dataOffset = record.roomIdOffset + record.roomIdLength;
+            [fileHandle seekToFileOffset:record.roomIdOffset];
+            [fileHandle writeData:roomIdData];
+            [fileHandle writeData:data];
+
+            [self writeRecord:record atIndex:index];
+
+            [freeRecordIndexes removeIndex:index];
+            @synchronized (self)
+            {
+                recordIndexes[roomId] = @(index);
+            }
+        }
+    }
+    @catch (NSException *exception)
+    {
+        MXLogErrorDetails(@"[MXRoomSummaryTable] setData: Cannot write data", @{
+            @"exception": exception ?: @"unknown"
+        });
+        return;
+    }
+
+    [self compactIfNeeded];
+}
+
+- (void)removeDataForRoomId:(NSString *)roomId
+{
+    if (!fileHandle && ![self reopen])
+    {
+        MXLogError(@"[MXRoomSummaryTable] removeDataForRoomId: Cannot open the table file. Data not removed");
+        return;
+    }
+
+    NSNumber *recordIndex;
+    @synchronized (self)
+    {
+        recordIndex = recordIndexes[roomId];
+    }
+    if (!recordIndex)
+    {
+        return;
+    }
+
+    uint32_t index = recordIndex.unsignedIntValue;
+    MXRoomSummaryTableRecord record = [self recordAtIndex:index];
+    _unusedBytes += record.roomIdLength + record.dataCapacity;
+
+    MXRoomSummaryTableRecord emptyRecord = {0};
+    @try
+    {
+        [self writeRecord:emptyRecord atIndex:index];
+    }
+    @catch (NSException *exception)
+    {
+        MXLogErrorDetails(@"[MXRoomSummaryTable] removeDataForRoomId: Cannot write record", @{
+            @"exception": exception ?: @"unknown"
+        });
+    }
+
+    @synchronized (self)
+    {
+        [recordIndexes removeObjectForKey:roomId];
+    }
+    [freeRecordIndexes addIndex:index];
+
+    [self compactIfNeeded];
+}
+
+- (void)removeAllData
+{
+    [fileHandle closeFile];
+    fileHandle = nil;
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+
+    [self rewriteWithRecordCapacity:kMXRoomSummaryTableMinRecordCapacity entries:@{}];
+}
+
+- (void)enumerateDataUsingBlock:(void (^)(NSString *, NSData *))block
+{
+    // Read the whole file at once
+    NSData *contents = [NSData dataWithContentsOfFile:_path];
+
+    for (NSString *roomId in recordIndexes)
+    {
+        MXRoomSummaryTableRecord record = [self recordAtIndex:recordIndexes[roomId].unsignedIntValue];
+        if (record.dataOffset + record.dataLength <= contents.length)
+        {
+            block(roomId, [contents subdataWithRange:NSMakeRange((NSUInteger)record.dataOffset, record.dataLength)]);
+        }
+    }
+}
+
+- (void)compact
+{
+    [self compactWithRecordCapacity:header.recordCapacity];
+}
+
+
+#pragma mark - Private methods
+
+- (uint64_t)heapStart
+{
+    return MXRoomSummaryTableHeapStart(header.recordCapacity);
+}
+
+- (MXRoomSummaryTableRecord)recordAtIndex:(uint32_t)index
+{
+    return MXRoomSummaryTableRecordAtIndex(recordsData, index);
+}
+
+- (void)writeRecord:(MXRoomSummaryTableRecord)record atIndex:(uint32_t)index
+{
+    NSRange range = NSMakeRange(index * sizeof(MXRoomSummaryTableRecord), sizeof(MXRoomSummaryTableRecord));
+
+    [fileHandle seekToFileOffset:sizeof(MXRoomSummaryTableHeader) + range.location];
+    [fileHandle writeData:[NSData dataWithBytes:&record length:sizeof(record)]];
+
+    @synchronized (self)
+    {
+        [recordsData replaceBytesInRange:range withBytes:&record];
+    }
+}
+
+- (void)writeHeader
+{
+    [fileHandle seekToFileOffset:0];
+    [fileHandle writeData:[NSData dataWithBytes:&header length:sizeof(header)]];
+}
+
+/**
+ Extend the heap by `length` zeroed bytes.
+
+ The file and the header are extended before the caller writes data and a record there. Else a
+ record could point past the heap end written in the file, and be dropped when the file is loaded.
+
+ @param length the number of bytes to add.
+ @param synchronize YES to flush the header to the disk before returning, so that the record cannot
+                    reach the disk before it. Required when the record already points to some data.
+ @return the offset of the new space.
+ */
+- (uint64_t)extendHeapBy:(uint64_t)length synchronize:(BOOL)synchronize
+{
+    uint64_t offset = header.heapEnd;
+
+    [fileHandle truncateFileAtOffset:offset + length];
+    header.heapEnd = offset + length;
+    [self writeHeader];
+
+    if (synchronize)
+    {
+        [fileHandle synchronizeFile];
+    }
+    return offset;
+}
+
+- (MXRoomSummaryTableLoadResult)load
+{
+    [fileHandle closeFile];
+    fileHandle = nil;
+    @synchronized (self)
+    {
+        recordsData = [NSMutableData data];
+        recordIndexes = [NSMutableDictionary dictionary];
+        readHandle = nil;
+    }
+    freeRecordIndexes = [NSMutableIndexSet indexSet];
+    header = (MXRoomSummaryTableHeader){0};
+    _unusedBytes = 0;
+
+    NSData *contents = [NSData dataWithContentsOfFile:_path];
+    if (!contents)
+    {
+        return [[NSFileManager defaultManager] fileExistsAtPath:_path] ? MXRoomSummaryTableLoadResultUnavailable : MXRoomSummaryTableLoadResultInvalid;
+    }
+
+    if (contents.length < sizeof(MXRoomSummaryTableHeader))
+    {
+        MXLogError(@"[MXRoomSummaryTable] load: Truncated file. Reset it");
+        return MXRoomSummaryTableLoadResultInvalid;
+    }
+
+    MXRoomSummaryTableHeader fileHeader;
+    [contents getBytes:&fileHeader length:sizeof(fileHeader)];
+    uint64_t heapStart = MXRoomSummaryTableHeapStart(fileHeader.recordCapacity);
+    if (fileHeader.magic != kMXRoomSummaryTableMagic
+        || fileHeader.version != kMXRoomSummaryTableVersion
+        || contents.length < heapStart
+        || fileHeader.heapEnd > contents.length)
+    {
+        MXLogError(@"[MXRoomSummaryTable] load: Invalid file. Reset it");
+        return MXRoomSummaryTableLoadResultInvalid;
+    }
+
+    NSMutableData *fileRecordsData = [[contents subdataWithRange:NSMakeRange(sizeof(MXRoomSummaryTableHeader), fileHeader.recordCapacity * sizeof(MXRoomSummaryTableRecord))] mutableCopy];
+    NSMutableDictionary<NSString*, NSNumber*> *fileRecordIndexes = [NSMutableDictionary dictionary];
+    NSMutableIndexSet *fileFreeRecordIndexes = [NSMutableIndexSet indexSet];
+
+    uint64_t usedBytes = 0;
+    for (uint32_t index = 0; index < fileHeader.recordCapacity; index++)
+    {
+        MXRoomSummaryTableRecord record = MXRoomSummaryTableRecordAtIndex(fileRecordsData, index);
+        if (!(record.flags & kMXRoomSummaryTableRecordFlagUsed)
+            || record.roomIdOffset + record.roomIdLength > fileHeader.heapEnd
+            || record.dataOffset + record.dataCapacity > fileHeader.heapEnd)
+        {
+            [fileFreeRecordIndexes addIndex:index];
+            continue;
+        }
+
+        NSString *roomId = [[NSString alloc] initWithBytes:(const char *)contents.bytes + record.roomIdOffset
+                                                    length:record.roomIdLength
+                                                  encoding:NSUTF8StringEncoding];
+        if (!roomId)
+        {
+            [fileFreeRecordIndexes addIndex:index];
+            continue;
+        }
+
+        fileRecordIndexes[roomId] = @(index);
+        usedBytes += record.roomIdLength + record.dataCapacity;
+    }
+
+    NSFileHandle *fileUpdatingHandle = [NSFileHandle fileHandleForUpdatingAtPath:_path];
+    NSFileHandle *fileReadingHandle = [NSFileHandle fileHandleForReadingAtPath:_path];
+    if (!fileUpdatingHandle || !fileReadingHandle)
+    {
+        return MXRoomSummaryTableLoadResultUnavailable;
+    }
+
+    header = fileHeader;
+    freeRecordIndexes = fileFreeRecordIndexes;
+    _unusedBytes = fileHeader.heapEnd - heapStart - usedBytes;
+    fileHandle = fileUpdatingHandle;
+    @synchronized (self)
+    {
+        recordsData = fileRecordsData;
+        recordIndexes = fileRecordIndexes;
+        readHandle = fileReadingHandle;
+    }
+    return MXRoomSummaryTableLoadResultLoaded;
+}
+
+/**
+ Open the table file again after it could not be opened or written.
+
+ The file is read again. It is reset only if it is missing or invalid, never because it cannot be
+ opened: that would lose all stored summaries.
+
+ @return YES if the file is open.
+ */
+- (BOOL)reopen
+{
+    if ([self load] == MXRoomSummaryTableLoadResultInvalid)
+    {
+        [self rewriteWithRecordCapacity:kMXRoomSummaryTableMinRecordCapacity entries:@{}];
+    }
+    return fileHandle != nil;
+}
+
+- (void)compactIfNeeded
+{
+    uint64_t heapSize = header.heapEnd - self.heapStart;
+    if (_unusedBytes > kMXRoomSummaryTableMinUnusedBytesForCompaction && _unusedBytes > heapSize / 2)
+    {
+        [self compact];
+    }
+}
+
+- (void)compactWithRecordCapacity:(uint32_t)recordCapacity
+{
+    NSDate *startDate = [NSDate date];
+
+    NSMutableDictionary<NSString*, NSData*> *entries = [NSMutableDictionary dictionaryWithCapacity:recordIndexes.count];
+    [self enumerateDataUsingBlock:^(NSString *roomId, NSData *data) {
+        entries[roomId] = data;
+    }];
+
+    recordCapacity = MAX(recordCapacity, (uint32_t)entries.count * 2);
+    [self rewriteWithRecordCapacity:recordCapacity entries:entries];
+
+    MXLogDebug(@"[MXRoomSummaryTable] compact: Compacted %@ rooms in %.0fms", @(entries.count), [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+}
+
+- (void)rewriteWithRecordCapacity:(uint32_t)recordCapacity entries:(NSDictionary<NSString*, NSData*>*)entries
+{
+    recordCapacity = MAX(recordCapacity, kMXRoomSummaryTableMinRecordCapacity);
+
+    MXRoomSummaryTableHeader newHeader = {0};
+    newHeader.magic = kMXRoomSummaryTableMagic;
+    newHeader.version = kMXRoomSummaryTableVersion;
+    newHeader.recordCapacity = recordCapacity;
+
+    uint64_t heapStart = MXRoomSummaryTableHeapStart(recordCapacity);
+    NSMutableData *newRecordsData = [NSMutableData dataWithLength:recordCapacity * sizeof(MXRoomSummaryTableRecord)];
+    NSMutableData *heap = [NSMutableData data];
+    NSMutableDictionary<NSString*, NSNumber*> *newRecordIndexes = [NSMutableDictionary dictionaryWithCapacity:entries.count];
+
+    uint32_t index = 0;
+    for (NSString *roomId in entries)
+    {
+        NSData *roomIdData = [roomId dataUsingEncoding:NSUTF8StringEncoding];
+        NSData *data = entries[roomId];
+
+        MXRoomSummaryTableRecord record = {0};
+        record.flags = kMXRoomSummaryTableRecordFlagUsed;
+        record.roomIdLength = (uint32_t)roomIdData.length;
+        record.roomIdOffset = heapStart + heap.length;
+        [heap appendData:roomIdData];
+
+        record.dataLength = (uint32_t)data.length;
+        record.dataCapacity = MXRoomSummaryTableCapacityForLength(data.length);
+        record.dataOffset = heapStart + heap.length;
+        [heap appendData:data];
+        [heap increaseLengthBy:record.dataCapacity - data.length];
+
+        [newRecordsData replaceBytesInRange:NSMakeRange(index * sizeof(MXRoomSummaryTableRecord), sizeof(MXRoomSummaryTableRecord)) withBytes:&record];
+        newRecordIndexes[roomId] = @(index);
+        index++;
+    }
+    newHeader.heapEnd = heapStart + heap.length;
+
+    NSMutableData *contents = [NSMutableData dataWithCapacity:(NSUInteger)newHeader.heapEnd];
+    [contents appendBytes:&newHeader length:sizeof(newHeader)];
+    [contents appendData:newRecordsData];
+    [contents appendData:heap];
+
+    [fileHandle closeFile];
+    fileHandle = nil;
+
+    if (![contents writeToFile:_path atomically:YES])
+    {
+        // Keep in sync with the file that is still on disk
+        MXLogError(@"[MXRoomSummaryTable] rewrite: Cannot write the table file");
+        [self load];
+        return;
+    }
+
+    header = newHeader;
+    freeRecordIndexes = [NSMutableIndexSet indexSetWithIndexesInRange:NSMakeRange(index, recordCapacity - index)];
+    _unusedBytes = 0;
+
+    fileHandle = [NSFileHandle fileHandleForUpdatingAtPath:_path];
+    @synchronized (self)
+    {
+        recordsData = newRecordsData;
+        recordIndexes = newRecordIndexes;
+        readHandle = [NSFileHandle fileHandleForReadingAtPath:_path];
+    }
+}
+
+@end
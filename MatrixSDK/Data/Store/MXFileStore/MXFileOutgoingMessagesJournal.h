@@ -0,0 +1,120 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MXEvent.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Change on the outgoing messages of a room.
+ */
+typedef NS_ENUM(NSUInteger, MXFileOutgoingMessagesJournalOperation)
+{
+    MXFileOutgoingMessagesJournalOperationStore = 0,
+    MXFileOutgoingMessagesJournalOperationRemove,
+    MXFileOutgoingMessagesJournalOperationRemoveAll
+};
+
+/**
+ A record of `MXFileOutgoingMessagesJournal`.
+ */
+@interface MXFileOutgoingMessagesJournalRecord : NSObject <NSCoding>
+
+@property (nonatomic, readonly) MXFileOutgoingMessagesJournalOperation operation;
+@property (nonatomic, readonly) NSString *roomId;
+
+/**
+ The stored message, for `MXFileOutgoingMessagesJournalOperationStore`.
+ */
+@property (nonatomic, readonly, nullable) MXEvent *event;
+
+/**
+ The id of the removed message, for `MXFileOutgoingMessagesJournalOperationRemove`.
+ */
+@property (nonatomic, readonly, nullable) NSString *eventId;
+
++ (instancetype)storeRecordWithEvent:(MXEvent*)event inRoom:(NSString*)roomId;
++ (instancetype)removeRecordWithEventId:(NSString*)eventId inRoom:(NSString*)roomId;
++ (instancetype)removeAllRecordInRoom:(NSString*)roomId;
+
+/**
+ Archive the record now, so that later changes on the event are not part of it.
+ */
+- (nullable NSData*)archivedData;
+
+@end
+
+
+/**
+ `MXFileOutgoingMessagesJournal` is an append-only log of the changes made on outgoing messages
+ since their last snapshot in the `MXFileStore` room files.
+
+ Each record is synced to disk when it is appended. The store replays the journal on top of
+ the snapshots when it opens.
+
+ The files structure is the following:
+ + {folder}
+    L outgoingMessagesJournal: the records appended since the last rotation
+    L outgoingMessagesJournal.rotated: the records covered by a snapshot being committed
+
+ Records are framed by their length and a checksum so that a record torn by a crash is ignored.
+
+ This class is not thread safe. `MXFileStore` uses it from its file queue.
+ */
+@interface MXFileOutgoingMessagesJournal : NSObject
+
+/**
+ Create a journal.
+
+ @param folder the folder containing the journal files.
+ @return a `MXFileOutgoingMessagesJournal` instance.
+ */
+- (instancetype)initWithFolder:(NSString*)folder;
+
+/**
+ Append a record and sync it to disk.
+
+ @param recordData the data returned by `-[MXFileOutgoingMessagesJournalRecord archivedData]`.
+ @return NO if the record could not be written.
+ */
+- (BOOL)appendRecordData:(NSData*)recordData;
+
+/**
+ All valid records, oldest first.
+ */
+- (NSArray<MXFileOutgoingMessagesJournalRecord*>*)records;
+
+/**
+ Set aside the current records once a snapshot of the outgoing messages has been taken.
+ Next records are appended to a new file.
+ */
+- (void)rotate;
+
+/**
+ Delete the records set aside by `rotate`, once the snapshot has been committed.
+ */
+- (void)removeRotatedRecords;
+
+/**
+ Delete all records.
+ */
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,352 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXFileOutgoingMessagesJournal.h"
+
+#import "MXLog.h"
+
+static NSString *const kMXFileOutgoingMessagesJournalFile = @"outgoingMessagesJournal";
+static NSString *const kMXFileOutgoingMessagesJournalRotatedFile = @"outgoingMessagesJournal.rotated";
+
+// Records bigger than that are considered as corrupted
+static uint32_t const kMXFileOutgoingMessagesJournalMaxRecordLength = 16 * 1024 * 1024;
+
+// Header of a record. It is followed by the archived record. Fields are stored in host byte order
+typedef struct __attribute__((packed))
+{
+    uint32_t length;
+    uint32_t checksum;
+} MXFileOutgoingMessagesJournalRecordHeader;
+
+// FNV-1a
+static uint32_t MXFileOutgoingMessagesJournalChecksum(const uint8_t *bytes, NSUInteger length)
+{
+    uint32_t hash = 2166136261u;
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+#pragma mark - MXFileOutgoingMessagesJournalRecord
+
+@interface MXFileOutgoingMessagesJournalRecord ()
+
+@property (nonatomic, readwrite) MXFileOutgoingMessagesJournalOperation operation;
+@property (nonatomic, readwrite) NSString *roomId;
+@property (nonatomic, readwrite, nullable) MXEvent *event;
+@property (nonatomic, readwrite, nullable) NSString *eventId;
+
+@end
+
+@implementation MXFileOutgoingMessagesJournalRecord
+
++ (instancetype)storeRecordWithEvent:(MXEvent*)event inRoom:(NSString*)roomId
+{
+    MXFileOutgoingMessagesJournalRecord *record = [MXFileOutgoingMessagesJournalRecord new];
+    record.operation = MXFileOutgoingMessagesJournalOperationStore;
+    record.roomId = roomId;
+    record.event = event;
+    return record;
+}
+
++ (instancetype)removeRecordWithEventId:(NSString*)eventId inRoom:(NSString*)roomId
+{
+    MXFileOutgoingMessagesJournalRecord *record = [MXFileOutgoingMessagesJournalRecord new];
+    record.operation = MXFileOutgoingMessagesJournalOperationRemove;
+    record.roomId = roomId;
+    record.eventId = eventId;
+    return record;
+}
+
++ (instancetype)removeAllRecordInRoom:(NSString*)roomId
+{
+    MXFileOutgoingMessagesJournalRecord *record = [MXFileOutgoingMessagesJournalRecord new];
+    record.operation = MXFileOutgoingMessagesJournalOperationRemoveAll;
+    record.roomId = roomId;
+    return record;
+}
+
+- (NSData*)archivedData
+{
+    NSError *error;
+    NSData *data = [NSKeyedArchiver archivedDataWithRootObject:self requiringSecureCoding:NO error:&error];
+    if (!data)
+    {
+        MXLogErrorDetails(@"[MXFileOutgoingMessagesJournal] archivedData: Failed to archive record", @{
+            @"error": error ?: @"unknown"
+        });
+    }
+    return data;
+}
+
+#pragma mark - NSCoding
+
+- (instancetype)initWithCoder:(NSCoder *)aDecoder
+{
+    self = [super init];
+    if (self)
+    {
+        _operation = [aDecoder decodeIntegerForKey:@"operation"];
+        _roomId = [aDecoder decodeObjectForKey:@"roomId"];
+        _event = [aDecoder decodeObjectForKey:@"event"];
+        _eventId = [aDecoder decodeObjectForKey:@"eventId"];
+    }
+    return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)aCoder
+{
+    [aCoder encodeInteger:_operation forKey:@"operation"];
+    [aCoder encodeObject:_roomId forKey:@"roomId"];
+    [aCoder encodeObject:_event forKey:@"event"];
+    [aCoder encodeObject:_eventId forKey:@"eventId"];
+}
+
+@end
+
+
+#pragma mark - MXFileOutgoingMessagesJournal
+
+@interface MXFileOutgoingMessagesJournal ()
+{
+    NSString *folder;
+    NSFileHandle *fileHandle;
+}
+
+@end
+
+@implementation MXFileOutgoingMessagesJournal
+
+- (instancetype)initWithFolder:(NSString*)theFolder
+{
+    self = [super init];
+    if (self)
+    {
+        folder = theFolder;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [fileHandle closeFile];
+}
+
+- (BOOL)appendRecordData:(NSData*)recordData
+{
+    if (!recordData.length || recordData.length > kMXFileOutgoingMessagesJournalMaxRecordLength)
+    {
+        return NO;
+    }
+
+    if (!fileHandle && ![self openFile])
+    {
+        return NO;
+    }
+
+    MXFileOutgoingMessagesJournalRecordHeader header = {
+        .length = (uint32_t)recordData.length,
+        .checksum = MXFileOutgoingMessagesJournalChecksum(recordData.bytes, recordData.length)
+    };
+
+    NSMutableData *data = [NSMutableData dataWithCapacity:sizeof(header) + recordData.length];
+    [data appendBytes:&header length:sizeof(header)];
+    [data appendData:recordData];
+
+    NSError *error;
+    if (![fileHandle writeData:data error:&error] || ![fileHandle synchronizeAndReturnError:&error])
+    {
+        MXLogErrorDetails(@"[MXFileOutgoingMessagesJournal] appendRecordData: Failed to write record", @{
+            @"error": error ?: @"unknown"
+        });
+
+        // The file will be checked again when reopened
+        [self closeFile];
+        return NO;
+    }
+
+    return YES;
+}
+
+- (NSArray<MXFileOutgoingMessagesJournalRecord*>*)records
+{
+    NSMutableArray<MXFileOutgoingMessagesJournalRecord*> *records = [NSMutableArray array];
+
+    for (NSString *file in @[self.rotatedFile, self.file])
+    {
+        NSData *data = [NSData dataWithContentsOfFile:file];
+        if (!data)
+        {
+            continue;
+        }
+
+        [self enumerateRecordsInData:data block:^(NSData *recordData) {
+            NSError *error;
+            NSKeyedUnarchiver *unarchiver = [[NSKeyedUnarchiver alloc] initForReadingFromData:recordData error:&error];
+            unarchiver.requiresSecureCoding = NO;
+
+            id record = [unarchiver decodeTopLevelObjectForKey:NSKeyedArchiveRootObjectKey error:&error];
+            if ([record isKindOfClass:MXFileOutgoingMessagesJournalRecord.class])
+            {
+                [records addObject:record];
+            }
+            else
+            {
+                MXLogErrorDetails(@"[MXFileOutgoingMessagesJournal] records: Failed to decode record", @{
+                    @"error": error ?: @"unknown"
+                });
+            }
+        }];
+    }
+
+    return records;
+}
+
+- (void)rotate
+{
+    [self closeFile];
+
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    if (![fileManager fileExistsAtPath:self.file])
+    {
+        return;
+    }
+
+    if ([fileManager fileExistsAtPath:self.rotatedFile])
+    {
+        // Records of a snapshot that has not been committed. Keep them, followed by the current ones
+        NSFileHandle *rotatedFileHandle = [NSFileHandle fileHandleForUpdatingAtPath:self.rotatedFile];
+        NSData *data = [NSData dataWithContentsOfFile:self.file];
+
+        [rotatedFileHandle truncateAtOffset:[self validLengthOfData:[NSData dataWithContentsOfFile:self.rotatedFile]] error:nil];
+        [rotatedFileHandle seekToEndReturningOffset:nil error:nil];
+        [rotatedFileHandle writeData:[data subdataWithRange:NSMakeRange(0, [self validLengthOfData:data])] error:nil];
+        [rotatedFileHandle synchronizeAndReturnError:nil];
+        [rotatedFileHandle closeFile];
+
+        [fileManager removeItemAtPath:self.file error:nil];
+    }
+    else
+    {
+        [fileManager moveItemAtPath:self.file toPath:self.rotatedFile error:nil];
+    }
+}
+
+- (void)removeRotatedRecords
+{
+    [[NSFileManager defaultManager] removeItemAtPath:self.rotatedFile error:nil];
+}
+
+- (void)reset
+{
+    [self closeFile];
+
+    [[NSFileManager defaultManager] removeItemAtPath:self.file error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:self.rotatedFile error:nil];
+}
+
+
+#pragma mark - Private
+
+- (NSString*)file
+{
+    return [folder stringByAppendingPathComponent:kMXFileOutgoingMessagesJournalFile];
+}
+
+- (NSString*)rotatedFile
+{
+    return [folder stringByAppendingPathComponent:kMXFileOutgoingMessagesJournalRotatedFile];
+}
+
+- (BOOL)openFile
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    if (![fileManager fileExistsAtPath:self.file])
+    {
+        [fileManager createDirectoryAtPath:folder withIntermediateDirectories:YES attributes:nil error:nil];
+        [fileManager createFileAtPath:self.file contents:nil attributes:nil];
+    }
+
+    fileHandle = [NSFileHandle fileHandleForUpdatingAtPath:self.file];
+    if (!fileHandle)
+    {
+        MXLogError(@"[MXFileOutgoingMessagesJournal] openFile: Cannot open the journal");
+        return NO;
+    }
+
+    // Drop a record torn by a crash so that next records are readable
+    NSUInteger validLength = [self validLengthOfData:[NSData dataWithContentsOfFile:self.file]];
+
+    NSError *error;
+    if (![fileHandle truncateAtOffset:validLength error:&error] || ![fileHandle seekToEndReturningOffset:nil error:&error])
+    {
+        MXLogErrorDetails(@"[MXFileOutgoingMessagesJournal] openFile: Cannot prepare the journal", @{
+            @"error": error ?: @"unknown"
+        });
+        [self closeFile];
+        return NO;
+    }
+
+    return YES;
+}
+
+- (void)closeFile
+{
+    [fileHandle closeFile];
+    fileHandle = nil;
+}
+
+- (NSUInteger)validLengthOfData:(NSData*)data
+{
+    __block NSUInteger validLength = 0;
+    [self enumerateRecordsInData:data block:^(NSData *recordData) {
+        validLength += sizeof(MXFileOutgoingMessagesJournalRecordHeader) + recordData.length;
+    }];
+    return validLength;
+}
+
+/**
+ Enumerate the records of a journal file until the first invalid one.
+ */
+- (void)enumerateRecordsInData:(NSData*)data block:(void (^)(NSData *recordData))block
+{
+    const uint8_t *bytes = data.bytes;
+    NSUInteger offset = 0;
+
+    while (offset + sizeof(MXFileOutgoingMessagesJournalRecordHeader) <= data.length)
+    {
+        MXFileOutgoingMessagesJournalRecordHeader header;
+        memcpy(&header, bytes + offset, sizeof(header));
+        offset += sizeof(header);
+
+        if (header.length == 0
+            || header.length > kMXFileOutgoingMessagesJournalMaxRecordLength
+            || offset + header.length > data.length
+            || MXFileOutgoingMessagesJournalChecksum(bytes + offset, header.length) != header.checksum)
+        {
+            break;
+        }
+
+        block([data subdataWithRange:NSMakeRange(offset, header.length)]);
+        offset += header.length;
+    }
+}
+
+@end
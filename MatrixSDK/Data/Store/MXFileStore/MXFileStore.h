@@ -67,10 +67,9 @@ typedef NS_OPTIONS(NSInteger, MXFileStorePreloadOptions)
                     L accountData
                     L receipts
                 + ...
-            + users: all MXUsers known by the user. There are distributed among smaller files to speed up their storage.
-                L usersGroup #1
-                L usersGroup #2
-                L ...
+            + users: all MXUsers known by the user (see `MXFileUserDirectory`). They are loaded on demand.
+                L data: archived MXUsers
+                L index: position of each MXUser in the data file
             + groups:
                 L groupA
                 L groupB
@@ -87,8 +86,8 @@ typedef NS_OPTIONS(NSInteger, MXFileStorePreloadOptions)
                         + {roomIdB}
                         + ...
                     + users
-                        L usersGroup #1
-                        L ...
+                        L data
+                        L index
                     + groups
                         L ...
                     L MXFileStore
@@ -28,6 +28,9 @@
 #import "MXTools.h"
 #import "MatrixSDKSwiftHeader.h"
 #import "MXFileRoomSummaryStore.h"
+#import "MXStorePreloadScheduler.h"
+#import "MXFileUserDirectory.h"
+#import "MXFileOutgoingMessagesJournal.h"
 
 static NSUInteger const kMXFileVersion = 83;    // Check getUnreadRoomFromStore if you update this value. Delete this comment after
 
@@ -40,6 +43,9 @@ static NSString *const kMXFileStoreBackupFolder = @"backup";
 
 static NSString *const kMXFileStoreSavingMarker = @"savingMarker";
 
+// Maximum number of decoded MXUsers kept in memory by the user directory
+static NSUInteger const kMXFileStoreUsersCacheCountLimit = 1000;
+
 static NSString *const kMXFileStoreRoomsFolder = @"rooms";
 static NSString *const kMXFileStoreRoomMessagesFile = @"messages";
 static NSString *const kMXFileStoreRoomOutgoingMessagesFile = @"outgoingMessages";
@@ -62,6 +68,9 @@ static NSUInteger preloadOptions;
     
     NSMutableArray *roomsToCommitForOutgoingMessages;
 
+    // Changes on outgoing messages since their last snapshot in room files
+    MXFileOutgoingMessagesJournal *outgoingMessagesJournal;
+
     NSMutableDictionary *roomsToCommitForState;
 
     NSMutableDictionary<NSString*, MXRoomAccountData*> *roomsToCommitForAccountData;
@@ -70,8 +79,6 @@ static NSUInteger preloadOptions;
 
     NSMutableArray *roomsToCommitForDeletion;
 
-    NSMutableDictionary *usersToCommit;
-    
     NSMutableDictionary *groupsToCommit;
     NSMutableArray *groupsToCommitForDeletion;
 
@@ -86,6 +93,9 @@ static NSUInteger preloadOptions;
 
     // The path of the rooms folder
     NSString *storeUsersPath;
+
+    // All users known by the user. They are loaded on demand
+    MXFileUserDirectory *userDirectory;
     
     // The path of the groups folder
     NSString *storeGroupsPath;
@@ -149,7 +159,6 @@ static NSUInteger preloadOptions;
         roomsToCommitForAccountData = [NSMutableDictionary dictionary];
         roomsToCommitForReceipts = [NSMutableArray array];
         roomsToCommitForDeletion = [NSMutableArray array];
-        usersToCommit = [NSMutableDictionary dictionary];
         groupsToCommit = [NSMutableDictionary dictionary];
         groupsToCommitForDeletion = [NSMutableArray array];
         preloadedRoomsStates = [NSMutableDictionary dictionary];
@@ -243,25 +252,8 @@ static NSUInteger preloadOptions;
                 
                 MXLogDebug(@"[MXFileStore] Start data loading from files");
 
-                if (preloadOptions & MXFileStorePreloadOptionRoomMessages)
-                {
-                    [self preloadRoomsMessages];
-                }
-                if (preloadOptions & MXFileStorePreloadOptionRoomState)
-                {
-                    [self preloadRoomsStates];
-                }
-                if (preloadOptions & MXFileStorePreloadOptionRoomAccountData)
-                {
-                    [self preloadRoomsAccountData];
-                }
-                if (preloadOptions & MXFileStorePreloadOptionReadReceipts)
-                {
-                    [self preloadRoomReceipts];
-                }
-                [self loadUsers];
-                [self loadGroups];
-                [self loadUnreadRooms];
+                [self preloadData];
+                [self replayOutgoingMessagesJournal];
                 taskProfile.units = self.roomSummaryStore.countOfRooms;
                 [MXSDKOptions.sharedInstance.profiler stopMeasuringTaskWithProfile:taskProfile];
                 MXLogDebug(@"[MXFileStore] Data loaded from files in %.0fms", taskProfile.duration * 1000);
@@ -403,6 +395,8 @@ static NSUInteger preloadOptions;
     }
 
     [super deleteAllData];
+    [userDirectory removeAllUsers];
+    [outgoingMessagesJournal reset];
 
     // Remove the MXFileStore and all its content
     NSError *error;
@@ -595,7 +589,7 @@ static NSUInteger preloadOptions;
 
     if (!roomUserdData)
     {
-        roomUserdData =[NSKeyedUnarchiver unarchiveObjectWithFile:[self accountDataFileForRoom:roomId forBackup:NO]];
+        roomUserdData = [self loadAccountDataFromFileForRoom:roomId];
 
         if (NO == [NSThread isMainThread])
         {
@@ -615,9 +609,44 @@ static NSUInteger preloadOptions;
 
 - (void)storeUser:(MXUser *)user
 {
-    [super storeUser:user];
+    if (!userDirectory)
+    {
+        [super storeUser:user];
+        return;
+    }
+
+    [userDirectory storeUser:user];
+}
+
+- (NSArray<MXUser *> *)users
+{
+    if (!userDirectory)
+    {
+        return [super users];
+    }
+
+    // Do not decode every stored user. Use asyncUsers for that
+    return userDirectory.residentUsers;
+}
+
+- (MXUser *)userWithUserId:(NSString *)userId
+{
+    if (!userDirectory)
+    {
+        return [super userWithUserId:userId];
+    }
 
-    usersToCommit[user.userId] = user;
+    return [userDirectory userWithUserId:userId];
+}
+
+- (NSArray<MXUser *> *)residentUsers
+{
+    if (!userDirectory)
+    {
+        return [super users];
+    }
+
+    return userDirectory.residentUsers;
 }
 
 - (void)storeGroup:(MXGroup *)group
@@ -804,6 +833,9 @@ static NSUInteger preloadOptions;
 
             [[NSFileManager defaultManager] removeItemAtPath:self->storeBackupPath error:nil];
 
+            // Journal records are now covered by the committed outgoing messages snapshots
+            [self->outgoingMessagesJournal removeRotatedRecords];
+
             // Release the background task if there is no more pending commits
             dispatch_async(dispatch_get_main_queue(), ^(void){
 
@@ -967,32 +999,7 @@ static NSUInteger preloadOptions;
         //  This object is global, which means that we will be able to open only one room at a time.
         //  A per-room lock might be better.
         @synchronized (roomThreadedReceiptsStores) {
-            NSString *roomFile = [self readReceiptsFileForRoom:roomId forBackup:NO];
-            RoomReceiptsStore *receiptsStore = [self loadReceiptsStoreFromFileAt:roomFile forRoomWithId:roomId];
-            
-            if (receiptsStore)
-            {
-                // if an old version of the receipts store exists we need first to port it to new version.
-                threadedStore = [RoomThreadedReceiptsStore new];
-                threadedStore[kMXEventTimelineMain] = receiptsStore;
-                
-                // then save the new version of the receipts
-                NSString *newFile = [self threadedReadReceiptsFileForRoom:roomId forBackup:NO];
-                if ([NSKeyedArchiver archiveRootObject:threadedStore toFile:newFile])
-                {
-                    // this file is not needed anymore
-                    [[NSFileManager defaultManager] removeItemAtPath:roomFile error:nil];
-                }
-            }
-            else
-            {
-                roomFile = [self threadedReadReceiptsFileForRoom:roomId forBackup:NO];
-                threadedStore = [self loadReceiptsStoreFromFileAt:roomFile forRoomWithId:roomId];
-                if (!threadedStore)
-                {
-                    threadedStore = [RoomThreadedReceiptsStore new];
-                }
-            }
+            threadedStore = [self loadRoomThreadedReceiptsStore:roomId];
             roomThreadedReceiptsStores[roomId] = threadedStore;
         }
     }
@@ -1000,6 +1007,45 @@ static NSUInteger preloadOptions;
     return threadedStore;
 }
 
+/**
+ Load the read receipts of a room from its file, migrating the file of an old version if any.
+
+ This method does not access the in-memory store. It can be called from any thread.
+ */
+- (RoomThreadedReceiptsStore*)loadRoomThreadedReceiptsStore:(NSString*)roomId
+{
+    RoomThreadedReceiptsStore *threadedStore;
+
+    NSString *roomFile = [self readReceiptsFileForRoom:roomId forBackup:NO];
+    RoomReceiptsStore *receiptsStore = [self loadReceiptsStoreFromFileAt:roomFile forRoomWithId:roomId];
+    
+    if (receiptsStore)
+    {
+        // if an old version of the receipts store exists we need first to port it to new version.
+        threadedStore = [RoomThreadedReceiptsStore new];
+        threadedStore[kMXEventTimelineMain] = receiptsStore;
+        
+        // then save the new version of the receipts
+        NSString *newFile = [self threadedReadReceiptsFileForRoom:roomId forBackup:NO];
+        if ([NSKeyedArchiver archiveRootObject:threadedStore toFile:newFile])
+        {
+            // this file is not needed anymore
+            [[NSFileManager defaultManager] removeItemAtPath:roomFile error:nil];
+        }
+    }
+    else
+    {
+        roomFile = [self threadedReadReceiptsFileForRoom:roomId forBackup:NO];
+        threadedStore = [self loadReceiptsStoreFromFileAt:roomFile forRoomWithId:roomId];
+        if (!threadedStore)
+        {
+            threadedStore = [RoomThreadedReceiptsStore new];
+        }
+    }
+
+    return threadedStore;
+}
+
 -(void)saveUnreadRooms
 {
     
@@ -1008,11 +1054,6 @@ static NSUInteger preloadOptions;
     [self saveObject:rooms toFile:roomsFile];
 }
 
--(void)loadUnreadRooms
-{
-    roomUnreaded = [NSMutableSet setWithArray:[self getUnreadRoomFromStore]];
-}
-
 - (NSArray*)getUnreadRoomFromStore
 {
     NSString *unreadRoomsFile = [self unreadRoomsFile];
@@ -1123,7 +1164,9 @@ static NSUInteger preloadOptions;
     storePath = [[cachePath stringByAppendingPathComponent:kMXFileStoreFolder] stringByAppendingPathComponent:credentials.userId];
     storeRoomsPath = [storePath stringByAppendingPathComponent:kMXFileStoreRoomsFolder];
     storeUsersPath = [storePath stringByAppendingPathComponent:kMXFileStoreUsersFolder];
+    userDirectory = [[MXFileUserDirectory alloc] initWithFolder:storeUsersPath cacheCountLimit:kMXFileStoreUsersCacheCountLimit];
     storeGroupsPath = [storePath stringByAppendingPathComponent:kMXFileStoreGroupsFolder];
+    outgoingMessagesJournal = [[MXFileOutgoingMessagesJournal alloc] initWithFolder:storePath];
     
     storeBackupPath = [storePath stringByAppendingPathComponent:kMXFileStoreBackupFolder];
 }
@@ -1234,21 +1277,23 @@ static NSUInteger preloadOptions;
     }
 }
 
-- (NSString*)usersFileForUser:(NSString*)userId forBackup:(BOOL)backup
+- (NSString*)groupFileForGroup:(NSString*)groupId forBackup:(BOOL)backup
 {
-    // Users, according theirs ids, are distrubed into several (100) files in order to
-    // make the save operation quicker
-    NSString *userGroup = [NSString stringWithFormat:@"%tu", userId.hash % 100];
-
     if (!backup)
     {
-        return [[storePath stringByAppendingPathComponent:kMXFileStoreUsersFolder] stringByAppendingPathComponent:userGroup];
+        return [storeGroupsPath stringByAppendingPathComponent:groupId];
     }
     else
     {
         if (backupEventStreamToken)
         {
-            return [[[storeBackupPath stringByAppendingPathComponent:backupEventStreamToken] stringByAppendingPathComponent:kMXFileStoreUsersFolder] stringByAppendingPathComponent:userGroup];
+            NSString *groupBackupFolder = [[storeBackupPath stringByAppendingPathComponent:backupEventStreamToken] stringByAppendingPathComponent:kMXFileStoreGroupsFolder];
+            if (![NSFileManager.defaultManager fileExistsAtPath:groupBackupFolder])
+            {
+                [[NSFileManager defaultManager] createDirectoryExcludedFromBackupAtPath:groupBackupFolder error:nil];
+            }
+            
+            return [groupBackupFolder stringByAppendingPathComponent:groupId];
         }
         else
         {
@@ -1257,23 +1302,23 @@ static NSUInteger preloadOptions;
     }
 }
 
-- (NSString*)groupFileForGroup:(NSString*)groupId forBackup:(BOOL)backup
+- (NSString*)usersFolderForBackup:(BOOL)backup
 {
     if (!backup)
     {
-        return [storeGroupsPath stringByAppendingPathComponent:groupId];
+        return storeUsersPath;
     }
     else
     {
         if (backupEventStreamToken)
         {
-            NSString *groupBackupFolder = [[storeBackupPath stringByAppendingPathComponent:backupEventStreamToken] stringByAppendingPathComponent:kMXFileStoreGroupsFolder];
-            if (![NSFileManager.defaultManager fileExistsAtPath:groupBackupFolder])
+            NSString *usersBackupFolder = [[storeBackupPath stringByAppendingPathComponent:backupEventStreamToken] stringByAppendingPathComponent:kMXFileStoreUsersFolder];
+            if (![NSFileManager.defaultManager fileExistsAtPath:usersBackupFolder])
             {
-                [[NSFileManager defaultManager] createDirectoryExcludedFromBackupAtPath:groupBackupFolder error:nil];
+                [[NSFileManager defaultManager] createDirectoryExcludedFromBackupAtPath:usersBackupFolder error:nil];
             }
-            
-            return [groupBackupFolder stringByAppendingPathComponent:groupId];
+
+            return usersBackupFolder;
         }
         else
         {
@@ -1353,6 +1398,9 @@ static NSUInteger preloadOptions;
                 // Load the event stream token.
                 [self loadMetaData];
 
+                // The users index may have been read before the restoration
+                [userDirectory reload];
+
                 // Sanity check
                 checkStorageValidity = [self.eventStreamToken isEqualToString:prevSyncToken];
 
@@ -1383,45 +1431,129 @@ static NSUInteger preloadOptions;
 }
 
 
-#pragma mark - Rooms messages
-// Load the data store in files
-- (void)preloadRoomsMessages
+#pragma mark - Preload
+/**
+ Preload data from files, according to `preloadOptions`.
+
+ Files are decoded concurrently. Decoded objects are merged into the store while this method
+ waits for them, so that no other operation can access the store in the meantime.
+
+ This operation must be called on the `dispatchQueue` thread to avoid blocking the main thread.
+ */
+- (void)preloadData
 {
-    NSArray<NSString *> *roomIDs = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storeRoomsPath error:nil];
+    NSArray<NSString *> *roomIDs = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storeRoomsPath error:nil] ?: @[];
+    MXStorePreloadScheduler *scheduler = [MXStorePreloadScheduler new];
 
-    NSDate *startDate = [NSDate date];
+    MXLogDebug(@"[MXFileStore] preloadData: %tu rooms with %tu workers", roomIDs.count, scheduler.maxConcurrentTasks);
 
-    for (NSString *roomId in roomIDs)  {
+    __block NSString *corruptedRoomId;
+    if (preloadOptions & MXFileStorePreloadOptionRoomMessages)
+    {
+        [scheduler addPhaseWithName:MXTaskProfileNameStartupStorePreloadRoomMessages items:roomIDs decodeBlock:^id(NSString *roomId) {
+            return [self loadRoomStoreFromFileForRoom:roomId];
+        } mergeBlock:^(NSString *roomId, MXFileRoomStore *roomStore) {
+            if (roomStore)
+            {
+                self->roomStores[roomId] = roomStore;
+            }
+            else if (!corruptedRoomId)
+            {
+                corruptedRoomId = roomId;
+            }
+        }];
+    }
+    if (preloadOptions & MXFileStorePreloadOptionRoomState)
+    {
+        [scheduler addPhaseWithName:MXTaskProfileNameStartupStorePreloadRoomStates items:roomIDs decodeBlock:^id(NSString *roomId) {
+            return [self loadRootObjectWithoutSecureCodingFromFile:[self stateFileForRoom:roomId forBackup:NO]];
+        } mergeBlock:^(NSString *roomId, NSArray *stateEvents) {
+            if (!stateEvents.count)
+            {
+                MXLogWarning(@"[MXFileStore] preloadData: no state was loaded for room %@", roomId);
+            }
+            self->preloadedRoomsStates[roomId] = stateEvents;
+        }];
+    }
+    if (preloadOptions & MXFileStorePreloadOptionRoomAccountData)
+    {
+        [scheduler addPhaseWithName:MXTaskProfileNameStartupStorePreloadRoomAccountData items:roomIDs decodeBlock:^id(NSString *roomId) {
+            return [self loadAccountDataFromFileForRoom:roomId];
+        } mergeBlock:^(NSString *roomId, MXRoomAccountData *accountData) {
+            self->preloadedRoomAccountData[roomId] = accountData;
+        }];
+    }
+    if (preloadOptions & MXFileStorePreloadOptionReadReceipts)
+    {
+        [scheduler addPhaseWithName:MXTaskProfileNameStartupStorePreloadReadReceipts items:roomIDs decodeBlock:^id(NSString *roomId) {
+            return [self loadRoomThreadedReceiptsStore:roomId];
+        } mergeBlock:^(NSString *roomId, RoomThreadedReceiptsStore *threadedStore) {
+            self->roomThreadedReceiptsStores[roomId] = threadedStore;
+        }];
+    }
 
-        NSString *roomFile = [self messagesFileForRoom:roomId forBackup:NO];
+    // Only the users index is loaded
+    [scheduler addPhaseWithName:MXTaskProfileNameStartupStorePreloadUsers items:@[userDirectory] decodeBlock:^id(MXFileUserDirectory *directory) {
+        [self loadUsers];
+        return nil;
+    } mergeBlock:^(MXFileUserDirectory *directory, id result) {
+    }];
 
-        MXFileRoomStore *roomStore;
-        @try
+    NSArray<NSString *> *groupIds = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storeGroupsPath error:nil] ?: @[];
+    [scheduler addPhaseWithName:MXTaskProfileNameStartupStorePreloadGroups items:groupIds decodeBlock:^id(NSString *groupId) {
+        return [self loadGroupFromFile:groupId];
+    } mergeBlock:^(NSString *groupId, MXGroup *group) {
+        if (group)
         {
-            roomStore = [NSKeyedUnarchiver unarchiveObjectWithFile:roomFile];
-        }
-        @catch (NSException *exception)
-        {
-            MXLogDebug(@"[MXFileStore] Warning: MXFileRoomStore file for room %@ has been corrupted. Exception: %@", roomId, exception);
+            self->groups[groupId] = group;
         }
+    }];
 
-        if (roomStore)
-        {
-            //MXLogDebug(@"   - %@: %@", roomId, roomStore);
-            roomStores[roomId] = roomStore;
-        }
-        else
-        {
-            MXLogDebug(@"[MXFileStore] Warning: MXFileStore has been reset due to room file corruption. Room id: %@. File path: %@",
-                  roomId, roomFile);
-            
-            [self logFiles];
-            [self deleteAllData];
-            break;
-        }
+    [scheduler addPhaseWithName:MXTaskProfileNameStartupStorePreloadUnreadRooms items:@[[self unreadRoomsFile]] decodeBlock:^id(NSString *file) {
+        return [self getUnreadRoomFromStore];
+    } mergeBlock:^(NSString *file, NSArray *unreadRooms) {
+        self->roomUnreaded = [NSMutableSet setWithArray:unreadRooms];
+    }];
+
+    [scheduler run];
+
+    if (corruptedRoomId)
+    {
+        MXLogDebug(@"[MXFileStore] Warning: MXFileStore has been reset due to room file corruption. Room id: %@. File path: %@",
+              corruptedRoomId, [self messagesFileForRoom:corruptedRoomId forBackup:NO]);
+
+        [self logFiles];
+        [self deleteAllData];
+
+        // Other preloaded data came from the deleted files
+        [preloadedRoomsStates removeAllObjects];
+        [preloadedRoomAccountData removeAllObjects];
+        [roomThreadedReceiptsStores removeAllObjects];
+        [groups removeAllObjects];
+        [roomUnreaded removeAllObjects];
     }
+}
 
-    MXLogDebug(@"[MXFileStore] Loaded room messages of %tu rooms in %.0fms", roomStores.allKeys.count, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+#pragma mark - Rooms messages
+/**
+ Load the messages store of a room from its file.
+
+ This method does not access the in-memory store. It can be called from any thread.
+
+ @return the room store. nil if the file is missing or corrupted.
+ */
+- (MXFileRoomStore*)loadRoomStoreFromFileForRoom:(NSString*)roomId
+{
+    MXFileRoomStore *roomStore;
+    @try
+    {
+        roomStore = [NSKeyedUnarchiver unarchiveObjectWithFile:[self messagesFileForRoom:roomId forBackup:NO]];
+    }
+    @catch (NSException *exception)
+    {
+        MXLogDebug(@"[MXFileStore] Warning: MXFileRoomStore file for room %@ has been corrupted. Exception: %@", roomId, exception);
+    }
+    return roomStore;
 }
 
 - (void)saveRoomsMessages
@@ -1473,25 +1605,6 @@ static NSUInteger preloadOptions;
 
 
 #pragma mark - Rooms state
-/**
- Preload states of all rooms.
-
- This operation must be called on the `dispatchQueue` thread to avoid blocking the main thread.
- */
-- (void)preloadRoomsStates
-{
-    NSArray<NSString *> *roomIDs = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storeRoomsPath error:nil];
-    
-    NSDate *startDate = [NSDate date];
-
-    for (NSString *roomId in roomIDs)
-    {
-        preloadedRoomsStates[roomId] = [self stateOfRoom:roomId];
-    }
-
-    MXLogDebug(@"[MXFileStore] Loaded room states of %tu rooms in %.0fms", roomIDs.count, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
-}
-
 - (void)saveRoomsState
 {
     if (roomsToCommitForState.count)
@@ -1535,22 +1648,13 @@ static NSUInteger preloadOptions;
 
 #pragma mark - Rooms account data
 /**
- Preload account data of all rooms.
+ Load the account data of a room from its file.
 
- This operation must be called on the `dispatchQueue` thread to avoid blocking the main thread.
+ This method does not access the in-memory store. It can be called from any thread.
  */
-- (void)preloadRoomsAccountData
+- (MXRoomAccountData*)loadAccountDataFromFileForRoom:(NSString*)roomId
 {
-    NSArray<NSString *> *roomIDs = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storeRoomsPath error:nil];
-    
-    NSDate *startDate = [NSDate date];
-
-    for (NSString *roomId in roomIDs)
-    {
-        preloadedRoomAccountData[roomId] = [self accountDataOfRoom:roomId];
-    }
-
-    MXLogDebug(@"[MXFileStore] Loaded rooms account data of %tu rooms in %.0fms", roomIDs.count, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+    return [NSKeyedUnarchiver unarchiveObjectWithFile:[self accountDataFileForRoom:roomId forBackup:NO]];
 }
 
 - (void)saveRoomsAccountData
@@ -1639,6 +1743,7 @@ static NSUInteger preloadOptions;
 - (void)storeOutgoingMessageForRoom:(NSString*)roomId outgoingMessage:(MXEvent*)outgoingMessage
 {
     [super storeOutgoingMessageForRoom:roomId outgoingMessage:outgoingMessage];
+    [self appendOutgoingMessagesJournalRecord:[MXFileOutgoingMessagesJournalRecord storeRecordWithEvent:outgoingMessage inRoom:roomId]];
 
     if (NSNotFound == [roomsToCommitForOutgoingMessages indexOfObject:roomId])
     {
@@ -1649,6 +1754,7 @@ static NSUInteger preloadOptions;
 - (void)removeAllOutgoingMessagesFromRoom:(NSString*)roomId
 {
     [super removeAllOutgoingMessagesFromRoom:roomId];
+    [self appendOutgoingMessagesJournalRecord:[MXFileOutgoingMessagesJournalRecord removeAllRecordInRoom:roomId]];
 
     if (NSNotFound == [roomsToCommitForOutgoingMessages indexOfObject:roomId])
     {
@@ -1659,6 +1765,7 @@ static NSUInteger preloadOptions;
 - (void)removeOutgoingMessageFromRoom:(NSString*)roomId outgoingMessage:(NSString*)outgoingMessageEventId
 {
     [super removeOutgoingMessageFromRoom:roomId outgoingMessage:outgoingMessageEventId];
+    [self appendOutgoingMessagesJournalRecord:[MXFileOutgoingMessagesJournalRecord removeRecordWithEventId:outgoingMessageEventId inRoom:roomId]];
 
     if (NSNotFound == [roomsToCommitForOutgoingMessages indexOfObject:roomId])
     {
@@ -1666,6 +1773,88 @@ static NSUInteger preloadOptions;
     }
 }
 
+- (BOOL)persistsOutgoingMessagesImmediately
+{
+    return YES;
+}
+
+- (void)appendOutgoingMessagesJournalRecord:(MXFileOutgoingMessagesJournalRecord*)record
+{
+    // Archive the record now. The event may be modified before the file queue processes it
+    NSData *recordData = record.archivedData;
+    if (!recordData)
+    {
+        return;
+    }
+
+    MXWeakify(self);
+    dispatch_async(dispatchQueue, ^(void){
+        MXStrongifyAndReturnIfNil(self);
+
+        // Like commits, nothing is stored without metadata
+        if (self->metaData)
+        {
+            [self->outgoingMessagesJournal appendRecordData:recordData];
+        }
+    });
+}
+
+- (void)replayOutgoingMessagesJournal
+{
+    NSArray<MXFileOutgoingMessagesJournalRecord*> *records = outgoingMessagesJournal.records;
+    if (!records.count)
+    {
+        return;
+    }
+
+    MXLogDebug(@"[MXFileStore] replayOutgoingMessagesJournal: Replay %tu records", records.count);
+
+    // Records are applied on top of the snapshots loaded from room files.
+    // Changes already in a snapshot are applied again, with the same result
+    NSMutableSet<NSString*> *roomIds = [NSMutableSet set];
+    for (MXFileOutgoingMessagesJournalRecord *record in records)
+    {
+        if (!record.roomId)
+        {
+            continue;
+        }
+
+        switch (record.operation)
+        {
+            case MXFileOutgoingMessagesJournalOperationStore:
+                if (record.event)
+                {
+                    if (record.event.eventId)
+                    {
+                        [super removeOutgoingMessageFromRoom:record.roomId outgoingMessage:record.event.eventId];
+                    }
+                    [super storeOutgoingMessageForRoom:record.roomId outgoingMessage:record.event];
+                }
+                break;
+            case MXFileOutgoingMessagesJournalOperationRemove:
+                if (record.eventId)
+                {
+                    [super removeOutgoingMessageFromRoom:record.roomId outgoingMessage:record.eventId];
+                }
+                break;
+            case MXFileOutgoingMessagesJournalOperationRemoveAll:
+                [super removeAllOutgoingMessagesFromRoom:record.roomId];
+                break;
+        }
+
+        [roomIds addObject:record.roomId];
+    }
+
+    // Snapshot them at the next commit
+    for (NSString *roomId in roomIds)
+    {
+        if (NSNotFound == [roomsToCommitForOutgoingMessages indexOfObject:roomId])
+        {
+            [roomsToCommitForOutgoingMessages addObject:roomId];
+        }
+    }
+}
+
 - (void)saveRoomsOutgoingMessages
 {
     if (roomsToCommitForOutgoingMessages.count)
@@ -1706,6 +1895,10 @@ static NSUInteger preloadOptions;
                 }
             }
 
+            // Journal records appended so far are part of the snapshots.
+            // Keep them until the end of the commit in case the backup needs to be restored
+            [self->outgoingMessagesJournal rotate];
+
 #if DEBUG
             MXLogDebug(@"[MXFileStore commit] lasted %.0fms for %tu rooms outgoing messages", [[NSDate date] timeIntervalSinceDate:startDate] * 1000, roomsToCommit.count);
 #endif
@@ -1854,96 +2047,58 @@ static NSUInteger preloadOptions;
 
 #pragma mark - Matrix users
 /**
- Preload all users.
+ Load the users index and move users stored by previous versions into the user directory.
 
  This operation must be called on the `dispatchQueue` thread to avoid blocking the main thread.
  */
 - (void)loadUsers
 {
-    NSDate *startDate = [NSDate date];
-
-    // Load all users which are distributed in several files
-    NSArray *groups = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storeUsersPath error:nil];
+    [userDirectory load];
 
-    for (NSString *group in groups)
+    // Users used to be distributed among 100 group files
+    NSArray<NSString *> *legacyGroups = [[[NSFileManager defaultManager] contentsOfDirectoryAtPath:storeUsersPath error:nil] filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF MATCHES '[0-9]+'"]];
+    if (!legacyGroups.count)
     {
-        NSString *groupFile = [[storePath stringByAppendingPathComponent:kMXFileStoreUsersFolder] stringByAppendingPathComponent:group];
-
-        // Load stored users in this group
-        @try
-        {
-            NSMutableDictionary <NSString*, MXUser*> *groupUsers = [NSKeyedUnarchiver unarchiveObjectWithFile:groupFile];
-            if (groupUsers)
-            {
-                // Append them
-                [users addEntriesFromDictionary:groupUsers];
-            }
-        }
-        @catch (NSException *exception)
-        {
-            MXLogDebug(@"[MXFileStore] Warning: MXFileRoomStore file for users group %@ has been corrupted", group);
-        }
+        return;
     }
-    
-    MXLogDebug(@"[MXFileStore] Loaded %tu MXUsers in %.0fms", users.count, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
-}
 
-- (NSArray<MXUser *> *)loadUsersWithUserIds:(NSArray<NSString *> *)userIds
-{
-    // Determine which groups to load based on userIds
-    NSMutableDictionary<NSString *, NSMutableArray<NSString *> *> *groups = [NSMutableDictionary dictionary];
-    for (NSString *userId in userIds)
-    {
-        NSString *groupId = [NSString stringWithFormat:@"%tu", userId.hash % 100];
-        
-        NSMutableArray *groupUserdIds = groups[groupId];
-        if (groupUserdIds)
-            [groupUserdIds addObject:userId];
-        else
-            groups[groupId] = [NSMutableArray arrayWithObject:userId];
-    }
-    
-    NSString *usersFolder = [storePath stringByAppendingPathComponent:kMXFileStoreUsersFolder];
-    
-    NSMutableArray<MXUser *> *loadedUsers = [NSMutableArray array];
-    for (NSString *group in groups.allKeys)
+    NSDate *startDate = [NSDate date];
+    NSUInteger migratedCount = 0;
+
+    for (NSString *group in legacyGroups)
     {
         @autoreleasepool
         {
-            NSString *groupFile = [usersFolder stringByAppendingPathComponent:group];
-            
-            // Load stored users in this group
+            NSString *groupFile = [storeUsersPath stringByAppendingPathComponent:group];
+
+            NSDictionary<NSString*, MXUser*> *groupUsers;
             @try
             {
-                NSMutableDictionary <NSString *, MXUser *> *groupUsers = [NSKeyedUnarchiver unarchiveObjectWithFile:groupFile];
-                if (groupUsers)
-                {
-                    NSSet *usersToLoad = [NSSet setWithArray:groups[group]];
-                    for (MXUser *user in groupUsers.allValues)
-                    {
-                        if ([usersToLoad containsObject:user.userId])
-                            [loadedUsers addObject:user];
-                    }
-                }
+                groupUsers = [NSKeyedUnarchiver unarchiveObjectWithFile:groupFile];
             }
             @catch (NSException *exception)
             {
                 MXLogDebug(@"[MXFileStore] Warning: MXFileRoomStore file for users group %@ has been corrupted", group);
             }
+
+            if (groupUsers.count)
+            {
+                [userDirectory writeUsers:groupUsers];
+                migratedCount += groupUsers.count;
+            }
+            [[NSFileManager defaultManager] removeItemAtPath:groupFile error:nil];
         }
     }
-    
-    return [loadedUsers copy];
+
+    MXLogDebug(@"[MXFileStore] Migrated %tu MXUsers to the user directory in %.0fms", migratedCount, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
 }
 
 - (void)saveUsers
 {
     // Save only in case of change
-    if (usersToCommit.count)
+    NSDictionary<NSString*, MXUser*> *theUsersToCommit = [userDirectory snapshotDirtyUsers];
+    if (theUsersToCommit.count)
     {
-        // Take a snapshot of users to store them on the other thread
-        NSMutableDictionary *theUsersToCommit = [[NSMutableDictionary alloc] initWithDictionary:usersToCommit copyItems:YES];
-        [usersToCommit removeAllObjects];
 #if DEBUG
         MXLogDebug(@"[MXFileStore commit] queuing saveUsers");
 #endif
@@ -1952,64 +2107,18 @@ static NSUInteger preloadOptions;
 #if DEBUG
             NSDate *startDate = [NSDate date];
 #endif
-            // Sort/Group users by the files they are be stored to
-            NSMutableDictionary <NSString*, NSMutableArray<MXUser*>*> *usersByFiles = [NSMutableDictionary dictionary];
-            NSMutableDictionary <NSString*, NSString*> *usersByFilesBackupFiles = [NSMutableDictionary dictionary];
-
-            for (NSString *userId in theUsersToCommit)
+            // Backup the users files
+            NSString *backupFolder = [self usersFolderForBackup:YES];
+            if (backupFolder)
             {
-                MXUser *user = theUsersToCommit[userId];
-
-                NSString *file = [self usersFileForUser:userId forBackup:NO];
-
-                NSMutableArray<MXUser*> *group = usersByFiles[file];
-                if (group)
-                {
-                    [group addObject:user];
-                }
-                else
-                {
-                    group = [NSMutableArray arrayWithObject:user];
-                    usersByFiles[file] = group;
-
-                    // Cache the backup file for this group
-                    NSString *usersFileForUser = [self usersFileForUser:userId forBackup:YES];
-                    if (usersFileForUser)
-                    {
-                        usersByFilesBackupFiles[file] = usersFileForUser;
-                    }
-                }
+                [self->userDirectory backupFilesToFolder:backupFolder];
             }
 
-            // Process users group one by one
-            for (NSString *file in usersByFiles)
-            {
-                // Backup the file for this group of users
-                NSString *backupFile = usersByFilesBackupFiles[file];
-                if (backupFile && [[NSFileManager defaultManager] fileExistsAtPath:file])
-                {
-                    [[NSFileManager defaultManager] moveItemAtPath:file toPath:backupFile error:nil];
-                }
-
-                // Load stored users in this group
-                NSMutableDictionary <NSString*, MXUser*> *group = [NSKeyedUnarchiver unarchiveObjectWithFile:file];
-                if (!group)
-                {
-                    group = [NSMutableDictionary dictionary];
-                }
-
-                // Apply the changes
-                for (MXUser *user in usersByFiles[file])
-                {
-                    group[user.userId] = user;
-                }
-
-                // And store the users group
-                [NSKeyedArchiver archiveRootObject:group toFile:file];
-            }
+            // Only records of changed users are appended
+            [self->userDirectory writeUsers:theUsersToCommit];
 
 #if DEBUG
-            MXLogDebug(@"[MXFileStore] saveUsers in %.0fms", [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+            MXLogDebug(@"[MXFileStore] saveUsers %tu users in %.0fms", theUsersToCommit.count, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
 #endif
         });
     }
@@ -2030,26 +2139,36 @@ static NSUInteger preloadOptions;
     
     for (NSString *groupId in groupIds)
     {
-        NSString *groupFile = [storeGroupsPath stringByAppendingPathComponent:groupId];
-        
         // Load stored group
-        @try
+        MXGroup *group = [self loadGroupFromFile:groupId];
+        if (group)
         {
-            MXGroup *group = [NSKeyedUnarchiver unarchiveObjectWithFile:groupFile];
-            if (group)
-            {
-                [groups setObject:group forKey:groupId];
-            }
-        }
-        @catch (NSException *exception)
-        {
-            MXLogDebug(@"[MXFileStore] Warning: File for group %@ has been corrupted", groupId);
+            [groups setObject:group forKey:groupId];
         }
     }
     
     MXLogDebug(@"[MXFileStore] Loaded %tu MXGroups in %.0fms", groups.count, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
 }
 
+/**
+ Load a group from its file.
+
+ This method does not access the in-memory store. It can be called from any thread.
+ */
+- (MXGroup*)loadGroupFromFile:(NSString*)groupId
+{
+    MXGroup *group;
+    @try
+    {
+        group = [NSKeyedUnarchiver unarchiveObjectWithFile:[storeGroupsPath stringByAppendingPathComponent:groupId]];
+    }
+    @catch (NSException *exception)
+    {
+        MXLogDebug(@"[MXFileStore] Warning: File for group %@ has been corrupted", groupId);
+    }
+    return group;
+}
+
 - (void)saveGroupsDeletion
 {
     if (groupsToCommitForDeletion.count)
@@ -2157,21 +2276,6 @@ static NSUInteger preloadOptions;
 }
 
 
-// Load the data store in files
-- (void)preloadRoomReceipts
-{
-    NSArray<NSString *> *roomIDs = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:storeRoomsPath error:nil];
-    
-    NSDate *startDate = [NSDate date];
-    
-    for (NSString *roomId in roomIDs)
-    {
-        roomThreadedReceiptsStores[roomId] = [self getOrCreateRoomThreadedReceiptsStore:roomId];
-    }
-
-    MXLogDebug(@"[MXFileStore] Loaded read receipts of %tu rooms in %.0fms", roomThreadedReceiptsStores.count, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
-}
-
 - (void)saveReceipts
 {
     if (roomsToCommitForReceipts.count)
@@ -2245,10 +2349,10 @@ static NSUInteger preloadOptions;
     dispatch_async(dispatchQueue, ^{
         MXStrongifyAndReturnIfNil(self);
 
-        [self loadUsers];
+        NSArray<MXUser *> *allUsers = self->userDirectory.allUsers;
 
         dispatch_async(dispatch_get_main_queue(), ^{
-            success(self->users.allValues);
+            success(allUsers);
         });
     });
 }
@@ -2257,7 +2361,7 @@ static NSUInteger preloadOptions;
 {
     dispatch_async(dispatchQueue, ^{
 
-        NSArray<MXUser *> *usersWithUserIds = [self loadUsersWithUserIds:userIds];
+        NSArray<MXUser *> *usersWithUserIds = [self->userDirectory usersWithUserIds:userIds];
 
         dispatch_async(dispatch_get_main_queue(), ^{
             success(usersWithUserIds);
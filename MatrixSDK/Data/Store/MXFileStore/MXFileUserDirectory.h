@@ -0,0 +1,141 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MXUser.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ `MXFileUserDirectory` is a disk-backed store of `MXUser` objects.
+
+ The files structure is the following:
+ + {folder}
+    L data: an append-only log of records. A record is a user id and the archived `MXUser`
+    L index: an append-only log of (user id, record position) entries
+
+ Only the index is loaded in memory. `MXUser` objects are decoded on demand and kept in a
+ bounded cache. A user stays the same instance as long as it is retained somewhere else.
+
+ Updated users are kept in memory until they are written by `writeUsers:`, which appends
+ only their records. Space of outdated records is reclaimed by compaction.
+
+ If the index is not consistent with the data file, for example after a crash during a
+ compaction, it is rebuilt from the data file.
+
+ This class is thread safe.
+ */
+@interface MXFileUserDirectory : NSObject
+
+/**
+ Create a user directory. Files are read on first access or on `load`.
+
+ @param folder the folder containing the directory files.
+ @param cacheCountLimit the maximum number of decoded users kept in memory.
+ @return a `MXFileUserDirectory` instance.
+ */
+- (instancetype)initWithFolder:(NSString*)folder cacheCountLimit:(NSUInteger)cacheCountLimit;
+
+/**
+ The folder containing the directory files.
+ */
+@property (nonatomic, readonly) NSString *folder;
+
+/**
+ The number of known users.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ Load the index if it is not loaded yet.
+ */
+- (void)load;
+
+/**
+ Forget the loaded index so that it is read again from the files.
+
+ Call it when the files have been replaced, for example by a backup restoration.
+ */
+- (void)reload;
+
+/**
+ Get a user.
+
+ @param userId the user id.
+ @return the user. nil if unknown.
+ */
+- (nullable MXUser*)userWithUserId:(NSString*)userId;
+
+/**
+ Get users.
+
+ @param userIds the user ids.
+ @return the known users among them.
+ */
+- (NSArray<MXUser*>*)usersWithUserIds:(NSArray<NSString*>*)userIds;
+
+/**
+ Get all users. All of them are decoded: this can be expensive.
+ */
+- (NSArray<MXUser*>*)allUsers;
+
+/**
+ Users that are currently in memory.
+ */
+- (NSArray<MXUser*>*)residentUsers;
+
+/**
+ Store a user. The user is written on the next `writeUsers:`.
+
+ @param user the user.
+ */
+- (void)storeUser:(MXUser*)user;
+
+/**
+ Take a copy of the users stored since the last call.
+
+ Users returned here are still served from memory until `writeUsers:` has written them.
+
+ @return users by user id.
+ */
+- (NSDictionary<NSString*, MXUser*>*)snapshotDirtyUsers;
+
+/**
+ Write users to disk.
+
+ @param users users returned by `snapshotDirtyUsers`.
+ */
+- (void)writeUsers:(NSDictionary<NSString*, MXUser*>*)users;
+
+/**
+ Copy the directory files into a folder, before writing, so that they can be restored if the
+ write is interrupted.
+
+ Files already present in the folder are kept: they are the state to restore.
+
+ @param folder the backup folder.
+ */
+- (void)backupFilesToFolder:(NSString*)folder;
+
+/**
+ Remove all users and delete the directory files.
+ */
+- (void)removeAllUsers;
+
+@end
+
+NS_ASSUME_NONNULL_END
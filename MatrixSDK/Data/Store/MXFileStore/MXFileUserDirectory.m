@@ -0,0 +1,778 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXFileUserDirectory.h"
+
+#import "MXLog.h"
+
+static NSString *const kMXFileUserDirectoryDataFile = @"data";
+static NSString *const kMXFileUserDirectoryIndexFile = @"index";
+
+static uint32_t const kMXFileUserDirectoryDataMagic = 0x4455584D; // "MXUD"
+static uint32_t const kMXFileUserDirectoryIndexMagic = 0x4955584D; // "MXUI"
+static uint32_t const kMXFileUserDirectoryVersion = 1;
+
+// Blob lengths are packed with offsets in the in-memory index
+static uint64_t const kMXFileUserDirectoryMaxBlobLength = (1 << 24) - 1;
+
+// Outdated data below which compaction is not worth it
+static uint64_t const kMXFileUserDirectoryMinUnusedBytesForCompaction = 1024 * 1024;
+
+// All fields are stored in host byte order (little endian on all supported platforms)
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+} MXFileUserDirectoryHeader;
+
+// Header of a record in the data file. It is followed by the user id and the blob
+typedef struct __attribute__((packed))
+{
+    uint32_t blobLength;
+    uint16_t userIdLength;
+} MXFileUserDirectoryRecordHeader;
+
+// Entry of the index file. It is followed by the user id
+typedef struct __attribute__((packed))
+{
+    uint64_t blobOffset;
+    uint32_t blobLength;
+    uint16_t userIdLength;
+} MXFileUserDirectoryIndexEntry;
+
+static inline uint64_t MXFileUserDirectoryPackLocation(uint64_t offset, uint64_t length)
+{
+    return (offset << 24) | length;
+}
+
+static inline uint64_t MXFileUserDirectoryLocationOffset(uint64_t location)
+{
+    return location >> 24;
+}
+
+static inline uint64_t MXFileUserDirectoryLocationLength(uint64_t location)
+{
+    return location & kMXFileUserDirectoryMaxBlobLength;
+}
+
+@interface MXFileUserDirectory ()
+{
+    BOOL loaded;
+    uint64_t generation;
+
+    NSFileHandle *dataFileHandle;
+    NSFileHandle *indexFileHandle;
+    uint64_t dataFileLength;
+
+    // Blob location in the data file by user id
+    NSMutableDictionary<NSString*, NSNumber*> *index;
+
+    // Sum of the lengths of indexed blobs
+    uint64_t usedBytes;
+
+    // Users stored since the last snapshot
+    NSMutableDictionary<NSString*, MXUser*> *dirtyUsers;
+
+    // Users snapshotted but not written yet
+    NSMutableDictionary<NSString*, MXUser*> *pendingUsers;
+
+    // Recently used users
+    NSCache<NSString*, MXUser*> *cache;
+
+    // Decoded users that are still alive. Used to always return the same instance
+    NSMapTable<NSString*, MXUser*> *liveUsers;
+}
+@end
+
+@implementation MXFileUserDirectory
+
+- (instancetype)initWithFolder:(NSString *)folder cacheCountLimit:(NSUInteger)cacheCountLimit
+{
+    self = [super init];
+    if (self)
+    {
+        _folder = folder;
+        index = [NSMutableDictionary dictionary];
+        dirtyUsers = [NSMutableDictionary dictionary];
+        pendingUsers = [NSMutableDictionary dictionary];
+        cache = [NSCache new];
+        cache.countLimit = cacheCountLimit;
+        liveUsers = [NSMapTable strongToWeakObjectsMapTable];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [dataFileHandle closeFile];
+    [indexFileHandle closeFile];
+}
+
+- (NSUInteger)count
+{
+    @synchronized (self)
+    {
+        [self loadIfNeeded];
+
+        NSUInteger count = index.count;
+        for (NSString *userId in dirtyUsers)
+        {
+            if (!index[userId] && !pendingUsers[userId])
+            {
+                count++;
+            }
+        }
+        for (NSString *userId in pendingUsers)
+        {
+            if (!index[userId])
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+}
+
+- (void)load
+{
+    @synchronized (self)
+    {
+        [self loadIfNeeded];
+    }
+}
+
+- (void)reload
+{
+    @synchronized (self)
+    {
+        [dataFileHandle closeFile];
+        dataFileHandle = nil;
+        [indexFileHandle closeFile];
+        indexFileHandle = nil;
+
+        // Decoded users may not match the files anymore
+        [index removeAllObjects];
+        [cache removeAllObjects];
+        [liveUsers removeAllObjects];
+        usedBytes = 0;
+        dataFileLength = 0;
+        loaded = NO;
+    }
+}
+
+- (MXUser *)userWithUserId:(NSString *)userId
+{
+    @synchronized (self)
+    {
+        MXUser *user = dirtyUsers[userId] ?: [liveUsers objectForKey:userId];
+        if (!user)
+        {
+            user = [cache objectForKey:userId];
+        }
+        if (!user)
+        {
+            user = pendingUsers[userId];
+        }
+        if (!user)
+        {
+            [self loadIfNeeded];
+            user = [self readUserWithUserId:userId];
+            if (user)
+            {
+                [liveUsers setObject:user forKey:userId];
+            }
+        }
+
+        if (user)
+        {
+            [cache setObject:user forKey:userId];
+        }
+        return user;
+    }
+}
+
+- (NSArray<MXUser *> *)usersWithUserIds:(NSArray<NSString *> *)userIds
+{
+    NSMutableArray<MXUser*> *users = [NSMutableArray arrayWithCapacity:userIds.count];
+    @synchronized (self)
+    {
+        // Read blobs in file order
+        [self loadIfNeeded];
+        NSArray<NSString*> *sortedUserIds = [userIds sortedArrayUsingComparator:^NSComparisonResult(NSString *userId1, NSString *userId2) {
+            return [self->index[userId1] compare:self->index[userId2] ?: @(0)];
+        }];
+
+        for (NSString *userId in sortedUserIds)
+        {
+            MXUser *user = [self userWithUserId:userId];
+            if (user)
+            {
+                [users addObject:user];
+            }
+        }
+    }
+    return users;
+}
+
+- (NSArray<MXUser *> *)allUsers
+{
+    @synchronized (self)
+    {
+        [self loadIfNeeded];
+
+        NSMutableOrderedSet<NSString*> *userIds = [NSMutableOrderedSet orderedSetWithArray:index.allKeys];
+        [userIds addObjectsFromArray:pendingUsers.allKeys];
+        [userIds addObjectsFromArray:dirtyUsers.allKeys];
+
+        MXLogDebug(@"[MXFileUserDirectory] allUsers: Decode %tu users", userIds.count);
+        return [self usersWithUserIds:userIds.array];
+    }
+}
+
+- (NSArray<MXUser *> *)residentUsers
+{
+    @synchronized (self)
+    {
+        NSMutableDictionary<NSString*, MXUser*> *users = [NSMutableDictionary dictionary];
+        for (NSString *userId in liveUsers)
+        {
+            MXUser *user = [liveUsers objectForKey:userId];
+            if (user)
+            {
+                users[userId] = user;
+            }
+        }
+        [users addEntriesFromDictionary:dirtyUsers];
+        return users.allValues;
+    }
+}
+
+- (void)storeUser:(MXUser *)user
+{
+    if (!user.userId)
+    {
+        return;
+    }
+
+    @synchronized (self)
+    {
+        dirtyUsers[user.userId] = user;
+        [liveUsers setObject:user forKey:user.userId];
+        [cache setObject:user forKey:user.userId];
+    }
+}
+
+- (NSDictionary<NSString *,MXUser *> *)snapshotDirtyUsers
+{
+    @synchronized (self)
+    {
+        NSDictionary<NSString*, MXUser*> *snapshot = [[NSDictionary alloc] initWithDictionary:dirtyUsers copyItems:YES];
+        [dirtyUsers removeAllObjects];
+        [pendingUsers addEntriesFromDictionary:snapshot];
+        return snapshot;
+    }
+}
+
+- (void)writeUsers:(NSDictionary<NSString *,MXUser *> *)users
+{
+    if (!users.count)
+    {
+        return;
+    }
+
+    @synchronized (self)
+    {
+        [self loadIfNeeded];
+        if (!dataFileHandle && ![self resetFiles])
+        {
+            return;
+        }
+
+        NSMutableData *records = [NSMutableData data];
+        NSMutableData *indexEntries = [NSMutableData data];
+        NSMutableDictionary<NSString*, NSNumber*> *locations = [NSMutableDictionary dictionaryWithCapacity:users.count];
+
+        for (NSString *userId in users)
+        {
+            NSData *blob = [NSKeyedArchiver archivedDataWithRootObject:users[userId]];
+            NSData *userIdData = [userId dataUsingEncoding:NSUTF8StringEncoding];
+            if (blob.length > kMXFileUserDirectoryMaxBlobLength || userIdData.length > UINT16_MAX)
+            {
+                MXLogErrorDetails(@"[MXFileUserDirectory] writeUsers: User too big to be stored", @{
+                    @"user_id": userId,
+                    @"length": @(blob.length)
+                });
+                continue;
+            }
+
+            MXFileUserDirectoryRecordHeader recordHeader = {
+                .blobLength = (uint32_t)blob.length,
+                .userIdLength = (uint16_t)userIdData.length
+            };
+            [records appendBytes:&recordHeader length:sizeof(recordHeader)];
+            [records appendData:userIdData];
+            uint64_t blobOffset = dataFileLength + records.length;
+            [records appendData:blob];
+
+            MXFileUserDirectoryIndexEntry entry = {
+                .blobOffset = blobOffset,
+                .blobLength = (uint32_t)blob.length,
+                .userIdLength = (uint16_t)userIdData.length
+            };
+            [indexEntries appendBytes:&entry length:sizeof(entry)];
+            [indexEntries appendData:userIdData];
+
+            locations[userId] = @(MXFileUserDirectoryPackLocation(blobOffset, blob.length));
+        }
+
+        @try
+        {
+            // Data first: records that are not indexed yet are recovered at load
+            [dataFileHandle seekToFileOffset:dataFileLength];
+            [dataFileHandle writeData:records];
+            dataFileLength += records.length;
+
+            [indexFileHandle seekToEndOfFile];
+            [indexFileHandle writeData:indexEntries];
+        }
+        @catch (NSException *exception)
+        {
+            MXLogErrorDetails(@"[MXFileUserDirectory] writeUsers: Cannot write", @{
+                @"exception": exception ?: @"unknown"
+            });
+            return;
+        }
+
+        for (NSString *userId in locations)
+        {
+            [self setLocation:locations[userId] forUserId:userId];
+
+            // The written copy is not needed anymore unless a newer snapshot replaced it
+            if (pendingUsers[userId] == users[userId])
+            {
+                [pendingUsers removeObjectForKey:userId];
+            }
+        }
+
+        [self compactIfNeeded];
+    }
+}
+
+- (void)backupFilesToFolder:(NSString *)folder
+{
+    @synchronized (self)
+    {
+        for (NSString *file in @[self.dataFile, self.indexFile])
+        {
+            NSString *backupFile = [folder stringByAppendingPathComponent:file.lastPathComponent];
+            if ([[NSFileManager defaultManager] fileExistsAtPath:file]
+                && ![[NSFileManager defaultManager] fileExistsAtPath:backupFile])
+            {
+                // Copy, do not move: records are appended to the current files.
+                // On APFS, the copy is a clone and does not duplicate the data
+                [[NSFileManager defaultManager] copyItemAtPath:file toPath:backupFile error:nil];
+            }
+        }
+    }
+}
+
+- (void)removeAllUsers
+{
+    @synchronized (self)
+    {
+        [dataFileHandle closeFile];
+        dataFileHandle = nil;
+        [indexFileHandle closeFile];
+        indexFileHandle = nil;
+
+        [[NSFileManager defaultManager] removeItemAtPath:[_folder stringByAppendingPathComponent:kMXFileUserDirectoryDataFile] error:nil];
+        [[NSFileManager defaultManager] removeItemAtPath:[_folder stringByAppendingPathComponent:kMXFileUserDirectoryIndexFile] error:nil];
+
+        [index removeAllObjects];
+        [dirtyUsers removeAllObjects];
+        [pendingUsers removeAllObjects];
+        [cache removeAllObjects];
+        [liveUsers removeAllObjects];
+        usedBytes = 0;
+        dataFileLength = 0;
+
+        // Files will be created on the next write
+        loaded = YES;
+    }
+}
+
+#pragma mark - Private
+
+- (NSString*)dataFile
+{
+    return [_folder stringByAppendingPathComponent:kMXFileUserDirectoryDataFile];
+}
+
+- (NSString*)indexFile
+{
+    return [_folder stringByAppendingPathComponent:kMXFileUserDirectoryIndexFile];
+}
+
+- (void)setLocation:(NSNumber*)location forUserId:(NSString*)userId
+{
+    NSNumber *previousLocation = index[userId];
+    if (previousLocation)
+    {
+        usedBytes -= MXFileUserDirectoryLocationLength(previousLocation.unsignedLongLongValue);
+    }
+    usedBytes += MXFileUserDirectoryLocationLength(location.unsignedLongLongValue);
+    index[userId] = location;
+}
+
+- (MXUser*)readUserWithUserId:(NSString*)userId
+{
+    NSNumber *location = index[userId];
+    if (!location)
+    {
+        return nil;
+    }
+
+    MXUser *user;
+    @try
+    {
+        [dataFileHandle seekToFileOffset:MXFileUserDirectoryLocationOffset(location.unsignedLongLongValue)];
+        NSData *blob = [dataFileHandle readDataOfLength:MXFileUserDirectoryLocationLength(location.unsignedLongLongValue)];
+        user = [NSKeyedUnarchiver unarchiveObjectWithData:blob];
+    }
+    @catch (NSException *exception)
+    {
+        MXLogErrorDetails(@"[MXFileUserDirectory] readUserWithUserId: User data has been corrupted", @{
+            @"user_id": userId ?: @"unknown",
+            @"exception": exception ?: @"unknown"
+        });
+    }
+    return [user isKindOfClass:MXUser.class] ? user : nil;
+}
+
+#pragma mark - Load
+
+- (void)loadIfNeeded
+{
+    if (loaded)
+    {
+        return;
+    }
+    loaded = YES;
+
+    NSDate *startDate = [NSDate date];
+
+    dataFileHandle = [NSFileHandle fileHandleForUpdatingAtPath:self.dataFile];
+    if (!dataFileHandle || ![self loadDataFileHeader])
+    {
+        [self resetFiles];
+        return;
+    }
+
+    if (![self loadIndex])
+    {
+        MXLogDebug(@"[MXFileUserDirectory] load: Rebuild the index");
+        [self rebuildIndex];
+    }
+
+    indexFileHandle = [NSFileHandle fileHandleForUpdatingAtPath:self.indexFile];
+
+    MXLogDebug(@"[MXFileUserDirectory] load: Loaded the index of %tu users in %.0fms", index.count, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+}
+
+- (BOOL)loadDataFileHeader
+{
+    dataFileLength = [dataFileHandle seekToEndOfFile];
+    [dataFileHandle seekToFileOffset:0];
+
+    NSData *headerData = [dataFileHandle readDataOfLength:sizeof(MXFileUserDirectoryHeader)];
+    if (headerData.length != sizeof(MXFileUserDirectoryHeader))
+    {
+        return NO;
+    }
+
+    MXFileUserDirectoryHeader header;
+    [headerData getBytes:&header length:sizeof(header)];
+    if (header.magic != kMXFileUserDirectoryDataMagic || header.version != kMXFileUserDirectoryVersion)
+    {
+        MXLogError(@"[MXFileUserDirectory] load: Unexpected data file. Reset it");
+        return NO;
+    }
+
+    generation = header.generation;
+    return YES;
+}
+
+/**
+ Load the index file.
+
+ @return NO if it does not match the data file.
+ */
+- (BOOL)loadIndex
+{
+    NSData *contents = [NSData dataWithContentsOfFile:self.indexFile options:NSDataReadingMappedIfSafe error:nil];
+    if (contents.length < sizeof(MXFileUserDirectoryHeader))
+    {
+        return NO;
+    }
+
+    MXFileUserDirectoryHeader header;
+    [contents getBytes:&header length:sizeof(header)];
+    if (header.magic != kMXFileUserDirectoryIndexMagic
+        || header.version != kMXFileUserDirectoryVersion
+        || header.generation != generation)
+    {
+        return NO;
+    }
+
+    const uint8_t *bytes = contents.bytes;
+    NSUInteger length = contents.length;
+    NSUInteger position = sizeof(MXFileUserDirectoryHeader);
+    uint64_t indexedDataEnd = sizeof(MXFileUserDirectoryHeader);
+
+    while (position + sizeof(MXFileUserDirectoryIndexEntry) <= length)
+    {
+        MXFileUserDirectoryIndexEntry entry;
+        memcpy(&entry, bytes + position, sizeof(entry));
+
+        if (position + sizeof(entry) + entry.userIdLength > length
+            || entry.blobOffset + entry.blobLength > dataFileLength)
+        {
+            // Entry written after its record was lost
+            break;
+        }
+
+        NSString *userId = [[NSString alloc] initWithBytes:bytes + position + sizeof(entry) length:entry.userIdLength encoding:NSUTF8StringEncoding];
+        if (userId)
+        {
+            [self setLocation:@(MXFileUserDirectoryPackLocation(entry.blobOffset, entry.blobLength)) forUserId:userId];
+        }
+
+        indexedDataEnd = MAX(indexedDataEnd, entry.blobOffset + entry.blobLength);
+        position += sizeof(entry) + entry.userIdLength;
+    }
+
+    if (position != length)
+    {
+        MXLogDebug(@"[MXFileUserDirectory] load: Drop %tu bytes at the end of the index", length - position);
+        NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:self.indexFile];
+        [fileHandle truncateFileAtOffset:position];
+        [fileHandle closeFile];
+    }
+
+    // Index records written after the last index entry
+    if (indexedDataEnd < dataFileLength)
+    {
+        NSMutableData *indexEntries = [NSMutableData data];
+        [self scanDataFromOffset:indexedDataEnd indexEntries:indexEntries];
+
+        NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:self.indexFile];
+        [fileHandle seekToEndOfFile];
+        [fileHandle writeData:indexEntries];
+        [fileHandle closeFile];
+    }
+
+    return YES;
+}
+
+- (void)rebuildIndex
+{
+    [index removeAllObjects];
+    usedBytes = 0;
+
+    NSMutableData *indexContents = [self indexHeaderData];
+    [self scanDataFromOffset:sizeof(MXFileUserDirectoryHeader) indexEntries:indexContents];
+    [indexContents writeToFile:self.indexFile atomically:YES];
+}
+
+/**
+ Index records of the data file from an offset.
+
+ A truncated record at the end of the file is removed.
+
+ @param offset the offset of the first record to index.
+ @param indexEntries data where to append the corresponding index entries.
+ */
+- (void)scanDataFromOffset:(uint64_t)offset indexEntries:(NSMutableData*)indexEntries
+{
+    NSData *contents = [NSData dataWithContentsOfFile:self.dataFile options:NSDataReadingMappedIfSafe error:nil];
+    const uint8_t *bytes = contents.bytes;
+    uint64_t length = MIN(contents.length, dataFileLength);
+    uint64_t position = offset;
+
+    while (position + sizeof(MXFileUserDirectoryRecordHeader) <= length)
+    {
+        MXFileUserDirectoryRecordHeader recordHeader;
+        memcpy(&recordHeader, bytes + position, sizeof(recordHeader));
+
+        uint64_t blobOffset = position + sizeof(recordHeader) + recordHeader.userIdLength;
+        if (blobOffset + recordHeader.blobLength > length)
+        {
+            break;
+        }
+
+        NSString *userId = [[NSString alloc] initWithBytes:bytes + position + sizeof(recordHeader) length:recordHeader.userIdLength encoding:NSUTF8StringEncoding];
+        if (userId)
+        {
+            [self setLocation:@(MXFileUserDirectoryPackLocation(blobOffset, recordHeader.blobLength)) forUserId:userId];
+
+            MXFileUserDirectoryIndexEntry entry = {
+                .blobOffset = blobOffset,
+                .blobLength = recordHeader.blobLength,
+                .userIdLength = recordHeader.userIdLength
+            };
+            [indexEntries appendBytes:&entry length:sizeof(entry)];
+            [indexEntries appendBytes:bytes + position + sizeof(recordHeader) length:recordHeader.userIdLength];
+        }
+
+        position = blobOffset + recordHeader.blobLength;
+    }
+
+    if (position != dataFileLength)
+    {
+        MXLogDebug(@"[MXFileUserDirectory] load: Drop %llu bytes at the end of the data file", dataFileLength - position);
+        [dataFileHandle truncateFileAtOffset:position];
+        dataFileLength = position;
+    }
+}
+
+- (NSMutableData*)indexHeaderData
+{
+    MXFileUserDirectoryHeader header = {
+        .magic = kMXFileUserDirectoryIndexMagic,
+        .version = kMXFileUserDirectoryVersion,
+        .generation = generation
+    };
+    return [NSMutableData dataWithBytes:&header length:sizeof(header)];
+}
+
+- (NSMutableData*)dataHeaderData
+{
+    MXFileUserDirectoryHeader header = {
+        .magic = kMXFileUserDirectoryDataMagic,
+        .version = kMXFileUserDirectoryVersion,
+        .generation = generation
+    };
+    return [NSMutableData dataWithBytes:&header length:sizeof(header)];
+}
+
+/**
+ Create empty files.
+ */
+- (BOOL)resetFiles
+{
+    [dataFileHandle closeFile];
+    [indexFileHandle closeFile];
+    [index removeAllObjects];
+    usedBytes = 0;
+
+    [[NSFileManager defaultManager] createDirectoryAtPath:_folder withIntermediateDirectories:YES attributes:nil error:nil];
+
+    generation++;
+    return [self openFilesWithData:[self dataHeaderData] index:[self indexHeaderData]];
+}
+
+- (BOOL)openFilesWithData:(NSData*)data index:(NSData*)indexContents
+{
+    // Write the data file first. If the index is not written, it will be rebuilt
+    if (![data writeToFile:self.dataFile atomically:YES]
+        || ![indexContents writeToFile:self.indexFile atomically:YES])
+    {
+        MXLogError(@"[MXFileUserDirectory] Cannot write files");
+        dataFileHandle = nil;
+        indexFileHandle = nil;
+        return NO;
+    }
+
+    dataFileHandle = [NSFileHandle fileHandleForUpdatingAtPath:self.dataFile];
+    indexFileHandle = [NSFileHandle fileHandleForUpdatingAtPath:self.indexFile];
+    dataFileLength = data.length;
+    return dataFileHandle && indexFileHandle;
+}
+
+#pragma mark - Compaction
+
+- (void)compactIfNeeded
+{
+    uint64_t unusedBytes = dataFileLength - sizeof(MXFileUserDirectoryHeader) - usedBytes;
+    if (unusedBytes > kMXFileUserDirectoryMinUnusedBytesForCompaction && unusedBytes > usedBytes)
+    {
+        [self compact];
+    }
+}
+
+- (void)compact
+{
+    NSDate *startDate = [NSDate date];
+    uint64_t previousDataFileLength = dataFileLength;
+
+    NSData *contents = [NSData dataWithContentsOfFile:self.dataFile options:NSDataReadingMappedIfSafe error:nil];
+    if (!contents)
+    {
+        return;
+    }
+
+    generation++;
+    NSMutableData *data = [self dataHeaderData];
+    NSMutableData *indexContents = [self indexHeaderData];
+    NSMutableDictionary<NSString*, NSNumber*> *newIndex = [NSMutableDictionary dictionaryWithCapacity:index.count];
+
+    // Keep records in file order
+    NSArray<NSString*> *userIds = [index keysSortedByValueUsingSelector:@selector(compare:)];
+    for (NSString *userId in userIds)
+    {
+        uint64_t location = index[userId].unsignedLongLongValue;
+        NSData *userIdData = [userId dataUsingEncoding:NSUTF8StringEncoding];
+
+        MXFileUserDirectoryRecordHeader recordHeader = {
+            .blobLength = (uint32_t)MXFileUserDirectoryLocationLength(location),
+            .userIdLength = (uint16_t)userIdData.length
+        };
+        [data appendBytes:&recordHeader length:sizeof(recordHeader)];
+        [data appendData:userIdData];
+        uint64_t blobOffset = data.length;
+        [data appendBytes:(const uint8_t *)contents.bytes + MXFileUserDirectoryLocationOffset(location) length:recordHeader.blobLength];
+
+        MXFileUserDirectoryIndexEntry entry = {
+            .blobOffset = blobOffset,
+            .blobLength = recordHeader.blobLength,
+            .userIdLength = recordHeader.userIdLength
+        };
+        [indexContents appendBytes:&entry length:sizeof(entry)];
+        [indexContents appendData:userIdData];
+
+        newIndex[userId] = @(MXFileUserDirectoryPackLocation(blobOffset, recordHeader.blobLength));
+    }
+
+    [dataFileHandle closeFile];
+    [indexFileHandle closeFile];
+    index = newIndex;
+
+    if ([self openFilesWithData:data index:indexContents])
+    {
+        MXLogDebug(@"[MXFileUserDirectory] compact: %llu bytes -> %llu bytes in %.0fms", previousDataFileLength, dataFileLength, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
+    }
+    else
+    {
+        // Start again from what is on disk
+        loaded = NO;
+        [index removeAllObjects];
+        usedBytes = 0;
+        [self loadIfNeeded];
+    }
+}
+
+@end
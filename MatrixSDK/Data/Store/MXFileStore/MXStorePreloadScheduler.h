@@ -0,0 +1,93 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MXTaskProfileName.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Block that decodes an item. It is called on a worker thread.
+
+ @param item the item to decode.
+ @return the decoded object.
+ */
+typedef id _Nullable (^MXStorePreloadDecodeBlock)(id item);
+
+/**
+ Block that merges a decoded item. Merge blocks are called one at a time.
+
+ @param item the item.
+ @param result the object returned by the decode block.
+ */
+typedef void (^MXStorePreloadMergeBlock)(id item, id _Nullable result);
+
+/**
+ `MXStorePreloadScheduler` decodes store files concurrently.
+
+ Work is organised in phases (room messages, room states, users...). Each phase has a list
+ of items, typically one per file. Items are decoded on a bounded pool of worker threads and
+ the results are merged serially on the scheduler queue, so that merge blocks can update
+ data structures that are not thread safe.
+
+ The duration of each phase, from its first decode to its last merge, is reported to
+ `MXSDKOptions.profiler`.
+ */
+@interface MXStorePreloadScheduler : NSObject
+
+/**
+ Create a scheduler.
+
+ @param maxConcurrentTasks the maximum number of items decoded at the same time.
+ @return a `MXStorePreloadScheduler` instance.
+ */
+- (instancetype)initWithMaxConcurrentTasks:(NSUInteger)maxConcurrentTasks NS_DESIGNATED_INITIALIZER;
+
+/**
+ Create a scheduler with one worker per active processor.
+ */
+- (instancetype)init;
+
+/**
+ The maximum number of items decoded at the same time.
+ */
+@property (nonatomic, readonly) NSUInteger maxConcurrentTasks;
+
+/**
+ Add a phase.
+
+ @param name the name used to report the phase duration.
+ @param items the items to decode.
+ @param decodeBlock the block called for each item on a worker thread.
+ @param mergeBlock the block called for each decoded item on the scheduler queue.
+ */
+- (void)addPhaseWithName:(MXTaskProfileName)name
+                   items:(NSArray*)items
+             decodeBlock:(MXStorePreloadDecodeBlock)decodeBlock
+              mergeBlock:(MXStorePreloadMergeBlock)mergeBlock;
+
+/**
+ Run all added phases.
+
+ Items are scheduled in the order of phases. The method returns once all items have been
+ merged. Phases are then removed.
+ */
+- (void)run;
+
+@end
+
+NS_ASSUME_NONNULL_END
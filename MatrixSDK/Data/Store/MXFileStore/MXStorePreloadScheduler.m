@@ -0,0 +1,132 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXStorePreloadScheduler.h"
+
+#import "MXSDKOptions.h"
+
+#pragma mark - MXStorePreloadPhase
+
+@interface MXStorePreloadPhase : NSObject
+
+@property (nonatomic) MXTaskProfileName name;
+@property (nonatomic) NSArray *items;
+@property (nonatomic, copy) MXStorePreloadDecodeBlock decodeBlock;
+@property (nonatomic, copy) MXStorePreloadMergeBlock mergeBlock;
+
+// Only accessed on the merge queue once the phase has started
+@property (nonatomic) NSUInteger remainingItems;
+@property (nonatomic) MXTaskProfile *taskProfile;
+
+@end
+
+@implementation MXStorePreloadPhase
+@end
+
+
+#pragma mark - MXStorePreloadScheduler
+
+@interface MXStorePreloadScheduler ()
+{
+    NSMutableArray<MXStorePreloadPhase*> *phases;
+
+    // Queue where decoded items are merged
+    dispatch_queue_t mergeQueue;
+}
+@end
+
+@implementation MXStorePreloadScheduler
+
+- (instancetype)initWithMaxConcurrentTasks:(NSUInteger)maxConcurrentTasks
+{
+    self = [super init];
+    if (self)
+    {
+        _maxConcurrentTasks = MAX(maxConcurrentTasks, 1);
+        phases = [NSMutableArray array];
+        mergeQueue = dispatch_queue_create("MXStorePreloadScheduler", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (instancetype)init
+{
+    return [self initWithMaxConcurrentTasks:NSProcessInfo.processInfo.activeProcessorCount];
+}
+
+- (void)addPhaseWithName:(MXTaskProfileName)name
+                   items:(NSArray *)items
+             decodeBlock:(MXStorePreloadDecodeBlock)decodeBlock
+              mergeBlock:(MXStorePreloadMergeBlock)mergeBlock
+{
+    MXStorePreloadPhase *phase = [MXStorePreloadPhase new];
+    phase.name = name;
+    phase.items = [items copy];
+    phase.decodeBlock = decodeBlock;
+    phase.mergeBlock = mergeBlock;
+
+    [phases addObject:phase];
+}
+
+- (void)run
+{
+    id<MXProfiler> profiler = MXSDKOptions.sharedInstance.profiler;
+    dispatch_queue_t workerQueue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    dispatch_group_t group = dispatch_group_create();
+
+    // Bound the number of items being decoded
+    dispatch_semaphore_t workers = dispatch_semaphore_create(_maxConcurrentTasks);
+
+    for (MXStorePreloadPhase *phase in phases)
+    {
+        if (!phase.items.count)
+        {
+            continue;
+        }
+
+        phase.remainingItems = phase.items.count;
+        phase.taskProfile = [profiler startMeasuringTaskWithName:phase.name];
+        phase.taskProfile.units = phase.items.count;
+
+        for (id item in phase.items)
+        {
+            dispatch_semaphore_wait(workers, DISPATCH_TIME_FOREVER);
+
+            dispatch_group_async(group, workerQueue, ^{
+                id result;
+                @autoreleasepool
+                {
+                    result = phase.decodeBlock(item);
+                }
+                dispatch_semaphore_signal(workers);
+
+                dispatch_group_async(group, self->mergeQueue, ^{
+                    phase.mergeBlock(item, result);
+
+                    if (--phase.remainingItems == 0 && phase.taskProfile)
+                    {
+                        [profiler stopMeasuringTaskWithProfile:phase.taskProfile];
+                    }
+                });
+            });
+        }
+    }
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    [phases removeAllObjects];
+}
+
+@end
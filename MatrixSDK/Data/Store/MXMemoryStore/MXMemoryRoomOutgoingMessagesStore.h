@@ -46,6 +46,14 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)removeOutgoingMessage:(NSString*)eventId;
 
+/**
+ Get an outgoing message.
+
+ @param eventId the id of the message.
+ @return the message. nil if not found.
+ */
+- (nullable MXEvent*)outgoingMessageWithEventId:(NSString*)eventId;
+
 /**
  All outgoing messages pending in the room.
  */
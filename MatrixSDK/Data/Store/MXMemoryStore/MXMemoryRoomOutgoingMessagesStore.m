@@ -18,6 +18,8 @@
 
 @interface MXMemoryRoomOutgoingMessagesStore ()
 {
+    // Outgoing messages by event id. Built on first use
+    NSMutableDictionary<NSString*, MXEvent*> *outgoingMessagesByEventId;
 }
 
 @end
@@ -42,11 +44,18 @@
     {
         [outgoingMessages addObject:outgoingMessage];
     }
+
+    // The event id of a stored message may have changed
+    if (outgoingMessagesByEventId && outgoingMessage.eventId)
+    {
+        outgoingMessagesByEventId[outgoingMessage.eventId] = outgoingMessage;
+    }
 }
 
 - (void)removeAllOutgoingMessages
 {
     [outgoingMessages removeAllObjects];
+    [outgoingMessagesByEventId removeAllObjects];
 }
 
 - (void)removeOutgoingMessage:(NSString*)eventId
@@ -60,6 +69,39 @@
             break;
         }
     }
+    [outgoingMessagesByEventId removeObjectForKey:eventId];
+}
+
+- (MXEvent *)outgoingMessageWithEventId:(NSString *)eventId
+{
+    if (!outgoingMessagesByEventId)
+    {
+        outgoingMessagesByEventId = [NSMutableDictionary dictionaryWithCapacity:outgoingMessages.count];
+        for (MXEvent *outgoingMessage in outgoingMessages)
+        {
+            if (outgoingMessage.eventId)
+            {
+                outgoingMessagesByEventId[outgoingMessage.eventId] = outgoingMessage;
+            }
+        }
+    }
+
+    MXEvent *outgoingMessage = outgoingMessagesByEventId[eventId];
+
+    // Drop entries of messages whose event id has changed since they were stored
+    if (outgoingMessage && ![outgoingMessage.eventId isEqualToString:eventId])
+    {
+        [outgoingMessagesByEventId removeObjectForKey:eventId];
+        outgoingMessage = nil;
+    }
+
+    return outgoingMessage;
+}
+
+- (void)setOutgoingMessages:(NSArray<MXEvent *> *)theOutgoingMessages
+{
+    outgoingMessages = [theOutgoingMessages mutableCopy];
+    outgoingMessagesByEventId = nil;
 }
 
 - (NSString *)description
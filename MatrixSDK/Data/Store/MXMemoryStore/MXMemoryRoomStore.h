@@ -102,6 +102,19 @@
  */
 - (id<MXEventsEnumerator>)enumeratorForMessagesWithTypeIn:(NSArray*)types;
 
+/**
+ Find the event to acknowledge with a read receipt when the user has read an event.
+
+ Messages are indexed by position on the first call so that next calls do not enumerate them.
+
+ @param event the event read by the user.
+ @param receiptEventId the event id of the current read receipt in the thread of `event`, if any.
+ @param types the acknowledgeable event types.
+ @return the last event of `types` in the thread of `event`, at or before it.
+         nil if there is none after the current read receipt.
+ */
+- (MXEvent*)eventToAcknowledge:(MXEvent*)event afterReceipt:(NSString*)receiptEventId withTypeIn:(NSArray<MXEventTypeString>*)types;
+
 /**
  Get all events in thread since the root message event.
 
@@ -19,9 +19,12 @@
 
 #import "MXEventsEnumeratorOnArray.h"
 #import "MXEventsByTypesEnumeratorOnArray.h"
+#import "MXMemoryRoomThreadedEventsIndex.h"
 
 @interface MXMemoryRoomStore () <MXEventsEnumeratorDataSource>
 {
+    // Positions of messages, built on demand
+    MXMemoryRoomThreadedEventsIndex *threadedEventsIndex;
 }
 
 @end
@@ -56,6 +59,8 @@
     {
         messagesByEventIds[event.eventId] = event;
     }
+
+    [threadedEventsIndex addEvent:event direction:direction];
 }
 
 - (void)replaceEvent:(MXEvent*)event
@@ -67,6 +72,7 @@
         if ([anEvent.eventId isEqualToString:event.eventId])
         {
             [messages replaceObjectAtIndex:index withObject:event];
+            [threadedEventsIndex replaceEvent:anEvent withEvent:event];
 
             messagesByEventIds[event.eventId] = event;
             break;
@@ -83,6 +89,7 @@
 {
     [messages removeAllObjects];
     [messagesByEventIds removeAllObjects];
+    threadedEventsIndex = nil;
 }
 
 - (NSArray <NSString *>*)allEventIds
@@ -104,6 +111,32 @@
     return [[MXEventsByTypesEnumeratorOnArray alloc] initWithEventIds:[self allEventIds] andTypesIn:types dataSource:self];
 }
 
+- (MXEvent*)eventToAcknowledge:(MXEvent*)event afterReceipt:(NSString*)receiptEventId withTypeIn:(NSArray<MXEventTypeString>*)types
+{
+    if (!threadedEventsIndex || ![threadedEventsIndex.types isEqualToArray:types])
+    {
+        threadedEventsIndex = [[MXMemoryRoomThreadedEventsIndex alloc] initWithMessages:messages types:types];
+    }
+
+    NSNumber *receiptPosition = receiptEventId ? [threadedEventsIndex positionOfEventWithEventId:receiptEventId] : nil;
+    NSInteger minPosition = receiptPosition ? receiptPosition.integerValue : NSIntegerMin;
+
+    NSNumber *position = event.eventId ? [threadedEventsIndex positionOfEventWithEventId:event.eventId] : nil;
+    if (!position)
+    {
+        // The event is not stored in the room. Rely on its timestamp
+        return [threadedEventsIndex lastEventInThread:event.threadId sentAtOrBefore:event.originServerTs afterPosition:minPosition];
+    }
+
+    MXEvent *eventToAcknowledge = [threadedEventsIndex lastEventInThread:event.threadId atOrBeforePosition:position.integerValue];
+    if (eventToAcknowledge && [threadedEventsIndex positionOfEventWithEventId:eventToAcknowledge.eventId].integerValue <= minPosition)
+    {
+        // The current receipt is already at or after this event
+        eventToAcknowledge = nil;
+    }
+    return eventToAcknowledge;
+}
+
 - (NSArray<MXEvent*>*)eventsInThreadWithThreadId:(NSString *)threadId except:(NSString *)userId withTypeIn:(NSSet<MXEventTypeString>*)types
 {
     NSMutableArray* list = [[NSMutableArray alloc] init];
@@ -221,6 +254,11 @@
             break;
         }
     }
+
+    if (didChange)
+    {
+        threadedEventsIndex = nil;
+    }
     return didChange;
 }
 
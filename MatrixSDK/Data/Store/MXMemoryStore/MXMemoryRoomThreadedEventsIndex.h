@@ -0,0 +1,96 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MXEvent.h"
+#import "MXEnumConstants.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ `MXMemoryRoomThreadedEventsIndex` indexes the messages of a room store by their position in the room stream.
+
+ Every message gets a position. Positions increase with the stream order, even for events stored backwards.
+ Events of the indexed types are also listed per thread, in stream order, so that the last one
+ before a position is found by a binary search.
+
+ The index must be informed of each message stored or replaced in the room store.
+ */
+@interface MXMemoryRoomThreadedEventsIndex : NSObject
+
+/**
+ Build the index.
+
+ @param messages the messages of the room, in chronological order.
+ @param types the event types to list per thread.
+ @return a `MXMemoryRoomThreadedEventsIndex` instance.
+ */
+- (instancetype)initWithMessages:(NSArray<MXEvent*>*)messages types:(NSArray<MXEventTypeString>*)types;
+
+/**
+ The event types listed per thread.
+ */
+@property (nonatomic, readonly) NSArray<MXEventTypeString> *types;
+
+/**
+ Index an event stored in the room.
+
+ @param event the event.
+ @param direction the direction it has been stored: at the end or at the beginning of the room messages.
+ */
+- (void)addEvent:(MXEvent*)event direction:(MXTimelineDirection)direction;
+
+/**
+ Index an event that replaces a stored event with the same event id.
+
+ @param event the new event.
+ @param previousEvent the replaced event.
+ */
+- (void)replaceEvent:(MXEvent*)previousEvent withEvent:(MXEvent*)event;
+
+/**
+ The position of an event in the room stream.
+
+ @param eventId the event id.
+ @return the position. nil if the event is not stored.
+ */
+- (nullable NSNumber*)positionOfEventWithEventId:(NSString*)eventId;
+
+/**
+ Find the last event of the indexed types in a thread at or before a position.
+
+ @param threadId the thread id. nil for the main timeline.
+ @param position a position in the room stream.
+ @return the event. nil if none.
+ */
+- (nullable MXEvent*)lastEventInThread:(nullable NSString*)threadId atOrBeforePosition:(NSInteger)position;
+
+/**
+ Find the last event of the indexed types in a thread sent at or before a timestamp.
+
+ The search starts from the most recent event of the thread.
+
+ @param threadId the thread id. nil for the main timeline.
+ @param ts the timestamp.
+ @param position the position where to stop the search, excluded. Pass NSIntegerMin not to stop.
+ @return the event. nil if none.
+ */
+- (nullable MXEvent*)lastEventInThread:(nullable NSString*)threadId sentAtOrBefore:(uint64_t)ts afterPosition:(NSInteger)position;
+
+@end
+
+NS_ASSUME_NONNULL_END
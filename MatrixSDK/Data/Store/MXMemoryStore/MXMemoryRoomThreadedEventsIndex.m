@@ -0,0 +1,185 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXMemoryRoomThreadedEventsIndex.h"
+
+// Key of the main timeline in `eventsByThread`
+static NSString *const kMXMemoryRoomThreadedEventsIndexMainThread = @"";
+
+@interface MXMemoryRoomThreadedEventsIndex ()
+{
+    NSSet<MXEventTypeString> *typeSet;
+
+    // Position of every stored message
+    NSMutableDictionary<NSString*, NSNumber*> *positionsByEventIds;
+
+    // Positions of the first and last messages
+    NSInteger firstPosition;
+    NSInteger lastPosition;
+
+    // Events of the indexed types, in stream order
+    NSMutableDictionary<NSString*, NSMutableArray<MXEvent*>*> *eventsByThread;
+}
+
+@end
+
+@implementation MXMemoryRoomThreadedEventsIndex
+
+- (instancetype)initWithMessages:(NSArray<MXEvent*>*)messages types:(NSArray<MXEventTypeString>*)types
+{
+    self = [super init];
+    if (self)
+    {
+        _types = [types copy];
+        typeSet = [NSSet setWithArray:types];
+        positionsByEventIds = [NSMutableDictionary dictionaryWithCapacity:messages.count];
+        eventsByThread = [NSMutableDictionary dictionary];
+
+        firstPosition = 0;
+        lastPosition = -1;
+        for (MXEvent *event in messages)
+        {
+            [self addEvent:event direction:MXTimelineDirectionForwards];
+        }
+    }
+    return self;
+}
+
+- (void)addEvent:(MXEvent*)event direction:(MXTimelineDirection)direction
+{
+    NSInteger position = (MXTimelineDirectionForwards == direction) ? ++lastPosition : --firstPosition;
+
+    if (!event.eventId)
+    {
+        return;
+    }
+
+    positionsByEventIds[event.eventId] = @(position);
+
+    if ([typeSet containsObject:event.type])
+    {
+        NSMutableArray<MXEvent*> *events = [self eventsInThread:event.threadId create:YES];
+        if (MXTimelineDirectionForwards == direction)
+        {
+            [events addObject:event];
+        }
+        else
+        {
+            [events insertObject:event atIndex:0];
+        }
+    }
+}
+
+- (void)replaceEvent:(MXEvent*)previousEvent withEvent:(MXEvent*)event
+{
+    NSNumber *position = positionsByEventIds[previousEvent.eventId];
+    if (!position)
+    {
+        return;
+    }
+
+    // The thread or the type may have changed (a redaction strips the relations)
+    if ([typeSet containsObject:previousEvent.type])
+    {
+        NSMutableArray<MXEvent*> *events = [self eventsInThread:previousEvent.threadId create:NO];
+        NSUInteger index = [self indexOfFirstEventAfterPosition:position.integerValue - 1 inEvents:events];
+        if (index < events.count && [events[index].eventId isEqualToString:previousEvent.eventId])
+        {
+            [events removeObjectAtIndex:index];
+        }
+    }
+
+    if ([typeSet containsObject:event.type])
+    {
+        NSMutableArray<MXEvent*> *events = [self eventsInThread:event.threadId create:YES];
+        NSUInteger index = [self indexOfFirstEventAfterPosition:position.integerValue inEvents:events];
+        [events insertObject:event atIndex:index];
+    }
+}
+
+- (NSNumber*)positionOfEventWithEventId:(NSString*)eventId
+{
+    return positionsByEventIds[eventId];
+}
+
+- (MXEvent*)lastEventInThread:(NSString*)threadId atOrBeforePosition:(NSInteger)position
+{
+    NSMutableArray<MXEvent*> *events = [self eventsInThread:threadId create:NO];
+    NSUInteger index = [self indexOfFirstEventAfterPosition:position inEvents:events];
+    return index ? events[index - 1] : nil;
+}
+
+- (MXEvent*)lastEventInThread:(NSString*)threadId sentAtOrBefore:(uint64_t)ts afterPosition:(NSInteger)position
+{
+    NSMutableArray<MXEvent*> *events = [self eventsInThread:threadId create:NO];
+
+    NSUInteger index = events.count;
+    while (index--)
+    {
+        MXEvent *event = events[index];
+        if (positionsByEventIds[event.eventId].integerValue <= position)
+        {
+            break;
+        }
+
+        if (event.originServerTs <= ts)
+        {
+            return event;
+        }
+    }
+    return nil;
+}
+
+
+#pragma mark - Private
+
+- (NSMutableArray<MXEvent*>*)eventsInThread:(NSString*)threadId create:(BOOL)create
+{
+    NSString *key = threadId ?: kMXMemoryRoomThreadedEventsIndexMainThread;
+
+    NSMutableArray<MXEvent*> *events = eventsByThread[key];
+    if (!events && create)
+    {
+        events = [NSMutableArray array];
+        eventsByThread[key] = events;
+    }
+    return events;
+}
+
+/**
+ Binary search of the first event positioned after `position`.
+
+ @return its index in `events`. `events.count` if there is none.
+ */
+- (NSUInteger)indexOfFirstEventAfterPosition:(NSInteger)position inEvents:(NSArray<MXEvent*>*)events
+{
+    NSUInteger low = 0, high = events.count;
+    while (low < high)
+    {
+        NSUInteger middle = low + (high - low) / 2;
+        if (positionsByEventIds[events[middle].eventId].integerValue <= position)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+@end
@@ -178,6 +178,12 @@
     return [roomStore enumeratorForMessagesWithTypeIn:types];
 }
 
+- (MXEvent *)eventToAcknowledge:(MXEvent *)event afterReceipt:(NSString *)receiptEventId inRoom:(NSString *)roomId withTypeIn:(NSArray<MXEventTypeString> *)types
+{
+    MXMemoryRoomStore *roomStore = [self getOrCreateRoomStore:roomId];
+    return [roomStore eventToAcknowledge:event afterReceipt:receiptEventId withTypeIn:types];
+}
+
 - (void)storePartialAttributedTextMessageForRoom:(NSString *)roomId partialAttributedTextMessage:(NSAttributedString *)partialAttributedTextMessage
 {
     MXMemoryRoomStore *roomStore = [self getOrCreateRoomStore:roomId];
@@ -508,6 +514,12 @@
     return roomStore.outgoingMessages;
 }
 
+- (MXEvent *)outgoingMessageWithEventId:(NSString *)eventId inRoom:(NSString *)roomId
+{
+    MXMemoryRoomOutgoingMessagesStore *roomStore = [self getOrCreateRoomOutgoingMessagesStore:roomId];
+    return [roomStore outgoingMessageWithEventId:eventId];
+}
+
 
 #pragma mark - Matrix filters
 - (void)storeFilter:(nonnull MXFilterJSONModel*)filter withFilterId:(nonnull NSString*)filterId
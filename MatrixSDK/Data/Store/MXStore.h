@@ -463,6 +463,32 @@
 
 @optional
 
+/**
+ Get an outgoing message pending in a room.
+
+ @param eventId the id of the message.
+ @param roomId the id of the room.
+ @return the message. nil if not found.
+ */
+- (MXEvent* _Nullable)outgoingMessageWithEventId:(nonnull NSString*)eventId inRoom:(nonnull NSString*)roomId;
+
+/**
+ Find the event to acknowledge with a read receipt when the user has read an event.
+
+ Stores implement it to avoid enumerating room messages on each read receipt update.
+
+ @param event the event read by the user.
+ @param receiptEventId the event id of the current read receipt in the thread of `event`, if any.
+ @param roomId the id of the room.
+ @param types the acknowledgeable event types.
+ @return the last event of `types` in the thread of `event`, at or before it.
+         nil if there is none after the current read receipt.
+ */
+- (MXEvent* _Nullable)eventToAcknowledge:(nonnull MXEvent*)event
+                            afterReceipt:(nullable NSString*)receiptEventId
+                                  inRoom:(nonnull NSString*)roomId
+                              withTypeIn:(nonnull NSArray<MXEventTypeString>*)types;
+
 /**
  Save changes in the store.
  
@@ -480,6 +506,12 @@
  */
 - (void)commitWithCompletion:(void (^_Nullable)(void))completion;
 
+/**
+ YES if changes on outgoing messages are persisted as soon as they are made,
+ without waiting for a `commit`.
+ */
+@property (nonatomic, readonly) BOOL persistsOutgoingMessagesImmediately;
+
 /**
  Close the store.
  
@@ -487,6 +519,15 @@
  */
 - (void)close;
 
+/**
+ Get the matrix users that are currently loaded in memory.
+
+ Stores that load users on demand implement it to avoid loading all of them.
+
+ @return an array of MXUser.
+ */
+- (NSArray<MXUser*>* _Nullable)residentUsers;
+
 
 #pragma mark - Media repository
 
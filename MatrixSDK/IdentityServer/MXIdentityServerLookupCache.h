@@ -0,0 +1,168 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "MXIdentityServerHashDetails.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ `MXIdentityServerLookupCache` keeps what the v2 lookup API computed and returned:
+
+ - the hashed addresses of 3rd party ids for the current pepper,
+ - the lookup results by hashed address, for a limited time,
+ - the 3rd party ids that have already been looked up, whatever the pepper.
+
+ Emails are compared and hashed in lower case.
+
+ Hashes and results are dropped when the pepper or the hash algorithm changes.
+
+ The cache can be persisted in a file, one per user and identity server. The file
+ contains no plain 3rd party id:
+ - lookup results are written only for the sha256 algorithm, with the pepper.
+   They are reused only if the identity server still announces the same pepper.
+ - the 3rd party ids already looked up are written as salted hashes.
+ Hashed addresses are computed again after a restart. The file is protected until
+ the first unlock of the device.
+
+ This class is thread safe.
+ */
+@interface MXIdentityServerLookupCache : NSObject
+
+/**
+ Create a cache kept in memory.
+
+ @param resultLifetime the time during which a lookup result can be reused, in seconds.
+ @return a `MXIdentityServerLookupCache` instance.
+ */
+- (instancetype)initWithResultLifetime:(NSTimeInterval)resultLifetime;
+
+/**
+ Create a cache persisted in a file.
+
+ The file is read on first use and written in background after each change.
+
+ @param fileURL the file of the cache. Nil to keep the cache in memory.
+ @param resultLifetime the time during which a lookup result can be reused, in seconds.
+ @return a `MXIdentityServerLookupCache` instance.
+ */
+- (instancetype)initWithFileURL:(nullable NSURL*)fileURL resultLifetime:(NSTimeInterval)resultLifetime NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ The file of the cache. Nil if the cache is kept in memory.
+ */
+@property (nonatomic, readonly, nullable) NSURL *fileURL;
+
+/**
+ The time during which a lookup result can be reused, in seconds.
+ */
+@property (nonatomic, readonly) NSTimeInterval resultLifetime;
+
+/**
+ The pepper the cached hashes and results have been computed with.
+ */
+@property (nonatomic, readonly, nullable) NSString *pepper;
+
+/**
+ Set the hash parameters announced by the identity server.
+
+ Cached hashes and results are dropped if they change.
+
+ @param pepper the pepper.
+ @param algorithm the hash algorithm.
+ */
+- (void)setPepper:(NSString*)pepper algorithm:(MXIdentityServerHashAlgorithm)algorithm;
+
+/**
+ Hash 3rd party ids with the current pepper and algorithm.
+
+ Only the 3rd party ids that are not in the cache are hashed. They are hashed
+ concurrently, on all cores.
+
+ @param threepids the list of 3rd party ids: [[<(MX3PIDMedium)media1>, <(NSString*)address1>], ...].
+                  They must have been filtered with `validThreepids:`.
+ @return the hashed addresses, in the order of `threepids`. Empty if no supported
+         hash parameters have been set.
+ */
+- (NSArray<NSString*>*)hashedAddressesForThreepids:(NSArray<NSArray<NSString*>*>*)threepids;
+
+/**
+ Get a lookup result that has not expired.
+
+ @param hashedAddress the hashed address.
+ @return the Matrix id of the user, `NSNull` if the address is known to be unbound, nil if there is no valid result.
+ */
+- (nullable id)lookupResultForHashedAddress:(NSString*)hashedAddress;
+
+/**
+ Store lookup results.
+
+ @param mappings the Matrix ids by hashed address returned by the identity server.
+ @param hashedAddresses all hashed addresses that have been looked up. Those not in
+                        `mappings` are stored as unbound.
+ */
+- (void)storeLookupResults:(NSDictionary<NSString*, NSString*>*)mappings forHashedAddresses:(NSArray<NSString*>*)hashedAddresses;
+
+/**
+ Filter out 3rd party ids that have already been looked up.
+
+ @param threepids valid 3rd party ids.
+ @return the 3rd party ids never looked up before.
+ */
+- (NSArray<NSArray<NSString*>*>*)unseenThreepids:(NSArray<NSArray<NSString*>*>*)threepids;
+
+/**
+ Mark 3rd party ids as looked up.
+
+ @param threepids valid 3rd party ids.
+ */
+- (void)markThreepidsAsSeen:(NSArray<NSArray<NSString*>*>*)threepids;
+
+/**
+ Empty the cache and delete its file.
+ */
+- (void)reset;
+
+/**
+ Remove invalid entries from a list of 3rd party ids.
+
+ @param threepids the list of 3rd party ids: [[<(MX3PIDMedium)media1>, <(NSString*)address1>], ...].
+ @return the 3rd party ids made of a medium and an address.
+ */
++ (NSArray<NSArray<NSString*>*>*)validThreepids:(NSArray*)threepids;
+
+/**
+ The file where to persist the cache of a user for an identity server.
+
+ @param userId the Matrix id of the user.
+ @param identityServer the identity server URL.
+ @return a file URL in the caches directory of the application.
+ */
++ (nullable NSURL*)fileURLForUser:(NSString*)userId identityServer:(NSString*)identityServer;
+
+/**
+ Delete the cache files of a user, for all identity servers.
+
+ @param userId the Matrix id of the user.
+ */
++ (void)deleteFilesOfUser:(NSString*)userId;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,597 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXIdentityServerLookupCache.h"
+
+#import <Security/Security.h>
+
+#import "MXIdentityServerRestClient.h"
+#import "MXJSONModels.h"
+#import "MXLog.h"
+#import "NSData+MatrixSDK.h"
+
+// Number of 3rd party ids hashed by one iteration of the concurrent hashing
+static NSUInteger const kMXIdentityServerLookupCacheHashStride = 64;
+
+// Folder of the cache files, in the caches directory
+static NSString *const kMXIdentityServerLookupCacheFolder = @"MXIdentityServerLookupCache";
+
+// Keys of the cache file
+static NSString *const kMXIdentityServerLookupCacheFilePepperKey = @"pepper";
+static NSString *const kMXIdentityServerLookupCacheFileAlgorithmKey = @"algorithm";
+static NSString *const kMXIdentityServerLookupCacheFileResultsKey = @"results";
+static NSString *const kMXIdentityServerLookupCacheFileSeenSaltKey = @"seenSalt";
+static NSString *const kMXIdentityServerLookupCacheFileSeenThreepidsKey = @"seenThreepids";
+
+// Number of random bytes of the salt of seen 3rd party ids hashes
+static NSUInteger const kMXIdentityServerLookupCacheSeenSaltLength = 32;
+
+
+#pragma mark - MXIdentityServerLookupResult
+
+@interface MXIdentityServerLookupResult : NSObject
+
+// The Matrix id or NSNull
+@property (nonatomic) id userId;
+@property (nonatomic) NSTimeInterval expirationTime;
+
+@end
+
+@implementation MXIdentityServerLookupResult
+@end
+
+
+#pragma mark - MXIdentityServerLookupCache
+
+@interface MXIdentityServerLookupCache ()
+{
+    MXIdentityServerHashAlgorithm algorithm;
+
+    // Hashed addresses by "<address> <medium>"
+    NSMutableDictionary<NSString*, NSString*> *hashedAddresses;
+
+    // Lookup results by hashed address
+    NSMutableDictionary<NSString*, MXIdentityServerLookupResult*> *results;
+
+    // Salted hashes of the 3rd party ids already looked up. The plain 3rd party ids are never kept
+    NSMutableSet<NSString*> *seenThreepids;
+
+    // Random salt of the hashes in `seenThreepids`
+    NSString *seenSalt;
+
+    // YES once the file has been read
+    BOOL loaded;
+
+    // YES while a write of the file is pending
+    BOOL saveScheduled;
+}
+@end
+
+@implementation MXIdentityServerLookupCache
+
+- (instancetype)initWithResultLifetime:(NSTimeInterval)resultLifetime
+{
+    return [self initWithFileURL:nil resultLifetime:resultLifetime];
+}
+
+- (instancetype)initWithFileURL:(NSURL *)fileURL resultLifetime:(NSTimeInterval)resultLifetime
+{
+    self = [super init];
+    if (self)
+    {
+        _fileURL = fileURL;
+        _resultLifetime = resultLifetime;
+        loaded = (fileURL == nil);
+        algorithm = MXIdentityServerHashAlgorithmUnknown;
+        hashedAddresses = [NSMutableDictionary dictionary];
+        results = [NSMutableDictionary dictionary];
+        seenThreepids = [NSMutableSet set];
+        seenSalt = [MXIdentityServerLookupCache newSeenSalt];
+    }
+    return self;
+}
+
+- (NSString *)pepper
+{
+    [self loadIfNeeded];
+
+    @synchronized (self)
+    {
+        return _pepper;
+    }
+}
+
+- (void)setPepper:(NSString *)pepper algorithm:(MXIdentityServerHashAlgorithm)newAlgorithm
+{
+    [self loadIfNeeded];
+
+    @synchronized (self)
+    {
+        if (newAlgorithm == algorithm && [pepper isEqualToString:_pepper])
+        {
+            return;
+        }
+
+        _pepper = pepper;
+        algorithm = newAlgorithm;
+        [hashedAddresses removeAllObjects];
+        [results removeAllObjects];
+        [self scheduleSave];
+    }
+}
+
+- (NSArray<NSString *> *)hashedAddressesForThreepids:(NSArray<NSArray<NSString *> *> *)threepids
+{
+    [self loadIfNeeded];
+
+    NSMutableArray<NSString*> *keys = [NSMutableArray arrayWithCapacity:threepids.count];
+    for (NSArray<NSString*> *threepid in threepids)
+    {
+        [keys addObject:[self keyForThreepid:threepid]];
+    }
+
+    NSString *pepper;
+    MXIdentityServerHashAlgorithm hashAlgorithm;
+    NSMutableArray<NSArray<NSString*>*> *missingThreepids = [NSMutableArray array];
+    NSMutableArray<NSString*> *missingKeys = [NSMutableArray array];
+    @synchronized (self)
+    {
+        pepper = _pepper;
+        hashAlgorithm = algorithm;
+        if (!pepper || hashAlgorithm == MXIdentityServerHashAlgorithmUnknown)
+        {
+            return @[];
+        }
+
+        for (NSUInteger index = 0; index < threepids.count; index++)
+        {
+            if (!hashedAddresses[keys[index]])
+            {
+                [missingThreepids addObject:threepids[index]];
+                [missingKeys addObject:keys[index]];
+            }
+        }
+    }
+
+    NSMutableDictionary<NSString*, NSString*> *newHashedAddresses = [NSMutableDictionary dictionaryWithCapacity:missingThreepids.count];
+    if (missingThreepids.count)
+    {
+        // Hash outside the lock, in strides so that each core gets a meaningful amount of work
+        NSUInteger strideCount = (missingThreepids.count + kMXIdentityServerLookupCacheHashStride - 1) / kMXIdentityServerLookupCacheHashStride;
+
+        dispatch_apply(strideCount, DISPATCH_APPLY_AUTO, ^(size_t stride) {
+            NSUInteger start = stride * kMXIdentityServerLookupCacheHashStride;
+            NSUInteger end = MIN(start + kMXIdentityServerLookupCacheHashStride, missingThreepids.count);
+
+            NSMutableDictionary<NSString*, NSString*> *strideHashedAddresses = [NSMutableDictionary dictionaryWithCapacity:end - start];
+            for (NSUInteger index = start; index < end; index++)
+            {
+                NSArray<NSString*> *threepid = missingThreepids[index];
+                NSString *hashedAddress = [MXIdentityServerRestClient hashedAddressForThreepid:[self addressOfThreepid:threepid]
+                                                                                        medium:threepid[0]
+                                                                                     algorithm:hashAlgorithm
+                                                                                        pepper:pepper];
+                if (hashedAddress)
+                {
+                    strideHashedAddresses[missingKeys[index]] = hashedAddress;
+                }
+            }
+
+            @synchronized (newHashedAddresses)
+            {
+                [newHashedAddresses addEntriesFromDictionary:strideHashedAddresses];
+            }
+        });
+    }
+
+    NSMutableArray<NSString*> *hashes = [NSMutableArray arrayWithCapacity:threepids.count];
+    @synchronized (self)
+    {
+        // Do not pollute the cache if the pepper changed in the meantime
+        if (newHashedAddresses.count && hashAlgorithm == algorithm && [pepper isEqualToString:_pepper])
+        {
+            [hashedAddresses addEntriesFromDictionary:newHashedAddresses];
+        }
+
+        for (NSString *key in keys)
+        {
+            NSString *hashedAddress = newHashedAddresses[key] ?: hashedAddresses[key];
+            if (hashedAddress)
+            {
+                [hashes addObject:hashedAddress];
+            }
+        }
+    }
+    return hashes;
+}
+
+- (id)lookupResultForHashedAddress:(NSString *)hashedAddress
+{
+    [self loadIfNeeded];
+
+    @synchronized (self)
+    {
+        MXIdentityServerLookupResult *result = results[hashedAddress];
+        if (!result)
+        {
+            return nil;
+        }
+
+        if (result.expirationTime < [NSDate date].timeIntervalSince1970)
+        {
+            [results removeObjectForKey:hashedAddress];
+            return nil;
+        }
+
+        return result.userId;
+    }
+}
+
+- (void)storeLookupResults:(NSDictionary<NSString *,NSString *> *)mappings forHashedAddresses:(NSArray<NSString *> *)lookedUpHashedAddresses
+{
+    [self loadIfNeeded];
+
+    NSTimeInterval expirationTime = [NSDate date].timeIntervalSince1970 + _resultLifetime;
+
+    @synchronized (self)
+    {
+        for (NSString *hashedAddress in lookedUpHashedAddresses)
+        {
+            MXIdentityServerLookupResult *result = [MXIdentityServerLookupResult new];
+            result.userId = mappings[hashedAddress] ?: [NSNull null];
+            result.expirationTime = expirationTime;
+            results[hashedAddress] = result;
+        }
+
+        if (lookedUpHashedAddresses.count)
+        {
+            [self scheduleSave];
+        }
+    }
+}
+
+- (NSArray<NSArray<NSString *> *> *)unseenThreepids:(NSArray<NSArray<NSString *> *> *)threepids
+{
+    [self loadIfNeeded];
+
+    NSMutableArray<NSArray<NSString*>*> *unseenThreepids = [NSMutableArray array];
+    @synchronized (self)
+    {
+        for (NSArray<NSString*> *threepid in threepids)
+        {
+            if (![seenThreepids containsObject:[self seenHashForThreepid:threepid]])
+            {
+                [unseenThreepids addObject:threepid];
+            }
+        }
+    }
+    return unseenThreepids;
+}
+
+- (void)markThreepidsAsSeen:(NSArray<NSArray<NSString *> *> *)threepids
+{
+    [self loadIfNeeded];
+
+    @synchronized (self)
+    {
+        for (NSArray<NSString*> *threepid in threepids)
+        {
+            [seenThreepids addObject:[self seenHashForThreepid:threepid]];
+        }
+
+        if (threepids.count)
+        {
+            [self scheduleSave];
+        }
+    }
+}
+
+- (void)reset
+{
+    @synchronized (self)
+    {
+        // There is nothing to read anymore
+        loaded = YES;
+
+        _pepper = nil;
+        algorithm = MXIdentityServerHashAlgorithmUnknown;
+        [hashedAddresses removeAllObjects];
+        [results removeAllObjects];
+        [seenThreepids removeAllObjects];
+        seenSalt = [MXIdentityServerLookupCache newSeenSalt];
+    }
+
+    NSURL *fileURL = _fileURL;
+    if (fileURL)
+    {
+        dispatch_async([MXIdentityServerLookupCache fileQueue], ^{
+            [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+        });
+    }
+}
+
++ (NSArray<NSArray<NSString *> *> *)validThreepids:(NSArray *)threepids
+{
+    NSMutableArray<NSArray<NSString*>*> *validThreepids = [NSMutableArray arrayWithCapacity:threepids.count];
+    for (NSArray<NSString*> *threepid in threepids)
+    {
+        if ([threepid isKindOfClass:NSArray.class] && threepid.count >= 2)
+        {
+            [validThreepids addObject:threepid];
+        }
+    }
+    return validThreepids;
+}
+
++ (NSURL *)fileURLForUser:(NSString *)userId identityServer:(NSString *)identityServer
+{
+    NSURL *userFolderURL = [self folderURLForUser:userId];
+    NSData *identityServerData = [identityServer dataUsingEncoding:NSUTF8StringEncoding];
+    if (!userFolderURL || !identityServerData)
+    {
+        return nil;
+    }
+
+    // Identity server URLs are not valid file names
+    NSString *fileName = [identityServerData.mx_SHA256 stringByAppendingPathExtension:@"plist"];
+    return [userFolderURL URLByAppendingPathComponent:fileName];
+}
+
++ (void)deleteFilesOfUser:(NSString *)userId
+{
+    NSURL *userFolderURL = [self folderURLForUser:userId];
+    if (userFolderURL)
+    {
+        // After the pending writes
+        dispatch_async([MXIdentityServerLookupCache fileQueue], ^{
+            [[NSFileManager defaultManager] removeItemAtURL:userFolderURL error:nil];
+        });
+    }
+}
+
+#pragma mark - File
+
++ (NSURL*)folderURLForUser:(NSString*)userId
+{
+    NSURL *cachesDirectoryURL = [[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask].firstObject;
+    NSData *userIdData = [userId dataUsingEncoding:NSUTF8StringEncoding];
+    if (!cachesDirectoryURL || !userIdData)
+    {
+        return nil;
+    }
+
+    return [[cachesDirectoryURL URLByAppendingPathComponent:kMXIdentityServerLookupCacheFolder isDirectory:YES] URLByAppendingPathComponent:userIdData.mx_SHA256 isDirectory:YES];
+}
+
+/**
+ The queue where all cache files are read and written.
+
+ It is shared so that a cache reads a file after the pending writes of another cache.
+ */
++ (dispatch_queue_t)fileQueue
+{
+    static dispatch_queue_t fileQueue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        fileQueue = dispatch_queue_create("MXIdentityServerLookupCache", DISPATCH_QUEUE_SERIAL);
+    });
+    return fileQueue;
+}
+
+- (void)loadIfNeeded
+{
+    @synchronized (self)
+    {
+        if (loaded)
+        {
+            return;
+        }
+    }
+
+    // Read outside the lock. A pending write takes it
+    __block NSDictionary *content;
+    dispatch_sync([MXIdentityServerLookupCache fileQueue], ^{
+        NSData *data = [NSData dataWithContentsOfURL:self.fileURL];
+        if (data)
+        {
+            content = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:nil error:nil];
+        }
+    });
+
+    @synchronized (self)
+    {
+        if (loaded)
+        {
+            return;
+        }
+        loaded = YES;
+
+        if ([content isKindOfClass:NSDictionary.class])
+        {
+            [self restoreFromFileContent:content];
+        }
+    }
+}
+
+- (void)restoreFromFileContent:(NSDictionary*)content
+{
+    NSString *fileSeenSalt = content[kMXIdentityServerLookupCacheFileSeenSaltKey];
+    NSArray *fileSeenThreepids = content[kMXIdentityServerLookupCacheFileSeenThreepidsKey];
+    if ([fileSeenSalt isKindOfClass:NSString.class] && [fileSeenThreepids isKindOfClass:NSArray.class])
+    {
+        // Nothing has been marked as seen before the file is read
+        seenSalt = fileSeenSalt;
+        [seenThreepids addObjectsFromArray:fileSeenThreepids];
+    }
+
+    NSString *filePepper = content[kMXIdentityServerLookupCacheFilePepperKey];
+    NSString *fileAlgorithm = content[kMXIdentityServerLookupCacheFileAlgorithmKey];
+    if (![filePepper isKindOfClass:NSString.class] || ![fileAlgorithm isKindOfClass:NSString.class])
+    {
+        return;
+    }
+
+    MXIdentityServerHashAlgorithm fileHashAlgorithm = [MXIdentityServerHashDetails hashAlgorithmFromString:fileAlgorithm];
+    if (_pepper)
+    {
+        // Hash parameters have already been set. Keep the file data only if they match
+        if (fileHashAlgorithm != algorithm || ![filePepper isEqualToString:_pepper])
+        {
+            return;
+        }
+    }
+    else
+    {
+        _pepper = filePepper;
+        algorithm = fileHashAlgorithm;
+    }
+
+    // Results are stored as [<Matrix id or empty string if unbound>, <expiration time>]
+    NSDictionary<NSString*, NSArray*> *fileResults = content[kMXIdentityServerLookupCacheFileResultsKey];
+    if ([fileResults isKindOfClass:NSDictionary.class])
+    {
+        NSTimeInterval now = [NSDate date].timeIntervalSince1970;
+        [fileResults enumerateKeysAndObjectsUsingBlock:^(NSString *hashedAddress, NSArray *fileResult, BOOL *stop) {
+            if (self->results[hashedAddress] || ![fileResult isKindOfClass:NSArray.class] || fileResult.count < 2)
+            {
+                return;
+            }
+
+            NSString *userId = fileResult[0];
+            NSTimeInterval expirationTime = [fileResult[1] doubleValue];
+            if (expirationTime < now)
+            {
+                return;
+            }
+
+            MXIdentityServerLookupResult *result = [MXIdentityServerLookupResult new];
+            result.userId = userId.length ? userId : [NSNull null];
+            result.expirationTime = expirationTime;
+            self->results[hashedAddress] = result;
+        }];
+    }
+}
+
+/**
+ Write the cache file in background.
+
+ Must be called with the lock held. Writes requested before the previous one started are coalesced.
+ */
+- (void)scheduleSave
+{
+    if (!_fileURL || saveScheduled)
+    {
+        return;
+    }
+    saveScheduled = YES;
+
+    dispatch_async([MXIdentityServerLookupCache fileQueue], ^{
+        NSDictionary *content;
+        @synchronized (self)
+        {
+            self->saveScheduled = NO;
+            content = [self fileContent];
+        }
+
+        NSError *error;
+        NSData *data = [NSPropertyListSerialization dataWithPropertyList:content format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+        if (data)
+        {
+            NSDataWritingOptions options = NSDataWritingAtomic;
+#if TARGET_OS_IPHONE
+            options |= NSDataWritingFileProtectionCompleteUntilFirstUserAuthentication;
+#endif
+            [[NSFileManager defaultManager] createDirectoryAtURL:self.fileURL.URLByDeletingLastPathComponent withIntermediateDirectories:YES attributes:nil error:nil];
+            [data writeToURL:self.fileURL options:options error:&error];
+        }
+
+        if (error)
+        {
+            MXLogDebug(@"[MXIdentityServerLookupCache] scheduleSave: Cannot write the cache. Error: %@", error);
+        }
+    });
+}
+
+/**
+ The content of the cache file. Must be called with the lock held.
+
+ It contains no plain 3rd party id: hashed addresses are recomputed after a restart, and
+ results are written only if their keys are real hashes.
+ */
+- (NSDictionary*)fileContent
+{
+    NSMutableDictionary *content = [NSMutableDictionary dictionary];
+    content[kMXIdentityServerLookupCacheFileSeenSaltKey] = seenSalt;
+    content[kMXIdentityServerLookupCacheFileSeenThreepidsKey] = seenThreepids.allObjects;
+
+    if (_pepper && algorithm == MXIdentityServerHashAlgorithmSHA256)
+    {
+        content[kMXIdentityServerLookupCacheFilePepperKey] = _pepper;
+        content[kMXIdentityServerLookupCacheFileAlgorithmKey] = [MXIdentityServerHashDetails stringValueForHashAlgorithm:algorithm];
+
+        NSTimeInterval now = [NSDate date].timeIntervalSince1970;
+        NSMutableDictionary<NSString*, NSArray*> *fileResults = [NSMutableDictionary dictionaryWithCapacity:results.count];
+        [results enumerateKeysAndObjectsUsingBlock:^(NSString *hashedAddress, MXIdentityServerLookupResult *result, BOOL *stop) {
+            if (result.expirationTime >= now)
+            {
+                NSString *userId = [result.userId isKindOfClass:NSString.class] ? result.userId : @"";
+                fileResults[hashedAddress] = @[userId, @(result.expirationTime)];
+            }
+        }];
+        content[kMXIdentityServerLookupCacheFileResultsKey] = fileResults;
+    }
+
+    return content;
+}
+
+#pragma mark - Private
+
+- (NSString*)addressOfThreepid:(NSArray<NSString*>*)threepid
+{
+    if ([threepid[0] isEqualToString:kMX3PIDMediumEmail])
+    {
+        // Email should be lower case
+        return threepid[1].lowercaseString;
+    }
+    return threepid[1];
+}
+
+- (NSString*)keyForThreepid:(NSArray<NSString*>*)threepid
+{
+    return [NSString stringWithFormat:@"%@ %@", [self addressOfThreepid:threepid], threepid[0]];
+}
+
+/**
+ The salted hash that marks a 3rd party id as seen. Must be called with the lock held.
+ */
+- (NSString*)seenHashForThreepid:(NSArray<NSString*>*)threepid
+{
+    NSString *saltedKey = [NSString stringWithFormat:@"%@ %@", seenSalt, [self keyForThreepid:threepid]];
+    return [saltedKey dataUsingEncoding:NSUTF8StringEncoding].mx_SHA256;
+}
+
++ (NSString*)newSeenSalt
+{
+    NSMutableData *salt = [NSMutableData dataWithLength:kMXIdentityServerLookupCacheSeenSaltLength];
+    if (SecRandomCopyBytes(kSecRandomDefault, salt.length, salt.mutableBytes) != errSecSuccess)
+    {
+        // Still better than no salt
+        return [NSUUID UUID].UUIDString;
+    }
+    return [salt base64EncodedStringWithOptions:0];
+}
+
+@end
@@ -194,6 +194,38 @@ NS_ERROR_ENUM(MXIdentityServerRestClientErrorDomain)
                         success:(void (^)(NSArray *discoveredUsers))success
                         failure:(void (^)(NSError *error))failure;
 
+/**
+ Look up addresses that have already been hashed (v2 API).
+
+ @param hashedAddresses the addresses hashed with `hashedAddressForThreepid:medium:algorithm:pepper:`.
+ @param algorithm Three pids hash algorithm retrieved from "/hash_details" endpoint.
+ @param pepper Three pids hash pepper retrieved from "/hash_details" endpoint.
+ @param success A block object called when the operation succeeds. It provides the Matrix ids
+                of the discovered users by hashed address. Unknown addresses are not part of it.
+ @param failure A block object called when the operation fails.
+
+ @return a MXHTTPOperation instance.
+ */
+- (MXHTTPOperation*)lookupHashedAddresses:(NSArray<NSString*> *)hashedAddresses
+                                algorithm:(MXIdentityServerHashAlgorithm)algorithm
+                                   pepper:(NSString*)pepper
+                                  success:(void (^)(NSDictionary<NSString*, NSString*> *mappings))success
+                                  failure:(void (^)(NSError *error))failure;
+
+/**
+ Hash a 3rd party id for the v2 lookup API.
+
+ @param address the 3rd party id. Emails must already be lower case.
+ @param medium the medium of the 3rd party id.
+ @param algorithm the hash algorithm.
+ @param pepper the pepper retrieved from "/hash_details" endpoint.
+ @return the hashed address. nil if the algorithm is not supported.
+ */
++ (nullable NSString*)hashedAddressForThreepid:(NSString*)address
+                                        medium:(NSString*)medium
+                                     algorithm:(MXIdentityServerHashAlgorithm)algorithm
+                                        pepper:(NSString*)pepper;
+
 #pragma mark Establishing associations
 
 /**
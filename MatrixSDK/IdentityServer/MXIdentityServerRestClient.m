@@ -378,28 +378,15 @@ NSString *const MXIdentityServerRestClientErrorDomain = @"org.matrix.sdk.MXIdent
                 threepid = threepid.lowercaseString;
             }
             
-            NSString *hashedTreePid;
+            NSString *hashedTreePid = [MXIdentityServerRestClient hashedAddressForThreepid:threepid medium:medium algorithm:algorithm pepper:pepper];
+            if (!hashedTreePid)
+            {
+                continue;
+            }
             
-            switch (algorithm)
+            if (algorithm == MXIdentityServerHashAlgorithmSHA256)
             {
-                case MXIdentityServerHashAlgorithmNone:
-                    hashedTreePid = [NSString stringWithFormat:@"%@ %@", threepid, medium];
-                    break;
-                case MXIdentityServerHashAlgorithmSHA256:
-                {
-                    NSString *threePidConcatenation = [NSString stringWithFormat:@"%@ %@ %@", threepid, medium, pepper];
-
-                    // Hash the concatenated string using the helper method
-                    NSString *hashedSha256ThreePid = sha256(threePidConcatenation);
-
-                    // Convert hashed SHA-256 string to base64 URL
-                    hashedTreePid = [MXBase64Tools base64ToBase64Url:hashedSha256ThreePid];
-                    
-                    threePidArrayByThreePidConcatHash[hashedTreePid] = threepidArray;
-                }
-                    break;
-                default:
-                    break;
+                threePidArrayByThreePidConcatHash[hashedTreePid] = threepidArray;
             }
             
             [hashedThreePids addObject:hashedTreePid];
@@ -485,6 +472,60 @@ NSString *const MXIdentityServerRestClientErrorDomain = @"org.matrix.sdk.MXIdent
     
 }
 
+- (MXHTTPOperation*)lookupHashedAddresses:(NSArray<NSString*> *)hashedAddresses
+                                algorithm:(MXIdentityServerHashAlgorithm)algorithm
+                                   pepper:(NSString*)pepper
+                                  success:(void (^)(NSDictionary<NSString*, NSString*> *mappings))success
+                                  failure:(void (^)(NSError *error))failure
+{
+    NSString *algorithmStringValue = [MXIdentityServerHashDetails stringValueForHashAlgorithm:algorithm];
+    if (algorithm == MXIdentityServerHashAlgorithmUnknown || !algorithmStringValue)
+    {
+        NSError *error = [NSError errorWithDomain:MXIdentityServerRestClientErrorDomain code:MXIdentityServerRestClientErrorUnsupportedHashAlgorithm userInfo:nil];
+        failure(error);
+        return nil;
+    }
+    
+    NSString *path = [self buildAPIPathWithAPIPathPrefix:kMXIdentityAPIPrefixPathV2 andPath:@"lookup"];
+    
+    if (!path)
+    {
+        NSError *error = [NSError errorWithDomain:MXIdentityServerRestClientErrorDomain code:MXIdentityServerRestClientErrorMissingAPIPrefix userInfo:nil];
+        failure(error);
+        return nil;
+    }
+    
+    NSDictionary *jsonDictionary = @{
+                                     @"addresses": hashedAddresses,
+                                     @"algorithm": algorithmStringValue,
+                                     @"pepper": pepper,
+                                     };
+    
+    NSData *payloadData = [NSJSONSerialization dataWithJSONObject:jsonDictionary options:0 error:nil];
+    
+    return [self.httpClient requestWithMethod:@"POST"
+                                         path:path
+                                   parameters:nil
+                          needsAuthentication:YES
+                                         data:payloadData
+                                      headers:@{@"Content-Type": @"application/json"}
+                                      timeout:-1
+                               uploadProgress:nil
+                                      success:^(NSDictionary *JSONResponse) {
+                                          if (success)
+                                          {
+                                              __block NSDictionary<NSString*, NSString*> *mappings;
+                                              [self dispatchProcessing:^{
+                                                  MXJSONModelSetDictionary(mappings, JSONResponse[@"mappings"]);
+                                              } andCompletion:^{
+                                                  success(mappings ?: @{});
+                                              }];
+                                          }
+                                      } failure:^(NSError *error) {
+                                          [self dispatchFailure:error inBlock:failure];
+                                      }];
+}
+
 // Helper method to perform SHA256 hashing
 NSString *sha256(NSString *input) {
     const char *str = [input UTF8String];
@@ -499,6 +540,30 @@ NSString *sha256(NSString *input) {
     return hash;
 }
 
++ (NSString *)hashedAddressForThreepid:(NSString *)address
+                                medium:(NSString *)medium
+                             algorithm:(MXIdentityServerHashAlgorithm)algorithm
+                                pepper:(NSString *)pepper
+{
+    switch (algorithm)
+    {
+        case MXIdentityServerHashAlgorithmNone:
+            return [NSString stringWithFormat:@"%@ %@", address, medium];
+        case MXIdentityServerHashAlgorithmSHA256:
+        {
+            NSString *threePidConcatenation = [NSString stringWithFormat:@"%@ %@ %@", address, medium, pepper];
+            
+            // Hash the concatenated string using the helper method
+            NSString *hashedSha256ThreePid = sha256(threePidConcatenation);
+            
+            // Convert hashed SHA-256 string to base64 URL
+            return [MXBase64Tools base64ToBase64Url:hashedSha256ThreePid];
+        }
+        default:
+            return nil;
+    }
+}
+
 #pragma mark Establishing associations
 
 - (MXHTTPOperation*)requestEmailValidation:(NSString*)email
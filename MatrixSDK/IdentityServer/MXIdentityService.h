@@ -128,6 +128,9 @@ extern NSString *const MXIdentityServiceNotificationAccessTokenKey;
 /**
  Retrieve user matrix ids from a list of 3rd party ids.
  
+ Addresses are hashed concurrently and the hashes are cached for the current pepper of the
+ identity server. Results are reused for a limited time. Big lists are looked up by chunks.
+ 
  @param threepids the list of 3rd party ids: [[<(MX3PIDMedium)media1>, <(NSString*)address1>], [<(MX3PIDMedium)media2>, <(NSString*)address2>], ...].
  @param success A block object called when the operation succeeds. It provides the array of the discovered users returned by the identity server.
  [[<(MX3PIDMedium)media>, <(NSString*)address>, <(NSString*)userId>], ...].
@@ -139,6 +142,32 @@ extern NSString *const MXIdentityServiceNotificationAccessTokenKey;
                         success:(void (^)(NSArray *discoveredUsers))success
                         failure:(void (^)(NSError *error))failure NS_REFINED_FOR_SWIFT;
 
+/**
+ Retrieve user matrix ids from the 3rd party ids that have not been looked up before
+ with this identity server. The 3rd party ids already looked up are persisted for the user,
+ as salted hashes.
+ 
+ Use it to discover the users behind contacts added to the address book since the last lookup.
+ 
+ @param threepids the list of 3rd party ids: [[<(MX3PIDMedium)media1>, <(NSString*)address1>], [<(MX3PIDMedium)media2>, <(NSString*)address2>], ...].
+ @param success A block object called when the operation succeeds. It provides the array of the users discovered
+ among the new 3rd party ids: [[<(MX3PIDMedium)media>, <(NSString*)address>, <(NSString*)userId>], ...].
+ @param failure A block object called when the operation fails.
+ 
+ @return a MXHTTPOperation instance.
+ */
+- (MXHTTPOperation*)lookupNew3pids:(NSArray*)threepids
+                           success:(void (^)(NSArray *discoveredUsers))success
+                           failure:(void (^)(NSError *error))failure;
+
+/**
+ Forget the lookup results and the 3rd party ids looked up with this identity server,
+ and delete their persisted copy.
+ 
+ It must be called when the user logs out or stops using this identity server.
+ */
+- (void)resetLookupCache;
+
 #pragma mark Establishing associations
 
 /**
@@ -16,8 +16,10 @@
 
 #import "MXIdentityService.h"
 #import "MXServiceTerms.h"
+#import "MXIdentityServerLookupCache.h"
 
 #import "MXRestClient.h"
+#import "MXLog.h"
 #import "MXTools.h"
 
 #pragma mark - Defines & Constants
@@ -31,6 +33,47 @@ NSString *const MXIdentityServiceNotificationUserIdKey = @"userId";
 NSString *const MXIdentityServiceNotificationIdentityServerKey = @"identityServer";
 NSString *const MXIdentityServiceNotificationAccessTokenKey = @"accessToken";
 
+// Maximum number of hashed addresses sent in one v2 lookup request
+static NSUInteger const kMXIdentityServiceLookupChunkSize = 500;
+
+// Time during which a v2 lookup result is reused
+static NSTimeInterval const kMXIdentityServiceLookupResultLifetime = 3600;
+
+#pragma mark - MXIdentityServiceLookupOperation
+
+/**
+ The operation returned by v2 lookups. Cancelling it cancels the requests it is made of.
+ */
+@interface MXIdentityServiceLookupOperation : MXHTTPOperation
+
+@property (nonatomic, copy) dispatch_block_t onCancel;
+
+@end
+
+@implementation MXIdentityServiceLookupOperation
+
+- (void)cancel
+{
+    if (self.isCancelled)
+    {
+        return;
+    }
+
+    [super cancel];
+
+    dispatch_block_t onCancel = self.onCancel;
+    self.onCancel = nil;
+    if (onCancel)
+    {
+        onCancel();
+    }
+}
+
+@end
+
+
+#pragma mark - MXIdentityService
+
 @interface MXIdentityService ()
 
 // Identity server REST client
@@ -41,6 +84,9 @@ NSString *const MXIdentityServiceNotificationAccessTokenKey = @"accessToken";
 // Identity server hash details
 @property (nonatomic, strong) MXIdentityServerHashDetails *identityServerHashDetails;
 
+// Hashed addresses and results of v2 lookups
+@property (nonatomic, strong) MXIdentityServerLookupCache *lookupCache;
+
 // Identity server access token for v2 API
 @property (nonatomic, strong) NSString *accessToken;
 
@@ -117,6 +163,12 @@ NSString *const MXIdentityServiceNotificationAccessTokenKey = @"accessToken";
         self.restClient = identityServerRestClient;
         _accessToken = identityServerRestClient.accessToken;
         self.homeserverRestClient = homeserverRestClient;
+
+        // The cache is persisted only if it can be scoped to the user
+        NSString *userId = homeserverRestClient.credentials.userId;
+        NSURL *lookupCacheFileURL = userId ? [MXIdentityServerLookupCache fileURLForUser:userId identityServer:identityServerRestClient.identityServer] : nil;
+        self.lookupCache = [[MXIdentityServerLookupCache alloc] initWithFileURL:lookupCacheFileURL
+                                                                  resultLifetime:kMXIdentityServiceLookupResultLifetime];
         
         [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(handleHTTPClientError:) name:kMXHTTPClientMatrixErrorNotification object:nil];
         [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(handleServiceTermsAccepted:) name:MXIdentityServiceTermsAcceptedNotification object:nil];
@@ -172,40 +224,19 @@ NSString *const MXIdentityServiceNotificationAccessTokenKey = @"accessToken";
                         success:(void (^)(NSArray *discoveredUsers))success
                         failure:(void (^)(NSError *error))failure
 {
-    __block MXHTTPOperation *operation;
-    
-    operation = [self checkAPIVersionAvailabilityWithSuccess:^{
-        
-        MXHTTPOperation *operation2;
-        
-        if ([self.restClient.preferredAPIPathPrefix isEqualToString:kMXIdentityAPIPrefixPathV1])
-        {
-            operation2 = [self.restClient lookup3pids:threepids
-                                              success:success
-                                              failure:failure];
-        }
-        else
-        {
-            operation2 = [self v2_lookup3pids:threepids
-                                      success:success
-                                      failure:failure];
-        }
-        
-        if (operation)
-        {
-            [operation mutateTo:operation2];
-        }
-        else
-        {
-            operation = operation2;
-        }
-        
-        
-    } failure:^(NSError *error) {
-        failure(error);
-    }];
-    
-    return operation;
+    return [self lookup3pids:threepids onlyNew:NO success:success failure:failure];
+}
+
+- (MXHTTPOperation*)lookupNew3pids:(NSArray*)threepids
+                           success:(void (^)(NSArray *discoveredUsers))success
+                           failure:(void (^)(NSError *error))failure
+{
+    return [self lookup3pids:threepids onlyNew:YES success:success failure:failure];
+}
+
+- (void)resetLookupCache
+{
+    [self.lookupCache reset];
 }
 
 #pragma mark Establishing associations
@@ -396,51 +427,273 @@ NSString *const MXIdentityServiceNotificationAccessTokenKey = @"accessToken";
     }];
 }
 
-- (MXHTTPOperation*)v2_lookup3pids:(NSArray*)threepids
-                           success:(void (^)(NSArray *discoveredUsers))success
-                           failure:(void (^)(NSError *error))failure
+- (MXHTTPOperation*)lookup3pids:(NSArray*)threepids
+                        onlyNew:(BOOL)onlyNew
+                        success:(void (^)(NSArray *discoveredUsers))success
+                        failure:(void (^)(NSError *error))failure
 {
+    NSArray<NSArray<NSString*>*> *validThreepids = [MXIdentityServerLookupCache validThreepids:threepids];
+    if (onlyNew)
+    {
+        validThreepids = [self.lookupCache unseenThreepids:validThreepids];
+    }
     
-    __block MXHTTPOperation *operation;
+    if (!validThreepids.count)
+    {
+        dispatch_async(self.completionQueue, ^{
+            success(@[]);
+        });
+        return nil;
+    }
     
-    operation = [self v2_lookupHashDetailsWithSuccess:^(MXIdentityServerHashDetails *hashDetails) {
-        
-        MXHTTPOperation *operation2;
-        
-        MXIdentityServerHashAlgorithm lookupHashAlgorithm = [self preferredLookupAlgorithmForLookupoHashDetails:hashDetails];
+    void (^lookupSuccess)(NSArray *discoveredUsers) = ^(NSArray *discoveredUsers) {
+        [self.lookupCache markThreepidsAsSeen:validThreepids];
+        success(discoveredUsers);
+    };
+    
+    // The lookup starts once the API version is known. Cancelling this operation cancels
+    // either the version check or all the lookup requests
+    MXIdentityServiceLookupOperation *operation = [MXIdentityServiceLookupOperation new];
+    
+    MXHTTPOperation *versionOperation = [self checkAPIVersionAvailabilityWithSuccess:^{
         
-        operation2 = [self.restClient lookup3pids:threepids
-                                        algorithm:lookupHashAlgorithm
-                                           pepper:hashDetails.pepper
-                                          success:success
-                                          failure:^(NSError * _Nonnull error) {
-                                              
-                                              MXError *mxError = [[MXError alloc] initWithNSError:error];
-                                              if ([mxError.errcode isEqualToString:kMXErrCodeStringInvalidPepper])
-                                              {
-                                                  // Identity server could rotate the pepper and it could become invalid
-                                                  // TODO: Retry lookup with new pepper on invalid pepper error
-                                                  self.identityServerHashDetails = nil;
-                                              }
-                                              
-                                              failure(error);
-                                          }];
+        if (operation.isCancelled)
+        {
+            return;
+        }
         
+        MXHTTPOperation *operation2;
         
-        if (operation)
+        if ([self.restClient.preferredAPIPathPrefix isEqualToString:kMXIdentityAPIPrefixPathV1])
         {
-            [operation mutateTo:operation2];
+            operation2 = [self.restClient lookup3pids:validThreepids
+                                              success:lookupSuccess
+                                              failure:failure];
         }
         else
         {
-            operation = operation2;
+            operation2 = [self v2_lookup3pids:validThreepids
+                            retryOnNewPepper:YES
+                                     success:lookupSuccess
+                                     failure:failure];
+        }
+        
+        operation.onCancel = ^{
+            [operation2 cancel];
+        };
+        [operation mutateTo:operation2];
+        
+    } failure:^(NSError *error) {
+        failure(error);
+    }];
+    
+    if (!operation.onCancel)
+    {
+        // The version check is still running
+        operation.onCancel = ^{
+            [versionOperation cancel];
+        };
+        [operation mutateTo:versionOperation];
+    }
+    
+    return operation;
+}
+
+- (MXHTTPOperation*)v2_lookup3pids:(NSArray<NSArray<NSString*>*>*)threepids
+                  retryOnNewPepper:(BOOL)retryOnNewPepper
+                           success:(void (^)(NSArray *discoveredUsers))success
+                           failure:(void (^)(NSError *error))failure
+{
+    // Hashing and chunked lookups are asynchronous. This operation reports and forwards their cancellation
+    MXIdentityServiceLookupOperation *operation = [MXIdentityServiceLookupOperation new];
+    
+    MXHTTPOperation *hashDetailsOperation = [self v2_lookupHashDetailsWithSuccess:^(MXIdentityServerHashDetails *hashDetails) {
+        
+        MXIdentityServerHashAlgorithm lookupHashAlgorithm = [self preferredLookupAlgorithmForLookupoHashDetails:hashDetails];
+        if (lookupHashAlgorithm == MXIdentityServerHashAlgorithmUnknown || !hashDetails.pepper)
+        {
+            failure([NSError errorWithDomain:MXIdentityServerRestClientErrorDomain code:MXIdentityServerRestClientErrorUnsupportedHashAlgorithm userInfo:nil]);
+            return;
         }
         
+        NSString *pepper = hashDetails.pepper;
+        [self.lookupCache setPepper:pepper algorithm:lookupHashAlgorithm];
+        
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            
+            NSArray<NSString*> *hashedAddresses = [self.lookupCache hashedAddressesForThreepids:threepids];
+            
+            // Reuse the results that have not expired. Look up the other addresses
+            NSMutableDictionary<NSString*, NSArray<NSString*>*> *threepidByHashedAddress = [NSMutableDictionary dictionaryWithCapacity:hashedAddresses.count];
+            NSMutableDictionary<NSString*, NSString*> *cachedMappings = [NSMutableDictionary dictionary];
+            NSMutableArray<NSString*> *hashedAddressesToLookUp = [NSMutableArray array];
+            
+            for (NSUInteger index = 0; index < hashedAddresses.count; index++)
+            {
+                NSString *hashedAddress = hashedAddresses[index];
+                if (threepidByHashedAddress[hashedAddress])
+                {
+                    continue;
+                }
+                threepidByHashedAddress[hashedAddress] = threepids[index];
+                
+                id userId = [self.lookupCache lookupResultForHashedAddress:hashedAddress];
+                if ([userId isKindOfClass:NSString.class])
+                {
+                    cachedMappings[hashedAddress] = userId;
+                }
+                else if (!userId)
+                {
+                    [hashedAddressesToLookUp addObject:hashedAddress];
+                }
+            }
+            
+            MXLogDebug(@"[MXIdentityService] v2_lookup3pids: %@ addresses. %@ to look up", @(threepidByHashedAddress.count), @(hashedAddressesToLookUp.count));
+            
+            dispatch_async(self.completionQueue, ^{
+                
+                if (operation.isCancelled)
+                {
+                    return;
+                }
+                
+                [self v2_lookupHashedAddresses:hashedAddressesToLookUp algorithm:lookupHashAlgorithm pepper:pepper operation:operation success:^(NSDictionary<NSString *,NSString *> *mappings) {
+                    
+                    [self.lookupCache storeLookupResults:mappings forHashedAddresses:hashedAddressesToLookUp];
+                    [cachedMappings addEntriesFromDictionary:mappings];
+                    
+                    NSMutableArray *discoveredUsers = [NSMutableArray arrayWithCapacity:cachedMappings.count];
+                    for (NSString *hashedAddress in hashedAddresses)
+                    {
+                        NSString *userId = cachedMappings[hashedAddress];
+                        NSArray<NSString*> *threepid = threepidByHashedAddress[hashedAddress];
+                        if (userId && threepid)
+                        {
+                            // Medium, 3 pid, Matrix ID
+                            [discoveredUsers addObject:@[threepid[0], threepid[1], userId]];
+                            
+                            // Report duplicates once
+                            [threepidByHashedAddress removeObjectForKey:hashedAddress];
+                        }
+                    }
+                    
+                    success(discoveredUsers);
+                    
+                } failure:^(NSError *error) {
+                    
+                    MXError *mxError = [[MXError alloc] initWithNSError:error];
+                    if ([mxError.errcode isEqualToString:kMXErrCodeStringInvalidPepper])
+                    {
+                        // Identity server could rotate the pepper and it could become invalid
+                        self.identityServerHashDetails = nil;
+                        
+                        if (retryOnNewPepper)
+                        {
+                            MXLogDebug(@"[MXIdentityService] v2_lookup3pids: Invalid pepper. Retry with new hash details");
+                            MXHTTPOperation *retryOperation = [self v2_lookup3pids:threepids retryOnNewPepper:NO success:success failure:failure];
+                            operation.onCancel = ^{
+                                [retryOperation cancel];
+                            };
+                            [operation mutateTo:retryOperation];
+                            return;
+                        }
+                    }
+                    
+                    failure(error);
+                }];
+            });
+        });
+        
     } failure:failure];
     
+    [operation mutateTo:hashDetailsOperation];
+    
     return operation;
 }
 
+/**
+ Look up hashed addresses by chunks of `kMXIdentityServiceLookupChunkSize`.
+ 
+ All chunks are requested at once. The HTTP client limits the number of concurrent connections.
+ */
+- (void)v2_lookupHashedAddresses:(NSArray<NSString*>*)hashedAddresses
+                       algorithm:(MXIdentityServerHashAlgorithm)algorithm
+                          pepper:(NSString*)pepper
+                       operation:(MXIdentityServiceLookupOperation*)operation
+                         success:(void (^)(NSDictionary<NSString*, NSString*> *mappings))success
+                         failure:(void (^)(NSError *error))failure
+{
+    if (!hashedAddresses.count)
+    {
+        success(@{});
+        return;
+    }
+    
+    NSUInteger chunksCount = (hashedAddresses.count + kMXIdentityServiceLookupChunkSize - 1) / kMXIdentityServiceLookupChunkSize;
+    
+    NSMutableDictionary<NSString*, NSString*> *mappings = [NSMutableDictionary dictionary];
+    NSMutableArray<MXHTTPOperation*> *chunkOperations = [NSMutableArray arrayWithCapacity:chunksCount];
+    __block NSUInteger pendingChunksCount = chunksCount;
+    __block BOOL completed = NO;
+    
+    operation.onCancel = ^{
+        for (MXHTTPOperation *chunkOperation in chunkOperations)
+        {
+            [chunkOperation cancel];
+        }
+    };
+    
+    for (NSUInteger chunkIndex = 0; chunkIndex < chunksCount; chunkIndex++)
+    {
+        NSRange range = NSMakeRange(chunkIndex * kMXIdentityServiceLookupChunkSize, 0);
+        range.length = MIN(kMXIdentityServiceLookupChunkSize, hashedAddresses.count - range.location);
+        
+        MXHTTPOperation *chunkOperation = [self.restClient lookupHashedAddresses:[hashedAddresses subarrayWithRange:range] algorithm:algorithm pepper:pepper success:^(NSDictionary<NSString *,NSString *> *chunkMappings) {
+            
+            if (completed || operation.isCancelled)
+            {
+                return;
+            }
+            
+            [mappings addEntriesFromDictionary:chunkMappings];
+            
+            if (--pendingChunksCount == 0)
+            {
+                completed = YES;
+                operation.onCancel = nil;
+                success(mappings);
+            }
+            
+        } failure:^(NSError *error) {
+            
+            if (completed || operation.isCancelled)
+            {
+                return;
+            }
+            
+            // Stop at the first failure
+            completed = YES;
+            operation.onCancel = nil;
+            for (MXHTTPOperation *otherChunkOperation in chunkOperations)
+            {
+                [otherChunkOperation cancel];
+            }
+            
+            failure(error);
+        }];
+        
+        if (chunkOperation)
+        {
+            [chunkOperations addObject:chunkOperation];
+        }
+        
+        if (completed)
+        {
+            break;
+        }
+    }
+}
+
 - (MXIdentityServerHashAlgorithm)preferredLookupAlgorithmForLookupoHashDetails:(MXIdentityServerHashDetails*)lookupHashDetails
 {
     MXIdentityServerHashAlgorithm preferredAlgorithm = MXIdentityServerHashAlgorithmUnknown;
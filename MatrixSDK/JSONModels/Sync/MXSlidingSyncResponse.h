@@ -0,0 +1,113 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXJSONModel.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Sliding sync list operations (MSC3575).
+ */
+FOUNDATION_EXPORT NSString *const kMXSlidingSyncOperationSync;
+FOUNDATION_EXPORT NSString *const kMXSlidingSyncOperationInsert;
+FOUNDATION_EXPORT NSString *const kMXSlidingSyncOperationDelete;
+FOUNDATION_EXPORT NSString *const kMXSlidingSyncOperationInvalidate;
+
+/**
+ `MXSlidingSyncListOperation` is an update of the room ids in a window of a sliding sync list.
+ */
+@interface MXSlidingSyncListOperation : MXJSONModel
+
+/**
+ The operation (see kMXSlidingSyncOperation* constants).
+ */
+@property (nonatomic) NSString *op;
+
+/**
+ The inclusive [start, end] range for SYNC and INVALIDATE operations.
+ */
+@property (nonatomic, nullable) NSArray<NSNumber*> *range;
+
+/**
+ The index for INSERT and DELETE operations.
+ */
+@property (nonatomic, nullable) NSNumber *index;
+
+/**
+ The room ids of a SYNC operation, in list order.
+ */
+@property (nonatomic, nullable) NSArray<NSString*> *roomIds;
+
+/**
+ The room id of an INSERT operation.
+ */
+@property (nonatomic, nullable) NSString *roomId;
+
+@end
+
+/**
+ `MXSlidingSyncListResponse` is the state of a sliding sync list returned by the server.
+ */
+@interface MXSlidingSyncListResponse : MXJSONModel
+
+/**
+ The total number of rooms in the list.
+ */
+@property (nonatomic) NSUInteger count;
+
+/**
+ The operations to apply to the client side copy of the list.
+ */
+@property (nonatomic, nullable) NSArray<MXSlidingSyncListOperation*> *ops;
+
+@end
+
+/**
+ `MXSlidingSyncResponse` represents the response of a sliding sync request.
+
+ Room and extension data are kept as raw JSON. They are converted into a classic
+ `MXSyncResponse` by `MXSlidingSync` before being processed by `MXSession`.
+ */
+@interface MXSlidingSyncResponse : MXJSONModel
+
+/**
+ The position to pass in the next request.
+ */
+@property (nonatomic) NSString *pos;
+
+/**
+ The transaction id of the request, echoed by the server.
+ */
+@property (nonatomic, nullable) NSString *txnId;
+
+/**
+ The lists updates, by list name.
+ */
+@property (nonatomic, nullable) NSDictionary<NSString*, MXSlidingSyncListResponse*> *lists;
+
+/**
+ The rooms data (JSON), by room id.
+ */
+@property (nonatomic, nullable) NSDictionary<NSString*, NSDictionary*> *rooms;
+
+/**
+ The extensions data (JSON), by extension name.
+ */
+@property (nonatomic, nullable) NSDictionary<NSString*, NSDictionary*> *extensions;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,164 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXSlidingSyncResponse.h"
+
+NSString *const kMXSlidingSyncOperationSync = @"SYNC";
+NSString *const kMXSlidingSyncOperationInsert = @"INSERT";
+NSString *const kMXSlidingSyncOperationDelete = @"DELETE";
+NSString *const kMXSlidingSyncOperationInvalidate = @"INVALIDATE";
+
+@implementation MXSlidingSyncListOperation
+
++ (id)modelFromJSON:(NSDictionary *)JSONDictionary
+{
+    MXSlidingSyncListOperation *operation;
+
+    NSString *op;
+    MXJSONModelSetString(op, JSONDictionary[@"op"]);
+    if (op)
+    {
+        operation = [[MXSlidingSyncListOperation alloc] init];
+        operation.op = op;
+        MXJSONModelSetArray(operation.range, JSONDictionary[@"range"]);
+        MXJSONModelSetNumber(operation.index, JSONDictionary[@"index"]);
+        MXJSONModelSetArray(operation.roomIds, JSONDictionary[@"room_ids"]);
+        MXJSONModelSetString(operation.roomId, JSONDictionary[@"room_id"]);
+    }
+    return operation;
+}
+
+- (NSDictionary *)JSONDictionary
+{
+    NSMutableDictionary *JSONDictionary = [NSMutableDictionary dictionary];
+
+    JSONDictionary[@"op"] = self.op;
+    if (self.range)
+    {
+        JSONDictionary[@"range"] = self.range;
+    }
+    if (self.index)
+    {
+        JSONDictionary[@"index"] = self.index;
+    }
+    if (self.roomIds)
+    {
+        JSONDictionary[@"room_ids"] = self.roomIds;
+    }
+    if (self.roomId)
+    {
+        JSONDictionary[@"room_id"] = self.roomId;
+    }
+
+    return JSONDictionary;
+}
+
+@end
+
+
+@implementation MXSlidingSyncListResponse
+
++ (id)modelFromJSON:(NSDictionary *)JSONDictionary
+{
+    MXSlidingSyncListResponse *listResponse = [[MXSlidingSyncListResponse alloc] init];
+    if (listResponse)
+    {
+        MXJSONModelSetUInteger(listResponse.count, JSONDictionary[@"count"]);
+        MXJSONModelSetMXJSONModelArray(listResponse.ops, MXSlidingSyncListOperation, JSONDictionary[@"ops"]);
+    }
+    return listResponse;
+}
+
+- (NSDictionary *)JSONDictionary
+{
+    NSMutableDictionary *JSONDictionary = [NSMutableDictionary dictionary];
+
+    JSONDictionary[@"count"] = @(self.count);
+    if (self.ops)
+    {
+        NSMutableArray *ops = [NSMutableArray arrayWithCapacity:self.ops.count];
+        for (MXSlidingSyncListOperation *operation in self.ops)
+        {
+            [ops addObject:operation.JSONDictionary];
+        }
+        JSONDictionary[@"ops"] = ops;
+    }
+
+    return JSONDictionary;
+}
+
+@end
+
+
+@implementation MXSlidingSyncResponse
+
++ (id)modelFromJSON:(NSDictionary *)JSONDictionary
+{
+    MXSlidingSyncResponse *response;
+
+    NSString *pos;
+    MXJSONModelSetString(pos, JSONDictionary[@"pos"]);
+    if (pos)
+    {
+        response = [[MXSlidingSyncResponse alloc] init];
+        response.pos = pos;
+        MXJSONModelSetString(response.txnId, JSONDictionary[@"txn_id"]);
+
+        NSDictionary *lists;
+        MXJSONModelSetDictionary(lists, JSONDictionary[@"lists"]);
+        if (lists)
+        {
+            NSMutableDictionary *mxLists = [NSMutableDictionary dictionaryWithCapacity:lists.count];
+            for (NSString *listName in lists)
+            {
+                MXJSONModelSetMXJSONModel(mxLists[listName], MXSlidingSyncListResponse, lists[listName]);
+            }
+            response.lists = mxLists;
+        }
+
+        MXJSONModelSetDictionary(response.rooms, JSONDictionary[@"rooms"]);
+        MXJSONModelSetDictionary(response.extensions, JSONDictionary[@"extensions"]);
+    }
+    return response;
+}
+
+- (NSDictionary *)JSONDictionary
+{
+    NSMutableDictionary *JSONDictionary = [NSMutableDictionary dictionary];
+
+    JSONDictionary[@"pos"] = self.pos;
+    if (self.lists)
+    {
+        NSMutableDictionary *lists = [NSMutableDictionary dictionaryWithCapacity:self.lists.count];
+        for (NSString *listName in self.lists)
+        {
+            lists[listName] = self.lists[listName].JSONDictionary;
+        }
+        JSONDictionary[@"lists"] = lists;
+    }
+    if (self.rooms)
+    {
+        JSONDictionary[@"rooms"] = self.rooms;
+    }
+    if (self.extensions)
+    {
+        JSONDictionary[@"extensions"] = self.extensions;
+    }
+
+    return JSONDictionary;
+}
+
+@end
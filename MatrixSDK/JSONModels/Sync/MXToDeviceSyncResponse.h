@@ -22,14 +22,38 @@ NS_ASSUME_NONNULL_BEGIN
 
 /**
  `MXToDeviceSyncResponse` represents the data directly sent to one of user's devices.
+
+ Events are kept in their JSON form and decoded into `MXEvent` objects only when they are accessed.
  */
 @interface MXToDeviceSyncResponse : MXJSONModel
 
+/**
+ Create a response from JSON strings of events, as returned by the crypto machine.
+
+ @param eventJSONStrings the JSON strings of the events.
+ @return a `MXToDeviceSyncResponse` instance.
+ */
++ (instancetype)modelWithEventJSONStrings:(NSArray<NSString*> *)eventJSONStrings;
+
 /**
  List of direct-to-device events.
+ All events are decoded on first access.
  */
 @property (nonatomic) NSArray<MXEvent*> *events;
 
+/**
+ The number of events. Events are not decoded.
+ */
+@property (nonatomic, readonly) NSUInteger eventsCount;
+
+/**
+ Decode only the events of some types.
+
+ @param types the event types.
+ @return the events of these types.
+ */
+- (NSArray<MXEvent*> *)eventsOfTypes:(NSSet<NSString*> *)types;
+
 @end
 
 NS_ASSUME_NONNULL_END
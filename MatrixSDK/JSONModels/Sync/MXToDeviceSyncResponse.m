@@ -17,31 +17,157 @@
 #import "MXToDeviceSyncResponse.h"
 
 #import "MXEvent.h"
+#import "MXTools.h"
+
+@interface MXToDeviceSyncResponse ()
+{
+    // Events not decoded yet, as JSON dictionaries or JSON strings
+    NSArray *rawEvents;
+}
+@end
 
 @implementation MXToDeviceSyncResponse
 
+@synthesize events = _events;
+
 + (id)modelFromJSON:(NSDictionary *)JSONDictionary
 {
     MXToDeviceSyncResponse *toDeviceSyncResponse = [[MXToDeviceSyncResponse alloc] init];
     if (toDeviceSyncResponse)
     {
-        MXJSONModelSetMXJSONModelArray(toDeviceSyncResponse.events, MXEvent, JSONDictionary[@"events"]);
+        NSArray *events = JSONDictionary[@"events"];
+        if ([events isKindOfClass:NSArray.class])
+        {
+            toDeviceSyncResponse->rawEvents = events;
+        }
+        else if (events)
+        {
+            MXJSONModelSetLogError(NSArray.class, events)
+        }
     }
     return toDeviceSyncResponse;
 }
 
++ (instancetype)modelWithEventJSONStrings:(NSArray<NSString *> *)eventJSONStrings
+{
+    MXToDeviceSyncResponse *toDeviceSyncResponse = [[MXToDeviceSyncResponse alloc] init];
+    toDeviceSyncResponse->rawEvents = [eventJSONStrings copy];
+    return toDeviceSyncResponse;
+}
+
+- (NSArray<MXEvent *> *)events
+{
+    if (!_events && rawEvents)
+    {
+        NSMutableArray<MXEvent*> *events = [NSMutableArray arrayWithCapacity:rawEvents.count];
+        for (id rawEvent in rawEvents)
+        {
+            MXEvent *event = [self eventFromRawEvent:rawEvent];
+            if (event)
+            {
+                [events addObject:event];
+            }
+        }
+        _events = events;
+        rawEvents = nil;
+    }
+    return _events ?: @[];
+}
+
+- (void)setEvents:(NSArray<MXEvent *> *)events
+{
+    _events = events;
+    rawEvents = nil;
+}
+
+- (NSUInteger)eventsCount
+{
+    return rawEvents ? rawEvents.count : _events.count;
+}
+
+- (NSArray<MXEvent *> *)eventsOfTypes:(NSSet<NSString *> *)types
+{
+    if (!rawEvents)
+    {
+        NSPredicate *predicate = [NSPredicate predicateWithBlock:^BOOL(MXEvent *event, NSDictionary *bindings) {
+            return [types containsObject:event.type];
+        }];
+        return [self.events filteredArrayUsingPredicate:predicate];
+    }
+
+    NSMutableArray<MXEvent*> *events = [NSMutableArray array];
+    for (id rawEvent in rawEvents)
+    {
+        NSDictionary *JSONEvent = [self JSONEventFromRawEvent:rawEvent];
+        if (![types containsObject:JSONEvent[@"type"]])
+        {
+            continue;
+        }
+
+        MXEvent *event = [MXEvent modelFromJSON:JSONEvent];
+        if (event)
+        {
+            [events addObject:event];
+        }
+    }
+    return events;
+}
+
 - (NSDictionary *)JSONDictionary
 {
     NSMutableDictionary *JSONDictionary = [NSMutableDictionary dictionary];
     
-    NSMutableArray *jsonEvents = [NSMutableArray arrayWithCapacity:self.events.count];
-    for (MXEvent *event in self.events)
+    NSMutableArray *jsonEvents = [NSMutableArray arrayWithCapacity:self.eventsCount];
+    if (rawEvents)
+    {
+        // Pass events through as they were received
+        for (id rawEvent in rawEvents)
+        {
+            NSDictionary *JSONEvent = [self JSONEventFromRawEvent:rawEvent];
+            if (JSONEvent)
+            {
+                [jsonEvents addObject:JSONEvent];
+            }
+        }
+    }
+    else
     {
-        [jsonEvents addObject:event.JSONDictionary];
+        for (MXEvent *event in _events)
+        {
+            [jsonEvents addObject:event.JSONDictionary];
+        }
     }
     JSONDictionary[@"events"] = jsonEvents;
     
     return JSONDictionary;
 }
 
+#pragma mark - Private
+
+- (NSDictionary*)JSONEventFromRawEvent:(id)rawEvent
+{
+    if ([rawEvent isKindOfClass:NSDictionary.class])
+    {
+        return rawEvent;
+    }
+
+    if ([rawEvent isKindOfClass:NSString.class])
+    {
+        NSDictionary *JSONEvent = [MXTools deserialiseJSONString:rawEvent];
+        if ([JSONEvent isKindOfClass:NSDictionary.class])
+        {
+            return JSONEvent;
+        }
+    }
+
+    MXLogError(@"[MXToDeviceSyncResponse] Cannot decode a to-device event");
+    return nil;
+}
+
+- (MXEvent*)eventFromRawEvent:(id)rawEvent
+{
+    NSDictionary *JSONEvent = [self JSONEventFromRawEvent:rawEvent];
+    return JSONEvent ? [MXEvent modelFromJSON:JSONEvent] : nil;
+}
+
 @end
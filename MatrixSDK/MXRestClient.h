@@ -49,6 +49,7 @@
 @class MXThirdpartyProtocolsResponse;
 @class MXThirdPartyUsersResponse;
 @class MXSyncResponse;
+@class MXSlidingSyncResponse;
 @class MXDeviceListResponse;
 @class MXSpaceChildrenRequestParameters;
 @class MXCapabilities;
@@ -2133,6 +2134,28 @@ NS_REFINED_FOR_SWIFT;
                            success:(void (^)(MXSyncResponse *syncResponse))success
                            failure:(void (^)(NSError *error))failure NS_REFINED_FOR_SWIFT;
 
+/**
+ Make a sliding sync request (MSC3575).
+
+ Sliding sync returns only the rooms in the requested windows of the room lists
+ and the subscribed rooms. See `MXSlidingSync` for a sync engine based on it.
+
+ @param request the JSON request body: lists, room subscriptions and extensions.
+ @param pos the position returned by the previous response (nil for the first request).
+ @param serverTimeout the maximum time in ms to wait for an update.
+ @param clientTimeout the maximum time in ms the SDK must wait for the server response.
+ @param success A block object called when the operation succeeds. It provides a `MXSlidingSyncResponse` object.
+ @param failure A block object called when the operation fails.
+
+ @return a MXHTTPOperation instance.
+ */
+- (MXHTTPOperation *)slidingSyncWithRequest:(NSDictionary*)request
+                                        pos:(NSString*)pos
+                              serverTimeout:(NSUInteger)serverTimeout
+                              clientTimeout:(NSUInteger)clientTimeout
+                                    success:(void (^)(MXSlidingSyncResponse *response))success
+                                    failure:(void (^)(NSError *error))failure;
+
 
 #pragma mark - Directory operations
 /**
@@ -30,6 +30,7 @@
 
 #import "MXThirdpartyProtocolsResponse.h"
 #import "MXThirdPartyUsersResponse.h"
+#import "MXSlidingSyncResponse.h"
 #import "MXRefreshTokenData.h"
 #import "MatrixSDKSwiftHeader.h"
 
@@ -4202,6 +4203,54 @@ andUnauthenticatedHandler: (MXRestClientUnauthenticatedHandler)unauthenticatedHa
     return operation;
 }
 
+- (MXHTTPOperation *)slidingSyncWithRequest:(NSDictionary*)request
+                                        pos:(NSString*)pos
+                              serverTimeout:(NSUInteger)serverTimeout
+                              clientTimeout:(NSUInteger)clientTimeout
+                                    success:(void (^)(MXSlidingSyncResponse *response))success
+                                    failure:(void (^)(NSError *error))failure
+{
+    // The body contains the request. pos and timeout go in the query string
+    NSMutableString *path = [NSMutableString stringWithFormat:@"%@/org.matrix.msc3575/sync?timeout=%tu", kMXAPIPrefixPathUnstable, serverTimeout];
+    if (pos)
+    {
+        [path appendFormat:@"&pos=%@", [MXTools encodeURIComponent:pos]];
+    }
+
+    NSTimeInterval clientTimeoutInSeconds = clientTimeout;
+    if (-1 != clientTimeoutInSeconds)
+    {
+        clientTimeoutInSeconds = clientTimeoutInSeconds / 1000;
+    }
+
+    MXWeakify(self);
+    MXHTTPOperation *operation = [httpClient requestWithMethod:@"POST"
+                                                          path:path
+                                                    parameters:request
+                                                       timeout:clientTimeoutInSeconds
+                                                       success:^(NSDictionary *JSONResponse) {
+        MXStrongifyAndReturnIfNil(self);
+
+        if (success)
+        {
+            __block MXSlidingSyncResponse *response;
+            [self dispatchProcessing:^{
+                MXJSONModelSetMXJSONModel(response, MXSlidingSyncResponse, JSONResponse);
+            } andCompletion:^{
+                success(response);
+            }];
+        }
+    } failure:^(NSError *error) {
+        MXStrongifyAndReturnIfNil(self);
+        [self dispatchFailure:error inBlock:failure];
+    }];
+
+    // Like /sync, let the sync engine manage retries
+    operation.maxNumberOfTries = 1;
+
+    return operation;
+}
+
 
 #pragma mark - read receipt
 - (MXHTTPOperation*)sendReadReceipt:(NSString*)roomId
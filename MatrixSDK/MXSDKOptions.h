@@ -224,6 +224,25 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic) BOOL enableNewClientInformationFeature;
 
+/**
+ The number of /sync responses that can be fetched in advance while the session processes
+ the current one. The next request is sent as soon as a response is received and responses
+ are processed in order. A response with to-device events or device list changes is stored
+ before the request that follows it is sent. 0 disables the pipelining.
+
+ @remark 0 by default.
+ */
+@property (nonatomic) NSUInteger syncPipelineDepth;
+
+/**
+ Route the requests of `MXHTTPClient` instances through a `MXHTTPRequestScheduler`.
+ Requests run in priority lanes with their own concurrency limits and identical idempotent
+ requests in flight share a single request.
+
+ @remark NO by default.
+ */
+@property (nonatomic) BOOL enableHTTPRequestScheduling;
+
 @end
 
 NS_ASSUME_NONNULL_END
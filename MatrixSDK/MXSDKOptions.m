@@ -56,6 +56,8 @@ static MXSDKOptions *sharedOnceInstance = nil;
         _enableRoomSharedHistoryOnInvite = NO;
         _enableSymmetricBackup = NO;
         _enableNewClientInformationFeature = NO;
+        _syncPipelineDepth = 0;
+        _enableHTTPRequestScheduling = NO;
         _cryptoMigrationDelegate = nil;
     }
     
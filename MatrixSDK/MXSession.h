@@ -38,7 +38,9 @@
 #import "MXIdentityService.h"
 #import "MX3PidAddManager.h"
 #import "MXMembershipTransitionState.h"
+#import "MXRoomSummaryChange.h"
 #import "MXRoomAccountDataUpdating.h"
+#import "MXDecryptionScheduler.h"
 
 /**
  `MXSessionState` represents the states in the life cycle of a MXSession instance.
@@ -203,6 +205,20 @@ FOUNDATION_EXPORT NSString *const kMXSessionIgnoredUsersDidChangeNotification;
  */
 FOUNDATION_EXPORT NSString *const kMXSessionDirectRoomsDidChangeNotification;
 
+/**
+ Posted once per batch of room summary changes.
+
+ Changes that happen while a /sync response is processed are delivered in a single batch
+ at the end of the processing. Other changes are delivered in the next run loop iteration.
+ Observe it instead of `kMXRoomSummaryDidChangeNotification` to update data once per batch.
+
+ The notification object is the concerned session (MXSession instance).
+
+ The passed userInfo dictionary contains:
+ - `kMXSessionNotificationRoomSummaryChangesKey` the changes, an array of `MXRoomSummaryChange`.
+ */
+FOUNDATION_EXPORT NSString *const kMXSessionDidUpdateRoomSummariesNotification;
+
 /**
  Posted when the virtual rooms are updated, either from the store or from the homeserver.
  
@@ -334,6 +350,12 @@ FOUNDATION_EXPORT NSString *const kMXSessionNotificationSyncResponseKey;
  */
 FOUNDATION_EXPORT NSString *const kMXSessionNotificationErrorKey;
 
+/**
+ The key in notification userInfo dictionary representating a batch of room summary changes
+ (array of MXRoomSummaryChange).
+ */
+FOUNDATION_EXPORT NSString *const kMXSessionNotificationRoomSummaryChangesKey;
+
 /**
  The key in notification userInfo dictionary representating a list of user ids.
  */
@@ -352,6 +374,7 @@ FOUNDATION_EXPORT NSString *const kMXSessionNoRoomTag;
 @class MXEventStreamService;
 @class MXLocationService;
 @class MXSessionStartupProgress;
+@class MXSlidingSync;
 
 #pragma mark - MXSession
 /**
@@ -512,6 +535,12 @@ FOUNDATION_EXPORT NSString *const kMXSessionNoRoomTag;
  */
 @property (nonatomic, readonly) MXLocationService *locationService;
 
+/**
+ The scheduler of event decryption across rooms.
+ Set the priority of displayed rooms on it so that their events are decrypted first.
+ */
+@property (nonatomic, readonly) MXDecryptionScheduler *decryptionScheduler;
+
 /**
  Flag indicating the session can be paused.
  */
@@ -586,6 +615,40 @@ FOUNDATION_EXPORT NSString *const kMXSessionNoRoomTag;
              onServerSyncDone:(void (^)(void))onServerSyncDone
                       failure:(void (^)(NSError *error))failure NS_REFINED_FOR_SWIFT;
 
+/**
+ Start the session with a sliding sync engine (MSC3575) instead of the classic /sync loop.
+
+ The first room lists are available as soon as the first windows are synced, whatever
+ the number of rooms of the account.
+
+ CAUTION: The classic /sync loop, including `backgroundSync`, must not be used with a
+ store filled by sliding sync.
+
+ @param slidingSync the sliding sync engine, configured with its lists.
+ @param onServerSyncDone A block object called when the first sliding sync response has been processed.
+ @param failure A block object called when the operation fails.
+ */
+- (void)startWithSlidingSync:(MXSlidingSync*)slidingSync
+            onServerSyncDone:(void (^)(void))onServerSyncDone
+                     failure:(void (^)(NSError *error))failure;
+
+/**
+ The sliding sync engine, if the session was started with one.
+ */
+@property (nonatomic, readonly) MXSlidingSync *slidingSync;
+
+/**
+ Process a sync response built by the sliding sync engine.
+
+ It goes through the same processing as classic /sync responses so that rooms,
+ room summaries and the store are updated the same way.
+
+ @param syncResponse the sync response converted from a sliding sync response.
+ @param completion A block called when the response has been processed.
+ */
+- (void)handleSlidingSyncResponse:(MXSyncResponse*)syncResponse
+                       completion:(void (^)(void))completion;
+
 /**
  Pause the session events stream.
  This action may be delayed by using `retainPreventPause`.
@@ -1078,6 +1141,23 @@ typedef void (^MXOnBackgroundSyncFail)(NSError *error);
                              success:(void (^)(MXEvent *event))success
                              failure:(void (^)(NSError *error))failure NS_REFINED_FOR_SWIFT;
 
+/**
+ Retrieve several events from their event ids.
+ They will be decrypted if needed, with a single decryption request per room.
+
+ Events that are not available locally are fetched from the homeserver. Lookups of the same
+ event that are already in progress are shared.
+
+ @param eventIdsByRoomId the ids of the events to retrieve, grouped by room id.
+
+ @param completion A block object called when all events have been retrieved. It gets the events
+                   by event id. Events that could not be retrieved are omitted.
+
+ @return a MXHTTPOperation instance.
+ */
+- (MXHTTPOperation*)eventsWithEventIds:(NSDictionary<NSString*, NSArray<NSString*>*>*)eventIdsByRoomId
+                            completion:(void (^)(NSDictionary<NSString*, MXEvent*> *events))completion;
+
 
 #pragma mark - Rooms summaries
 /**
@@ -23,6 +23,8 @@
 #import <AFNetworking/AFNetworking.h>
 
 #import "MXSessionEventListener.h"
+#import "MXEventListenerDispatchTable.h"
+#import "MXRoomSummary_Private.h"
 
 #import "MXTools.h"
 #import "MXHTTPClient.h"
@@ -46,6 +48,9 @@
 
 #import "MXAggregations_Private.h"
 #import "MatrixSDKSwiftHeader.h"
+#import "MXSyncPipeline.h"
+#import "MXEventLookupCoalescer.h"
+#import "MXIdentityServerLookupCache.h"
 #import "MXRoomSummaryProtocol.h"
 
 #pragma mark - Constants definitions
@@ -58,6 +63,7 @@ NSString *const kMXSessionInvitedRoomsDidChangeNotification = @"kMXSessionInvite
 NSString *const kMXSessionOnToDeviceEventNotification = @"kMXSessionOnToDeviceEventNotification";
 NSString *const kMXSessionIgnoredUsersDidChangeNotification = @"kMXSessionIgnoredUsersDidChangeNotification";
 NSString *const kMXSessionDirectRoomsDidChangeNotification = @"kMXSessionDirectRoomsDidChangeNotification";
+NSString *const kMXSessionDidUpdateRoomSummariesNotification = @"kMXSessionDidUpdateRoomSummariesNotification";
 NSString *const kMXSessionVirtualRoomsDidChangeNotification = @"kMXSessionVirtualRoomsDidChangeNotification";
 NSString *const kMXSessionAccountDataDidChangeNotification = @"kMXSessionAccountDataDidChangeNotification";
 NSString *const kMXSessionAccountDataDidChangeIdentityServerNotification = @"kMXSessionAccountDataDidChangeIdentityServerNotification";
@@ -78,6 +84,7 @@ NSString *const kMXSessionNotificationGroupIdKey = @"groupId";
 NSString *const kMXSessionNotificationEventKey = @"event";
 NSString *const kMXSessionNotificationSyncResponseKey = @"syncResponse";
 NSString *const kMXSessionNotificationErrorKey = @"error";
+NSString *const kMXSessionNotificationRoomSummaryChangesKey = @"roomSummaryChanges";
 NSString *const kMXSessionNotificationUserIdsArrayKey = @"userIds";
 
 NSString *const kMXSessionNoRoomTag = @"m.recent";  // Use the same value as matrix-react-sdk
@@ -93,6 +100,16 @@ NSString *const kMXSessionNoRoomTag = @"m.recent";  // Use the same value as mat
  */
 #define RETRY_SYNC_AFTER_MXERROR_MS 5000
 
+/**
+ Time during which an event not found by the homeserver is not requested again, in seconds.
+ */
+static NSTimeInterval const kMXSessionNotFoundEventTTL = 60;
+
+/**
+ Maximum number of events decrypted in one go by the decryption scheduler.
+ */
+static NSUInteger const kMXSessionDecryptionChunkSize = 20;
+
 
 // Block called when MSSession resume is complete
 typedef void (^MXOnResumeDone)(void);
@@ -116,10 +133,31 @@ typedef void (^MXOnResumeDone)(void);
      */
     MXHTTPOperation *eventStreamRequest;
 
+    /**
+     The pipeline that prefetches /sync responses, if enabled by `MXSDKOptions.syncPipelineDepth`.
+     */
+    MXSyncPipeline *syncPipeline;
+
+    /**
+     Room summaries changed since the last `kMXSessionDidUpdateRoomSummariesNotification`, by room id.
+     */
+    NSMutableDictionary<NSString*, MXRoomSummary*> *changedRoomSummaries;
+
+    /**
+     Number of nested batches of room summary changes in progress.
+     */
+    NSUInteger roomSummaryChangesBatchCount;
+    BOOL roomSummaryChangesFlushScheduled;
+
     /**
      The list of global events listeners (`MXSessionEventListener`).
      */
-    NSMutableArray *globalEventListeners;
+    MXEventListenerDispatchTable *globalEventListeners;
+
+    /**
+     Shares requests of events fetched by id and remembers events that were not found.
+     */
+    MXEventLookupCoalescer *eventLookupCoalescer;
 
     /**
      The block to call when MSSession resume is complete.
@@ -236,7 +274,11 @@ typedef void (^MXOnResumeDone)(void);
         roomSummaries = [NSMutableDictionary dictionary];
         _roomSummaryUpdateDelegate = [MXRoomSummaryUpdater roomSummaryUpdaterForSession:self];
         _roomAccountDataUpdateDelegate = [MXRoomAccountDataUpdater roomAccountDataUpdaterForSession:self];
-        globalEventListeners = [NSMutableArray array];
+        globalEventListeners = [[MXEventListenerDispatchTable alloc] init];
+        eventLookupCoalescer = [[MXEventLookupCoalescer alloc] initWithNegativeResultTTL:kMXSessionNotFoundEventTTL];
+        NSUInteger maxConcurrentDecryptionChunks = MIN(MAX(NSProcessInfo.processInfo.activeProcessorCount, 2) - 1, 4);
+        _decryptionScheduler = [[MXDecryptionScheduler alloc] initWithMaxConcurrentChunks:maxConcurrentDecryptionChunks
+                                                                                chunkSize:kMXSessionDecryptionChunkSize];
         _notificationCenter = [[MXNotificationCenter alloc] initWithMatrixSession:self];
         _accountData = [[MXAccountData alloc] init];
         peekingRooms = [NSMutableArray array];
@@ -316,6 +358,9 @@ typedef void (^MXOnResumeDone)(void);
 
         [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(onDidDecryptEvent:) name:kMXEventDidDecryptNotification object:nil];
 
+        changedRoomSummaries = [NSMutableDictionary dictionary];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(onRoomSummaryDidChange:) name:kMXRoomSummaryDidChangeNotification object:nil];
+
         [self setState:MXSessionStateInitialised];
     }
     return self;
@@ -587,13 +632,19 @@ typedef void (^MXOnResumeDone)(void);
                 completion:(void (^)(void))completion
            storeCompletion:(void (^)(void))storeCompletion
 {
-    MXLogDebug(@"[MXSession] handleSyncResponse: Received %tu joined rooms, %tu invited rooms, %tu left rooms, %tu toDevice events.", syncResponse.rooms.join.count, syncResponse.rooms.invite.count, syncResponse.rooms.leave.count, syncResponse.toDevice.events.count);
+    MXLogDebug(@"[MXSession] handleSyncResponse: Received %tu joined rooms, %tu invited rooms, %tu left rooms, %tu toDevice events.", syncResponse.rooms.join.count, syncResponse.rooms.invite.count, syncResponse.rooms.leave.count, syncResponse.toDevice.eventsCount);
     
     // Check whether this is the initial sync
     BOOL isInitialSync = !self.isEventStreamInitialised;
 
+    // Room summary changes are notified once for the whole response
+    [self beginRoomSummaryChangesBatch];
+
     [self handleCryptoEventsInSyncResponse:syncResponse onComplete:^{
         
+        // So are aggregation updates, whose store writes are grouped per run loop iteration
+        [self.aggregations beginBatch];
+        
         dispatch_group_t dispatchGroup = dispatch_group_create();
         
         // Handle top-level account data
@@ -808,6 +859,9 @@ typedef void (^MXOnResumeDone)(void);
             {
                 [self.homeserverCapabilitiesService updateWithCompletion:nil];
             }
+
+            [self.aggregations endBatch];
+            [self endRoomSummaryChangesBatch];
             
             if (completion)
             {
@@ -836,6 +890,12 @@ typedef void (^MXOnResumeDone)(void);
     
     matrixRestClient.identityServer = identityServer;
 
+    if (_identityService && ![_identityService.identityServer isEqualToString:identityServer])
+    {
+        // Forget what has been looked up with the previous identity server
+        [_identityService resetLookupCache];
+    }
+
     if (identityServer)
     {
         _identityService = [[MXIdentityService alloc] initWithIdentityServer:identityServer accessToken:accessToken andHomeserverRestClient:matrixRestClient];
@@ -1052,6 +1112,82 @@ typedef void (^MXOnResumeDone)(void);
     }];
 }
 
+- (void)startWithSlidingSync:(MXSlidingSync *)slidingSync onServerSyncDone:(void (^)(void))onServerSyncDone failure:(void (^)(NSError *))failure
+{
+    MXLogDebug(@"[MXSession] startWithSlidingSync");
+
+    if (nil == self.store)
+    {
+        // The user did not set a MXStore, use MXNoStore as default
+        MXWeakify(self);
+        [self setStore:[[MXNoStore alloc] init] success:^{
+            MXStrongifyAndReturnIfNil(self);
+            [self startWithSlidingSync:slidingSync onServerSyncDone:onServerSyncDone failure:failure];
+        } failure:^(NSError *error) {
+            MXStrongifyAndReturnIfNil(self);
+            [self setState:MXSessionStateInitialSyncFailed];
+            failure(error);
+        }];
+        return;
+    }
+
+    _slidingSync = slidingSync;
+    [self setState:MXSessionStateSyncInProgress];
+
+    // onResumeDone is called once the first response has been processed (see handleSlidingSyncResponse)
+    onResumeDone = onServerSyncDone;
+
+    MXWeakify(self);
+    [self startCrypto:^{
+        MXStrongifyAndReturnIfNil(self);
+
+        MXLogDebug(@"[MXSession] startWithSlidingSync: Crypto has been started. Start sliding sync");
+        [self.slidingSync start];
+
+    } failure:^(NSError *error) {
+        MXStrongifyAndReturnIfNil(self);
+
+        MXLogErrorDetails(@"[MXSession] startWithSlidingSync: Crypto failed to start", @{
+            @"error": error ?: @"unknown"
+        });
+
+        self->onResumeDone = nil;
+        [self setState:MXSessionStateInitialSyncFailed];
+        failure(error);
+    }];
+
+    // Refresh homeserver capabilities
+    [self refreshHomeserverCapabilities:nil failure:nil];
+}
+
+- (void)handleSlidingSyncResponse:(MXSyncResponse *)syncResponse completion:(void (^)(void))completion
+{
+    [self handleSyncResponse:syncResponse progress:nil completion:^{
+
+        self->firstSyncDone = YES;
+
+        // Inform the app that it received the last up-to-date data
+        if (self->onResumeDone)
+        {
+            // Operations on session may occur during this block. Run a copy of it.
+            MXOnResumeDone onResumeDoneCpy = [self->onResumeDone copy];
+            self->onResumeDone = nil;
+            onResumeDoneCpy();
+        }
+
+        if (self.state == MXSessionStateSyncInProgress)
+        {
+            [self setState:MXSessionStateRunning];
+        }
+
+        if (completion)
+        {
+            completion();
+        }
+
+    } storeCompletion:nil];
+}
+
 - (NSString *)syncFilterId
 {
     return self.store.syncFilterId;
@@ -1134,6 +1270,8 @@ typedef void (^MXOnResumeDone)(void);
         // Cancel the current request managing the event stream
         [eventStreamRequest cancel];
         eventStreamRequest = nil;
+        [syncPipeline cancel];
+        [_slidingSync stop];
 
         for (MXPeekingRoom *peekingRoom in peekingRooms)
         {
@@ -1182,7 +1320,12 @@ typedef void (^MXOnResumeDone)(void);
         // Resume from the last known token
         onResumeDone = resumeDone;
         
-        if (!eventStreamRequest)
+        if (_slidingSync)
+        {
+            // Relaunch sliding sync. handleSlidingSyncResponse will call onResumeDone
+            [_slidingSync start];
+        }
+        else if (!eventStreamRequest)
         {
             // Relaunch live events stream (long polling)
             [self serverSyncWithServerTimeout:0 success:nil failure:nil clientTimeout:CLIENT_TIMEOUT_MS setPresence:self.preferredSyncPresenceString];
@@ -1253,6 +1396,7 @@ typedef void (^MXOnResumeDone)(void);
         MXLogDebug(@"[MXSession] Reconnect starts");
         [eventStreamRequest cancel];
         eventStreamRequest = nil;
+        [syncPipeline cancel];
         
         // retrieve the available data asap
         // disable the long poll to get the available data asap
@@ -1273,13 +1417,18 @@ typedef void (^MXOnResumeDone)(void);
     // Cancel the current server request (if any)
     [eventStreamRequest cancel];
     eventStreamRequest = nil;
+    [syncPipeline cancel];
+    [_slidingSync stop];
+    [eventLookupCoalescer removeAllNotFoundEvents];
+    [_decryptionScheduler resetPriorities];
 
     // Flush pending direct room operations
     [directRoomsOperationsQueue removeAllObjects];
     directRoomsOperationsQueue = nil;
 
-    // Clean MXUsers
-    for (MXUser *user in self.users)
+    // Clean MXUsers. Only loaded ones can have listeners
+    NSArray<MXUser*> *loadedUsers = [self.store respondsToSelector:@selector(residentUsers)] ? self.store.residentUsers : self.users;
+    for (MXUser *user in loadedUsers)
     {
         [user removeAllListeners];
     }
@@ -1344,6 +1493,9 @@ typedef void (^MXOnResumeDone)(void);
         self.backgroundTask = nil;
     }
     
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:kMXRoomSummaryDidChangeNotification object:nil];
+    [changedRoomSummaries removeAllObjects];
+
     // Clear spaces
     [[NSNotificationCenter defaultCenter] removeObserver:self
                                                     name:MXSpaceService.didBuildSpaceGraph
@@ -1363,6 +1515,10 @@ typedef void (^MXOnResumeDone)(void);
     // Create an empty operation that will be mutated later
     MXHTTPOperation *operation = [[MXHTTPOperation alloc] init];
 
+    // Forget the contacts looked up on identity servers
+    [self.identityService resetLookupCache];
+    [MXIdentityServerLookupCache deleteFilesOfUser:self.myUserId];
+
     // Clear crypto data
     // For security and because it will be no more useful as we will get a new device id
     // on the next log in
@@ -1513,7 +1669,7 @@ typedef void (^MXOnResumeDone)(void);
         MXLogDebug(@"[MXSession] Do a server sync%@ from token: %@", _catchingUp ? @" (catching up)" : @"", streamToken);
         
         MXWeakify(self);
-        eventStreamRequest = [matrixRestClient syncFromToken:streamToken serverTimeout:serverTimeout clientTimeout:clientTimeout setPresence:setPresence filter:self.syncFilterId success:^(MXSyncResponse *liveResponse) {
+        void (^onLiveResponse)(MXSyncResponse *liveResponse) = ^(MXSyncResponse *liveResponse) {
             MXStrongifyAndReturnIfNil(self);
             
             // Make sure [MXSession close] or [MXSession pause] has not been called before the server response
@@ -1529,9 +1685,21 @@ typedef void (^MXOnResumeDone)(void);
             useLiveResponse = YES;
             
             dispatch_group_leave(initialSyncDispatchGroup);
-        } failure:^(NSError *error) {
+        };
+        void (^onLiveFailure)(NSError *error) = ^(NSError *error) {
             [self handleServerSyncError:error forRequestWithServerTimeout:serverTimeout success:success failure:failure];
-        }];
+        };
+
+        MXSyncPipeline *pipeline = self.syncPipeline;
+        if (pipeline)
+        {
+            // The next batch is requested as soon as this one is received
+            eventStreamRequest = [pipeline syncFromToken:streamToken serverTimeout:serverTimeout clientTimeout:clientTimeout setPresence:setPresence filter:self.syncFilterId success:onLiveResponse failure:onLiveFailure];
+        }
+        else
+        {
+            eventStreamRequest = [matrixRestClient syncFromToken:streamToken serverTimeout:serverTimeout clientTimeout:clientTimeout setPresence:setPresence filter:self.syncFilterId success:onLiveResponse failure:onLiveFailure];
+        }
     }
     
     dispatch_group_notify(initialSyncDispatchGroup, dispatch_get_main_queue(), ^{
@@ -1556,15 +1724,10 @@ typedef void (^MXOnResumeDone)(void);
             [self.initialSyncResponseCache addSyncResponseWithSyncResponse:response];
         }
         
-        // By default, the next sync will be a long polling (with the default server timeout value)
-        NSUInteger nextServerTimeout = SERVER_TIMEOUT_MS;
-
-        if (self.catchingUp && syncResponse.toDevice.events.count)
+        NSUInteger nextServerTimeout = [MXSession nextServerTimeoutAfterSyncResponse:syncResponse catchingUp:self.catchingUp];
+        if (nextServerTimeout == 0)
         {
-            // We may have not received all to-device events in a single /sync response
-            // Pursue /sync with short timeout
             MXLogDebug(@"[MXSession] Continue /sync with short timeout to get all to-device events (%@)", self.myUser.userId);
-            nextServerTimeout = 0;
         }
         
         // A few local constants used to calculate overall progress for a number of different steps
@@ -1640,6 +1803,7 @@ typedef void (^MXOnResumeDone)(void);
                         {
                             MXLogDebug(@"[MXSession] go to paused ");
                             self->eventStreamRequest = nil;
+                            [self->syncPipeline cancel];
                             [self setState:MXSessionStatePaused];
                             return;
                         }
@@ -1697,10 +1861,47 @@ typedef void (^MXOnResumeDone)(void);
         } storeCompletion:^{
             //  clear initial sync cache after handling sync response
             [self.initialSyncResponseCache deleteData];
+
+            // The pipeline can now request the batch that follows this response
+            [self->syncPipeline didStoreSyncResponse:syncResponse];
         }];
     });
 }
 
++ (NSUInteger)nextServerTimeoutAfterSyncResponse:(MXSyncResponse*)syncResponse catchingUp:(BOOL)catchingUp
+{
+    // By default, the next sync will be a long polling (with the default server timeout value)
+    NSUInteger nextServerTimeout = SERVER_TIMEOUT_MS;
+
+    if (catchingUp && syncResponse.toDevice.eventsCount)
+    {
+        // We may have not received all to-device events in a single /sync response
+        // Pursue /sync with short timeout
+        nextServerTimeout = 0;
+    }
+
+    return nextServerTimeout;
+}
+
+- (MXSyncPipeline*)syncPipeline
+{
+    NSUInteger maxDepth = MXSDKOptions.sharedInstance.syncPipelineDepth;
+    if (!maxDepth)
+    {
+        [syncPipeline cancel];
+        syncPipeline = nil;
+    }
+    else if (!syncPipeline || syncPipeline.maxDepth != maxDepth)
+    {
+        [syncPipeline cancel];
+        syncPipeline = [[MXSyncPipeline alloc] initWithRestClient:matrixRestClient maxDepth:maxDepth];
+        syncPipeline.nextServerTimeoutBlock = ^NSUInteger(NSUInteger serverTimeout, MXSyncResponse *syncResponse) {
+            return [MXSession nextServerTimeoutAfterSyncResponse:syncResponse catchingUp:(0 == serverTimeout)];
+        };
+    }
+    return syncPipeline;
+}
+
 - (void)handleServerSyncError:(NSError*)error forRequestWithServerTimeout:(NSUInteger)serverTimeout success:(void (^)(void))success failure:(void (^)(NSError *error))failure
 {
     // Make sure [MXSession close] or [MXSession pause] has not been called before the server response
@@ -1733,6 +1934,7 @@ typedef void (^MXOnResumeDone)(void);
             {
                 MXLogDebug(@"[MXSession] go to paused ");
                 self->eventStreamRequest = nil;
+                [self->syncPipeline cancel];
                 [self setState:MXSessionStatePaused];
                 return;
             }
@@ -1769,6 +1971,7 @@ typedef void (^MXOnResumeDone)(void);
             // The reconnection attempt failed on timeout: there is no data to retrieve from server
             [self->eventStreamRequest cancel];
             self->eventStreamRequest = nil;
+            [self->syncPipeline cancel];
 
             // Notify the reconnection attempt has been done.
             [[NSNotificationCenter defaultCenter] postNotificationName:kMXSessionDidSyncNotification
@@ -3038,7 +3241,7 @@ typedef void (^MXOnResumeDone)(void);
 - (void)addRoom:(MXRoom*)room notify:(BOOL)notify
 {
     // Register global listeners for this room
-    for (MXSessionEventListener *listener in globalEventListeners)
+    for (MXSessionEventListener *listener in globalEventListeners.listeners)
     {
         [listener addRoomToSpy:room];
     }
@@ -3071,7 +3274,7 @@ typedef void (^MXOnResumeDone)(void);
     if (room)
     {
         // Unregister global listeners for this room
-        for (MXSessionEventListener *listener in globalEventListeners)
+        for (MXSessionEventListener *listener in globalEventListeners.listeners)
         {
             [listener removeSpiedRoom:room];
         }
@@ -3161,7 +3364,6 @@ typedef void (^MXOnResumeDone)(void);
         }
         return [MXHTTPOperation new];
     }
-    MXHTTPOperation *operation = [MXHTTPOperation new];
 
     void (^decryptIfNeeded)(MXEvent *event) = ^(MXEvent *event) {
         [self decryptEvents:@[event] inTimeline:nil onComplete:^(NSArray<MXEvent *> *failedEvents) {
@@ -3172,41 +3374,130 @@ typedef void (^MXOnResumeDone)(void);
         }];
     };
     
-    if (roomId)
+    // Try to find it from the store first
+    // (this operation requires a roomId for the moment)
+    MXEvent *event = roomId ? [self localEventWithEventId:eventId inRoom:roomId] : nil;
+    if (event)
     {
-        // Try to find it from the store first
-        // (this operation requires a roomId for the moment)
-        MXEvent *event = [self.store eventWithEventId:eventId inRoom:roomId];
-        
-        //  also search in local event
-        if (!event)
+        decryptIfNeeded(event);
+        return [MXHTTPOperation new];
+    }
+
+    return [self requestEventWithEventId:eventId inRoom:roomId success:decryptIfNeeded failure:failure];
+}
+
+- (MXHTTPOperation*)eventsWithEventIds:(NSDictionary<NSString*, NSArray<NSString*>*> *)eventIdsByRoomId
+                            completion:(void (^)(NSDictionary<NSString*, MXEvent*> *events))completion
+{
+    // Look for events locally first
+    NSMutableDictionary<NSString*, NSMutableArray<MXEvent*>*> *localEventsByRoomId = [NSMutableDictionary dictionary];
+    NSMutableDictionary<NSString*, NSArray<NSString*>*> *missingEventIdsByRoomId = [NSMutableDictionary dictionary];
+    for (NSString *roomId in eventIdsByRoomId)
+    {
+        NSMutableArray<MXEvent*> *localEvents = [NSMutableArray array];
+        NSMutableArray<NSString*> *missingEventIds = [NSMutableArray array];
+        for (NSString *eventId in eventIdsByRoomId[roomId])
         {
-            NSArray<MXEvent *> *outgoingMessages = [self.store outgoingMessagesInRoom:roomId];
-            for (MXEvent *localEvent in outgoingMessages)
+            MXEvent *event = [self localEventWithEventId:eventId inRoom:roomId];
+            if (event)
             {
-                if ([localEvent.eventId isEqualToString:eventId])
-                {
-                    event = localEvent;
-                    break;
-                }
+                [localEvents addObject:event];
+            }
+            else
+            {
+                [missingEventIds addObject:eventId];
             }
         }
-
-        if (event)
+        localEventsByRoomId[roomId] = localEvents;
+        if (missingEventIds.count)
         {
-            decryptIfNeeded(event);
+            missingEventIdsByRoomId[roomId] = missingEventIds;
         }
-        else
+    }
+
+    MXWeakify(self);
+    return [eventLookupCoalescer eventsWithEventIds:missingEventIdsByRoomId request:^MXHTTPOperation *(NSString *eventId, NSString *roomId, void (^requestSuccess)(MXEvent *), void (^requestFailure)(NSError *)) {
+        MXStrongifyAndReturnValueIfNil(self, [MXHTTPOperation new]);
+        return [self->matrixRestClient eventWithEventId:eventId inRoom:roomId success:requestSuccess failure:requestFailure];
+    } completion:^(NSDictionary<NSString *,NSArray<MXEvent *> *> *fetchedEventsByRoomId) {
+        MXStrongifyAndReturnIfNil(self);
+
+        // Decrypt events room by room
+        NSMutableDictionary<NSString*, MXEvent*> *events = [NSMutableDictionary dictionary];
+        dispatch_group_t group = dispatch_group_create();
+        for (NSString *roomId in localEventsByRoomId)
         {
-            operation = [matrixRestClient eventWithEventId:eventId inRoom:roomId success:decryptIfNeeded failure:failure];
+            NSMutableArray<MXEvent*> *roomEvents = localEventsByRoomId[roomId];
+            [roomEvents addObjectsFromArray:fetchedEventsByRoomId[roomId] ?: @[]];
+            if (!roomEvents.count)
+            {
+                continue;
+            }
+
+            dispatch_group_enter(group);
+            [self decryptEvents:roomEvents inTimeline:nil onComplete:^(NSArray<MXEvent *> *failedEvents) {
+                for (MXEvent *event in roomEvents)
+                {
+                    events[event.eventId] = event;
+                }
+                dispatch_group_leave(group);
+            }];
         }
+
+        dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+            completion(events);
+        });
+    }];
+}
+
+/**
+ Find an event in the store or in the outgoing messages of a room.
+ */
+- (MXEvent*)localEventWithEventId:(NSString*)eventId inRoom:(NSString*)roomId
+{
+    MXEvent *event = [self.store eventWithEventId:eventId inRoom:roomId];
+    if (event)
+    {
+        return event;
     }
-    else
+
+    //  also search in local event
+    if ([self.store respondsToSelector:@selector(outgoingMessageWithEventId:inRoom:)])
     {
-        operation = [matrixRestClient eventWithEventId:eventId success:decryptIfNeeded failure:failure];
+        return [self.store outgoingMessageWithEventId:eventId inRoom:roomId];
     }
 
-    return operation;
+    for (MXEvent *localEvent in [self.store outgoingMessagesInRoom:roomId])
+    {
+        if ([localEvent.eventId isEqualToString:eventId])
+        {
+            return localEvent;
+        }
+    }
+    return nil;
+}
+
+/**
+ Fetch an event from the homeserver. The event is not decrypted.
+
+ Concurrent requests of the same event are shared and events that were not found recently are
+ not requested again.
+ */
+- (MXHTTPOperation*)requestEventWithEventId:(NSString*)eventId
+                                     inRoom:(NSString*)roomId
+                                    success:(void (^)(MXEvent *event))success
+                                    failure:(void (^)(NSError *error))failure
+{
+    MXWeakify(self);
+    return [eventLookupCoalescer eventWithEventId:eventId inRoom:roomId request:^MXHTTPOperation *(void (^requestSuccess)(MXEvent *), void (^requestFailure)(NSError *)) {
+        MXStrongifyAndReturnValueIfNil(self, [MXHTTPOperation new]);
+
+        if (roomId)
+        {
+            return [self->matrixRestClient eventWithEventId:eventId inRoom:roomId success:requestSuccess failure:requestFailure];
+        }
+        return [self->matrixRestClient eventWithEventId:eventId success:requestSuccess failure:requestFailure];
+    } success:success failure:failure];
 }
 
 
@@ -4939,23 +5230,59 @@ typedef void (^MXOnResumeDone)(void);
     
     if (_crypto)
     {
-        [_crypto decryptEvents:eventsToDecrypt inTimeline:timeline onComplete:^(NSArray<MXEventDecryptionResult *> *results) {
-            NSMutableArray<MXEvent *> *failedEvents = [NSMutableArray array];
-            for (NSUInteger index = 0; index < eventsToDecrypt.count; index++)
+        // Submit one job per room to the scheduler so that events of displayed rooms go first
+        NSMutableDictionary<NSString*, NSMutableArray<MXEvent*>*> *eventsToDecryptByRoomId = [NSMutableDictionary dictionary];
+        for (MXEvent *event in eventsToDecrypt)
+        {
+            NSString *roomId = event.roomId ?: @"";
+            if (!eventsToDecryptByRoomId[roomId])
             {
-                MXEvent *event = eventsToDecrypt[index];
-                MXEventDecryptionResult *result = results[index];
-                
-                [event setClearData:result];
+                eventsToDecryptByRoomId[roomId] = [NSMutableArray array];
+            }
+            [eventsToDecryptByRoomId[roomId] addObject:event];
+        }
+
+        id<MXCrypto> crypto = _crypto;
+        NSHashTable<MXEvent*> *failedEventsTable = [NSHashTable hashTableWithOptions:NSPointerFunctionsObjectPointerPersonality];
+        __block NSUInteger pendingRoomsCount = eventsToDecryptByRoomId.count;
+        
+        for (NSString *roomId in eventsToDecryptByRoomId)
+        {
+            [_decryptionScheduler decryptEvents:eventsToDecryptByRoomId[roomId] inRoom:roomId chunkBlock:^(NSArray<MXEvent *> *chunk, dispatch_block_t onChunkComplete) {
+                [crypto decryptEvents:chunk inTimeline:timeline onComplete:^(NSArray<MXEventDecryptionResult *> *results) {
+                    for (NSUInteger index = 0; index < chunk.count; index++)
+                    {
+                        MXEvent *event = chunk[index];
+                        MXEventDecryptionResult *result = results[index];
+                        
+                        [event setClearData:result];
+                        
+                        if (result.error)
+                        {
+                            [failedEventsTable addObject:event];
+                        }
+                    }
+                    onChunkComplete();
+                }];
+            } onComplete:^{
+                if (--pendingRoomsCount > 0)
+                {
+                    return;
+                }
                 
-                if (result.error)
+                // Keep the order of the submitted events
+                NSMutableArray<MXEvent *> *failedEvents = [NSMutableArray array];
+                for (MXEvent *event in eventsToDecrypt)
                 {
-                    [failedEvents addObject:event];
+                    if ([failedEventsTable containsObject:event])
+                    {
+                        [failedEvents addObject:event];
+                    }
                 }
-            }
-
-            onComplete(failedEvents);
-        }];
+                
+                onComplete(failedEvents);
+            }];
+        }
     }
     else
     {
@@ -5005,6 +5332,70 @@ typedef void (^MXOnResumeDone)(void);
     }
 }
 
+#pragma mark - Room summary changes
+
+- (void)onRoomSummaryDidChange:(NSNotification*)notification
+{
+    MXRoomSummary *summary = notification.object;
+    if (![summary isKindOfClass:MXRoomSummary.class] || summary.mxSession != self || !summary.roomId)
+    {
+        return;
+    }
+
+    changedRoomSummaries[summary.roomId] = summary;
+
+    if (!roomSummaryChangesBatchCount && !roomSummaryChangesFlushScheduled)
+    {
+        // Coalesce changes done outside a sync in the same run loop iteration
+        roomSummaryChangesFlushScheduled = YES;
+        MXWeakify(self);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            MXStrongifyAndReturnIfNil(self);
+            self->roomSummaryChangesFlushScheduled = NO;
+            if (!self->roomSummaryChangesBatchCount)
+            {
+                [self flushRoomSummaryChanges];
+            }
+        });
+    }
+}
+
+- (void)beginRoomSummaryChangesBatch
+{
+    roomSummaryChangesBatchCount++;
+}
+
+- (void)endRoomSummaryChangesBatch
+{
+    if (roomSummaryChangesBatchCount && !--roomSummaryChangesBatchCount)
+    {
+        [self flushRoomSummaryChanges];
+    }
+}
+
+- (void)flushRoomSummaryChanges
+{
+    if (!changedRoomSummaries.count)
+    {
+        return;
+    }
+
+    NSMutableArray<MXRoomSummaryChange*> *changes = [NSMutableArray arrayWithCapacity:changedRoomSummaries.count];
+    for (MXRoomSummary *summary in changedRoomSummaries.allValues)
+    {
+        // The summary notified a change, even if it is not in a tracked group of fields
+        MXRoomSummaryChangedFields changedFields = [summary consumeChangedFields] ?: MXRoomSummaryChangedFieldsOther;
+        [changes addObject:[[MXRoomSummaryChange alloc] initWithSummary:summary changedFields:changedFields]];
+    }
+    [changedRoomSummaries removeAllObjects];
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:kMXSessionDidUpdateRoomSummariesNotification
+                                                        object:self
+                                                      userInfo:@{
+                                                          kMXSessionNotificationRoomSummaryChangesKey: changes
+                                                      }];
+}
+
 #pragma mark - Global events listeners
 - (id)listenToEvents:(MXOnSessionEvent)onEvent
 {
@@ -5021,7 +5412,7 @@ typedef void (^MXOnResumeDone)(void);
         [listener addRoomToSpy:room];
     }
     
-    [globalEventListeners addObject:listener];
+    [globalEventListeners addListener:listener];
     
     return listener;
 }
@@ -5033,14 +5424,14 @@ typedef void (^MXOnResumeDone)(void);
     [listener removeAllSpiedRooms];
     
     // Before removing it
-    [globalEventListeners removeObject:listener];
+    [globalEventListeners removeListener:listener];
 }
 
 - (void)removeAllListeners
 {
     // must be done before deleted the listeners to avoid
     // ollection <__NSArrayM: ....> was mutated while being enumerated.'
-    NSArray* eventListeners = [globalEventListeners copy];
+    NSArray* eventListeners = globalEventListeners.listeners;
     
     for (MXSessionEventListener *listener in eventListeners)
     {
@@ -5050,15 +5441,15 @@ typedef void (^MXOnResumeDone)(void);
 
 - (void)notifyListeners:(MXEvent*)event direction:(MXTimelineDirection)direction
 {
-    // Notify all listeners
+    // Notify the listeners of this event type
     // The SDK client may remove a listener while calling them by enumeration
     // So, use a copy of them
-    NSArray *listeners = [globalEventListeners copy];
+    NSArray *listeners = [globalEventListeners listenersForEvent:event];
 
     for (MXEventListener *listener in listeners)
     {
         // And check the listener still exists before calling it
-        if (NSNotFound != [globalEventListeners indexOfObject:listener])
+        if ([globalEventListeners containsListener:listener])
         {
             [listener notify:event direction:direction andCustomObject:nil];
         }
@@ -37,6 +37,7 @@ FOUNDATION_EXPORT NSString *MatrixSDKVersion;
 
 #import "MXRoomSummaryProtocol.h"
 #import "MXRoomSummaryUpdater.h"
+#import "MXDecryptionScheduler.h"
 
 #import "MXEventsEnumeratorOnArray.h"
 #import "MXEventsByTypesEnumeratorOnArray.h"
@@ -46,6 +47,7 @@ FOUNDATION_EXPORT NSString *MatrixSDKVersion;
 
 #import "MXTools.h"
 #import "MXThrottler.h"
+#import "MXHTTPRequestScheduler.h"
 #import "NSData+MatrixSDK.h"
 #import "MXMatrixVersions.h"
 #import "MXCapabilities.h"
@@ -55,6 +57,7 @@ FOUNDATION_EXPORT NSString *MatrixSDKVersion;
 #import "MXSDKOptions.h"
 
 #import "MXMediaManager.h"
+#import "MXImageCache.h"
 
 #import "MXLRUCache.h"
 
@@ -189,6 +192,7 @@ FOUNDATION_EXPORT NSString *MatrixSDKVersion;
 #import "MXGroupsSyncResponse.h"
 #import "MXInvitedGroupSync.h"
 #import "MXGroupSyncProfile.h"
+#import "MXSlidingSyncResponse.h"
 #import "MXBeaconInfo.h"
 #import "MXBeacon.h"
 #import "MXEventAssetType.h"
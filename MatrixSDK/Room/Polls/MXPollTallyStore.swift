@@ -0,0 +1,318 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import Foundation
+
+/// `MXPollTallyStore` persists the tallies of the polls that have been displayed, keyed by poll start event id.
+///
+/// Once a poll has a snapshot, live poll responses and ends are applied to it even when no `PollAggregator`
+/// is alive, so that reopening the poll neither refetches nor refolds its history.
+/// Snapshots of a room are dropped when its timeline has a gap.
+/// Undecryptable references to a poll are recorded in its snapshot and applied once they are decrypted.
+///
+/// Snapshots updated by live events are written before the session store commits these events, see
+/// `writePendingSnapshots()`. A snapshot can be newer than the store, never older: events received
+/// again are applied once.
+///
+/// This class must be used from the main thread. Files are written on a background queue.
+@objcMembers
+public final class MXPollTallyStore: NSObject {
+
+    // MARK: - Constants
+
+    private enum Constants {
+        static let fileStoreFolder = "MXPollTallyStore"
+        static let fileExtension = "json"
+        static let writeDelay: TimeInterval = 0.5
+    }
+
+    // MARK: - Properties
+
+    private let storeUrl: URL?
+    private let ioQueue = DispatchQueue(label: "MXPollTallyStore")
+
+    /// Poll start event ids of the stored snapshots by room id
+    private var pollStartEventIdsByRoom: [String: Set<String>] = [:]
+
+    /// Snapshots loaded in memory by poll start event id
+    private var tallies: [String: PollTally] = [:]
+
+    /// Snapshots waiting to be written
+    private var pendingWrites: [String: PollTally] = [:]
+    private var isWriteScheduled = false
+
+    // MARK: - Setup
+
+    public convenience init(userId: String) {
+        var cacheUrl: URL?
+        if let container = FileManager.default.applicationGroupContainerURL() {
+            cacheUrl = container
+        } else {
+            cacheUrl = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first
+        }
+
+        self.init(storeUrl: cacheUrl?.appendingPathComponent(Constants.fileStoreFolder).appendingPathComponent(userId))
+    }
+
+    init(storeUrl: URL?) {
+        self.storeUrl = storeUrl
+        super.init()
+
+        setUpStoragePath()
+
+        NotificationCenter.default.addObserver(self, selector: #selector(handleRoomDataFlush), name: .mxRoomDidFlushData, object: nil)
+        NotificationCenter.default.addObserver(self, selector: #selector(handleEventDidDecrypt), name: .mxEventDidDecrypt, object: nil)
+    }
+
+    deinit {
+        NotificationCenter.default.removeObserver(self)
+    }
+
+    // MARK: - Public
+
+    /// Apply a live poll response or poll end event to the snapshot of its poll, if any.
+    /// Undecryptable events that reference the poll are recorded to be applied once decrypted.
+    public func handlePollEvent(_ event: MXEvent) {
+        guard
+            event.relatesTo?.relationType == MXEventRelationTypeReference,
+            let pollStartEventId = event.relatesTo?.eventId,
+            let roomId = event.roomId,
+            var tally = tally(forPollStartEventId: pollStartEventId, inRoom: roomId)
+        else {
+            return
+        }
+
+        if tally.apply(event) {
+            store(tally)
+        }
+    }
+
+    /// Remove the snapshots of the polls of a room.
+    public func removeSnapshots(inRoom roomId: String) {
+        guard let pollStartEventIds = pollStartEventIdsByRoom.removeValue(forKey: roomId) else {
+            return
+        }
+
+        for pollStartEventId in pollStartEventIds {
+            tallies.removeValue(forKey: pollStartEventId)
+            pendingWrites.removeValue(forKey: pollStartEventId)
+        }
+
+        guard let roomUrl = roomUrl(forRoom: roomId) else {
+            return
+        }
+        ioQueue.async {
+            try? FileManager.default.removeItem(at: roomUrl)
+        }
+    }
+
+    /// Write the pending snapshots and return once they are on disk.
+    ///
+    /// It must be called before the session store commits the events applied to the snapshots. Else, if the
+    /// app is killed in between, their votes would be lost: the events will not be received again.
+    public func writePendingSnapshots() {
+        guard !pendingWrites.isEmpty else {
+            return
+        }
+
+        let writes = takePendingWrites()
+        ioQueue.sync {
+            write(writes)
+        }
+    }
+
+    /// Remove all snapshots.
+    public func removeAllSnapshots() {
+        pollStartEventIdsByRoom.removeAll()
+        tallies.removeAll()
+        pendingWrites.removeAll()
+
+        guard let storeUrl = storeUrl else {
+            return
+        }
+        ioQueue.async {
+            try? FileManager.default.removeItem(at: storeUrl)
+            try? FileManager.default.createDirectoryExcludedFromBackup(at: storeUrl)
+        }
+    }
+
+    // MARK: - Internal
+
+    /// Get the snapshot of a poll.
+    func tally(forPollStartEventId pollStartEventId: String, inRoom roomId: String) -> PollTally? {
+        if let tally = tallies[pollStartEventId] {
+            return tally
+        }
+
+        guard
+            pollStartEventIdsByRoom[roomId]?.contains(pollStartEventId) == true,
+            let fileUrl = fileUrl(forPollStartEventId: pollStartEventId, inRoom: roomId)
+        else {
+            return nil
+        }
+
+        // Pending writes are in `tallies`, the file is up to date
+        var tally: PollTally?
+        ioQueue.sync {
+            if let data = try? Data(contentsOf: fileUrl) {
+                tally = try? JSONDecoder().decode(PollTally.self, from: data)
+            }
+        }
+
+        guard let tally = tally, tally.pollStartEventId == pollStartEventId else {
+            MXLog.warning("[MXPollTallyStore] tally: Invalid snapshot")
+            pollStartEventIdsByRoom[roomId]?.remove(pollStartEventId)
+            return nil
+        }
+
+        tallies[pollStartEventId] = tally
+        return tally
+    }
+
+    /// Store the snapshot of a poll.
+    func store(_ tally: PollTally) {
+        tallies[tally.pollStartEventId] = tally
+        pollStartEventIdsByRoom[tally.roomId, default: []].insert(tally.pollStartEventId)
+
+        pendingWrites[tally.pollStartEventId] = tally
+        scheduleWrite()
+    }
+
+    /// Write the pending snapshots now.
+    /// - Parameter completion: called on the main queue once the files, and those of previous removals, are written.
+    func flush(completion: (() -> Void)? = nil) {
+        let writes = takePendingWrites()
+        ioQueue.async {
+            self.write(writes)
+
+            if let completion = completion {
+                DispatchQueue.main.async(execute: completion)
+            }
+        }
+    }
+
+    // MARK: - Private
+
+    /// Take the pending snapshots with the files to write them to.
+    private func takePendingWrites() -> [(tally: PollTally, fileUrl: URL)] {
+        let writes = pendingWrites.values.compactMap { tally in
+            fileUrl(forPollStartEventId: tally.pollStartEventId, inRoom: tally.roomId).map { (tally, $0) }
+        }
+        pendingWrites.removeAll()
+        return writes
+    }
+
+    /// Write snapshots. Must be called on `ioQueue`.
+    private func write(_ writes: [(tally: PollTally, fileUrl: URL)]) {
+        let encoder = JSONEncoder()
+        for (tally, fileUrl) in writes {
+            do {
+                try FileManager.default.createDirectory(at: fileUrl.deletingLastPathComponent(), withIntermediateDirectories: true)
+                try encoder.encode(tally).write(to: fileUrl, options: .atomic)
+            } catch {
+                MXLog.error("[MXPollTallyStore] write: Failed to write snapshot", context: error)
+            }
+        }
+    }
+
+    private func scheduleWrite() {
+        guard !isWriteScheduled else {
+            return
+        }
+
+        // Coalesce the writes of busy polls
+        isWriteScheduled = true
+        DispatchQueue.main.asyncAfter(deadline: .now() + Constants.writeDelay) { [weak self] in
+            guard let self = self else {
+                return
+            }
+
+            self.isWriteScheduled = false
+            self.flush()
+        }
+    }
+
+    @objc private func handleEventDidDecrypt(sender: Notification) {
+        guard
+            let event = sender.object as? MXEvent,
+            let eventId = event.eventId,
+            let pollStartEventId = event.relatesTo?.eventId,
+            let roomId = event.roomId,
+            var tally = tally(forPollStartEventId: pollStartEventId, inRoom: roomId),
+            tally.undecryptableEventIds.contains(eventId)
+        else {
+            return
+        }
+
+        if tally.apply(event) {
+            store(tally)
+        }
+    }
+
+    @objc private func handleRoomDataFlush(sender: Notification) {
+        guard let room = sender.object as? MXRoom, let roomId = room.roomId else {
+            return
+        }
+
+        // Events may have been missed in the gap
+        removeSnapshots(inRoom: roomId)
+    }
+
+    private func setUpStoragePath() {
+        guard let storeUrl = storeUrl else {
+            MXLog.error("[MXPollTallyStore] setUpStoragePath: storeUrl not defined")
+            return
+        }
+
+        do {
+            try FileManager.default.createDirectoryExcludedFromBackup(at: storeUrl)
+        } catch {
+            MXLog.error("[MXPollTallyStore] setUpStoragePath: Unable to create the store folder", context: error)
+            return
+        }
+
+        // Only index the snapshots. They are loaded on demand
+        let roomUrls = (try? FileManager.default.contentsOfDirectory(at: storeUrl, includingPropertiesForKeys: nil)) ?? []
+        for roomUrl in roomUrls {
+            guard let roomId = roomUrl.lastPathComponent.removingPercentEncoding else {
+                continue
+            }
+
+            let fileUrls = (try? FileManager.default.contentsOfDirectory(at: roomUrl, includingPropertiesForKeys: nil)) ?? []
+            let pollStartEventIds = fileUrls
+                .filter { $0.pathExtension == Constants.fileExtension }
+                .compactMap { $0.deletingPathExtension().lastPathComponent.removingPercentEncoding }
+
+            if !pollStartEventIds.isEmpty {
+                pollStartEventIdsByRoom[roomId] = Set(pollStartEventIds)
+            }
+        }
+    }
+
+    private func roomUrl(forRoom roomId: String) -> URL? {
+        guard let storeUrl = storeUrl, let component = roomId.addingPercentEncoding(withAllowedCharacters: .alphanumerics) else {
+            return nil
+        }
+        return storeUrl.appendingPathComponent(component)
+    }
+
+    private func fileUrl(forPollStartEventId pollStartEventId: String, inRoom roomId: String) -> URL? {
+        guard let roomUrl = roomUrl(forRoom: roomId), let component = pollStartEventId.addingPercentEncoding(withAllowedCharacters: .alphanumerics) else {
+            return nil
+        }
+        return roomUrl.appendingPathComponent(component).appendingPathExtension(Constants.fileExtension)
+    }
+}
@@ -31,6 +31,8 @@ public protocol PollAggregatorDelegate: AnyObject {
 /**
  Responsible for building poll models out of the original poll start event and listen to replies.
  It will listen for PollResponse and PollEnd events on the live timline and update the built models accordingly.
+ Responses are counted incrementally and the tally is persisted in the session `MXPollTallyStore` so that
+ reopening the poll does not fetch and count its whole history again.
  I will also listen for `mxRoomDidFlushData` and reload all data to avoid gappy sync problems
 */
 
@@ -51,7 +53,7 @@ public class PollAggregator {
     private var referenceEventsListener: Any?
     private var editEventsListener: Any?
     
-    private var events: [MXEvent] = []
+    private var tally: PollTally?
     private var hasBeenEdited = false
     
     public private(set) var poll: PollProtocol? {
@@ -99,10 +101,13 @@ public class PollAggregator {
         self.delegate = delegate
         
         NotificationCenter.default.addObserver(self, selector: #selector(handleRoomDataFlush), name: .mxRoomDidFlushData, object: self.room)
+        NotificationCenter.default.addObserver(self, selector: #selector(handleEventDidDecrypt), name: .mxEventDidDecrypt, object: nil)
         setupEditListener()
         buildPollStartContent()
         
-        reloadPollData()
+        if !restorePollData() {
+            reloadPollData()
+        }
     }
     
     private func setupEditListener() {
@@ -120,12 +125,14 @@ public class PollAggregator {
     private func buildPollStartContent() {
         let event = session.store.event(withEventId: pollStartEventId, inRoom: room.roomId)
         tryUpdatePollStartedEvent(with: event)
-        if let pollStartedEvent = pollStartedEvent {
-            poll = pollBuilder.build(pollStartEventContent: pollStartEventContent,
-                                     pollStartEvent: pollStartedEvent,
-                                     events: events,
-                                     currentUserIdentifier: session.myUserId,
-                                     hasBeenEdited: hasBeenEdited)
+        if pollStartedEvent != nil {
+            // An edition can change the number of allowed answers
+            if var tally = tally {
+                tally.update(maxAllowedSelections: pollStartEventContent.maxSelections.uintValue)
+                updateTally(tally)
+            }
+            
+            buildPoll()
         }
     }
 
@@ -152,6 +159,45 @@ public class PollAggregator {
         reloadPollData()
     }
     
+    @objc private func handleEventDidDecrypt(sender: Notification) {
+        guard
+            var tally = tally,
+            let event = sender.object as? MXEvent,
+            let eventId = event.eventId,
+            tally.undecryptableEventIds.contains(eventId),
+            event.relatesTo?.eventId == pollStartEventId
+        else {
+            return
+        }
+        
+        if tally.apply(event) {
+            updateTally(tally)
+            buildPoll()
+        }
+    }
+    
+    /// Restore the tally stored the last time the poll was aggregated.
+    /// - Returns: false if there is no stored tally.
+    private func restorePollData() -> Bool {
+        guard
+            pollStartedEvent != nil,
+            var tally = session.aggregations.pollTallyStore.tally(forPollStartEventId: pollStartEventId, inRoom: room.roomId)
+        else {
+            return false
+        }
+        
+        delegate?.pollAggregatorDidStartLoading(self)
+
+        self.tally = tally
+        tally.update(maxAllowedSelections: pollStartEventContent.maxSelections.uintValue)
+        updateTally(tally)
+        listenToReferenceEvents()
+        buildPoll()
+        
+        delegate?.pollAggregatorDidEndLoading(self)
+        return true
+    }
+    
     private func reloadPollData() {
         delegate?.pollAggregatorDidStartLoading(self)
         
@@ -165,33 +211,16 @@ public class PollAggregator {
                 return
             }
             
-            self.events.removeAll()
-            self.events.append(contentsOf: response.chunk)
+            var tally = PollTally(pollStartEventId: self.pollStartEventId,
+                                  roomId: self.room.roomId,
+                                  maxAllowedSelections: self.pollStartEventContent.maxSelections.uintValue)
+            for event in response.chunk {
+                tally.apply(event)
+            }
+            self.updateTally(tally)
             
-            let eventTypes = [kMXEventTypeStringPollResponse, kMXEventTypeStringPollResponseMSC3381, kMXEventTypeStringPollEnd, kMXEventTypeStringPollEndMSC3381]
-            self.referenceEventsListener = self.room.listen(toEventsOfTypes: eventTypes) { [weak self] event, direction, state in
-                guard
-                    let self = self,
-                    let relatedEventId = event.relatesTo?.eventId,
-                    relatedEventId == self.pollStartEventId
-                else {
-                    return
-                }
-                
-                self.events.append(event)
-                
-                self.poll = self.pollBuilder.build(pollStartEventContent: self.pollStartEventContent,
-                                                   pollStartEvent: self.pollStartedEvent,
-                                                   events: self.events,
-                                                   currentUserIdentifier: self.session.myUserId,
-                                                   hasBeenEdited: self.hasBeenEdited)
-            } as Any
-
-            self.poll = self.pollBuilder.build(pollStartEventContent: self.pollStartEventContent,
-                                               pollStartEvent: self.pollStartedEvent,
-                                               events: self.events,
-                                               currentUserIdentifier: self.session.myUserId,
-                                               hasBeenEdited: self.hasBeenEdited)
+            self.listenToReferenceEvents()
+            self.buildPoll()
             
             self.delegate?.pollAggregatorDidEndLoading(self)
             
@@ -203,4 +232,54 @@ public class PollAggregator {
             self.delegate?.pollAggregator(self, didFailWithError: error)
         }
     }
+    
+    private func listenToReferenceEvents() {
+        if let referenceEventsListener = referenceEventsListener {
+            room.removeListener(referenceEventsListener)
+        }
+        
+        // Undecryptable votes are recorded in the tally until they are decrypted
+        let eventTypes = [kMXEventTypeStringPollResponse, kMXEventTypeStringPollResponseMSC3381, kMXEventTypeStringPollEnd, kMXEventTypeStringPollEndMSC3381, kMXEventTypeStringRoomEncrypted]
+        referenceEventsListener = room.listen(toEventsOfTypes: eventTypes) { [weak self] event, direction, state in
+            guard
+                let self = self,
+                var tally = self.tally,
+                let relatedEventId = event.relatesTo?.eventId,
+                relatedEventId == self.pollStartEventId
+            else {
+                return
+            }
+            
+            // Only the votes of the sender are counted again
+            if tally.apply(event) {
+                self.updateTally(tally)
+                self.buildPoll()
+            }
+        } as Any
+    }
+    
+    private func updateTally(_ tally: PollTally) {
+        guard tally != self.tally else {
+            return
+        }
+        
+        self.tally = tally
+        session.aggregations.pollTallyStore.store(tally)
+    }
+    
+    private func buildPoll() {
+        guard let pollStartedEvent = pollStartedEvent else {
+            return
+        }
+        
+        let tally = self.tally ?? PollTally(pollStartEventId: pollStartEventId,
+                                             roomId: room.roomId,
+                                             maxAllowedSelections: pollStartEventContent.maxSelections.uintValue)
+        
+        poll = pollBuilder.build(pollStartEventContent: pollStartEventContent,
+                                 pollStartEvent: pollStartedEvent,
+                                 tally: tally,
+                                 currentUserIdentifier: session.myUserId,
+                                 hasBeenEdited: hasBeenEdited)
+    }
 }
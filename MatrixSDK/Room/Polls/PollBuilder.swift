@@ -28,11 +28,31 @@ struct PollBuilder {
                currentUserIdentifier: String,
                hasBeenEdited: Bool = false) -> PollProtocol {
         
+        var tally = PollTally(pollStartEventId: pollStartEvent.eventId,
+                              roomId: pollStartEvent.roomId ?? "",
+                              maxAllowedSelections: pollStartEventContent.maxSelections.uintValue)
+        for event in events {
+            tally.apply(event)
+        }
+        
+        return build(pollStartEventContent: pollStartEventContent,
+                     pollStartEvent: pollStartEvent,
+                     tally: tally,
+                     currentUserIdentifier: currentUserIdentifier,
+                     hasBeenEdited: hasBeenEdited)
+    }
+    
+    func build(pollStartEventContent: MXEventContentPollStart,
+               pollStartEvent: MXEvent,
+               tally: PollTally,
+               currentUserIdentifier: String,
+               hasBeenEdited: Bool = false) -> PollProtocol {
+        
         let poll = Poll()
         poll.id = pollStartEvent.eventId
         poll.startDate = Date(timeIntervalSince1970: Double(pollStartEvent.originServerTs) / 1000)
         poll.hasBeenEdited = hasBeenEdited
-        poll.hasDecryptionError = events.contains(where: { $0.isEncrypted && $0.clear == nil })
+        poll.hasDecryptionError = tally.hasDecryptionError
         
         poll.text = pollStartEventContent.question
         poll.maxAllowedSelections = max(1, pollStartEventContent.maxSelections.uintValue)
@@ -46,101 +66,24 @@ struct PollBuilder {
             poll.kind = .undisclosed
         }
         
-        var answerOptionIdentifiers = [String]()
         poll.answerOptions = pollStartEventContent.answerOptions.prefix(Constants.maxAnswerOptionCount).map { answerOption in
-            answerOptionIdentifiers.append(answerOption.uuid)
-            
             let option = PollAnswerOption()
             option.id = answerOption.uuid
             option.text = answerOption.text
             return option
         }
         
-        let stopEvent = events.filter { $0.eventType == .pollEnd }.first
-        poll.isClosed = (stopEvent != nil)
-        
-        var filteredEvents = events.filter { event in
-            guard
-                let eventContent = event.content,
-                event.eventType == .pollResponse,
-                let response = pollResponseFromEventContent(eventContent),
-                let _ = response[kMXMessageContentKeyExtensiblePollAnswers]
-            else {
-                return false
-            }
-            
-            // Remove responses submitted after the poll was closed
-            if let stopOriginServerTs = stopEvent?.originServerTs, event.originServerTs > stopOriginServerTs {
-                return false
-            }
-            
-            return true
-        }
-        
-        // Sort them by the server timestamp, newest first
-        filteredEvents.sort { firstEvent, secondEvent in
-            return firstEvent.originServerTs > secondEvent.originServerTs
-        }
-        
-        let answersGroupedByUser = filteredEvents.reduce([String: [String]]()) { result, event in
-            guard let userIdentifier = event.sender,
-                  let eventContent = event.content,
-                  let response = pollResponseFromEventContent(eventContent),
-                  let answerIdentifiers = response[kMXMessageContentKeyExtensiblePollAnswers],
-                  !result.keys.contains(userIdentifier) else {
-                return result
-            }
-            
-            var result = result
-            result[userIdentifier] = answerIdentifiers
-            return result
-        }
+        poll.isClosed = tally.isClosed
         
-        var currentUserAnswers: [String]?
-        var winningCount: UInt = 0
-        let countedAnswers = answersGroupedByUser.reduce([String: UInt]()) { result, groupedUserAnswers in
-            // Remove responses with no answers or more than allowed
-            guard !groupedUserAnswers.value.isEmpty, groupedUserAnswers.value.count <= poll.maxAllowedSelections else {
-                return result
-            }
-            
-            // Remove responses that contain invalid answer identifiers
-            guard !groupedUserAnswers.value.map({ answerOptionIdentifiers.contains($0) }).isEmpty else {
-                return result
-            }
-            
-            var result = result
-            for answerIdentifier in Array(Set(groupedUserAnswers.value)) { //Remove duplicates
-                let count  = (result[answerIdentifier] ?? 0) + 1
-                result[answerIdentifier] = count
-                if count > winningCount {
-                    winningCount = count
-                }
-            }
-            
-            if groupedUserAnswers.key == currentUserIdentifier {
-                currentUserAnswers = groupedUserAnswers.value
-            }
-            
-            return result
-        }
+        let winningCount = tally.winningCount
+        let currentUserAnswers = tally.countedAnswersByUser[currentUserIdentifier]
         
         for case let answerOption as PollAnswerOption in poll.answerOptions {
-            answerOption.count = countedAnswers[answerOption.id] ?? 0
+            answerOption.count = tally.answerCounts[answerOption.id] ?? 0
             answerOption.isWinner = (answerOption.count > 0 && answerOption.count == winningCount)
             answerOption.isCurrentUserSelection = (currentUserAnswers?.contains(answerOption.id) ?? false)
         }
         
         return poll
     }
-    
-    private func pollResponseFromEventContent(_ eventContent: [String: Any]) -> [String: [String]]? {
-        if let response = eventContent[kMXMessageContentKeyExtensiblePollResponse] {
-            return response as? [String: [String]]
-        } else if let response = eventContent[kMXMessageContentKeyExtensiblePollResponseMSC3381]  {
-            return response as? [String: [String]]
-        }
-        
-        return nil;
-    }
 }
@@ -0,0 +1,187 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import Foundation
+
+/// Running count of the answers to a poll.
+///
+/// Poll response and end events are applied one by one. Each of them only updates the votes of its sender,
+/// so counting a new vote does not depend on the size of the poll history.
+/// The tally is `Codable` so that it can be persisted and restored without replaying the history.
+struct PollTally: Codable, Equatable {
+
+    struct Vote: Codable, Equatable {
+        let eventId: String
+        let timestamp: UInt64
+        let answers: [String]
+    }
+
+    let pollStartEventId: String
+    let roomId: String
+
+    private(set) var maxAllowedSelections: UInt
+
+    /// Timestamp of the earliest end event. Votes submitted after it are ignored
+    private(set) var stopTimestamp: UInt64?
+
+    /// All votes of each user, oldest first
+    private(set) var votesByUser: [String: [Vote]] = [:]
+
+    /// The answers counted for each user: their latest valid vote
+    private(set) var countedAnswersByUser: [String: [String]] = [:]
+
+    private(set) var answerCounts: [String: UInt] = [:]
+
+    private(set) var appliedEventIds: Set<String> = []
+    private(set) var undecryptableEventIds: Set<String> = []
+
+    var isClosed: Bool {
+        stopTimestamp != nil
+    }
+
+    var hasDecryptionError: Bool {
+        !undecryptableEventIds.isEmpty
+    }
+
+    var winningCount: UInt {
+        answerCounts.values.max() ?? 0
+    }
+
+    init(pollStartEventId: String, roomId: String, maxAllowedSelections: UInt) {
+        self.pollStartEventId = pollStartEventId
+        self.roomId = roomId
+        self.maxAllowedSelections = max(1, maxAllowedSelections)
+    }
+
+    /// Apply a poll response or poll end event.
+    /// - Parameter event: the event. Events already applied are ignored.
+    /// - Returns: true if the tally changed.
+    @discardableResult
+    mutating func apply(_ event: MXEvent) -> Bool {
+        guard let eventId = event.eventId, !appliedEventIds.contains(eventId) else {
+            return false
+        }
+
+        if event.isEncrypted && event.clear == nil {
+            return undecryptableEventIds.insert(eventId).inserted
+        }
+        let wasUndecryptable = (undecryptableEventIds.remove(eventId) != nil)
+
+        switch event.eventType {
+        case .pollEnd:
+            appliedEventIds.insert(eventId)
+            if let stopTimestamp = stopTimestamp, stopTimestamp <= event.originServerTs {
+                return wasUndecryptable
+            }
+
+            stopTimestamp = event.originServerTs
+            recount()
+            return true
+
+        case .pollResponse:
+            guard
+                let sender = event.sender,
+                let eventContent = event.content,
+                let answers = Self.pollResponseFromEventContent(eventContent)?[kMXMessageContentKeyExtensiblePollAnswers]
+            else {
+                return wasUndecryptable
+            }
+
+            appliedEventIds.insert(eventId)
+
+            let vote = Vote(eventId: eventId, timestamp: event.originServerTs, answers: answers)
+            var votes = votesByUser[sender] ?? []
+            // On equal timestamps, the last applied vote wins
+            let index = votes.lastIndex { $0.timestamp <= vote.timestamp }.map { $0 + 1 } ?? 0
+            votes.insert(vote, at: index)
+            votesByUser[sender] = votes
+
+            return updateCountedAnswers(ofUser: sender) || wasUndecryptable
+
+        default:
+            return wasUndecryptable
+        }
+    }
+
+    /// Update the maximum number of answers of a vote, after an edition of the poll.
+    mutating func update(maxAllowedSelections: UInt) {
+        let maxAllowedSelections = max(1, maxAllowedSelections)
+        guard maxAllowedSelections != self.maxAllowedSelections else {
+            return
+        }
+
+        self.maxAllowedSelections = maxAllowedSelections
+        recount()
+    }
+
+    // MARK: - Private
+
+    private mutating func recount() {
+        countedAnswersByUser.removeAll()
+        answerCounts.removeAll()
+
+        for userIdentifier in votesByUser.keys {
+            updateCountedAnswers(ofUser: userIdentifier)
+        }
+    }
+
+    @discardableResult
+    private mutating func updateCountedAnswers(ofUser userIdentifier: String) -> Bool {
+        let previousAnswers = countedAnswersByUser[userIdentifier]
+        let answers = countedAnswers(ofUser: userIdentifier)
+        guard answers != previousAnswers else {
+            return false
+        }
+
+        for answerIdentifier in Set(previousAnswers ?? []) {
+            let count = (answerCounts[answerIdentifier] ?? 1) - 1
+            answerCounts[answerIdentifier] = count > 0 ? count : nil
+        }
+        for answerIdentifier in Set(answers ?? []) {
+            answerCounts[answerIdentifier, default: 0] += 1
+        }
+
+        countedAnswersByUser[userIdentifier] = answers
+        return true
+    }
+
+    private func countedAnswers(ofUser userIdentifier: String) -> [String]? {
+        // The latest vote submitted before the poll was closed
+        let latestVote = votesByUser[userIdentifier]?.last { vote in
+            guard let stopTimestamp = stopTimestamp else {
+                return true
+            }
+            return vote.timestamp <= stopTimestamp
+        }
+
+        // Remove responses with no answers or more than allowed
+        guard let answers = latestVote?.answers, !answers.isEmpty, answers.count <= maxAllowedSelections else {
+            return nil
+        }
+
+        return answers
+    }
+
+    private static func pollResponseFromEventContent(_ eventContent: [String: Any]) -> [String: [String]]? {
+        if let response = eventContent[kMXMessageContentKeyExtensiblePollResponse] {
+            return response as? [String: [String]]
+        } else if let response = eventContent[kMXMessageContentKeyExtensiblePollResponseMSC3381]  {
+            return response as? [String: [String]]
+        }
+
+        return nil
+    }
+}
@@ -0,0 +1,333 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import Foundation
+
+// MARK: - MXSlidingSync notification constants
+extension MXSlidingSync {
+    /// Posted when a sliding sync response has been processed by the session.
+    /// The notification object is the `MXSlidingSync` instance.
+    public static let didUpdateLists = Notification.Name("MXSlidingSyncDidUpdateLists")
+}
+
+/// Sliding sync engine (MSC3575).
+///
+/// It is an alternative to the classic `/sync` loop of `MXSession`: the server only sends
+/// the rooms in the requested windows of the lists and the subscribed rooms, so the time to
+/// get the first room list does not depend on the number of rooms of the account.
+///
+/// Responses are converted into `MXSyncResponse` and processed by the session like classic
+/// sync responses. Use `-[MXSession startWithSlidingSync:onServerSyncDone:failure:]` to use it.
+///
+/// The classic `/sync` loop and sliding sync must not be used with the same store.
+@objcMembers
+public class MXSlidingSync: NSObject {
+
+    // MARK: - Constants
+
+    private enum Constants {
+        static let serverTimeout: UInt = 30000
+        static let clientTimeout: UInt = 120000
+        static let retryDelay: TimeInterval = 5
+        static let unknownPosErrCode = "M_UNKNOWN_POS"
+        static let storedPosKey = "pos"
+        static let storedToDeviceSinceKey = "to_device_since"
+        static let storedListsKey = "lists"
+    }
+
+    // MARK: - Properties
+
+    private weak var session: MXSession?
+
+    /// The room lists, by name.
+    public private(set) var lists: [String: MXSlidingSyncList] = [:]
+
+    /// The room subscriptions, by room id.
+    public private(set) var roomSubscriptions: [String: MXSlidingSyncRoomSubscription] = [:]
+
+    /// Extensions to enable (e.g. "to_device", "e2ee", "account_data", "receipts", "typing").
+    public var extensions: [String] = ["to_device", "e2ee", "account_data", "receipts", "typing"]
+
+    /// The position returned by the last processed response.
+    ///
+    /// It is saved in the session store with the data of the response, with the lists and the
+    /// to-device position, and restored on `start()`.
+    public private(set) var pos: String?
+
+    /// True when the engine is running its request loop.
+    public private(set) var isRunning = false
+
+    private var currentRequest: MXHTTPOperation?
+
+    /// Incremented for each request so that responses to cancelled requests are ignored.
+    private var requestGeneration = 0
+
+    /// True while the session processes a response. The next request is sent after.
+    private var isProcessingResponse = false
+
+    /// Position of the to-device stream, which is independent from `pos`.
+    /// The server deletes the to-device events before it. It only moves once the session has
+    /// processed and stored the events.
+    private var toDeviceSince: String?
+
+    // MARK: - Setup
+
+    /// Initializer
+    /// - Parameter session: the session to feed.
+    public init(session: MXSession) {
+        self.session = session
+        super.init()
+    }
+
+    // MARK: - Lists and subscriptions
+
+    /// Add or replace a room list.
+    /// - Parameter list: the list.
+    public func addList(_ list: MXSlidingSyncList) {
+        lists[list.name] = list
+        restartRequestIfNeeded()
+    }
+
+    /// Remove a room list.
+    /// - Parameter name: the name of the list.
+    public func removeList(named name: String) {
+        lists.removeValue(forKey: name)
+        restartRequestIfNeeded()
+    }
+
+    /// Change the windows of a list, e.g. when the user scrolls the room list.
+    /// - Parameters:
+    ///   - ranges: the new inclusive windows.
+    ///   - name: the name of the list.
+    public func setRanges(_ ranges: [ClosedRange<Int>], forListNamed name: String) {
+        guard let list = lists[name] else {
+            MXLog.warning("[MXSlidingSync] setRanges: Unknown list \(name)")
+            return
+        }
+        list.ranges = ranges
+        restartRequestIfNeeded()
+    }
+
+    /// Subscribe to a room, e.g. when the user opens it.
+    /// - Parameters:
+    ///   - roomId: the room id.
+    ///   - subscription: the data to get for the room.
+    public func subscribe(toRoomWithId roomId: String, subscription: MXSlidingSyncRoomSubscription = MXSlidingSyncRoomSubscription()) {
+        roomSubscriptions[roomId] = subscription
+        restartRequestIfNeeded()
+    }
+
+    /// Unsubscribe from a room.
+    /// - Parameter roomId: the room id.
+    public func unsubscribe(fromRoomWithId roomId: String) {
+        roomSubscriptions.removeValue(forKey: roomId)
+        restartRequestIfNeeded()
+    }
+
+    // MARK: - Loop
+
+    /// Start the request loop.
+    public func start() {
+        guard !isRunning else {
+            return
+        }
+        if pos == nil {
+            restoreStoredState()
+        }
+        MXLog.debug("[MXSlidingSync] start from pos: \(String(describing: pos))")
+        isRunning = true
+        if !isProcessingResponse {
+            sendRequest(serverTimeout: 0)
+        }
+    }
+
+    /// Stop the request loop. It can be restarted later from the current position.
+    public func stop() {
+        MXLog.debug("[MXSlidingSync] stop")
+        isRunning = false
+        cancelCurrentRequest()
+    }
+
+    /// JSON body of the next request.
+    public func requestJSON() -> [String: Any] {
+        var json: [String: Any] = [:]
+        json["lists"] = lists.mapValues { $0.requestJSON() }
+        json["room_subscriptions"] = roomSubscriptions.mapValues { $0.requestJSON() }
+
+        var extensionsJSON: [String: Any] = [:]
+        for name in extensions {
+            var extensionJSON: [String: Any] = ["enabled": true]
+            if name == "to_device", let toDeviceSince = toDeviceSince {
+                extensionJSON["since"] = toDeviceSince
+            }
+            extensionsJSON[name] = extensionJSON
+        }
+        json["extensions"] = extensionsJSON
+
+        return json
+    }
+
+    // MARK: - Private
+
+    private func restartRequestIfNeeded() {
+        guard isRunning, !isProcessingResponse else {
+            // The new parameters will be sent with the next request
+            return
+        }
+
+        // Do not wait for the end of the long poll to send the new parameters
+        cancelCurrentRequest()
+        sendRequest(serverTimeout: 0)
+    }
+
+    private func cancelCurrentRequest() {
+        requestGeneration += 1
+        currentRequest?.cancel()
+        currentRequest = nil
+    }
+
+    private func sendRequest(serverTimeout: UInt) {
+        guard isRunning, let session = session, let restClient = session.matrixRestClient else {
+            return
+        }
+
+        requestGeneration += 1
+        let generation = requestGeneration
+
+        // The server echoes the transaction id in the response to the request
+        let txnId = MXTools.generateTransactionId()
+        var json = requestJSON()
+        json["txn_id"] = txnId
+
+        currentRequest = restClient.slidingSync(withRequest: json,
+                                                pos: pos,
+                                                serverTimeout: serverTimeout,
+                                                clientTimeout: Constants.clientTimeout,
+                                                success: { [weak self] response in
+            guard let self = self, generation == self.requestGeneration else { return }
+            self.currentRequest = nil
+
+            guard let response = response else {
+                MXLog.error("[MXSlidingSync] sendRequest: Cannot parse the response")
+                self.retryLater()
+                return
+            }
+            if let responseTxnId = response.txnId, responseTxnId != txnId {
+                MXLog.warning("[MXSlidingSync] sendRequest: The response is for another request. Ignore it")
+                self.retryLater()
+                return
+            }
+            self.handle(response)
+        }, failure: { [weak self] error in
+            guard let self = self, generation == self.requestGeneration else { return }
+            self.currentRequest = nil
+            self.handle(error)
+        })
+    }
+
+    private func handle(_ response: MXSlidingSyncResponse) {
+        guard let session = session else {
+            return
+        }
+
+        for (name, listResponse) in response.lists ?? [:] {
+            lists[name]?.apply(listResponse)
+        }
+
+        let nextToDeviceSince = response.extensions?["to_device"]?["next_batch"] as? String ?? toDeviceSince
+        let syncToken = storedStateToken(pos: response.pos, toDeviceSince: nextToDeviceSince)
+        let syncResponse = MXSlidingSyncResponseConverter.syncResponse(from: response, syncToken: syncToken)
+
+        isProcessingResponse = true
+        session.handleSlidingSyncResponse(syncResponse) { [weak self] in
+            guard let self = self else { return }
+
+            self.isProcessingResponse = false
+            self.pos = response.pos
+            self.toDeviceSince = nextToDeviceSince
+
+            NotificationCenter.default.post(name: MXSlidingSync.didUpdateLists, object: self)
+
+            self.sendRequest(serverTimeout: Constants.serverTimeout)
+        }
+    }
+
+    /// The sync token of a converted response: the positions and the lists after the response.
+    ///
+    /// The session stores it as the event stream token, in the same commit as the response data.
+    private func storedStateToken(pos: String, toDeviceSince: String?) -> String {
+        var json: [String: Any] = [
+            Constants.storedPosKey: pos,
+            Constants.storedListsKey: lists.mapValues { $0.storedStateJSON }
+        ]
+        json[Constants.storedToDeviceSinceKey] = toDeviceSince
+
+        guard let data = try? JSONSerialization.data(withJSONObject: json),
+              let token = String(data: data, encoding: .utf8) else {
+            return pos
+        }
+        return token
+    }
+
+    /// Resume from the state stored by the session, if any.
+    private func restoreStoredState() {
+        guard let token = session?.store?.eventStreamToken,
+              let data = token.data(using: .utf8),
+              let json = (try? JSONSerialization.jsonObject(with: data)) as? [String: Any],
+              let storedPos = json[Constants.storedPosKey] as? String else {
+            return
+        }
+
+        toDeviceSince = json[Constants.storedToDeviceSinceKey] as? String
+
+        // The server only sends the changes since pos. Use it only if every list can be restored
+        let storedLists = json[Constants.storedListsKey] as? [String: [String: Any]] ?? [:]
+        for (name, list) in lists {
+            guard let storedList = storedLists[name], list.restore(fromStoredStateJSON: storedList) else {
+                MXLog.debug("[MXSlidingSync] restoreStoredState: No stored state for list \(name). Restart the lists")
+                lists.values.forEach { $0.reset() }
+                return
+            }
+        }
+        pos = storedPos
+    }
+
+    private func handle(_ error: Error?) {
+        guard isRunning else {
+            return
+        }
+
+        if let error = error as NSError?, MXError.isMXError(error), MXError(nsError: error)?.errcode == Constants.unknownPosErrCode {
+            // The server has expired our position. Restart from scratch
+            MXLog.debug("[MXSlidingSync] handleError: Unknown pos. Restart the lists")
+            pos = nil
+            lists.values.forEach { $0.reset() }
+            sendRequest(serverTimeout: 0)
+            return
+        }
+
+        MXLog.warning("[MXSlidingSync] handleError: Request failed. Retry in \(Constants.retryDelay)s", context: error)
+        retryLater()
+    }
+
+    private func retryLater() {
+        let generation = requestGeneration
+        DispatchQueue.main.asyncAfter(deadline: .now() + Constants.retryDelay) { [weak self] in
+            guard let self = self, generation == self.requestGeneration, self.currentRequest == nil else { return }
+            self.sendRequest(serverTimeout: 0)
+        }
+    }
+}
@@ -0,0 +1,222 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import Foundation
+
+/// A sliding sync room list (MSC3575).
+///
+/// The server sorts all rooms of the list but only sends the rooms that are in the
+/// requested `ranges`. The client side copy of the list, `roomIds`, is kept up to date
+/// by applying the operations of each response.
+@objcMembers
+public class MXSlidingSyncList: NSObject {
+
+    // MARK: - Properties
+
+    /// Name of the list. Used as key in requests and responses.
+    public let name: String
+
+    /// Inclusive windows of the list the client is interested in.
+    public var ranges: [ClosedRange<Int>]
+
+    /// Sort order of the list, as defined by MSC3575 (e.g. "by_recency", "by_name").
+    public var sort: [String]
+
+    /// Maximum number of timeline events to get for each room in the windows.
+    public var timelineLimit: UInt
+
+    /// State events to get for each room in the windows, as [event type, state key] pairs.
+    public var requiredState: [[String]]
+
+    /// Optional filters (e.g. ["is_dm": true]).
+    public var filters: [String: Any]?
+
+    /// The total number of rooms in the list on the server side.
+    public private(set) var count: Int = 0
+
+    /// The client side copy of the list. Rooms outside the synced windows are nil.
+    public private(set) var roomIds: [String?] = []
+
+    // MARK: - Setup
+
+    public init(name: String,
+                ranges: [ClosedRange<Int>],
+                sort: [String] = ["by_recency", "by_name"],
+                timelineLimit: UInt = 1,
+                requiredState: [[String]] = [[kMXEventTypeStringRoomName, ""], [kMXEventTypeStringRoomAvatar, ""], [kMXEventTypeStringRoomEncryption, ""]],
+                filters: [String: Any]? = nil) {
+        self.name = name
+        self.ranges = ranges
+        self.sort = sort
+        self.timelineLimit = timelineLimit
+        self.requiredState = requiredState
+        self.filters = filters
+        super.init()
+    }
+
+    // MARK: - Public
+
+    /// Room ids currently known in the requested windows, in list order.
+    public var roomIdsInRanges: [String] {
+        var result: [String] = []
+        for range in ranges {
+            // Windows past the end of the list are empty
+            let lowerBound = max(range.lowerBound, 0), upperBound = min(range.upperBound, roomIds.count - 1)
+            guard lowerBound <= upperBound else { continue }
+            result.append(contentsOf: roomIds[lowerBound...upperBound].compactMap { $0 })
+        }
+        return result
+    }
+
+    /// JSON representation of the list in a sliding sync request.
+    public func requestJSON() -> [String: Any] {
+        var json: [String: Any] = [
+            "ranges": ranges.map { [$0.lowerBound, $0.upperBound] },
+            "timeline_limit": timelineLimit,
+            "required_state": requiredState
+        ]
+        if !sort.isEmpty {
+            json["sort"] = sort
+        }
+        if let filters = filters {
+            json["filters"] = filters
+        }
+        return json
+    }
+
+    /// Apply the list update of a sliding sync response.
+    /// - Parameter response: the list response.
+    public func apply(_ response: MXSlidingSyncListResponse) {
+        resize(to: Int(response.count))
+
+        for operation in response.ops ?? [] {
+            switch operation.op {
+            case kMXSlidingSyncOperationSync:
+                guard let range = closedRange(of: operation) else { continue }
+                for (offset, roomId) in (operation.roomIds ?? []).enumerated() {
+                    let index = range.lowerBound + offset
+                    guard index <= range.upperBound else { break }
+                    set(roomId, at: index)
+                }
+            case kMXSlidingSyncOperationInvalidate:
+                guard let range = closedRange(of: operation) else { continue }
+                for index in range where index < roomIds.count {
+                    roomIds[index] = nil
+                }
+            case kMXSlidingSyncOperationDelete:
+                guard let index = operation.index?.intValue, index >= 0, index < roomIds.count else { continue }
+                // Shift the following rooms to fill the gap. A following INSERT will take the free slot.
+                roomIds.remove(at: index)
+                roomIds.append(nil)
+            case kMXSlidingSyncOperationInsert:
+                guard let index = operation.index?.intValue, index >= 0, let roomId = operation.roomId else { continue }
+                roomIds.insert(roomId, at: min(index, roomIds.count))
+                if roomIds.count > count {
+                    // Drop the last slot, it has been shifted out of the list
+                    roomIds.removeLast(roomIds.count - count)
+                }
+            default:
+                MXLog.debug("[MXSlidingSyncList] apply: Unknown operation \(operation.op) in list \(name)")
+            }
+        }
+    }
+
+    /// Forget the client side copy of the list.
+    ///
+    /// It must be called when the server has forgotten our sync position.
+    public func reset() {
+        count = 0
+        roomIds = []
+    }
+
+    /// JSON of the client side copy of the list, to store with the sync position.
+    var storedStateJSON: [String: Any] {
+        return [
+            "count": count,
+            "room_ids": roomIds.map { $0 ?? NSNull() }
+        ]
+    }
+
+    /// Restore the client side copy of the list from `storedStateJSON`.
+    /// - Parameter json: the stored JSON.
+    /// - Returns: false if the JSON is not valid. The list is not modified then.
+    func restore(fromStoredStateJSON json: [String: Any]) -> Bool {
+        guard let storedCount = json["count"] as? Int, let storedRoomIds = json["room_ids"] as? [Any] else {
+            return false
+        }
+        count = storedCount
+        roomIds = storedRoomIds.map { $0 as? String }
+        return true
+    }
+
+    // MARK: - Private
+
+    private func resize(to newCount: Int) {
+        count = newCount
+        if roomIds.count > newCount {
+            roomIds.removeLast(roomIds.count - newCount)
+        } else if roomIds.count < newCount {
+            roomIds.append(contentsOf: [String?](repeating: nil, count: newCount - roomIds.count))
+        }
+    }
+
+    private func set(_ roomId: String, at index: Int) {
+        if index >= roomIds.count {
+            // The server sent more rooms than announced
+            roomIds.append(contentsOf: [String?](repeating: nil, count: index - roomIds.count + 1))
+            count = roomIds.count
+        }
+        roomIds[index] = roomId
+    }
+
+    private func closedRange(of operation: MXSlidingSyncListOperation) -> ClosedRange<Int>? {
+        guard let range = operation.range, range.count == 2 else {
+            return nil
+        }
+        let lowerBound = range[0].intValue, upperBound = range[1].intValue
+        guard lowerBound >= 0, lowerBound <= upperBound else {
+            return nil
+        }
+        return lowerBound...upperBound
+    }
+}
+
+/// Subscription to a specific room, whatever its position in the lists.
+///
+/// Typically used for the room the user is looking at.
+@objcMembers
+public class MXSlidingSyncRoomSubscription: NSObject {
+
+    /// Maximum number of timeline events to get.
+    public let timelineLimit: UInt
+
+    /// State events to get, as [event type, state key] pairs.
+    public let requiredState: [[String]]
+
+    public init(timelineLimit: UInt = 20, requiredState: [[String]] = [["*", "*"]]) {
+        self.timelineLimit = timelineLimit
+        self.requiredState = requiredState
+        super.init()
+    }
+
+    /// JSON representation of the subscription in a sliding sync request.
+    public func requestJSON() -> [String: Any] {
+        return [
+            "timeline_limit": timelineLimit,
+            "required_state": requiredState
+        ]
+    }
+}
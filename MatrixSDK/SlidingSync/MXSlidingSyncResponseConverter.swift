@@ -0,0 +1,125 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import Foundation
+
+/// Converts sliding sync responses into classic `/sync` responses.
+///
+/// This lets `MXSession` process sliding sync data with the same code path as `/sync`,
+/// so rooms, summaries and the store are updated the same way.
+struct MXSlidingSyncResponseConverter {
+
+    /// Build a `MXSyncResponse` from a sliding sync response.
+    /// - Parameters:
+    ///   - response: the sliding sync response.
+    ///   - syncToken: the `nextBatch` of the classic sync response. The session stores it with the response data.
+    /// - Returns: the equivalent classic sync response.
+    static func syncResponse(from response: MXSlidingSyncResponse, syncToken: String) -> MXSyncResponse {
+        return MXSyncResponse(fromJSON: syncResponseJSON(from: response, syncToken: syncToken))
+    }
+
+    /// JSON of the classic sync response equivalent to a sliding sync response.
+    static func syncResponseJSON(from response: MXSlidingSyncResponse, syncToken: String) -> [String: Any] {
+        var join: [String: [String: Any]] = [:]
+        var invite: [String: [String: Any]] = [:]
+
+        for (roomId, room) in response.rooms ?? [:] {
+            if let inviteState = room["invite_state"] as? [[String: Any]] {
+                invite[roomId] = ["invite_state": ["events": inviteState]]
+            } else {
+                join[roomId] = joinedRoomJSON(from: room)
+            }
+        }
+
+        var json: [String: Any] = ["next_batch": syncToken]
+
+        let extensions = response.extensions ?? [:]
+
+        if let toDevice = extensions["to_device"], let events = toDevice["events"] {
+            json["to_device"] = ["events": events]
+        }
+
+        if let e2ee = extensions["e2ee"] {
+            json["device_lists"] = e2ee["device_lists"]
+            json["device_one_time_keys_count"] = e2ee["device_one_time_keys_count"]
+            json["org.matrix.msc2732.device_unused_fallback_key_types"] = e2ee["device_unused_fallback_key_types"]
+        }
+
+        if let accountData = extensions["account_data"] {
+            if let global = accountData["global"] {
+                json["account_data"] = ["events": global]
+            }
+            for (roomId, events) in accountData["rooms"] as? [String: Any] ?? [:] {
+                guard invite[roomId] == nil else { continue }
+                join[roomId, default: [:]]["account_data"] = ["events": events]
+            }
+        }
+
+        // Receipts and typing notifications are both room ephemeral events
+        for extensionName in ["receipts", "typing"] {
+            for (roomId, event) in extensions[extensionName]?["rooms"] as? [String: Any] ?? [:] {
+                guard invite[roomId] == nil else { continue }
+                var ephemeral = join[roomId, default: [:]]["ephemeral"] as? [String: Any] ?? [:]
+                var events = ephemeral["events"] as? [Any] ?? []
+                events.append(event)
+                ephemeral["events"] = events
+                join[roomId, default: [:]]["ephemeral"] = ephemeral
+            }
+        }
+
+        json["rooms"] = ["join": join, "invite": invite]
+
+        return json
+    }
+
+    private static func joinedRoomJSON(from room: [AnyHashable: Any]) -> [String: Any] {
+        var roomJSON: [String: Any] = [:]
+
+        if let requiredState = room["required_state"] {
+            roomJSON["state"] = ["events": requiredState]
+        }
+
+        var timeline: [String: Any] = ["events": room["timeline"] ?? []]
+        timeline["limited"] = room["limited"] ?? false
+        timeline["prev_batch"] = room["prev_batch"]
+        roomJSON["timeline"] = timeline
+
+        var unreadNotifications: [String: Any] = [:]
+        unreadNotifications["notification_count"] = room["notification_count"]
+        unreadNotifications["highlight_count"] = room["highlight_count"]
+        if !unreadNotifications.isEmpty {
+            roomJSON["unread_notifications"] = unreadNotifications
+        }
+
+        var summary: [String: Any] = [:]
+        summary["m.joined_member_count"] = room["joined_count"]
+        summary["m.invited_member_count"] = room["invited_count"]
+        if let heroes = room["heroes"] as? [Any] {
+            // Heroes are either user ids or objects with a user_id field depending on the server version
+            summary["m.heroes"] = heroes.compactMap { hero -> String? in
+                if let userId = hero as? String {
+                    return userId
+                }
+                return (hero as? [String: Any])?["user_id"] as? String
+            }
+        }
+        if !summary.isEmpty {
+            roomJSON["summary"] = summary
+        }
+
+        return roomJSON
+    }
+}
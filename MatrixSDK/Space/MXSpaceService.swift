@@ -256,7 +256,7 @@ public class MXSpaceService: NSObject {
     /// - Parameters:
     ///   - syncResponse: The sync response object
     public func handleSyncResponse(_ syncResponse: MXSyncResponse) {
-         guard self.needsUpdate || !(syncResponse.rooms?.join?.isEmpty ?? true) || !(syncResponse.rooms?.invite?.isEmpty ?? true) || !(syncResponse.rooms?.leave?.isEmpty ?? true) || !(syncResponse.toDevice?.events.isEmpty ?? true) else {
+         guard self.needsUpdate || !(syncResponse.rooms?.join?.isEmpty ?? true) || !(syncResponse.rooms?.invite?.isEmpty ?? true) || !(syncResponse.rooms?.leave?.isEmpty ?? true) || (syncResponse.toDevice?.eventsCount ?? 0) > 0 else {
              return
         }
         
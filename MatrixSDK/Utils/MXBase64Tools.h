@@ -18,6 +18,11 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ Base64 conversions between bytes and the standard, unpadded and URL-safe alphabets.
+
+ Conversions are done by a table-driven codec in a single pass, without intermediate strings.
+ */
 @interface MXBase64Tools : NSObject
 
 #pragma mark - Padding
@@ -40,6 +45,87 @@ NS_ASSUME_NONNULL_BEGIN
 + (NSString *)base64FromData:(NSData *)data;
 + (NSString *)unpaddedBase64FromData:(NSData *)data;
 
+// The base64url string can be padded or unpadded
++ (nullable NSData *)dataFromBase64Url:(NSString *)base64Url;
+
+// base64url has no padding
++ (NSString *)base64UrlFromData:(NSData *)data;
+
+@end
+
+
+#pragma mark - Streaming
+
+/**
+ `MXBase64Encoder` encodes a stream of bytes chunk by chunk.
+
+ Bytes that do not make a complete group of 3 bytes are kept for the next chunk.
+ */
+@interface MXBase64Encoder : NSObject
+
+/**
+ Create an encoder.
+
+ @param urlSafe YES to use the base64url alphabet.
+ @param padding YES to pad the end of the output.
+ @return a `MXBase64Encoder` instance.
+ */
+- (instancetype)initWithURLSafeAlphabet:(BOOL)urlSafe padding:(BOOL)padding;
+
+/**
+ Encode a chunk.
+
+ @param bytes the bytes of the chunk.
+ @param length the length of the chunk.
+ @return the base64 characters, as ASCII bytes.
+ */
+- (NSData *)encodeBytes:(const void *)bytes length:(NSUInteger)length;
+
+/**
+ Encode the remaining bytes.
+
+ The encoder can be reused for another stream after this call.
+
+ @return the last base64 characters, as ASCII bytes.
+ */
+- (NSData *)finish;
+
+@end
+
+/**
+ `MXBase64Decoder` decodes a stream of base64 characters chunk by chunk.
+
+ Like `[MXBase64Tools dataFromBase64:]`, it accepts padded and unpadded content and ignores
+ unknown characters like line breaks.
+ */
+@interface MXBase64Decoder : NSObject
+
+/**
+ Create a decoder.
+
+ @param urlSafe YES to decode the base64url alphabet.
+ @return a `MXBase64Decoder` instance.
+ */
+- (instancetype)initWithURLSafeAlphabet:(BOOL)urlSafe;
+
+/**
+ Decode a chunk.
+
+ @param bytes the base64 characters, as ASCII bytes.
+ @param length the length of the chunk.
+ @return the decoded bytes.
+ */
+- (NSData *)decodeBytes:(const void *)bytes length:(NSUInteger)length;
+
+/**
+ Decode the remaining characters.
+
+ The decoder can be reused for another stream after this call.
+
+ @return the last decoded bytes. nil if the stream ended with an incomplete character group.
+ */
+- (nullable NSData *)finish;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -16,64 +16,482 @@
 
 #import "MXBase64Tools.h"
 
+static const char kMXBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char kMXBase64UrlAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Value of the characters that are not part of an alphabet in the decoding tables
+static const uint8_t kMXBase64InvalidValue = 0xFF;
+
+// Character to drop in the character mapping tables
+static const uint8_t kMXBase64DroppedCharacter = 0;
+
+typedef struct
+{
+    // Sextets of the current group of 4 characters
+    uint32_t bits;
+    NSUInteger count;
+} MXBase64DecodingState;
+
+
+#pragma mark - Tables
+
+static const uint8_t *MXBase64DecodingTable(BOOL urlSafe)
+{
+    static uint8_t table[256], urlTable[256];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        memset(table, kMXBase64InvalidValue, sizeof(table));
+        memset(urlTable, kMXBase64InvalidValue, sizeof(urlTable));
+        for (uint8_t value = 0; value < 64; value++)
+        {
+            table[(uint8_t)kMXBase64Alphabet[value]] = value;
+            urlTable[(uint8_t)kMXBase64UrlAlphabet[value]] = value;
+        }
+    });
+    return urlSafe ? urlTable : table;
+}
+
+typedef NS_ENUM(NSUInteger, MXBase64Mapping)
+{
+    MXBase64MappingUnpad,
+    MXBase64MappingToUrl,
+    MXBase64MappingFromUrl
+};
+
+// Map ASCII characters of a base64 string to the characters of the output string
+static const uint8_t *MXBase64MappingTable(MXBase64Mapping mapping)
+{
+    static uint8_t tables[3][128];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (NSUInteger t = 0; t < 3; t++)
+        {
+            for (NSUInteger c = 0; c < 128; c++)
+            {
+                tables[t][c] = (uint8_t)c;
+            }
+            tables[t]['='] = kMXBase64DroppedCharacter;
+        }
+        tables[MXBase64MappingToUrl]['+'] = '-';
+        tables[MXBase64MappingToUrl]['/'] = '_';
+        tables[MXBase64MappingFromUrl]['-'] = '+';
+        tables[MXBase64MappingFromUrl]['_'] = '/';
+    });
+    return tables[mapping];
+}
+
+
+#pragma mark - Codec
+
+static NSUInteger MXBase64EncodedLength(NSUInteger length, BOOL padding)
+{
+    return padding ? (length + 2) / 3 * 4 : (length * 4 + 2) / 3;
+}
+
+static NSUInteger MXBase64Encode(const uint8_t *bytes, NSUInteger length, const char *alphabet, BOOL padding, uint8_t *output)
+{
+    uint8_t *o = output;
+
+    NSUInteger i = 0;
+    for (; i + 3 <= length; i += 3)
+    {
+        uint32_t group = (uint32_t)bytes[i] << 16 | (uint32_t)bytes[i + 1] << 8 | bytes[i + 2];
+        *o++ = alphabet[group >> 18];
+        *o++ = alphabet[(group >> 12) & 0x3F];
+        *o++ = alphabet[(group >> 6) & 0x3F];
+        *o++ = alphabet[group & 0x3F];
+    }
+
+    NSUInteger remaining = length - i;
+    if (remaining)
+    {
+        uint32_t group = (uint32_t)bytes[i] << 16 | (remaining == 2 ? (uint32_t)bytes[i + 1] << 8 : 0);
+        *o++ = alphabet[group >> 18];
+        *o++ = alphabet[(group >> 12) & 0x3F];
+        if (remaining == 2)
+        {
+            *o++ = alphabet[(group >> 6) & 0x3F];
+        }
+        else if (padding)
+        {
+            *o++ = '=';
+        }
+        if (padding)
+        {
+            *o++ = '=';
+        }
+    }
+
+    return o - output;
+}
+
+// Maximum number of bytes decoded from `length` characters
+static NSUInteger MXBase64DecodedMaxLength(NSUInteger length)
+{
+    return (length / 4 + 1) * 3;
+}
+
+// Decode all complete groups of 4 characters. Padding and unknown characters are skipped.
+static NSUInteger MXBase64Decode(const uint8_t *characters, NSUInteger length, const uint8_t *table, MXBase64DecodingState *state, uint8_t *output)
+{
+    uint8_t *o = output;
+
+    NSUInteger i = 0;
+    while (i < length)
+    {
+        // Fast path for groups made of 4 valid characters
+        if (state->count == 0)
+        {
+            for (; i + 4 <= length; i += 4)
+            {
+                uint8_t a = table[characters[i]], b = table[characters[i + 1]], c = table[characters[i + 2]], d = table[characters[i + 3]];
+                if ((a | b | c | d) == kMXBase64InvalidValue)
+                {
+                    break;
+                }
+
+                uint32_t group = (uint32_t)a << 18 | (uint32_t)b << 12 | (uint32_t)c << 6 | d;
+                *o++ = group >> 16;
+                *o++ = (group >> 8) & 0xFF;
+                *o++ = group & 0xFF;
+            }
+            if (i == length)
+            {
+                break;
+            }
+        }
+
+        uint8_t value = table[characters[i++]];
+        if (value == kMXBase64InvalidValue)
+        {
+            continue;
+        }
+
+        state->bits = state->bits << 6 | value;
+        if (++state->count == 4)
+        {
+            *o++ = state->bits >> 16;
+            *o++ = (state->bits >> 8) & 0xFF;
+            *o++ = state->bits & 0xFF;
+            state->bits = 0;
+            state->count = 0;
+        }
+    }
+
+    return o - output;
+}
+
+// Decode the last incomplete group. Return -1 if it cannot make a byte.
+static NSInteger MXBase64DecodeFinal(MXBase64DecodingState *state, uint8_t *output)
+{
+    NSInteger length = 0;
+    switch (state->count)
+    {
+        case 0:
+            break;
+        case 2:
+            output[0] = state->bits >> 4;
+            length = 1;
+            break;
+        case 3:
+            output[0] = state->bits >> 10;
+            output[1] = (state->bits >> 2) & 0xFF;
+            length = 2;
+            break;
+        default:
+            length = -1;
+            break;
+    }
+
+    state->bits = 0;
+    state->count = 0;
+    return length;
+}
+
+static NSString *MXBase64EncodeData(NSData *data, const char *alphabet, BOOL padding)
+{
+    // Like Foundation methods called on nil
+    if (!data)
+    {
+        return nil;
+    }
+
+    NSUInteger length = MXBase64EncodedLength(data.length, padding);
+    if (!length)
+    {
+        return @"";
+    }
+
+    uint8_t *output = malloc(length);
+    MXBase64Encode(data.bytes, data.length, alphabet, padding, output);
+    return [[NSString alloc] initWithBytesNoCopy:output length:length encoding:NSASCIIStringEncoding freeWhenDone:YES];
+}
+
+static NSData *MXBase64DecodeString(NSString *base64, BOOL urlSafe)
+{
+    if (!base64)
+    {
+        return nil;
+    }
+
+    NSUInteger length = base64.length;
+
+    // Read the characters in place when the string stores them as ASCII
+    const uint8_t *characters = (const uint8_t *)CFStringGetCStringPtr((__bridge CFStringRef)base64, kCFStringEncodingASCII);
+    uint8_t *buffer = NULL;
+    if (!characters)
+    {
+        // Non ASCII characters become unknown characters
+        buffer = malloc(length);
+        [base64 getBytes:buffer maxLength:length usedLength:&length encoding:NSASCIIStringEncoding options:NSStringEncodingConversionAllowLossy range:NSMakeRange(0, base64.length) remainingRange:NULL];
+        characters = buffer;
+    }
+
+    MXBase64DecodingState state = {0};
+    uint8_t *output = malloc(MXBase64DecodedMaxLength(length));
+    NSUInteger outputLength = MXBase64Decode(characters, length, MXBase64DecodingTable(urlSafe), &state, output);
+    NSInteger finalLength = MXBase64DecodeFinal(&state, output + outputLength);
+    free(buffer);
+
+    if (finalLength < 0)
+    {
+        free(output);
+        return nil;
+    }
+
+    return [[NSData alloc] initWithBytesNoCopy:output length:outputLength + finalLength freeWhenDone:YES];
+}
+
+static NSString *MXBase64MapString(NSString *base64, MXBase64Mapping mapping, BOOL padding)
+{
+    if (!base64)
+    {
+        return nil;
+    }
+
+    const uint8_t *table = MXBase64MappingTable(mapping);
+    NSUInteger length = base64.length;
+
+    uint8_t *output = malloc(length + 3);
+    NSRange remainingRange;
+    [base64 getBytes:output maxLength:length usedLength:NULL encoding:NSASCIIStringEncoding options:0 range:NSMakeRange(0, length) remainingRange:&remainingRange];
+    if (remainingRange.length)
+    {
+        // Not a base64 string. Keep non ASCII characters as they are
+        free(output);
+
+        unichar *characters = malloc((length + 3) * sizeof(unichar));
+        [base64 getCharacters:characters range:NSMakeRange(0, length)];
+
+        NSUInteger outputLength = 0;
+        for (NSUInteger i = 0; i < length; i++)
+        {
+            unichar c = characters[i] < 128 ? table[characters[i]] : characters[i];
+            if (c != kMXBase64DroppedCharacter)
+            {
+                characters[outputLength++] = c;
+            }
+        }
+        while (padding && outputLength % 4)
+        {
+            characters[outputLength++] = '=';
+        }
+        return [[NSString alloc] initWithCharactersNoCopy:characters length:outputLength freeWhenDone:YES];
+    }
+
+    NSUInteger outputLength = 0;
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        uint8_t c = table[output[i]];
+        if (c != kMXBase64DroppedCharacter)
+        {
+            output[outputLength++] = c;
+        }
+    }
+    while (padding && outputLength % 4)
+    {
+        output[outputLength++] = '=';
+    }
+    return [[NSString alloc] initWithBytesNoCopy:output length:outputLength encoding:NSASCIIStringEncoding freeWhenDone:YES];
+}
+
+
 @implementation MXBase64Tools
 
 #pragma mark - Padding
 
 + (NSString *)base64ToUnpaddedBase64:(NSString *)base64
 {
-    return [base64 stringByReplacingOccurrencesOfString:@"=" withString:@""];
+    return MXBase64MapString(base64, MXBase64MappingUnpad, NO);
 }
 
 + (NSString *)padBase64:(NSString *)unpadded
 {
-    NSString *ret = unpadded;
-    
-    while (ret.length % 4) {
-        ret = [ret stringByAppendingString:@"="];
+    NSUInteger length = unpadded.length;
+    if (!(length % 4))
+    {
+        return unpadded;
     }
-    return ret;
+    return [unpadded stringByPaddingToLength:length + 4 - length % 4 withString:@"=" startingAtIndex:0];
 }
 
 #pragma mark - URL
 
 + (NSString *)base64UrlToBase64:(NSString *)base64Url
 {
-    NSString *ret = base64Url;
-    ret = [ret stringByReplacingOccurrencesOfString:@"-" withString:@"+"];
-    ret = [ret stringByReplacingOccurrencesOfString:@"_" withString:@"/"];
-    
     // iOS needs the padding to decode base64
-    return [[self class] padBase64:ret];
+    return MXBase64MapString(base64Url, MXBase64MappingFromUrl, YES);
 }
 
 + (NSString *)base64ToBase64Url:(NSString *)base64
 {
-    NSString *ret = base64;
-    ret = [ret stringByReplacingOccurrencesOfString:@"+" withString:@"-"];
-    ret = [ret stringByReplacingOccurrencesOfString:@"/" withString:@"_"];
     // base64url has no padding
-    return [ret stringByReplacingOccurrencesOfString:@"=" withString:@""];
+    return MXBase64MapString(base64, MXBase64MappingToUrl, NO);
 }
 
 #pragma mark - Data
 
 + (NSData *)dataFromBase64:(NSString *)base64
 {
-    // Make sure we have a padded base64 string before calling NSData
-    NSString *base64String = [[self class] padBase64:base64];
-    return [[NSData alloc] initWithBase64EncodedString:base64String options:NSDataBase64DecodingIgnoreUnknownCharacters];
+    return MXBase64DecodeString(base64, NO);
 }
 
 + (NSString *)base64FromData:(NSData *)data
 {
-    return [data base64EncodedStringWithOptions:0];
+    return MXBase64EncodeData(data, kMXBase64Alphabet, YES);
 }
 
 + (NSString *)unpaddedBase64FromData:(NSData *)data
 {
-    NSString *base64 = [[self class] base64FromData:data];
-    return [[self class] base64ToUnpaddedBase64:base64];
+    return MXBase64EncodeData(data, kMXBase64Alphabet, NO);
+}
+
++ (NSData *)dataFromBase64Url:(NSString *)base64Url
+{
+    return MXBase64DecodeString(base64Url, YES);
+}
+
++ (NSString *)base64UrlFromData:(NSData *)data
+{
+    return MXBase64EncodeData(data, kMXBase64UrlAlphabet, NO);
+}
+
+@end
+
+
+#pragma mark - Streaming
+
+@interface MXBase64Encoder ()
+{
+    const char *alphabet;
+    BOOL addsPadding;
+
+    // Bytes of the incomplete group of 3 bytes
+    uint8_t pendingBytes[3];
+    NSUInteger pendingLength;
+}
+@end
+
+@implementation MXBase64Encoder
+
+- (instancetype)init
+{
+    return [self initWithURLSafeAlphabet:NO padding:YES];
+}
+
+- (instancetype)initWithURLSafeAlphabet:(BOOL)urlSafe padding:(BOOL)padding
+{
+    self = [super init];
+    if (self)
+    {
+        alphabet = urlSafe ? kMXBase64UrlAlphabet : kMXBase64Alphabet;
+        addsPadding = padding;
+    }
+    return self;
+}
+
+- (NSData *)encodeBytes:(const void *)bytes length:(NSUInteger)length
+{
+    const uint8_t *input = bytes;
+
+    // Complete the pending group first
+    if (pendingLength)
+    {
+        NSUInteger missingLength = MIN(3 - pendingLength, length);
+        memcpy(pendingBytes + pendingLength, input, missingLength);
+        pendingLength += missingLength;
+        input += missingLength;
+        length -= missingLength;
+
+        if (pendingLength < 3)
+        {
+            return [NSData data];
+        }
+    }
+
+    NSUInteger groupsLength = length - length % 3;
+    NSMutableData *output = [NSMutableData dataWithLength:(pendingLength + groupsLength) / 3 * 4];
+    uint8_t *o = output.mutableBytes;
+
+    if (pendingLength)
+    {
+        o += MXBase64Encode(pendingBytes, 3, alphabet, NO, o);
+    }
+    MXBase64Encode(input, groupsLength, alphabet, NO, o);
+
+    // Keep the incomplete group for the next chunk
+    pendingLength = length - groupsLength;
+    memcpy(pendingBytes, input + groupsLength, pendingLength);
+
+    return output;
+}
+
+- (NSData *)finish
+{
+    NSMutableData *output = [NSMutableData dataWithLength:MXBase64EncodedLength(pendingLength, addsPadding)];
+    MXBase64Encode(pendingBytes, pendingLength, alphabet, addsPadding, output.mutableBytes);
+    pendingLength = 0;
+    return output;
+}
+
+@end
+
+@interface MXBase64Decoder ()
+{
+    const uint8_t *table;
+    MXBase64DecodingState state;
+}
+@end
+
+@implementation MXBase64Decoder
+
+- (instancetype)init
+{
+    return [self initWithURLSafeAlphabet:NO];
+}
+
+- (instancetype)initWithURLSafeAlphabet:(BOOL)urlSafe
+{
+    self = [super init];
+    if (self)
+    {
+        table = MXBase64DecodingTable(urlSafe);
+    }
+    return self;
+}
+
+- (NSData *)decodeBytes:(const void *)bytes length:(NSUInteger)length
+{
+    NSMutableData *output = [NSMutableData dataWithLength:MXBase64DecodedMaxLength(state.count + length)];
+    output.length = MXBase64Decode(bytes, length, table, &state, output.mutableBytes);
+    return output;
+}
+
+- (NSData *)finish
+{
+    uint8_t output[2];
+    NSInteger length = MXBase64DecodeFinal(&state, output);
+    return length < 0 ? nil : [NSData dataWithBytes:output length:length];
 }
 
 @end
@@ -19,6 +19,7 @@
 #import <Foundation/Foundation.h>
 
 #import "MXHTTPOperation.h"
+#import "MXHTTPRequestScheduler.h"
 
 /**
  `MXHTTPClientErrorResponseDataKey`
@@ -136,6 +137,13 @@ typedef NS_ENUM(NSUInteger, MXHTTPClientSSLPinningMode) {
  */
 @property (nonatomic, readonly) BOOL isAuthenticatedClient;
 
+/**
+ The scheduler of the requests, if any.
+ It is created if `MXSDKOptions.enableHTTPRequestScheduling` is YES. Requests are sent
+ immediately when it is nil.
+ */
+@property (nonatomic) MXHTTPRequestScheduler *requestScheduler;
+
 #pragma mark - Public methods
 /**
  Create an instance to make requests to the server.
@@ -126,6 +126,11 @@ static NSUInteger requestCount = 0;
         [self setUpNetworkReachibility];
         [self setUpSSLCertificatesHandler];
 
+        if ([MXSDKOptions sharedInstance].enableHTTPRequestScheduling)
+        {
+            _requestScheduler = [[MXHTTPRequestScheduler alloc] init];
+        }
+
         // Track potential expected session invalidation (seen on iOS10 beta)
         MXWeakify(self);
         [httpManager setSessionDidBecomeInvalidBlock:^(NSURLSession * _Nonnull session, NSError * _Nonnull error) {
@@ -209,6 +214,43 @@ static NSUInteger requestCount = 0;
                        uploadProgress:(void (^)(NSProgress *uploadProgress))uploadProgress
                               success:(void (^)(NSDictionary *JSONResponse))success
                               failure:(void (^)(NSError *error))failure
+{
+    // Share identical idempotent requests in flight
+    MXHTTPRequestScheduler *requestScheduler = _requestScheduler;
+    NSString *coalescingKey;
+    if (requestScheduler && !uploadProgress)
+    {
+        coalescingKey = [MXHTTPRequestScheduler coalescingKeyForMethod:httpMethod path:path parameters:parameters data:data headers:headers];
+    }
+
+    if (coalescingKey)
+    {
+        // The Authorization and Content-Type headers come from the client: its access token and its serializer.
+        // So, requests of different clients sharing the scheduler are never shared
+        coalescingKey = [NSString stringWithFormat:@"%@ %p %@ %@ %@", coalescingKey, self, @(needsAuthentication), @(_requestParametersInJSON), @(timeoutInSeconds)];
+
+        MXWeakify(self);
+        return [requestScheduler coalesceRequestWithKey:coalescingKey
+                                                   lane:[MXHTTPRequestScheduler laneForMethod:httpMethod path:path]
+                                                request:^MXHTTPOperation *(void (^requestSuccess)(NSDictionary *), void (^requestFailure)(NSError *)) {
+            MXStrongifyAndReturnValueIfNil(self, [MXHTTPOperation new]);
+            return [self sendRequestWithMethod:httpMethod path:path parameters:parameters needsAuthentication:needsAuthentication data:data headers:headers timeout:timeoutInSeconds uploadProgress:nil success:requestSuccess failure:requestFailure];
+        } success:success failure:failure];
+    }
+
+    return [self sendRequestWithMethod:httpMethod path:path parameters:parameters needsAuthentication:needsAuthentication data:data headers:headers timeout:timeoutInSeconds uploadProgress:uploadProgress success:success failure:failure];
+}
+
+- (MXHTTPOperation*)sendRequestWithMethod:(NSString *)httpMethod
+                                     path:(NSString *)path
+                               parameters:(NSDictionary*)parameters
+                      needsAuthentication:(BOOL)needsAuthentication
+                                     data:(NSData *)data
+                                  headers:(NSDictionary*)headers
+                                  timeout:(NSTimeInterval)timeoutInSeconds
+                           uploadProgress:(void (^)(NSProgress *uploadProgress))uploadProgress
+                                  success:(void (^)(NSDictionary *JSONResponse))success
+                                  failure:(void (^)(NSError *error))failure
 {
     MXHTTPOperation *mxHTTPOperation = [[MXHTTPOperation alloc] init];
     
@@ -301,7 +343,74 @@ static NSUInteger requestCount = 0;
     	MXLogDebug(@"[MXHTTPClient] tryRequest: ignore the request as the NSURLSession has been invalidated");
         return;
     }
-    
+
+    MXHTTPRequestScheduler *requestScheduler = _requestScheduler;
+    if (!requestScheduler)
+    {
+        [self startRequest:mxHTTPOperation method:httpMethod path:path parameters:parameters data:data headers:headers accessToken:accessToken timeout:timeoutInSeconds uploadProgress:uploadProgress completion:nil success:success failure:failure];
+        return;
+    }
+
+    // Wait for a free slot in the lane of the request
+    MXHTTPRequestLane lane = [MXHTTPRequestScheduler laneForMethod:httpMethod path:path];
+    MXWeakify(self);
+    [requestScheduler scheduleRequestInLane:lane block:^(dispatch_block_t completion) {
+        if (!weakself)
+        {
+            completion();
+            return;
+        }
+        MXStrongifyAndReturnIfNil(self);
+
+        if (self->invalidatedSession)
+        {
+            completion();
+            return;
+        }
+
+        // The request may have been cancelled while it was waiting
+        if (mxHTTPOperation.isCancelled)
+        {
+            MXLogDebug(@"[MXHTTPClient] tryRequest: Request %p cancelled before being sent", mxHTTPOperation);
+            completion();
+            failure([NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]);
+            return;
+        }
+
+        [self startRequest:mxHTTPOperation method:httpMethod path:path parameters:parameters data:data headers:headers accessToken:accessToken timeout:timeoutInSeconds uploadProgress:uploadProgress completion:completion success:success failure:failure];
+
+        switch (lane)
+        {
+            case MXHTTPRequestLaneSend:
+                mxHTTPOperation.operation.priority = NSURLSessionTaskPriorityHigh;
+                break;
+            case MXHTTPRequestLaneBackground:
+                mxHTTPOperation.operation.priority = NSURLSessionTaskPriorityLow;
+                break;
+            default:
+                break;
+        }
+    }];
+}
+
+/**
+ Send a request attempt.
+
+ @param completion (optional) the block to call once the attempt is complete, before calling `success` or `failure`.
+ */
+- (void)startRequest:(MXHTTPOperation*)mxHTTPOperation
+              method:(NSString *)httpMethod
+                path:(NSString *)path
+          parameters:(NSDictionary*)parameters
+                data:(NSData *)data
+             headers:(NSDictionary*)headers
+         accessToken:(NSString*)accessToken
+             timeout:(NSTimeInterval)timeoutInSeconds
+      uploadProgress:(void (^)(NSProgress *uploadProgress))uploadProgress
+          completion:(dispatch_block_t)completion
+             success:(void (^)(NSDictionary *JSONResponse))success
+             failure:(void (^)(NSError *error))failure
+{
     if (accessToken)
     {
         [httpManager.requestSerializer setValue:[NSString stringWithFormat:@"Bearer %@", accessToken] forHTTPHeaderField:@"Authorization"];
@@ -353,6 +462,12 @@ static NSUInteger requestCount = 0;
         NSHTTPURLResponse *response = (NSHTTPURLResponse*)theResponse;
         mxHTTPOperation.httpResponse = response;
 
+        // Free the slot of the request in its lane
+        if (completion)
+        {
+            completion();
+        }
+
         MXLogDebug(@"[MXHTTPClient] #%@ - %@ %@ completed in %.0fms" ,@(requestNumber), httpMethod, path, [[NSDate date] timeIntervalSinceDate:startDate] * 1000);
 
         if (!weakself)
@@ -0,0 +1,210 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+@class MXHTTPOperation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The lanes in which `MXHTTPRequestScheduler` runs requests.
+ Each lane has its own concurrency limit so that requests of a lane never wait for requests of another one.
+ */
+typedef NS_ENUM(NSUInteger, MXHTTPRequestLane) {
+    /**
+     The `/sync` long poll.
+     */
+    MXHTTPRequestLaneSync,
+    /**
+     User-visible sends: events, redactions, state events and to-device messages.
+     */
+    MXHTTPRequestLaneSend,
+    /**
+     Media uploads. They are long, so they do not take the slots of the other sends.
+     */
+    MXHTTPRequestLaneUpload,
+    /**
+     Other requests. This is the default lane.
+     */
+    MXHTTPRequestLaneInteractive,
+    /**
+     Bulk fetches: media downloads, thumbnails, URL previews and key backup.
+     */
+    MXHTTPRequestLaneBackground,
+};
+
+/**
+ The number of `MXHTTPRequestLane` values.
+ */
+FOUNDATION_EXPORT NSUInteger const MXHTTPRequestLaneCount;
+
+/**
+ Block that sends a request.
+
+ @param success the block to call with the JSON response.
+ @param failure the block to call in case of error.
+ @return the HTTP operation.
+ */
+typedef MXHTTPOperation* _Nonnull (^MXHTTPRequestSchedulerRequestBlock)(void (^success)(NSDictionary *JSONResponse), void (^failure)(NSError *error));
+
+
+/**
+ A snapshot of the activity of a lane.
+ */
+@interface MXHTTPRequestLaneMetrics : NSObject
+
+/**
+ The lane.
+ */
+@property (nonatomic, readonly) MXHTTPRequestLane lane;
+
+/**
+ The maximum number of requests running at the same time in the lane.
+ */
+@property (nonatomic, readonly) NSUInteger maxConcurrentRequests;
+
+/**
+ The number of requests running.
+ */
+@property (nonatomic, readonly) NSUInteger runningRequestsCount;
+
+/**
+ The number of requests waiting for a free slot.
+ */
+@property (nonatomic, readonly) NSUInteger queuedRequestsCount;
+
+/**
+ The number of requests started since the creation of the scheduler or the last `resetMetrics`.
+ */
+@property (nonatomic, readonly) NSUInteger startedRequestsCount;
+
+/**
+ The number of requests that joined an identical request in flight instead of being sent.
+ */
+@property (nonatomic, readonly) NSUInteger coalescedRequestsCount;
+
+/**
+ The average and the maximum time spent by started requests waiting for a free slot, in milliseconds.
+ */
+@property (nonatomic, readonly) NSUInteger averageQueueingTime;
+@property (nonatomic, readonly) NSUInteger maxQueueingTime;
+
+@end
+
+
+/**
+ `MXHTTPRequestScheduler` is the scheduling layer of `MXHTTPClient`.
+
+ It routes requests to priority lanes with their own concurrency limits and shares a single
+ request between identical idempotent requests in flight.
+
+ This class is thread safe.
+ */
+@interface MXHTTPRequestScheduler : NSObject
+
+/**
+ Create a scheduler with the default concurrency limits.
+ */
+- (instancetype)init;
+
+/**
+ Set the maximum number of requests running at the same time in a lane.
+
+ @param maxConcurrentRequests the limit. Must be greater than 0.
+ @param lane the lane.
+ */
+- (void)setMaxConcurrentRequests:(NSUInteger)maxConcurrentRequests forLane:(MXHTTPRequestLane)lane;
+
+/**
+ Get the maximum number of requests running at the same time in a lane.
+
+ @param lane the lane.
+ @return the limit.
+ */
+- (NSUInteger)maxConcurrentRequestsForLane:(MXHTTPRequestLane)lane;
+
+/**
+ Run a request in a lane.
+
+ `block` is called immediately if the lane has a free slot, else when one is freed, in FIFO order.
+ It must call the `completion` block it gets exactly once, when the request is complete.
+
+ @param lane the lane.
+ @param block the block that starts the request.
+ */
+- (void)scheduleRequestInLane:(MXHTTPRequestLane)lane block:(void (^)(dispatch_block_t completion))block;
+
+/**
+ Share a request between identical requests in flight.
+
+ Each caller gets its own `MXHTTPOperation`. The shared request is cancelled only when all callers
+ have cancelled theirs.
+
+ @param key the key identifying the request. See `coalescingKeyForMethod:path:parameters:data:headers:`.
+ @param lane the lane of the request, for metrics.
+ @param request the block that sends the request. It is not called if an identical request is in flight.
+ @param success A block object called when the operation succeeds.
+ @param failure A block object called when the operation fails.
+ @return the operation of the caller.
+ */
+- (MXHTTPOperation*)coalesceRequestWithKey:(NSString*)key
+                                      lane:(MXHTTPRequestLane)lane
+                                   request:(MXHTTPRequestSchedulerRequestBlock)request
+                                   success:(void (^)(NSDictionary *JSONResponse))success
+                                   failure:(void (^)(NSError *error))failure;
+
+/**
+ Get the metrics of a lane.
+
+ @param lane the lane.
+ @return a snapshot of the lane activity.
+ */
+- (MXHTTPRequestLaneMetrics*)metricsForLane:(MXHTTPRequestLane)lane;
+
+/**
+ Reset the counters of all lanes.
+ */
+- (void)resetMetrics;
+
+/**
+ Get the lane of a request.
+
+ @param httpMethod the HTTP method.
+ @param path the path of the request.
+ @return the lane.
+ */
++ (MXHTTPRequestLane)laneForMethod:(NSString*)httpMethod path:(NSString*)path;
+
+/**
+ Get the key identifying a request that can be shared.
+
+ @param httpMethod the HTTP method.
+ @param path the path of the request.
+ @param parameters the parameters of the request.
+ @param data the body of the request.
+ @param headers the headers specific to the request. Requests with different headers are not shared.
+ @return the key. nil if the request is not idempotent.
+ */
++ (nullable NSString*)coalescingKeyForMethod:(NSString*)httpMethod
+                                        path:(NSString*)path
+                                  parameters:(nullable NSDictionary*)parameters
+                                        data:(nullable NSData*)data
+                                     headers:(nullable NSDictionary<NSString*, NSString*>*)headers;
+
+@end
+
+NS_ASSUME_NONNULL_END
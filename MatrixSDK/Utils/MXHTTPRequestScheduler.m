@@ -0,0 +1,559 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXHTTPRequestScheduler.h"
+
+#import "MXHTTPOperation.h"
+#import "MXLog.h"
+#import "MXTools.h"
+
+NSUInteger const MXHTTPRequestLaneCount = MXHTTPRequestLaneBackground + 1;
+
+/**
+ Default concurrency limits by lane.
+ */
+static NSUInteger const kMXHTTPRequestSchedulerDefaultLimits[] = {
+    1,  // MXHTTPRequestLaneSync
+    2,  // MXHTTPRequestLaneSend
+    2,  // MXHTTPRequestLaneUpload
+    4,  // MXHTTPRequestLaneInteractive
+    2,  // MXHTTPRequestLaneBackground
+};
+
+
+#pragma mark - MXHTTPRequestLaneMetrics
+
+@interface MXHTTPRequestLaneMetrics ()
+
+@property (nonatomic, readwrite) MXHTTPRequestLane lane;
+@property (nonatomic, readwrite) NSUInteger maxConcurrentRequests;
+@property (nonatomic, readwrite) NSUInteger runningRequestsCount;
+@property (nonatomic, readwrite) NSUInteger queuedRequestsCount;
+@property (nonatomic, readwrite) NSUInteger startedRequestsCount;
+@property (nonatomic, readwrite) NSUInteger coalescedRequestsCount;
+@property (nonatomic, readwrite) NSUInteger averageQueueingTime;
+@property (nonatomic, readwrite) NSUInteger maxQueueingTime;
+
+@end
+
+@implementation MXHTTPRequestLaneMetrics
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<MXHTTPRequestLaneMetrics: lane: %@, running: %@/%@, queued: %@, started: %@, coalesced: %@, queueing time: avg %@ms, max %@ms>",
+            @(_lane), @(_runningRequestsCount), @(_maxConcurrentRequests), @(_queuedRequestsCount),
+            @(_startedRequestsCount), @(_coalescedRequestsCount), @(_averageQueueingTime), @(_maxQueueingTime)];
+}
+
+@end
+
+
+#pragma mark - MXHTTPRequestSchedulerLane
+
+/**
+ The state of a lane.
+ */
+@interface MXHTTPRequestSchedulerLane : NSObject
+
+@property (nonatomic) NSUInteger maxConcurrentRequests;
+@property (nonatomic) NSUInteger runningRequestsCount;
+
+// Blocks of requests waiting for a free slot with their enqueuing date
+@property (nonatomic) NSMutableArray<void (^)(dispatch_block_t)> *queuedBlocks;
+@property (nonatomic) NSMutableArray<NSDate*> *queuedDates;
+
+@property (nonatomic) NSUInteger startedRequestsCount;
+@property (nonatomic) NSUInteger coalescedRequestsCount;
+@property (nonatomic) NSTimeInterval totalQueueingTime;
+@property (nonatomic) NSTimeInterval maxQueueingTime;
+
+@end
+
+@implementation MXHTTPRequestSchedulerLane
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _queuedBlocks = [NSMutableArray array];
+        _queuedDates = [NSMutableArray array];
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark - MXHTTPCoalescedOperation
+
+/**
+ The operation returned to a caller of a shared request. It notifies the scheduler when it is cancelled.
+ */
+@interface MXHTTPCoalescedOperation : MXHTTPOperation
+
+@property (nonatomic, copy) dispatch_block_t onCancel;
+
+/**
+ The shared request operation, if this caller created it.
+ Retry settings applied to the caller operation are forwarded to it.
+ */
+@property (nonatomic, weak) MXHTTPOperation *ownedOperation;
+
+@end
+
+@implementation MXHTTPCoalescedOperation
+
+- (void)cancel
+{
+    if (self.isCancelled)
+    {
+        return;
+    }
+
+    // The shared request is cancelled by the scheduler once nobody waits for it
+    self.operation = nil;
+    [super cancel];
+
+    dispatch_block_t onCancel = self.onCancel;
+    self.onCancel = nil;
+    if (onCancel)
+    {
+        onCancel();
+    }
+}
+
+- (void)setMaxNumberOfTries:(NSUInteger)maxNumberOfTries
+{
+    [super setMaxNumberOfTries:maxNumberOfTries];
+    self.ownedOperation.maxNumberOfTries = maxNumberOfTries;
+}
+
+- (void)setMaxRetriesTime:(NSUInteger)maxRetriesTime
+{
+    [super setMaxRetriesTime:maxRetriesTime];
+    self.ownedOperation.maxRetriesTime = maxRetriesTime;
+}
+
+@end
+
+
+#pragma mark - MXHTTPCoalescedRequest
+
+@interface MXHTTPCoalescedRequest : NSObject
+
+@property (nonatomic) MXHTTPOperation *operation;
+@property (nonatomic) NSMutableArray<MXHTTPCoalescedOperation*> *callerOperations;
+@property (nonatomic) NSMutableArray<void (^)(NSDictionary*)> *successBlocks;
+@property (nonatomic) NSMutableArray<void (^)(NSError*)> *failureBlocks;
+
+@end
+
+@implementation MXHTTPCoalescedRequest
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _callerOperations = [NSMutableArray array];
+        _successBlocks = [NSMutableArray array];
+        _failureBlocks = [NSMutableArray array];
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark - MXHTTPRequestScheduler
+
+@interface MXHTTPRequestScheduler ()
+{
+    NSArray<MXHTTPRequestSchedulerLane*> *lanes;
+
+    // Shared requests in flight by coalescing key
+    NSMutableDictionary<NSString*, MXHTTPCoalescedRequest*> *coalescedRequests;
+}
+@end
+
+@implementation MXHTTPRequestScheduler
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        NSMutableArray<MXHTTPRequestSchedulerLane*> *theLanes = [NSMutableArray arrayWithCapacity:MXHTTPRequestLaneCount];
+        for (NSUInteger lane = 0; lane < MXHTTPRequestLaneCount; lane++)
+        {
+            MXHTTPRequestSchedulerLane *schedulerLane = [MXHTTPRequestSchedulerLane new];
+            schedulerLane.maxConcurrentRequests = kMXHTTPRequestSchedulerDefaultLimits[lane];
+            [theLanes addObject:schedulerLane];
+        }
+        lanes = theLanes;
+        coalescedRequests = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (void)setMaxConcurrentRequests:(NSUInteger)maxConcurrentRequests forLane:(MXHTTPRequestLane)lane
+{
+    NSParameterAssert(maxConcurrentRequests > 0);
+
+    NSMutableArray<dispatch_block_t> *blocksToStart = [NSMutableArray array];
+    @synchronized (self)
+    {
+        lanes[lane].maxConcurrentRequests = MAX(maxConcurrentRequests, 1);
+
+        // A higher limit may free slots
+        dispatch_block_t block;
+        while ((block = [self dequeueBlockInLane:lane]))
+        {
+            [blocksToStart addObject:block];
+        }
+    }
+
+    for (dispatch_block_t block in blocksToStart)
+    {
+        block();
+    }
+}
+
+- (NSUInteger)maxConcurrentRequestsForLane:(MXHTTPRequestLane)lane
+{
+    @synchronized (self)
+    {
+        return lanes[lane].maxConcurrentRequests;
+    }
+}
+
+- (void)scheduleRequestInLane:(MXHTTPRequestLane)lane block:(void (^)(dispatch_block_t))block
+{
+    dispatch_block_t blockToStart;
+    @synchronized (self)
+    {
+        [lanes[lane].queuedBlocks addObject:[block copy]];
+        [lanes[lane].queuedDates addObject:[NSDate date]];
+        blockToStart = [self dequeueBlockInLane:lane];
+    }
+
+    if (blockToStart)
+    {
+        blockToStart();
+    }
+}
+
+- (MXHTTPOperation *)coalesceRequestWithKey:(NSString *)key
+                                       lane:(MXHTTPRequestLane)lane
+                                    request:(MXHTTPRequestSchedulerRequestBlock)request
+                                    success:(void (^)(NSDictionary *))success
+                                    failure:(void (^)(NSError *))failure
+{
+    MXHTTPCoalescedOperation *callerOperation = [MXHTTPCoalescedOperation new];
+    MXHTTPCoalescedRequest *coalescedRequest;
+    BOOL isNewRequest = NO;
+
+    @synchronized (self)
+    {
+        coalescedRequest = coalescedRequests[key];
+        if (coalescedRequest)
+        {
+            lanes[lane].coalescedRequestsCount++;
+        }
+        else
+        {
+            coalescedRequest = [MXHTTPCoalescedRequest new];
+            coalescedRequests[key] = coalescedRequest;
+            isNewRequest = YES;
+        }
+
+        [coalescedRequest.callerOperations addObject:callerOperation];
+        [coalescedRequest.successBlocks addObject:success ? [success copy] : ^(NSDictionary *JSONResponse) {}];
+        [coalescedRequest.failureBlocks addObject:failure ? [failure copy] : ^(NSError *error) {}];
+    }
+
+    MXWeakify(self);
+    MXWeakify(coalescedRequest);
+    MXWeakify(callerOperation);
+    callerOperation.onCancel = ^{
+        MXStrongifyAndReturnIfNil(self);
+        MXStrongifyAndReturnIfNil(coalescedRequest);
+        MXStrongifyAndReturnIfNil(callerOperation);
+        [self cancelCallerOperation:callerOperation ofRequest:coalescedRequest withKey:key];
+    };
+
+    if (isNewRequest)
+    {
+        MXHTTPCoalescedRequest *theRequest = coalescedRequest;
+        MXHTTPOperation *operation = request(^(NSDictionary *JSONResponse) {
+            MXStrongifyAndReturnIfNil(self);
+            [self completeRequest:theRequest withKey:key JSONResponse:JSONResponse error:nil];
+        }, ^(NSError *error) {
+            MXStrongifyAndReturnIfNil(self);
+            [self completeRequest:theRequest withKey:key JSONResponse:nil error:error];
+        });
+
+        @synchronized (self)
+        {
+            coalescedRequest.operation = operation;
+        }
+        callerOperation.ownedOperation = operation;
+    }
+
+    return callerOperation;
+}
+
+- (MXHTTPRequestLaneMetrics *)metricsForLane:(MXHTTPRequestLane)lane
+{
+    MXHTTPRequestLaneMetrics *metrics = [MXHTTPRequestLaneMetrics new];
+    @synchronized (self)
+    {
+        MXHTTPRequestSchedulerLane *schedulerLane = lanes[lane];
+        metrics.lane = lane;
+        metrics.maxConcurrentRequests = schedulerLane.maxConcurrentRequests;
+        metrics.runningRequestsCount = schedulerLane.runningRequestsCount;
+        metrics.queuedRequestsCount = schedulerLane.queuedBlocks.count;
+        metrics.startedRequestsCount = schedulerLane.startedRequestsCount;
+        metrics.coalescedRequestsCount = schedulerLane.coalescedRequestsCount;
+        if (schedulerLane.startedRequestsCount)
+        {
+            metrics.averageQueueingTime = schedulerLane.totalQueueingTime * 1000 / schedulerLane.startedRequestsCount;
+        }
+        metrics.maxQueueingTime = schedulerLane.maxQueueingTime * 1000;
+    }
+    return metrics;
+}
+
+- (void)resetMetrics
+{
+    @synchronized (self)
+    {
+        for (MXHTTPRequestSchedulerLane *schedulerLane in lanes)
+        {
+            schedulerLane.startedRequestsCount = 0;
+            schedulerLane.coalescedRequestsCount = 0;
+            schedulerLane.totalQueueingTime = 0;
+            schedulerLane.maxQueueingTime = 0;
+        }
+    }
+}
+
++ (MXHTTPRequestLane)laneForMethod:(NSString *)httpMethod path:(NSString *)path
+{
+    NSString *pathWithoutQuery = [path componentsSeparatedByString:@"?"].firstObject;
+
+    if ([pathWithoutQuery hasSuffix:@"/sync"])
+    {
+        return MXHTTPRequestLaneSync;
+    }
+
+    if ([pathWithoutQuery containsString:@"/download/"]
+        || [pathWithoutQuery containsString:@"/thumbnail/"]
+        || [pathWithoutQuery hasSuffix:@"/preview_url"]
+        || [pathWithoutQuery containsString:@"/room_keys/"])
+    {
+        return MXHTTPRequestLaneBackground;
+    }
+
+    if ([httpMethod isEqualToString:@"GET"])
+    {
+        return MXHTTPRequestLaneInteractive;
+    }
+
+    if ([pathWithoutQuery hasSuffix:@"/upload"])
+    {
+        return MXHTTPRequestLaneUpload;
+    }
+
+    if ([pathWithoutQuery containsString:@"/send/"]
+        || [pathWithoutQuery containsString:@"/sendToDevice/"]
+        || [pathWithoutQuery containsString:@"/redact/"]
+        || [pathWithoutQuery containsString:@"/state/"])
+    {
+        return MXHTTPRequestLaneSend;
+    }
+
+    return MXHTTPRequestLaneInteractive;
+}
+
++ (NSString *)coalescingKeyForMethod:(NSString *)httpMethod path:(NSString *)path parameters:(NSDictionary *)parameters data:(NSData *)data headers:(NSDictionary<NSString *,NSString *> *)headers
+{
+    if (data || !([httpMethod isEqualToString:@"GET"] || [httpMethod isEqualToString:@"HEAD"]))
+    {
+        return nil;
+    }
+
+    NSString *parametersString = @"";
+    if (parameters.count)
+    {
+        NSData *parametersData = [NSJSONSerialization dataWithJSONObject:parameters options:NSJSONWritingSortedKeys error:nil];
+        if (!parametersData)
+        {
+            return nil;
+        }
+        parametersString = [[NSString alloc] initWithData:parametersData encoding:NSUTF8StringEncoding];
+    }
+
+    // Header names are case insensitive
+    NSString *headersString = @"";
+    if (headers.count)
+    {
+        NSMutableDictionary<NSString*, NSString*> *normalisedHeaders = [NSMutableDictionary dictionaryWithCapacity:headers.count];
+        for (NSString *name in headers)
+        {
+            normalisedHeaders[name.lowercaseString] = headers[name];
+        }
+
+        NSData *headersData = [NSJSONSerialization dataWithJSONObject:normalisedHeaders options:NSJSONWritingSortedKeys error:nil];
+        if (!headersData)
+        {
+            return nil;
+        }
+        headersString = [[NSString alloc] initWithData:headersData encoding:NSUTF8StringEncoding];
+    }
+
+    return [NSString stringWithFormat:@"%@ %@ %@ %@", httpMethod, path, parametersString, headersString];
+}
+
+#pragma mark - Private
+
+/**
+ Take the next request of a lane if the lane has a free slot.
+ Must be called under the lock.
+
+ @return the block starting the request. nil if there is no request to start.
+ */
+- (dispatch_block_t)dequeueBlockInLane:(MXHTTPRequestLane)lane
+{
+    MXHTTPRequestSchedulerLane *schedulerLane = lanes[lane];
+    if (!schedulerLane.queuedBlocks.count || schedulerLane.runningRequestsCount >= schedulerLane.maxConcurrentRequests)
+    {
+        return nil;
+    }
+
+    void (^block)(dispatch_block_t) = schedulerLane.queuedBlocks.firstObject;
+    NSDate *queuedDate = schedulerLane.queuedDates.firstObject;
+    [schedulerLane.queuedBlocks removeObjectAtIndex:0];
+    [schedulerLane.queuedDates removeObjectAtIndex:0];
+
+    NSTimeInterval queueingTime = -queuedDate.timeIntervalSinceNow;
+    schedulerLane.runningRequestsCount++;
+    schedulerLane.startedRequestsCount++;
+    schedulerLane.totalQueueingTime += queueingTime;
+    schedulerLane.maxQueueingTime = MAX(schedulerLane.maxQueueingTime, queueingTime);
+
+    MXWeakify(self);
+    __block BOOL completed = NO;
+    dispatch_block_t completion = ^{
+        MXStrongifyAndReturnIfNil(self);
+
+        dispatch_block_t blockToStart;
+        @synchronized (self)
+        {
+            // Make sure the slot is released only once
+            if (completed)
+            {
+                MXLogError(@"[MXHTTPRequestScheduler] Request already completed in lane %@", @(lane));
+                return;
+            }
+            completed = YES;
+
+            self->lanes[lane].runningRequestsCount--;
+            blockToStart = [self dequeueBlockInLane:lane];
+        }
+
+        if (blockToStart)
+        {
+            blockToStart();
+        }
+    };
+
+    return ^{
+        block(completion);
+    };
+}
+
+- (void)completeRequest:(MXHTTPCoalescedRequest*)request withKey:(NSString*)key JSONResponse:(NSDictionary*)JSONResponse error:(NSError*)error
+{
+    NSArray<MXHTTPCoalescedOperation*> *callerOperations;
+    NSArray<void (^)(NSDictionary*)> *successBlocks;
+    NSArray<void (^)(NSError*)> *failureBlocks;
+
+    @synchronized (self)
+    {
+        if (coalescedRequests[key] == request)
+        {
+            [coalescedRequests removeObjectForKey:key];
+        }
+
+        callerOperations = [request.callerOperations copy];
+        successBlocks = [request.successBlocks copy];
+        failureBlocks = [request.failureBlocks copy];
+        [request.callerOperations removeAllObjects];
+        [request.successBlocks removeAllObjects];
+        [request.failureBlocks removeAllObjects];
+    }
+
+    for (NSUInteger index = 0; index < callerOperations.count; index++)
+    {
+        MXHTTPCoalescedOperation *callerOperation = callerOperations[index];
+        if (callerOperation.isCancelled)
+        {
+            continue;
+        }
+
+        // The caller operation cannot be cancelled anymore
+        callerOperation.onCancel = nil;
+        callerOperation.httpResponse = request.operation.httpResponse;
+
+        if (error)
+        {
+            failureBlocks[index](error);
+        }
+        else
+        {
+            successBlocks[index](JSONResponse);
+        }
+    }
+}
+
+- (void)cancelCallerOperation:(MXHTTPCoalescedOperation*)callerOperation ofRequest:(MXHTTPCoalescedRequest*)request withKey:(NSString*)key
+{
+    MXHTTPOperation *operationToCancel;
+    @synchronized (self)
+    {
+        NSUInteger index = [request.callerOperations indexOfObjectIdenticalTo:callerOperation];
+        if (index == NSNotFound)
+        {
+            return;
+        }
+        [request.callerOperations removeObjectAtIndex:index];
+        [request.successBlocks removeObjectAtIndex:index];
+        [request.failureBlocks removeObjectAtIndex:index];
+
+        // Cancel the shared request once nobody waits for it
+        if (!request.callerOperations.count && coalescedRequests[key] == request)
+        {
+            [coalescedRequests removeObjectForKey:key];
+            operationToCancel = request.operation;
+        }
+    }
+
+    [operationToCancel cancel];
+}
+
+@end
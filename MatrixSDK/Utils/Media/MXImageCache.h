@@ -0,0 +1,158 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#if TARGET_OS_IPHONE
+#import <UIKit/UIKit.h>
+#elif TARGET_OS_OSX
+#import <Cocoa/Cocoa.h>
+#endif
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ `MXImageCache` is an in-memory cache of decoded images.
+
+ - It is bounded by the memory cost of the decoded bitmaps, not by a number of images.
+   The least recently used images are evicted first.
+ - Images are decoded, and optionally downscaled, off the main thread. Concurrent loads
+   of the same image share a single decode.
+ - It releases memory when the system reports memory pressure.
+
+ This class is thread safe.
+ */
+@interface MXImageCache : NSObject
+
+/**
+ Create a cache.
+
+ @param totalCostLimit the maximum memory cost of the cached images, in bytes.
+ @return a `MXImageCache` instance.
+ */
+- (instancetype)initWithTotalCostLimit:(NSUInteger)totalCostLimit;
+
+/**
+ The maximum memory cost of the cached images, in bytes.
+ Lowering it evicts images immediately.
+ */
+@property (nonatomic) NSUInteger totalCostLimit;
+
+/**
+ The memory cost of the cached images, in bytes.
+ */
+@property (nonatomic, readonly) NSUInteger totalCost;
+
+/**
+ The number of cached images.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ Get a cached image.
+
+ @param key the key of the image.
+ @return the image. nil if it is not in the cache.
+ */
+#if TARGET_OS_IPHONE
+- (nullable UIImage*)imageForKey:(NSString*)key;
+#elif TARGET_OS_OSX
+- (nullable NSImage*)imageForKey:(NSString*)key;
+#endif
+
+/**
+ Cache an image.
+
+ Images bigger than `totalCostLimit` are not cached.
+
+ @param image the image.
+ @param key the key of the image.
+ */
+#if TARGET_OS_IPHONE
+- (void)setImage:(UIImage*)image forKey:(NSString*)key;
+#elif TARGET_OS_OSX
+- (void)setImage:(NSImage*)image forKey:(NSString*)key;
+#endif
+
+/**
+ Load an image file through the cache.
+
+ The image is decoded on a background queue. It is downscaled so that its biggest
+ dimension fits `maxPixelSize`, keeping its aspect ratio.
+
+ @param filePath the path of the image file.
+ @param maxPixelSize the maximum width and height of the image, in pixels. 0 to keep the original size.
+ @param completion the block called on the main queue with the image. nil if the file cannot be decoded.
+ */
+#if TARGET_OS_IPHONE
+- (void)loadImageWithFilePath:(NSString*)filePath
+                 maxPixelSize:(NSUInteger)maxPixelSize
+                   completion:(void (^)(UIImage * _Nullable image))completion;
+#elif TARGET_OS_OSX
+- (void)loadImageWithFilePath:(NSString*)filePath
+                 maxPixelSize:(NSUInteger)maxPixelSize
+                   completion:(void (^)(NSImage * _Nullable image))completion;
+#endif
+
+/**
+ Evict the least recently used images until the cost of the cache is at most `cost`.
+
+ @param cost the cost to reach, in bytes.
+ */
+- (void)trimToCost:(NSUInteger)cost;
+
+/**
+ Empty the cache.
+ */
+- (void)removeAllImages;
+
+/**
+ Get the key of an image file loaded at a given size.
+
+ @param filePath the path of the image file.
+ @param maxPixelSize the maximum width and height of the image, in pixels. 0 for the original size.
+ @return the key.
+ */
++ (NSString*)keyForFilePath:(NSString*)filePath maxPixelSize:(NSUInteger)maxPixelSize;
+
+/**
+ Decode an image file synchronously.
+
+ @param filePath the path of the image file.
+ @param maxPixelSize the maximum width and height of the image, in pixels. 0 to keep the original size.
+ @return the decoded image. nil if the file cannot be decoded.
+ */
+#if TARGET_OS_IPHONE
++ (nullable UIImage*)decodeImageWithFilePath:(NSString*)filePath maxPixelSize:(NSUInteger)maxPixelSize;
+#elif TARGET_OS_OSX
++ (nullable NSImage*)decodeImageWithFilePath:(NSString*)filePath maxPixelSize:(NSUInteger)maxPixelSize;
+#endif
+
+/**
+ Get the memory cost of an image.
+
+ @param image the image.
+ @return the size of its decoded bitmap, in bytes.
+ */
+#if TARGET_OS_IPHONE
++ (NSUInteger)costOfImage:(UIImage*)image;
+#elif TARGET_OS_OSX
++ (NSUInteger)costOfImage:(NSImage*)image;
+#endif
+
+@end
+
+NS_ASSUME_NONNULL_END
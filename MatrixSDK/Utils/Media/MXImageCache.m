@@ -0,0 +1,358 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "MXImageCache.h"
+
+#import <ImageIO/ImageIO.h>
+
+#import "MXLog.h"
+#import "MXTools.h"
+
+#if TARGET_OS_IPHONE
+typedef UIImage MXImageCacheImage;
+#elif TARGET_OS_OSX
+typedef NSImage MXImageCacheImage;
+#endif
+
+
+#pragma mark - MXImageCacheEntry
+
+@interface MXImageCacheEntry : NSObject
+
+@property (nonatomic) MXImageCacheImage *image;
+@property (nonatomic) NSUInteger cost;
+
+@end
+
+@implementation MXImageCacheEntry
+@end
+
+
+#pragma mark - MXImageCache
+
+@interface MXImageCache ()
+{
+    // Cached images by key
+    NSMutableDictionary<NSString*, MXImageCacheEntry*> *entries;
+
+    // Keys of cached images, from the least to the most recently used
+    NSMutableOrderedSet<NSString*> *usageOrder;
+
+    // Completion blocks of the decodes in progress, by key
+    NSMutableDictionary<NSString*, NSMutableArray<void (^)(MXImageCacheImage*)>*> *pendingLoads;
+
+    NSOperationQueue *decodeQueue;
+    dispatch_source_t memoryPressureSource;
+}
+@end
+
+@implementation MXImageCache
+
+- (instancetype)initWithTotalCostLimit:(NSUInteger)totalCostLimit
+{
+    self = [super init];
+    if (self)
+    {
+        _totalCostLimit = totalCostLimit;
+        entries = [NSMutableDictionary dictionary];
+        usageOrder = [NSMutableOrderedSet orderedSet];
+        pendingLoads = [NSMutableDictionary dictionary];
+
+        decodeQueue = [[NSOperationQueue alloc] init];
+        decodeQueue.name = @"MXImageCache";
+        decodeQueue.qualityOfService = NSQualityOfServiceUserInitiated;
+        decodeQueue.maxConcurrentOperationCount = MAX(NSProcessInfo.processInfo.activeProcessorCount, 2) - 1;
+
+        [self observeMemoryPressure];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (memoryPressureSource)
+    {
+        dispatch_source_cancel(memoryPressureSource);
+    }
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (void)setTotalCostLimit:(NSUInteger)totalCostLimit
+{
+    @synchronized (self)
+    {
+        _totalCostLimit = totalCostLimit;
+    }
+    [self trimToCost:totalCostLimit];
+}
+
+- (NSUInteger)totalCost
+{
+    @synchronized (self)
+    {
+        return _totalCost;
+    }
+}
+
+- (NSUInteger)count
+{
+    @synchronized (self)
+    {
+        return entries.count;
+    }
+}
+
+- (MXImageCacheImage *)imageForKey:(NSString *)key
+{
+    @synchronized (self)
+    {
+        MXImageCacheEntry *entry = entries[key];
+        if (!entry)
+        {
+            return nil;
+        }
+
+        [usageOrder removeObject:key];
+        [usageOrder addObject:key];
+        return entry.image;
+    }
+}
+
+- (void)setImage:(MXImageCacheImage *)image forKey:(NSString *)key
+{
+    NSUInteger cost = [MXImageCache costOfImage:image];
+
+    @synchronized (self)
+    {
+        [self removeEntryForKey:key];
+
+        if (cost > _totalCostLimit)
+        {
+            MXLogDebug(@"[MXImageCache] setImage: Image too big to be cached: %@ bytes", @(cost));
+            return;
+        }
+
+        MXImageCacheEntry *entry = [MXImageCacheEntry new];
+        entry.image = image;
+        entry.cost = cost;
+        entries[key] = entry;
+        [usageOrder addObject:key];
+        _totalCost += cost;
+
+        [self trimToCost:_totalCostLimit];
+    }
+}
+
+- (void)loadImageWithFilePath:(NSString *)filePath
+                 maxPixelSize:(NSUInteger)maxPixelSize
+                   completion:(void (^)(MXImageCacheImage * _Nullable))completion
+{
+    NSString *key = [MXImageCache keyForFilePath:filePath maxPixelSize:maxPixelSize];
+
+    MXImageCacheImage *image = [self imageForKey:key];
+    if (image)
+    {
+        if (NSThread.isMainThread)
+        {
+            completion(image);
+        }
+        else
+        {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                completion(image);
+            });
+        }
+        return;
+    }
+
+    @synchronized (self)
+    {
+        NSMutableArray *completions = pendingLoads[key];
+        if (completions)
+        {
+            // Join the decode in progress
+            [completions addObject:completion];
+            return;
+        }
+        pendingLoads[key] = [NSMutableArray arrayWithObject:completion];
+    }
+
+    [decodeQueue addOperationWithBlock:^{
+        MXImageCacheImage *image = [MXImageCache decodeImageWithFilePath:filePath maxPixelSize:maxPixelSize];
+        if (image)
+        {
+            [self setImage:image forKey:key];
+        }
+
+        NSArray<void (^)(MXImageCacheImage*)> *completions;
+        @synchronized (self)
+        {
+            completions = self->pendingLoads[key];
+            [self->pendingLoads removeObjectForKey:key];
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            for (void (^completion)(MXImageCacheImage*) in completions)
+            {
+                completion(image);
+            }
+        });
+    }];
+}
+
+- (void)trimToCost:(NSUInteger)cost
+{
+    @synchronized (self)
+    {
+        while (_totalCost > cost && usageOrder.count)
+        {
+            [self removeEntryForKey:usageOrder.firstObject];
+        }
+    }
+}
+
+- (void)removeAllImages
+{
+    @synchronized (self)
+    {
+        [entries removeAllObjects];
+        [usageOrder removeAllObjects];
+        _totalCost = 0;
+    }
+}
+
++ (NSString *)keyForFilePath:(NSString *)filePath maxPixelSize:(NSUInteger)maxPixelSize
+{
+    if (!maxPixelSize)
+    {
+        return filePath;
+    }
+    return [NSString stringWithFormat:@"%@#%@", filePath, @(maxPixelSize)];
+}
+
++ (MXImageCacheImage *)decodeImageWithFilePath:(NSString *)filePath maxPixelSize:(NSUInteger)maxPixelSize
+{
+    NSURL *fileURL = [NSURL fileURLWithPath:filePath];
+    NSDictionary *sourceOptions = @{ (id)kCGImageSourceShouldCache: @NO };
+    CGImageSourceRef source = CGImageSourceCreateWithURL((__bridge CFURLRef)fileURL, (__bridge CFDictionaryRef)sourceOptions);
+    if (!source)
+    {
+        return nil;
+    }
+
+    NSUInteger pixelSize = maxPixelSize;
+    if (!pixelSize)
+    {
+        NSDictionary *properties = CFBridgingRelease(CGImageSourceCopyPropertiesAtIndex(source, 0, NULL));
+        pixelSize = MAX([properties[(id)kCGImagePropertyPixelWidth] unsignedIntegerValue],
+                        [properties[(id)kCGImagePropertyPixelHeight] unsignedIntegerValue]);
+    }
+
+    CGImageRef cgImage = NULL;
+    if (pixelSize)
+    {
+        // The thumbnail API decodes at the target size directly, applies the EXIF orientation
+        // and returns a bitmap that does not need to be decoded again at display time
+        NSDictionary *options = @{
+            (id)kCGImageSourceCreateThumbnailFromImageAlways: @YES,
+            (id)kCGImageSourceCreateThumbnailWithTransform: @YES,
+            (id)kCGImageSourceShouldCacheImmediately: @YES,
+            (id)kCGImageSourceThumbnailMaxPixelSize: @(pixelSize)
+        };
+        cgImage = CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+    }
+    CFRelease(source);
+
+    if (!cgImage)
+    {
+        return nil;
+    }
+
+#if TARGET_OS_IPHONE
+    UIImage *image = [UIImage imageWithCGImage:cgImage scale:1 orientation:UIImageOrientationUp];
+#elif TARGET_OS_OSX
+    NSImage *image = [[NSImage alloc] initWithCGImage:cgImage size:NSZeroSize];
+#endif
+    CGImageRelease(cgImage);
+
+    return image;
+}
+
++ (NSUInteger)costOfImage:(MXImageCacheImage *)image
+{
+#if TARGET_OS_IPHONE
+    CGImageRef cgImage = image.CGImage;
+    CGFloat scale = image.scale;
+#elif TARGET_OS_OSX
+    CGImageRef cgImage = [image CGImageForProposedRect:NULL context:nil hints:nil];
+    CGFloat scale = 1;
+#endif
+
+    if (cgImage)
+    {
+        return CGImageGetBytesPerRow(cgImage) * CGImageGetHeight(cgImage);
+    }
+
+    // Assume 4 bytes per pixel
+    return image.size.width * scale * image.size.height * scale * 4;
+}
+
+#pragma mark - Private
+
+- (void)removeEntryForKey:(NSString*)key
+{
+    MXImageCacheEntry *entry = entries[key];
+    if (entry)
+    {
+        _totalCost -= entry.cost;
+        [entries removeObjectForKey:key];
+        [usageOrder removeObject:key];
+    }
+}
+
+- (void)observeMemoryPressure
+{
+    memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                                  DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                                  dispatch_get_main_queue());
+
+    MXWeakify(self);
+    dispatch_source_set_event_handler(memoryPressureSource, ^{
+        MXStrongifyAndReturnIfNil(self);
+
+        dispatch_source_memorypressure_flags_t flags = dispatch_source_get_data(self->memoryPressureSource);
+        if (flags & DISPATCH_MEMORYPRESSURE_CRITICAL)
+        {
+            MXLogDebug(@"[MXImageCache] Critical memory pressure. Remove all images");
+            [self removeAllImages];
+        }
+        else if (flags & DISPATCH_MEMORYPRESSURE_WARN)
+        {
+            MXLogDebug(@"[MXImageCache] Memory pressure. Release half of the cache");
+            [self trimToCost:self.totalCost / 2];
+        }
+    });
+    dispatch_resume(memoryPressureSource);
+
+#if TARGET_OS_IPHONE
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(removeAllImages)
+                                                 name:UIApplicationDidReceiveMemoryWarningNotification
+                                               object:nil];
+#endif
+}
+
+@end
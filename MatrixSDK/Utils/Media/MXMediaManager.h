@@ -20,6 +20,7 @@
 #import "MXMediaLoader.h"
 #import "MXEnumConstants.h"
 #import "MXRestClient.h"
+#import "MXImageCache.h"
 
 #if TARGET_OS_IPHONE
 #import <UIKit/UIKit.h>
@@ -78,10 +79,16 @@ extern NSString *const kMXMediaManagerDefaultCacheFolder;
  */
 + (BOOL)writeMediaData:(NSData *)mediaData toFilePath:(NSString*)filePath;
 
+/**
+ The in-memory cache of decoded images used by `loadThroughCacheWithFilePath` methods.
+ It is bounded by the memory cost of the images, according to the device memory.
+ */
++ (MXImageCache*)imageCache;
+
 /**
  Load an image in memory cache. If the image is not in the cache,
  load it from the given path, insert it into the cache and return it.
- The images are cached in a LRU cache if they are not yet loaded.
+ The images are cached decoded in a LRU cache bounded by their memory cost.
  So, it should be faster than calling loadPictureFromFilePath;
  
  @param filePath picture file path.
@@ -93,6 +100,26 @@ extern NSString *const kMXMediaManagerDefaultCacheFolder;
 + (NSImage*)loadThroughCacheWithFilePath:(NSString*)filePath;
 #endif
 
+/**
+ Load an image through the memory cache without blocking the caller.
+
+ The image is decoded and downscaled off the main thread. Concurrent loads of the
+ same image at the same size share a single decode.
+
+ @param filePath picture file path.
+ @param maxPixelSize the maximum width and height of the image, in pixels. 0 to keep the original size.
+ @param completion the block called on the main queue with the image (if any).
+ */
+#if TARGET_OS_IPHONE
++ (void)loadThroughCacheWithFilePath:(NSString*)filePath
+                        maxPixelSize:(NSUInteger)maxPixelSize
+                          completion:(void (^)(UIImage *image))completion;
+#elif TARGET_OS_OSX
++ (void)loadThroughCacheWithFilePath:(NSString*)filePath
+                        maxPixelSize:(NSUInteger)maxPixelSize
+                          completion:(void (^)(NSImage *image))completion;
+#endif
+
 /**
  Load an image from the in memory cache, or return nil if the image
  is not in the cache
@@ -28,7 +28,6 @@
 
 #import "MXSDKOptions.h"
 
-#import "MXLRUCache.h"
 #import "MXTools.h"
 
 NSUInteger const kMXMediaCacheSDKVersion = 3;
@@ -104,7 +103,24 @@ static NSMutableDictionary* uploadTableById = nil;
     return NO;
 }
 
-static MXLRUCache* imagesCacheLruCache = nil;
+/**
+ Bounds of the memory cost of the decoded images cache.
+ */
+static NSUInteger const kMXMediaManagerImageCacheMinCost = 16 * 1024 * 1024;
+static NSUInteger const kMXMediaManagerImageCacheMaxCost = 128 * 1024 * 1024;
+
++ (MXImageCache*)imageCache
+{
+    static MXImageCache *imageCache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        // Use 1/32 of the device memory
+        NSUInteger totalCostLimit = (NSUInteger)(NSProcessInfo.processInfo.physicalMemory / 32);
+        totalCostLimit = MIN(MAX(totalCostLimit, kMXMediaManagerImageCacheMinCost), kMXMediaManagerImageCacheMaxCost);
+        imageCache = [[MXImageCache alloc] initWithTotalCostLimit:totalCostLimit];
+    });
+    return imageCache;
+}
 
 #if TARGET_OS_IPHONE
 + (UIImage*)loadThroughCacheWithFilePath:(NSString*)filePath
@@ -120,7 +136,12 @@ static MXLRUCache* imagesCacheLruCache = nil;
     
     if (image) return image;
     
-    image = [MXMediaManager loadPictureFromFilePath:filePath];
+    image = [MXImageCache decodeImageWithFilePath:filePath maxPixelSize:0];
+    if (!image)
+    {
+        // Fallback to the platform decoder
+        image = [MXMediaManager loadPictureFromFilePath:filePath];
+    }
     
     if (image)
     {
@@ -130,6 +151,18 @@ static MXLRUCache* imagesCacheLruCache = nil;
     return image;
 }
 
+#if TARGET_OS_IPHONE
++ (void)loadThroughCacheWithFilePath:(NSString*)filePath
+                        maxPixelSize:(NSUInteger)maxPixelSize
+                          completion:(void (^)(UIImage *image))completion
+#elif TARGET_OS_OSX
++ (void)loadThroughCacheWithFilePath:(NSString*)filePath
+                        maxPixelSize:(NSUInteger)maxPixelSize
+                          completion:(void (^)(NSImage *image))completion
+#endif
+{
+    [[MXMediaManager imageCache] loadImageWithFilePath:filePath maxPixelSize:maxPixelSize completion:completion];
+}
 
 #if TARGET_OS_IPHONE
 + (UIImage*)getFromMemoryCacheWithFilePath:(NSString*)filePath
@@ -137,16 +170,11 @@ static MXLRUCache* imagesCacheLruCache = nil;
 + (NSImage*)getFromMemoryCacheWithFilePath:(NSString*)filePath
 #endif
 {
-    if (!imagesCacheLruCache)
+    if (!filePath)
     {
-        imagesCacheLruCache = [[MXLRUCache alloc] initWithCapacity:20];
+        return nil;
     }
-    
-#if TARGET_OS_IPHONE
-    return (UIImage*)[imagesCacheLruCache get:filePath];
-#elif TARGET_OS_OSX
-    return (NSImage*)[imagesCacheLruCache get:filePath];
-#endif
+    return [[MXMediaManager imageCache] imageForKey:filePath];
 }
 
 #if TARGET_OS_IPHONE
@@ -155,12 +183,11 @@ static MXLRUCache* imagesCacheLruCache = nil;
 + (void)cacheImage:(NSImage *)image withCachePath:(NSString *)filePath
 #endif
 {
-    if (!imagesCacheLruCache)
+    if (!image || !filePath)
     {
-        imagesCacheLruCache = [[MXLRUCache alloc] initWithCapacity:20];
+        return;
     }
-    
-    [imagesCacheLruCache put:filePath object:image];
+    [[MXMediaManager imageCache] setImage:image forKey:filePath];
 }
 
 
@@ -1154,6 +1181,7 @@ static NSMutableDictionary* fileBaseFromMimeType = nil;
     
     [MXMediaManager cancelDownloads];
     [MXMediaManager cancelUploads];
+    [[MXMediaManager imageCache] removeAllImages];
     
     if (mediaCachePath)
     {
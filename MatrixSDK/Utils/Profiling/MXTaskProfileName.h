@@ -21,6 +21,14 @@ static MXTaskProfileName const MXTaskProfileNameStartupInitialSync = @"startup:
 static MXTaskProfileName const MXTaskProfileNameStartupIncrementalSync = @"startup: incrementalSync";
 /// The time taken to preload data in the MXStore.
 static MXTaskProfileName const MXTaskProfileNameStartupStorePreload = @"startup: storePreload";
+/// The time taken to preload each kind of data in the MXStore. These phases run concurrently.
+static MXTaskProfileName const MXTaskProfileNameStartupStorePreloadRoomMessages = @"startup: storePreload: roomMessages";
+static MXTaskProfileName const MXTaskProfileNameStartupStorePreloadRoomStates = @"startup: storePreload: roomStates";
+static MXTaskProfileName const MXTaskProfileNameStartupStorePreloadRoomAccountData = @"startup: storePreload: roomAccountData";
+static MXTaskProfileName const MXTaskProfileNameStartupStorePreloadReadReceipts = @"startup: storePreload: readReceipts";
+static MXTaskProfileName const MXTaskProfileNameStartupStorePreloadUsers = @"startup: storePreload: users";
+static MXTaskProfileName const MXTaskProfileNameStartupStorePreloadGroups = @"startup: storePreload: groups";
+static MXTaskProfileName const MXTaskProfileNameStartupStorePreloadUnreadRooms = @"startup: storePreload: unreadRooms";
 /// The time to mount all objects from the store (it includes MXTaskProfileNameStartupStorePreload time).
 static MXTaskProfileName const MXTaskProfileNameStartupMountData = @"startup: mountData";
 /// The duration of the the display of the app launch screen
@@ -26,8 +26,11 @@ class MXRoomEventDecryptionUnitTests: XCTestCase {
         }
         
         var stubbedEvents = [String: DecryptedEvent]()
+        /// Called when an event cannot be decrypted, before the error is thrown
+        var onDecryptionFailure: ((MXEvent) -> Void)?
         func decryptRoomEvent(_ event: MXEvent) throws -> DecryptedEvent {
             guard let decrypted = stubbedEvents[event.eventId] else {
+                onDecryptionFailure?(event)
                 throw Error.cannotDecrypt
             }
             return decrypted
@@ -95,6 +98,34 @@ class MXRoomEventDecryptionUnitTests: XCTestCase {
         XCTAssertNotNil(results[2].error)
     }
     
+    func test_decrypt_decryptsAgainIfRoomKeyArrivesDuringDecryption() async {
+        let event = MXEvent.encryptedFixture(
+            id: "1",
+            sessionId: "123"
+        )
+        
+        // The room key is imported and handled after the first decryption attempt failed,
+        // but before the failure is tracked by the decryptor
+        handler.onDecryptionFailure = { [unowned self] _ in
+            self.handler.onDecryptionFailure = nil
+            self.handler.stubbedEvents = [
+                "1": .stub(clearEvent: ["type": "m.decrypted"])
+            ]
+            
+            let semaphore = DispatchSemaphore(value: 0)
+            Task {
+                await self.decryptor.handlePossibleRoomKeyEvent(MXEvent.roomKeyFixture(sessionId: "123"))
+                semaphore.signal()
+            }
+            semaphore.wait()
+        }
+        
+        let results = await decryptor.decrypt(events: [event])
+        
+        XCTAssertEqual(results.first?.clearEvent as? [String: String], ["type": "m.decrypted"])
+        XCTAssertNil(results.first?.error)
+    }
+    
     // MARK: - Room key
     
     func test_handlePossibleRoomKeyEvent_doesNothingIfInvalidRoomKeyEvent() async {
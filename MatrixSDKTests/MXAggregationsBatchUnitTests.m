@@ -0,0 +1,168 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXRealmAggregationsStore.h"
+#import "MXAggregatedReactionsUpdater.h"
+#import "MXEvent.h"
+
+static NSString * const kRoomId = @"!room:matrix.org";
+static NSString * const kEventId = @"$event";
+
+@interface MXAggregationsBatchUnitTests : XCTestCase
+
+@property (nonatomic) MXRealmAggregationsStore *store;
+
+@end
+
+@implementation MXAggregationsBatchUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    MXCredentials *credentials = [MXCredentials new];
+    credentials.userId = [NSString stringWithFormat:@"@batch-%@:matrix.org", [NSUUID UUID].UUIDString];
+    self.store = [[MXRealmAggregationsStore alloc] initWithCredentials:credentials];
+}
+
+- (void)tearDown
+{
+    [self.store deleteAll];
+    self.store = nil;
+
+    [super tearDown];
+}
+
+- (void)testReadsInBatchSeePendingWrites
+{
+    [self.store beginBatch];
+    [self.store beginBatch];
+
+    [self.store addOrUpdateReactionCount:[self reactionCount:@"👍" count:1] onEvent:kEventId inRoom:kRoomId];
+    XCTAssertEqual([self.store reactionCountForReaction:@"👍" onEvent:kEventId].count, 1);
+
+    [self.store addOrUpdateReactionCount:[self reactionCount:@"👍" count:2] onEvent:kEventId inRoom:kRoomId];
+    [self.store addReactionRelation:[self relation:@"👍" reactionEventId:@"$reaction1"] inRoom:kRoomId];
+    [self.store commitBatch];
+
+    // The inner commit does not end the batch
+    XCTAssertEqual([self.store reactionCountForReaction:@"👍" onEvent:kEventId].count, 2);
+    XCTAssertNotNil([self.store reactionRelationWithReactionEventId:@"$reaction1"]);
+
+    [self.store commitBatch];
+
+    XCTAssertEqual([self.store reactionCountForReaction:@"👍" onEvent:kEventId].count, 2);
+    XCTAssertEqual([self.store reactionRelationsOnEvent:kEventId].count, 1);
+
+    // Writes out of a batch still work
+    [self.store deleteReactionCountsForReaction:@"👍" onEvent:kEventId];
+    XCTAssertFalse([self.store hasReactionCountsOnEvent:kEventId]);
+}
+
+- (void)testBatchDoesNotBlockOtherThreadsAcrossRunLoopIterations
+{
+    [self.store beginBatch];
+    [self.store addOrUpdateReactionCount:[self reactionCount:@"👍" count:1] onEvent:kEventId inRoom:kRoomId];
+
+    // Like a batch waiting for decryption, the main thread goes back to its run loop.
+    // Another thread can write meanwhile, with its own realm
+    XCTestExpectation *expectation = [self expectationWithDescription:@"write"];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self.store addOrUpdateReactionCount:[self reactionCount:@"👀" count:1] onEvent:kEventId inRoom:kRoomId];
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    [self.store addOrUpdateReactionCount:[self reactionCount:@"👍" count:2] onEvent:kEventId inRoom:kRoomId];
+    XCTAssertEqual([self.store reactionCountForReaction:@"👀" onEvent:kEventId].count, 1);
+    XCTAssertEqual([self.store reactionCountForReaction:@"👍" onEvent:kEventId].count, 2);
+
+    [self.store commitBatch];
+
+    XCTAssertEqual([self.store reactionCountsOnEvent:kEventId].count, 2);
+}
+
+- (void)testReactionCountChangesAreMergedPerBatch
+{
+    [self.store setReactionCounts:@[[self reactionCount:@"👍" count:2], [self reactionCount:@"👀" count:2]] onEvent:kEventId inRoom:kRoomId];
+    for (NSString *reactionEventId in @[@"$reaction1", @"$reaction2"])
+    {
+        [self.store addReactionRelation:[self relation:@"👍" reactionEventId:reactionEventId] inRoom:kRoomId];
+    }
+    [self.store addReactionRelation:[self relation:@"👀" reactionEventId:@"$reaction3"] inRoom:kRoomId];
+
+    MXAggregatedReactionsUpdater *updater = [[MXAggregatedReactionsUpdater alloc] initWithMatrixSession:nil aggregationStore:self.store];
+
+    NSMutableArray<NSDictionary<NSString*, MXReactionCountChange*>*> *notifications = [NSMutableArray array];
+    [updater listenToReactionCountUpdateInRoom:kRoomId block:^(NSDictionary<NSString *,MXReactionCountChange *> * _Nonnull changes) {
+        [notifications addObject:changes];
+    }];
+
+    [self.store beginBatch];
+    [updater beginBatch];
+
+    [updater handleRedaction:[self redactionOfEvent:@"$reaction1"]];
+    [updater handleRedaction:[self redactionOfEvent:@"$reaction2"]];
+    [updater handleRedaction:[self redactionOfEvent:@"$reaction3"]];
+    XCTAssertEqual(notifications.count, 0);
+
+    [self.store commitBatch];
+    [updater endBatch];
+
+    XCTAssertEqual(notifications.count, 1);
+
+    MXReactionCountChange *change = notifications.firstObject[kEventId];
+    XCTAssertNil(change.inserted);
+    XCTAssertEqualObjects(change.deleted, @[@"👍"]);
+    XCTAssertEqual(change.modified.count, 1);
+    XCTAssertEqualObjects(change.modified.firstObject.reaction, @"👀");
+    XCTAssertEqual(change.modified.firstObject.count, 1);
+}
+
+#pragma mark - Private
+
+- (MXReactionCount*)reactionCount:(NSString*)reaction count:(NSUInteger)count
+{
+    MXReactionCount *reactionCount = [MXReactionCount new];
+    reactionCount.reaction = reaction;
+    reactionCount.count = count;
+    return reactionCount;
+}
+
+- (MXReactionRelation*)relation:(NSString*)reaction reactionEventId:(NSString*)reactionEventId
+{
+    MXReactionRelation *relation = [MXReactionRelation new];
+    relation.reaction = reaction;
+    relation.eventId = kEventId;
+    relation.reactionEventId = reactionEventId;
+    return relation;
+}
+
+- (MXEvent*)redactionOfEvent:(NSString*)eventId
+{
+    return [MXEvent modelFromJSON:@{
+        @"event_id": [NSString stringWithFormat:@"$redaction-%@", eventId],
+        @"type": kMXEventTypeStringRoomRedaction,
+        @"room_id": kRoomId,
+        @"sender": @"@alice:matrix.org",
+        @"redacts": eventId,
+        @"content": @{}
+    }];
+}
+
+@end
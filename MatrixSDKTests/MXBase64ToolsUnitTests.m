@@ -0,0 +1,295 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXBase64Tools.h"
+
+@interface MXBase64ToolsUnitTests : XCTestCase
+@end
+
+@implementation MXBase64ToolsUnitTests
+
+#pragma mark - Codec
+
+- (void)testRFC4648Corpus
+{
+    // Test vectors from RFC 4648
+    NSDictionary<NSString*, NSString*> *corpus = @{
+        @"": @"",
+        @"f": @"Zg==",
+        @"fo": @"Zm8=",
+        @"foo": @"Zm9v",
+        @"foob": @"Zm9vYg==",
+        @"fooba": @"Zm9vYmE=",
+        @"foobar": @"Zm9vYmFy"
+    };
+
+    for (NSString *string in corpus)
+    {
+        NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+        NSString *base64 = corpus[string];
+        NSString *unpadded = [base64 stringByReplacingOccurrencesOfString:@"=" withString:@""];
+
+        XCTAssertEqualObjects([MXBase64Tools base64FromData:data], base64);
+        XCTAssertEqualObjects([MXBase64Tools unpaddedBase64FromData:data], unpadded);
+        XCTAssertEqualObjects([MXBase64Tools base64UrlFromData:data], unpadded);
+
+        XCTAssertEqualObjects([MXBase64Tools dataFromBase64:base64], data);
+        XCTAssertEqualObjects([MXBase64Tools dataFromBase64:unpadded], data);
+        XCTAssertEqualObjects([MXBase64Tools dataFromBase64Url:unpadded], data);
+
+        XCTAssertEqualObjects([MXBase64Tools base64ToUnpaddedBase64:base64], unpadded);
+        XCTAssertEqualObjects([MXBase64Tools padBase64:unpadded], base64);
+    }
+}
+
+- (void)testURLSafeAlphabet
+{
+    uint8_t bytes[] = {0xFB, 0xFF, 0xBF, 0x3E};
+    NSData *data = [NSData dataWithBytes:bytes length:sizeof(bytes)];
+
+    XCTAssertEqualObjects([MXBase64Tools base64FromData:data], @"+/+/Pg==");
+    XCTAssertEqualObjects([MXBase64Tools base64UrlFromData:data], @"-_-_Pg");
+
+    XCTAssertEqualObjects([MXBase64Tools base64ToBase64Url:@"+/+/Pg=="], @"-_-_Pg");
+    XCTAssertEqualObjects([MXBase64Tools base64UrlToBase64:@"-_-_Pg"], @"+/+/Pg==");
+
+    XCTAssertEqualObjects([MXBase64Tools dataFromBase64Url:@"-_-_Pg"], data);
+
+    // Each decoder ignores the characters of the other alphabet
+    XCTAssertEqualObjects([MXBase64Tools dataFromBase64:@"-_-_Pg"], [MXBase64Tools dataFromBase64:@"Pg"]);
+}
+
+- (void)testDecodingIgnoresUnknownCharacters
+{
+    NSData *data = [@"foobar" dataUsingEncoding:NSUTF8StringEncoding];
+
+    XCTAssertEqualObjects([MXBase64Tools dataFromBase64:@"Zm9v\nYmFy\n"], data);
+    XCTAssertEqualObjects([MXBase64Tools dataFromBase64:@" Zm 9vY\r\nmFy "], data);
+    XCTAssertEqualObjects([MXBase64Tools dataFromBase64:@"Zm9vYmFy🎉"], data);
+}
+
+- (void)testDecodingInvalidLength
+{
+    XCTAssertNil([MXBase64Tools dataFromBase64:@"Z"]);
+    XCTAssertNil([MXBase64Tools dataFromBase64:@"Zm9vY"]);
+    XCTAssertNil([MXBase64Tools dataFromBase64Url:@"Zm9vY==="]);
+}
+
+- (void)testNilInput
+{
+    // Callers pass optional values, like attachment keys
+    NSString *nilString = nil;
+    NSData *nilData = nil;
+
+    XCTAssertNil([MXBase64Tools dataFromBase64:nilString]);
+    XCTAssertNil([MXBase64Tools dataFromBase64Url:nilString]);
+    XCTAssertNil([MXBase64Tools base64UrlToBase64:nilString]);
+    XCTAssertNil([MXBase64Tools base64ToBase64Url:nilString]);
+    XCTAssertNil([MXBase64Tools base64ToUnpaddedBase64:nilString]);
+    XCTAssertNil([MXBase64Tools base64FromData:nilData]);
+    XCTAssertNil([MXBase64Tools unpaddedBase64FromData:nilData]);
+    XCTAssertNil([MXBase64Tools base64UrlFromData:nilData]);
+}
+
+- (void)testNonBase64StringsAreKeptByConversions
+{
+    XCTAssertEqualObjects([MXBase64Tools base64ToBase64Url:@"é+/="], @"é-_");
+    XCTAssertEqualObjects([MXBase64Tools base64UrlToBase64:@"é-_"], @"é+/=");
+}
+
+- (void)testRoundTrip
+{
+    for (NSUInteger length = 0; length < 300; length++)
+    {
+        NSData *data = [self randomDataWithLength:length];
+
+        XCTAssertEqualObjects([MXBase64Tools dataFromBase64:[MXBase64Tools base64FromData:data]], data);
+        XCTAssertEqualObjects([MXBase64Tools dataFromBase64:[MXBase64Tools unpaddedBase64FromData:data]], data);
+        XCTAssertEqualObjects([MXBase64Tools dataFromBase64Url:[MXBase64Tools base64UrlFromData:data]], data);
+
+        // Same output as Foundation
+        XCTAssertEqualObjects([MXBase64Tools base64FromData:data], [data base64EncodedStringWithOptions:0]);
+    }
+}
+
+
+#pragma mark - Streaming
+
+- (void)testStreamingWithAnyChunkSize
+{
+    NSData *data = [self randomDataWithLength:1000];
+    NSString *base64 = [MXBase64Tools base64FromData:data];
+    NSData *base64Data = [base64 dataUsingEncoding:NSASCIIStringEncoding];
+
+    MXBase64Encoder *encoder = [[MXBase64Encoder alloc] initWithURLSafeAlphabet:NO padding:YES];
+    MXBase64Decoder *decoder = [[MXBase64Decoder alloc] initWithURLSafeAlphabet:NO];
+
+    for (NSUInteger chunkSize = 1; chunkSize <= 17; chunkSize++)
+    {
+        NSMutableData *encoded = [NSMutableData data];
+        for (NSUInteger offset = 0; offset < data.length; offset += chunkSize)
+        {
+            NSUInteger length = MIN(chunkSize, data.length - offset);
+            [encoded appendData:[encoder encodeBytes:(const uint8_t*)data.bytes + offset length:length]];
+        }
+        [encoded appendData:[encoder finish]];
+
+        XCTAssertEqualObjects(encoded, base64Data, @"chunkSize: %@", @(chunkSize));
+
+        NSMutableData *decoded = [NSMutableData data];
+        for (NSUInteger offset = 0; offset < base64Data.length; offset += chunkSize)
+        {
+            NSUInteger length = MIN(chunkSize, base64Data.length - offset);
+            [decoded appendData:[decoder decodeBytes:(const uint8_t*)base64Data.bytes + offset length:length]];
+        }
+        [decoded appendData:[decoder finish]];
+
+        XCTAssertEqualObjects(decoded, data, @"chunkSize: %@", @(chunkSize));
+    }
+}
+
+- (void)testStreamingURLSafeUnpadded
+{
+    NSData *data = [self randomDataWithLength:100];
+
+    MXBase64Encoder *encoder = [[MXBase64Encoder alloc] initWithURLSafeAlphabet:YES padding:NO];
+    NSMutableData *encoded = [NSMutableData dataWithData:[encoder encodeBytes:data.bytes length:50]];
+    [encoded appendData:[encoder encodeBytes:(const uint8_t*)data.bytes + 50 length:50]];
+    [encoded appendData:[encoder finish]];
+
+    XCTAssertEqualObjects([[NSString alloc] initWithData:encoded encoding:NSASCIIStringEncoding], [MXBase64Tools base64UrlFromData:data]);
+}
+
+- (void)testStreamingDecoderWithIncompleteGroup
+{
+    MXBase64Decoder *decoder = [MXBase64Decoder new];
+    [decoder decodeBytes:"Zm9vY" length:5];
+    XCTAssertNil([decoder finish]);
+
+    // The decoder is reusable after finish
+    XCTAssertEqualObjects([decoder decodeBytes:"Zm9v" length:4], [@"foo" dataUsingEncoding:NSUTF8StringEncoding]);
+    XCTAssertEqualObjects([decoder finish], [NSData data]);
+}
+
+
+#pragma mark - Benchmarks
+
+- (void)testEncodingPerformance
+{
+    NSArray<NSData*> *corpus = [self benchmarkCorpus];
+
+    [self measureBlock:^{
+        for (NSData *data in corpus)
+        {
+            [MXBase64Tools unpaddedBase64FromData:data];
+        }
+    }];
+}
+
+// Baseline for testEncodingPerformance
+- (void)testFoundationEncodingPerformance
+{
+    NSArray<NSData*> *corpus = [self benchmarkCorpus];
+
+    [self measureBlock:^{
+        for (NSData *data in corpus)
+        {
+            [[data base64EncodedStringWithOptions:0] stringByReplacingOccurrencesOfString:@"=" withString:@""];
+        }
+    }];
+}
+
+- (void)testDecodingPerformance
+{
+    NSArray<NSString*> *corpus = [self unpaddedBase64BenchmarkCorpus];
+
+    [self measureBlock:^{
+        for (NSString *base64 in corpus)
+        {
+            [MXBase64Tools dataFromBase64:base64];
+        }
+    }];
+}
+
+// Baseline for testDecodingPerformance
+- (void)testFoundationDecodingPerformance
+{
+    NSArray<NSString*> *corpus = [self unpaddedBase64BenchmarkCorpus];
+
+    [self measureBlock:^{
+        for (NSString *base64 in corpus)
+        {
+            NSString *padded = base64;
+            while (padded.length % 4)
+            {
+                padded = [padded stringByAppendingString:@"="];
+            }
+            [[NSData alloc] initWithBase64EncodedString:padded options:NSDataBase64DecodingIgnoreUnknownCharacters];
+        }
+    }];
+}
+
+- (void)testURLConversionPerformance
+{
+    NSArray<NSString*> *corpus = [self unpaddedBase64BenchmarkCorpus];
+
+    [self measureBlock:^{
+        for (NSString *base64 in corpus)
+        {
+            [MXBase64Tools base64UrlToBase64:[MXBase64Tools base64ToBase64Url:base64]];
+        }
+    }];
+}
+
+
+#pragma mark - Private
+
+- (NSData*)randomDataWithLength:(NSUInteger)length
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+// Sizes of keys, hashes, Olm payloads and thumbnails
+- (NSArray<NSData*>*)benchmarkCorpus
+{
+    NSMutableArray<NSData*> *corpus = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        [corpus addObject:[self randomDataWithLength:32]];
+        [corpus addObject:[self randomDataWithLength:1000]];
+    }
+    for (NSUInteger i = 0; i < 10; i++)
+    {
+        [corpus addObject:[self randomDataWithLength:100 * 1024]];
+    }
+    return corpus;
+}
+
+- (NSArray<NSString*>*)unpaddedBase64BenchmarkCorpus
+{
+    NSMutableArray<NSString*> *corpus = [NSMutableArray array];
+    for (NSData *data in [self benchmarkCorpus])
+    {
+        [corpus addObject:[MXBase64Tools unpaddedBase64FromData:data]];
+    }
+    return corpus;
+}
+
+@end
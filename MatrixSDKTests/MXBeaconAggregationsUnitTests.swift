@@ -0,0 +1,211 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import XCTest
+@testable import MatrixSDK
+
+class MXBeaconAggregationsUnitTests: XCTestCase {
+
+    private enum Constants {
+        static let roomId = "!room:matrix.org"
+        static let alice = "@alice:matrix.org"
+        static let bob = "@bob:matrix.org"
+        static let credentials: MXCredentials = {
+            let result = MXCredentials(homeServer: "localhost",
+                                       userId: "@me:matrix.org",
+                                       accessToken: "some_access_token")
+            result.deviceId = "some_device_id"
+            return result
+        }()
+    }
+
+    private var session: MXSession!
+    private var store: CountingBeaconInfoSummaryStore!
+    private var beaconAggregations: MXBeaconAggregations!
+
+    /// Number of listener notifications by beacon info summary id
+    private var notificationCounts: [String: Int] = [:]
+    private var listener: AnyObject?
+
+    /// Current time, in milliseconds
+    private let now = UInt64(Date().timeIntervalSince1970 * 1000)
+
+    override func setUp() {
+        super.setUp()
+
+        let restClient = MXRestClient(credentials: Constants.credentials, unrecognizedCertificateHandler: nil)
+        session = MXSession(matrixRestClient: restClient)
+        store = CountingBeaconInfoSummaryStore()
+        beaconAggregations = MXBeaconAggregations(session: session, store: store)
+
+        notificationCounts = [:]
+        listener = beaconAggregations.listenToBeaconInfoSummaryUpdate { [weak self] _, beaconInfoSummary in
+            self?.notificationCounts[beaconInfoSummary.id, default: 0] += 1
+        }
+    }
+
+    override func tearDown() {
+        if let listener = listener {
+            beaconAggregations.removeListener(listener)
+        }
+        beaconAggregations = nil
+        store = nil
+        session.close()
+        session = nil
+
+        super.tearDown()
+    }
+
+    // MARK: - Tests
+
+    func testBeaconsAreCoalescedPerBatch() {
+        startSharing(beaconInfoEventId: "$aliceInfo", userId: Constants.alice)
+        startSharing(beaconInfoEventId: "$bobInfo", userId: Constants.bob)
+
+        beaconAggregations.beginBatch()
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 1, timestamp: now + 1))
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 3, timestamp: now + 3))
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 2, timestamp: now + 2))
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$bobInfo", latitude: 4, timestamp: now + 4))
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$bobInfo", latitude: 5, timestamp: now + 5))
+
+        // Nothing is aggregated before the end of the batch
+        XCTAssertEqual(notificationCounts, [:])
+        XCTAssertEqual(store.updateCounts, [:])
+        XCTAssertNil(beaconAggregations.beaconInfoSummary(for: "$aliceInfo", inRoomWithId: Constants.roomId)?.lastBeacon)
+
+        beaconAggregations.endBatch()
+
+        // Each summary is stored and notified once, with its newest beacon
+        XCTAssertEqual(notificationCounts, ["$aliceInfo": 1, "$bobInfo": 1])
+        XCTAssertEqual(store.updateCounts, ["$aliceInfo": 1, "$bobInfo": 1])
+        XCTAssertEqual(beaconAggregations.beaconInfoSummary(for: "$aliceInfo", inRoomWithId: Constants.roomId)?.lastBeacon?.timestamp, now + 3)
+        XCTAssertEqual(beaconAggregations.beaconInfoSummary(for: "$aliceInfo", inRoomWithId: Constants.roomId)?.lastBeacon?.location.latitude, 3)
+        XCTAssertEqual(beaconAggregations.beaconInfoSummary(for: "$bobInfo", inRoomWithId: Constants.roomId)?.lastBeacon?.timestamp, now + 5)
+    }
+
+    func testBeaconOlderThanTheStoredOneIsIgnored() {
+        startSharing(beaconInfoEventId: "$aliceInfo", userId: Constants.alice)
+
+        beaconAggregations.beginBatch()
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 2, timestamp: now + 2))
+        beaconAggregations.endBatch()
+
+        beaconAggregations.beginBatch()
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 1, timestamp: now + 1))
+        beaconAggregations.endBatch()
+
+        XCTAssertEqual(notificationCounts, ["$aliceInfo": 1])
+        XCTAssertEqual(store.updateCounts, ["$aliceInfo": 1])
+        XCTAssertEqual(beaconAggregations.beaconInfoSummary(for: "$aliceInfo", inRoomWithId: Constants.roomId)?.lastBeacon?.timestamp, now + 2)
+    }
+
+    func testNestedBatchesAreFlushedByTheOutermostEnd() {
+        startSharing(beaconInfoEventId: "$aliceInfo", userId: Constants.alice)
+
+        beaconAggregations.beginBatch()
+        beaconAggregations.beginBatch()
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 1, timestamp: now + 1))
+        beaconAggregations.endBatch()
+
+        XCTAssertEqual(notificationCounts, [:])
+
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 2, timestamp: now + 2))
+        beaconAggregations.endBatch()
+
+        XCTAssertEqual(notificationCounts, ["$aliceInfo": 1])
+        XCTAssertEqual(beaconAggregations.beaconInfoSummary(for: "$aliceInfo", inRoomWithId: Constants.roomId)?.lastBeacon?.timestamp, now + 2)
+    }
+
+    func testBeaconsOutOfBatchAreCoalescedUntilTheNextRunLoopIteration() {
+        startSharing(beaconInfoEventId: "$aliceInfo", userId: Constants.alice)
+
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 1, timestamp: now + 1))
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 2, timestamp: now + 2))
+
+        XCTAssertEqual(notificationCounts, [:])
+
+        let expectation = self.expectation(description: "Next run loop iteration")
+        DispatchQueue.main.async {
+            expectation.fulfill()
+        }
+        waitForExpectations(timeout: 1)
+
+        XCTAssertEqual(notificationCounts, ["$aliceInfo": 1])
+        XCTAssertEqual(store.updateCounts, ["$aliceInfo": 1])
+        XCTAssertEqual(beaconAggregations.beaconInfoSummary(for: "$aliceInfo", inRoomWithId: Constants.roomId)?.lastBeacon?.timestamp, now + 2)
+    }
+
+    func testPendingBeaconsAreAppliedBeforeTheSharingStops() {
+        startSharing(beaconInfoEventId: "$aliceInfo", userId: Constants.alice)
+
+        beaconAggregations.beginBatch()
+        beaconAggregations.handleBeacon(event: beaconEvent(beaconInfoEventId: "$aliceInfo", latitude: 1, timestamp: now + 1))
+        beaconAggregations.handleBeaconInfo(event: beaconInfoEvent(eventId: "$aliceStop", userId: Constants.alice, isLive: false))
+        beaconAggregations.endBatch()
+
+        let beaconInfoSummary = beaconAggregations.beaconInfoSummary(for: "$aliceInfo", inRoomWithId: Constants.roomId)
+        XCTAssertEqual(beaconInfoSummary?.hasStopped, true)
+        XCTAssertEqual(beaconInfoSummary?.lastBeacon?.timestamp, now + 1)
+    }
+
+    // MARK: - Private
+
+    /// Handle a live beacon info and forget the resulting notification.
+    private func startSharing(beaconInfoEventId: String, userId: String) {
+        beaconAggregations.handleBeaconInfo(event: beaconInfoEvent(eventId: beaconInfoEventId, userId: userId, isLive: true))
+
+        XCTAssertNotNil(beaconAggregations.beaconInfoSummary(for: beaconInfoEventId, inRoomWithId: Constants.roomId))
+        notificationCounts = [:]
+        store.updateCounts = [:]
+    }
+
+    private func beaconInfoEvent(eventId: String, userId: String, isLive: Bool) -> MXEvent {
+        let beaconInfo = MXBeaconInfo(userId: userId, roomId: Constants.roomId, description: nil, timeout: 3600000, isLive: isLive, timestamp: now)
+        return MXEvent(fromJSON: [
+            "type": kMXEventTypeStringBeaconInfo,
+            "event_id": eventId,
+            "room_id": Constants.roomId,
+            "sender": userId,
+            "state_key": userId,
+            "origin_server_ts": now,
+            "content": beaconInfo.jsonDictionary()
+        ])!
+    }
+
+    private func beaconEvent(beaconInfoEventId: String, latitude: Double, timestamp: UInt64) -> MXEvent {
+        let beacon = MXBeacon(latitude: latitude, longitude: 0, description: nil, timestamp: timestamp, beaconInfoEventId: beaconInfoEventId)
+        return MXEvent(fromJSON: [
+            "type": kMXEventTypeStringBeacon,
+            "event_id": "$beacon\(timestamp)",
+            "room_id": Constants.roomId,
+            "sender": Constants.alice,
+            "origin_server_ts": timestamp,
+            "content": beacon.jsonDictionary()
+        ])!
+    }
+}
+
+/// Memory store that counts the writes of each beacon info summary
+private class CountingBeaconInfoSummaryStore: MXBeaconInfoSummaryMemoryStore {
+
+    var updateCounts: [String: Int] = [:]
+
+    override func addOrUpdateBeaconInfoSummary(_ beaconInfoSummary: MXBeaconInfoSummary, inRoomWithId roomId: String) {
+        updateCounts[beaconInfoSummary.id, default: 0] += 1
+        super.addOrUpdateBeaconInfoSummary(beaconInfoSummary, inRoomWithId: roomId)
+    }
+}
@@ -0,0 +1,59 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import Foundation
+
+class MXBeaconTrackTests: XCTestCase {
+
+    func testBeaconsAtTheSameLocationAreMerged() {
+        let track = MXBeaconTrack(maxBeaconCount: 10)
+
+        XCTAssertTrue(track.add(beacon(latitude: 1, timestamp: 0)))
+        XCTAssertTrue(track.add(beacon(latitude: 1, timestamp: 10)))
+        XCTAssertTrue(track.add(beacon(latitude: 2, timestamp: 20)))
+
+        XCTAssertEqual(track.beacons.map(\.timestamp), [10, 20])
+    }
+
+    func testOlderBeaconsAreIgnored() {
+        let track = MXBeaconTrack(maxBeaconCount: 10)
+
+        track.add(beacon(latitude: 1, timestamp: 20))
+        XCTAssertFalse(track.add(beacon(latitude: 2, timestamp: 10)))
+
+        XCTAssertEqual(track.beacons.map(\.timestamp), [20])
+    }
+
+    func testTrackIsBounded() {
+        let track = MXBeaconTrack(maxBeaconCount: 8)
+
+        for index in 0..<100 {
+            track.add(beacon(latitude: Double(index), timestamp: UInt64(index)))
+        }
+
+        XCTAssertLessThanOrEqual(track.beacons.count, 8)
+        // The whole period stays covered, the latest beacons are kept
+        XCTAssertEqual(track.beacons.first?.timestamp, 0)
+        XCTAssertEqual(track.beacons.last?.timestamp, 99)
+        XCTAssertEqual(track.beacons.map(\.timestamp), track.beacons.map(\.timestamp).sorted())
+    }
+
+    // MARK: - Private
+
+    private func beacon(latitude: Double, timestamp: UInt64) -> MXBeacon {
+        MXBeacon(latitude: latitude, longitude: 0, description: nil, timestamp: timestamp, beaconInfoEventId: "$beaconInfo")
+    }
+}
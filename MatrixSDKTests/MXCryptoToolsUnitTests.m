@@ -0,0 +1,157 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXCryptoTools.h"
+#import "NSObject+sortedKeys.h"
+
+@interface MXCryptoToolsUnitTests : XCTestCase
+@end
+
+@implementation MXCryptoToolsUnitTests
+
+#pragma mark - Canonical JSON
+
+- (void)testCanonicalJSONCorpus
+{
+    // Input JSON -> expected canonical JSON.
+    // The first ones come from the examples of the Matrix specification
+    NSArray<NSArray<NSString*>*> *corpus = @[
+        @[@"{}", @"{}"],
+        @[@"{\"one\": 1, \"two\": \"Two\"}", @"{\"one\":1,\"two\":\"Two\"}"],
+        @[@"{\"b\": \"2\", \"a\": \"1\"}", @"{\"a\":\"1\",\"b\":\"2\"}"],
+        @[@"{\"auth\": {\"success\": true, \"mxid\": \"@john.doe:example.com\", \"profile\": {\"display_name\": \"John Doe\", \"three_pids\": [{\"medium\": \"email\", \"address\": \"john.doe@example.org\"}, {\"medium\": \"msisdn\", \"address\": \"123456789\"}]}}}",
+          @"{\"auth\":{\"mxid\":\"@john.doe:example.com\",\"profile\":{\"display_name\":\"John Doe\",\"three_pids\":[{\"address\":\"john.doe@example.org\",\"medium\":\"email\"},{\"address\":\"123456789\",\"medium\":\"msisdn\"}]},\"success\":true}}"],
+        @[@"{\"a\": \"日本語\"}", @"{\"a\":\"日本語\"}"],
+        @[@"{\"本\": 2, \"日\": 1}", @"{\"日\":1,\"本\":2}"],
+        @[@"{\"a\": \"\\u65E5\"}", @"{\"a\":\"日\"}"],
+        @[@"{\"a\": null}", @"{\"a\":null}"],
+        @[@"{\"a\": -0, \"b\": 1e10, \"c\": -9007199254740991}", @"{\"a\":0,\"b\":10000000000,\"c\":-9007199254740991}"],
+        @[@"{\"a\": false, \"b\": [true, 0, 1, []]}", @"{\"a\":false,\"b\":[true,0,1,[]]}"],
+
+        // Only quotation marks, reverse solidi and control characters are escaped
+        @[@"{\"a\": \"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u0001\\u001F\\u007F\"}", [NSString stringWithFormat:@"{\"a\":\"\\\"\\\\/\\b\\f\\n\\r\\t\\u0001\\u001f%C\"}", (unichar)0x7f]],
+        @[@"{\"a\\nb\": \"ab+/cd==\"}", @"{\"a\\nb\":\"ab+/cd==\"}"],
+
+        // Keys are sorted by code points, not by UTF-16 code units
+        @[@"{\"\\uD83D\\uDE00\": 2, \"\\uE000\": 1}", @"{\"\uE000\":1,\"😀\":2}"],
+    ];
+
+    for (NSArray<NSString*> *entry in corpus)
+    {
+        NSDictionary *JSON = [NSJSONSerialization JSONObjectWithData:[entry[0] dataUsingEncoding:NSUTF8StringEncoding] options:0 error:nil];
+        XCTAssertNotNil(JSON, @"Invalid corpus entry: %@", entry[0]);
+
+        XCTAssertEqualObjects([MXCryptoTools canonicalJSONStringForJSON:JSON], entry[1]);
+        XCTAssertEqualObjects([MXCryptoTools canonicalJSONDataForJSON:JSON], [entry[1] dataUsingEncoding:NSUTF8StringEncoding]);
+    }
+}
+
+- (void)testCanonicalJSONNumbers
+{
+    NSString *canonicalJSON = [MXCryptoTools canonicalJSONStringForJSON:@{
+        @"int": @(-42),
+        @"uint64": @(UINT64_MAX),
+        @"integralDouble": @(1700000000000.0),
+        @"bool": @YES
+    }];
+
+    XCTAssertEqualObjects(canonicalJSON, @"{\"bool\":true,\"int\":-42,\"integralDouble\":1700000000000,\"uint64\":18446744073709551615}");
+}
+
+- (void)testCanonicalJSONWithInvalidObject
+{
+    XCTAssertNil([MXCryptoTools canonicalJSONStringForJSON:@{@"a": [NSDate date]}]);
+    XCTAssertNil([MXCryptoTools canonicalJSONStringForJSON:@{@"a": @(NAN)}]);
+    XCTAssertNil([MXCryptoTools canonicalJSONStringForJSON:@{@1: @"a"}]);
+}
+
+- (void)testCanonicalJSONMatchesFoundationSerialisation
+{
+    NSDictionary *deviceKeys = [self deviceKeysWithIndex:0];
+    XCTAssertEqualObjects([MXCryptoTools canonicalJSONStringForJSON:deviceKeys], [self foundationCanonicalJSONStringForJSON:deviceKeys]);
+}
+
+- (void)testCanonicalJSONPerformance
+{
+    NSArray<NSDictionary*> *devicesKeys = [self devicesKeys];
+
+    [self measureBlock:^{
+        for (NSDictionary *deviceKeys in devicesKeys)
+        {
+            [MXCryptoTools canonicalJSONDataForJSON:deviceKeys];
+        }
+    }];
+}
+
+// Baseline for testCanonicalJSONPerformance
+- (void)testFoundationCanonicalJSONPerformance
+{
+    NSArray<NSDictionary*> *devicesKeys = [self devicesKeys];
+
+    [self measureBlock:^{
+        for (NSDictionary *deviceKeys in devicesKeys)
+        {
+            [[self foundationCanonicalJSONStringForJSON:deviceKeys] dataUsingEncoding:NSUTF8StringEncoding];
+        }
+    }];
+}
+
+#pragma mark - Private
+
+// The previous implementation, based on NSJSONSerialization
+- (NSString*)foundationCanonicalJSONStringForJSON:(NSDictionary*)JSONDictionary
+{
+    NSData *data = [NSJSONSerialization dataWithJSONObject:[JSONDictionary objectWithSortedKeys] options:0 error:nil];
+    NSString *string = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    return [string stringByReplacingOccurrencesOfString:@"\\/" withString:@"/"];
+}
+
+// Device keys like the ones returned by /keys/query
+- (NSDictionary*)deviceKeysWithIndex:(NSUInteger)index
+{
+    NSString *deviceId = [NSString stringWithFormat:@"DEVICE%@", @(index)];
+    return @{
+        @"user_id": @"@alice:example.com",
+        @"device_id": deviceId,
+        @"algorithms": @[@"m.olm.v1.curve25519-aes-sha2", @"m.megolm.v1.aes-sha2"],
+        @"keys": @{
+            [NSString stringWithFormat:@"curve25519:%@", deviceId]: @"3C5BFWi2Y8MaVvjM8M22DBmh24PmgR0nPvJOIArzgyI",
+            [NSString stringWithFormat:@"ed25519:%@", deviceId]: @"lEuiRJBit0IG6nUf5pUzWTUEsRVVe/HJkoKuEww9ULI"
+        },
+        @"signatures": @{
+            @"@alice:example.com": @{
+                [NSString stringWithFormat:@"ed25519:%@", deviceId]: @"dSO80A01XiigH3uBiDVx/EjzaoycHcjq9lfQX0uWsqxl2giMIiSPR8a4d291W1ihKJL/a+myXS367WT6NAIcBA"
+            }
+        },
+        @"unsigned": @{
+            @"device_display_name": [NSString stringWithFormat:@"Alice's \"mobile\" phone #%@", @(index)]
+        }
+    };
+}
+
+- (NSArray<NSDictionary*>*)devicesKeys
+{
+    NSMutableArray<NSDictionary*> *devicesKeys = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 500; i++)
+    {
+        [devicesKeys addObject:[self deviceKeysWithIndex:i]];
+    }
+    return devicesKeys;
+}
+
+@end
@@ -0,0 +1,211 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXDecryptionScheduler.h"
+#import "MXEvent.h"
+
+@interface MXDecryptionSchedulerUnitTests : XCTestCase
+{
+    // Rooms of the chunks started by the scheduler, in start order
+    NSMutableArray<NSString*> *startedChunkRoomIds;
+
+    // Completion blocks of the running chunks, in start order
+    NSMutableArray<dispatch_block_t> *pendingChunkCompletions;
+}
+@end
+
+@implementation MXDecryptionSchedulerUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    startedChunkRoomIds = [NSMutableArray array];
+    pendingChunkCompletions = [NSMutableArray array];
+}
+
+- (NSArray<MXEvent*>*)eventsWithCount:(NSUInteger)count
+{
+    NSMutableArray<MXEvent*> *events = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger index = 0; index < count; index++)
+    {
+        MXEvent *event = [MXEvent new];
+        event.eventId = [NSString stringWithFormat:@"$event%@", @(index)];
+        [events addObject:event];
+    }
+    return events;
+}
+
+/**
+ Submit a job whose chunks stay running until `completeNextChunk` is called.
+ */
+- (void)submitEventsCount:(NSUInteger)count inRoom:(NSString*)roomId scheduler:(MXDecryptionScheduler*)scheduler onComplete:(dispatch_block_t)onComplete
+{
+    NSMutableArray<NSString*> *roomIds = startedChunkRoomIds;
+    NSMutableArray<dispatch_block_t> *completions = pendingChunkCompletions;
+    [scheduler decryptEvents:[self eventsWithCount:count] inRoom:roomId chunkBlock:^(NSArray<MXEvent *> *events, dispatch_block_t onChunkComplete) {
+        [roomIds addObject:roomId];
+        [completions addObject:onChunkComplete];
+    } onComplete:onComplete ?: ^{}];
+}
+
+- (void)completeNextChunk
+{
+    dispatch_block_t completion = pendingChunkCompletions.firstObject;
+    [pendingChunkCompletions removeObjectAtIndex:0];
+    completion();
+}
+
+- (void)testConcurrencyLimit
+{
+    MXDecryptionScheduler *scheduler = [[MXDecryptionScheduler alloc] initWithMaxConcurrentChunks:2 chunkSize:10];
+
+    for (NSUInteger index = 0; index < 4; index++)
+    {
+        [self submitEventsCount:5 inRoom:[NSString stringWithFormat:@"!room%@", @(index)] scheduler:scheduler onComplete:nil];
+    }
+
+    XCTAssertEqual(scheduler.runningChunksCount, 2);
+    XCTAssertEqual([scheduler metricsForPriority:MXDecryptionPriorityBacklog].queuedJobsCount, 2);
+    XCTAssertEqual([scheduler metricsForPriority:MXDecryptionPriorityBacklog].queuedEventsCount, 10);
+
+    [self completeNextChunk];
+    XCTAssertEqual(scheduler.runningChunksCount, 2);
+    XCTAssertEqual(startedChunkRoomIds.count, 3);
+
+    // Completing twice must not free another slot
+    dispatch_block_t completion = pendingChunkCompletions.firstObject;
+    completion();
+    completion();
+    XCTAssertEqual(scheduler.runningChunksCount, 2);
+    XCTAssertEqual(startedChunkRoomIds.count, 4);
+}
+
+- (void)testVisibleRoomGoesBetweenChunksOfBacklog
+{
+    MXDecryptionScheduler *scheduler = [[MXDecryptionScheduler alloc] initWithMaxConcurrentChunks:1 chunkSize:10];
+
+    __block BOOL backlogCompleted = NO;
+    [self submitEventsCount:30 inRoom:@"!backlog" scheduler:scheduler onComplete:^{
+        backlogCompleted = YES;
+    }];
+
+    [scheduler setPriority:MXDecryptionPriorityVisible forRoom:@"!visible"];
+
+    __block BOOL visibleCompleted = NO;
+    [self submitEventsCount:5 inRoom:@"!visible" scheduler:scheduler onComplete:^{
+        visibleCompleted = YES;
+    }];
+
+    // The first chunk of the backlog is running. The visible room goes next
+    [self completeNextChunk];
+    XCTAssertEqualObjects(startedChunkRoomIds, (@[@"!backlog", @"!visible"]));
+
+    [self completeNextChunk];
+    XCTAssertTrue(visibleCompleted);
+    XCTAssertFalse(backlogCompleted);
+
+    [self completeNextChunk];
+    [self completeNextChunk];
+    XCTAssertTrue(backlogCompleted);
+    XCTAssertEqualObjects(startedChunkRoomIds, (@[@"!backlog", @"!visible", @"!backlog", @"!backlog"]));
+}
+
+- (void)testJobsOfARoomAreDecryptedInOrder
+{
+    MXDecryptionScheduler *scheduler = [[MXDecryptionScheduler alloc] initWithMaxConcurrentChunks:4 chunkSize:10];
+
+    NSMutableArray<NSNumber*> *completedJobs = [NSMutableArray array];
+    [self submitEventsCount:20 inRoom:@"!room" scheduler:scheduler onComplete:^{
+        [completedJobs addObject:@(1)];
+    }];
+    [self submitEventsCount:5 inRoom:@"!room" scheduler:scheduler onComplete:^{
+        [completedJobs addObject:@(2)];
+    }];
+
+    // Only one chunk of a room runs at a time, even with free slots
+    XCTAssertEqual(scheduler.runningChunksCount, 1);
+
+    [self completeNextChunk];
+    XCTAssertEqual(scheduler.runningChunksCount, 1);
+    [self completeNextChunk];
+    [self completeNextChunk];
+
+    XCTAssertEqualObjects(completedJobs, (@[@(1), @(2)]));
+}
+
+- (void)testSetPriorityMovesQueuedJobs
+{
+    MXDecryptionScheduler *scheduler = [[MXDecryptionScheduler alloc] initWithMaxConcurrentChunks:1 chunkSize:10];
+
+    [self submitEventsCount:5 inRoom:@"!room1" scheduler:scheduler onComplete:nil];
+    [self submitEventsCount:5 inRoom:@"!room2" scheduler:scheduler onComplete:nil];
+    [self submitEventsCount:5 inRoom:@"!room3" scheduler:scheduler onComplete:nil];
+
+    [scheduler setPriority:MXDecryptionPriorityPreview forRoom:@"!room3"];
+    XCTAssertEqual([scheduler priorityForRoom:@"!room3"], MXDecryptionPriorityPreview);
+    XCTAssertEqual([scheduler metricsForPriority:MXDecryptionPriorityPreview].queuedJobsCount, 1);
+    XCTAssertEqual([scheduler metricsForPriority:MXDecryptionPriorityBacklog].queuedJobsCount, 1);
+
+    [self completeNextChunk];
+    [self completeNextChunk];
+    XCTAssertEqualObjects(startedChunkRoomIds, (@[@"!room1", @"!room3", @"!room2"]));
+
+    [scheduler resetPriorities];
+    XCTAssertEqual([scheduler priorityForRoom:@"!room3"], MXDecryptionPriorityBacklog);
+}
+
+- (void)testMetrics
+{
+    MXDecryptionScheduler *scheduler = [[MXDecryptionScheduler alloc] initWithMaxConcurrentChunks:1 chunkSize:10];
+    [scheduler setPriority:MXDecryptionPriorityVisible forRoom:@"!visible"];
+
+    [self submitEventsCount:5 inRoom:@"!visible" scheduler:scheduler onComplete:nil];
+    [self submitEventsCount:5 inRoom:@"!backlog" scheduler:scheduler onComplete:nil];
+
+    [self completeNextChunk];
+    [self completeNextChunk];
+
+    MXDecryptionSchedulerMetrics *visibleMetrics = [scheduler metricsForPriority:MXDecryptionPriorityVisible];
+    XCTAssertEqual(visibleMetrics.completedJobsCount, 1);
+    XCTAssertEqual(visibleMetrics.queuedJobsCount, 0);
+    XCTAssertEqual([scheduler metricsForPriority:MXDecryptionPriorityBacklog].completedJobsCount, 1);
+
+    [scheduler resetMetrics];
+    XCTAssertEqual([scheduler metricsForPriority:MXDecryptionPriorityVisible].completedJobsCount, 0);
+}
+
+- (void)testSynchronousChunkBlock
+{
+    MXDecryptionScheduler *scheduler = [[MXDecryptionScheduler alloc] initWithMaxConcurrentChunks:1 chunkSize:2];
+
+    __block NSUInteger decryptedEventsCount = 0;
+    __block BOOL completed = NO;
+    [scheduler decryptEvents:[self eventsWithCount:5] inRoom:@"!room" chunkBlock:^(NSArray<MXEvent *> *events, dispatch_block_t onChunkComplete) {
+        decryptedEventsCount += events.count;
+        onChunkComplete();
+    } onComplete:^{
+        completed = YES;
+    }];
+
+    XCTAssertTrue(completed);
+    XCTAssertEqual(decryptedEventsCount, 5);
+    XCTAssertEqual(scheduler.runningChunksCount, 0);
+}
+
+@end
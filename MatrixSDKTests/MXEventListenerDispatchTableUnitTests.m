@@ -0,0 +1,89 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXEventListenerDispatchTable.h"
+
+@interface MXEventListenerDispatchTableUnitTests : XCTestCase
+@end
+
+@implementation MXEventListenerDispatchTableUnitTests
+
+- (MXEventListener*)listenerWithTypes:(NSArray<MXEventTypeString>*)types
+{
+    return [[MXEventListener alloc] initWithSender:self andEventTypes:types andListenerBlock:^(MXEvent *event, MXTimelineDirection direction, id customObject) {}];
+}
+
+- (MXEvent*)eventWithType:(MXEventTypeString)type
+{
+    return [MXEvent modelFromJSON:@{
+        @"event_id": @"$event",
+        @"type": type,
+        @"sender": @"@alice:matrix.org",
+        @"content": @{}
+    }];
+}
+
+- (void)testListenersForEventType
+{
+    MXEventListenerDispatchTable *table = [[MXEventListenerDispatchTable alloc] init];
+
+    MXEventListener *messageListener = [self listenerWithTypes:@[kMXEventTypeStringRoomMessage]];
+    MXEventListener *memberListener = [self listenerWithTypes:@[kMXEventTypeStringRoomMember]];
+    [table addListener:messageListener];
+    [table addListener:memberListener];
+
+    XCTAssertEqualObjects([table listenersForEvent:[self eventWithType:kMXEventTypeStringRoomMessage]], @[messageListener]);
+    XCTAssertEqualObjects([table listenersForEvent:[self eventWithType:kMXEventTypeStringRoomMember]], @[memberListener]);
+    XCTAssertEqualObjects([table listenersForEvent:[self eventWithType:kMXEventTypeStringRoomName]], @[]);
+}
+
+- (void)testWildcardListenersAreMergedInRegistrationOrder
+{
+    MXEventListenerDispatchTable *table = [[MXEventListenerDispatchTable alloc] init];
+
+    MXEventListener *wildcardListener1 = [self listenerWithTypes:nil];
+    MXEventListener *messageListener1 = [self listenerWithTypes:@[kMXEventTypeStringRoomMessage, kMXEventTypeStringRoomName]];
+    MXEventListener *wildcardListener2 = [self listenerWithTypes:nil];
+    MXEventListener *messageListener2 = [self listenerWithTypes:@[kMXEventTypeStringRoomMessage]];
+    [table addListener:wildcardListener1];
+    [table addListener:messageListener1];
+    [table addListener:wildcardListener2];
+    [table addListener:messageListener2];
+
+    NSArray *expected = @[wildcardListener1, messageListener1, wildcardListener2, messageListener2];
+    XCTAssertEqualObjects([table listenersForEvent:[self eventWithType:kMXEventTypeStringRoomMessage]], expected);
+    XCTAssertEqualObjects(table.listeners, expected);
+}
+
+- (void)testRemoveListener
+{
+    MXEventListenerDispatchTable *table = [[MXEventListenerDispatchTable alloc] init];
+
+    MXEventListener *listener = [self listenerWithTypes:@[kMXEventTypeStringRoomMessage, kMXEventTypeStringRoomName]];
+    [table addListener:listener];
+    XCTAssertTrue([table containsListener:listener]);
+
+    [table removeListener:listener];
+
+    XCTAssertFalse([table containsListener:listener]);
+    XCTAssertEqualObjects([table listenersForEvent:[self eventWithType:kMXEventTypeStringRoomMessage]], @[]);
+    XCTAssertEqualObjects([table listenersForEvent:[self eventWithType:kMXEventTypeStringRoomName]], @[]);
+    XCTAssertEqualObjects(table.listeners, @[]);
+}
+
+@end
@@ -0,0 +1,253 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXEventLookupCoalescer.h"
+#import "MXMemoryRoomOutgoingMessagesStore.h"
+#import "MXError.h"
+#import "MXEvent.h"
+#import "MXHTTPOperation.h"
+
+@interface MXEventLookupCoalescerUnitTests : XCTestCase
+@end
+
+@implementation MXEventLookupCoalescerUnitTests
+
+- (MXEvent*)eventWithEventId:(NSString*)eventId
+{
+    return [MXEvent modelFromJSON:@{
+        @"event_id": eventId,
+        @"type": kMXEventTypeStringRoomMessage,
+        @"sender": @"@alice:matrix.org",
+        @"content": @{}
+    }];
+}
+
+- (NSError*)notFoundError
+{
+    return [[MXError alloc] initWithErrorCode:kMXErrCodeStringNotFound error:@"Event not found"].createNSError;
+}
+
+- (void)testConcurrentLookupsShareOneRequest
+{
+    MXEventLookupCoalescer *coalescer = [[MXEventLookupCoalescer alloc] initWithNegativeResultTTL:60];
+
+    __block NSUInteger requestsCount = 0;
+    __block void (^requestSuccess)(MXEvent *event);
+    MXEventLookupRequestBlock request = ^MXHTTPOperation *(void (^success)(MXEvent *), void (^failure)(NSError *)) {
+        requestsCount++;
+        requestSuccess = success;
+        return [MXHTTPOperation new];
+    };
+
+    __block NSUInteger successCount = 0;
+    [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:^(MXEvent *event) {
+        successCount++;
+    } failure:nil];
+    [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:^(MXEvent *event) {
+        successCount++;
+    } failure:nil];
+
+    XCTAssertEqual(requestsCount, 1);
+    XCTAssertEqual(coalescer.pendingRequestsCount, 1);
+
+    requestSuccess([self eventWithEventId:@"$event"]);
+
+    XCTAssertEqual(successCount, 2);
+    XCTAssertEqual(coalescer.pendingRequestsCount, 0);
+}
+
+- (void)testRequestIsCancelledWhenAllCallersCancel
+{
+    MXEventLookupCoalescer *coalescer = [[MXEventLookupCoalescer alloc] initWithNegativeResultTTL:60];
+
+    // Each request gets its own operation
+    NSMutableArray<MXHTTPOperation*> *requestOperations = [NSMutableArray array];
+    NSMutableArray<void (^)(MXEvent *event)> *requestSuccesses = [NSMutableArray array];
+    MXEventLookupRequestBlock request = ^MXHTTPOperation *(void (^success)(MXEvent *), void (^failure)(NSError *)) {
+        MXHTTPOperation *requestOperation = [MXHTTPOperation new];
+        [requestOperations addObject:requestOperation];
+        [requestSuccesses addObject:success];
+        return requestOperation;
+    };
+
+    // Three callers share the request of the same event
+    MXHTTPOperation *operation1 = [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:nil failure:nil];
+    MXHTTPOperation *operation2 = [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:nil failure:nil];
+    MXHTTPOperation *operation3 = [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:nil failure:nil];
+
+    XCTAssertEqual(requestOperations.count, 1);
+    XCTAssertNotEqual(operation1, operation2);
+    XCTAssertNotEqual(operation1, requestOperations[0]);
+
+    [operation1 cancel];
+    XCTAssertFalse(requestOperations[0].isCancelled);
+
+    [operation2 cancel];
+    XCTAssertFalse(requestOperations[0].isCancelled);
+    XCTAssertEqual(coalescer.pendingRequestsCount, 1);
+
+    // The shared request is cancelled with its last caller
+    [operation3 cancel];
+    XCTAssertTrue(requestOperations[0].isCancelled);
+    XCTAssertEqual(coalescer.pendingRequestsCount, 0);
+
+    // The callers that did not cancel still get the event
+    __block BOOL cancelledCallerCalled = NO;
+    __block BOOL otherCallerCalled = NO;
+    MXHTTPOperation *operation4 = [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:^(MXEvent *event) {
+        cancelledCallerCalled = YES;
+    } failure:nil];
+    [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:^(MXEvent *event) {
+        otherCallerCalled = YES;
+    } failure:nil];
+
+    XCTAssertEqual(requestOperations.count, 2);
+
+    [operation4 cancel];
+    XCTAssertFalse(requestOperations[1].isCancelled);
+
+    requestSuccesses[1]([self eventWithEventId:@"$event"]);
+    XCTAssertFalse(cancelledCallerCalled);
+    XCTAssertTrue(otherCallerCalled);
+    XCTAssertEqual(coalescer.pendingRequestsCount, 0);
+}
+
+- (void)testNotFoundEventsAreRemembered
+{
+    MXEventLookupCoalescer *coalescer = [[MXEventLookupCoalescer alloc] initWithNegativeResultTTL:60];
+
+    __block NSUInteger requestsCount = 0;
+    MXEventLookupRequestBlock request = ^MXHTTPOperation *(void (^success)(MXEvent *), void (^failure)(NSError *)) {
+        requestsCount++;
+        failure([self notFoundError]);
+        return [MXHTTPOperation new];
+    };
+
+    [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:nil failure:nil];
+    XCTAssertTrue([coalescer isEventKnownAsNotFound:@"$event" inRoom:@"!room"]);
+    XCTAssertFalse([coalescer isEventKnownAsNotFound:@"$event" inRoom:@"!otherRoom"]);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"failure"];
+    [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:^(MXEvent *event) {
+        XCTFail(@"The lookup must fail");
+    } failure:^(NSError *error) {
+        MXError *mxError = [[MXError alloc] initWithNSError:error];
+        XCTAssertEqualObjects(mxError.errcode, kMXErrCodeStringNotFound);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqual(requestsCount, 1);
+
+    [coalescer forgetNotFoundEvent:@"$event" inRoom:@"!room"];
+    [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:nil failure:nil];
+    XCTAssertEqual(requestsCount, 2);
+}
+
+- (void)testNotFoundEventsExpire
+{
+    MXEventLookupCoalescer *coalescer = [[MXEventLookupCoalescer alloc] initWithNegativeResultTTL:0.1];
+
+    __block NSUInteger requestsCount = 0;
+    MXEventLookupRequestBlock request = ^MXHTTPOperation *(void (^success)(MXEvent *), void (^failure)(NSError *)) {
+        requestsCount++;
+        failure([self notFoundError]);
+        return [MXHTTPOperation new];
+    };
+
+    [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:nil failure:nil];
+    XCTAssertTrue([coalescer isEventKnownAsNotFound:@"$event" inRoom:@"!room"]);
+
+    [NSThread sleepForTimeInterval:0.2];
+
+    XCTAssertFalse([coalescer isEventKnownAsNotFound:@"$event" inRoom:@"!room"]);
+    [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:nil failure:nil];
+    XCTAssertEqual(requestsCount, 2);
+}
+
+- (void)testOtherErrorsAreNotRemembered
+{
+    MXEventLookupCoalescer *coalescer = [[MXEventLookupCoalescer alloc] initWithNegativeResultTTL:60];
+
+    MXEventLookupRequestBlock request = ^MXHTTPOperation *(void (^success)(MXEvent *), void (^failure)(NSError *)) {
+        failure([NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil]);
+        return [MXHTTPOperation new];
+    };
+
+    [coalescer eventWithEventId:@"$event" inRoom:@"!room" request:request success:nil failure:nil];
+    XCTAssertFalse([coalescer isEventKnownAsNotFound:@"$event" inRoom:@"!room"]);
+}
+
+- (void)testBatchLookup
+{
+    MXEventLookupCoalescer *coalescer = [[MXEventLookupCoalescer alloc] initWithNegativeResultTTL:60];
+
+    NSMutableArray<NSString*> *requestedEventIds = [NSMutableArray array];
+    MXEventLookupBatchRequestBlock request = ^MXHTTPOperation *(NSString *eventId, NSString *roomId, void (^success)(MXEvent *), void (^failure)(NSError *)) {
+        [requestedEventIds addObject:eventId];
+        if ([eventId isEqualToString:@"$missing"])
+        {
+            failure([self notFoundError]);
+        }
+        else
+        {
+            success([self eventWithEventId:eventId]);
+        }
+        return [MXHTTPOperation new];
+    };
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completion"];
+    [coalescer eventsWithEventIds:@{
+        @"!room1": @[@"$event1", @"$event2", @"$event1"],
+        @"!room2": @[@"$missing"]
+    } request:request completion:^(NSDictionary<NSString *,NSArray<MXEvent *> *> *eventsByRoomId) {
+        XCTAssertEqual(eventsByRoomId[@"!room1"].count, 2);
+        XCTAssertEqual(eventsByRoomId[@"!room2"].count, 0);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+
+    XCTAssertEqual(requestedEventIds.count, 3);
+    XCTAssertTrue([coalescer isEventKnownAsNotFound:@"$missing" inRoom:@"!room2"]);
+}
+
+- (void)testOutgoingMessageWithEventId
+{
+    MXMemoryRoomOutgoingMessagesStore *store = [[MXMemoryRoomOutgoingMessagesStore alloc] init];
+
+    MXEvent *event1 = [self eventWithEventId:@"$local1"];
+    MXEvent *event2 = [self eventWithEventId:@"$local2"];
+    [store storeOutgoingMessage:event1];
+    [store storeOutgoingMessage:event2];
+
+    XCTAssertEqual([store outgoingMessageWithEventId:@"$local1"], event1);
+    XCTAssertEqual([store outgoingMessageWithEventId:@"$local2"], event2);
+
+    // Update the message like MXRoom does once it is sent
+    [store removeOutgoingMessage:@"$local1"];
+    event1.eventId = @"$remote1";
+    [store storeOutgoingMessage:event1];
+
+    XCTAssertNil([store outgoingMessageWithEventId:@"$local1"]);
+    XCTAssertEqual([store outgoingMessageWithEventId:@"$remote1"], event1);
+
+    [store removeAllOutgoingMessages];
+    XCTAssertNil([store outgoingMessageWithEventId:@"$local2"]);
+    XCTAssertNil([store outgoingMessageWithEventId:@"$remote1"]);
+}
+
+@end
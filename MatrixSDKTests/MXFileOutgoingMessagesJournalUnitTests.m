@@ -0,0 +1,118 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXFileOutgoingMessagesJournal.h"
+
+static NSString * const kRoomId = @"!room:matrix.org";
+
+@interface MXFileOutgoingMessagesJournalUnitTests : XCTestCase
+{
+    NSString *folder;
+}
+@end
+
+@implementation MXFileOutgoingMessagesJournalUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+    folder = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"MXFileOutgoingMessagesJournalUnitTests-%@", [NSUUID UUID].UUIDString]];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:folder error:nil];
+    [super tearDown];
+}
+
+- (MXEvent*)eventWithEventId:(NSString*)eventId body:(NSString*)body
+{
+    return [MXEvent modelFromJSON:@{
+        @"event_id": eventId,
+        @"type": kMXEventTypeStringRoomMessage,
+        @"room_id": kRoomId,
+        @"sender": @"@alice:matrix.org",
+        @"content": @{
+            @"msgtype": kMXMessageTypeText,
+            @"body": body
+        }
+    }];
+}
+
+- (void)testRecordsAreReadBackInOrder
+{
+    MXFileOutgoingMessagesJournal *journal = [[MXFileOutgoingMessagesJournal alloc] initWithFolder:folder];
+
+    XCTAssertTrue([journal appendRecordData:[MXFileOutgoingMessagesJournalRecord storeRecordWithEvent:[self eventWithEventId:@"$1" body:@"Hello"] inRoom:kRoomId].archivedData]);
+    XCTAssertTrue([journal appendRecordData:[MXFileOutgoingMessagesJournalRecord removeRecordWithEventId:@"$1" inRoom:kRoomId].archivedData]);
+    XCTAssertTrue([journal appendRecordData:[MXFileOutgoingMessagesJournalRecord removeAllRecordInRoom:kRoomId].archivedData]);
+
+    NSArray<MXFileOutgoingMessagesJournalRecord*> *records = [[MXFileOutgoingMessagesJournal alloc] initWithFolder:folder].records;
+
+    XCTAssertEqual(records.count, 3);
+    XCTAssertEqual(records[0].operation, MXFileOutgoingMessagesJournalOperationStore);
+    XCTAssertEqualObjects(records[0].roomId, kRoomId);
+    XCTAssertEqualObjects(records[0].event.content[@"body"], @"Hello");
+    XCTAssertEqual(records[1].operation, MXFileOutgoingMessagesJournalOperationRemove);
+    XCTAssertEqualObjects(records[1].eventId, @"$1");
+    XCTAssertEqual(records[2].operation, MXFileOutgoingMessagesJournalOperationRemoveAll);
+}
+
+- (void)testRotatedRecordsAreKeptUntilRemoved
+{
+    MXFileOutgoingMessagesJournal *journal = [[MXFileOutgoingMessagesJournal alloc] initWithFolder:folder];
+
+    [journal appendRecordData:[MXFileOutgoingMessagesJournalRecord removeRecordWithEventId:@"$1" inRoom:kRoomId].archivedData];
+    [journal rotate];
+    [journal appendRecordData:[MXFileOutgoingMessagesJournalRecord removeRecordWithEventId:@"$2" inRoom:kRoomId].archivedData];
+
+    // A second rotation before the first snapshot is committed keeps both
+    [journal rotate];
+    [journal appendRecordData:[MXFileOutgoingMessagesJournalRecord removeRecordWithEventId:@"$3" inRoom:kRoomId].archivedData];
+
+    XCTAssertEqualObjects([journal.records valueForKey:@"eventId"], (@[@"$1", @"$2", @"$3"]));
+
+    [journal removeRotatedRecords];
+    XCTAssertEqualObjects([journal.records valueForKey:@"eventId"], @[@"$3"]);
+
+    [journal reset];
+    XCTAssertEqual(journal.records.count, 0);
+}
+
+- (void)testTornRecordIsIgnored
+{
+    MXFileOutgoingMessagesJournal *journal = [[MXFileOutgoingMessagesJournal alloc] initWithFolder:folder];
+    [journal appendRecordData:[MXFileOutgoingMessagesJournalRecord removeRecordWithEventId:@"$1" inRoom:kRoomId].archivedData];
+    journal = nil;
+
+    // Simulate a crash in the middle of a write
+    NSString *file = [folder stringByAppendingPathComponent:@"outgoingMessagesJournal"];
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:file];
+    [fileHandle seekToEndOfFile];
+    [fileHandle writeData:[@"torn" dataUsingEncoding:NSUTF8StringEncoding]];
+    [fileHandle closeFile];
+
+    journal = [[MXFileOutgoingMessagesJournal alloc] initWithFolder:folder];
+    XCTAssertEqualObjects([journal.records valueForKey:@"eventId"], @[@"$1"]);
+
+    // Next records are still readable
+    [journal appendRecordData:[MXFileOutgoingMessagesJournalRecord removeRecordWithEventId:@"$2" inRoom:kRoomId].archivedData];
+    XCTAssertEqualObjects([journal.records valueForKey:@"eventId"], (@[@"$1", @"$2"]));
+}
+
+@end
@@ -0,0 +1,221 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXFileUserDirectory.h"
+
+@interface MXFileUserDirectoryUnitTests : XCTestCase
+{
+    NSString *folder;
+}
+@end
+
+@implementation MXFileUserDirectoryUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+    folder = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"MXFileUserDirectoryUnitTests-%@", [NSUUID UUID].UUIDString]];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:folder error:nil];
+    [super tearDown];
+}
+
+- (MXFileUserDirectory*)openDirectory
+{
+    return [[MXFileUserDirectory alloc] initWithFolder:folder cacheCountLimit:10];
+}
+
+- (MXUser*)userWithUserId:(NSString*)userId displayname:(NSString*)displayname
+{
+    MXUser *user = [[MXUser alloc] initWithUserId:userId];
+    [user setValue:displayname forKey:@"displayname"];
+    return user;
+}
+
+- (void)storeAndWriteUsers:(NSUInteger)count inDirectory:(MXFileUserDirectory*)directory displaynamePrefix:(NSString*)prefix
+{
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        NSString *userId = [NSString stringWithFormat:@"@user%@:matrix.org", @(i)];
+        [directory storeUser:[self userWithUserId:userId displayname:[NSString stringWithFormat:@"%@%@", prefix, @(i)]]];
+    }
+    [directory writeUsers:[directory snapshotDirtyUsers]];
+}
+
+- (void)testStoreAndReopen
+{
+    MXFileUserDirectory *directory = [self openDirectory];
+    [self storeAndWriteUsers:100 inDirectory:directory displaynamePrefix:@"User "];
+    XCTAssertEqual(directory.count, 100);
+
+    directory = [self openDirectory];
+
+    XCTAssertEqual(directory.count, 100);
+    XCTAssertEqualObjects([directory userWithUserId:@"@user42:matrix.org"].displayname, @"User 42");
+    XCTAssertNil([directory userWithUserId:@"@unknown:matrix.org"]);
+    XCTAssertEqual([directory usersWithUserIds:@[@"@user1:matrix.org", @"@user2:matrix.org", @"@unknown:matrix.org"]].count, 2);
+    XCTAssertEqual(directory.allUsers.count, 100);
+}
+
+- (void)testUsersAreNotDecodedAtLoad
+{
+    MXFileUserDirectory *directory = [self openDirectory];
+    [self storeAndWriteUsers:100 inDirectory:directory displaynamePrefix:@"User "];
+
+    directory = [self openDirectory];
+    [directory load];
+
+    XCTAssertEqual(directory.residentUsers.count, 0);
+}
+
+- (void)testSameInstanceWhileRetained
+{
+    MXFileUserDirectory *directory = [self openDirectory];
+    [self storeAndWriteUsers:100 inDirectory:directory displaynamePrefix:@"User "];
+    directory = [self openDirectory];
+
+    MXUser *user = [directory userWithUserId:@"@user0:matrix.org"];
+
+    // Push it out of the cache
+    for (NSUInteger i = 1; i < 100; i++)
+    {
+        [directory userWithUserId:[NSString stringWithFormat:@"@user%@:matrix.org", @(i)]];
+    }
+
+    XCTAssertEqual([directory userWithUserId:@"@user0:matrix.org"], user);
+}
+
+- (void)testStoredUsersAreServedBeforeBeingWritten
+{
+    MXFileUserDirectory *directory = [self openDirectory];
+    [self storeAndWriteUsers:1 inDirectory:directory displaynamePrefix:@"User "];
+
+    [directory storeUser:[self userWithUserId:@"@user0:matrix.org" displayname:@"New name"]];
+    XCTAssertEqualObjects([directory userWithUserId:@"@user0:matrix.org"].displayname, @"New name");
+
+    NSDictionary *snapshot = [directory snapshotDirtyUsers];
+    XCTAssertEqualObjects([directory userWithUserId:@"@user0:matrix.org"].displayname, @"New name");
+
+    [directory writeUsers:snapshot];
+    directory = [self openDirectory];
+    XCTAssertEqualObjects([directory userWithUserId:@"@user0:matrix.org"].displayname, @"New name");
+    XCTAssertEqual(directory.count, 1);
+}
+
+- (void)testIndexIsRebuilt
+{
+    MXFileUserDirectory *directory = [self openDirectory];
+    [self storeAndWriteUsers:50 inDirectory:directory displaynamePrefix:@"User "];
+    directory = nil;
+
+    [[NSFileManager defaultManager] removeItemAtPath:[folder stringByAppendingPathComponent:@"index"] error:nil];
+
+    directory = [self openDirectory];
+    XCTAssertEqual(directory.count, 50);
+    XCTAssertEqualObjects([directory userWithUserId:@"@user7:matrix.org"].displayname, @"User 7");
+}
+
+- (void)testTruncatedDataFile
+{
+    MXFileUserDirectory *directory = [self openDirectory];
+    [self storeAndWriteUsers:10 inDirectory:directory displaynamePrefix:@"User "];
+    [self storeAndWriteUsers:1 inDirectory:directory displaynamePrefix:@"Updated "];
+    directory = nil;
+
+    // Simulate a crash while appending the last record
+    NSString *dataFile = [folder stringByAppendingPathComponent:@"data"];
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:dataFile];
+    unsigned long long length = [fileHandle seekToEndOfFile];
+    [fileHandle truncateFileAtOffset:length - 10];
+    [fileHandle closeFile];
+
+    directory = [self openDirectory];
+    XCTAssertEqual(directory.count, 10);
+    XCTAssertEqualObjects([directory userWithUserId:@"@user0:matrix.org"].displayname, @"User 0");
+}
+
+- (void)testCompaction
+{
+    MXFileUserDirectory *directory = [self openDirectory];
+
+    // Rewrite the same users until outdated records trigger a compaction
+    for (NSUInteger i = 0; i < 30; i++)
+    {
+        [self storeAndWriteUsers:500 inDirectory:directory displaynamePrefix:[NSString stringWithFormat:@"Round %@ ", @(i)]];
+    }
+
+    NSString *dataFile = [folder stringByAppendingPathComponent:@"data"];
+    unsigned long long dataFileSize = [[NSFileManager defaultManager] attributesOfItemAtPath:dataFile error:nil].fileSize;
+
+    directory = [self openDirectory];
+    XCTAssertEqual(directory.count, 500);
+    XCTAssertEqualObjects([directory userWithUserId:@"@user499:matrix.org"].displayname, @"Round 29 499");
+
+    // Without compaction, the file would contain 30 versions of each user
+    NSData *oneUser = [NSKeyedArchiver archivedDataWithRootObject:[directory userWithUserId:@"@user0:matrix.org"]];
+    XCTAssertLessThan(dataFileSize, 10 * 500 * oneUser.length);
+}
+
+- (void)testRemoveAllUsers
+{
+    MXFileUserDirectory *directory = [self openDirectory];
+    [self storeAndWriteUsers:10 inDirectory:directory displaynamePrefix:@"User "];
+
+    [directory removeAllUsers];
+
+    XCTAssertEqual(directory.count, 0);
+    XCTAssertNil([directory userWithUserId:@"@user0:matrix.org"]);
+
+    [self storeAndWriteUsers:1 inDirectory:directory displaynamePrefix:@"New "];
+    directory = [self openDirectory];
+    XCTAssertEqual(directory.count, 1);
+}
+
+- (void)testRestoreBackup
+{
+    NSString *backupFolder = [folder stringByAppendingPathComponent:@"backup"];
+    MXFileUserDirectory *directory = [self openDirectory];
+    [self storeAndWriteUsers:10 inDirectory:directory displaynamePrefix:@"User "];
+    [[NSFileManager defaultManager] createDirectoryAtPath:backupFolder withIntermediateDirectories:YES attributes:nil error:nil];
+
+    [directory backupFilesToFolder:backupFolder];
+    [self storeAndWriteUsers:20 inDirectory:directory displaynamePrefix:@"New "];
+
+    // A second backup in the same commit keeps the first state
+    [directory backupFilesToFolder:backupFolder];
+    [directory storeUser:[self userWithUserId:@"@other:matrix.org" displayname:@"Other"]];
+    [directory writeUsers:[directory snapshotDirtyUsers]];
+    XCTAssertEqual(directory.count, 21);
+
+    // Restore the backup like MXFileStore does
+    for (NSString *file in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:backupFolder error:nil])
+    {
+        [[NSFileManager defaultManager] removeItemAtPath:[folder stringByAppendingPathComponent:file] error:nil];
+        [[NSFileManager defaultManager] copyItemAtPath:[backupFolder stringByAppendingPathComponent:file] toPath:[folder stringByAppendingPathComponent:file] error:nil];
+    }
+    [directory reload];
+
+    XCTAssertEqual(directory.count, 10);
+    XCTAssertEqualObjects([directory userWithUserId:@"@user5:matrix.org"].displayname, @"User 5");
+    XCTAssertNil([directory userWithUserId:@"@other:matrix.org"]);
+}
+
+@end
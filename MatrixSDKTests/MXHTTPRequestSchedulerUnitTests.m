@@ -0,0 +1,247 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXHTTPClient.h"
+#import "MXHTTPRequestScheduler.h"
+#import "MXSDKOptions.h"
+
+#import <OHHTTPStubs/HTTPStubs.h>
+
+static NSString *const kBaseURL = @"https://myhs.org";
+
+@interface MXHTTPRequestSchedulerUnitTests : XCTestCase
+{
+    NSMutableArray<NSString*> *receivedPaths;
+}
+@end
+
+@implementation MXHTTPRequestSchedulerUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    receivedPaths = [NSMutableArray array];
+    [MXSDKOptions sharedInstance].enableHTTPRequestScheduling = YES;
+}
+
+- (void)tearDown
+{
+    [HTTPStubs removeAllStubs];
+    [MXSDKOptions sharedInstance].enableHTTPRequestScheduling = NO;
+
+    [super tearDown];
+}
+
+/**
+ Make the mock server answer requests containing `string` after `responseTime` seconds.
+ */
+- (void)stubRequestsContaining:(NSString*)string responseTime:(NSTimeInterval)responseTime
+{
+    NSMutableArray<NSString*> *paths = receivedPaths;
+    [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return [request.URL.absoluteString containsString:string];
+    } withStubResponse:^HTTPStubsResponse*(NSURLRequest *request) {
+        @synchronized (paths)
+        {
+            [paths addObject:request.URL.path];
+        }
+        return [[HTTPStubsResponse responseWithJSONObject:@{} statusCode:200 headers:@{ @"Content-Type": @"application/json" }]
+                requestTime:0 responseTime:responseTime];
+    }];
+}
+
+- (NSUInteger)receivedRequestsCount
+{
+    @synchronized (receivedPaths)
+    {
+        return receivedPaths.count;
+    }
+}
+
+- (void)testIdenticalRequestsAreCoalesced
+{
+    [self stubRequestsContaining:@"/profile/" responseTime:0.2];
+
+    MXHTTPClient *httpClient = [[MXHTTPClient alloc] initWithBaseURL:kBaseURL andOnUnrecognizedCertificateBlock:nil];
+    XCTAssertNotNil(httpClient.requestScheduler);
+
+    XCTestExpectation *expectation1 = [self expectationWithDescription:@"request1"];
+    XCTestExpectation *expectation2 = [self expectationWithDescription:@"request2"];
+    [httpClient requestWithMethod:@"GET" path:@"_matrix/client/v3/profile/@alice:matrix.org" parameters:nil success:^(NSDictionary *JSONResponse) {
+        [expectation1 fulfill];
+    } failure:^(NSError *error) {
+        XCTFail(@"The request should not fail - NSError: %@", error);
+    }];
+    [httpClient requestWithMethod:@"GET" path:@"_matrix/client/v3/profile/@alice:matrix.org" parameters:nil success:^(NSDictionary *JSONResponse) {
+        [expectation2 fulfill];
+    } failure:^(NSError *error) {
+        XCTFail(@"The request should not fail - NSError: %@", error);
+    }];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertEqual(self.receivedRequestsCount, 1);
+    XCTAssertEqual([httpClient.requestScheduler metricsForLane:MXHTTPRequestLaneInteractive].coalescedRequestsCount, 1);
+}
+
+- (void)testCancelledCallerDoesNotCancelSharedRequest
+{
+    [self stubRequestsContaining:@"/profile/" responseTime:0.2];
+
+    MXHTTPClient *httpClient = [[MXHTTPClient alloc] initWithBaseURL:kBaseURL andOnUnrecognizedCertificateBlock:nil];
+
+    MXHTTPOperation *operation1 = [httpClient requestWithMethod:@"GET" path:@"_matrix/client/v3/profile/@alice:matrix.org" parameters:nil success:^(NSDictionary *JSONResponse) {
+        XCTFail(@"A cancelled request must not call its callbacks");
+    } failure:^(NSError *error) {
+        XCTFail(@"A cancelled request must not call its callbacks");
+    }];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"request2"];
+    [httpClient requestWithMethod:@"GET" path:@"_matrix/client/v3/profile/@alice:matrix.org" parameters:nil success:^(NSDictionary *JSONResponse) {
+        [expectation fulfill];
+    } failure:^(NSError *error) {
+        XCTFail(@"The request should not fail - NSError: %@", error);
+    }];
+
+    [operation1 cancel];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testNonIdempotentRequestsAreNotCoalesced
+{
+    [self stubRequestsContaining:@"/createRoom" responseTime:0.1];
+
+    MXHTTPClient *httpClient = [[MXHTTPClient alloc] initWithBaseURL:kBaseURL andOnUnrecognizedCertificateBlock:nil];
+
+    XCTestExpectation *expectation1 = [self expectationWithDescription:@"request1"];
+    XCTestExpectation *expectation2 = [self expectationWithDescription:@"request2"];
+    [httpClient requestWithMethod:@"POST" path:@"_matrix/client/v3/createRoom" parameters:@{} success:^(NSDictionary *JSONResponse) {
+        [expectation1 fulfill];
+    } failure:nil];
+    [httpClient requestWithMethod:@"POST" path:@"_matrix/client/v3/createRoom" parameters:@{} success:^(NSDictionary *JSONResponse) {
+        [expectation2 fulfill];
+    } failure:nil];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertEqual(self.receivedRequestsCount, 2);
+}
+
+- (void)testSendsDoNotQueueBehindBackgroundFetches
+{
+    [self stubRequestsContaining:@"/download/" responseTime:1];
+    [self stubRequestsContaining:@"/send/" responseTime:0.1];
+
+    MXHTTPClient *httpClient = [[MXHTTPClient alloc] initWithBaseURL:kBaseURL andOnUnrecognizedCertificateBlock:nil];
+    [httpClient.requestScheduler setMaxConcurrentRequests:1 forLane:MXHTTPRequestLaneBackground];
+
+    __block NSUInteger completedDownloadsCount = 0;
+    for (NSUInteger index = 0; index < 3; index++)
+    {
+        NSString *path = [NSString stringWithFormat:@"_matrix/media/v3/download/matrix.org/media%@", @(index)];
+        [httpClient requestWithMethod:@"GET" path:path parameters:nil success:^(NSDictionary *JSONResponse) {
+            completedDownloadsCount++;
+        } failure:nil];
+    }
+
+    MXHTTPRequestLaneMetrics *backgroundMetrics = [httpClient.requestScheduler metricsForLane:MXHTTPRequestLaneBackground];
+    XCTAssertEqual(backgroundMetrics.runningRequestsCount, 1);
+    XCTAssertEqual(backgroundMetrics.queuedRequestsCount, 2);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"send"];
+    [httpClient requestWithMethod:@"PUT" path:@"_matrix/client/v3/rooms/!room:matrix.org/send/m.room.message/txn1" parameters:@{} success:^(NSDictionary *JSONResponse) {
+        XCTAssertEqual(completedDownloadsCount, 0);
+
+        MXHTTPRequestLaneMetrics *sendMetrics = [httpClient.requestScheduler metricsForLane:MXHTTPRequestLaneSend];
+        XCTAssertEqual(sendMetrics.startedRequestsCount, 1);
+        XCTAssertEqual(sendMetrics.queuedRequestsCount, 0);
+        [expectation fulfill];
+    } failure:^(NSError *error) {
+        XCTFail(@"The request should not fail - NSError: %@", error);
+    }];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testLaneLimit
+{
+    MXHTTPRequestScheduler *scheduler = [[MXHTTPRequestScheduler alloc] init];
+    [scheduler setMaxConcurrentRequests:2 forLane:MXHTTPRequestLaneInteractive];
+
+    NSMutableArray<dispatch_block_t> *completions = [NSMutableArray array];
+    for (NSUInteger index = 0; index < 5; index++)
+    {
+        [scheduler scheduleRequestInLane:MXHTTPRequestLaneInteractive block:^(dispatch_block_t completion) {
+            [completions addObject:completion];
+        }];
+    }
+
+    XCTAssertEqual(completions.count, 2);
+    XCTAssertEqual([scheduler metricsForLane:MXHTTPRequestLaneInteractive].queuedRequestsCount, 3);
+
+    completions[0]();
+    XCTAssertEqual(completions.count, 3);
+
+    // Completing twice must not free another slot
+    completions[0]();
+    XCTAssertEqual(completions.count, 3);
+
+    [scheduler setMaxConcurrentRequests:4 forLane:MXHTTPRequestLaneInteractive];
+    XCTAssertEqual(completions.count, 5);
+
+    MXHTTPRequestLaneMetrics *metrics = [scheduler metricsForLane:MXHTTPRequestLaneInteractive];
+    XCTAssertEqual(metrics.runningRequestsCount, 4);
+    XCTAssertEqual(metrics.startedRequestsCount, 5);
+}
+
+- (void)testLaneForRequest
+{
+    XCTAssertEqual([MXHTTPRequestScheduler laneForMethod:@"GET" path:@"_matrix/client/v3/sync"], MXHTTPRequestLaneSync);
+    XCTAssertEqual([MXHTTPRequestScheduler laneForMethod:@"PUT" path:@"_matrix/client/v3/rooms/!room:matrix.org/send/m.room.message/txn1"], MXHTTPRequestLaneSend);
+    XCTAssertEqual([MXHTTPRequestScheduler laneForMethod:@"PUT" path:@"_matrix/client/v3/sendToDevice/m.room.encrypted/txn1"], MXHTTPRequestLaneSend);
+    XCTAssertEqual([MXHTTPRequestScheduler laneForMethod:@"GET" path:@"_matrix/media/v3/download/matrix.org/media"], MXHTTPRequestLaneBackground);
+    XCTAssertEqual([MXHTTPRequestScheduler laneForMethod:@"POST" path:@"_matrix/media/v3/upload"], MXHTTPRequestLaneUpload);
+    XCTAssertEqual([MXHTTPRequestScheduler laneForMethod:@"PUT" path:@"_matrix/client/v3/rooms/!room:matrix.org/redact/$event/txn1"], MXHTTPRequestLaneSend);
+    XCTAssertEqual([MXHTTPRequestScheduler laneForMethod:@"GET" path:@"_matrix/client/v3/rooms/!room:matrix.org/state/m.room.name/"], MXHTTPRequestLaneInteractive);
+    XCTAssertEqual([MXHTTPRequestScheduler laneForMethod:@"GET" path:@"_matrix/client/v3/profile/@alice:matrix.org"], MXHTTPRequestLaneInteractive);
+}
+
+- (void)testCoalescingKey
+{
+    NSString *key1 = [MXHTTPRequestScheduler coalescingKeyForMethod:@"GET" path:@"path" parameters:@{@"a": @"1", @"b": @"2"} data:nil headers:nil];
+    NSString *key2 = [MXHTTPRequestScheduler coalescingKeyForMethod:@"GET" path:@"path" parameters:@{@"b": @"2", @"a": @"1"} data:nil headers:nil];
+    XCTAssertEqualObjects(key1, key2);
+
+    XCTAssertNil([MXHTTPRequestScheduler coalescingKeyForMethod:@"POST" path:@"path" parameters:nil data:nil headers:nil]);
+    XCTAssertNil([MXHTTPRequestScheduler coalescingKeyForMethod:@"GET" path:@"path" parameters:nil data:[NSData data] headers:nil]);
+}
+
+- (void)testCoalescingKeyWithHeaders
+{
+    NSString *key = [MXHTTPRequestScheduler coalescingKeyForMethod:@"GET" path:@"path" parameters:nil data:nil headers:@{@"Authorization": @"Bearer token1"}];
+
+    XCTAssertEqualObjects(key, [MXHTTPRequestScheduler coalescingKeyForMethod:@"GET" path:@"path" parameters:nil data:nil headers:@{@"authorization": @"Bearer token1"}]);
+    XCTAssertNotEqualObjects(key, [MXHTTPRequestScheduler coalescingKeyForMethod:@"GET" path:@"path" parameters:nil data:nil headers:@{@"Authorization": @"Bearer token2"}]);
+    XCTAssertNotEqualObjects(key, [MXHTTPRequestScheduler coalescingKeyForMethod:@"GET" path:@"path" parameters:nil data:nil headers:nil]);
+    XCTAssertNotEqualObjects([MXHTTPRequestScheduler coalescingKeyForMethod:@"GET" path:@"path" parameters:nil data:nil headers:@{@"Content-Type": @"application/json"}],
+                             [MXHTTPRequestScheduler coalescingKeyForMethod:@"GET" path:@"path" parameters:nil data:nil headers:@{@"Content-Type": @"text/plain"}]);
+}
+
+@end
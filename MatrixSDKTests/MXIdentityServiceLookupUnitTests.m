@@ -0,0 +1,456 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXIdentityService.h"
+#import "MXIdentityServerLookupCache.h"
+#import "MXRestClient.h"
+
+#import <OHHTTPStubs/HTTPStubs.h>
+#import <OHHTTPStubs/NSURLRequest+HTTPBodyTesting.h>
+
+static NSString *const kIdentityServerURL = @"https://myis.org";
+static NSString *const kUserId = @"@me:myhs.org";
+
+/**
+ Tests of MXIdentityService v2 lookups against a stubbed identity server.
+ */
+@interface MXIdentityServiceLookupUnitTests : XCTestCase
+{
+    // The pepper announced by the stubbed identity server
+    NSString *serverPepper;
+
+    // Matrix ids by address known by the stubbed identity server
+    NSDictionary<NSString*, NSString*> *serverBindings;
+
+    NSUInteger hashDetailsRequestsCount;
+
+    // Number of addresses in each /lookup request
+    NSMutableArray<NSNumber*> *lookupRequestSizes;
+
+    // Delay before the stubbed identity server answers a /lookup request
+    NSTimeInterval lookupResponseDelay;
+
+    // Fulfilled when a /lookup request reaches the stubbed identity server
+    XCTestExpectation *lookupRequestExpectation;
+}
+@end
+
+@implementation MXIdentityServiceLookupUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    serverPepper = @"pepper1";
+    serverBindings = @{};
+    hashDetailsRequestsCount = 0;
+    lookupRequestSizes = [NSMutableArray array];
+    lookupResponseDelay = 0;
+    lookupRequestExpectation = nil;
+
+    // Start from an empty cache
+    [self deleteLookupCacheFiles];
+
+    [self stubIdentityServer];
+}
+
+- (void)tearDown
+{
+    [HTTPStubs removeAllStubs];
+    [self deleteLookupCacheFiles];
+
+    [super tearDown];
+}
+
+- (NSURL*)temporaryCacheFileURL
+{
+    return [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:@"MXIdentityServiceLookupUnitTests.plist"];
+}
+
+- (void)deleteLookupCacheFiles
+{
+    [[NSFileManager defaultManager] removeItemAtURL:[MXIdentityServerLookupCache fileURLForUser:kUserId identityServer:kIdentityServerURL] error:nil];
+    [[NSFileManager defaultManager] removeItemAtURL:[self temporaryCacheFileURL] error:nil];
+}
+
+- (void)stubIdentityServer
+{
+    [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return [request.URL.path hasSuffix:@"/_matrix/identity/v2"];
+    } withStubResponse:^HTTPStubsResponse*(NSURLRequest *request) {
+        return [HTTPStubsResponse responseWithJSONObject:@{} statusCode:200 headers:@{ @"Content-Type": @"application/json" }];
+    }];
+
+    [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return [request.URL.path hasSuffix:@"/_matrix/identity/v2/hash_details"];
+    } withStubResponse:^HTTPStubsResponse*(NSURLRequest *request) {
+        @synchronized (self)
+        {
+            self->hashDetailsRequestsCount++;
+            return [HTTPStubsResponse responseWithJSONObject:@{
+                @"algorithms": @[@"none", @"sha256"],
+                @"lookup_pepper": self->serverPepper
+            } statusCode:200 headers:@{ @"Content-Type": @"application/json" }];
+        }
+    }];
+
+    [HTTPStubs stubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return [request.URL.path hasSuffix:@"/_matrix/identity/v2/lookup"];
+    } withStubResponse:^HTTPStubsResponse*(NSURLRequest *request) {
+        NSDictionary *body = [NSJSONSerialization JSONObjectWithData:request.OHHTTPStubs_HTTPBody options:0 error:nil];
+
+        @synchronized (self)
+        {
+            if (![body[@"pepper"] isEqualToString:self->serverPepper])
+            {
+                return [HTTPStubsResponse responseWithJSONObject:@{
+                    @"errcode": @"M_INVALID_PEPPER",
+                    @"error": @"Unknown or invalid pepper"
+                } statusCode:400 headers:@{ @"Content-Type": @"application/json" }];
+            }
+
+            NSArray<NSString*> *addresses = body[@"addresses"];
+            [self->lookupRequestSizes addObject:@(addresses.count)];
+            [self->lookupRequestExpectation fulfill];
+
+            NSMutableDictionary *mappings = [NSMutableDictionary dictionary];
+            [self->serverBindings enumerateKeysAndObjectsUsingBlock:^(NSString *address, NSString *userId, BOOL *stop) {
+                NSString *hashedAddress = [MXIdentityServerRestClient hashedAddressForThreepid:address
+                                                                                        medium:kMX3PIDMediumEmail
+                                                                                     algorithm:MXIdentityServerHashAlgorithmSHA256
+                                                                                        pepper:self->serverPepper];
+                if ([addresses containsObject:hashedAddress])
+                {
+                    mappings[hashedAddress] = userId;
+                }
+            }];
+
+            return [[HTTPStubsResponse responseWithJSONObject:@{ @"mappings": mappings }
+                                                   statusCode:200
+                                                      headers:@{ @"Content-Type": @"application/json" }] requestTime:self->lookupResponseDelay responseTime:0];
+        }
+    }];
+}
+
+- (MXIdentityService*)identityService
+{
+    return [self identityServiceWithKnownAPIVersion:YES];
+}
+
+/**
+ Create a service of the stubbed identity server.
+
+ @param knownAPIVersion NO to make the service check the API version before its first request.
+ */
+- (MXIdentityService*)identityServiceWithKnownAPIVersion:(BOOL)knownAPIVersion
+{
+    MXIdentityServerRestClient *restClient = [[MXIdentityServerRestClient alloc] initWithIdentityServer:kIdentityServerURL
+                                                                                            accessToken:@"token"
+                                                                      andOnUnrecognizedCertificateBlock:nil];
+    if (knownAPIVersion)
+    {
+        restClient.preferredAPIPathPrefix = kMXIdentityAPIPrefixPathV2;
+    }
+
+    MXCredentials *credentials = [[MXCredentials alloc] initWithHomeServer:@"https://myhs.org" userId:kUserId accessToken:@"hs_token"];
+    MXRestClient *homeserverRestClient = [[MXRestClient alloc] initWithCredentials:credentials andOnUnrecognizedCertificateBlock:nil];
+
+    return [[MXIdentityService alloc] initWithIdentityServerRestClient:restClient andHomeserverRestClient:homeserverRestClient];
+}
+
+- (NSArray<NSArray<NSString*>*>*)emailThreepidsWithCount:(NSUInteger)count
+{
+    NSMutableArray<NSArray<NSString*>*> *threepids = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger index = 0; index < count; index++)
+    {
+        [threepids addObject:@[kMX3PIDMediumEmail, [NSString stringWithFormat:@"user%@@example.org", @(index)]]];
+    }
+    return threepids;
+}
+
+- (NSArray*)lookup3pids:(NSArray*)threepids onlyNew:(BOOL)onlyNew withService:(MXIdentityService*)identityService
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"lookup"];
+    __block NSArray *result;
+
+    void (^success)(NSArray*) = ^(NSArray *discoveredUsers) {
+        result = discoveredUsers;
+        [expectation fulfill];
+    };
+    void (^failure)(NSError*) = ^(NSError *error) {
+        XCTFail(@"The request should not fail - NSError: %@", error);
+        [expectation fulfill];
+    };
+
+    if (onlyNew)
+    {
+        [identityService lookupNew3pids:threepids success:success failure:failure];
+    }
+    else
+    {
+        [identityService lookup3pids:threepids success:success failure:failure];
+    }
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    return result;
+}
+
+- (void)testLookupIsChunkedAndCached
+{
+    serverBindings = @{
+        @"user0@example.org": @"@user0:example.org",
+        @"user1100@example.org": @"@user1100:example.org"
+    };
+
+    MXIdentityService *identityService = [self identityService];
+    NSArray *threepids = [self emailThreepidsWithCount:1200];
+
+    NSArray *discoveredUsers = [self lookup3pids:threepids onlyNew:NO withService:identityService];
+
+    XCTAssertEqualObjects(discoveredUsers, (@[
+        @[kMX3PIDMediumEmail, @"user0@example.org", @"@user0:example.org"],
+        @[kMX3PIDMediumEmail, @"user1100@example.org", @"@user1100:example.org"]
+    ]));
+    XCTAssertEqualObjects([lookupRequestSizes sortedArrayUsingSelector:@selector(compare:)], (@[@(200), @(500), @(500)]));
+
+    // The same lookup is served from the cache
+    discoveredUsers = [self lookup3pids:threepids onlyNew:NO withService:identityService];
+
+    XCTAssertEqual(discoveredUsers.count, 2);
+    XCTAssertEqual(lookupRequestSizes.count, 3);
+    XCTAssertEqual(hashDetailsRequestsCount, 1);
+}
+
+- (void)testLookupRetriesOnNewPepper
+{
+    serverBindings = @{ @"user1@example.org": @"@user1:example.org" };
+
+    MXIdentityService *identityService = [self identityService];
+    NSArray *threepids = [self emailThreepidsWithCount:3];
+
+    [self lookup3pids:threepids onlyNew:NO withService:identityService];
+    XCTAssertEqual(lookupRequestSizes.count, 1);
+
+    // The identity server rotates its pepper
+    @synchronized (self)
+    {
+        serverPepper = @"pepper2";
+        serverBindings = @{ @"user2@example.org": @"@user2:example.org" };
+    }
+
+    // Cached results are still valid for this pepper
+    NSArray *discoveredUsers = [self lookup3pids:threepids onlyNew:NO withService:identityService];
+    XCTAssertEqualObjects(discoveredUsers, (@[@[kMX3PIDMediumEmail, @"user1@example.org", @"@user1:example.org"]]));
+
+    // New addresses are looked up with the old pepper, rejected, and looked up again with the new one.
+    // The results of the old pepper are dropped
+    NSArray *moreThreepids = [threepids arrayByAddingObject:@[kMX3PIDMediumEmail, @"User9@Example.org"]];
+    discoveredUsers = [self lookup3pids:moreThreepids onlyNew:NO withService:identityService];
+
+    XCTAssertEqualObjects(discoveredUsers, (@[@[kMX3PIDMediumEmail, @"user2@example.org", @"@user2:example.org"]]));
+    XCTAssertEqual(hashDetailsRequestsCount, 2);
+    XCTAssertEqualObjects(lookupRequestSizes, (@[@(3), @(4)]));
+}
+
+- (void)testLookupNew3pids
+{
+    serverBindings = @{
+        @"user0@example.org": @"@user0:example.org",
+        @"user2@example.org": @"@user2:example.org"
+    };
+
+    MXIdentityService *identityService = [self identityService];
+    NSArray *threepids = [self emailThreepidsWithCount:3];
+
+    NSArray *discoveredUsers = [self lookup3pids:[threepids subarrayWithRange:NSMakeRange(0, 2)] onlyNew:YES withService:identityService];
+    XCTAssertEqualObjects(discoveredUsers, (@[@[kMX3PIDMediumEmail, @"user0@example.org", @"@user0:example.org"]]));
+
+    // Only the new contact is reported
+    discoveredUsers = [self lookup3pids:threepids onlyNew:YES withService:identityService];
+    XCTAssertEqualObjects(discoveredUsers, (@[@[kMX3PIDMediumEmail, @"user2@example.org", @"@user2:example.org"]]));
+    XCTAssertEqualObjects(lookupRequestSizes, (@[@(2), @(1)]));
+
+    // Nothing new
+    discoveredUsers = [self lookup3pids:threepids onlyNew:YES withService:identityService];
+    XCTAssertEqualObjects(discoveredUsers, @[]);
+    XCTAssertEqual(lookupRequestSizes.count, 2);
+}
+
+- (void)testLookupResultsArePersisted
+{
+    serverBindings = @{ @"user1@example.org": @"@user1:example.org" };
+
+    NSArray *threepids = [self emailThreepidsWithCount:3];
+    [self lookup3pids:threepids onlyNew:NO withService:[self identityService]];
+    XCTAssertEqual(lookupRequestSizes.count, 1);
+
+    // Another service of the same identity server, like after an application restart, reuses the results
+    NSArray *discoveredUsers = [self lookup3pids:threepids onlyNew:NO withService:[self identityService]];
+
+    XCTAssertEqualObjects(discoveredUsers, (@[@[kMX3PIDMediumEmail, @"user1@example.org", @"@user1:example.org"]]));
+    XCTAssertEqual(lookupRequestSizes.count, 1);
+    XCTAssertEqual(hashDetailsRequestsCount, 2);
+
+    // And remembers the 3rd party ids already looked up
+    discoveredUsers = [self lookup3pids:threepids onlyNew:YES withService:[self identityService]];
+    XCTAssertEqualObjects(discoveredUsers, @[]);
+}
+
+- (void)testCacheIsPersisted
+{
+    NSURL *fileURL = [self temporaryCacheFileURL];
+    NSArray *threepids = @[@[kMX3PIDMediumEmail, @"alice@example.org"], @[kMX3PIDMediumEmail, @"bob@example.org"]];
+
+    MXIdentityServerLookupCache *cache = [[MXIdentityServerLookupCache alloc] initWithFileURL:fileURL resultLifetime:3600];
+    [cache setPepper:@"pepper" algorithm:MXIdentityServerHashAlgorithmSHA256];
+    NSArray<NSString*> *hashedAddresses = [cache hashedAddressesForThreepids:threepids];
+    [cache storeLookupResults:@{ hashedAddresses[0]: @"@alice:example.org" } forHashedAddresses:hashedAddresses];
+    [cache markThreepidsAsSeen:threepids];
+
+    // A new cache reads the file after the pending writes
+    MXIdentityServerLookupCache *cache2 = [[MXIdentityServerLookupCache alloc] initWithFileURL:fileURL resultLifetime:3600];
+    XCTAssertEqualObjects(cache2.pepper, @"pepper");
+    XCTAssertEqualObjects([cache2 lookupResultForHashedAddress:hashedAddresses[0]], @"@alice:example.org");
+    XCTAssertEqualObjects([cache2 lookupResultForHashedAddress:hashedAddresses[1]], [NSNull null]);
+    XCTAssertEqualObjects([cache2 unseenThreepids:threepids], @[]);
+
+    // Results of another pepper are not reused. Seen 3rd party ids are kept
+    MXIdentityServerLookupCache *cache3 = [[MXIdentityServerLookupCache alloc] initWithFileURL:fileURL resultLifetime:3600];
+    [cache3 setPepper:@"pepper2" algorithm:MXIdentityServerHashAlgorithmSHA256];
+    XCTAssertNil([cache3 lookupResultForHashedAddress:hashedAddresses[0]]);
+    XCTAssertEqualObjects([cache3 unseenThreepids:threepids], @[]);
+
+    // Only hashes are written
+    NSData *fileData = [NSData dataWithContentsOfURL:fileURL];
+    NSString *fileString = [[NSString alloc] initWithData:fileData encoding:NSISOLatin1StringEncoding];
+    XCTAssertNotNil(fileData);
+    XCTAssertFalse([fileString containsString:@"alice"]);
+    XCTAssertFalse([fileString containsString:@"bob"]);
+
+    // Reset deletes the file
+    [cache3 reset];
+    MXIdentityServerLookupCache *cache4 = [[MXIdentityServerLookupCache alloc] initWithFileURL:fileURL resultLifetime:3600];
+    XCTAssertNil(cache4.pepper);
+    XCTAssertEqualObjects([cache4 unseenThreepids:threepids], threepids);
+}
+
+- (void)testCacheOfTheNoneAlgorithmIsNotPersisted
+{
+    NSURL *fileURL = [self temporaryCacheFileURL];
+    NSArray *threepids = @[@[kMX3PIDMediumEmail, @"alice@example.org"]];
+
+    // With the none algorithm, hashed addresses are the plain addresses
+    MXIdentityServerLookupCache *cache = [[MXIdentityServerLookupCache alloc] initWithFileURL:fileURL resultLifetime:3600];
+    [cache setPepper:@"pepper" algorithm:MXIdentityServerHashAlgorithmNone];
+    NSArray<NSString*> *hashedAddresses = [cache hashedAddressesForThreepids:threepids];
+    [cache storeLookupResults:@{ hashedAddresses[0]: @"@alice:example.org" } forHashedAddresses:hashedAddresses];
+    [cache markThreepidsAsSeen:threepids];
+
+    MXIdentityServerLookupCache *cache2 = [[MXIdentityServerLookupCache alloc] initWithFileURL:fileURL resultLifetime:3600];
+    XCTAssertNil(cache2.pepper);
+    XCTAssertNil([cache2 lookupResultForHashedAddress:hashedAddresses[0]]);
+    XCTAssertEqualObjects([cache2 unseenThreepids:threepids], @[]);
+
+    NSString *fileString = [[NSString alloc] initWithData:[NSData dataWithContentsOfURL:fileURL] encoding:NSISOLatin1StringEncoding];
+    XCTAssertFalse([fileString containsString:@"alice"]);
+}
+
+- (void)testResetLookupCacheDeletesTheUserFile
+{
+    [self lookup3pids:[self emailThreepidsWithCount:1] onlyNew:NO withService:[self identityService]];
+
+    NSURL *fileURL = [MXIdentityServerLookupCache fileURLForUser:kUserId identityServer:kIdentityServerURL];
+    MXIdentityServerLookupCache *cache = [[MXIdentityServerLookupCache alloc] initWithFileURL:fileURL resultLifetime:3600];
+    XCTAssertEqualObjects(cache.pepper, @"pepper1");
+
+    [[self identityService] resetLookupCache];
+
+    cache = [[MXIdentityServerLookupCache alloc] initWithFileURL:fileURL resultLifetime:3600];
+    XCTAssertNil(cache.pepper);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:fileURL.path]);
+}
+
+- (void)testCancelAfterAnAsynchronousVersionCheckCancelsTheLookup
+{
+    lookupResponseDelay = 1;
+    lookupRequestExpectation = [self expectationWithDescription:@"lookup request"];
+
+    MXIdentityService *identityService = [self identityServiceWithKnownAPIVersion:NO];
+    MXHTTPOperation *operation = [identityService lookup3pids:[self emailThreepidsWithCount:3] success:^(NSArray *discoveredUsers) {
+        XCTFail(@"A cancelled lookup must not succeed");
+    } failure:^(NSError *error) {
+    }];
+
+    // Cancel once the chunk requests have been sent
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    [operation cancel];
+
+    // Wait for the delayed /lookup response
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait"];
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(2 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    XCTAssertTrue(operation.isCancelled);
+}
+
+- (void)testCacheHashes
+{
+    MXIdentityServerLookupCache *cache = [[MXIdentityServerLookupCache alloc] initWithResultLifetime:3600];
+    NSArray *threepids = [MXIdentityServerLookupCache validThreepids:@[
+        @[kMX3PIDMediumEmail, @"Alice@Example.org"],
+        @[kMX3PIDMediumMSISDN, @"447700900000"],
+        @[@"invalid"]
+    ]];
+    XCTAssertEqual(threepids.count, 2);
+
+    // No pepper yet
+    XCTAssertEqualObjects([cache hashedAddressesForThreepids:threepids], @[]);
+
+    [cache setPepper:@"pepper" algorithm:MXIdentityServerHashAlgorithmSHA256];
+    NSArray<NSString*> *hashedAddresses = [cache hashedAddressesForThreepids:threepids];
+
+    XCTAssertEqualObjects(hashedAddresses, (@[
+        [MXIdentityServerRestClient hashedAddressForThreepid:@"alice@example.org" medium:kMX3PIDMediumEmail algorithm:MXIdentityServerHashAlgorithmSHA256 pepper:@"pepper"],
+        [MXIdentityServerRestClient hashedAddressForThreepid:@"447700900000" medium:kMX3PIDMediumMSISDN algorithm:MXIdentityServerHashAlgorithmSHA256 pepper:@"pepper"]
+    ]));
+
+    [cache storeLookupResults:@{ hashedAddresses[0]: @"@alice:example.org" } forHashedAddresses:hashedAddresses];
+    XCTAssertEqualObjects([cache lookupResultForHashedAddress:hashedAddresses[0]], @"@alice:example.org");
+    XCTAssertEqualObjects([cache lookupResultForHashedAddress:hashedAddresses[1]], [NSNull null]);
+
+    // A new pepper drops hashes and results
+    [cache setPepper:@"pepper2" algorithm:MXIdentityServerHashAlgorithmSHA256];
+    XCTAssertNil([cache lookupResultForHashedAddress:hashedAddresses[0]]);
+    XCTAssertNotEqualObjects([cache hashedAddressesForThreepids:threepids], hashedAddresses);
+}
+
+- (void)testCacheResultsExpire
+{
+    MXIdentityServerLookupCache *cache = [[MXIdentityServerLookupCache alloc] initWithResultLifetime:-1];
+    [cache setPepper:@"pepper" algorithm:MXIdentityServerHashAlgorithmNone];
+
+    NSArray<NSString*> *hashedAddresses = [cache hashedAddressesForThreepids:@[@[kMX3PIDMediumEmail, @"alice@example.org"]]];
+    XCTAssertEqualObjects(hashedAddresses, @[@"alice@example.org email"]);
+
+    [cache storeLookupResults:@{ hashedAddresses[0]: @"@alice:example.org" } forHashedAddresses:hashedAddresses];
+    XCTAssertNil([cache lookupResultForHashedAddress:hashedAddresses[0]]);
+}
+
+@end
@@ -0,0 +1,189 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+#import <ImageIO/ImageIO.h>
+
+#import "MXImageCache.h"
+
+#if TARGET_OS_IPHONE
+#import <MobileCoreServices/MobileCoreServices.h>
+typedef UIImage MXTestImage;
+#elif TARGET_OS_OSX
+typedef NSImage MXTestImage;
+#endif
+
+@interface MXImageCacheUnitTests : XCTestCase
+{
+    NSString *imagesFolder;
+}
+@end
+
+@implementation MXImageCacheUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    imagesFolder = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [[NSFileManager defaultManager] createDirectoryAtPath:imagesFolder withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:imagesFolder error:nil];
+
+    [super tearDown];
+}
+
+/**
+ Write a PNG file of the given size.
+ */
+- (NSString*)pngFileWithWidth:(size_t)width height:(size_t)height
+{
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace, kCGImageAlphaPremultipliedLast);
+    CGContextSetRGBFillColor(context, 1, 0, 0, 1);
+    CGContextFillRect(context, CGRectMake(0, 0, width, height));
+    CGImageRef cgImage = CGBitmapContextCreateImage(context);
+
+    NSString *filePath = [imagesFolder stringByAppendingPathComponent:[NSString stringWithFormat:@"%@.png", [NSUUID UUID].UUIDString]];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithURL((__bridge CFURLRef)[NSURL fileURLWithPath:filePath], kUTTypePNG, 1, NULL);
+    CGImageDestinationAddImage(destination, cgImage, NULL);
+    CGImageDestinationFinalize(destination);
+
+    CFRelease(destination);
+    CGImageRelease(cgImage);
+    CGContextRelease(context);
+    CGColorSpaceRelease(colorSpace);
+
+    return filePath;
+}
+
+- (CGSize)pixelSizeOfImage:(MXTestImage*)image
+{
+#if TARGET_OS_IPHONE
+    CGImageRef cgImage = image.CGImage;
+#elif TARGET_OS_OSX
+    CGImageRef cgImage = [image CGImageForProposedRect:NULL context:nil hints:nil];
+#endif
+    return CGSizeMake(CGImageGetWidth(cgImage), CGImageGetHeight(cgImage));
+}
+
+- (void)testDecodeKeepsOriginalSize
+{
+    NSString *filePath = [self pngFileWithWidth:300 height:200];
+
+    MXTestImage *image = [MXImageCache decodeImageWithFilePath:filePath maxPixelSize:0];
+
+    XCTAssertNotNil(image);
+    XCTAssertTrue(CGSizeEqualToSize([self pixelSizeOfImage:image], CGSizeMake(300, 200)));
+    XCTAssertGreaterThanOrEqual([MXImageCache costOfImage:image], 300 * 200 * 4);
+}
+
+- (void)testDecodeDownscales
+{
+    NSString *filePath = [self pngFileWithWidth:400 height:200];
+
+    MXTestImage *image = [MXImageCache decodeImageWithFilePath:filePath maxPixelSize:100];
+
+    XCTAssertTrue(CGSizeEqualToSize([self pixelSizeOfImage:image], CGSizeMake(100, 50)));
+}
+
+- (void)testDecodeInvalidFile
+{
+    NSString *filePath = [imagesFolder stringByAppendingPathComponent:@"invalid.png"];
+    [[@"not an image" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:filePath atomically:YES];
+
+    XCTAssertNil([MXImageCache decodeImageWithFilePath:filePath maxPixelSize:0]);
+    XCTAssertNil([MXImageCache decodeImageWithFilePath:[imagesFolder stringByAppendingPathComponent:@"missing.png"] maxPixelSize:0]);
+}
+
+- (void)testCacheIsBoundedByCost
+{
+    MXTestImage *image = [MXImageCache decodeImageWithFilePath:[self pngFileWithWidth:100 height:100] maxPixelSize:0];
+    NSUInteger imageCost = [MXImageCache costOfImage:image];
+
+    MXImageCache *cache = [[MXImageCache alloc] initWithTotalCostLimit:imageCost * 2];
+    [cache setImage:image forKey:@"a"];
+    [cache setImage:image forKey:@"b"];
+    XCTAssertEqual(cache.totalCost, imageCost * 2);
+
+    // "a" becomes the most recently used
+    XCTAssertNotNil([cache imageForKey:@"a"]);
+
+    [cache setImage:image forKey:@"c"];
+    XCTAssertEqual(cache.count, 2);
+    XCTAssertNotNil([cache imageForKey:@"a"]);
+    XCTAssertNil([cache imageForKey:@"b"]);
+    XCTAssertNotNil([cache imageForKey:@"c"]);
+
+    // Too big to be cached
+    cache.totalCostLimit = imageCost - 1;
+    XCTAssertEqual(cache.count, 0);
+    [cache setImage:image forKey:@"d"];
+    XCTAssertNil([cache imageForKey:@"d"]);
+    XCTAssertEqual(cache.totalCost, 0);
+}
+
+- (void)testTrimToCost
+{
+    MXTestImage *image = [MXImageCache decodeImageWithFilePath:[self pngFileWithWidth:100 height:100] maxPixelSize:0];
+    NSUInteger imageCost = [MXImageCache costOfImage:image];
+
+    MXImageCache *cache = [[MXImageCache alloc] initWithTotalCostLimit:imageCost * 4];
+    for (NSString *key in @[@"a", @"b", @"c", @"d"])
+    {
+        [cache setImage:image forKey:key];
+    }
+
+    [cache trimToCost:imageCost * 2];
+    XCTAssertEqual(cache.count, 2);
+    XCTAssertNotNil([cache imageForKey:@"d"]);
+
+    [cache removeAllImages];
+    XCTAssertEqual(cache.count, 0);
+    XCTAssertEqual(cache.totalCost, 0);
+}
+
+- (void)testConcurrentLoadsShareDecode
+{
+    NSString *filePath = [self pngFileWithWidth:1000 height:1000];
+    MXImageCache *cache = [[MXImageCache alloc] initWithTotalCostLimit:100 * 1024 * 1024];
+
+    XCTestExpectation *expectation1 = [self expectationWithDescription:@"load1"];
+    XCTestExpectation *expectation2 = [self expectationWithDescription:@"load2"];
+    __block MXTestImage *image1;
+
+    [cache loadImageWithFilePath:filePath maxPixelSize:64 completion:^(MXTestImage *image) {
+        XCTAssertTrue(NSThread.isMainThread);
+        image1 = image;
+        [expectation1 fulfill];
+    }];
+    [cache loadImageWithFilePath:filePath maxPixelSize:64 completion:^(MXTestImage *image) {
+        XCTAssertNotNil(image);
+        XCTAssertEqual(image, image1);
+        [expectation2 fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertEqual(cache.count, 1);
+    XCTAssertEqual([cache imageForKey:[MXImageCache keyForFilePath:filePath maxPixelSize:64]], image1);
+    XCTAssertTrue(CGSizeEqualToSize([self pixelSizeOfImage:image1], CGSizeMake(64, 64)));
+}
+
+@end
@@ -16,6 +16,7 @@
 
 
 #import <XCTest/XCTest.h>
+#import <Security/Security.h>
 
 #import "MXMegolmExportEncryption.h"
 
@@ -143,4 +144,198 @@
     XCTAssertNil(encrypted);
 }
 
+- (void)testStreamRoundTrip
+{
+    // Several chunks of stream and base64 batches
+    NSMutableData *input = [NSMutableData dataWithLength:200 * 1024 + 7];
+    XCTAssertEqual(SecRandomCopyBytes(kSecRandomDefault, input.length, input.mutableBytes), 0);
+    NSString *password = @"my super secret passphrase";
+
+    NSOutputStream *encryptedStream = [NSOutputStream outputStreamToMemory];
+    [encryptedStream open];
+
+    NSError *error;
+    BOOL success = [MXMegolmExportEncryption encryptMegolmKeyStream:[NSInputStream inputStreamWithData:input] toStream:encryptedStream withPassword:password kdfRounds:1000 error:&error];
+    XCTAssertTrue(success);
+    XCTAssertNil(error);
+
+    NSData *encrypted = [encryptedStream propertyForKey:NSStreamDataWrittenToMemoryStreamKey];
+    [encryptedStream close];
+
+    // The streaming and the in-memory APIs produce the same format
+    NSData *decrypted = [MXMegolmExportEncryption decryptMegolmKeyFile:encrypted withPassword:password error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(decrypted, input);
+
+    NSOutputStream *decryptedStream = [NSOutputStream outputStreamToMemory];
+    [decryptedStream open];
+    success = [MXMegolmExportEncryption decryptMegolmKeyStream:[NSInputStream inputStreamWithData:encrypted] toStream:decryptedStream withPassword:password error:&error];
+    XCTAssertTrue(success);
+    XCTAssertEqualObjects([decryptedStream propertyForKey:NSStreamDataWrittenToMemoryStreamKey], input);
+    [decryptedStream close];
+}
+
+- (void)testStreamDecryptWithOtherLineBreaks
+{
+    NSMutableData *input = [NSMutableData dataWithLength:100 * 1024];
+    XCTAssertEqual(SecRandomCopyBytes(kSecRandomDefault, input.length, input.mutableBytes), 0);
+    NSString *password = @"my super secret passphrase";
+
+    NSData *encrypted = [MXMegolmExportEncryption encryptMegolmKeyFile:input withPassword:password kdfRounds:1000 error:nil];
+
+    // CRLF line breaks, text before the header and no line break after the trailer
+    NSString *armored = [[NSString alloc] initWithData:encrypted encoding:NSUTF8StringEncoding];
+    armored = [armored stringByTrimmingCharactersInSet:NSCharacterSet.newlineCharacterSet];
+    armored = [armored stringByReplacingOccurrencesOfString:@"\n" withString:@"\r\n"];
+    armored = [@"-----BEGIN MEGOLM SESSION DATA----- but not quite\r\n\r\n" stringByAppendingString:armored];
+
+    NSOutputStream *decryptedStream = [NSOutputStream outputStreamToMemory];
+    [decryptedStream open];
+    NSError *error;
+    BOOL success = [MXMegolmExportEncryption decryptMegolmKeyStream:[NSInputStream inputStreamWithData:[armored dataUsingEncoding:NSUTF8StringEncoding]] toStream:decryptedStream withPassword:password error:&error];
+    XCTAssertTrue(success);
+    XCTAssertNil(error);
+    XCTAssertEqualObjects([decryptedStream propertyForKey:NSStreamDataWrittenToMemoryStreamKey], input);
+    [decryptedStream close];
+}
+
+- (void)testStreamDecryptWithWrongPassword
+{
+    NSData *encrypted = [MXMegolmExportEncryption encryptMegolmKeyFile:[@"plain" dataUsingEncoding:NSUTF8StringEncoding] withPassword:@"password" kdfRounds:1000 error:nil];
+
+    NSError *error;
+    BOOL success = [MXMegolmExportEncryption decryptMegolmKeyStream:[NSInputStream inputStreamWithData:encrypted] toStream:[NSOutputStream outputStreamToMemory] withPassword:@"wrong" error:&error];
+
+    XCTAssertFalse(success);
+    XCTAssertEqual(error.code, MXMegolmExportErrorAuthenticationFailedCode);
+}
+
+- (void)testSessionsRoundTrip
+{
+    NSMutableArray<NSDictionary*> *sessions = [NSMutableArray array];
+    for (NSUInteger index = 0; index < 500; index++)
+    {
+        [sessions addObject:@{
+            @"room_id": [NSString stringWithFormat:@"!room%@:matrix.org", @(index)],
+            @"session_id": [NSString stringWithFormat:@"session, \"%@\" ]", @(index)],
+            @"forwarding_curve25519_key_chain": @[],
+            @"sender_claimed_keys": @{ @"ed25519": @"key" }
+        }];
+    }
+
+    NSURL *fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString]];
+    NSError *error;
+    BOOL success = [MXMegolmExportEncryption encryptMegolmSessions:sessions.objectEnumerator toStream:[NSOutputStream outputStreamWithURL:fileURL append:NO] withPassword:@"password" kdfRounds:1000 error:&error];
+    XCTAssertTrue(success);
+    XCTAssertTrue([MXMegolmExportEncryption isMegolmKeyFile:fileURL]);
+
+    NSMutableArray<NSDictionary*> *importedSessions = [NSMutableArray array];
+    success = [MXMegolmExportEncryption decryptMegolmKeyFileAtURL:fileURL withPassword:@"password" sessionBlock:^(NSDictionary *session) {
+        [importedSessions addObject:session];
+    } error:&error];
+    XCTAssertTrue(success);
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(importedSessions, sessions);
+
+    // The file can also be read as a whole
+    NSData *plain = [MXMegolmExportEncryption decryptMegolmKeyFile:[NSData dataWithContentsOfURL:fileURL] withPassword:@"password" error:&error];
+    XCTAssertEqualObjects([NSJSONSerialization JSONObjectWithData:plain options:0 error:nil], sessions);
+
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+- (void)testSessionsAreNotImportedFromTamperedFile
+{
+    NSData *encrypted = [MXMegolmExportEncryption encryptMegolmKeyFile:[@"[{\"session_id\":\"a\"}]" dataUsingEncoding:NSUTF8StringEncoding] withPassword:@"password" kdfRounds:1000 error:nil];
+
+    // Flip a bit in the first base64 line after the header
+    NSMutableData *tampered = [encrypted mutableCopy];
+    uint8_t *bytes = tampered.mutableBytes;
+    NSUInteger position = @"-----BEGIN MEGOLM SESSION DATA-----\n".length + 60;
+    bytes[position] = (bytes[position] == 'A') ? 'B' : 'A';
+
+    NSURL *fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString]];
+    [tampered writeToURL:fileURL atomically:YES];
+
+    NSError *error;
+    BOOL success = [MXMegolmExportEncryption decryptMegolmKeyFileAtURL:fileURL withPassword:@"password" sessionBlock:^(NSDictionary *session) {
+        XCTFail(@"No session must be imported from a tampered file");
+    } error:&error];
+
+    XCTAssertFalse(success);
+    XCTAssertEqual(error.code, MXMegolmExportErrorAuthenticationFailedCode);
+
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+}
+
+- (void)testAsyncSessionsRoundTrip
+{
+    NSMutableArray<NSDictionary*> *sessions = [NSMutableArray array];
+    for (NSUInteger index = 0; index < 100; index++)
+    {
+        [sessions addObject:@{
+            @"room_id": [NSString stringWithFormat:@"!room%@:matrix.org", @(index)],
+            @"session_id": [NSString stringWithFormat:@"session%@", @(index)]
+        }];
+    }
+
+    NSURL *fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString]];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Export and import"];
+
+    NSProgress *exportProgress = [MXMegolmExportEncryption encryptMegolmSessions:sessions toFileAtURL:fileURL withPassword:@"password" kdfRounds:25000 success:^{
+        XCTAssertTrue([NSThread isMainThread]);
+
+        // Keys derived by slices can be derived in one call by the synchronous API
+        NSError *error;
+        NSData *plain = [MXMegolmExportEncryption decryptMegolmKeyFile:[NSData dataWithContentsOfURL:fileURL] withPassword:@"password" error:&error];
+        XCTAssertEqualObjects([NSJSONSerialization JSONObjectWithData:plain options:0 error:nil], sessions);
+
+        NSMutableArray<NSDictionary*> *importedSessions = [NSMutableArray array];
+        __block NSProgress *importProgress = [MXMegolmExportEncryption decryptMegolmKeyFileAtURL:fileURL withPassword:@"password" sessionBlock:^(NSDictionary *session) {
+            [importedSessions addObject:session];
+        } success:^{
+            XCTAssertEqualObjects(importedSessions, sessions);
+            XCTAssertEqual(importProgress.fractionCompleted, 1.0);
+
+            [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+            [expectation fulfill];
+        } failure:^(NSError *error) {
+            XCTFail(@"The operation should not fail - NSError: %@", error);
+            [expectation fulfill];
+        }];
+    } failure:^(NSError *error) {
+        XCTFail(@"The operation should not fail - NSError: %@", error);
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    XCTAssertEqual(exportProgress.fractionCompleted, 1.0);
+}
+
+- (void)testAsyncExportCancellation
+{
+    NSURL *fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString]];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Cancelled export"];
+
+    NSProgress *progress = [MXMegolmExportEncryption encryptMegolmSessions:@[@{@"session_id": @"a"}] toFileAtURL:fileURL withPassword:@"password" kdfRounds:10000000 success:^{
+        XCTFail(@"The operation must be cancelled");
+        [expectation fulfill];
+    } failure:^(NSError *error) {
+        XCTAssertEqual(error.code, MXMegolmExportErrorCancelledCode);
+        XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:fileURL.path]);
+        [expectation fulfill];
+    }];
+    [progress cancel];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testKdfRoundsForDuration
+{
+    NSUInteger rounds = [MXMegolmExportEncryption kdfRoundsForDuration:0.001];
+    XCTAssertEqual(rounds, 100000);
+
+    XCTAssertGreaterThanOrEqual([MXMegolmExportEncryption kdfRoundsForDuration:1], rounds);
+}
+
 @end
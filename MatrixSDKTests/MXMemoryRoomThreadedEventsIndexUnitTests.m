@@ -0,0 +1,112 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXMemoryRoomStore.h"
+
+@interface MXMemoryRoomThreadedEventsIndexUnitTests : XCTestCase
+{
+    MXMemoryRoomStore *roomStore;
+    NSArray<MXEventTypeString> *types;
+}
+@end
+
+@implementation MXMemoryRoomThreadedEventsIndexUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+    roomStore = [MXMemoryRoomStore new];
+    types = @[kMXEventTypeStringRoomMessage];
+}
+
+- (MXEvent*)eventWithEventId:(NSString*)eventId type:(MXEventTypeString)type ts:(uint64_t)ts threadId:(NSString*)threadId
+{
+    NSMutableDictionary *content = [NSMutableDictionary dictionaryWithDictionary:@{
+        @"msgtype": kMXMessageTypeText,
+        @"body": eventId
+    }];
+    if (threadId)
+    {
+        content[@"m.relates_to"] = @{
+            @"rel_type": MXEventRelationTypeThread,
+            @"event_id": threadId
+        };
+    }
+
+    return [MXEvent modelFromJSON:@{
+        @"event_id": eventId,
+        @"type": type,
+        @"room_id": @"!room:matrix.org",
+        @"sender": @"@alice:matrix.org",
+        @"origin_server_ts": @(ts),
+        @"content": content
+    }];
+}
+
+- (void)testEventToAcknowledge
+{
+    [roomStore storeEvent:[self eventWithEventId:@"$2" type:kMXEventTypeStringRoomMessage ts:2 threadId:nil] direction:MXTimelineDirectionForwards];
+    [roomStore storeEvent:[self eventWithEventId:@"$3" type:kMXEventTypeStringRoomMessage ts:3 threadId:@"$2"] direction:MXTimelineDirectionForwards];
+    [roomStore storeEvent:[self eventWithEventId:@"$4" type:kMXEventTypeStringReaction ts:4 threadId:nil] direction:MXTimelineDirectionForwards];
+
+    MXEvent *reaction = [roomStore eventWithEventId:@"$4"];
+
+    // Non acknowledgeable events and events of other threads are skipped
+    XCTAssertEqualObjects([roomStore eventToAcknowledge:reaction afterReceipt:nil withTypeIn:types].eventId, @"$2");
+
+    // Not after the current receipt
+    XCTAssertNil([roomStore eventToAcknowledge:reaction afterReceipt:@"$2" withTypeIn:types]);
+
+    // The index follows events stored afterwards, in both directions
+    [roomStore storeEvent:[self eventWithEventId:@"$1" type:kMXEventTypeStringRoomMessage ts:1 threadId:nil] direction:MXTimelineDirectionBackwards];
+    [roomStore storeEvent:[self eventWithEventId:@"$5" type:kMXEventTypeStringRoomMessage ts:5 threadId:nil] direction:MXTimelineDirectionForwards];
+
+    XCTAssertEqualObjects([roomStore eventToAcknowledge:[roomStore eventWithEventId:@"$5"] afterReceipt:@"$1" withTypeIn:types].eventId, @"$5");
+    XCTAssertNil([roomStore eventToAcknowledge:[roomStore eventWithEventId:@"$1"] afterReceipt:@"$2" withTypeIn:types]);
+    XCTAssertEqualObjects([roomStore eventToAcknowledge:[roomStore eventWithEventId:@"$3"] afterReceipt:nil withTypeIn:types].eventId, @"$3");
+}
+
+- (void)testEventNotInStoreFallsBackToTimestamp
+{
+    for (NSUInteger i = 1; i <= 5; i++)
+    {
+        [roomStore storeEvent:[self eventWithEventId:[NSString stringWithFormat:@"$%@", @(i)] type:kMXEventTypeStringRoomMessage ts:i * 10 threadId:nil] direction:MXTimelineDirectionForwards];
+    }
+
+    MXEvent *unknownEvent = [self eventWithEventId:@"$unknown" type:kMXEventTypeStringRoomMessage ts:35 threadId:nil];
+
+    XCTAssertEqualObjects([roomStore eventToAcknowledge:unknownEvent afterReceipt:@"$1" withTypeIn:types].eventId, @"$3");
+    XCTAssertNil([roomStore eventToAcknowledge:unknownEvent afterReceipt:@"$4" withTypeIn:types]);
+}
+
+- (void)testRedactionMovesEventToMainTimeline
+{
+    [roomStore storeEvent:[self eventWithEventId:@"$1" type:kMXEventTypeStringRoomMessage ts:1 threadId:nil] direction:MXTimelineDirectionForwards];
+    [roomStore storeEvent:[self eventWithEventId:@"$2" type:kMXEventTypeStringRoomMessage ts:2 threadId:@"$1"] direction:MXTimelineDirectionForwards];
+    [roomStore storeEvent:[self eventWithEventId:@"$3" type:kMXEventTypeStringReaction ts:3 threadId:nil] direction:MXTimelineDirectionForwards];
+
+    MXEvent *reaction = [roomStore eventWithEventId:@"$3"];
+    XCTAssertEqualObjects([roomStore eventToAcknowledge:reaction afterReceipt:nil withTypeIn:types].eventId, @"$1");
+
+    // Once redacted, the thread event has no more relation
+    [roomStore replaceEvent:[self eventWithEventId:@"$2" type:kMXEventTypeStringRoomMessage ts:2 threadId:nil]];
+
+    XCTAssertEqualObjects([roomStore eventToAcknowledge:reaction afterReceipt:nil withTypeIn:types].eventId, @"$2");
+}
+
+@end
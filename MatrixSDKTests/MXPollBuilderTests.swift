@@ -157,12 +157,12 @@ class MXPollBuilderTest: XCTestCase {
     }
     
     private func pollStartedEvent() -> MXEvent {
-        .init(fromJSON: pollResponseEventWithSender("Bob", answerIdentifiers: ["1", "2"]))
+        .init(fromJSON: pollResponseEventWithSender("Bob", eventId: "$eventId", answerIdentifiers: ["1", "2"]))
     }
     
-    private func pollResponseEventWithSender(_ sender: String, timestamp: Int = 0, answerIdentifiers:[String]) -> [String: Any] {
+    private func pollResponseEventWithSender(_ sender: String, eventId: String = "$" + UUID().uuidString, timestamp: Int = 0, answerIdentifiers:[String]) -> [String: Any] {
         return [
-            "event_id": "$eventId",
+            "event_id": eventId,
             "type": kMXEventTypeStringPollResponse,
             "sender": sender,
             "origin_server_ts": timestamp,
@@ -172,7 +172,7 @@ class MXPollBuilderTest: XCTestCase {
     
     private func pollEndEvent(timestamp: Int = 0) -> [String: Any] {
         return [
-            "event_id": "$eventId",
+            "event_id": "$" + UUID().uuidString,
             "type": kMXEventTypeStringPollEnd,
             "origin_server_ts": timestamp,
             "content": [kMXMessageContentKeyExtensiblePollEnd: [:]]
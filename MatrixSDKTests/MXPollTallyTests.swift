@@ -0,0 +1,256 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import Foundation
+
+class MXPollTallyTests: XCTestCase {
+
+    private let pollStartEventId = "$pollStart"
+    private let roomId = "!room:matrix.org"
+
+    func testVotesAreAppliedIncrementally() {
+        var tally = makeTally(maxAllowedSelections: 2)
+
+        XCTAssertTrue(tally.apply(pollResponseEvent(sender: "Alice", timestamp: 0, answerIdentifiers: ["1"])))
+        XCTAssertTrue(tally.apply(pollResponseEvent(sender: "Bob", timestamp: 1, answerIdentifiers: ["1", "2"])))
+        XCTAssertEqual(tally.answerCounts, ["1": 2, "2": 1])
+        XCTAssertEqual(tally.winningCount, 2)
+
+        // Alice changes her vote
+        XCTAssertTrue(tally.apply(pollResponseEvent(sender: "Alice", timestamp: 2, answerIdentifiers: ["2"])))
+        XCTAssertEqual(tally.answerCounts, ["1": 1, "2": 2])
+
+        // An older vote of Alice does not change anything
+        XCTAssertFalse(tally.apply(pollResponseEvent(sender: "Alice", timestamp: 1, answerIdentifiers: ["1"])))
+        XCTAssertEqual(tally.countedAnswersByUser["Alice"], ["2"])
+
+        // Spoiled vote
+        XCTAssertTrue(tally.apply(pollResponseEvent(sender: "Bob", timestamp: 3, answerIdentifiers: [])))
+        XCTAssertEqual(tally.answerCounts, ["2": 1])
+        XCTAssertNil(tally.countedAnswersByUser["Bob"])
+    }
+
+    func testEventsAreAppliedOnce() {
+        var tally = makeTally()
+        let event = pollResponseEvent(sender: "Alice", timestamp: 0, answerIdentifiers: ["1"])
+
+        XCTAssertTrue(tally.apply(event))
+        XCTAssertFalse(tally.apply(event))
+        XCTAssertEqual(tally.answerCounts, ["1": 1])
+    }
+
+    func testEndEventReceivedLate() {
+        var tally = makeTally()
+        tally.apply(pollResponseEvent(sender: "Alice", timestamp: 0, answerIdentifiers: ["1"]))
+        tally.apply(pollResponseEvent(sender: "Alice", timestamp: 20, answerIdentifiers: ["2"]))
+        tally.apply(pollResponseEvent(sender: "Bob", timestamp: 20, answerIdentifiers: ["2"]))
+        XCTAssertEqual(tally.answerCounts, ["2": 2])
+
+        // Votes submitted after the end are discarded
+        XCTAssertTrue(tally.apply(pollEndEvent(timestamp: 10)))
+        XCTAssertTrue(tally.isClosed)
+        XCTAssertEqual(tally.answerCounts, ["1": 1])
+
+        // A later end event does not reopen anything
+        XCTAssertFalse(tally.apply(pollEndEvent(timestamp: 30)))
+        XCTAssertEqual(tally.answerCounts, ["1": 1])
+    }
+
+    func testMaxAllowedSelectionsUpdate() {
+        var tally = makeTally(maxAllowedSelections: 1)
+        tally.apply(pollResponseEvent(sender: "Alice", timestamp: 0, answerIdentifiers: ["1", "2"]))
+        XCTAssertEqual(tally.answerCounts, [:])
+
+        tally.update(maxAllowedSelections: 2)
+        XCTAssertEqual(tally.answerCounts, ["1": 1, "2": 1])
+    }
+
+    func testTallyMatchesFullBuild() {
+        let builder = PollBuilder()
+        var events = [MXEvent]()
+        for index in 0..<200 {
+            let answers = index % 7 == 0 ? [] : [String(index % 3), String(index % 2)]
+            events.append(pollResponseEvent(sender: "user\(index % 50)", timestamp: index, answerIdentifiers: answers))
+        }
+        events.append(pollEndEvent(timestamp: 150))
+
+        var tally = makeTally(maxAllowedSelections: 2)
+        for event in events.shuffled() {
+            tally.apply(event)
+        }
+
+        let incrementalPoll = builder.build(pollStartEventContent: pollStartEventContent(maxSelections: 2), pollStartEvent: pollStartEvent(), tally: tally, currentUserIdentifier: "user1")
+        let fullPoll = builder.build(pollStartEventContent: pollStartEventContent(maxSelections: 2), pollStartEvent: pollStartEvent(), events: events, currentUserIdentifier: "user1")
+
+        XCTAssertEqual(incrementalPoll.answerOptions.map(\.count), fullPoll.answerOptions.map(\.count))
+        XCTAssertEqual(incrementalPoll.answerOptions.map(\.isWinner), fullPoll.answerOptions.map(\.isWinner))
+        XCTAssertEqual(incrementalPoll.answerOptions.map(\.isCurrentUserSelection), fullPoll.answerOptions.map(\.isCurrentUserSelection))
+        XCTAssertTrue(incrementalPoll.isClosed)
+    }
+
+    func testStoreRestoresSnapshot() {
+        let storeUrl = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent(UUID().uuidString)
+        defer {
+            try? FileManager.default.removeItem(at: storeUrl)
+        }
+
+        var tally = makeTally()
+        tally.apply(pollResponseEvent(sender: "Alice", timestamp: 0, answerIdentifiers: ["1"]))
+
+        let store = MXPollTallyStore(storeUrl: storeUrl)
+        store.store(tally)
+
+        // Live events update the snapshot
+        store.handlePollEvent(pollResponseEvent(sender: "Bob", timestamp: 1, answerIdentifiers: ["2"]))
+        flush(store)
+
+        // A new store finds the snapshot on disk
+        let restoredTally = MXPollTallyStore(storeUrl: storeUrl).tally(forPollStartEventId: pollStartEventId, inRoom: roomId)
+        XCTAssertEqual(restoredTally?.answerCounts, ["1": 1, "2": 1])
+        XCTAssertNil(MXPollTallyStore(storeUrl: storeUrl).tally(forPollStartEventId: "$otherPoll", inRoom: roomId))
+
+        store.removeSnapshots(inRoom: roomId)
+        flush(store)
+        XCTAssertNil(store.tally(forPollStartEventId: pollStartEventId, inRoom: roomId))
+        XCTAssertNil(MXPollTallyStore(storeUrl: storeUrl).tally(forPollStartEventId: pollStartEventId, inRoom: roomId))
+    }
+
+    func testStoreAppliesVotesDecryptedLate() {
+        let storeUrl = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent(UUID().uuidString)
+        defer {
+            try? FileManager.default.removeItem(at: storeUrl)
+        }
+
+        let store = MXPollTallyStore(storeUrl: storeUrl)
+        store.store(makeTally())
+
+        // The vote arrives undecryptable
+        let event = encryptedPollResponseEvent(sender: "Alice", timestamp: 0)
+        store.handlePollEvent(event)
+        XCTAssertEqual(store.tally(forPollStartEventId: pollStartEventId, inRoom: roomId)?.hasDecryptionError, true)
+
+        // Then the keys arrive
+        let result = MXEventDecryptionResult()
+        result.clearEvent = [
+            "type": kMXEventTypeStringPollResponse,
+            "content": [
+                kMXMessageContentKeyExtensiblePollResponse: [kMXMessageContentKeyExtensiblePollAnswers: ["1"]]
+            ]
+        ]
+        event.setClearData(result)
+        NotificationCenter.default.post(name: .mxEventDidDecrypt, object: event)
+
+        let tally = store.tally(forPollStartEventId: pollStartEventId, inRoom: roomId)
+        XCTAssertEqual(tally?.hasDecryptionError, false)
+        XCTAssertEqual(tally?.answerCounts, ["1": 1])
+
+        // The snapshot restored later has the vote
+        flush(store)
+        XCTAssertEqual(MXPollTallyStore(storeUrl: storeUrl).tally(forPollStartEventId: pollStartEventId, inRoom: roomId)?.answerCounts, ["1": 1])
+    }
+
+    func testPendingSnapshotsAreWrittenSynchronously() {
+        let storeUrl = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent(UUID().uuidString)
+        defer {
+            try? FileManager.default.removeItem(at: storeUrl)
+        }
+
+        let store = MXPollTallyStore(storeUrl: storeUrl)
+        store.store(makeTally())
+        store.handlePollEvent(pollResponseEvent(sender: "Alice", timestamp: 0, answerIdentifiers: ["1"]))
+
+        // Like before the session store commits the vote
+        store.writePendingSnapshots()
+
+        XCTAssertEqual(MXPollTallyStore(storeUrl: storeUrl).tally(forPollStartEventId: pollStartEventId, inRoom: roomId)?.answerCounts, ["1": 1])
+    }
+
+    // MARK: - Private
+
+    private func flush(_ store: MXPollTallyStore) {
+        let expectation = expectation(description: "flush")
+        store.flush {
+            expectation.fulfill()
+        }
+        waitForExpectations(timeout: 5)
+    }
+
+    private func makeTally(maxAllowedSelections: UInt = 1) -> PollTally {
+        PollTally(pollStartEventId: pollStartEventId, roomId: roomId, maxAllowedSelections: maxAllowedSelections)
+    }
+
+    private func pollStartEventContent(maxSelections: UInt) -> MXEventContentPollStart {
+        let answerOptions = [MXEventContentPollStartAnswerOption(uuid: "0", text: "First answer"),
+                             MXEventContentPollStartAnswerOption(uuid: "1", text: "Second answer"),
+                             MXEventContentPollStartAnswerOption(uuid: "2", text: "Third answer")]
+
+        return MXEventContentPollStart(question: "Question",
+                                       kind: kMXMessageContentKeyExtensiblePollKindDisclosed,
+                                       maxSelections: NSNumber(value: maxSelections),
+                                       answerOptions: answerOptions)
+    }
+
+    private func pollStartEvent() -> MXEvent {
+        MXEvent(fromJSON: [
+            "event_id": pollStartEventId,
+            "type": kMXEventTypeStringPollStart,
+            "room_id": roomId,
+            "origin_server_ts": 0
+        ])
+    }
+
+    private func pollResponseEvent(sender: String, timestamp: Int, answerIdentifiers: [String]) -> MXEvent {
+        MXEvent(fromJSON: [
+            "event_id": "$" + UUID().uuidString,
+            "type": kMXEventTypeStringPollResponse,
+            "room_id": roomId,
+            "sender": sender,
+            "origin_server_ts": timestamp,
+            "content": [
+                kMXMessageContentKeyExtensiblePollResponse: [kMXMessageContentKeyExtensiblePollAnswers: answerIdentifiers],
+                kMXEventRelationRelatesToKey: ["rel_type": MXEventRelationTypeReference, "event_id": pollStartEventId]
+            ]
+        ])
+    }
+
+    private func encryptedPollResponseEvent(sender: String, timestamp: Int) -> MXEvent {
+        MXEvent(fromJSON: [
+            "event_id": "$" + UUID().uuidString,
+            "type": kMXEventTypeStringRoomEncrypted,
+            "room_id": roomId,
+            "sender": sender,
+            "origin_server_ts": timestamp,
+            "content": [
+                "algorithm": kMXCryptoMegolmAlgorithm,
+                "ciphertext": "ciphertext",
+                kMXEventRelationRelatesToKey: ["rel_type": MXEventRelationTypeReference, "event_id": pollStartEventId]
+            ]
+        ])
+    }
+
+    private func pollEndEvent(timestamp: Int) -> MXEvent {
+        MXEvent(fromJSON: [
+            "event_id": "$" + UUID().uuidString,
+            "type": kMXEventTypeStringPollEnd,
+            "room_id": roomId,
+            "origin_server_ts": timestamp,
+            "content": [
+                kMXMessageContentKeyExtensiblePollEnd: [:],
+                kMXEventRelationRelatesToKey: ["rel_type": MXEventRelationTypeReference, "event_id": pollStartEventId]
+            ]
+        ])
+    }
+}
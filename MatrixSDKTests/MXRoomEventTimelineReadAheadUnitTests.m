@@ -0,0 +1,326 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXSession.h"
+#import "MXMemoryStore.h"
+#import "MXRoomEventTimeline.h"
+#import "MXRestClientStub.h"
+
+static NSString * const kRoomId = @"!room:matrix.org";
+static NSString * const kAlice = @"@alice:matrix.org";
+static NSString * const kBob = @"@bob:matrix.org";
+
+@interface MXRoomEventTimelineReadAheadUnitTests : XCTestCase
+{
+    MXRestClientStub *restClient;
+    MXSession *session;
+    MXMemoryStore *store;
+    MXRoom *room;
+    MXRoomEventTimeline *timeline;
+
+    // Events received by the timeline listener
+    NSMutableArray<MXEvent*> *paginatedEvents;
+}
+@end
+
+@implementation MXRoomEventTimelineReadAheadUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    // The stub plays the homeserver: the room has 30 messages, the 20 first ones from Bob
+    NSMutableArray<NSDictionary*> *messages = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 30; i++)
+    {
+        [messages addObject:@{
+            @"event_id": [NSString stringWithFormat:@"$%@", @(i)],
+            @"type": kMXEventTypeStringRoomMessage,
+            @"room_id": kRoomId,
+            @"sender": i < 20 ? kBob : kAlice,
+            @"origin_server_ts": @(i),
+            @"content": @{
+                @"msgtype": kMXMessageTypeText,
+                @"body": [NSString stringWithFormat:@"%@", @(i)]
+            }
+        }];
+    }
+
+    MXCredentials *credentials = [[MXCredentials alloc] initWithHomeServer:@"www" userId:@"@user:domain" accessToken:nil];
+    restClient = [[MXRestClientStub alloc] initWithCredentials:credentials andOnUnrecognizedCertificateBlock:nil];
+    restClient.stubbedMessagesPerRoom = @{kRoomId: messages};
+    restClient.stubbedStatePerRoom = @{kRoomId: @[[self memberEventWithUserId:kAlice], [self memberEventWithUserId:kBob]]};
+
+    session = [[MXSession alloc] initWithMatrixRestClient:restClient];
+    store = [[MXMemoryStore alloc] init];
+    [session setStore:store success:^{} failure:^(NSError *error) {}];
+
+    room = [session getOrCreateRoom:kRoomId];
+    timeline = [[MXRoomEventTimeline alloc] initWithRoom:room initialEventId:nil andStore:store];
+    timeline.backPaginationReadAheadCount = 10;
+    [timeline resetPagination];
+
+    paginatedEvents = [NSMutableArray array];
+    [timeline listenToEvents:^(MXEvent *event, MXTimelineDirection direction, MXRoomState *roomState) {
+        [self->paginatedEvents addObject:event];
+    }];
+}
+
+- (void)tearDown
+{
+    [timeline destroy];
+    [session close];
+    [super tearDown];
+}
+
+- (NSDictionary*)memberEventWithUserId:(NSString*)userId
+{
+    return @{
+        @"event_id": [NSString stringWithFormat:@"$member-%@", userId],
+        @"type": kMXEventTypeStringRoomMember,
+        @"room_id": kRoomId,
+        @"sender": userId,
+        @"state_key": userId,
+        @"origin_server_ts": @(0),
+        @"content": @{@"membership": kMXMembershipStringJoin}
+    };
+}
+
+- (NSUInteger)storedEventsCount
+{
+    return [store messagesEnumeratorForRoom:kRoomId].remaining;
+}
+
+- (void)testReadAheadPreparesTheNextPagination
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"paginations"];
+
+    [timeline paginate:10 direction:MXTimelineDirectionBackwards onlyFromStore:NO complete:^{
+
+        // The read-ahead request has been sent after the first one
+        XCTAssertEqual(self->paginatedEvents.count, 10);
+        XCTAssertEqual(self->restClient.messagesRequestsCount, 2);
+
+        // The second pagination waits for the read-ahead instead of making its own request
+        [self->timeline paginate:10 direction:MXTimelineDirectionBackwards onlyFromStore:NO complete:^{
+
+            XCTAssertEqual(self->paginatedEvents.count, 20);
+            XCTAssertEqualObjects(self->paginatedEvents.lastObject.eventId, @"$10");
+            XCTAssertEqual([self storedEventsCount], 20);
+
+            // Now, the last page is being prepared
+            XCTAssertEqual(self->restClient.messagesRequestsCount, 3);
+
+            dispatch_async(dispatch_get_main_queue(), ^{
+                // Prepared events are stored but not notified
+                XCTAssertEqual([self storedEventsCount], 30);
+                XCTAssertEqual(self->paginatedEvents.count, 20);
+                XCTAssertEqual(self->timeline.remainingMessagesForBackPaginationInStore, 10);
+
+                // The last page comes from the store. The read-ahead then finds the beginning of the room
+                [self->timeline paginate:10 direction:MXTimelineDirectionBackwards onlyFromStore:NO complete:^{
+                    XCTAssertEqual(self->paginatedEvents.count, 30);
+                    XCTAssertEqualObjects(self->paginatedEvents.lastObject.eventId, @"$0");
+                    XCTAssertEqual(self->restClient.messagesRequestsCount, 4);
+                    [expectation fulfill];
+
+                } failure:^(NSError *error) {
+                    XCTFail(@"The operation should not fail - NSError: %@", error);
+                    [expectation fulfill];
+                }];
+            });
+
+        } failure:^(NSError *error) {
+            XCTFail(@"The operation should not fail - NSError: %@", error);
+            [expectation fulfill];
+        }];
+
+    } failure:^(NSError *error) {
+        XCTFail(@"The operation should not fail - NSError: %@", error);
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testReadAheadIsCancelledWhenScrollingAway
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"pagination"];
+
+    [timeline paginate:10 direction:MXTimelineDirectionBackwards onlyFromStore:NO complete:^{
+
+        // The read-ahead request has been sent
+        XCTAssertEqual(self->restClient.messagesRequestsCount, 2);
+        self->timeline.backPaginationReadAheadCount = 0;
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            XCTAssertEqual([self storedEventsCount], 10);
+            XCTAssertEqual(self->timeline.remainingMessagesForBackPaginationInStore, 0);
+            [expectation fulfill];
+        });
+
+    } failure:^(NSError *error) {
+        XCTFail(@"The operation should not fail - NSError: %@", error);
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testResetPaginationCancelsReadAhead
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"pagination"];
+
+    [timeline paginate:10 direction:MXTimelineDirectionBackwards onlyFromStore:NO complete:^{
+
+        [self->timeline resetPagination];
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            XCTAssertEqual([self storedEventsCount], 10);
+            XCTAssertEqual(self->timeline.remainingMessagesForBackPaginationInStore, 10);
+            XCTAssertEqual(self->paginatedEvents.count, 10);
+            [expectation fulfill];
+        });
+
+    } failure:^(NSError *error) {
+        XCTFail(@"The operation should not fail - NSError: %@", error);
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testLimitedSyncCancelsReadAhead
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"pagination"];
+
+    [timeline paginate:10 direction:MXTimelineDirectionBackwards onlyFromStore:NO complete:^{
+
+        // The read-ahead request is pending when a limited sync flushes the room messages
+        XCTAssertEqual(self->restClient.messagesRequestsCount, 2);
+
+        MXRoomSync *roomSync = [MXRoomSync modelFromJSON:@{
+            @"timeline": @{
+                @"events": @[@{
+                    @"event_id": @"$new",
+                    @"type": kMXEventTypeStringRoomMessage,
+                    @"sender": kAlice,
+                    @"origin_server_ts": @(100),
+                    @"content": @{
+                        @"msgtype": kMXMessageTypeText,
+                        @"body": @"new"
+                    }
+                }],
+                @"limited": @(YES),
+                @"prev_batch": @"gap"
+            }
+        }];
+        self->room.summary.membership = MXMembershipJoin;
+        [self->timeline handleJoinedRoomSync:roomSync onComplete:^{
+
+            dispatch_async(dispatch_get_main_queue(), ^{
+                // Events from before the gap have not been stored back
+                XCTAssertEqual([self storedEventsCount], 1);
+                XCTAssertEqualObjects([self->store paginationTokenOfRoom:kRoomId], @"gap");
+                XCTAssertEqual(self->timeline.remainingMessagesForBackPaginationInStore, 0);
+                [expectation fulfill];
+            });
+        }];
+
+    } failure:^(NSError *error) {
+        XCTFail(@"The operation should not fail - NSError: %@", error);
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testLazyLoadedMembersAreKeptWhenReadAheadIsReset
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"pagination"];
+
+    [timeline paginate:10 direction:MXTimelineDirectionBackwards onlyFromStore:NO complete:^{
+
+        XCTAssertNotNil([self->timeline.state.members memberWithUserId:kAlice]);
+        XCTAssertNil([self->timeline.state.members memberWithUserId:kBob]);
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            // Bob's messages have been prepared and stored
+            XCTAssertEqual([self storedEventsCount], 20);
+
+            // The prepared events are dropped but they will come from the store
+            [self->timeline resetPagination];
+            XCTAssertEqual(self->timeline.remainingMessagesForBackPaginationInStore, 20);
+
+            // Their sender is known
+            XCTAssertNotNil([self->timeline.state.members memberWithUserId:kBob]);
+            [expectation fulfill];
+        });
+
+    } failure:^(NSError *error) {
+        XCTFail(@"The operation should not fail - NSError: %@", error);
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testPaginationOnlyFromStoreDoesNotWaitForReadAhead
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"paginations"];
+
+    [timeline paginate:10 direction:MXTimelineDirectionBackwards onlyFromStore:NO complete:^{
+
+        // Restart from the 10 stored events
+        self->timeline.backPaginationReadAheadCount = 0;
+        [self->timeline resetPagination];
+        self->timeline.backPaginationReadAheadCount = 10;
+
+        [self->timeline paginate:5 direction:MXTimelineDirectionBackwards onlyFromStore:NO complete:^{
+
+            // The read-ahead has prepared the 5 other stored events and requests 5 more.
+            // The request cancelled by the reset counts too
+            XCTAssertEqual(self->timeline.remainingMessagesForBackPaginationInStore, 5);
+            XCTAssertEqual(self->restClient.messagesRequestsCount, 3);
+
+            [self->timeline paginate:10 direction:MXTimelineDirectionBackwards onlyFromStore:YES complete:^{
+
+                // Only the prepared events from the store
+                XCTAssertEqual(self->paginatedEvents.count, 20);
+                XCTAssertEqualObjects(self->paginatedEvents.lastObject.eventId, @"$20");
+                [expectation fulfill];
+
+            } failure:^(NSError *error) {
+                XCTFail(@"The operation should not fail - NSError: %@", error);
+                [expectation fulfill];
+            }];
+
+        } failure:^(NSError *error) {
+            XCTFail(@"The operation should not fail - NSError: %@", error);
+            [expectation fulfill];
+        }];
+
+    } failure:^(NSError *error) {
+        XCTFail(@"The operation should not fail - NSError: %@", error);
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+@end
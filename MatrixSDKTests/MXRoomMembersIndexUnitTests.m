@@ -0,0 +1,163 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXRoomMembersIndex.h"
+#import "MXRoomMember.h"
+#import "MXEvent.h"
+
+@interface MXRoomMembersIndexUnitTests : XCTestCase
+@end
+
+@implementation MXRoomMembersIndexUnitTests
+
+- (MXRoomMember*)memberWithUserId:(NSString*)userId displayname:(NSString*)displayname membership:(NSString*)membership ts:(uint64_t)ts
+{
+    NSMutableDictionary *content = [NSMutableDictionary dictionaryWithDictionary:@{@"membership": membership}];
+    if (displayname)
+    {
+        content[@"displayname"] = displayname;
+    }
+
+    MXEvent *event = [MXEvent modelFromJSON:@{
+        @"event_id": [NSString stringWithFormat:@"$%@-%@", userId, membership],
+        @"type": kMXEventTypeStringRoomMember,
+        @"state_key": userId,
+        @"sender": userId,
+        @"origin_server_ts": @(ts),
+        @"content": content
+    }];
+
+    return [[MXRoomMember alloc] initWithMXEvent:event];
+}
+
+- (MXRoomMembersIndex*)buildIndex
+{
+    return [[MXRoomMembersIndex alloc] initWithMembers:@[
+        [self memberWithUserId:@"@alice:matrix.org" displayname:@"Alice" membership:kMXMembershipStringJoin ts:3],
+        [self memberWithUserId:@"@bob:matrix.org" displayname:@"Bob Smith" membership:kMXMembershipStringJoin ts:1],
+        [self memberWithUserId:@"@charlie:matrix.org" displayname:@"Chärlie" membership:kMXMembershipStringInvite ts:2],
+        [self memberWithUserId:@"@dave:matrix.org" displayname:nil membership:kMXMembershipStringLeave ts:4]
+    ]];
+}
+
+- (NSArray<NSString*>*)userIdsOfMembers:(NSArray<MXRoomMember*>*)members
+{
+    return [members valueForKey:@"userId"];
+}
+
+- (void)testMembershipCounts
+{
+    MXRoomMembersIndex *index = [self buildIndex];
+
+    XCTAssertEqual(index.count, 4);
+    XCTAssertEqual([index countOfMembersWithMembership:MXMembershipJoin], 2);
+    XCTAssertEqual([index countOfMembersWithMembership:MXMembershipInvite], 1);
+    XCTAssertEqual([index countOfMembersWithMembership:MXMembershipLeave], 1);
+    XCTAssertEqual([index countOfMembersWithMembership:MXMembershipBan], 0);
+
+    // Charlie joins
+    [index addOrUpdateMember:[self memberWithUserId:@"@charlie:matrix.org" displayname:@"Chärlie" membership:kMXMembershipStringJoin ts:5]];
+
+    XCTAssertEqual(index.count, 4);
+    XCTAssertEqual([index countOfMembersWithMembership:MXMembershipJoin], 3);
+    XCTAssertEqual([index countOfMembersWithMembership:MXMembershipInvite], 0);
+
+    [index removeMemberWithUserId:@"@alice:matrix.org"];
+
+    XCTAssertEqual(index.count, 3);
+    XCTAssertEqual([index countOfMembersWithMembership:MXMembershipJoin], 2);
+}
+
+- (void)testCopyIsIndependent
+{
+    MXRoomMembersIndex *index = [self buildIndex];
+    MXRoomMembersIndex *indexCopy = [index copy];
+
+    // Eve joins and Alice leaves in the copy only
+    [indexCopy addOrUpdateMember:[self memberWithUserId:@"@eve:matrix.org" displayname:@"Alicia" membership:kMXMembershipStringJoin ts:6]];
+    [indexCopy removeMemberWithUserId:@"@alice:matrix.org"];
+
+    XCTAssertEqual(index.count, 4);
+    XCTAssertEqual([index countOfMembersWithMembership:MXMembershipJoin], 2);
+    XCTAssertEqualObjects([self userIdsOfMembers:[index membersMatchingSearchText:@"ali" limit:0]], (@[@"@alice:matrix.org"]));
+
+    XCTAssertEqual(indexCopy.count, 4);
+    XCTAssertEqual([indexCopy countOfMembersWithMembership:MXMembershipJoin], 2);
+    XCTAssertEqualObjects([self userIdsOfMembers:[indexCopy membersMatchingSearchText:@"ali" limit:0]], (@[@"@eve:matrix.org"]));
+    XCTAssertEqualObjects([self userIdsOfMembers:[indexCopy membersMatchingSearchText:@"e" limit:0]], (@[@"@eve:matrix.org"]));
+    XCTAssertEqualObjects([self userIdsOfMembers:indexCopy.joinedOrInvitedMembersByCreation], (@[@"@bob:matrix.org", @"@charlie:matrix.org", @"@eve:matrix.org"]));
+}
+
+- (void)testPrefixSearch
+{
+    MXRoomMembersIndex *index = [self buildIndex];
+
+    XCTAssertEqualObjects([self userIdsOfMembers:[index membersMatchingSearchText:@"al" limit:0]], @[@"@alice:matrix.org"]);
+    XCTAssertEqualObjects([self userIdsOfMembers:[index membersMatchingSearchText:@"@b" limit:0]], @[@"@bob:matrix.org"]);
+
+    // Case and diacritic insensitive
+    XCTAssertEqualObjects([self userIdsOfMembers:[index membersMatchingSearchText:@"CH" limit:0]], @[@"@charlie:matrix.org"]);
+}
+
+- (void)testSubstringSearch
+{
+    MXRoomMembersIndex *index = [self buildIndex];
+
+    XCTAssertEqualObjects([self userIdsOfMembers:[index membersMatchingSearchText:@"smith" limit:0]], @[@"@bob:matrix.org"]);
+    XCTAssertEqualObjects([self userIdsOfMembers:[index membersMatchingSearchText:@"arli" limit:0]], @[@"@charlie:matrix.org"]);
+    XCTAssertEqual([index membersMatchingSearchText:@"matrix.org" limit:0].count, 4);
+    XCTAssertEqual([index membersMatchingSearchText:@"matrix.org" limit:2].count, 2);
+    XCTAssertEqual([index membersMatchingSearchText:@"zzz" limit:0].count, 0);
+
+    // Bob changes his name
+    [index addOrUpdateMember:[self memberWithUserId:@"@bob:matrix.org" displayname:@"Robert" membership:kMXMembershipStringJoin ts:1]];
+
+    XCTAssertEqual([index membersMatchingSearchText:@"smith" limit:0].count, 0);
+    XCTAssertEqualObjects([self userIdsOfMembers:[index membersMatchingSearchText:@"bert" limit:0]], @[@"@bob:matrix.org"]);
+}
+
+- (void)testSortedByName
+{
+    MXRoomMembersIndex *index = [self buildIndex];
+    [index addOrUpdateMember:[self memberWithUserId:@"@aaron:matrix.org" displayname:@"zed" membership:kMXMembershipStringJoin ts:6]];
+
+    NSMutableArray<NSString*> *userIds = [NSMutableArray array];
+    [index enumerateMembersSortedByNameUsingBlock:^(MXRoomMember *member, BOOL *stop) {
+        [userIds addObject:member.userId];
+    }];
+
+    // Dave has no display name and is sorted by his user id
+    NSArray *expected = @[@"@dave:matrix.org", @"@alice:matrix.org", @"@bob:matrix.org", @"@charlie:matrix.org", @"@aaron:matrix.org"];
+    XCTAssertEqualObjects(userIds, expected);
+}
+
+- (void)testJoinedOrInvitedMembersByCreation
+{
+    MXRoomMembersIndex *index = [self buildIndex];
+
+    NSArray *expected = @[@"@bob:matrix.org", @"@charlie:matrix.org", @"@alice:matrix.org"];
+    XCTAssertEqualObjects([self userIdsOfMembers:index.joinedOrInvitedMembersByCreation], expected);
+
+    // Bob leaves
+    [index addOrUpdateMember:[self memberWithUserId:@"@bob:matrix.org" displayname:@"Bob Smith" membership:kMXMembershipStringLeave ts:7]];
+
+    expected = @[@"@charlie:matrix.org", @"@alice:matrix.org"];
+    XCTAssertEqualObjects([self userIdsOfMembers:index.joinedOrInvitedMembersByCreation], expected);
+}
+
+@end
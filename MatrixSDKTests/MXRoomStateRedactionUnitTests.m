@@ -0,0 +1,107 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXRoomState.h"
+
+static NSString * const kRoomId = @"!room:matrix.org";
+
+@interface MXRoomStateRedactionUnitTests : XCTestCase
+{
+    MXRoomState *state;
+}
+@end
+
+@implementation MXRoomStateRedactionUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    state = [[MXRoomState alloc] initWithRoomId:kRoomId andMatrixSession:nil andDirection:YES];
+    [state handleStateEvents:@[
+        [self stateEventWithEventId:@"$name1" type:kMXEventTypeStringRoomName stateKey:@"" content:@{@"name": @"Old name"}],
+        [self stateEventWithEventId:@"$name2" type:kMXEventTypeStringRoomName stateKey:@"" content:@{@"name": @"Name"}],
+        [self stateEventWithEventId:@"$bob1" type:kMXEventTypeStringRoomMember stateKey:@"@bob:matrix.org" content:@{@"membership": kMXMembershipStringJoin}],
+        [self stateEventWithEventId:@"$bob2" type:kMXEventTypeStringRoomMember stateKey:@"@bob:matrix.org" content:@{@"membership": kMXMembershipStringJoin, @"displayname": @"Bob"}]
+    ]];
+}
+
+- (MXEvent*)stateEventWithEventId:(NSString*)eventId type:(MXEventTypeString)type stateKey:(NSString*)stateKey content:(NSDictionary*)content
+{
+    return [MXEvent modelFromJSON:@{
+        @"event_id": eventId,
+        @"type": type,
+        @"room_id": kRoomId,
+        @"sender": @"@bob:matrix.org",
+        @"state_key": stateKey,
+        @"origin_server_ts": @(1),
+        @"content": content
+    }];
+}
+
+- (MXEvent*)redactedEventWithEventId:(NSString*)eventId
+{
+    MXEvent *redactedEvent = [[state stateEventWithEventId:eventId] prune];
+    redactedEvent.redactedBecause = @{@"event_id": @"$redaction"};
+    return redactedEvent;
+}
+
+- (void)testStateEventsAreIndexedByEventId
+{
+    XCTAssertEqualObjects([state stateEventWithEventId:@"$name1"].eventId, @"$name1");
+    XCTAssertEqualObjects([state stateEventWithEventId:@"$bob2"].eventId, @"$bob2");
+
+    // Replaced member events are no more part of the state
+    XCTAssertNil([state stateEventWithEventId:@"$bob1"]);
+    XCTAssertNil([state stateEventWithEventId:@"$unknown"]);
+}
+
+- (void)testRedactionOfTheCurrentStateEvent
+{
+    MXRoomState *previousState = [state copy];
+
+    XCTAssertTrue([state handleRedactedStateEvent:[self redactedEventWithEventId:@"$name2"]]);
+
+    XCTAssertNil(state.name);
+    XCTAssertTrue([state stateEventWithEventId:@"$name2"].isRedactedEvent);
+    XCTAssertEqual([state stateEventsWithType:kMXEventTypeStringRoomName].count, 2);
+
+    // Copies of the state are not affected
+    XCTAssertEqualObjects(previousState.name, @"Name");
+}
+
+- (void)testRedactionOfAnOlderStateEventKeepsItsPosition
+{
+    XCTAssertTrue([state handleRedactedStateEvent:[self redactedEventWithEventId:@"$name1"]]);
+
+    XCTAssertEqualObjects(state.name, @"Name");
+    XCTAssertTrue([state stateEventsWithType:kMXEventTypeStringRoomName].firstObject.isRedactedEvent);
+}
+
+- (void)testRedactionOfAMemberEvent
+{
+    XCTAssertTrue([state handleRedactedStateEvent:[self redactedEventWithEventId:@"$bob2"]]);
+
+    MXRoomMember *bob = [state.members memberWithUserId:@"@bob:matrix.org"];
+    XCTAssertNil(bob.displayname);
+    XCTAssertEqual(bob.membership, MXMembershipJoin);
+    XCTAssertTrue([state stateEventWithEventId:@"$bob2"].isRedactedEvent);
+    XCTAssertEqual(state.members.members.count, 1);
+}
+
+@end
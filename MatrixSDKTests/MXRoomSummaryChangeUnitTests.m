@@ -0,0 +1,70 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXRoomSummary_Private.h"
+
+@interface MXRoomSummaryChangeUnitTests : XCTestCase
+@end
+
+@implementation MXRoomSummaryChangeUnitTests
+
+- (void)testFirstCallReportsAllFields
+{
+    MXRoomSummary *summary = [[MXRoomSummary alloc] initWithRoomId:@"!room:matrix.org" andMatrixSession:nil];
+
+    XCTAssertEqual([summary consumeChangedFields], MXRoomSummaryChangedFieldsAll);
+    XCTAssertEqual([summary consumeChangedFields], 0);
+}
+
+- (void)testChangedFields
+{
+    MXRoomSummary *summary = [[MXRoomSummary alloc] initWithRoomId:@"!room:matrix.org" andMatrixSession:nil];
+    [summary consumeChangedFields];
+
+    summary.displayName = @"Room";
+    XCTAssertEqual([summary consumeChangedFields], MXRoomSummaryChangedFieldsProfile);
+
+    summary.displayName = @"Room";
+    summary.membership = MXMembershipJoin;
+    summary.isEncrypted = YES;
+    XCTAssertEqual([summary consumeChangedFields], MXRoomSummaryChangedFieldsMembership | MXRoomSummaryChangedFieldsEncryption);
+}
+
+- (void)testChangedFieldsCompareValues
+{
+    MXRoomSummary *summary = [[MXRoomSummary alloc] initWithRoomId:@"!room:matrix.org" andMatrixSession:nil];
+    summary.aliases = @[@"#a:matrix.org"];
+    [summary consumeChangedFields];
+
+    // Same number of aliases
+    summary.aliases = @[@"#b:matrix.org"];
+    XCTAssertEqual([summary consumeChangedFields], MXRoomSummaryChangedFieldsProfile);
+
+    summary.parentSpaceIds = [NSSet setWithObject:@"!space:matrix.org"];
+    XCTAssertEqual([summary consumeChangedFields], MXRoomSummaryChangedFieldsSpaces);
+
+    summary.membersCount = [MXRoomMembersCount new];
+    summary.membersCount.joined = 2;
+    XCTAssertEqual([summary consumeChangedFields], MXRoomSummaryChangedFieldsMembersCount);
+
+    // In place mutation
+    summary.membersCount.joined = 3;
+    XCTAssertEqual([summary consumeChangedFields], MXRoomSummaryChangedFieldsMembersCount);
+}
+
+@end
@@ -0,0 +1,201 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXRoomSummaryTable.h"
+
+@interface MXRoomSummaryTableUnitTests : XCTestCase
+{
+    NSString *path;
+}
+@end
+
+@implementation MXRoomSummaryTableUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+    path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"MXRoomSummaryTableUnitTests-%@", [NSUUID UUID].UUIDString]];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    [super tearDown];
+}
+
+- (NSData*)dataWithLength:(NSUInteger)length byte:(uint8_t)byte
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    memset(data.mutableBytes, byte, length);
+    return data;
+}
+
+- (void)testSetAndGetData
+{
+    MXRoomSummaryTable *table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    NSData *data = [self dataWithLength:100 byte:1];
+
+    [table setData:data forRoomId:@"!room:matrix.org"];
+
+    XCTAssertEqual(table.count, 1);
+    XCTAssertEqualObjects(table.roomIds, @[@"!room:matrix.org"]);
+    XCTAssertEqualObjects([table dataForRoomId:@"!room:matrix.org"], data);
+    XCTAssertNil([table dataForRoomId:@"!other:matrix.org"]);
+}
+
+- (void)testUpdateInPlace
+{
+    MXRoomSummaryTable *table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    [table setData:[self dataWithLength:100 byte:1] forRoomId:@"!room:matrix.org"];
+
+    NSData *data = [self dataWithLength:110 byte:2];
+    [table setData:data forRoomId:@"!room:matrix.org"];
+
+    XCTAssertEqualObjects([table dataForRoomId:@"!room:matrix.org"], data);
+    XCTAssertEqual(table.unusedBytes, 0);
+}
+
+- (void)testUpdateBeyondCapacity
+{
+    MXRoomSummaryTable *table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    [table setData:[self dataWithLength:100 byte:1] forRoomId:@"!room:matrix.org"];
+
+    NSData *data = [self dataWithLength:1000 byte:2];
+    [table setData:data forRoomId:@"!room:matrix.org"];
+
+    XCTAssertEqualObjects([table dataForRoomId:@"!room:matrix.org"], data);
+    XCTAssertGreaterThan(table.unusedBytes, 0);
+    XCTAssertEqual(table.count, 1);
+}
+
+- (void)testRemoveData
+{
+    MXRoomSummaryTable *table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    [table setData:[self dataWithLength:100 byte:1] forRoomId:@"!room1:matrix.org"];
+    [table setData:[self dataWithLength:100 byte:2] forRoomId:@"!room2:matrix.org"];
+
+    [table removeDataForRoomId:@"!room1:matrix.org"];
+
+    XCTAssertEqualObjects(table.roomIds, @[@"!room2:matrix.org"]);
+    XCTAssertNil([table dataForRoomId:@"!room1:matrix.org"]);
+
+    table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    XCTAssertEqualObjects(table.roomIds, @[@"!room2:matrix.org"]);
+}
+
+- (void)testReopen
+{
+    MXRoomSummaryTable *table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    NSMutableDictionary<NSString*, NSData*> *expected = [NSMutableDictionary dictionary];
+    for (uint8_t i = 0; i < 200; i++)
+    {
+        NSString *roomId = [NSString stringWithFormat:@"!room%@:matrix.org", @(i)];
+        expected[roomId] = [self dataWithLength:50 + i * 10 byte:i];
+        [table setData:expected[roomId] forRoomId:roomId];
+    }
+    table = nil;
+
+    table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    XCTAssertEqual(table.count, expected.count);
+
+    NSMutableDictionary<NSString*, NSData*> *enumerated = [NSMutableDictionary dictionary];
+    [table enumerateDataUsingBlock:^(NSString *roomId, NSData *data) {
+        enumerated[roomId] = data;
+    }];
+    XCTAssertEqualObjects(enumerated, expected);
+    XCTAssertEqualObjects([table dataForRoomId:@"!room42:matrix.org"], expected[@"!room42:matrix.org"]);
+}
+
+- (void)testCompact
+{
+    MXRoomSummaryTable *table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    [table setData:[self dataWithLength:100 byte:1] forRoomId:@"!room1:matrix.org"];
+    [table setData:[self dataWithLength:100 byte:2] forRoomId:@"!room2:matrix.org"];
+    [table removeDataForRoomId:@"!room1:matrix.org"];
+    XCTAssertGreaterThan(table.unusedBytes, 0);
+
+    [table compact];
+
+    XCTAssertEqual(table.unusedBytes, 0);
+    XCTAssertEqualObjects([table dataForRoomId:@"!room2:matrix.org"], [self dataWithLength:100 byte:2]);
+
+    table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    XCTAssertEqualObjects(table.roomIds, @[@"!room2:matrix.org"]);
+    XCTAssertEqualObjects([table dataForRoomId:@"!room2:matrix.org"], [self dataWithLength:100 byte:2]);
+}
+
+- (void)testCorruptedFileIsReset
+{
+    [[NSData dataWithBytes:"garbage" length:7] writeToFile:path atomically:YES];
+
+    MXRoomSummaryTable *table = [[MXRoomSummaryTable alloc] initWithPath:path];
+
+    XCTAssertEqual(table.count, 0);
+    [table setData:[self dataWithLength:10 byte:1] forRoomId:@"!room:matrix.org"];
+    XCTAssertEqualObjects([table dataForRoomId:@"!room:matrix.org"], [self dataWithLength:10 byte:1]);
+}
+
+- (void)testFileThatCannotBeOpenedIsNotReset
+{
+    MXRoomSummaryTable *table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    [table setData:[self dataWithLength:100 byte:1] forRoomId:@"!room1:matrix.org"];
+    table = nil;
+
+    // Like a protected file while the device is locked
+    [[NSFileManager defaultManager] setAttributes:@{NSFilePosixPermissions: @(0)} ofItemAtPath:path error:nil];
+    table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    XCTAssertEqual(table.count, 0);
+
+    [table setData:[self dataWithLength:100 byte:2] forRoomId:@"!room2:matrix.org"];
+    XCTAssertNil([table dataForRoomId:@"!room2:matrix.org"]);
+
+    // The next write opens the file again, with its previous content
+    [[NSFileManager defaultManager] setAttributes:@{NSFilePosixPermissions: @(0600)} ofItemAtPath:path error:nil];
+    [table setData:[self dataWithLength:100 byte:2] forRoomId:@"!room2:matrix.org"];
+
+    XCTAssertEqual(table.count, 2);
+    XCTAssertEqualObjects([table dataForRoomId:@"!room1:matrix.org"], [self dataWithLength:100 byte:1]);
+    XCTAssertEqualObjects([table dataForRoomId:@"!room2:matrix.org"], [self dataWithLength:100 byte:2]);
+}
+
+- (void)testReadsFromAnotherThreadDuringWrites
+{
+    MXRoomSummaryTable *table = [[MXRoomSummaryTable alloc] initWithPath:path];
+    NSData *data = [self dataWithLength:100 byte:1];
+    [table setData:data forRoomId:@"!room:matrix.org"];
+
+    dispatch_queue_t writeQueue = dispatch_queue_create("MXRoomSummaryTableUnitTests", DISPATCH_QUEUE_SERIAL);
+    dispatch_async(writeQueue, ^{
+        // Grow other rooms out of their slots, which also compacts the file
+        for (uint8_t i = 0; i < 200; i++)
+        {
+            NSString *roomId = [NSString stringWithFormat:@"!other%@:matrix.org", @(i % 20)];
+            [table setData:[self dataWithLength:100 + i * 50 byte:i] forRoomId:roomId];
+        }
+    });
+
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        XCTAssertEqualObjects([table dataForRoomId:@"!room:matrix.org"], data);
+    }
+
+    dispatch_sync(writeQueue, ^{});
+    XCTAssertEqual(table.count, 21);
+}
+
+@end
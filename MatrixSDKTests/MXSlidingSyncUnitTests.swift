@@ -0,0 +1,400 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+import XCTest
+import OHHTTPStubs
+@testable import MatrixSDK
+
+class MXSlidingSyncUnitTests: XCTestCase {
+
+    private enum Constants {
+        static let credentials: MXCredentials = {
+            let result = MXCredentials(homeServer: "https://localhost",
+                                       userId: "@me:matrix.org",
+                                       accessToken: "some_access_token")
+            result.deviceId = "some_device_id"
+            return result
+        }()
+    }
+
+    override func tearDown() {
+        HTTPStubs.removeAllStubs()
+        super.tearDown()
+    }
+
+    private func listResponse(count: Int, ops: [[String: Any]]) -> MXSlidingSyncListResponse {
+        return MXSlidingSyncListResponse(fromJSON: ["count": count, "ops": ops])
+    }
+
+    // MARK: - List operations
+
+    func testListSyncOperation() {
+        let list = MXSlidingSyncList(name: "all", ranges: [0...2])
+
+        list.apply(listResponse(count: 5, ops: [
+            ["op": "SYNC", "range": [0, 2], "room_ids": ["!a", "!b", "!c"]]
+        ]))
+
+        XCTAssertEqual(list.count, 5)
+        XCTAssertEqual(list.roomIds, ["!a", "!b", "!c", nil, nil])
+        XCTAssertEqual(list.roomIdsInRanges, ["!a", "!b", "!c"])
+    }
+
+    func testListMoveWithDeleteAndInsert() {
+        let list = MXSlidingSyncList(name: "all", ranges: [0...2])
+        list.apply(listResponse(count: 3, ops: [
+            ["op": "SYNC", "range": [0, 2], "room_ids": ["!a", "!b", "!c"]]
+        ]))
+
+        // "!c" gets a new message and moves to the top
+        list.apply(listResponse(count: 3, ops: [
+            ["op": "DELETE", "index": 2],
+            ["op": "INSERT", "index": 0, "room_id": "!c"]
+        ]))
+
+        XCTAssertEqual(list.roomIds, ["!c", "!a", "!b"])
+    }
+
+    func testListInvalidateOperation() {
+        let list = MXSlidingSyncList(name: "all", ranges: [0...1])
+        list.apply(listResponse(count: 2, ops: [
+            ["op": "SYNC", "range": [0, 1], "room_ids": ["!a", "!b"]]
+        ]))
+
+        list.apply(listResponse(count: 2, ops: [
+            ["op": "INVALIDATE", "range": [0, 1]]
+        ]))
+
+        XCTAssertEqual(list.roomIds, [nil, nil])
+        XCTAssertEqual(list.roomIdsInRanges, [])
+    }
+
+    func testListWindowPastTheEndIsEmpty() {
+        let list = MXSlidingSyncList(name: "all", ranges: [0...1, 5...9])
+        list.apply(listResponse(count: 3, ops: [
+            ["op": "SYNC", "range": [0, 1], "room_ids": ["!a", "!b"]]
+        ]))
+
+        XCTAssertEqual(list.roomIdsInRanges, ["!a", "!b"])
+
+        list.ranges = [2...9]
+        list.apply(listResponse(count: 3, ops: [
+            ["op": "SYNC", "range": [2, 2], "room_ids": ["!c"]]
+        ]))
+
+        XCTAssertEqual(list.roomIdsInRanges, ["!c"])
+    }
+
+    func testListRequestJSON() {
+        let list = MXSlidingSyncList(name: "all", ranges: [0...19], sort: ["by_recency"], timelineLimit: 3, requiredState: [["m.room.name", ""]])
+
+        let json = list.requestJSON()
+
+        XCTAssertEqual(json["ranges"] as? [[Int]], [[0, 19]])
+        XCTAssertEqual(json["sort"] as? [String], ["by_recency"])
+        XCTAssertEqual(json["timeline_limit"] as? UInt, 3)
+        XCTAssertEqual(json["required_state"] as? [[String]], [["m.room.name", ""]])
+    }
+
+    // MARK: - Loop
+
+    func testLoopAgainstStubbedServer() throws {
+        // Responses of the stubbed server, in order. The last request is kept pending
+        let responses: [[String: Any]] = [
+            [
+                "pos": "1",
+                "lists": ["all": ["count": 2, "ops": [["op": "SYNC", "range": [0, 1], "room_ids": ["!a:matrix.org", "!b:matrix.org"]]]]],
+                "rooms": [
+                    "!a:matrix.org": [
+                        "timeline": [["type": "m.room.message", "event_id": "$a1", "sender": "@alice:matrix.org", "origin_server_ts": 1, "content": ["body": "hello", "msgtype": "m.text"]]],
+                        "joined_count": 2
+                    ],
+                    "!b:matrix.org": ["joined_count": 2]
+                ]
+            ],
+            [
+                "pos": "2",
+                "lists": ["all": ["count": 2, "ops": [["op": "DELETE", "index": 1], ["op": "INSERT", "index": 0, "room_id": "!b:matrix.org"]]]],
+                "rooms": [
+                    "!b:matrix.org": [
+                        "timeline": [["type": "m.room.message", "event_id": "$b1", "sender": "@alice:matrix.org", "origin_server_ts": 2, "content": ["body": "hi", "msgtype": "m.text"]]]
+                    ]
+                ]
+            ]
+        ]
+
+        let pendingRequestExpectation = expectation(description: "The request after the last response is sent")
+
+        // Stubbed requests are served on another thread
+        let lock = NSLock()
+        var requestedPositions: [String?] = []
+        var requestedTxnIds: [String] = []
+        HTTPStubs.stubRequests { request in
+            request.url?.path.hasSuffix("/org.matrix.msc3575/sync") ?? false
+        } withStubResponse: { request in
+            let components = request.url.flatMap { URLComponents(url: $0, resolvingAgainstBaseURL: false) }
+            let pos = components?.queryItems?.first { $0.name == "pos" }?.value
+            let body = request.httpBodyStream.flatMap { try? JSONSerialization.jsonObject(with: Data(reading: $0)) as? [String: Any] }
+            let txnId = body?["txn_id"] as? String ?? ""
+
+            lock.lock()
+            requestedPositions.append(pos)
+            requestedTxnIds.append(txnId)
+            let index = requestedPositions.count - 1
+            lock.unlock()
+
+            guard index < responses.count else {
+                pendingRequestExpectation.fulfill()
+                return HTTPStubsResponse(jsonObject: ["pos": "\(index + 1)", "txn_id": txnId], statusCode: 200, headers: ["Content-Type": "application/json"])
+                    .requestTime(0, responseTime: 60)
+            }
+
+            var response = responses[index]
+            response["txn_id"] = txnId
+            return HTTPStubsResponse(jsonObject: response, statusCode: 200, headers: ["Content-Type": "application/json"])
+        }
+
+        let restClient = MXRestClient(credentials: Constants.credentials, unrecognizedCertificateHandler: nil)
+        let session = try XCTUnwrap(MXSession(matrixRestClient: restClient))
+        defer {
+            session.close()
+        }
+
+        let slidingSync = MXSlidingSync(session: session)
+        slidingSync.extensions = []
+        slidingSync.addList(MXSlidingSyncList(name: "all", ranges: [0...19]))
+
+        let updatesExpectation = expectation(forNotification: MXSlidingSync.didUpdateLists, object: slidingSync, handler: nil)
+        updatesExpectation.expectedFulfillmentCount = responses.count
+
+        session.setStore(MXMemoryStore()) { response in
+            XCTAssertTrue(response.isSuccess)
+            slidingSync.start()
+        }
+
+        waitForExpectations(timeout: 5)
+
+        lock.lock()
+        defer {
+            lock.unlock()
+        }
+
+        // The position of each response is sent with the next request
+        XCTAssertEqual(slidingSync.pos, "2")
+        XCTAssertEqual(requestedPositions, [nil, "1", "2"])
+
+        // Each request has its own transaction id
+        XCTAssertEqual(Set(requestedTxnIds).count, requestedTxnIds.count)
+        XCTAssertFalse(requestedTxnIds.contains(""))
+
+        // The list update has been applied and the rooms processed by the session
+        XCTAssertEqual(slidingSync.lists["all"]?.roomIds, ["!b:matrix.org", "!a:matrix.org"])
+        XCTAssertNotNil(session.room(withRoomId: "!a:matrix.org"))
+        XCTAssertNotNil(session.store.event(withEventId: "$a1", inRoom: "!a:matrix.org"))
+        XCTAssertNotNil(session.store.event(withEventId: "$b1", inRoom: "!b:matrix.org"))
+
+        slidingSync.stop()
+    }
+
+    func testResponseToAnotherTransactionIsIgnored() {
+        let lock = NSLock()
+        var requestsCount = 0
+        HTTPStubs.stubRequests { request in
+            request.url?.path.hasSuffix("/org.matrix.msc3575/sync") ?? false
+        } withStubResponse: { request in
+            lock.lock()
+            requestsCount += 1
+            lock.unlock()
+            return HTTPStubsResponse(jsonObject: [
+                "pos": "1",
+                "txn_id": "another_txn",
+                "lists": ["all": ["count": 1, "ops": [["op": "SYNC", "range": [0, 0], "room_ids": ["!a:matrix.org"]]]]]
+            ], statusCode: 200, headers: ["Content-Type": "application/json"])
+        }
+
+        let restClient = MXRestClient(credentials: Constants.credentials, unrecognizedCertificateHandler: nil)
+        guard let session = MXSession(matrixRestClient: restClient) else {
+            XCTFail("Failed to setup test conditions")
+            return
+        }
+        defer {
+            session.close()
+        }
+
+        let slidingSync = MXSlidingSync(session: session)
+        slidingSync.extensions = []
+        slidingSync.addList(MXSlidingSyncList(name: "all", ranges: [0...19]))
+
+        wait { expectation in
+            session.setStore(MXMemoryStore()) { _ in
+                slidingSync.start()
+                DispatchQueue.main.asyncAfter(deadline: .now() + 1) {
+                    expectation.fulfill()
+                }
+            }
+        }
+
+        lock.lock()
+        XCTAssertEqual(requestsCount, 1)
+        lock.unlock()
+
+        // The response has not been applied
+        XCTAssertNil(slidingSync.pos)
+        XCTAssertEqual(slidingSync.lists["all"]?.roomIds, [])
+
+        slidingSync.stop()
+    }
+
+    func testPositionsAndListsAreRestoredFromTheStore() throws {
+        // Only the first request gets a response. The others are kept pending
+        let lock = NSLock()
+        var requests: [(pos: String?, toDeviceSince: String?)] = []
+        HTTPStubs.stubRequests { request in
+            request.url?.path.hasSuffix("/org.matrix.msc3575/sync") ?? false
+        } withStubResponse: { request in
+            let components = request.url.flatMap { URLComponents(url: $0, resolvingAgainstBaseURL: false) }
+            let pos = components?.queryItems?.first { $0.name == "pos" }?.value
+            let body = request.httpBodyStream.flatMap { try? JSONSerialization.jsonObject(with: Data(reading: $0)) as? [String: Any] }
+            let toDeviceSince = ((body?["extensions"] as? [String: Any])?["to_device"] as? [String: Any])?["since"] as? String
+
+            lock.lock()
+            requests.append((pos, toDeviceSince))
+            let index = requests.count - 1
+            lock.unlock()
+
+            guard index == 0 else {
+                return HTTPStubsResponse(jsonObject: [:], statusCode: 200, headers: ["Content-Type": "application/json"])
+                    .requestTime(0, responseTime: 60)
+            }
+            return HTTPStubsResponse(jsonObject: [
+                "pos": "1",
+                "txn_id": body?["txn_id"] ?? "",
+                "lists": ["all": ["count": 2, "ops": [["op": "SYNC", "range": [0, 1], "room_ids": ["!a:matrix.org", "!b:matrix.org"]]]]],
+                "extensions": ["to_device": ["next_batch": "td1", "events": []]]
+            ], statusCode: 200, headers: ["Content-Type": "application/json"])
+        }
+
+        let restClient = MXRestClient(credentials: Constants.credentials, unrecognizedCertificateHandler: nil)
+        let session = try XCTUnwrap(MXSession(matrixRestClient: restClient))
+        defer {
+            session.close()
+        }
+
+        let slidingSync = MXSlidingSync(session: session)
+        slidingSync.extensions = ["to_device"]
+        slidingSync.addList(MXSlidingSyncList(name: "all", ranges: [0...19]))
+
+        _ = expectation(forNotification: MXSlidingSync.didUpdateLists, object: slidingSync, handler: nil)
+        session.setStore(MXMemoryStore()) { response in
+            XCTAssertTrue(response.isSuccess)
+            slidingSync.start()
+        }
+        waitForExpectations(timeout: 5)
+        slidingSync.stop()
+
+        // Like after an app restart, a new engine resumes from the stored state
+        let restoredSlidingSync = MXSlidingSync(session: session)
+        restoredSlidingSync.extensions = ["to_device"]
+        restoredSlidingSync.addList(MXSlidingSyncList(name: "all", ranges: [0...19]))
+        restoredSlidingSync.start()
+
+        XCTAssertEqual(restoredSlidingSync.pos, "1")
+        XCTAssertEqual(restoredSlidingSync.lists["all"]?.roomIds, ["!a:matrix.org", "!b:matrix.org"])
+
+        wait { expectation in
+            DispatchQueue.main.asyncAfter(deadline: .now() + 1) {
+                expectation.fulfill()
+            }
+        }
+        restoredSlidingSync.stop()
+
+        lock.lock()
+        defer {
+            lock.unlock()
+        }
+        XCTAssertEqual(requests.first?.pos, nil)
+        XCTAssertEqual(requests.first?.toDeviceSince, nil)
+        XCTAssertEqual(requests.last?.pos, "1")
+        XCTAssertEqual(requests.last?.toDeviceSince, "td1")
+    }
+
+    // MARK: - Conversion
+
+    func testConversionToSyncResponse() throws {
+        let response = try XCTUnwrap(MXSlidingSyncResponse(fromJSON: [
+            "pos": "42",
+            "rooms": [
+                "!joined:matrix.org": [
+                    "required_state": [
+                        ["type": "m.room.name", "state_key": "", "event_id": "$name", "sender": "@alice:matrix.org", "content": ["name": "Room"]]
+                    ],
+                    "timeline": [
+                        ["type": "m.room.message", "event_id": "$message", "sender": "@alice:matrix.org", "content": ["body": "hello", "msgtype": "m.text"]]
+                    ],
+                    "limited": true,
+                    "prev_batch": "prev",
+                    "notification_count": 2,
+                    "highlight_count": 1,
+                    "joined_count": 10,
+                    "invited_count": 1,
+                    "heroes": [["user_id": "@alice:matrix.org"]]
+                ],
+                "!invited:matrix.org": [
+                    "invite_state": [
+                        ["type": "m.room.member", "state_key": "@me:matrix.org", "sender": "@alice:matrix.org", "content": ["membership": "invite"]]
+                    ]
+                ]
+            ],
+            "extensions": [
+                "to_device": [
+                    "next_batch": "td",
+                    "events": [["type": "m.room_key", "sender": "@alice:matrix.org", "content": [:]]]
+                ],
+                "account_data": [
+                    "global": [["type": "m.direct", "content": [:]]]
+                ]
+            ]
+        ]))
+
+        let syncResponse = MXSlidingSyncResponseConverter.syncResponse(from: response, syncToken: "token")
+
+        XCTAssertEqual(syncResponse.nextBatch, "token")
+        XCTAssertEqual(syncResponse.toDevice?.events.count, 1)
+        XCTAssertNotNil(syncResponse.accountData)
+
+        let roomSync = try XCTUnwrap(syncResponse.rooms?.join?["!joined:matrix.org"])
+        XCTAssertEqual(roomSync.state.events.first?.eventId, "$name")
+        XCTAssertEqual(roomSync.timeline.events.first?.eventId, "$message")
+        XCTAssertTrue(roomSync.timeline.limited)
+        XCTAssertEqual(roomSync.timeline.prevBatch, "prev")
+        XCTAssertEqual(roomSync.unreadNotifications.notificationCount, 2)
+        XCTAssertEqual(roomSync.unreadNotifications.highlightCount, 1)
+        XCTAssertEqual(roomSync.summary.joinedMemberCount, 10)
+        XCTAssertEqual(roomSync.summary.heroes, ["@alice:matrix.org"])
+
+        XCTAssertNotNil(syncResponse.rooms?.invite?["!invited:matrix.org"])
+        XCTAssertNil(syncResponse.rooms?.join?["!invited:matrix.org"])
+    }
+
+    // MARK: - Private
+
+    private func wait(_ timeout: TimeInterval = 5, _ block: @escaping (XCTestExpectation) -> Void) {
+        let waiter = XCTWaiter()
+        let expectation = XCTestExpectation(description: "Async operation expectation")
+        block(expectation)
+        waiter.wait(for: [expectation], timeout: timeout)
+    }
+}
@@ -0,0 +1,114 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXStorePreloadScheduler.h"
+
+@interface MXStorePreloadSchedulerUnitTests : XCTestCase
+@end
+
+@implementation MXStorePreloadSchedulerUnitTests
+
+- (NSArray<NSNumber*>*)itemsWithCount:(NSUInteger)count
+{
+    NSMutableArray<NSNumber*> *items = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [items addObject:@(i)];
+    }
+    return items;
+}
+
+- (void)testAllPhasesAreMerged
+{
+    MXStorePreloadScheduler *scheduler = [[MXStorePreloadScheduler alloc] initWithMaxConcurrentTasks:4];
+
+    // Merge blocks use non thread safe containers on purpose
+    NSMutableDictionary<NSNumber*, NSNumber*> *squares = [NSMutableDictionary dictionary];
+    NSMutableArray<NSString*> *strings = [NSMutableArray array];
+
+    [scheduler addPhaseWithName:@"squares" items:[self itemsWithCount:500] decodeBlock:^id(NSNumber *item) {
+        return @(item.integerValue * item.integerValue);
+    } mergeBlock:^(NSNumber *item, NSNumber *result) {
+        squares[item] = result;
+    }];
+    [scheduler addPhaseWithName:@"strings" items:[self itemsWithCount:500] decodeBlock:^id(NSNumber *item) {
+        return item.stringValue;
+    } mergeBlock:^(NSNumber *item, NSString *result) {
+        [strings addObject:result];
+    }];
+    [scheduler addPhaseWithName:@"empty" items:@[] decodeBlock:^id(id item) {
+        XCTFail(@"Nothing to decode");
+        return nil;
+    } mergeBlock:^(id item, id result) {
+        XCTFail(@"Nothing to merge");
+    }];
+
+    [scheduler run];
+
+    XCTAssertEqual(squares.count, 500);
+    XCTAssertEqualObjects(squares[@(12)], @(144));
+    XCTAssertEqual(strings.count, 500);
+}
+
+- (void)testMaxConcurrentTasks
+{
+    MXStorePreloadScheduler *scheduler = [[MXStorePreloadScheduler alloc] initWithMaxConcurrentTasks:2];
+
+    __block NSInteger runningTasks = 0;
+    __block NSInteger maxRunningTasks = 0;
+    NSObject *lock = [NSObject new];
+
+    [scheduler addPhaseWithName:@"sleep" items:[self itemsWithCount:20] decodeBlock:^id(NSNumber *item) {
+        @synchronized (lock)
+        {
+            runningTasks++;
+            maxRunningTasks = MAX(maxRunningTasks, runningTasks);
+        }
+        [NSThread sleepForTimeInterval:0.01];
+        @synchronized (lock)
+        {
+            runningTasks--;
+        }
+        return item;
+    } mergeBlock:^(id item, id result) {
+    }];
+
+    [scheduler run];
+
+    XCTAssertGreaterThan(maxRunningTasks, 0);
+    XCTAssertLessThanOrEqual(maxRunningTasks, 2);
+}
+
+- (void)testNilResultIsMerged
+{
+    MXStorePreloadScheduler *scheduler = [MXStorePreloadScheduler new];
+
+    __block NSUInteger mergeCount = 0;
+    [scheduler addPhaseWithName:@"nil" items:[self itemsWithCount:3] decodeBlock:^id(id item) {
+        return nil;
+    } mergeBlock:^(id item, id result) {
+        XCTAssertNil(result);
+        mergeCount++;
+    }];
+
+    [scheduler run];
+
+    XCTAssertEqual(mergeCount, 3);
+}
+
+@end
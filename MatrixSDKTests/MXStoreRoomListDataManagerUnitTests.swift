@@ -243,6 +243,63 @@ class MXStoreRoomListDataManagerUnitTests: XCTestCase {
         }
     }
     
+    func testFetcherRecomputesWhenOnlyParentSpacesChange() {
+        let restClient = MXRestClient(credentials:  Constants.credentials, unrecognizedCertificateHandler: nil, persistentTokenDataHandler: nil, unauthenticatedHandler: nil)
+        guard let session = MXSession(matrixRestClient: restClient) else {
+            XCTFail("Failed to setup test conditions")
+            return
+        }
+        let store = MXMemoryStore()
+        //  delegates are weakly held by the fetcher
+        var delegate: MockRoomListDataFetcherDelegate?
+        var recomputed = false
+        
+        wait { expectation in
+            session.setStore(store, completion: { response in
+                guard case .success = response, let manager = session.roomListDataManager else {
+                    XCTFail("Failed to setup test conditions")
+                    return
+                }
+                
+                guard let summary = MXRoomSummary(roomId: "!room:matrix.org", andMatrixSession: session) else {
+                    XCTFail("Failed to setup test conditions")
+                    return
+                }
+                summary.displayName = "Room"
+                store.roomSummaryStore.storeSummary(summary)
+                
+                let fetcher = manager.fetcher(withOptions: self.basicFetchOptions)
+                fetcher.paginate()
+                XCTAssertEqual(fetcher.data?.counts.numberOfRooms, 1, "The orphan room should be in the home space")
+                
+                //  let the first batch of changes, with all fields, go
+                summary.save(true)
+                DispatchQueue.main.async {
+                    let fetcherDelegate = MockRoomListDataFetcherDelegate {
+                        //  wait for the room to move to the space
+                        guard fetcher.data?.counts.numberOfRooms == 0 else {
+                            return
+                        }
+                        DispatchQueue.main.async {
+                            recomputed = true
+                            store.deleteAllData()
+                            session.close()
+                            expectation.fulfill()
+                        }
+                    }
+                    delegate = fetcherDelegate
+                    fetcher.addDelegate(fetcherDelegate)
+                    
+                    //  only a field that affects space filters changes
+                    summary.parentSpaceIds = ["!space:matrix.org"]
+                }
+            })
+        }
+        
+        XCTAssertNotNil(delegate, "Failed to setup test conditions")
+        XCTAssertTrue(recomputed, "Fetcher should recompute data when only parent spaces change")
+    }
+    
     private func generateDefaultFetcher(_ completion: @escaping (MXRoomListDataFetcher) -> Void) {
         let restClient = MXRestClient(credentials:  Constants.credentials, unrecognizedCertificateHandler: nil, persistentTokenDataHandler: nil, unauthenticatedHandler: nil)
         guard let session = MXSession(matrixRestClient: restClient) else {
@@ -326,6 +383,20 @@ class MXStoreRoomListDataManagerUnitTests: XCTestCase {
     
 }
 
+fileprivate class MockRoomListDataFetcherDelegate: MXRoomListDataFetcherDelegate {
+    
+    private let onChange: () -> Void
+    
+    init(onChange: @escaping () -> Void) {
+        self.onChange = onChange
+    }
+    
+    func fetcherDidChangeData(_ fetcher: MXRoomListDataFetcher, totalCountsChanged: Bool) {
+        onChange()
+    }
+    
+}
+
 fileprivate extension MXRoomSummaryDataTypes {
     
     static let all: [MXRoomSummaryDataTypes] = [.invited, .favorited, .direct, .lowPriority, .serverNotice, .hidden, .space, .conferenceUser]
@@ -0,0 +1,193 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXSyncPipeline.h"
+#import "MXRestClient.h"
+#import "MXSyncResponse.h"
+#import "MXHTTPOperation.h"
+
+#pragma mark - MXSyncPipelineRestClient
+
+/**
+ Rest client that records /sync requests. The test answers them with `respondToRequestFromToken:`.
+ */
+@interface MXSyncPipelineRestClient : MXRestClient
+
+@property (nonatomic) NSMutableArray<NSString*> *requestedTokens;
+@property (nonatomic) NSMutableDictionary<NSString*, void (^)(MXSyncResponse *)> *pendingRequests;
+
+- (void)respondToRequestFromToken:(NSString*)token nextBatch:(NSString*)nextBatch;
+- (void)respondToRequestFromToken:(NSString*)token withJSON:(NSDictionary*)JSONDictionary;
+
+@end
+
+@implementation MXSyncPipelineRestClient
+
+- (MXHTTPOperation *)syncFromToken:(NSString *)token serverTimeout:(NSUInteger)serverTimeout clientTimeout:(NSUInteger)clientTimeout setPresence:(NSString *)setPresence filter:(NSString *)filterId success:(void (^)(MXSyncResponse *))success failure:(void (^)(NSError *))failure
+{
+    if (!_requestedTokens)
+    {
+        _requestedTokens = [NSMutableArray array];
+        _pendingRequests = [NSMutableDictionary dictionary];
+    }
+    [_requestedTokens addObject:token];
+    _pendingRequests[token] = success;
+    return [[MXHTTPOperation alloc] init];
+}
+
+- (void)respondToRequestFromToken:(NSString *)token nextBatch:(NSString *)nextBatch
+{
+    [self respondToRequestFromToken:token withJSON:@{@"next_batch": nextBatch}];
+}
+
+- (void)respondToRequestFromToken:(NSString *)token withJSON:(NSDictionary *)JSONDictionary
+{
+    void (^success)(MXSyncResponse *) = _pendingRequests[token];
+    [_pendingRequests removeObjectForKey:token];
+    success([MXSyncResponse modelFromJSON:JSONDictionary]);
+}
+
+@end
+
+
+#pragma mark - MXSyncPipelineUnitTests
+
+@interface MXSyncPipelineUnitTests : XCTestCase
+{
+    MXSyncPipelineRestClient *restClient;
+}
+@end
+
+@implementation MXSyncPipelineUnitTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    MXCredentials *credentials = [[MXCredentials alloc] initWithHomeServer:@"https://matrix.org" userId:@"@user:matrix.org" accessToken:nil];
+    restClient = [[MXSyncPipelineRestClient alloc] initWithCredentials:credentials andOnUnrecognizedCertificateBlock:nil];
+}
+
+- (void)testNextBatchIsRequestedOnResponse
+{
+    MXSyncPipeline *pipeline = [[MXSyncPipeline alloc] initWithRestClient:restClient maxDepth:1];
+
+    __block MXSyncResponse *received;
+    [pipeline syncFromToken:@"t0" serverTimeout:0 clientTimeout:0 setPresence:nil filter:nil success:^(MXSyncResponse *syncResponse) {
+        received = syncResponse;
+    } failure:^(NSError *error) {
+        XCTFail(@"Unexpected failure: %@", error);
+    }];
+
+    [restClient respondToRequestFromToken:@"t0" nextBatch:@"t1"];
+
+    XCTAssertEqualObjects(received.nextBatch, @"t1");
+    XCTAssertEqualObjects(restClient.requestedTokens, (@[@"t0", @"t1"]));
+    XCTAssertEqual(pipeline.depth, 1);
+}
+
+- (void)testPrefetchedResponseIsUsed
+{
+    MXSyncPipeline *pipeline = [[MXSyncPipeline alloc] initWithRestClient:restClient maxDepth:1];
+
+    [pipeline syncFromToken:@"t0" serverTimeout:0 clientTimeout:0 setPresence:nil filter:nil success:^(MXSyncResponse *syncResponse) {} failure:^(NSError *error) {}];
+    [restClient respondToRequestFromToken:@"t0" nextBatch:@"t1"];
+
+    // The response for t1 arrives while the session is still processing t0
+    [restClient respondToRequestFromToken:@"t1" nextBatch:@"t2"];
+
+    // The queue is full: t2 must not be requested yet
+    XCTAssertEqualObjects(restClient.requestedTokens, (@[@"t0", @"t1"]));
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Prefetched response"];
+    [pipeline syncFromToken:@"t1" serverTimeout:0 clientTimeout:0 setPresence:nil filter:nil success:^(MXSyncResponse *syncResponse) {
+        XCTAssertEqualObjects(syncResponse.nextBatch, @"t2");
+        [expectation fulfill];
+    } failure:^(NSError *error) {
+        XCTFail(@"Unexpected failure: %@", error);
+    }];
+
+    // Consuming t1 makes room to prefetch t2
+    XCTAssertEqualObjects(restClient.requestedTokens, (@[@"t0", @"t1", @"t2"]));
+
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+}
+
+- (void)testUnexpectedTokenDiscardsPrefetchedBatches
+{
+    MXSyncPipeline *pipeline = [[MXSyncPipeline alloc] initWithRestClient:restClient maxDepth:2];
+
+    [pipeline syncFromToken:@"t0" serverTimeout:0 clientTimeout:0 setPresence:nil filter:nil success:^(MXSyncResponse *syncResponse) {} failure:^(NSError *error) {}];
+    [restClient respondToRequestFromToken:@"t0" nextBatch:@"t1"];
+    XCTAssertEqual(pipeline.depth, 1);
+
+    [pipeline syncFromToken:@"other" serverTimeout:0 clientTimeout:0 setPresence:nil filter:nil success:^(MXSyncResponse *syncResponse) {} failure:^(NSError *error) {}];
+
+    XCTAssertEqual(pipeline.depth, 0);
+    XCTAssertEqualObjects(restClient.requestedTokens.lastObject, @"other");
+}
+
+- (void)testToDeviceEventsSurviveAKillBeforeTheResponseIsStored
+{
+    MXSyncPipeline *pipeline = [[MXSyncPipeline alloc] initWithRestClient:restClient maxDepth:1];
+
+    [pipeline syncFromToken:@"t0" serverTimeout:0 clientTimeout:0 setPresence:nil filter:nil success:^(MXSyncResponse *syncResponse) {} failure:^(NSError *error) {}];
+    [restClient respondToRequestFromToken:@"t0" withJSON:@{
+        @"next_batch": @"t1",
+        @"to_device": @{
+            @"events": @[@{@"type": @"m.room_key", @"sender": @"@alice:matrix.org", @"content": @{}}]
+        }
+    }];
+
+    // Requesting t1 would make the server delete the to-device events of t0
+    XCTAssertEqualObjects(restClient.requestedTokens, (@[@"t0"]));
+
+    // The app is killed before the session stores t0
+    [pipeline cancel];
+    pipeline = nil;
+
+    // The next run syncs again from t0, which the server can still answer with the same to-device events
+    pipeline = [[MXSyncPipeline alloc] initWithRestClient:restClient maxDepth:1];
+    [pipeline syncFromToken:@"t0" serverTimeout:0 clientTimeout:0 setPresence:nil filter:nil success:^(MXSyncResponse *syncResponse) {} failure:^(NSError *error) {}];
+
+    XCTAssertEqualObjects(restClient.requestedTokens, (@[@"t0", @"t0"]));
+}
+
+- (void)testPrefetchResumesOnceTheResponseIsStored
+{
+    MXSyncPipeline *pipeline = [[MXSyncPipeline alloc] initWithRestClient:restClient maxDepth:1];
+
+    __block MXSyncResponse *received;
+    [pipeline syncFromToken:@"t0" serverTimeout:0 clientTimeout:0 setPresence:nil filter:nil success:^(MXSyncResponse *syncResponse) {
+        received = syncResponse;
+    } failure:^(NSError *error) {}];
+    [restClient respondToRequestFromToken:@"t0" withJSON:@{
+        @"next_batch": @"t1",
+        @"device_lists": @{@"changed": @[@"@alice:matrix.org"]}
+    }];
+
+    XCTAssertEqualObjects(restClient.requestedTokens, (@[@"t0"]));
+    XCTAssertEqual(pipeline.depth, 0);
+
+    [pipeline didStoreSyncResponse:received];
+
+    XCTAssertEqualObjects(restClient.requestedTokens, (@[@"t0", @"t1"]));
+    XCTAssertEqual(pipeline.depth, 1);
+}
+
+@end
@@ -0,0 +1,95 @@
+//
+// Copyright 2024 The Matrix.org Foundation C.I.C
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "MXToDeviceSyncResponse.h"
+#import "MXEvent.h"
+#import "MXTools.h"
+
+@interface MXToDeviceSyncResponseUnitTests : XCTestCase
+@end
+
+@implementation MXToDeviceSyncResponseUnitTests
+
+- (NSDictionary*)JSONEventWithType:(NSString*)type
+{
+    return @{
+        @"type": type,
+        @"sender": @"@alice:matrix.org",
+        @"content": @{
+            @"key": @"value"
+        }
+    };
+}
+
+- (void)testJSONIsPassedThrough
+{
+    NSDictionary *JSONEvent = [self JSONEventWithType:kMXEventTypeStringRoomKey];
+    MXToDeviceSyncResponse *toDevice = [MXToDeviceSyncResponse modelFromJSON:@{ @"events": @[JSONEvent] }];
+
+    XCTAssertEqual(toDevice.eventsCount, 1);
+    XCTAssertEqualObjects(toDevice.JSONDictionary, @{ @"events": @[JSONEvent] });
+    XCTAssertEqual(toDevice.JSONDictionary[@"events"][0], JSONEvent, @"Events must not be re-encoded");
+}
+
+- (void)testEventsAreDecodedOnAccess
+{
+    MXToDeviceSyncResponse *toDevice = [MXToDeviceSyncResponse modelFromJSON:@{
+        @"events": @[
+            [self JSONEventWithType:kMXEventTypeStringRoomKey],
+            [self JSONEventWithType:kMXEventTypeStringSecretSend]
+        ]
+    }];
+
+    XCTAssertEqual(toDevice.events.count, 2);
+    XCTAssertEqualObjects(toDevice.events[1].type, kMXEventTypeStringSecretSend);
+    XCTAssertEqual(toDevice.eventsCount, 2);
+}
+
+- (void)testEventJSONStrings
+{
+    NSArray<NSString*> *eventJSONStrings = @[
+        [MXTools serialiseJSONObject:[self JSONEventWithType:kMXEventTypeStringRoomKey]],
+        [MXTools serialiseJSONObject:[self JSONEventWithType:kMXEventTypeStringSecretSend]],
+        @"not json"
+    ];
+    MXToDeviceSyncResponse *toDevice = [MXToDeviceSyncResponse modelWithEventJSONStrings:eventJSONStrings];
+
+    XCTAssertEqual(toDevice.eventsCount, 3);
+
+    NSArray<MXEvent*> *events = [toDevice eventsOfTypes:[NSSet setWithObject:kMXEventTypeStringSecretSend]];
+    XCTAssertEqual(events.count, 1);
+    XCTAssertEqualObjects(events.firstObject.type, kMXEventTypeStringSecretSend);
+    XCTAssertEqualObjects(events.firstObject.content[@"key"], @"value");
+
+    // Invalid events are dropped once decoded
+    XCTAssertEqual(toDevice.events.count, 2);
+    XCTAssertEqual([toDevice eventsOfTypes:[NSSet setWithObject:kMXEventTypeStringRoomKey]].count, 1);
+}
+
+- (void)testSetEvents
+{
+    MXToDeviceSyncResponse *toDevice = [MXToDeviceSyncResponse modelFromJSON:@{
+        @"events": @[[self JSONEventWithType:kMXEventTypeStringRoomKey]]
+    }];
+
+    toDevice.events = @[];
+    XCTAssertEqual(toDevice.eventsCount, 0);
+    XCTAssertEqualObjects(toDevice.JSONDictionary, @{ @"events": @[] });
+}
+
+@end
@@ -35,6 +35,18 @@
  */
 @property (nonatomic, strong) NSDictionary<NSString *, MXAggregationPaginatedResponse *> *stubbedRelatedEventsPerEvent;
 
+/**
+ Stubbed room messages, in chronological order, that will be returned when calling `messagesForRoom`
+ backwards instead of making HTTP requests. Pagination tokens are positions in these arrays.
+ Member events of the senders, taken from `stubbedStatePerRoom`, are returned as lazy loaded state.
+ */
+@property (nonatomic, strong) NSDictionary<NSString *, NSArray <NSDictionary *>*> *stubbedMessagesPerRoom;
+
+/**
+ The number of `messagesForRoom` calls answered with stubbed messages
+ */
+@property (nonatomic) NSUInteger messagesRequestsCount;
+
 @end
 
 #endif /* MXRestClientStub_h */
@@ -72,4 +72,47 @@
     }
 }
 
+- (MXHTTPOperation *)messagesForRoom:(NSString *)roomId from:(NSString *)from direction:(MXTimelineDirection)direction limit:(NSInteger)limit filter:(MXRoomEventFilter *)roomEventFilter success:(void (^)(MXPaginationResponse *))success failure:(void (^)(NSError *))failure
+{
+    NSArray<NSDictionary *> *messages = self.stubbedMessagesPerRoom[roomId];
+    if (!messages || direction != MXTimelineDirectionBackwards)
+    {
+        return [super messagesForRoom:roomId from:from direction:direction limit:limit filter:roomEventFilter success:success failure:failure];
+    }
+
+    self.messagesRequestsCount++;
+
+    NSInteger end = [from isEqualToString:@"END"] ? messages.count : from.integerValue;
+    NSInteger start = MAX(0, end - limit);
+    NSArray<NSDictionary *> *chunk = [messages subarrayWithRange:NSMakeRange(start, end - start)].reverseObjectEnumerator.allObjects;
+
+    // Lazy loaded members
+    NSSet<NSString *> *senders = [NSSet setWithArray:[chunk valueForKey:@"sender"]];
+    NSMutableArray<NSDictionary *> *state = [NSMutableArray array];
+    for (NSDictionary *stateEvent in self.stubbedStatePerRoom[roomId])
+    {
+        if ([stateEvent[@"type"] isEqualToString:kMXEventTypeStringRoomMember] && [senders containsObject:stateEvent[@"state_key"]])
+        {
+            [state addObject:stateEvent];
+        }
+    }
+
+    MXPaginationResponse *response = [MXPaginationResponse modelFromJSON:@{
+        @"start": from,
+        @"end": [NSString stringWithFormat:@"%@", @(start)],
+        @"chunk": chunk,
+        @"state": state
+    }];
+
+    // Answer asynchronously like a homeserver
+    MXHTTPOperation *operation = [MXHTTPOperation new];
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if (!operation.isCancelled)
+        {
+            success(response);
+        }
+    });
+    return operation;
+}
+
 @end